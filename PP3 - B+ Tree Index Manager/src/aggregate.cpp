@@ -0,0 +1,369 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "aggregate.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb {
+
+// partitions of partitions deeper than this keep all of their groups in
+// memory, however many there are
+static const int MAXSPILLDEPTH = 4;
+
+// mixes the bits of a key, differently at each partitioning level; the table
+// takes its slot from the high bits and the partition from the low ones
+static std::uint64_t hashKey(std::uint64_t key, int depth) {
+  std::uint64_t h = key + (depth + 1) * 0x9E3779B97F4A7C15ULL;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// keys are the int, or the bits of the double, grouped by; the two zeros of a
+// double are one group
+static std::uint64_t intKey(int value) {
+  return (std::uint64_t)(std::int64_t)value;
+}
+
+static std::uint64_t doubleKey(double value) {
+  if (value == 0) value = 0;
+  std::uint64_t key;
+  memcpy(&key, &value, sizeof(key));
+  return key;
+}
+
+HashAggregate::HashAggregate(const std::vector<KeyColumn> &batchColumns,
+                             int groupBy,
+                             const std::vector<AggregateSpec> &specs,
+                             BufMgr *bufferMgr, const std::string &name,
+                             std::size_t groupsInMemory)
+    : columns(batchColumns),
+      groupColumn(groupBy),
+      keyType(batchColumns[groupBy].type),
+      aggregates(specs),
+      bufMgr(bufferMgr),
+      spillName(name),
+      maxGroups(std::max<std::size_t>(groupsInMemory, 1)),
+      depth(0) {
+  if (keyType == STRING)
+    throw BadIndexInfoException("Rows can only be grouped by numbers");
+  for (const AggregateSpec &spec : aggregates) {
+    if (spec.function == COUNT) {
+      valueTypes.push_back(INTEGER);
+    } else if (columns[spec.column].type == STRING) {
+      throw BadIndexInfoException("Only numbers can be aggregated");
+    } else {
+      valueTypes.push_back(columns[spec.column].type);
+    }
+  }
+  init();
+}
+
+HashAggregate::HashAggregate(const HashAggregate &parent, int level,
+                             const std::string &name,
+                             std::size_t groupsInMemory)
+    : columns(parent.columns),
+      groupColumn(parent.groupColumn),
+      keyType(parent.keyType),
+      aggregates(parent.aggregates),
+      valueTypes(parent.valueTypes),
+      bufMgr(parent.bufMgr),
+      spillName(name),
+      maxGroups(std::max<std::size_t>(groupsInMemory, 1)),
+      depth(level) {
+  init();
+}
+
+HashAggregate::~HashAggregate() {
+  if (!finished) {
+    try {
+      closePartitions();
+    } catch (...) {
+    }
+    removePartitions();
+  }
+}
+
+void HashAggregate::init() {
+  // at most half of the slots hold groups, so that probes are short
+  std::size_t capacity = 16;
+  hashShift = 60;
+  while (capacity < 2 * maxGroups) {
+    capacity *= 2;
+    hashShift--;
+  }
+  mask = capacity - 1;
+  const std::size_t numAggregates = aggregates.size();
+  slotKeys.assign(capacity, 0);
+  slotUsed.assign(capacity, 0);
+  states.resize((capacity + 1) * numAggregates);
+
+  initialState.resize(numAggregates);
+  for (std::size_t a = 0; a < numAggregates; a++) {
+    AggregateValue &value = initialState[a];
+    const bool isInt = valueTypes[a] == INTEGER;
+    switch (aggregates[a].function) {
+      case COUNT:
+      case SUM:
+        if (isInt)
+          value.i = 0;
+        else
+          value.d = 0;
+        break;
+      case MIN:
+        if (isInt)
+          value.i = std::numeric_limits<std::int64_t>::max();
+        else
+          value.d = std::numeric_limits<double>::infinity();
+        break;
+      case MAX:
+        if (isInt)
+          value.i = std::numeric_limits<std::int64_t>::min();
+        else
+          value.d = -std::numeric_limits<double>::infinity();
+        break;
+    }
+  }
+
+  rowKeys.resize(TupleBatch::CAPACITY);
+  rowValues.resize(TupleBatch::CAPACITY * numAggregates);
+  rowSlots.resize(TupleBatch::CAPACITY);
+  rowSize = sizeof(std::uint64_t) + numAggregates * sizeof(AggregateValue);
+  rowsPerPage = Page::BLOB_SIZE / rowSize;
+  spilledRows = 0;
+  finished = false;
+}
+
+std::size_t HashAggregate::findGroup(std::uint64_t key) {
+  std::size_t slot = hashKey(key, depth) >> hashShift;
+  while (slotUsed[slot]) {
+    if (slotKeys[slot] == key) return slot;
+    slot = (slot + 1) & mask;
+  }
+  if (groups.size() == maxGroups) return mask + 1;
+
+  slotUsed[slot] = 1;
+  slotKeys[slot] = key;
+  std::copy(initialState.begin(), initialState.end(),
+            states.begin() + slot * aggregates.size());
+  groups.push_back(slot);
+  return slot;
+}
+
+void HashAggregate::consume(const TupleBatch &batch) {
+  const std::size_t n = batch.numSelected();
+  const std::uint16_t *sel = batch.selection();
+  if (keyType == INTEGER) {
+    const int *keys = batch.intColumn(groupColumn);
+    for (std::size_t k = 0; k < n; k++) rowKeys[k] = intKey(keys[sel[k]]);
+  } else {
+    const double *keys = batch.doubleColumn(groupColumn);
+    for (std::size_t k = 0; k < n; k++) rowKeys[k] = doubleKey(keys[sel[k]]);
+  }
+  for (std::size_t a = 0; a < aggregates.size(); a++) {
+    if (aggregates[a].function == COUNT) continue;
+    AggregateValue *values = &rowValues[a * TupleBatch::CAPACITY];
+    if (valueTypes[a] == INTEGER) {
+      const int *column = batch.intColumn(aggregates[a].column);
+      for (std::size_t k = 0; k < n; k++) values[k].i = column[sel[k]];
+    } else {
+      const double *column = batch.doubleColumn(aggregates[a].column);
+      for (std::size_t k = 0; k < n; k++) values[k].d = column[sel[k]];
+    }
+  }
+  addRows(n);
+}
+
+void HashAggregate::addRows(std::size_t n) {
+  const std::size_t sink = mask + 1;
+  for (std::size_t k = 0; k < n; k++) {
+    rowSlots[k] = findGroup(rowKeys[k]);
+    if (rowSlots[k] == sink) spillRow(rowKeys[k], k);
+  }
+
+  // each aggregate is a loop over the rows, adding to the sink those of the
+  // groups spilled
+  const std::size_t numAggregates = aggregates.size();
+  for (std::size_t a = 0; a < numAggregates; a++) {
+    const AggregateValue *values = &rowValues[a * TupleBatch::CAPACITY];
+    AggregateValue *state = &states[a];
+    const bool isInt = valueTypes[a] == INTEGER;
+    switch (aggregates[a].function) {
+      case COUNT:
+        for (std::size_t k = 0; k < n; k++)
+          state[rowSlots[k] * numAggregates].i++;
+        break;
+      case SUM:
+        if (isInt) {
+          for (std::size_t k = 0; k < n; k++)
+            state[rowSlots[k] * numAggregates].i += values[k].i;
+        } else {
+          for (std::size_t k = 0; k < n; k++)
+            state[rowSlots[k] * numAggregates].d += values[k].d;
+        }
+        break;
+      case MIN:
+        if (isInt) {
+          for (std::size_t k = 0; k < n; k++) {
+            std::int64_t &v = state[rowSlots[k] * numAggregates].i;
+            v = std::min(v, values[k].i);
+          }
+        } else {
+          for (std::size_t k = 0; k < n; k++) {
+            double &v = state[rowSlots[k] * numAggregates].d;
+            v = std::min(v, values[k].d);
+          }
+        }
+        break;
+      case MAX:
+        if (isInt) {
+          for (std::size_t k = 0; k < n; k++) {
+            std::int64_t &v = state[rowSlots[k] * numAggregates].i;
+            v = std::max(v, values[k].i);
+          }
+        } else {
+          for (std::size_t k = 0; k < n; k++) {
+            double &v = state[rowSlots[k] * numAggregates].d;
+            v = std::max(v, values[k].d);
+          }
+        }
+        break;
+    }
+  }
+}
+
+void HashAggregate::spillRow(std::uint64_t key, std::size_t row) {
+  Partition &part = partitions[hashKey(key, depth) & (NUMPARTITIONS - 1)];
+  if (part.file == NULL) {
+    const std::string name = partitionName(&part - partitions);
+    try {
+      File::remove(name);
+    } catch (FileNotFoundException e) {
+    }
+    part.file = new BlobFile(name, true);
+  }
+  const std::size_t onPage = part.numRows % rowsPerPage;
+  if (onPage == 0) {
+    if (part.page != NULL) bufMgr->unPinPage(part.file, part.pageNo, true);
+    bufMgr->allocPage(part.file, part.pageNo, part.page);
+    if (part.numRows == 0) part.firstPageNo = part.pageNo;
+  }
+
+  char *out = (char *)part.page + onPage * rowSize;
+  memcpy(out, &key, sizeof(key));
+  out += sizeof(key);
+  for (std::size_t a = 0; a < aggregates.size(); a++) {
+    memcpy(out, &rowValues[a * TupleBatch::CAPACITY + row],
+           sizeof(AggregateValue));
+    out += sizeof(AggregateValue);
+  }
+  part.numRows++;
+  spilledRows++;
+}
+
+void HashAggregate::closePartitions() {
+  for (Partition &part : partitions) {
+    if (part.file == NULL) continue;
+    if (part.page != NULL) {
+      bufMgr->unPinPage(part.file, part.pageNo, true);
+      part.page = NULL;
+    }
+    bufMgr->flushFile(part.file);
+    delete part.file;
+    part.file = NULL;
+  }
+}
+
+void HashAggregate::consumePartition(const Partition &part) {
+  BlobFile file(spillName, false);
+  std::size_t n = 0;
+  PageId pageNo = part.firstPageNo;
+  for (std::size_t r = 0; r < part.numRows; pageNo++) {
+    Page *page;
+    bufMgr->readPage(&file, pageNo, page);
+    const std::size_t end = std::min(part.numRows, r + rowsPerPage);
+    const char *in = (const char *)page;
+    for (; r < end; r++) {
+      memcpy(&rowKeys[n], in, sizeof(std::uint64_t));
+      in += sizeof(std::uint64_t);
+      for (std::size_t a = 0; a < aggregates.size(); a++) {
+        memcpy(&rowValues[a * TupleBatch::CAPACITY + n], in,
+               sizeof(AggregateValue));
+        in += sizeof(AggregateValue);
+      }
+      if (++n == TupleBatch::CAPACITY) {
+        addRows(n);
+        n = 0;
+      }
+    }
+    bufMgr->unPinPage(&file, pageNo, false);
+  }
+  addRows(n);
+  bufMgr->flushFile(&file);
+}
+
+void HashAggregate::removePartitions() {
+  for (Partition &part : partitions) {
+    if (part.firstPageNo == Page::INVALID_NUMBER) continue;
+    try {
+      File::remove(partitionName(&part - partitions));
+    } catch (FileNotFoundException e) {
+    }
+    part.firstPageNo = Page::INVALID_NUMBER;
+  }
+}
+
+void HashAggregate::finish(
+    const std::function<void(const void *key, const AggregateValue *values)>
+        &fn) {
+  closePartitions();
+  finished = true;
+  for (std::size_t slot : groups) {
+    const AggregateValue *values = &states[slot * aggregates.size()];
+    if (keyType == INTEGER) {
+      const int key = (int)(std::int64_t)slotKeys[slot];
+      fn(&key, values);
+    } else {
+      double key;
+      memcpy(&key, &slotKeys[slot], sizeof(key));
+      fn(&key, values);
+    }
+  }
+
+  // the table is freed before the partitions are aggregated in tables of
+  // their own
+  std::vector<std::uint64_t>().swap(slotKeys);
+  std::vector<std::uint8_t>().swap(slotUsed);
+  std::vector<AggregateValue>().swap(states);
+  std::vector<std::size_t>().swap(groups);
+
+  try {
+    for (int p = 0; p < NUMPARTITIONS; p++) {
+      const Partition &part = partitions[p];
+      if (part.numRows == 0) continue;
+      const std::size_t partGroups =
+          depth + 1 < MAXSPILLDEPTH ? maxGroups : part.numRows;
+      HashAggregate child(*this, depth + 1, partitionName(p), partGroups);
+      child.consumePartition(part);
+      child.finish(fn);
+      spilledRows += child.spilledRows;
+    }
+  } catch (...) {
+    removePartitions();
+    throw;
+  }
+  removePartitions();
+}
+
+}
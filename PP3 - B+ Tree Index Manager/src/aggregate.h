@@ -0,0 +1,235 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "batch.h"
+#include "buffer.h"
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Aggregate functions of a HashAggregate.
+ */
+enum AggregateFunction {
+  COUNT, /* Number of rows of the group */
+  SUM,   /* Sum of the values of a column */
+  MIN,   /* Smallest value of a column */
+  MAX    /* Largest value of a column */
+};
+
+/**
+ * @brief An aggregate computed for each group: a function of a column of the
+ * batches consumed.
+ */
+struct AggregateSpec {
+  AggregateFunction function;
+
+  /**
+   * Column aggregated, INTEGER or DOUBLE; ignored by COUNT.
+   */
+  int column;
+};
+
+/**
+ * @brief Value of an aggregate of a group: i for COUNT and for the SUM, MIN and
+ * MAX of an INTEGER column, d for those of a DOUBLE column.
+ */
+union AggregateValue {
+  std::int64_t i;
+  double d;
+};
+
+/**
+ * @brief Groups the rows of batches by the value of a column and computes
+ * aggregates of each group, as GROUP BY does.
+ *
+ * The groups are kept in an open-addressing hash table whose keys, and whose
+ * aggregates, are stored in arrays, so that a probe reads a cache line or two.
+ * Once the table holds maxGroups groups, rows of the groups it holds are
+ * still aggregated in it, and the others are written to one of several
+ * partitions on pages of temporary BlobFiles through the buffer manager.  Each
+ * partition is then aggregated in turn the same way, with its own partitions
+ * if its groups do not fit either.
+ */
+class HashAggregate {
+ public:
+  /**
+   * Number of partitions rows are spilled to.
+   */
+  static const int NUMPARTITIONS = 16;
+
+  /**
+   * Creates an aggregate with no groups.
+   *
+   * @param columns     Columns of the batches consumed
+   * @param groupColumn Column the rows are grouped by, INTEGER or DOUBLE
+   * @param aggregates  Aggregates computed for each group
+   * @param bufMgr      Buffer manager the spilled rows are written through
+   * @param spillName   Prefix of the names of the files rows are spilled to
+   * @param maxGroups   Number of groups kept in memory
+   * @throws  BadIndexInfoException If a column grouped by or aggregated is
+   *                                not INTEGER or DOUBLE
+   */
+  HashAggregate(const std::vector<KeyColumn> &columns, int groupColumn,
+                const std::vector<AggregateSpec> &aggregates, BufMgr *bufMgr,
+                const std::string &spillName,
+                std::size_t maxGroups = 65536);
+
+  /**
+   * Removes the files of the partitions, if any are left.
+   */
+  ~HashAggregate();
+
+  /**
+   * Adds the rows selected in a batch to their groups.
+   *
+   * @param batch  Batch of the columns given to the constructor
+   */
+  void consume(const TupleBatch &batch);
+
+  /**
+   * Calls fn with every group and its aggregates, in no particular order, and
+   * removes the files of the partitions.  No rows are consumed afterwards.
+   *
+   * @param fn  Called with a pointer to the int or double grouped by, and the
+   *            aggregates of the group in the order given
+   */
+  void finish(const std::function<void(const void *key,
+                                       const AggregateValue *values)> &fn);
+
+  /**
+   * Returns the number of rows written to partitions, by this aggregate and
+   * those of its partitions.
+   */
+  std::size_t numSpilledRows() const { return spilledRows; }
+
+ private:
+  /**
+   * @brief The rows spilled to one partition: a file of pages written one
+   * after another, the last of them pinned while rows are added.
+   */
+  struct Partition {
+    File *file = NULL;
+    PageId firstPageNo = Page::INVALID_NUMBER;
+    PageId pageNo = Page::INVALID_NUMBER;
+    Page *page = NULL;
+    std::size_t numRows = 0;
+  };
+
+  /**
+   * Creates the aggregate of a partition of another one.
+   */
+  HashAggregate(const HashAggregate &parent, int depth,
+                const std::string &spillName, std::size_t maxGroups);
+
+  /**
+   * Sizes the table and the rows for maxGroups groups.
+   */
+  void init();
+
+  /**
+   * Returns the slot of the group of a key, adding the group if the table has
+   * room for it, or the sink slot if it does not.
+   */
+  std::size_t findGroup(std::uint64_t key);
+
+  /**
+   * Adds the first n rows of rowKeys and rowValues to their groups, and
+   * spills those of the groups that have no room.
+   */
+  void addRows(std::size_t n);
+
+  /**
+   * Writes a row to its partition.
+   */
+  void spillRow(std::uint64_t key, std::size_t row);
+
+  /**
+   * Unpins the last page of each partition and closes its file.
+   */
+  void closePartitions();
+
+  /**
+   * Reads the rows of a partition of another aggregate back from the file
+   * this aggregate is named after, and adds them to their groups.
+   */
+  void consumePartition(const Partition &part);
+
+  /**
+   * Removes the file of each partition.
+   */
+  void removePartitions();
+
+  std::string partitionName(int p) const {
+    return spillName + "." + std::to_string(p);
+  }
+
+  std::vector<KeyColumn> columns;
+  int groupColumn;
+  Datatype keyType;
+  std::vector<AggregateSpec> aggregates;
+
+  /**
+   * Type of the values of each aggregate.
+   */
+  std::vector<Datatype> valueTypes;
+
+  BufMgr *bufMgr;
+  std::string spillName;
+  std::size_t maxGroups;
+
+  /**
+   * Partitioning level: rows are hashed differently at each one.
+   */
+  int depth;
+
+  /**
+   * The table: the key of each slot, whether it holds a group, and the
+   * aggregates of the groups, those of a slot one after another.  The slot
+   * after the last one is the sink, whose aggregates the rows of spilled
+   * groups are added to and which is never read.
+   */
+  std::vector<std::uint64_t> slotKeys;
+  std::vector<std::uint8_t> slotUsed;
+  std::vector<AggregateValue> states;
+  std::vector<AggregateValue> initialState;
+  std::size_t mask;
+  int hashShift;
+
+  /**
+   * Slots holding groups, in the order they were added.
+   */
+  std::vector<std::size_t> groups;
+
+  /**
+   * Rows being added: the key of each, the value each aggregate is computed
+   * on, aggregate after aggregate, and the slot of each.
+   */
+  std::vector<std::uint64_t> rowKeys;
+  std::vector<AggregateValue> rowValues;
+  std::vector<std::size_t> rowSlots;
+
+  Partition partitions[NUMPARTITIONS];
+
+  /**
+   * Bytes of a spilled row, and rows on a page of a partition.
+   */
+  std::size_t rowSize;
+  std::size_t rowsPerPage;
+
+  std::size_t spilledRows;
+  bool finished;
+};
+
+}
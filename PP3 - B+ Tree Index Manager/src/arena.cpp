@@ -0,0 +1,74 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "arena.h"
+
+#include <algorithm>
+
+namespace badgerdb {
+
+Arena &Arena::local() {
+  thread_local Arena arena;
+  return arena;
+}
+
+Arena::Arena(std::size_t blockSize)
+    : current(0), used(0), blockSize(blockSize) {}
+
+Arena::~Arena() {
+  for (const Block &block : blocks) ::operator delete(block.data);
+}
+
+void *Arena::allocateSlow(std::size_t bytes, std::size_t align) {
+  // blocks are aligned for any type, so a fresh block needs no padding
+  const std::size_t next = blocks.empty() ? 0 : current + 1;
+  if (next >= blocks.size() || blocks[next].size < bytes) {
+    const std::size_t size = std::max(blockSize, bytes);
+    const Block block = {static_cast<char *>(::operator new(size)), size};
+    blocks.insert(blocks.begin() + next, block);
+  }
+  current = next;
+  used = bytes;
+  return blocks[current].data;
+}
+
+std::size_t Arena::reserved() const {
+  std::size_t bytes = 0;
+  for (const Block &block : blocks) bytes += block.size;
+  return bytes;
+}
+
+FreeList::~FreeList() {
+  while (head != nullptr) {
+    Node *next = head->next;
+    ::operator delete(head);
+    head = next;
+  }
+}
+
+void *FreeList::take(std::size_t bytes) {
+  if (size == 0) size = bytes;
+  if (bytes != size || head == nullptr) return ::operator new(bytes);
+  Node *node = head;
+  head = node->next;
+  held--;
+  return node;
+}
+
+void FreeList::give(void *block, std::size_t bytes) {
+  if (bytes != size || held >= limit || bytes < sizeof(Node)) {
+    ::operator delete(block);
+    return;
+  }
+  Node *node = static_cast<Node *>(block);
+  node->next = head;
+  head = node;
+  held++;
+}
+
+}  // namespace badgerdb
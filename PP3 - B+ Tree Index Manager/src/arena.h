@@ -0,0 +1,329 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * Bytes of the blocks an arena takes from the heap, unless an allocation needs
+ * a larger one
+ */
+const std::size_t ARENA_BLOCK_SIZE = 64 << 10;
+
+/**
+ * @brief Memory for the temporaries of an operation, handed out by bumping a
+ * pointer through blocks taken from the heap.
+ *
+ * Nothing is freed on its own: the memory allocated since a mark is given
+ * back all at once by rewinding to the mark, usually by a Scope.  The blocks
+ * are kept for reuse, so that an operation repeated in a steady state takes
+ * nothing from the heap.  Memory allocated by an enclosing scope while an
+ * inner scope is open is given back with the inner scope, so a container of
+ * an outer scope must not grow meanwhile.  An arena is used by one thread at
+ * a time.
+ */
+class Arena {
+ public:
+  /**
+   * @brief A point to rewind an arena to
+   */
+  struct Mark {
+    std::size_t block;
+    std::size_t used;
+  };
+
+  /**
+   * @brief Rewinds an arena, when it goes out of scope, to where it was when
+   * the scope was opened.
+   */
+  class Scope {
+   public:
+    explicit Scope(Arena &arena) : arena(arena), start(arena.mark()) {}
+    ~Scope() { arena.rewind(start); }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+   private:
+    Arena &arena;
+    const Mark start;
+  };
+
+  /**
+   * Returns the arena of the calling thread.
+   */
+  static Arena &local();
+
+  /**
+   * Creates an arena holding no block yet.
+   *
+   * @param blockSize   Bytes of the blocks taken from the heap
+   */
+  explicit Arena(std::size_t blockSize = ARENA_BLOCK_SIZE);
+
+  ~Arena();
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  /**
+   * Allocates memory, valid until the arena is rewound past it.
+   *
+   * @param bytes   Bytes wanted
+   * @param align   Alignment wanted, a power of two
+   * @return  The memory
+   */
+  void *allocate(std::size_t bytes,
+                 std::size_t align = alignof(std::max_align_t)) {
+    if (current < blocks.size()) {
+      const std::size_t start = (used + align - 1) & ~(align - 1);
+      if (start + bytes <= blocks[current].size) {
+        used = start + bytes;
+        return blocks[current].data + start;
+      }
+    }
+    return allocateSlow(bytes, align);
+  }
+
+  /**
+   * Returns the point the arena is at.
+   */
+  Mark mark() const { return Mark{current, used}; }
+
+  /**
+   * Gives back the memory allocated since the given mark.
+   *
+   * @param mark  Mark taken earlier, not rewound past since
+   */
+  void rewind(const Mark &mark) {
+    current = mark.block;
+    used = mark.used;
+  }
+
+  /**
+   * Gives back all memory allocated.
+   */
+  void reset() { rewind(Mark{0, 0}); }
+
+  /**
+   * Returns the bytes of the blocks held.
+   */
+  std::size_t reserved() const;
+
+ private:
+  /**
+   * Allocates memory from the next block, taking a new block if it is
+   * missing or too small.
+   */
+  void *allocateSlow(std::size_t bytes, std::size_t align);
+
+  struct Block {
+    char *data;
+    std::size_t size;
+  };
+
+  /**
+   * Blocks held, those up to current in use
+   */
+  std::vector<Block> blocks;
+
+  /**
+   * Block allocated from, and the bytes of it in use
+   */
+  std::size_t current;
+  std::size_t used;
+
+  const std::size_t blockSize;
+};
+
+/**
+ * @brief Allocator of standard containers taking their memory from an arena;
+ * memory a container gives back stays allocated until the arena is rewound.
+ */
+template <class T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(Arena &arena) : arena(&arena) {}
+
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *, std::size_t) {}
+
+  template <class U>
+  bool operator==(const ArenaAllocator<U> &other) const {
+    return arena == other.arena;
+  }
+
+  template <class U>
+  bool operator!=(const ArenaAllocator<U> &other) const {
+    return arena != other.arena;
+  }
+
+ private:
+  template <class U>
+  friend class ArenaAllocator;
+
+  Arena *arena;
+};
+
+/**
+ * Vector of temporaries living in an arena
+ */
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/**
+ * @brief Blocks of memory of one size given back for reuse, up to a limit,
+ * rather than to the heap.  The size is that of the first block taken.  Not
+ * latched; its owner serializes the calls.
+ */
+class FreeList {
+ public:
+  /**
+   * Creates a free list.
+   *
+   * @param limit   Number of blocks kept at most
+   */
+  explicit FreeList(std::size_t limit) : limit(limit) {}
+
+  ~FreeList();
+
+  FreeList(const FreeList &) = delete;
+  FreeList &operator=(const FreeList &) = delete;
+
+  /**
+   * Returns a block of the given size, reused if one was given back.
+   *
+   * @param bytes   Bytes of the block
+   * @return  The block
+   */
+  void *take(std::size_t bytes);
+
+  /**
+   * Gives back a block taken from this list.
+   *
+   * @param block   The block
+   * @param bytes   Bytes of the block
+   */
+  void give(void *block, std::size_t bytes);
+
+ private:
+  struct Node {
+    Node *next;
+  };
+
+  const std::size_t limit;
+  std::size_t size = 0;
+  Node *head = nullptr;
+  std::size_t held = 0;
+};
+
+/**
+ * @brief Allocator of node-based standard containers, such as maps, reusing
+ * the nodes they free through a free list.  Arrays are taken from the heap.
+ */
+template <class T>
+class PoolAllocator {
+ public:
+  typedef T value_type;
+
+  explicit PoolAllocator(FreeList &list) : list(&list) {}
+
+  template <class U>
+  PoolAllocator(const PoolAllocator<U> &other) : list(other.list) {}
+
+  T *allocate(std::size_t n) {
+    if (n == 1) return static_cast<T *>(list->take(sizeof(T)));
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, std::size_t n) {
+    if (n == 1) {
+      list->give(p, sizeof(T));
+    } else {
+      ::operator delete(p);
+    }
+  }
+
+  template <class U>
+  bool operator==(const PoolAllocator<U> &other) const {
+    return list == other.list;
+  }
+
+  template <class U>
+  bool operator!=(const PoolAllocator<U> &other) const {
+    return list != other.list;
+  }
+
+ private:
+  template <class U>
+  friend class PoolAllocator;
+
+  FreeList *list;
+};
+
+/**
+ * @brief Objects kept for reuse, such as buffers holding on to their
+ * capacity, so that taking one in a steady state allocates nothing.
+ * Thread-safe.
+ */
+template <class T>
+class ObjectPool {
+ public:
+  /**
+   * Creates a pool.
+   *
+   * @param limit   Number of objects kept at most
+   */
+  explicit ObjectPool(std::size_t limit) : limit(limit) {}
+
+  /**
+   * Returns an object given back earlier, or a new one.
+   */
+  T take() {
+    std::lock_guard<std::mutex> guard(latch);
+    if (spare.empty()) return T();
+    T object = std::move(spare.back());
+    spare.pop_back();
+    return object;
+  }
+
+  /**
+   * Gives back an object to be taken again, unless the pool is full.
+   *
+   * @param object  The object
+   */
+  void give(T &&object) {
+    std::lock_guard<std::mutex> guard(latch);
+    if (spare.size() >= limit) return;
+    if (spare.capacity() == 0) spare.reserve(limit);
+    spare.push_back(std::move(object));
+  }
+
+ private:
+  const std::size_t limit;
+  std::vector<T> spare;
+  std::mutex latch;
+};
+
+}  // namespace badgerdb
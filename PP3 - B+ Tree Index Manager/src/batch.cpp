@@ -0,0 +1,155 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "batch.h"
+#include <algorithm>
+#include <cstring>
+
+namespace badgerdb {
+
+static std::size_t valueSize(Datatype type) {
+  switch (type) {
+    case INTEGER:
+      return sizeof(int);
+    case DOUBLE:
+      return sizeof(double);
+    default:
+      return TupleBatch::STRINGWIDTH;
+  }
+}
+
+TupleBatch::TupleBatch(const std::vector<KeyColumn> &batchColumns)
+    : columns(batchColumns),
+      data(batchColumns.size()),
+      rids(CAPACITY),
+      sel(CAPACITY),
+      rows(0),
+      selected(0),
+      keep(CAPACITY),
+      order(CAPACITY) {
+  for (std::size_t c = 0; c < columns.size(); c++)
+    data[c].resize(CAPACITY * valueSize(columns[c].type));
+}
+
+void TupleBatch::clear() {
+  rows = 0;
+  selected = 0;
+}
+
+// copies an attribute of fixed size out of each record, and marks the
+// records too short to hold it
+template <class V>
+static void gatherColumn(const RecordView *records, std::size_t n,
+                         std::size_t offset, V *out, std::uint8_t *fits) {
+  for (std::size_t k = 0; k < n; k++) {
+    if (records[k].length >= offset + sizeof(V)) {
+      memcpy(&out[k], records[k].data + offset, sizeof(V));
+    } else {
+      out[k] = V();
+      fits[k] = 0;
+    }
+  }
+}
+
+void TupleBatch::append(const RecordId *recordIds, const RecordView *records,
+                        std::size_t n) {
+  std::fill(keep.begin(), keep.begin() + n, 1);
+  for (std::size_t c = 0; c < columns.size(); c++) {
+    const std::size_t offset = columns[c].byteOffset;
+    switch (columns[c].type) {
+      case INTEGER:
+        gatherColumn(records, n, offset, (int *)data[c].data() + rows,
+                     keep.data());
+        break;
+      case DOUBLE:
+        gatherColumn(records, n, offset, (double *)data[c].data() + rows,
+                     keep.data());
+        break;
+      case STRING: {
+        // strings may end before the width, and the record with them
+        char *out = data[c].data() + rows * STRINGWIDTH;
+        for (std::size_t k = 0; k < n; k++, out += STRINGWIDTH) {
+          const std::size_t length =
+              records[k].length > offset
+                  ? std::min<std::size_t>(records[k].length - offset,
+                                          STRINGWIDTH)
+                  : 0;
+          memcpy(out, records[k].data + offset, length);
+          memset(out + length, 0, STRINGWIDTH - length);
+          keep[k] &= length > 0;
+        }
+        break;
+      }
+    }
+  }
+  std::copy(recordIds, recordIds + n, rids.begin() + rows);
+  for (std::size_t k = 0; k < n; k++) {
+    sel[selected] = rows + k;
+    selected += keep[k];
+  }
+  rows += n;
+}
+
+void TupleBatch::filter(int column, Operator op, const void *value) {
+  // every row is compared, selected or not, so that the comparisons run over
+  // whole arrays; the selection is then narrowed to the rows kept
+  std::fill(keep.begin(), keep.begin() + rows, 1);
+  switch (columns[column].type) {
+    case INTEGER:
+      compareValues(intColumn(column), rows, op, *(const int *)value,
+                    keep.data());
+      break;
+    case DOUBLE:
+      compareValues(doubleColumn(column), rows, op, *(const double *)value,
+                    keep.data());
+      break;
+    case STRING: {
+      const char *constant = (const char *)value;
+      const std::size_t length =
+          std::min<std::size_t>(strlen(constant), STRINGWIDTH);
+      const char *strings = stringColumn(column);
+      for (std::size_t k = 0; k < rows; k++) {
+        const int c = memcmp(strings + k * STRINGWIDTH, constant, length);
+        order[k] = (c > 0) - (c < 0);
+      }
+      compareValues(order.data(), rows, op, 0, keep.data());
+      break;
+    }
+  }
+
+  std::size_t kept = 0;
+  for (std::size_t k = 0; k < selected; k++) {
+    const std::uint16_t row = sel[k];
+    sel[kept] = row;
+    kept += keep[row];
+  }
+  selected = kept;
+}
+
+std::int64_t TupleBatch::sumInt(int column) const {
+  const int *values = intColumn(column);
+  std::int64_t sum = 0;
+  if (selected == rows) {
+    for (std::size_t k = 0; k < rows; k++) sum += values[k];
+  } else {
+    for (std::size_t k = 0; k < selected; k++) sum += values[sel[k]];
+  }
+  return sum;
+}
+
+double TupleBatch::sumDouble(int column) const {
+  const double *values = doubleColumn(column);
+  double sum = 0;
+  if (selected == rows) {
+    for (std::size_t k = 0; k < rows; k++) sum += values[k];
+  } else {
+    for (std::size_t k = 0; k < selected; k++) sum += values[sel[k]];
+  }
+  return sum;
+}
+
+}
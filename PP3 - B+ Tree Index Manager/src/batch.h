@@ -0,0 +1,203 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "types.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * Keeps the values which compare with the constant as the operator says, by
+ * clearing keep[k] for the others.  The loops have no branches, so that they
+ * run over the values as vectors.
+ */
+template <class V>
+inline void compareValues(const V *values, std::size_t n, Operator op,
+                          V constant, std::uint8_t *keep) {
+  switch (op) {
+    case LT:
+      for (std::size_t k = 0; k < n; k++) keep[k] &= values[k] < constant;
+      break;
+    case LTE:
+      for (std::size_t k = 0; k < n; k++) keep[k] &= values[k] <= constant;
+      break;
+    case GTE:
+      for (std::size_t k = 0; k < n; k++) keep[k] &= values[k] >= constant;
+      break;
+    case GT:
+      for (std::size_t k = 0; k < n; k++) keep[k] &= values[k] > constant;
+      break;
+    case EQ:
+      for (std::size_t k = 0; k < n; k++) keep[k] &= values[k] == constant;
+      break;
+    case NE:
+      for (std::size_t k = 0; k < n; k++) keep[k] &= values[k] != constant;
+      break;
+  }
+}
+
+/**
+ * @brief A batch of up to CAPACITY records, held as an array of values for
+ * each of a few of their attributes, and a selection vector of the rows which
+ * are still in the batch.
+ *
+ * Operators pass records to each other a batch at a time: a FileScan or a
+ * HeapFetch copies the attributes out of the pinned pages once, and filters
+ * and aggregates then run as loops over the arrays rather than as a call per
+ * record.  A filter drops rows from the selection without moving any values.
+ */
+class TupleBatch {
+ public:
+  /**
+   * Number of rows a batch holds.
+   */
+  static const std::size_t CAPACITY = 1024;
+
+  /**
+   * Bytes of a string attribute held in a row; longer strings are cut, and
+   * shorter ones padded with zero bytes.
+   */
+  static const int STRINGWIDTH = 64;
+
+  /**
+   * Creates an empty batch of the given attributes of records.
+   *
+   * @param columns  Attributes held, as column 0, 1, ...
+   */
+  explicit TupleBatch(const std::vector<KeyColumn> &columns);
+
+  /**
+   * Empties the batch.
+   */
+  void clear();
+
+  /**
+   * Adds a record as the next row, selected.  A record too short to hold
+   * all of the attributes is added but not selected.
+   *
+   * @param rid     Record id of the record
+   * @param record  The record, which the attributes are copied out of
+   */
+  void append(const RecordId &rid, const RecordView &record) {
+    append(&rid, &record, 1);
+  }
+
+  /**
+   * Adds records as the next rows, as append() does one.  The attributes are
+   * copied a column at a time, so that each copy is a loop over the records.
+   *
+   * @param rids     Record ids of the records
+   * @param records  The records
+   * @param n        Number of records, at most the rows left in the batch
+   */
+  void append(const RecordId *rids, const RecordView *records, std::size_t n);
+
+  /**
+   * Returns true if no more rows can be added.
+   */
+  bool full() const { return rows == CAPACITY; }
+
+  /**
+   * Returns the number of rows added since the batch was last cleared.
+   */
+  std::size_t numRows() const { return rows; }
+
+  /**
+   * Returns the number of rows selected.
+   */
+  std::size_t numSelected() const { return selected; }
+
+  /**
+   * Returns the rows selected, in ascending order.
+   */
+  const std::uint16_t *selection() const { return sel.data(); }
+
+  /**
+   * Returns the attributes held.
+   */
+  const std::vector<KeyColumn> &getColumns() const { return columns; }
+
+  /**
+   * Returns the record ids of the rows.
+   */
+  const RecordId *recordIds() const { return rids.data(); }
+
+  /**
+   * Returns the values of an INTEGER column, one per row.
+   */
+  const int *intColumn(int column) const {
+    return (const int *)data[column].data();
+  }
+
+  /**
+   * Returns the values of a DOUBLE column, one per row.
+   */
+  const double *doubleColumn(int column) const {
+    return (const double *)data[column].data();
+  }
+
+  /**
+   * Returns the values of a STRING column, STRINGWIDTH bytes per row.
+   */
+  const char *stringColumn(int column) const { return data[column].data(); }
+
+  /**
+   * Drops the rows whose value of a column does not compare with a constant
+   * as the operator says from the selection.  A string is compared on as
+   * many bytes as the constant has, as in a ScanPredicate.
+   *
+   * @param column  Column compared
+   * @param op      Comparison of the values with the constant
+   * @param value   The constant: an int, a double, or a string ended by a
+   *                zero byte
+   */
+  void filter(int column, Operator op, const void *value);
+
+  /**
+   * Returns the sum of the values of an INTEGER column over the rows
+   * selected.
+   */
+  std::int64_t sumInt(int column) const;
+
+  /**
+   * Returns the sum of the values of a DOUBLE column over the rows selected.
+   */
+  double sumDouble(int column) const;
+
+ private:
+  std::vector<KeyColumn> columns;
+
+  /**
+   * Values of each column, CAPACITY of them.
+   */
+  std::vector<std::vector<char>> data;
+
+  std::vector<RecordId> rids;
+
+  /**
+   * Selection vector: the first selected entries are the rows selected.
+   */
+  std::vector<std::uint16_t> sel;
+
+  std::size_t rows;
+  std::size_t selected;
+
+  /**
+   * Result of the comparison of each row while filtering, or whether it
+   * holds all of the attributes while appending, and the order of strings
+   * with the constant.
+   */
+  std::vector<std::uint8_t> keep;
+  std::vector<int> order;
+};
+
+}
@@ -0,0 +1,589 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+// Benchmark of an INTEGER index: builds it over a relation of the given size
+// and key distribution, then times point lookups, range scans and a full scan,
+// and writes the timings and the I/O of each phase as one JSON object, along
+// with the heap allocations made by the steady-state loops, which are none.
+//
+//   PP3_bench --records 1000000 --distribution zipfian --frames 5000
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "btree.h"
+#include "buffer.h"
+#include "exceptions/badgerdb_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "file.h"
+#include "filescan.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+// Allocations made through operator new by each thread, counted so that the
+// steady-state loops can be checked to make none.  Every form of new and
+// delete is replaced, and all of them go through allocateBlock() and
+// freeBlock(), kept out of line so that the compiler sees each new paired
+// with a delete rather than with malloc() and free().
+thread_local std::uint64_t threadAllocations = 0;
+
+__attribute__((noinline)) static void *allocateBlock(std::size_t size) {
+  threadAllocations++;
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+__attribute__((noinline)) static void freeBlock(void *block) {
+  std::free(block);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return allocateBlock(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return allocateBlock(size);
+}
+
+void *operator new(std::size_t size) {
+  void *block = allocateBlock(size);
+  if (block == NULL) throw std::bad_alloc();
+  return block;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *block) noexcept { freeBlock(block); }
+
+void operator delete[](void *block) noexcept { freeBlock(block); }
+
+void operator delete(void *block, std::size_t) noexcept { freeBlock(block); }
+
+void operator delete[](void *block, std::size_t) noexcept {
+  freeBlock(block);
+}
+
+void operator delete(void *block, const std::nothrow_t &) noexcept {
+  freeBlock(block);
+}
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept {
+  freeBlock(block);
+}
+
+namespace {
+
+// Records of the relation, laid out as those of the tests of main.cpp
+struct Record {
+  int i;
+  double d;
+  char s[64];
+};
+
+const std::string relationName = "bench.rel";
+
+enum Distribution { SEQUENTIAL, REVERSE, UNIFORM, ZIPFIAN };
+
+const char *const distributionNames[] = {"sequential", "reverse", "uniform",
+                                         "zipfian"};
+
+struct Options {
+  int records = 1000000;
+  Distribution distribution = UNIFORM;
+  double theta = 0.99;
+  std::uint32_t frames = 10000;
+  int threads = 1;
+  BuildMethod build = BULK_BUILD;
+  double fillFactor = DEFAULT_FILL_FACTOR;
+  long lookups = 100000;
+  long ranges = 10000;
+  int rangeLength = 100;
+  std::uint32_t seed = 1;
+  std::string output;
+};
+
+void usage(const char *program) {
+  std::cerr
+      << "usage: " << program << " [options]\n"
+      << "  --records N          records in the relation (1000000)\n"
+      << "  --distribution D     sequential, reverse, uniform or zipfian\n"
+      << "                       keys (uniform)\n"
+      << "  --theta T            skew of zipfian keys, from 0 to 1 (0.99)\n"
+      << "  --frames N           frames in the buffer pool (10000)\n"
+      << "  --threads N          threads building, looking up and scanning;\n"
+      << "                       more than one makes the pool and index\n"
+      << "                       concurrent (1)\n"
+      << "  --build B            bulk or insert (bulk)\n"
+      << "  --fill-factor F      fill of the nodes of a bulk build ("
+      << DEFAULT_FILL_FACTOR << ")\n"
+      << "  --lookups N          point lookups (100000)\n"
+      << "  --ranges N           range scans (10000)\n"
+      << "  --range-length N     width of the key range of a scan (100)\n"
+      << "  --seed N             seed of the keys (1)\n"
+      << "  --output FILE        file the results are written to (stdout)\n";
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string name = argv[i];
+    if (i + 1 == argc) return false;
+    const std::string value = argv[++i];
+    if (name == "--records") {
+      options.records = std::atoi(value.c_str());
+    } else if (name == "--distribution") {
+      const char *const *end = distributionNames + 4;
+      const char *const *found = std::find_if(
+          distributionNames, end,
+          [&](const char *known) { return value == known; });
+      if (found == end) return false;
+      options.distribution = (Distribution)(found - distributionNames);
+    } else if (name == "--theta") {
+      options.theta = std::atof(value.c_str());
+    } else if (name == "--frames") {
+      options.frames = std::strtoul(value.c_str(), NULL, 10);
+    } else if (name == "--threads") {
+      options.threads = std::atoi(value.c_str());
+    } else if (name == "--build") {
+      if (value != "bulk" && value != "insert") return false;
+      options.build = value == "bulk" ? BULK_BUILD : INSERT_BUILD;
+    } else if (name == "--fill-factor") {
+      options.fillFactor = std::atof(value.c_str());
+    } else if (name == "--lookups") {
+      options.lookups = std::atol(value.c_str());
+    } else if (name == "--ranges") {
+      options.ranges = std::atol(value.c_str());
+    } else if (name == "--range-length") {
+      options.rangeLength = std::atoi(value.c_str());
+    } else if (name == "--seed") {
+      options.seed = std::strtoul(value.c_str(), NULL, 10);
+    } else if (name == "--output") {
+      options.output = value;
+    } else {
+      return false;
+    }
+  }
+  return options.records > 0 && options.frames > 0 && options.threads > 0 &&
+         options.theta > 0 && options.theta < 1 && options.lookups >= 0 &&
+         options.ranges >= 0 && options.rangeLength > 0;
+}
+
+// Ranks drawn from a Zipfian distribution over [0, n), rank 0 the most
+// frequent, by the method of Gray et al., "Quickly generating billion-record
+// synthetic databases", SIGMOD 1994.
+class ZipfGenerator {
+ public:
+  ZipfGenerator(std::uint64_t n, double theta)
+      : n(n), theta(theta), zetan(zeta(n, theta)) {
+    alpha = 1 / (1 - theta);
+    eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta(2, theta) / zetan);
+  }
+
+  template <class Random>
+  std::uint64_t next(Random &random) const {
+    const double u = std::uniform_real_distribution<double>(0, 1)(random);
+    const double uz = u * zetan;
+    if (uz < 1) return 0;
+    if (uz < 1 + std::pow(0.5, theta)) return 1;
+    const double rank = n * std::pow(eta * u - eta + 1, alpha);
+    return std::min<std::uint64_t>(n - 1, (std::uint64_t)rank);
+  }
+
+ private:
+  static double zeta(std::uint64_t n, double theta) {
+    double sum = 0;
+    for (std::uint64_t i = 1; i <= n; i++) sum += 1 / std::pow(i, theta);
+    return sum;
+  }
+
+  std::uint64_t n;
+  double theta;
+  double zetan;
+  double alpha;
+  double eta;
+};
+
+// Keys of the records and of the queries. Records are numbered in the order
+// they are written: sequential and reverse keys are the numbers up or down,
+// uniform ones are drawn from [0, records) and may repeat, and zipfian ones
+// are ranks scattered over [0, records) by a random permutation, so that the
+// frequent keys do not share a leaf. Queries look for keys drawn uniformly
+// from [0, records), or for zipfian relations as skewed as the records.
+class KeyGenerator {
+ public:
+  explicit KeyGenerator(const Options &options)
+      : options(options), zipf(options.records, options.theta) {
+    if (options.distribution != ZIPFIAN) return;
+    scatter.resize(options.records);
+    for (int i = 0; i < options.records; i++) scatter[i] = i;
+    std::mt19937_64 random(options.seed);
+    std::shuffle(scatter.begin(), scatter.end(), random);
+  }
+
+  template <class Random>
+  int recordKey(int i, Random &random) const {
+    switch (options.distribution) {
+      case SEQUENTIAL:
+        return i;
+      case REVERSE:
+        return options.records - 1 - i;
+      case UNIFORM:
+        return queryKey(random);
+      case ZIPFIAN:
+        break;
+    }
+    return scatter[zipf.next(random)];
+  }
+
+  template <class Random>
+  int queryKey(Random &random) const {
+    if (options.distribution == ZIPFIAN) return scatter[zipf.next(random)];
+    return std::uniform_int_distribution<int>(0, options.records - 1)(random);
+  }
+
+ private:
+  const Options &options;
+  ZipfGenerator zipf;
+  std::vector<int> scatter;
+};
+
+void removeFile(const std::string &name) {
+  try {
+    File::remove(name);
+  } catch (FileNotFoundException e) {
+  }
+}
+
+void createRelation(const Options &options, const KeyGenerator &keys) {
+  removeFile(relationName);
+  PageFile file(relationName, true);
+  std::mt19937_64 random(options.seed);
+
+  Record record;
+  memset(record.s, ' ', sizeof(record.s));
+  PageId pageNo;
+  Page page = file.allocatePage(pageNo);
+  for (int i = 0; i < options.records; i++) {
+    record.i = keys.recordKey(i, random);
+    record.d = record.i;
+    snprintf(record.s, sizeof(record.s), "%09d string record", record.i);
+    const std::string data(reinterpret_cast<char *>(&record), sizeof(record));
+    while (true) {
+      try {
+        page.insertRecord(data);
+        break;
+      } catch (InsufficientSpaceException e) {
+        file.writePage(pageNo, page);
+        page = file.allocatePage(pageNo);
+      }
+    }
+  }
+  file.writePage(pageNo, page);
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+std::uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Runs work(thread, histogram) on each thread and returns the merged
+// histograms of the latencies they recorded.
+template <class Work>
+Histogram runThreads(int numThreads, Work work) {
+  std::vector<Histogram> histograms(numThreads);
+  std::vector<std::thread> threads;
+  for (int t = 1; t < numThreads; t++) {
+    threads.emplace_back([&, t] { work(t, histograms[t]); });
+  }
+  work(0, histograms[0]);
+  for (std::thread &thread : threads) thread.join();
+  Histogram merged;
+  for (const Histogram &histogram : histograms) merged.add(histogram);
+  return merged;
+}
+
+// Share of n operations of one of the threads
+long share(long n, int numThreads, int thread) {
+  return n / numThreads + (thread < n % numThreads ? 1 : 0);
+}
+
+void writeIo(std::ostream &out, const BufStats &stats) {
+  out << "\"io\": {\"accesses\": " << stats.accesses
+      << ", \"hits\": " << stats.hits
+      << ", \"disk_reads\": " << stats.diskreads
+      << ", \"disk_writes\": " << stats.diskwrites
+      << ", \"clean_evictions\": " << stats.cleanEvictions
+      << ", \"dirty_evictions\": " << stats.dirtyEvictions << "}";
+}
+
+void writeLatency(std::ostream &out, const Histogram &latency) {
+  out << "\"latency_ns\": {\"mean\": " << latency.mean()
+      << ", \"p50\": " << latency.percentile(0.5)
+      << ", \"p90\": " << latency.percentile(0.9)
+      << ", \"p99\": " << latency.percentile(0.99)
+      << ", \"p99_9\": " << latency.percentile(0.999)
+      << ", \"max\": " << latency.max << "}";
+}
+
+// Runs each steady-state loop once to warm it up, then again counting the
+// allocations of this thread, and writes the counts. The deferred writes of
+// a loop are written out before it is counted.
+void writeAllocations(std::ostream &out, const Options &options,
+                      BTreeIndex *index, BufMgr *pool) {
+  const char *separator = "";
+  auto counted = [&](const char *loop, long operations,
+                     const std::function<void()> &fn) {
+    fn();
+    File::syncAll();
+    const std::uint64_t before = threadAllocations;
+    fn();
+    out << separator << "\"" << loop << "\": {\"operations\": " << operations
+        << ", \"allocations\": " << threadAllocations - before << "}";
+    separator = ", ";
+  };
+  out << " \"allocations\": {";
+
+  {
+    FileScan scan(relationName, pool);
+    RecordId rid;
+    const int records = std::max(options.records / 2, 1);
+    counted("file_scan_records", records / 2, [&] {
+      for (int k = 0; k < records / 2; k++) {
+        scan.scanNext(rid);
+        scan.getRecordView();
+      }
+    });
+  }
+
+  const int loops = 1000;
+  counted("point_lookups", loops, [&] {
+    RecordId rids[16];
+    for (int k = 0; k < loops; k++) {
+      const int key = k * 7919 % options.records;
+      index->lookup(&key, rids, 16);
+    }
+  });
+  counted("cursor_scans", loops, [&] {
+    RecordId rids[64];
+    for (int k = 0; k < loops; k++) {
+      const int low = k * 7919 % options.records;
+      const int high = low + options.rangeLength;
+      try {
+        IndexScanCursor cursor = index->openScan(&low, GTE, &high, LT);
+        while (cursor.scanNextBatch(rids, 64) > 0) {
+        }
+      } catch (const NoSuchKeyFoundException &e) {
+      }
+    }
+  });
+
+  std::vector<RecordId> fetched(100);
+  {
+    const int low = INT_MIN, high = INT_MAX;
+    IndexScanCursor cursor = index->openScan(&low, GTE, &high, LTE);
+    fetched.resize(cursor.scanNextBatch(fetched.data(), fetched.size()));
+  }
+  HeapFetch fetch(relationName, pool);
+  std::size_t bytes = 0;
+  counted("heap_fetches", loops, [&] {
+    for (int k = 0; k < loops; k++) {
+      fetch.fetch(fetched,
+                  [&](const RecordId &, const RecordView &record) {
+                    bytes += record.length;
+                  },
+                  GIVEN_ORDER);
+    }
+  });
+
+  int nextKey = options.records;
+  counted("inserts", 5 * loops, [&] {
+    for (int k = 0; k < 5 * loops; k++, nextKey++) {
+      const RecordId rid = {1, 1};
+      index->insertEntry(&nextKey, rid);
+    }
+  });
+  out << "},\n";
+}
+
+void run(const Options &options, std::ostream &out) {
+  const KeyGenerator keys(options);
+  createRelation(options, keys);
+  std::string indexName =
+      relationName + "," + std::to_string(offsetof(Record, i));
+  removeFile(indexName);
+
+  const bool concurrent = options.threads > 1;
+  BufMgr *pool = new BufMgr(options.frames, concurrent);
+  out << "{\"parameters\": {\"records\": " << options.records
+      << ", \"distribution\": \""
+      << distributionNames[options.distribution] << "\""
+      << ", \"theta\": " << options.theta
+      << ", \"frames\": " << options.frames
+      << ", \"threads\": " << options.threads
+      << ", \"build\": \""
+      << (options.build == BULK_BUILD ? "bulk" : "insert") << "\""
+      << ", \"fill_factor\": " << options.fillFactor
+      << ", \"page_size\": " << Page::SIZE
+      << ", \"seed\": " << options.seed << "},\n";
+
+  // build, with the relation read through the pool
+  pool->clearBufStats();
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  BTreeIndex *index = new BTreeIndex(
+      relationName, indexName, pool, offsetof(Record, i), INTEGER,
+      options.build, options.fillFactor, concurrent,
+      std::vector<CoveredColumn>(),
+      options.build == BULK_BUILD ? options.threads : 1);
+  double seconds = secondsSince(start);
+  out << " \"build\": {\"seconds\": " << seconds
+      << ", \"entries_per_second\": " << options.records / seconds << ", ";
+  writeIo(out, pool->getBufStats());
+  out << "},\n";
+
+  // point lookups
+  index->clearCounters();
+  pool->clearBufStats();
+  std::vector<std::size_t> found(options.threads);
+  start = std::chrono::steady_clock::now();
+  Histogram latency =
+      runThreads(options.threads, [&](int t, Histogram &histogram) {
+        std::mt19937_64 random(options.seed * 1000003 + t);
+        RecordId rids[16];
+        for (long n = share(options.lookups, options.threads, t); n > 0;
+             n--) {
+          const int key = keys.queryKey(random);
+          const std::chrono::steady_clock::time_point began =
+              std::chrono::steady_clock::now();
+          found[t] += index->lookup(&key, rids, 16);
+          histogram.record(nanosSince(began));
+        }
+      });
+  seconds = secondsSince(start);
+  std::size_t entries = 0;
+  for (std::size_t n : found) entries += n;
+  out << " \"point_lookups\": {\"operations\": " << options.lookups
+      << ", \"entries\": " << entries
+      << ", \"per_second\": " << options.lookups / seconds
+      << ", \"pages_per_operation\": "
+      << index->getCounters().pagesPerOperation() << ", ";
+  writeLatency(out, latency);
+  out << ", ";
+  writeIo(out, pool->getBufStats());
+  out << "},\n";
+
+  // range scans of rangeLength keys from keys drawn as the lookups are
+  pool->clearBufStats();
+  std::fill(found.begin(), found.end(), 0);
+  start = std::chrono::steady_clock::now();
+  latency = runThreads(options.threads, [&](int t, Histogram &histogram) {
+    std::mt19937_64 random(options.seed * 1000033 + t);
+    RecordId rids[256];
+    for (long n = share(options.ranges, options.threads, t); n > 0; n--) {
+      const int low = keys.queryKey(random);
+      const int high = low + options.rangeLength;
+      const std::chrono::steady_clock::time_point began =
+          std::chrono::steady_clock::now();
+      try {
+        IndexScanCursor cursor = index->openScan(&low, GTE, &high, LT);
+        std::size_t fetched;
+        while ((fetched = cursor.scanNextBatch(rids, 256)) > 0) {
+          found[t] += fetched;
+        }
+        cursor.endScan();
+      } catch (NoSuchKeyFoundException e) {
+      }
+      histogram.record(nanosSince(began));
+    }
+  });
+  seconds = secondsSince(start);
+  entries = 0;
+  for (std::size_t n : found) entries += n;
+  out << " \"range_scans\": {\"operations\": " << options.ranges
+      << ", \"range_length\": " << options.rangeLength
+      << ", \"entries\": " << entries
+      << ", \"per_second\": " << options.ranges / seconds << ", ";
+  writeLatency(out, latency);
+  out << ", ";
+  writeIo(out, pool->getBufStats());
+  out << "},\n";
+
+  // one full scan, on a single thread
+  pool->clearBufStats();
+  entries = 0;
+  start = std::chrono::steady_clock::now();
+  {
+    const int low = INT_MIN;
+    const int high = INT_MAX;
+    RecordId rids[256];
+    IndexScanCursor cursor = index->openScan(&low, GTE, &high, LTE);
+    std::size_t fetched;
+    while ((fetched = cursor.scanNextBatch(rids, 256)) > 0) entries += fetched;
+    cursor.endScan();
+  }
+  seconds = secondsSince(start);
+  out << " \"full_scan\": {\"seconds\": " << seconds
+      << ", \"entries\": " << entries
+      << ", \"entries_per_second\": " << entries / seconds << ", ";
+  writeIo(out, pool->getBufStats());
+  out << "},\n";
+
+  const IndexAnalysis analysis = index->analyze();
+  writeAllocations(out, options, index, pool);
+  out << " \"index\": {\"height\": " << analysis.height
+      << ", \"leaves\": " << analysis.levels.back().numNodes
+      << ", \"leaf_fill\": " << analysis.levels.back().fillFactor
+      << ", \"fragmentation\": " << analysis.fragmentation << "}}\n";
+
+  delete index;
+  delete pool;
+  removeFile(indexName);
+  removeFile(relationName);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+  try {
+    if (options.output.empty()) {
+      run(options, std::cout);
+    } else {
+      std::ofstream out(options.output);
+      run(options, out);
+    }
+  } catch (const BadgerDbException &e) {
+    std::cerr << e.message() << std::endl;
+    return 1;
+  }
+  return 0;
+}
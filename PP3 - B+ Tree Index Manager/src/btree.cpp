@@ -8,6 +8,15 @@
 
 #include "btree.h"
 #include <algorithm>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <new>
+#include <queue>
+#include <thread>
+#if defined(__x86_64__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
@@ -17,6 +26,7 @@
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "filescan.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -31,16 +41,41 @@ namespace badgerdb {
 // ##################################################################### //
 
 /**
- * Alloca a page in the buffer for an internal node
+ * Rebuild the directory of an internal node after its keys changed. Only
+ * nodes with INTEGER keys have one.
+ *
+ * @param node an internal node
+ */
+template <class T>
+static void indexNonLeaf(NonLeafNode<T> *node) {}
+
+static void indexNonLeaf(NonLeafNode<int> *node) {
+  indexIntKeys(node->keyArray, node->numKeys, node->blockKeys,
+               node->lineKeys);
+}
+
+/**
+ * Alloca a page in the buffer for an internal node. A page freed by a merge is
+ * reused if there is one.
  *
  * @param newPageId the page number for the new node
  * @return a pointer to the new internal node
  */
-NonLeafNodeInt *BTreeIndex::allocNonLeafNode(PageId &newPageId) {
-  NonLeafNodeInt *newNode;
-  bufMgr->allocPage(file, newPageId, (Page *&)newNode);
-  memset(newNode, 0, Page::SIZE);
-  return newNode;
+template <class T>
+NonLeafNode<T> *BTreeIndex::allocNonLeafNode(PageId &newPageId) {
+  Page *page;
+  std::unique_lock<std::mutex> lock = latchMeta();
+  if (indexMetaInfo.freePageNo != 0) {
+    newPageId = indexMetaInfo.freePageNo;
+    pinPage(newPageId, page);
+    indexMetaInfo.freePageNo = ((FreeNode *)page)->nextFreePageNo;
+    writeMetaInfo();
+  } else {
+    if (lock.owns_lock()) lock.unlock();
+    pinNewPage(newPageId, page);
+  }
+  memset(reinterpret_cast<char *>(page), 0, Page::SIZE);
+  return (NonLeafNode<T> *)page;
 }
 
 /**
@@ -49,603 +84,4603 @@ NonLeafNodeInt *BTreeIndex::allocNonLeafNode(PageId &newPageId) {
  * @param newPageId the page number for the new node
  * @return a pointer to the new leaf node
  */
-LeafNodeInt *BTreeIndex::allocLeafNode(PageId &newPageId) {
-  LeafNodeInt *newNode = (LeafNodeInt *)allocNonLeafNode(newPageId);
+template <class T>
+LeafNode<T> *BTreeIndex::allocLeafNode(PageId &newPageId) {
+  LeafNode<T> *newNode = (LeafNode<T> *)allocNonLeafNode<T>(newPageId);
   newNode->level = -1;
   return newNode;
 }
 
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
-// #########################   Constructor   ########################### //
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
-
 /**
- * Constructor
- *
- * The constructor first checks if the specified index ﬁle exists.
- * And index ﬁle name is constructed by concatenating the relational name with
- * the offset of the attribute over which the index is built.
+ * Alloc a page in the buffer for a page of a posting list
  *
- * If the index ﬁle exists, the ﬁle is opened. Else, a new index ﬁle is created.
+ * @param newPageId the page number for the new page
+ * @return a pointer to the new posting list page
+ */
+PostingPage *BTreeIndex::allocPostingPage(PageId &newPageId) {
+  Page *page = (Page *)allocNonLeafNode<int>(newPageId);
+  return new (page) PostingPage();
+}
+
+/**
+ * Put the given node page on the free list of the index file.
  *
- * @param relationName The name of the relation on which to build the index.
- * @param outIndexName The name of the index file.
- * @param bufMgrIn The instance of the global buffer manager.
- * @param attrByteOffset The byte offset of the attribute in the tuple on which
- * to build the index.
- * @param attrType The data type of the attribute we are indexing.
+ * @param pageNo the page number of the node
+ * @param page the node page, pinned; it is unpinned here
  */
-BTreeIndex::BTreeIndex(const string &relationName, string &outIndexName,
-                       BufMgr *bufMgrIn, const int attrByteOffset_,
-                       const Datatype attrType) {
-  bufMgr = bufMgrIn;
-  attrByteOffset = attrByteOffset_;
-  attributeType = attrType;
+void BTreeIndex::freeNode(PageId pageNo, Page *page) {
+  // a node kept pinned holds the pin of the index besides that of the caller
+  if (!pinnedNodes.empty()) {
+    auto pinned = pinnedNodes.find(pageNo);
+    if (pinned != pinnedNodes.end()) {
+      unswizzleChildren(pinned->second);
+      pinnedNodes.erase(pinned);
+      bufMgr->unPinPage(file, pageNo, false);
+    }
+  }
 
-  ostringstream idx_str{};
-  idx_str << relationName << ',' << attrByteOffset;
-  outIndexName = idx_str.str();
+  std::unique_lock<std::mutex> lock = latchMeta();
+  memset(reinterpret_cast<char *>(page), 0, Page::SIZE);
+  FreeNode *node = new (page) FreeNode();
+  node->nextFreePageNo = indexMetaInfo.freePageNo;
+  bufMgr->unPinPage(file, pageNo, true);
 
-  relationName.copy(indexMetaInfo.relationName, 20, 0);
-  indexMetaInfo.attrByteOffset = attrByteOffset;
-  indexMetaInfo.attrType = attrType;
+  indexMetaInfo.freePageNo = pageNo;
+  writeMetaInfo();
+}
 
-  file = new BlobFile(outIndexName, true);
+/**
+ * Read a node on the way down from the root, through its slot in its parent
+ * if that is set, or else from the nodes kept pinned if it is one of them.
+ *
+ * @param pageNo the page number of the node
+ * @param page set to the node page
+ * @param depth the number of levels above the node
+ * @param slot the slot of the node in its parent, or NULL
+ * @param site where the node is pinned, for pin tracking
+ * @return the node as kept pinned, or NULL if it is not
+ */
+BTreeIndex::PinnedNode *BTreeIndex::readNode(PageId pageNo, Page *&page,
+                                             int depth, Page **slot,
+                                             const PinSite &site) {
+  if (slot != NULL && *slot != NULL) {
+    page = *slot;
+    count(PAGES_PINNED);
+    bufMgr->pinSwizzled(page, site);
+    if (numSnapshots.load(std::memory_order_relaxed) > 0)
+      savePageVersion(pageNo, page);
+    return NULL;
+  }
+  if (depth < PINNED_LEVELS && !pinnedNodes.empty()) {
+    auto pinned = pinnedNodes.find(pageNo);
+    if (pinned != pinnedNodes.end()) {
+      page = pinned->second.page;
+      return &pinned->second;
+    }
+  }
 
-  allocLeafNode(indexMetaInfo.rootPageNo);
-  bufMgr->unPinPage(file, indexMetaInfo.rootPageNo, true);
+  // the pin taken here becomes that of the index; a checkpoint only writes
+  // pages nobody pins, so none are kept if the changes are logged
+  pinPage(pageNo, page, NORMAL_ACCESS, site);
+  if (depth < PINNED_LEVELS && !concurrent && !parallelBuild &&
+      bufMgr->getLog() == NULL && !isLeaf(page) &&
+      pinnedNodes.size() < bufMgr->numFrames() / PINNED_FRAME_SHARE) {
+    PinnedNode &pinned = pinnedNodes[pageNo];
+    pinned.page = page;
+    return &pinned;
+  }
+  if (slot != NULL) bufMgr->swizzle(page, slot);
+  return NULL;
+}
 
-  FileScan fscan(relationName, bufMgr);
-  try {
-    RecordId scanRid;
-    while (1) {
-      fscan.scanNext(scanRid);
-      std::string recordStr = fscan.getRecord();
-      const char *record = recordStr.c_str();
-      int key = *((int *)(record + attrByteOffset));
-      insertEntry(&key, scanRid);
+/**
+ * Returns the slot of a child of a node kept pinned, allocating the slots of
+ * the node if it has none yet.
+ *
+ * @param parent the node as kept pinned, or NULL
+ * @param index the index of the child in pageNoArray
+ */
+template <class T>
+Page **BTreeIndex::childSlot(PinnedNode *parent, int index) {
+  if (parent == NULL || !swizzling) return NULL;
+  if (!parent->children) {
+    parent->numChildren = KeyTraits<T>::NONLEAFSIZE + 1;
+    parent->children.reset(new Page *[parent->numChildren]());
+  }
+  return &parent->children[index];
+}
+
+/**
+ * Clear the slots of the children of a node kept pinned.
+ *
+ * @param pinned the node as kept pinned
+ */
+void BTreeIndex::unswizzleChildren(PinnedNode &pinned) {
+  if (!pinned.children) return;
+  for (int c = 0; c < pinned.numChildren; c++)
+    bufMgr->unswizzle(&pinned.children[c]);
+}
+
+/**
+ * Release a node read by readNode().
+ *
+ * @param pageNo the page number of the node
+ * @param dirty whether the node was changed
+ * @param depth the number of levels above the node
+ */
+void BTreeIndex::unPinNode(PageId pageNo, bool dirty, int depth) {
+  if (depth < PINNED_LEVELS && !pinnedNodes.empty()) {
+    auto pinned = pinnedNodes.find(pageNo);
+    if (pinned != pinnedNodes.end()) {
+      // the children may have moved to other entries; the buffer manager
+      // learns of the change, and logs it, through a pin of its own
+      if (dirty) {
+        unswizzleChildren(pinned->second);
+        pinned->second.leaves.reset();
+        bufMgr->pinSwizzled(pinned->second.page);
+        bufMgr->unPinPage(pinned->second.page, true);
+      }
+      return;
     }
-  } catch (EndOfFileException e) {
   }
+  bufMgr->unPinPage(file, pageNo, dirty);
 }
 
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
-// #######################  Generic Node Helper  ####################### //
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
+/**
+ * Unpin the nodes kept pinned.
+ */
+void BTreeIndex::unpinNodes() {
+  if (pinnedNodes.empty()) return;
+  for (auto &pinned : pinnedNodes) {
+    unswizzleChildren(pinned.second);
+    bufMgr->unPinPage(file, pinned.first, false);
+  }
+  pinnedNodes.clear();
+}
 
 /**
- * This method takes in a page and checks if the page stores a leaf node or
- * an internal node.
+ * Sets whether descents follow the slots of the nodes kept pinned.
  *
- * Assumption: The level for leaf node is -1.
+ * @param on whether descents follow the slots
+ */
+void BTreeIndex::setSwizzling(bool on) {
+  swizzling = on;
+  if (on) return;
+  for (auto &pinned : pinnedNodes) unswizzleChildren(pinned.second);
+}
+
+/**
+ * Sets whether the nodes kept pinned summarize their leaf children.
  *
- * @param page the page being checked
- * @return true if the page stores a leaf node
- *         false if the page stores an internal node
+ * @param on whether the leaves are summarized
  */
-bool BTreeIndex::isLeaf(Page *page) { return *((int *)page) == -1; }
+void BTreeIndex::setLeafSummaries(bool on) {
+  leafSummaries = on;
+  if (on) return;
+  for (auto &pinned : pinnedNodes) pinned.second.leaves.reset();
+}
 
 /**
- * Checks if an internal node is full
+ * Build the summary of a leaf child of a node kept pinned, unless it is built
+ * already.
  *
- * Assumption: All valid page numbers are nonzero.
+ * @param parent the node as kept pinned
+ * @param index the index of the leaf in pageNoArray
+ * @param leaf the leaf, pinned
+ */
+template <class T>
+void BTreeIndex::summarizeLeaf(PinnedNode &parent, int index,
+                               LeafNode<T> *leaf) {
+  if (!parent.leaves)
+    parent.leaves.reset(new LeafSummary[KeyTraits<T>::NONLEAFSIZE + 1]());
+  LeafSummary &summary = parent.leaves[index];
+  if (summary.built) return;
+
+  const int len = getLeafLen(leaf);
+  summary.built = true;
+  summary.hasKeys = false;
+  summary.filter.assign(max(1, (len * LEAF_FILTER_BITS_PER_KEY + 63) / 64), 0);
+  for (int i = 0; i < len; i++) addToSummary(summary, getLeafKey(leaf, i));
+}
+
+/**
+ * Add a key inserted into a leaf to its summary, if that is built. The key
+ * sets LEAF_FILTER_PROBES bits of one word of the filter, the word and the
+ * bits picked by parts of its hash.
  *
- * @param node an internal node
- * @return true if an internal node is full
- *         false if an internal node is not full
+ * @param summary the summary
+ * @param key the key
  */
-bool BTreeIndex::isNonLeafNodeFull(NonLeafNodeInt *node) {
-  return node->pageNoArray[INTARRAYNONLEAFSIZE] != 0;
+template <class T>
+void BTreeIndex::addToSummary(LeafSummary &summary, const T &key) {
+  if (!summary.built) return;
+  T &low = *(T *)summary.lowKey;
+  T &high = *(T *)summary.highKey;
+  if (!summary.hasKeys || key < low) low = key;
+  if (!summary.hasKeys || high < key) high = key;
+  summary.hasKeys = true;
+
+  const std::uint64_t hash = KeyTraits<T>::hash(key);
+  std::uint64_t &word = summary.filter[(hash >> 32) % summary.filter.size()];
+  for (int p = 0; p < LEAF_FILTER_PROBES; p++)
+    word |= std::uint64_t(1) << ((hash >> (6 * p)) & 63);
 }
 
 /**
- * Checks if a leaf node is full
+ * Returns true if the built summary of a leaf child of an internal node shows
+ * that no key from low to high is in the leaf or in the leaves after it. The
+ * keys of the leaves after it are not below the separator to the right of the
+ * leaf, nor below any key the summary holds. A single key within the fences
+ * is looked for in the filter; a key there at the high fence is the highest
+ * key of the leaf, so it is not in a later leaf unless it is in this one too.
  *
- * Assumption: All valid records are nonzero.
+ * @param parent the node as kept pinned
+ * @param index the index of the leaf in pageNoArray
+ * @param low the lowest key sought
+ * @param high the highest key sought
+ */
+template <class T>
+bool BTreeIndex::summaryExcludes(const PinnedNode &parent, int index,
+                                 const T &low, const T &high) {
+  if (!parent.leaves || !parent.leaves[index].built) return false;
+  const LeafSummary &summary = parent.leaves[index];
+  if (summary.hasKeys) {
+    const T &lowKey = *(const T *)summary.lowKey;
+    const T &highKey = *(const T *)summary.highKey;
+    if (high < lowKey) return true;
+    if (!(highKey < low)) {
+      if (!(low == high)) return false;
+      const std::uint64_t hash = KeyTraits<T>::hash(low);
+      const std::uint64_t word =
+          summary.filter[(hash >> 32) % summary.filter.size()];
+      for (int p = 0; p < LEAF_FILTER_PROBES; p++)
+        if (((word >> ((hash >> (6 * p)) & 63)) & 1) == 0) return true;
+      return false;
+    }
+  }
+  // the leaf holds nothing sought, and the next leaf starts at the separator
+  const NonLeafNode<T> *node = (const NonLeafNode<T> *)parent.page;
+  return index < node->numKeys && high < node->keyArray[index];
+}
+
+/**
+ * Walk down the nodes kept pinned towards the leftmost leaf that may hold the
+ * given key, without pinning anything.
  *
- * @param node a leaf node
- * @return true if a leaf node is full
- *         false if a leaf node is not full
+ * @param key the key
+ * @param index set to the index of the child taken from the node returned
+ * @return the last node kept pinned on the way, or NULL if the root is not one
  */
-bool BTreeIndex::isLeafNodeFull(LeafNodeInt *node) {
-  return !(node->ridArray[INTARRAYLEAFSIZE - 1].page_number == 0 &&
-           node->ridArray[INTARRAYLEAFSIZE - 1].slot_number == 0);
+template <class T>
+BTreeIndex::PinnedNode *BTreeIndex::findPinnedParent(const T &key,
+                                                     int &index) {
+  PinnedNode *parent = NULL;
+  PageId pageNo = indexMetaInfo.rootPageNo;
+  for (int depth = 0; depth < PINNED_LEVELS; depth++) {
+    auto pinned = pinnedNodes.find(pageNo);
+    if (pinned == pinnedNodes.end()) break;
+    parent = &pinned->second;
+    NonLeafNode<T> *node = (NonLeafNode<T> *)parent->page;
+    index = findIndexNonLeaf(node, key);
+    pageNo = node->pageNoArray[index];
+  }
+  return parent;
 }
 
 // ##################################################################### //
 // ##################################################################### //
 // ##################################################################### //
-// #######################   Find Index Helper   ####################### //
+// #########################   Constructor   ########################### //
 // ##################################################################### //
 // ##################################################################### //
 // ##################################################################### //
 
 /**
- * Returns the number of records stored in the leaf node.
- *
- * Assumption: 1. All records are continuously stored.
- *             2. All valid records are nonzero.
+ * Returns the type of the keys built from the given attributes.
  *
- * @param node a leaf node
- * @return the number of records stored in the leaf node
+ * @param keyColumns the attributes the keys are built from
+ * @return the type of the keys
+ * @throws BadIndexInfoException if no index is built on such attributes
  */
-int BTreeIndex::getLeafLen(LeafNodeInt *node) {
-  static auto comp = [](const RecordId &r1, const RecordId &r2) {
-    return r1.page_number > r2.page_number;
-  };
-  static RecordId emptyRecord{};
-
-  RecordId *start = node->ridArray;
-  RecordId *end = &node->ridArray[INTARRAYLEAFSIZE];
-
-  return lower_bound(start, end, emptyRecord, comp) - start;
+static KeyType keyTypeOf(const vector<KeyColumn> &keyColumns) {
+  if (keyColumns.size() == 1) {
+    switch (keyColumns[0].type) {
+      case INTEGER:
+        return INTEGER_KEY;
+      case DOUBLE:
+        return DOUBLE_KEY;
+      case STRING:
+        return STRING_KEY;
+    }
+  }
+  if (keyColumns.size() == 2 && keyColumns[0].type == INTEGER) {
+    switch (keyColumns[1].type) {
+      case INTEGER:
+        return INTEGER_INTEGER_KEY;
+      case DOUBLE:
+        return INTEGER_DOUBLE_KEY;
+      case STRING:
+        return INTEGER_STRING_KEY;
+    }
+  }
+  throw BadIndexInfoException("no index is built on these attributes");
 }
 
 /**
- * Returns the number of records stored in the internal node.
- *
- * Assumption: 1. All records are continuously stored.
- *             2. All valid page numbers are nonzero.
- *
- * @param node an internal node
- * @return the number of records stored in the internal node
+ * Returns the name of the index file of an index on the given attributes of a
+ * relation: the relation name followed by the offset of each attribute.
  */
-int BTreeIndex::getNonLeafLen(NonLeafNodeInt *node) {
-  static auto comp = [](const PageId &p1, const PageId &p2) { return p1 > p2; };
-  PageId *start = node->pageNoArray;
-  PageId *end = &node->pageNoArray[INTARRAYNONLEAFSIZE + 1];
-  return lower_bound(start, end, 0, comp) - start;
+static string indexFileName(const string &relationName,
+                            const vector<KeyColumn> &keyColumns) {
+  string name = relationName;
+  for (const KeyColumn &column : keyColumns)
+    name += ',' + std::to_string(column.byteOffset);
+  return name;
 }
 
 /**
- * Given an integer array, find the index of the first integer larger than
- * (or equal to) the given key.
+ * Constructor
  *
- * Assumption: The array is sorted.
+ * The constructor first checks if the specified index ﬁle exists.
+ * And index ﬁle name is constructed by concatenating the relational name with
+ * the offset of the attribute over which the index is built.
  *
- * @param arr an interger array
- * @param len the length of the array
- * @param key the target key
- * @param includeKey whether the current key is included
+ * If the index ﬁle exists, the ﬁle is opened and its meta page is checked
+ * against the given parameters. Else, a new index ﬁle is created, built from
+ * the relation and its meta page written.
  *
- * @return a. the index of the first integer larger than the given key if
- *            includeKey = false
- *         b. the index of the first integer larger than or equal to the
- *            given key if includeKey = true
- *         c. -1 if the key is not found till the end of array
+ * @param relationName The name of the relation on which to build the index.
+ * @param outIndexName The name of the index file.
+ * @param bufMgrIn The instance of the global buffer manager.
+ * @param attrByteOffset The byte offset of the attribute in the tuple on which
+ * to build the index.
+ * @param attrType The data type of the attribute we are indexing.
+ * @param buildMethod How the index is built from the relation.
+ * @param fillFactor The fraction of each node filled by a bulk build.
+ * @param concurrent Whether the index may be used from several threads.
+ * @param coveredColumns The columns stored in the leaf entries.
+ * @param buildThreads The number of threads a bulk build runs on.
  */
-int BTreeIndex::findArrayIndex(const int *arr, int len, int key,
-                               bool includeKey) {
-  if (!includeKey) key++;
-  int result = lower_bound(arr, &arr[len], key) - arr;
-  return result >= len ? -1 : result;
-}
+BTreeIndex::BTreeIndex(const string &relationName, string &outIndexName,
+                       BufMgr *bufMgrIn, const int attrByteOffset_,
+                       const Datatype attrType, const BuildMethod buildMethod,
+                       const double fillFactor, const bool concurrent_,
+                       const vector<CoveredColumn> &coveredColumns,
+                       const int buildThreads)
+    : BTreeIndex(relationName, outIndexName, bufMgrIn,
+                 vector<KeyColumn>{KeyColumn{attrByteOffset_, attrType}},
+                 buildMethod, fillFactor, concurrent_, coveredColumns,
+                 buildThreads) {}
 
 /**
- * Find the index of the first key smaller than the given key
- *
- * Assumption: 1. All records are continuously stored.
- *             2. All valid page numbers are nonzero.
- *             3. All keys are sorted in the node.
+ * Constructor of an index on several attributes. The index file name is the
+ * relational name followed by the offset of each attribute.
  *
- * @param node an internal node
- * @param key the key to find
- * @return the index of the first key smaller than the given key
- *         return the largest index if not found
+ * @param relationName The name of the relation on which to build the index.
+ * @param outIndexName The name of the index file.
+ * @param bufMgrIn The instance of the global buffer manager.
+ * @param keyColumns The attributes the keys are built from.
+ * @param buildMethod How the index is built from the relation.
+ * @param fillFactor The fraction of each node filled by a bulk build.
+ * @param concurrent Whether the index may be used from several threads.
+ * @param coveredColumns The columns stored in the leaf entries.
+ * @param buildThreads The number of threads a bulk build runs on.
  */
-int BTreeIndex::findIndexNonLeaf(NonLeafNodeInt *node, int key) {
-  int len = getNonLeafLen(node);
-  int result = findArrayIndex(node->keyArray, len - 1, key);
-  return result == -1 ? len - 1 : result;
-}
+BTreeIndex::BTreeIndex(const string &relationName, string &outIndexName,
+                       BufMgr *bufMgrIn, const vector<KeyColumn> &keyColumns,
+                       const BuildMethod buildMethod, const double fillFactor,
+                       const bool concurrent_,
+                       const vector<CoveredColumn> &coveredColumns,
+                       const int buildThreads)
+    : BTreeIndex(relationName,
+                 outIndexName = indexFileName(relationName, keyColumns),
+                 bufMgrIn, keyColumns, buildMethod, fillFactor, concurrent_,
+                 coveredColumns, buildThreads, NULL) {}
 
 /**
- * Find the insertaion index for a key in a leaf node
- *
- * Assumption: 1. All records are continuously stored.
- *             2. All valid records are nonzero.
- *             3. All keys are sorted in the node.
- *
- * @param node a leaf node
- * @param key the key to be inserted
+ * Constructor bulk building a new index from the given records.
  *
- * @return the insertaion index for a key in a leaf node
+ * @param relationName The name of the relation on which to build the index.
+ * @param outIndexName The name of the index file.
+ * @param bufMgrIn The instance of the global buffer manager.
+ * @param keyColumns The attributes the keys are built from.
+ * @param records The records of the relation.
+ * @param fillFactor The fraction of each node filled.
+ * @param coveredColumns The columns stored in the leaf entries.
  */
-int BTreeIndex::findInsertionIndexLeaf(LeafNodeInt *node, int key) {
-  int len = getLeafLen(node);
-  int result = findArrayIndex(node->keyArray, len, key);
-  return result == -1 ? len : result;
-}
+BTreeIndex::BTreeIndex(const string &relationName, string &outIndexName,
+                       BufMgr *bufMgrIn, const vector<KeyColumn> &keyColumns,
+                       const RecordFeed &records, const double fillFactor,
+                       const vector<CoveredColumn> &coveredColumns)
+    : BTreeIndex(relationName,
+                 outIndexName = indexFileName(relationName, keyColumns),
+                 bufMgrIn, keyColumns, BULK_BUILD, fillFactor, false,
+                 coveredColumns, 1, &records) {}
 
 /**
- * Find the index of the first key larger than the given key in the leaf node
- *
- * Assumption: 1. All records are continuously stored.
- *             2. All valid records are nonzero.
- *             3. All keys are sorted in the node.
- *
- * @param node a leaf node
- * @param key the key to find
- * @param includeKey whether the current key is included
+ * Constructor of an index kept in a file of the given name, bulk building a
+ * new index from the given records.
  *
- * @return a. the index of the first integer larger than the given key if
- *            includeKey = false
- *         b. the index of the first integer larger than or equal to the
- *            given key if includeKey = true
- *         c. -1 if the key is not found till the end of array
+ * @param relationName The name of the relation on which to build the index.
+ * @param indexFile The name of the index file.
+ * @param bufMgrIn The instance of the global buffer manager.
+ * @param keyColumns The attributes the keys are built from.
+ * @param records The records to index.
+ * @param fillFactor The fraction of each node filled.
+ * @param concurrent Whether the index may be used from several threads.
  */
-int BTreeIndex::findScanIndexLeaf(LeafNodeInt *node, int key, bool includeKey) {
-  return findArrayIndex(node->keyArray, getLeafLen(node), key, includeKey);
-}
-
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
-// #########################   Insert Helper   ######################### //
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
+BTreeIndex::BTreeIndex(const string &relationName, const string &indexFile,
+                       BufMgr *bufMgrIn, const vector<KeyColumn> &keyColumns,
+                       const RecordFeed &records, const double fillFactor,
+                       const bool concurrent_)
+    : BTreeIndex(relationName, indexFile, bufMgrIn, keyColumns, BULK_BUILD,
+                 fillFactor, concurrent_, vector<CoveredColumn>(), 1,
+                 &records) {}
 
 /**
- * Inserts the given key-record pair into the leaf node at the given insertion
- * index.
+ * Constructor the others delegate to.
  *
- * @param node a leaf node
- * @param i the insertion index
- * @param key the key of the key-record pair to be inserted
- * @param rid the record ID of the key-record pair to be inserted
+ * @param indexFile The name of the index file.
+ * @param records The records a new index is bulk built from, or NULL to scan
+ * the relation.
  */
-void BTreeIndex::insertToLeafNode(LeafNodeInt *node, int i, int key,
-                                  RecordId rid) {
-  const size_t len = INTARRAYLEAFSIZE - i - 1;
+BTreeIndex::BTreeIndex(const string &relationName, const string &indexFile,
+                       BufMgr *bufMgrIn, const vector<KeyColumn> &keyColumns,
+                       const BuildMethod buildMethod, const double fillFactor,
+                       const bool concurrent_,
+                       const vector<CoveredColumn> &coveredColumns,
+                       const int buildThreads, const RecordFeed *records) {
+  bufMgr = bufMgrIn;
+  keyType = keyTypeOf(keyColumns);
+  attrByteOffset = keyColumns[0].byteOffset;
+  attributeType = keyColumns[0].type;
+  concurrent = concurrent_;
 
-  // shift items to add space for the new element
-  memmove(&node->keyArray[i + 1], &node->keyArray[i], len * sizeof(int));
-  memmove(&node->ridArray[i + 1], &node->ridArray[i], len * sizeof(RecordId));
+  for (const CoveredColumn &column : coveredColumns) {
+    if (column.length <= 0) throw BadIndexInfoException("empty covered column");
+    coveredSize += column.length;
+  }
+  if (coveredColumns.size() > (size_t)MAXCOVEREDCOLUMNS ||
+      coveredSize > MAXCOVEREDSIZE)
+    throw BadIndexInfoException("covered columns do not fit in a leaf entry");
+  if (concurrent && coveredSize > 0)
+    throw BadIndexInfoException(
+        "a concurrent index can not store covered columns");
+  // the changes of a concurrent index are not grouped by operation
+  if (concurrent && bufMgr->getLog() != NULL)
+    throw BadIndexInfoException("a concurrent index can not be logged");
 
-  // save the key and record id to the leaf node
-  node->keyArray[i] = key;
-  node->ridArray[i] = rid;
+  relationName.copy(indexMetaInfo.relationName, 20, 0);
+  indexMetaInfo.attrByteOffset = attrByteOffset;
+  indexMetaInfo.attrType = attributeType;
+  indexMetaInfo.numCoveredColumns = coveredColumns.size();
+  copy(coveredColumns.begin(), coveredColumns.end(),
+       indexMetaInfo.coveredColumns);
+  indexMetaInfo.numKeyColumns = keyColumns.size();
+  copy(keyColumns.begin(), keyColumns.end(), indexMetaInfo.keyColumns);
+
+  if (File::exists(indexFile)) {
+    file = new BlobFile(indexFile, false);
+    file->setWriteBehind(true);
+
+    // the meta page is always the first page of the index file
+    headerPageNum = file->getFirstPageNo();
+    Page *headerPage;
+    pinPage(headerPageNum, headerPage);
+    IndexMetaInfo *meta = (IndexMetaInfo *)headerPage;
+
+    string reason;
+    if (strncmp(meta->relationName, indexMetaInfo.relationName, 20) != 0)
+      reason = "relation name does not match";
+    else if (meta->attrByteOffset != attrByteOffset)
+      reason = "attribute byte offset does not match";
+    else if (meta->attrType != attributeType)
+      reason = "attribute type does not match";
+    else if (meta->numKeyColumns != indexMetaInfo.numKeyColumns ||
+             memcmp(meta->keyColumns, indexMetaInfo.keyColumns,
+                    sizeof(indexMetaInfo.keyColumns)) != 0)
+      reason = "key attributes do not match";
+    else if (concurrent && meta->hasPostingLists)
+      reason = "a concurrent index can not hold posting lists";
+    else if (meta->numCoveredColumns != indexMetaInfo.numCoveredColumns ||
+             memcmp(meta->coveredColumns, indexMetaInfo.coveredColumns,
+                    sizeof(indexMetaInfo.coveredColumns)) != 0)
+      reason = "covered columns do not match";
+    indexMetaInfo.rootPageNo = meta->rootPageNo;
+    indexMetaInfo.freePageNo = meta->freePageNo;
+    indexMetaInfo.hasPostingLists = meta->hasPostingLists;
+    bufMgr->unPinPage(file, headerPageNum, false);
+
+    if (!reason.empty()) {
+      bufMgr->flushFile(file);
+      delete file;
+      throw BadIndexInfoException(reason);
+    }
+    if (coveredSize > 0) relationFile = new PageFile(relationName, false);
+    if (bufMgr->getLog() != NULL) bufMgr->getLog()->addFile(file);
+    return;
+  }
+
+  // index pages are written out in batches; the destructor syncs the file
+  file = new BlobFile(indexFile, true);
+  file->setWriteBehind(true);
+  if (coveredSize > 0) relationFile = new PageFile(relationName, false);
+
+  Page *headerPage;
+  pinNewPage(headerPageNum, headerPage);
+  bufMgr->unPinPage(file, headerPageNum, true);
+
+  switch (keyType) {
+    case INTEGER_KEY:
+      if (buildMethod == BULK_BUILD)
+        bulkBuild<int>(relationName, fillFactor, buildThreads,
+                       records);
+      else
+        insertBuild<int>(relationName);
+      break;
+    case DOUBLE_KEY:
+      if (buildMethod == BULK_BUILD)
+        bulkBuild<double>(relationName, fillFactor, buildThreads,
+                          records);
+      else
+        insertBuild<double>(relationName);
+      break;
+    case STRING_KEY:
+      if (buildMethod == BULK_BUILD)
+        bulkBuild<StringKey>(relationName, fillFactor, buildThreads,
+                             records);
+      else
+        insertBuild<StringKey>(relationName);
+      break;
+    case INTEGER_INTEGER_KEY:
+      if (buildMethod == BULK_BUILD)
+        bulkBuild<IntIntKey>(relationName, fillFactor, buildThreads,
+                             records);
+      else
+        insertBuild<IntIntKey>(relationName);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      if (buildMethod == BULK_BUILD)
+        bulkBuild<IntDoubleKey>(relationName, fillFactor, buildThreads,
+                                records);
+      else
+        insertBuild<IntDoubleKey>(relationName);
+      break;
+    case INTEGER_STRING_KEY:
+      if (buildMethod == BULK_BUILD)
+        bulkBuild<IntStringKey>(relationName, fillFactor, buildThreads,
+                                records);
+      else
+        insertBuild<IntStringKey>(relationName);
+      break;
+  }
+  writeMetaInfo();
+
+  // a built index is made durable as a whole; its changes are logged after
+  if (bufMgr->getLog() != NULL) {
+    bufMgr->flushFile(file);
+    file->sync();
+    bufMgr->getLog()->addFile(file);
+  }
 }
 
 /**
- * Inserts the given key-(page number) pair into the given leaf node at the
- * given index.
- *
- * @param n an internal node
- * @param i the insertion index
- * @param key the key of the key-(page number) pair
- * @param pid the page number of the key-(page number) pair
+ * Write indexMetaInfo to the meta page of the index file. Called whenever the
+ * root page changes so that the index can be reopened later.
  */
-void BTreeIndex::insertToNonLeafNode(NonLeafNodeInt *n, int i, int key,
-                                     PageId pid) {
-  const size_t len = INTARRAYNONLEAFSIZE - i - 1;
+void BTreeIndex::writeMetaInfo() {
+  Page *headerPage;
+  pinPage(headerPageNum, headerPage);
+  memcpy(reinterpret_cast<char *>(headerPage), &indexMetaInfo,
+         sizeof(IndexMetaInfo));
+  bufMgr->unPinPage(file, headerPageNum, true);
+}
 
-  // shift items to add space for the new element
-  memmove(&n->keyArray[i + 1], &n->keyArray[i], len * sizeof(int));
-  memmove(&n->pageNoArray[i + 2], &n->pageNoArray[i + 1], len * sizeof(PageId));
+/**
+ * Returns the page number of the root, which writers of a concurrent index may
+ * change at any time.
+ */
+PageId BTreeIndex::loadRootPageNo() {
+  return __atomic_load_n(&indexMetaInfo.rootPageNo, __ATOMIC_ACQUIRE);
+}
 
-  // store the key and page number to the node
-  n->keyArray[i] = key;
-  n->pageNoArray[i + 1] = pid;
+/**
+ * Make the given page the root and write the meta page.
+ *
+ * @param pageNo the page number of the new root
+ */
+void BTreeIndex::storeRootPageNo(PageId pageNo) {
+  // the nodes kept pinned are those below the old root
+  unpinNodes();
+  std::unique_lock<std::mutex> lock = latchMeta();
+  __atomic_store_n(&indexMetaInfo.rootPageNo, pageNo, __ATOMIC_RELEASE);
+  writeMetaInfo();
 }
 
 // ##################################################################### //
 // ##################################################################### //
 // ##################################################################### //
-// ##########################   Split Helper   ######################### //
+// #########################   Build Helper   ########################## //
 // ##################################################################### //
 // ##################################################################### //
 // ##################################################################### //
 
 /**
- * Splits a leaf node into two.
- * It moves the records after the given index in the node into the new node.
+ * Build the index by calling insertEntry() for every tuple of the relation.
  *
- * @param node a pointer to the original node
- * @param newNode a pointer to the new node
+ * @param relationName the name of the relation to be indexed
+ */
+template <class T>
+void BTreeIndex::insertBuild(const string &relationName) {
+  allocLeafNode<T>(indexMetaInfo.rootPageNo);
+  bufMgr->unPinPage(file, indexMetaInfo.rootPageNo, true);
+
+  FileScan fscan(relationName, bufMgr);
+  try {
+    RecordId scanRid;
+    while (1) {
+      fscan.scanNext(scanRid);
+      const char *record = fscan.getRecordView().data;
+      insertKey(KeyTraits<T>::fromRecord(record, indexMetaInfo.keyColumns),
+                scanRid);
+      count(INSERTS);
+    }
+  } catch (EndOfFileException e) {
+  }
+}
+
+/**
+ * Sort the given pairs and write them to the end of the sort file.
+ *
+ * @param runFile the temporary sort file
+ * @param run the pairs of the run, cleared once written
+ * @return the run written to the file
+ */
+template <class T>
+SortRun BTreeIndex::spillRun(File *runFile, vector<RIDKeyPair<T>> &run) {
+  sort(run.begin(), run.end());
+
+  SortRun sortRun{Page::INVALID_NUMBER, run.size()};
+  for (size_t i = 0; i < run.size(); i += KeyTraits<T>::RUNPAGESIZE) {
+    PageId pageNo;
+    Page *page;
+    bufMgr->allocPage(runFile, pageNo, page);
+    if (i == 0) sortRun.firstPageNo = pageNo;
+
+    size_t len = min(run.size() - i, (size_t)KeyTraits<T>::RUNPAGESIZE);
+    memcpy(reinterpret_cast<char *>(page), &run[i],
+           len * sizeof(RIDKeyPair<T>));
+    bufMgr->unPinPage(runFile, pageNo, true);
+  }
+
+  run.clear();
+  return sortRun;
+}
+
+/**
+ * Merge the given sorted runs, passing each pair in order to emit.
+ *
+ * @param runFile the temporary sort file
+ * @param runs the runs to be merged, at most BULKLOAD_MERGE_FANIN of them
+ * @param emit called once for every pair, in sorted order
+ */
+template <class T, class Emit>
+void BTreeIndex::mergeRuns(File *runFile, const vector<SortRun> &runs,
+                           Emit &emit) {
+  // the page currently pinned and the next position of every run
+  vector<PageId> pageNos(runs.size());
+  vector<RIDKeyPair<T> *> pages(runs.size());
+  vector<size_t> positions(runs.size(), 0);
+
+  // min-heap of the next pair of every run, tagged with the run index
+  typedef pair<RIDKeyPair<T>, size_t> HeapEntry;
+  auto greater = [](const HeapEntry &e1, const HeapEntry &e2) {
+    return e2.first < e1.first;
+  };
+  priority_queue<HeapEntry, vector<HeapEntry>, decltype(greater)> heap(greater);
+
+  for (size_t r = 0; r < runs.size(); r++) {
+    if (runs[r].length == 0) continue;
+    pageNos[r] = runs[r].firstPageNo;
+    bufMgr->readPage(runFile, pageNos[r], (Page *&)pages[r]);
+    heap.push(HeapEntry(pages[r][0], r));
+  }
+
+  while (!heap.empty()) {
+    HeapEntry top = heap.top();
+    heap.pop();
+    emit(top.first);
+
+    // advance the run the pair came from, moving to its next page if needed
+    size_t r = top.second;
+    size_t pos = ++positions[r];
+    if (pos % KeyTraits<T>::RUNPAGESIZE == 0) {
+      bufMgr->unPinPage(runFile, pageNos[r], false);
+      if (pos == runs[r].length) continue;
+      pageNos[r]++;
+      bufMgr->readPage(runFile, pageNos[r], (Page *&)pages[r]);
+    } else if (pos == runs[r].length) {
+      bufMgr->unPinPage(runFile, pageNos[r], false);
+      continue;
+    }
+    heap.push(HeapEntry(pages[r][pos % KeyTraits<T>::RUNPAGESIZE], r));
+  }
+}
+
+/**
+ * Pack the given nodes into a new level of internal nodes. The children are
+ * spread evenly over the new nodes so that the last node is not left nearly
+ * empty.
+ *
+ * @param children the smallest key and page number of every node of the
+ *        level below, from left to right
+ * @param fanout the number of children given to each new node
+ * @param level the level of the new nodes
+ * @return the smallest key and page number of every new node
+ */
+template <class T>
+vector<PageKeyPair<T>> BTreeIndex::buildNonLeafLevel(
+    const vector<PageKeyPair<T>> &children, int fanout, int level) {
+  const size_t numNodes = (children.size() + fanout - 1) / fanout;
+  vector<PageKeyPair<T>> parents;
+  parents.reserve(numNodes);
+
+  size_t next = 0;
+  for (size_t n = 0; n < numNodes; n++) {
+    size_t len = children.size() / numNodes + (n < children.size() % numNodes);
+
+    PageId pageNo;
+    NonLeafNode<T> *node = allocNonLeafNode<T>(pageNo);
+    node->level = level;
+
+    // the smallest key of the first child belongs to the parent level
+    PageKeyPair<T> parent;
+    parent.set(pageNo, children[next].key);
+    parents.push_back(parent);
+
+    node->pageNoArray[0] = children[next++].pageNo;
+    for (size_t i = 1; i < len; i++) {
+      node->keyArray[i - 1] = children[next].key;
+      node->pageNoArray[i] = children[next++].pageNo;
+    }
+    node->numKeys = len - 1;
+    indexNonLeaf(node);
+
+    bufMgr->unPinPage(file, pageNo, true);
+  }
+
+  return parents;
+}
+
+/**
+ * Returns the number of leaf entries the given sorted pairs take if a key with
+ * at least MINPOSTINGSIZE pairs takes a single one for its posting list.
+ */
+template <class T>
+static size_t countLeafEntries(const vector<RIDKeyPair<T>> &pairs) {
+  size_t numEntries = 0;
+  for (size_t i = 0, j; i < pairs.size(); i = j) {
+    for (j = i + 1; j < pairs.size() && pairs[j].key == pairs[i].key; j++) {
+    }
+    numEntries += j - i >= (size_t)KeyTraits<T>::MINPOSTINGSIZE ? 1 : j - i;
+  }
+  return numEntries;
+}
+
+/**
+ * Run fn(0) to fn(numThreads - 1) on threads of their own and wait for all of
+ * them. The first exception thrown by any of them is then rethrown.
+ */
+template <class Fn>
+static void runThreads(int numThreads, Fn fn) {
+  vector<thread> threads;
+  vector<exception_ptr> errors(numThreads);
+  for (int t = 0; t < numThreads; t++) {
+    threads.emplace_back([&fn, &errors, t] {
+      try {
+        fn(t);
+      } catch (...) {
+        errors[t] = current_exception();
+      }
+    });
+  }
+  for (thread &th : threads) th.join();
+  for (const exception_ptr &error : errors) {
+    if (error) rethrow_exception(error);
+  }
+}
+
+/**
+ * Returns the position of a record in the relation, by which the covered
+ * columns kept during a bulk build are found.
+ */
+static std::uint64_t ridPosition(const RecordId &rid) {
+  return ((std::uint64_t)rid.page_number << 16) | rid.slot_number;
+}
+
+/**
+ * Build the index bottom-up. The leaves are built from the sorted (key, rid)
+ * pairs of the relation, and each level of internal nodes is then packed from
+ * the smallest keys of the level below until a single root remains.
+ *
+ * @param relationName the name of the relation to be indexed
+ * @param fillFactor the fraction of each node to be filled
+ * @param numThreads the number of threads the leaves are built on
+ * @param records the records to build from, or NULL to scan the relation
+ */
+template <class T>
+void BTreeIndex::bulkBuild(const string &relationName, double fillFactor,
+                           int numThreads, const RecordFeed *records) {
+  const int nonLeafSize = KeyTraits<T>::NONLEAFSIZE;
+  fillFactor = max(0.0, min(1.0, fillFactor));
+  const int fanout = max(
+      2, min(nonLeafSize + 1, (int)(fillFactor * (nonLeafSize + 1))));
+
+  vector<PageKeyPair<T>> level =
+      numThreads > 1 && records == NULL
+          ? buildLeavesParallel<T>(relationName, fillFactor, numThreads)
+          : buildLeaves<T>(relationName, fillFactor, records);
+  if (level.empty()) {
+    allocLeafNode<T>(indexMetaInfo.rootPageNo);
+    bufMgr->unPinPage(file, indexMetaInfo.rootPageNo, true);
+    return;
+  }
+
+  // build the internal levels until a single root remains
+  for (int lvl = 1; level.size() > 1; lvl = 0)
+    level = buildNonLeafLevel<T>(level, fanout, lvl);
+  indexMetaInfo.rootPageNo = level[0].pageNo;
+}
+
+/**
+ * Build the leaves of a bulk build on this thread, spilling sorted runs of
+ * pairs to a temporary file when they do not fit in memory.
+ *
+ * @param relationName the name of the relation to be indexed
+ * @param fillFactor the fraction of each leaf to be filled
+ * @param records the records to build from, or NULL to scan the relation
+ * @return the smallest key and page number of every leaf
+ */
+template <class T>
+vector<PageKeyPair<T>> BTreeIndex::buildLeaves(const string &relationName,
+                                               double fillFactor,
+                                               const RecordFeed *records) {
+  // collect the pairs, spilling sorted runs if they do not fit in memory
+  const string runFileName = file->filename() + ".sort";
+  File *runFile = NULL;
+  vector<SortRun> runs;
+  vector<RIDKeyPair<T>> run;
+  size_t numPairs = 0;
+
+  // the covered columns of the records, kept in memory until the entries are
+  // packed into leaves in key order, and found by the position of their record
+  // ids in the relation
+  vector<pair<std::uint64_t, size_t>> columnsIndex;
+  vector<char> columns;
+
+  auto addRecord = [&](const RecordId &rid, const char *record) {
+    RIDKeyPair<T> entry;
+    entry.set(rid, KeyTraits<T>::fromRecord(record, indexMetaInfo.keyColumns));
+    run.push_back(entry);
+    numPairs++;
+
+    if (coveredSize > 0) {
+      columnsIndex.push_back(make_pair(ridPosition(rid), columns.size()));
+      columns.resize(columns.size() + coveredSize);
+      copyCoveredColumns(record, &columns[columns.size() - coveredSize]);
+    }
+
+    if (run.size() == (size_t)BULKLOAD_RUN_SIZE) {
+      if (runFile == NULL) {
+        try {
+          File::remove(runFileName);
+        } catch (FileNotFoundException e) {
+        }
+        runFile = new BlobFile(runFileName, true);
+      }
+      runs.push_back(spillRun(runFile, run));
+    }
+  };
+
+  if (records != NULL) {
+    (*records)(addRecord);
+  } else {
+    FileScan fscan(relationName, bufMgr);
+    try {
+      RecordId scanRid;
+      while (1) {
+        fscan.scanNext(scanRid);
+        addRecord(scanRid, fscan.getRecordView().data);
+      }
+    } catch (EndOfFileException e) {
+    }
+  }
+
+  if (numPairs == 0) return vector<PageKeyPair<T>>();
+
+  sort(columnsIndex.begin(), columnsIndex.end());
+  auto columnsOf = [&](const RecordId &rid) -> const char * {
+    if (coveredSize == 0) return NULL;
+    auto it = lower_bound(columnsIndex.begin(), columnsIndex.end(),
+                          make_pair(ridPosition(rid), (size_t)0));
+    return &columns[it->second];
+  };
+
+  PageId lastPageNo;
+  if (runs.empty()) {
+    sort(run.begin(), run.end());
+    const size_t numEntries =
+        bulkPostingLists() ? countLeafEntries(run) : run.size();
+    auto feed = [&](const function<void(const RIDKeyPair<T> &)> &append) {
+      for (const RIDKeyPair<T> &entry : run) append(entry);
+    };
+    return packLeaves<T>(feed, numEntries, fillFactor, columnsOf, lastPageNo);
+  }
+
+  if (!run.empty()) runs.push_back(spillRun(runFile, run));
+  vector<RIDKeyPair<T>>().swap(run);
+
+  // merge groups of runs into longer runs until they can be merged at once
+  while (runs.size() > (size_t)BULKLOAD_MERGE_FANIN) {
+    vector<SortRun> merged;
+    for (size_t i = 0; i < runs.size(); i += BULKLOAD_MERGE_FANIN) {
+      vector<SortRun> group(
+          runs.begin() + i,
+          runs.begin() + min(runs.size(), i + BULKLOAD_MERGE_FANIN));
+
+      SortRun out{Page::INVALID_NUMBER, 0};
+      PageId outPageNo = Page::INVALID_NUMBER;
+      RIDKeyPair<T> *outPage = NULL;
+      auto appendToRun = [&](const RIDKeyPair<T> &entry) {
+        if (out.length % KeyTraits<T>::RUNPAGESIZE == 0) {
+          if (outPage != NULL) bufMgr->unPinPage(runFile, outPageNo, true);
+          bufMgr->allocPage(runFile, outPageNo, (Page *&)outPage);
+          if (out.length == 0) out.firstPageNo = outPageNo;
+        }
+        outPage[out.length++ % KeyTraits<T>::RUNPAGESIZE] = entry;
+      };
+      mergeRuns<T>(runFile, group, appendToRun);
+      if (outPage != NULL) bufMgr->unPinPage(runFile, outPageNo, true);
+      merged.push_back(out);
+    }
+    runs.swap(merged);
+  }
+
+  // the number of entries is not known before the merge, so the leaves are
+  // spread as if no key had a posting list
+  auto feed = [&](function<void(const RIDKeyPair<T> &)> append) {
+    mergeRuns<T>(runFile, runs, append);
+  };
+  vector<PageKeyPair<T>> level =
+      packLeaves<T>(feed, numPairs, fillFactor, columnsOf, lastPageNo);
+
+  bufMgr->flushFile(runFile);
+  delete runFile;
+  File::remove(runFileName);
+  return level;
+}
+
+/**
+ * Build the leaves of a bulk build on several threads.
+ *
+ * @param relationName the name of the relation to be indexed
+ * @param fillFactor the fraction of each leaf to be filled
+ * @param numThreads the number of threads
+ * @return the smallest key and page number of every leaf
+ */
+template <class T>
+vector<PageKeyPair<T>> BTreeIndex::buildLeavesParallel(
+    const string &relationName, double fillFactor, int numThreads) {
+  // the pairs each worker of a parallel scan finds, sorted, and their covered
+  // columns, found by the position of their record ids in the relation
+  vector<vector<RIDKeyPair<T>>> shares(numThreads);
+  vector<vector<pair<std::uint64_t, size_t>>> columnsIndex(numThreads);
+  vector<vector<char>> columns(numThreads);
+  vector<vector<PageId>> pagesOf(numThreads);
+  {
+    ParallelFileScan scan(relationName, bufMgr, numThreads);
+    scan.run([&](ParallelFileScan::Worker &worker) {
+      const int t = worker.id();
+      try {
+        RecordId rid;
+        while (1) {
+          worker.scanNext(rid);
+          const char *record = worker.getRecordView().data;
+          RIDKeyPair<T> entry;
+          entry.set(rid, KeyTraits<T>::fromRecord(record,
+                                                  indexMetaInfo.keyColumns));
+          shares[t].push_back(entry);
+
+          if (coveredSize > 0) {
+            if (pagesOf[t].empty() || pagesOf[t].back() != rid.page_number)
+              pagesOf[t].push_back(rid.page_number);
+            columnsIndex[t].push_back(
+                make_pair(ridPosition(rid), columns[t].size()));
+            columns[t].resize(columns[t].size() + coveredSize);
+            copyCoveredColumns(record,
+                               &columns[t][columns[t].size() - coveredSize]);
+          }
+        }
+      } catch (EndOfFileException e) {
+      }
+      sort(shares[t].begin(), shares[t].end());
+      sort(columnsIndex[t].begin(), columnsIndex[t].end());
+    });
+  }
+
+  // the worker that read each page, for finding the covered columns of a
+  // record
+  vector<int> workerOfPage;
+  for (int t = 0; t < numThreads; t++) {
+    for (PageId pageNo : pagesOf[t]) {
+      if (pageNo >= workerOfPage.size()) workerOfPage.resize(pageNo + 1);
+      workerOfPage[pageNo] = t;
+    }
+  }
+  auto columnsOf = [&](const RecordId &rid) -> const char * {
+    if (coveredSize == 0) return NULL;
+    const int t = workerOfPage[rid.page_number];
+    auto it = lower_bound(columnsIndex[t].begin(), columnsIndex[t].end(),
+                          make_pair(ridPosition(rid), (size_t)0));
+    return &columns[t][it->second];
+  };
+
+  // split the key range into one part per thread at keys sampled at an even
+  // stride from the sorted shares, which can differ in size as workers take
+  // morsels from each other; all pairs of a key fall into the same part
+  size_t numPairs = 0;
+  for (const vector<RIDKeyPair<T>> &share : shares) numPairs += share.size();
+  const size_t stride = max<size_t>(1, numPairs / (numThreads * 16));
+  vector<T> samples;
+  for (const vector<RIDKeyPair<T>> &share : shares) {
+    for (size_t i = stride / 2; i < share.size(); i += stride)
+      samples.push_back(share[i].key);
+  }
+  if (samples.empty()) return vector<PageKeyPair<T>>();
+  sort(samples.begin(), samples.end());
+  vector<T> splitters;
+  for (int i = 1; i < numThreads; i++)
+    splitters.push_back(samples[samples.size() * i / numThreads]);
+
+  // the start of each part in each share
+  auto partBegin = [&](int t, int part) -> size_t {
+    if (part == 0) return 0;
+    if (part == numThreads) return shares[t].size();
+    auto keyLess = [](const RIDKeyPair<T> &entry, const T &key) {
+      return entry.key < key;
+    };
+    return lower_bound(shares[t].begin(), shares[t].end(),
+                       splitters[part - 1], keyLess) -
+           shares[t].begin();
+  };
+
+  // each thread packs the pairs of its part into a chain of leaves
+  vector<vector<PageKeyPair<T>>> levels(numThreads);
+  vector<PageId> lastPageNos(numThreads);
+  parallelBuild = true;
+  try {
+    runThreads(numThreads, [&](int part) {
+      vector<RIDKeyPair<T>> pairs;
+      for (int t = 0; t < numThreads; t++) {
+        pairs.insert(pairs.end(), shares[t].begin() + partBegin(t, part),
+                     shares[t].begin() + partBegin(t, part + 1));
+      }
+      if (pairs.empty()) return;
+      sort(pairs.begin(), pairs.end());
+
+      const size_t numEntries =
+          bulkPostingLists() ? countLeafEntries(pairs) : pairs.size();
+      auto feed = [&](const function<void(const RIDKeyPair<T> &)> &append) {
+        for (const RIDKeyPair<T> &entry : pairs) append(entry);
+      };
+      levels[part] = packLeaves<T>(feed, numEntries, fillFactor, columnsOf,
+                                   lastPageNos[part]);
+    });
+  } catch (...) {
+    parallelBuild = false;
+    throw;
+  }
+  parallelBuild = false;
+
+  // link the chains up, from left to right
+  vector<PageKeyPair<T>> level;
+  PageId prevPageNo = 0;
+  for (int part = 0; part < numThreads; part++) {
+    if (levels[part].empty()) continue;
+    if (prevPageNo != 0) {
+      const PageId nextPageNo = levels[part][0].pageNo;
+      Page *prevPage, *nextPage;
+      pinPage(prevPageNo, prevPage);
+      pinPage(nextPageNo, nextPage);
+      LeafNode<T> *prev = (LeafNode<T> *)prevPage;
+      LeafNode<T> *next = (LeafNode<T> *)nextPage;
+      prev->rightSibPageNo = nextPageNo;
+      next->leftSibPageNo = prevPageNo;
+      bufMgr->unPinPage(file, prevPageNo, true);
+      bufMgr->unPinPage(file, nextPageNo, true);
+    }
+    prevPageNo = lastPageNos[part];
+    level.insert(level.end(), levels[part].begin(), levels[part].end());
+  }
+  return level;
+}
+
+/**
+ * Pack sorted pairs into a chain of new leaves, spread evenly over them.
+ *
+ * @param feed called with the function to be called with every pair
+ * @param numEntries the number of leaf entries the pairs take, or more
+ * @param fillFactor the fraction of each leaf to be filled
+ * @param columnsOf returns the covered columns of the record of a record id
+ * @param lastPageNo set to the page number of the last leaf
+ * @return the smallest key and page number of every leaf
+ */
+template <class T, class Feed, class Columns>
+vector<PageKeyPair<T>> BTreeIndex::packLeaves(Feed feed, size_t numEntries,
+                                              double fillFactor,
+                                              Columns columnsOf,
+                                              PageId &lastPageNo) {
+  const int leafSize = maxLeafCapacity<T>();
+  const int leafFill = max(1, min(leafSize, (int)(fillFactor * leafSize)));
+  const bool usePostingLists = bulkPostingLists();
+
+  const size_t numLeaves = (numEntries + leafFill - 1) / leafFill;
+  vector<PageKeyPair<T>> level;
+  level.reserve(numLeaves);
+
+  LeafNode<T> *leaf = NULL;
+  PageId leafPageNo = Page::INVALID_NUMBER;
+  int leafLen = 0;
+  int leafCap = 0;
+
+  // a leaf is also closed early if the next key would overfill it, which can
+  // happen before it holds its share when its capacity depends on its keys
+  auto leafIsFull = [&](const T &key) {
+    return leafLen == leafCap ||
+           leafLen >= max(1, (int)(fillFactor * getLeafCapacity(leaf, key)));
+  };
+
+  auto appendToLeaf = [&](const RIDKeyPair<T> &entry) {
+    if (leafIsFull(entry.key)) {
+      PageId newPageNo;
+      LeafNode<T> *newLeaf = allocLeafNode<T>(newPageNo);
+      if (leaf != NULL) {
+        leaf->rightSibPageNo = newPageNo;
+        newLeaf->leftSibPageNo = leafPageNo;
+        bufMgr->unPinPage(file, leafPageNo, true);
+      }
+      leaf = newLeaf;
+      leafPageNo = newPageNo;
+      leafLen = 0;
+      leafCap =
+          numEntries / numLeaves + (level.size() < numEntries % numLeaves);
+
+      PageKeyPair<T> sep;
+      sep.set(newPageNo, entry.key);
+      level.push_back(sep);
+    }
+    appendToLeafNode(leaf, leafLen, entry.key, entry.rid, columnsOf(entry.rid));
+    leafLen++;
+  };
+
+  // the pairs of the current key are held back until there are enough of them
+  // for a posting list, after which they are appended to it in batches
+  vector<RecordId> keyRids;
+  T key{};
+  PageId postingPageNo = 0;
+  auto endKey = [&]() {
+    if (postingPageNo != 0) {
+      appendPostingRids(postingPageNo, keyRids.data(), keyRids.size());
+    } else {
+      RIDKeyPair<T> entry;
+      for (const RecordId &rid : keyRids) {
+        entry.set(rid, key);
+        appendToLeaf(entry);
+      }
+    }
+    keyRids.clear();
+    postingPageNo = 0;
+  };
+  auto appendPair = [&](const RIDKeyPair<T> &entry) {
+    if (!usePostingLists) return appendToLeaf(entry);
+    if ((!keyRids.empty() || postingPageNo != 0) && !(entry.key == key))
+      endKey();
+    key = entry.key;
+    keyRids.push_back(entry.rid);
+    if (keyRids.size() < (size_t)KeyTraits<T>::MINPOSTINGSIZE) return;
+
+    if (postingPageNo == 0) {
+      postingPageNo = createPostingList(keyRids.data(), keyRids.size());
+      RIDKeyPair<T> listEntry;
+      listEntry.set(RecordId{postingPageNo, POSTINGLISTSLOT}, key);
+      appendToLeaf(listEntry);
+    } else {
+      appendPostingRids(postingPageNo, keyRids.data(), keyRids.size());
+    }
+    keyRids.clear();
+  };
+
+  feed(appendPair);
+  endKey();
+  bufMgr->unPinPage(file, leafPageNo, true);
+  lastPageNo = leafPageNo;
+  return level;
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// #######################  Generic Node Helper  ####################### //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+/**
+ * This method takes in a page and checks if the page stores a leaf node or
+ * an internal node.
+ *
+ * Assumption: The level for leaf node is -1.
+ *
+ * @param page the page being checked
+ * @return true if the page stores a leaf node
+ *         false if the page stores an internal node
+ */
+bool BTreeIndex::isLeaf(Page *page) { return *((int *)page) == -1; }
+
+/**
+ * Checks if an internal node is full
+ *
+ * @param node an internal node
+ * @return true if an internal node is full
+ *         false if an internal node is not full
+ */
+template <class T>
+bool BTreeIndex::isNonLeafNodeFull(NonLeafNode<T> *node) {
+  return node->numKeys == KeyTraits<T>::NONLEAFSIZE;
+}
+
+/**
+ * Checks if a leaf node is full
+ *
+ * @param node a leaf node
+ * @param key the key to be inserted
+ * @return true if a leaf node has no room for the key
+ *         false if a leaf node is not full
+ */
+template <class T>
+bool BTreeIndex::isLeafNodeFull(LeafNode<T> *node, const T &key) {
+  return node->numKeys >= getLeafCapacity(node, key);
+}
+
+/**
+ * Returns the number of records the leaf node can hold once the given key is
+ * stored in it.
+ *
+ * @param node a leaf node
+ * @param key the key to be stored
+ * @return the capacity of the leaf node
+ */
+template <class T>
+int BTreeIndex::getLeafCapacity(LeafNode<T> *node, const T &key) {
+  return maxLeafCapacity<T>();
+}
+
+/**
+ * Returns the number of entries a leaf holds at most. The covered columns of
+ * the entries are stored from the end of the record id array backwards, so
+ * they take the room of record ids no longer used.
+ *
+ * @return the largest capacity of a leaf
+ */
+template <class T>
+int BTreeIndex::maxLeafCapacity() {
+  return KeyTraits<T>::LEAFSIZE * sizeof(RecordId) /
+         (sizeof(RecordId) + coveredSize);
+}
+
+/**
+ * Returns the end of the area of a leaf that its covered columns are stored
+ * backwards from, while its entries fill it from the front.
+ */
+template <class T>
+static char *leafColumnsEnd(LeafNode<T> *node) {
+  return (char *)&node->ridArray[KeyTraits<T>::LEAFSIZE];
+}
+
+static char *leafColumnsEnd(LeafNode<StringKey> *node) {
+  return node->data + STRINGLEAFDATASIZE;
+}
+
+/**
+ * Returns the covered columns of the given entry of the leaf node.
+ *
+ * @param node a leaf node
+ * @param i the index of the entry
+ * @return the covered columns of the entry
+ */
+template <class T>
+char *BTreeIndex::getLeafColumns(LeafNode<T> *node, int i) {
+  return leafColumnsEnd(node) - (i + 1) * coveredSize;
+}
+
+/**
+ * Make room for the covered columns of an entry inserted at the given index of
+ * a leaf, and store them there.
+ *
+ * @param node a leaf node
+ * @param i the index of the entry
+ * @param len the number of entries before the insertion
+ * @param columns the covered columns, or NULL to store zeros
+ */
+template <class T>
+void BTreeIndex::insertLeafColumns(LeafNode<T> *node, int i, int len,
+                                   const char *columns) {
+  if (coveredSize == 0) return;
+  char *end = leafColumnsEnd(node);
+  memmove(end - (len + 1) * coveredSize, end - len * coveredSize,
+          (len - i) * coveredSize);
+  if (columns != NULL)
+    memcpy(getLeafColumns(node, i), columns, coveredSize);
+  else
+    memset(getLeafColumns(node, i), 0, coveredSize);
+}
+
+/**
+ * Remove the covered columns of the entry at the given index of a leaf.
+ *
+ * @param node a leaf node
+ * @param i the index of the entry
+ * @param len the number of entries before the removal
+ */
+template <class T>
+void BTreeIndex::removeLeafColumns(LeafNode<T> *node, int i, int len) {
+  if (coveredSize == 0) return;
+  char *end = leafColumnsEnd(node);
+  memmove(end - (len - 1) * coveredSize, end - len * coveredSize,
+          (len - i - 1) * coveredSize);
+  memset(end - len * coveredSize, 0, coveredSize);
+}
+
+/**
+ * Move the covered columns of the entries from the given index of a leaf on
+ * to the front of a new leaf, as a split moves the entries.
+ *
+ * @param node a leaf node
+ * @param newNode an empty leaf node
+ * @param index the index of the first entry moved
+ * @param len the number of entries before the split
+ */
+template <class T>
+void BTreeIndex::splitLeafColumns(LeafNode<T> *node, LeafNode<T> *newNode,
+                                  int index, int len) {
+  if (coveredSize == 0) return;
+  const size_t size = (len - index) * coveredSize;
+  char *moved = leafColumnsEnd(node) - len * coveredSize;
+  memcpy(leafColumnsEnd(newNode) - size, moved, size);
+  memset(moved, 0, size);
+}
+
+/**
+ * Copy the covered columns out of a record.
+ *
+ * @param record the record
+ * @param columns the buffer the columns are copied to, one after another
+ */
+void BTreeIndex::copyCoveredColumns(const char *record, char *columns) {
+  for (int c = 0; c < indexMetaInfo.numCoveredColumns; c++) {
+    const CoveredColumn &column = indexMetaInfo.coveredColumns[c];
+    memcpy(columns, record + column.byteOffset, column.length);
+    columns += column.length;
+  }
+}
+
+/**
+ * Read the covered columns of a record of the base relation, for an entry
+ * being inserted.
+ *
+ * @param rid the record id of the record
+ * @param columns the buffer the columns are copied to
+ * @return columns, or NULL if the index stores no columns
+ */
+const char *BTreeIndex::readCoveredColumns(RecordId rid, char *columns) {
+  if (coveredSize == 0) return NULL;
+  Page *page;
+  bufMgr->readPage(relationFile, rid.page_number, page);
+  copyCoveredColumns(page->getRecordView(rid).data, columns);
+  bufMgr->unPinPage(relationFile, rid.page_number, false);
+  return columns;
+}
+
+/**
+ * Returns the key of the given entry of the leaf node.
+ *
+ * @param node a leaf node
+ * @param i the index of the entry
+ * @return the key of the entry
+ */
+template <class T>
+T BTreeIndex::getLeafKey(LeafNode<T> *node, int i) {
+  return node->keyArray[i];
+}
+
+/**
+ * Returns the record id of the given entry of the leaf node.
+ *
+ * @param node a leaf node
+ * @param i the index of the entry
+ * @return the record id of the entry
+ */
+template <class T>
+RecordId BTreeIndex::getLeafRid(LeafNode<T> *node, int i) {
+  return node->ridArray[i];
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// #######################   Find Index Helper   ####################### //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+/**
+ * Returns the number of records stored in the leaf node.
+ *
+ * @param node a leaf node
+ * @return the number of records stored in the leaf node
+ */
+template <class T>
+int BTreeIndex::getLeafLen(LeafNode<T> *node) {
+  return node->numKeys;
+}
+
+/**
+ * Returns the number of records stored in the internal node.
+ *
+ * @param node an internal node
+ * @return the number of records stored in the internal node
+ */
+template <class T>
+int BTreeIndex::getNonLeafLen(NonLeafNode<T> *node) {
+  return node->numKeys + 1;
+}
+
+/**
+ * Given a key array, find the index of the first key larger than (or equal
+ * to) the given key.
+ *
+ * Assumption: The array is sorted.
+ *
+ * @param arr a key array
+ * @param len the length of the array
+ * @param key the target key
+ * @param includeKey whether the current key is included
+ *
+ * @return a. the index of the first key larger than the given key if
+ *            includeKey = false
+ *         b. the index of the first key larger than or equal to the
+ *            given key if includeKey = true
+ *         c. -1 if the key is not found till the end of array
+ */
+template <class T>
+int BTreeIndex::findArrayIndex(const T *arr, int len, const T &key,
+                               bool includeKey) {
+  const T *found = includeKey ? lower_bound(arr, &arr[len], key)
+                              : upper_bound(arr, &arr[len], key);
+  int result = found - arr;
+  return result >= len ? -1 : result;
+}
+
+#if defined(__x86_64__)
+/**
+ * Count the keys of a short array not larger than the bound, eight at a
+ * time, on a processor with AVX2.
+ */
+__attribute__((target("avx2"))) static int countNotLargerAvx2(
+    const int *keys, int n, int bound) {
+  int count = 0;
+  int i = 0;
+  const __m256i bound8 = _mm256_set1_epi32(bound);
+  for (; i + 8 <= n; i += 8) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)&keys[i]);
+    __m256i larger = _mm256_cmpgt_epi32(block, bound8);
+    count += 8 - __builtin_popcount(
+                     _mm256_movemask_ps(_mm256_castsi256_ps(larger)));
+  }
+  for (; i < n; i++) count += keys[i] <= bound;
+  return count;
+}
+#endif
+
+/**
+ * Count the keys of a short array not larger than the bound, a vector at a
+ * time: eight keys if the processor has AVX2, whatever the build targets,
+ * otherwise four.
+ *
+ * @param keys an array of keys
+ * @param n the length of the array
+ * @param bound the bound
+ * @return the number of keys not larger than bound
+ */
+static int countNotLarger(const int *keys, int n, int bound) {
+#if defined(__x86_64__)
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  if (avx2) return countNotLargerAvx2(keys, n, bound);
+#endif
+  int count = 0;
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128i bound4 = _mm_set1_epi32(bound);
+  for (; i + 4 <= n; i += 4) {
+    __m128i block = _mm_loadu_si128((const __m128i *)&keys[i]);
+    __m128i larger = _mm_cmpgt_epi32(block, bound4);
+    count +=
+        4 - __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(larger)));
+  }
+#endif
+  for (; i < n; i++) count += keys[i] <= bound;
+  return count;
+}
+
+/**
+ * Search a sorted array of INTEGER keys, narrowing the range by binary search
+ * and then comparing the remaining keys a vector at a time.
+ *
+ * @param arr a sorted key array
+ * @param len the length of the array
+ * @param key the target key
+ * @param includeKey whether keys equal to the target key are included
+ * @return the index of the first key larger than (or equal to, if includeKey)
+ *         the given key, or len if there is none
+ */
+int searchIntArray(const int *arr, int len, int key, bool includeKey) {
+  // keys before the result are smaller than the key, or equal to it if it is
+  // not included; comparing with key - 1 turns the second case into the first
+  // except when key is the smallest int, before which nothing comes
+  if (includeKey && key == numeric_limits<int>::min()) return 0;
+  const int bound = includeKey ? key - 1 : key;
+
+  // the result lies in [base, base + n]
+  const int *base = arr;
+  int n = len;
+  while (n > INTSEARCHBLOCKSIZE) {
+    const int half = n / 2;
+    if (base[half - 1] <= bound) {
+      base += half;
+      n -= half;
+    } else {
+      n = half;
+    }
+  }
+
+  // count the keys of the block not larger than bound
+  return (base - arr) + countNotLarger(base, n, bound);
+}
+
+void indexIntKeys(const int *arr, int len, int *blockKeys, int *lineKeys) {
+  const int numBlocks = (len + INTKEYBLOCKSIZE - 1) / INTKEYBLOCKSIZE;
+  for (int b = 0; b < numBlocks; b++) blockKeys[b] = arr[b * INTKEYBLOCKSIZE];
+  for (int l = 0; l * INTKEYBLOCKSIZE < numBlocks; l++)
+    lineKeys[l] = blockKeys[l * INTKEYBLOCKSIZE];
+}
+
+int searchIntDirectory(const int *arr, int len, const int *blockKeys,
+                       const int *lineKeys, const PageId *pageNos, int key,
+                       bool includeKey) {
+  if (includeKey && key == numeric_limits<int>::min()) return 0;
+  const int bound = includeKey ? key - 1 : key;
+  const int numBlocks = (len + INTKEYBLOCKSIZE - 1) / INTKEYBLOCKSIZE;
+  const int numLines = (numBlocks + INTKEYBLOCKSIZE - 1) / INTKEYBLOCKSIZE;
+
+  // the lines of the first level are fetched while the second is searched,
+  // up to the number a core keeps in flight comfortably
+  for (int l = 0; l < numLines && l < 4; l++)
+    __builtin_prefetch(&blockKeys[l * INTKEYBLOCKSIZE]);
+
+  // keys before the first entry of a level belong to its first line or
+  // block anyway, so each level is searched past its first entry
+  const int line = numLines > 1
+                       ? countNotLarger(lineKeys + 1, numLines - 1, bound)
+                       : 0;
+  const int firstBlock = line * INTKEYBLOCKSIZE;
+  const int lineBlocks = min(INTKEYBLOCKSIZE, numBlocks - firstBlock);
+  const int block =
+      firstBlock + (lineBlocks > 1 ? countNotLarger(blockKeys + firstBlock + 1,
+                                                    lineBlocks - 1, bound)
+                                   : 0);
+  const int first = block * INTKEYBLOCKSIZE;
+  if (pageNos != NULL) __builtin_prefetch(&pageNos[first]);
+  const int result =
+      first + countNotLarger(arr + first, min(INTKEYBLOCKSIZE, len - first),
+                             bound);
+
+  // the keys around the result tell whether the directory was stale
+  if ((result > 0 && arr[result - 1] > bound) ||
+      (result < len && arr[result] <= bound))
+    return searchIntArray(arr, len, key, includeKey);
+  return result;
+}
+
+/**
+ * Search an array of INTEGER keys with searchIntArray().
+ */
+template <>
+int BTreeIndex::findArrayIndex<int>(const int *arr, int len, const int &key,
+                                    bool includeKey) {
+  int result = searchIntArray(arr, len, key, includeKey);
+  return result >= len ? -1 : result;
+}
+
+/**
+ * Find the index of the first key smaller than the given key
+ *
+ * Assumption: All keys are sorted in the node.
+ *
+ * @param node an internal node
+ * @param key the key to find
+ * @return the index of the first key smaller than the given key
+ *         return the largest index if not found
+ */
+template <class T>
+int BTreeIndex::findIndexNonLeaf(NonLeafNode<T> *node, const T &key) {
+  int len = getNonLeafLen(node);
+  int result = findArrayIndex(node->keyArray, len - 1, key);
+  return result == -1 ? len - 1 : result;
+}
+
+/**
+ * Find the child of an internal node with INTEGER keys through its
+ * directory.
+ */
+template <>
+int BTreeIndex::findIndexNonLeaf<int>(NonLeafNode<int> *node,
+                                      const int &key) {
+  return searchIntDirectory(node->keyArray, node->numKeys, node->blockKeys,
+                            node->lineKeys, node->pageNoArray, key, true);
+}
+
+/**
+ * Find the insertaion index for a key in a leaf node
+ *
+ * Assumption: All keys are sorted in the node.
+ *
+ * @param node a leaf node
+ * @param key the key to be inserted
+ *
+ * @return the insertaion index for a key in a leaf node
+ */
+template <class T>
+int BTreeIndex::findInsertionIndexLeaf(LeafNode<T> *node, const T &key) {
+  int result = findScanIndexLeaf(node, key, true);
+  return result == -1 ? getLeafLen(node) : result;
+}
+
+/**
+ * Find the index of the first key larger than the given key in the leaf node
+ *
+ * Assumption: All keys are sorted in the node.
+ *
+ * @param node a leaf node
+ * @param key the key to find
+ * @param includeKey whether the current key is included
+ *
+ * @return a. the index of the first integer larger than the given key if
+ *            includeKey = false
+ *         b. the index of the first integer larger than or equal to the
+ *            given key if includeKey = true
+ *         c. -1 if the key is not found till the end of array
+ */
+template <class T>
+int BTreeIndex::findScanIndexLeaf(LeafNode<T> *node, const T &key,
+                                  bool includeKey) {
+  return findArrayIndex(node->keyArray, getLeafLen(node), key, includeKey);
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// #########################   Insert Helper   ######################### //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+/**
+ * Inserts the given key-record pair into the leaf node at the given insertion
+ * index.
+ *
+ * @param node a leaf node
+ * @param i the insertion index
+ * @param key the key of the key-record pair to be inserted
+ * @param rid the record ID of the key-record pair to be inserted
+ * @param columns the covered columns of the entry, or NULL
+ */
+template <class T>
+void BTreeIndex::insertToLeafNode(LeafNode<T> *node, int i, const T &key,
+                                  RecordId rid, const char *columns) {
+  insertLeafColumns(node, i, node->numKeys, columns);
+  const size_t len = node->numKeys - i;
+
+  // shift items to add space for the new element
+  memmove(&node->keyArray[i + 1], &node->keyArray[i], len * sizeof(T));
+  memmove(&node->ridArray[i + 1], &node->ridArray[i], len * sizeof(RecordId));
+
+  // save the key and record id to the leaf node
+  node->keyArray[i] = key;
+  node->ridArray[i] = rid;
+  node->numKeys++;
+}
+
+/**
+ * Appends the given key-record pair to the leaf node, after its last entry.
+ *
+ * @param node a leaf node
+ * @param len the number of entries in the leaf node
+ * @param key the key of the key-record pair to be appended
+ * @param rid the record ID of the key-record pair to be appended
+ * @param columns the covered columns of the entry, or NULL
+ */
+template <class T>
+void BTreeIndex::appendToLeafNode(LeafNode<T> *node, int len, const T &key,
+                                  RecordId rid, const char *columns) {
+  insertLeafColumns(node, len, len, columns);
+  node->keyArray[len] = key;
+  node->ridArray[len] = rid;
+  node->numKeys = len + 1;
+}
+
+/**
+ * Removes the key-record pair at the given index from the leaf node.
+ *
+ * @param node a leaf node
+ * @param i the index of the pair to be removed
+ */
+template <class T>
+void BTreeIndex::removeFromLeafNode(LeafNode<T> *node, int i) {
+  removeLeafColumns(node, i, node->numKeys);
+  const size_t len = node->numKeys - i - 1;
+
+  // shift items to fill the space of the removed element
+  memmove(&node->keyArray[i], &node->keyArray[i + 1], len * sizeof(T));
+  memmove(&node->ridArray[i], &node->ridArray[i + 1], len * sizeof(RecordId));
+
+  node->numKeys--;
+  memset(&node->keyArray[node->numKeys], 0, sizeof(T));
+  memset(&node->ridArray[node->numKeys], 0, sizeof(RecordId));
+}
+
+/**
+ * Removes the key at the given index and the page number after it from the
+ * internal node.
+ *
+ * @param n an internal node
+ * @param i the index of the key to be removed
+ */
+template <class T>
+void BTreeIndex::removeFromNonLeafNode(NonLeafNode<T> *n, int i) {
+  const size_t len = n->numKeys - i - 1;
+
+  // shift items to fill the space of the removed element
+  memmove(&n->keyArray[i], &n->keyArray[i + 1], len * sizeof(T));
+  memmove(&n->pageNoArray[i + 1], &n->pageNoArray[i + 2], len * sizeof(PageId));
+
+  n->numKeys--;
+  memset(&n->keyArray[n->numKeys], 0, sizeof(T));
+  n->pageNoArray[n->numKeys + 1] = 0;
+  indexNonLeaf(n);
+}
+
+/**
+ * Inserts the given key-(page number) pair into the given leaf node at the
+ * given index.
+ *
+ * @param n an internal node
+ * @param i the insertion index
+ * @param key the key of the key-(page number) pair
+ * @param pid the page number of the key-(page number) pair
+ */
+template <class T>
+void BTreeIndex::insertToNonLeafNode(NonLeafNode<T> *n, int i, const T &key,
+                                     PageId pid) {
+  const size_t len = n->numKeys - i;
+
+  // shift items to add space for the new element
+  memmove(&n->keyArray[i + 1], &n->keyArray[i], len * sizeof(T));
+  memmove(&n->pageNoArray[i + 2], &n->pageNoArray[i + 1], len * sizeof(PageId));
+
+  // store the key and page number to the node
+  n->keyArray[i] = key;
+  n->pageNoArray[i + 1] = pid;
+  n->numKeys++;
+  indexNonLeaf(n);
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// ##########################   Split Helper   ######################### //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+/**
+ * Splits a leaf node into two.
+ * It moves the records after the given index in the node into the new node.
+ *
+ * @param node a pointer to the original node
+ * @param newNode a pointer to the new node
  * @param index the index where the split occurs.
  */
-void BTreeIndex::splitLeafNode(LeafNodeInt *node, LeafNodeInt *newNode,
-                               int index) {
-  const size_t len = INTARRAYLEAFSIZE - index;
+template <class T>
+void BTreeIndex::splitLeafNode(LeafNode<T> *node, LeafNode<T> *newNode,
+                               int index) {
+  count(LEAF_SPLITS);
+  TRACE_SCOPE("splitLeaf", "index", "entries", node->numKeys, "index", index);
+  splitLeafColumns(node, newNode, index, node->numKeys);
+  const size_t len = node->numKeys - index;
+
+  // copy elements from old node to new node
+  memcpy(&newNode->keyArray, &node->keyArray[index], len * sizeof(T));
+  memcpy(&newNode->ridArray, &node->ridArray[index], len * sizeof(RecordId));
+  newNode->numKeys = len;
+
+  // remove elements from old node
+  memset(&node->keyArray[index], 0, len * sizeof(T));
+  memset(&node->ridArray[index], 0, len * sizeof(RecordId));
+  node->numKeys = index;
+}
+
+/**
+ * Split the internal node by the given index. It moves the values stored in the
+ * given node after the split index into a new internal node.
+ *
+ * @param node an internal node
+ * @param i the index where the split occurs.
+ * @param keepMidKey Whether the value at the index should be moved to the
+ * parent internal node or not. If keepMidKey is true, then the pair at the
+ * index does not need to be moved up and will be moved to the newly created
+ *                   internal node, whose first page number is left for
+ *                   the caller to set.
+ *
+ * @return a pointer to the newly created internal node.
+ */
+template <class T>
+void BTreeIndex::splitNonLeafNode(NonLeafNode<T> *curr, NonLeafNode<T> *next,
+                                  int i, bool keepMidKey) {
+  count(NONLEAF_SPLITS);
+  TRACE_SCOPE("splitNonLeaf", "index", "keys", curr->numKeys, "index", i);
+  size_t len = curr->numKeys - i;
+
+  // copy keys from old node to new node
+  if (keepMidKey)
+    memcpy(&next->keyArray, &curr->keyArray[i], len * sizeof(T));
+  else
+    memcpy(&next->keyArray, &curr->keyArray[i + 1], (len - 1) * sizeof(T));
+  next->numKeys = keepMidKey ? len : len - 1;
+
+  // copy values from old node to new node, leaving the first slot for the
+  // page of the key moved up if the key at the index is kept
+  memcpy(&next->pageNoArray[keepMidKey], &curr->pageNoArray[i + 1],
+         len * sizeof(PageId));
+
+  // remove elements from old node
+  memset(&curr->keyArray[i], 0, len * sizeof(T));
+  memset(&curr->pageNoArray[i + 1], 0, len * sizeof(PageId));
+  curr->numKeys = i;
+  indexNonLeaf(curr);
+  indexNonLeaf(next);
+}
+
+/**
+ * Create a new root with midVal, pid1 and pid2.
+ *
+ * @param midVal the first middle value of the new root
+ * @param pid1 the first page number in the new root
+ * @param pid2 the second page number in the new root
+ *
+ * @return the page id of the new root
+ */
+template <class T>
+PageId BTreeIndex::splitRoot(const T &midVal, PageId pid1, PageId pid2) {
+  count(ROOT_SPLITS);
+  TRACE_SCOPE("splitRoot", "index", "left", pid1, "right", pid2);
+  // alloc a new page for root
+  PageId newRootPageId;
+  NonLeafNode<T> *newRoot = allocNonLeafNode<T>(newRootPageId);
+
+  // set key and page numbers
+  newRoot->keyArray[0] = midVal;
+  newRoot->pageNoArray[0] = pid1;
+  newRoot->pageNoArray[1] = pid2;
+  newRoot->numKeys = 1;
+  indexNonLeaf(newRoot);
+
+  // unpin the root page
+  bufMgr->unPinPage(file, newRootPageId, true);
+
+  return newRootPageId;
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// #######################   String Leaf Helper   ###################### //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+/**
+ * Returns the size of an entry of a STRING leaf whose keys share a prefix of
+ * the given length.
+ */
+static inline int stringEntrySize(int prefixLen) {
+  return sizeof(RecordId) + STRINGSIZE - prefixLen;
+}
+
+/**
+ * Returns the number of entries of a STRING leaf whose keys share a prefix of
+ * the given length, and whose entries have covered columns of the given size
+ * stored from the end of the data backwards.
+ */
+static inline int stringLeafCapacity(int prefixLen, int coveredSize) {
+  return min(STRINGARRAYLEAFMAXSIZE,
+             STRINGLEAFDATASIZE / (stringEntrySize(prefixLen) + coveredSize));
+}
+
+/**
+ * Returns the length of the prefix the keys of the leaf share once the given
+ * key is stored in it.
+ */
+static int commonPrefixLen(const LeafNode<StringKey> *node,
+                           const StringKey &key) {
+  if (node->numKeys == 0) return STRINGSIZE;
+  int len = 0;
+  while (len < node->prefixLen && node->prefix[len] == key.data[len]) len++;
+  return len;
+}
+
+/**
+ * Rewrites the entries of the leaf for a shared prefix of the given length,
+ * taken from its first key.
+ *
+ * Assumption: The first prefixLen characters of every key are the same.
+ */
+static void setStringLeafPrefix(LeafNode<StringKey> *node, int prefixLen) {
+  LeafNode<StringKey> old;
+  memcpy(reinterpret_cast<char *>(&old),
+         reinterpret_cast<const char *>(node), sizeof(old));
+
+  const int oldSize = stringEntrySize(old.prefixLen);
+  const int newSize = stringEntrySize(prefixLen);
+  StringKey key;
+  memcpy(key.data, old.prefix, old.prefixLen);
+  for (int i = 0; i < old.numKeys; i++) {
+    const char *oldEntry = &old.data[i * oldSize];
+    char *newEntry = &node->data[i * newSize];
+    memcpy(key.data + old.prefixLen, oldEntry + sizeof(RecordId),
+           STRINGSIZE - old.prefixLen);
+    if (i == 0) memcpy(node->prefix, key.data, STRINGSIZE);
+    memcpy(newEntry, oldEntry, sizeof(RecordId));
+    memcpy(newEntry + sizeof(RecordId), key.data + prefixLen,
+           STRINGSIZE - prefixLen);
+  }
+
+  // the covered columns at the end of the data stay where they are
+  node->prefixLen = prefixLen;
+  if (newSize < oldSize)
+    memset(&node->data[old.numKeys * newSize], 0,
+           old.numKeys * (oldSize - newSize));
+  memset(&node->prefix[prefixLen], 0, STRINGSIZE - prefixLen);
+}
+
+/**
+ * Lengthens the prefix of the leaf to the prefix shared by its first and last
+ * keys, which all its keys share since they are sorted.
+ */
+static void growStringLeafPrefix(LeafNode<StringKey> *node) {
+  const int size = stringEntrySize(node->prefixLen);
+  const char *first = &node->data[sizeof(RecordId)];
+  const char *last = &node->data[(node->numKeys - 1) * size + sizeof(RecordId)];
+
+  int len = node->prefixLen;
+  while (len < STRINGSIZE &&
+         first[len - node->prefixLen] == last[len - node->prefixLen])
+    len++;
+  if (len > node->prefixLen) setStringLeafPrefix(node, len);
+}
+
+template <>
+bool BTreeIndex::isLeafNodeFull<StringKey>(LeafNode<StringKey> *node,
+                                           const StringKey &key) {
+  return node->numKeys >= getLeafCapacity(node, key);
+}
+
+template <>
+int BTreeIndex::getLeafCapacity<StringKey>(LeafNode<StringKey> *node,
+                                           const StringKey &key) {
+  return stringLeafCapacity(commonPrefixLen(node, key), coveredSize);
+}
+
+/**
+ * Returns the number of entries a STRING leaf holds at most, once all of its
+ * keys are the same.
+ */
+template <>
+int BTreeIndex::maxLeafCapacity<StringKey>() {
+  return stringLeafCapacity(STRINGSIZE, coveredSize);
+}
+
+template <>
+StringKey BTreeIndex::getLeafKey<StringKey>(LeafNode<StringKey> *node, int i) {
+  const char *entry = &node->data[i * stringEntrySize(node->prefixLen)];
+  StringKey key;
+  memcpy(key.data, node->prefix, node->prefixLen);
+  memcpy(key.data + node->prefixLen, entry + sizeof(RecordId),
+         STRINGSIZE - node->prefixLen);
+  return key;
+}
+
+template <>
+RecordId BTreeIndex::getLeafRid<StringKey>(LeafNode<StringKey> *node, int i) {
+  RecordId rid;
+  memcpy(&rid, &node->data[i * stringEntrySize(node->prefixLen)],
+         sizeof(RecordId));
+  return rid;
+}
+
+/**
+ * Find the index of the first key larger than the given key in a STRING leaf.
+ * The key is compared with the shared prefix once, and then only with the
+ * suffixes of the entries.
+ */
+template <>
+int BTreeIndex::findScanIndexLeaf<StringKey>(LeafNode<StringKey> *node,
+                                             const StringKey &key,
+                                             bool includeKey) {
+  const int len = node->numKeys;
+  const int cmp = memcmp(key.data, node->prefix, node->prefixLen);
+  if (cmp < 0) return len == 0 ? -1 : 0;
+  if (cmp > 0) return -1;
+
+  const int size = stringEntrySize(node->prefixLen);
+  const int suffixLen = STRINGSIZE - node->prefixLen;
+  const char *suffix = key.data + node->prefixLen;
+  int low = 0;
+  int high = len;
+  while (low < high) {
+    const int mid = (low + high) / 2;
+    const int c =
+        memcmp(&node->data[mid * size + sizeof(RecordId)], suffix, suffixLen);
+    if (c < 0 || (c == 0 && !includeKey))
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low >= len ? -1 : low;
+}
+
+/**
+ * Inserts the given key-record pair into a STRING leaf, shortening the shared
+ * prefix first if the key does not start with it.
+ */
+template <>
+void BTreeIndex::insertToLeafNode<StringKey>(LeafNode<StringKey> *node, int i,
+                                             const StringKey &key,
+                                             RecordId rid,
+                                             const char *columns) {
+  insertLeafColumns(node, i, node->numKeys, columns);
+  const int prefixLen = commonPrefixLen(node, key);
+  if (node->numKeys == 0) {
+    memcpy(node->prefix, key.data, STRINGSIZE);
+    node->prefixLen = STRINGSIZE;
+  } else if (prefixLen < node->prefixLen) {
+    setStringLeafPrefix(node, prefixLen);
+  }
+
+  // shift entries to add space for the new entry
+  const int size = stringEntrySize(node->prefixLen);
+  char *entry = &node->data[i * size];
+  memmove(entry + size, entry, (node->numKeys - i) * size);
+
+  memcpy(entry, &rid, sizeof(RecordId));
+  memcpy(entry + sizeof(RecordId), key.data + node->prefixLen,
+         STRINGSIZE - node->prefixLen);
+  node->numKeys++;
+}
+
+template <>
+void BTreeIndex::appendToLeafNode<StringKey>(LeafNode<StringKey> *node,
+                                             int len, const StringKey &key,
+                                             RecordId rid,
+                                             const char *columns) {
+  insertToLeafNode(node, len, key, rid, columns);
+}
+
+/**
+ * Removes an entry from a STRING leaf. The remaining keys may then share a
+ * longer prefix.
+ */
+template <>
+void BTreeIndex::removeFromLeafNode<StringKey>(LeafNode<StringKey> *node,
+                                               int i) {
+  removeLeafColumns(node, i, node->numKeys);
+  const int size = stringEntrySize(node->prefixLen);
+  char *entry = &node->data[i * size];
+  memmove(entry, entry + size, (node->numKeys - i - 1) * size);
+
+  node->numKeys--;
+  memset(&node->data[node->numKeys * size], 0, size);
+  if (node->numKeys > 0) growStringLeafPrefix(node);
+}
+
+/**
+ * Splits a STRING leaf into two. Either half may then share a longer prefix.
+ */
+template <>
+void BTreeIndex::splitLeafNode<StringKey>(LeafNode<StringKey> *node,
+                                          LeafNode<StringKey> *newNode,
+                                          int index) {
+  count(LEAF_SPLITS);
+  TRACE_SCOPE("splitLeaf", "index", "entries", node->numKeys, "index", index);
+  splitLeafColumns(node, newNode, index, node->numKeys);
+  const int size = stringEntrySize(node->prefixLen);
+  const int len = node->numKeys - index;
+
+  // copy entries from old node to new node
+  newNode->numKeys = len;
+  newNode->prefixLen = node->prefixLen;
+  memcpy(newNode->prefix, node->prefix, STRINGSIZE);
+  memcpy(newNode->data, &node->data[index * size], len * size);
+
+  // remove entries from old node
+  memset(&node->data[index * size], 0, len * size);
+  node->numKeys = index;
+
+  growStringLeafPrefix(node);
+  growStringLeafPrefix(newNode);
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// ########################    Posting List    ######################### //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+/**
+ * Returns true if the record id of a leaf entry stands for a posting list.
+ */
+static inline bool isPostingList(const RecordId &rid) {
+  return rid.slot_number == POSTINGLISTSLOT;
+}
+
+/**
+ * Returns the position of a record id in the order of posting lists, by page
+ * number and then by slot number.
+ */
+static inline std::uint64_t ridOrdinal(const RecordId &rid) {
+  return ((std::uint64_t)rid.page_number << 16) | rid.slot_number;
+}
+
+/**
+ * Returns true if the first record id comes before the second one.
+ */
+static bool ridLess(const RecordId &r1, const RecordId &r2) {
+  return ridOrdinal(r1) < ridOrdinal(r2);
+}
+
+/**
+ * Returns the number of bytes of the varint encoding of a value.
+ */
+static inline int varintSize(std::uint64_t value) {
+  int size = 1;
+  for (; value >= 0x80; value >>= 7) size++;
+  return size;
+}
+
+/**
+ * Append a record id, not smaller than the last one, to a posting list page,
+ * encoded as its difference from the last one.
+ *
+ * @return false if the page has no room for it
+ */
+static bool appendToPostingPage(PostingPage *page, const RecordId &rid) {
+  std::uint64_t delta =
+      ridOrdinal(rid) - (page->numRids == 0 ? 0 : ridOrdinal(page->lastRid));
+  if (page->numBytes + varintSize(delta) > POSTINGDATASIZE) return false;
+
+  unsigned char *out = &page->data[page->numBytes];
+  for (; delta >= 0x80; delta >>= 7) *out++ = (unsigned char)(delta | 0x80);
+  *out++ = (unsigned char)delta;
+  page->numBytes = out - page->data;
+  page->numRids++;
+  page->lastRid = rid;
+  return true;
+}
+
+/**
+ * Replace the record ids of a posting list page with as many of the given
+ * sorted ones as fit.
+ *
+ * @return the number of record ids stored
+ */
+static int fillPostingPage(PostingPage *page, const RecordId *rids, int n) {
+  memset(page->data, 0, POSTINGDATASIZE);
+  page->numRids = 0;
+  page->numBytes = 0;
+  int i = 0;
+  while (i < n && appendToPostingPage(page, rids[i])) i++;
+  return i;
+}
+
+/**
+ * Pass the record ids of a posting list page to emit, in order.
+ */
+template <class Emit>
+static void decodePostingPage(const PostingPage *page, Emit &&emit) {
+  const unsigned char *in = page->data;
+  std::uint64_t ordinal = 0;
+  for (int i = 0; i < page->numRids; i++) {
+    std::uint64_t delta = 0;
+    for (int shift = 0;; shift += 7) {
+      delta |= (std::uint64_t)(*in & 0x7f) << shift;
+      if (!(*in++ & 0x80)) break;
+    }
+    ordinal += delta;
+    emit(RecordId{(PageId)(ordinal >> 16), (SlotId)(ordinal & 0xffff)});
+  }
+}
+
+/**
+ * Returns the record ids of a posting list page, in order.
+ */
+static vector<RecordId> postingPageRids(const PostingPage *page) {
+  vector<RecordId> rids;
+  rids.reserve(page->numRids + 1);
+  decodePostingPage(page, [&](RecordId rid) { rids.push_back(rid); });
+  return rids;
+}
+
+/**
+ * Create a posting list holding the given record ids, and record in the meta
+ * page that the index file has posting lists.
+ *
+ * @param rids the record ids, sorted
+ * @param n the number of record ids, at least one
+ * @return the page number of the first page of the list
+ */
+PageId BTreeIndex::createPostingList(const RecordId *rids, std::size_t n) {
+  PageId headPageNo;
+  PostingPage *head = allocPostingPage(headPageNo);
+  head->lastPageNo = headPageNo;
+  bufMgr->unPinPage(file, headPageNo, true);
+  appendPostingRids(headPageNo, rids, n);
+
+  std::unique_lock<std::mutex> lock = latchMeta();
+  if (!indexMetaInfo.hasPostingLists) {
+    indexMetaInfo.hasPostingLists = true;
+    writeMetaInfo();
+  }
+  return headPageNo;
+}
+
+/**
+ * Link a new page into a posting list after the given one.
+ *
+ * @param head the first page of the list, pinned
+ * @param pageNo the page number of the page the new one follows
+ * @param page that page, pinned
+ * @param newPageNo set to the page number of the new page
+ * @return the new page, pinned, to be unpinned dirty
+ */
+PageHandle BTreeIndex::linkPostingPage(PostingPage *head, PageId pageNo,
+                                       PostingPage *page,
+                                       PageId &newPageNo) {
+  PageHandle newHandle(bufMgr, (Page *)allocPostingPage(newPageNo));
+  newHandle.markDirty();
+  PostingPage *newPage = newHandle.as<PostingPage>();
+  newPage->prevPageNo = pageNo;
+  newPage->nextPageNo = page->nextPageNo;
+  page->nextPageNo = newPageNo;
+  if (newPage->nextPageNo == 0) {
+    head->lastPageNo = newPageNo;
+  } else {
+    PageHandle next = pinHandle(newPage->nextPageNo);
+    next.as<PostingPage>()->prevPageNo = newPageNo;
+    next.markDirty();
+  }
+  return newHandle;
+}
+
+/**
+ * Append record ids to the end of a posting list, filling its last page and
+ * then new pages.
+ *
+ * @param headPageNo the page number of the first page of the list
+ * @param rids the record ids, sorted and none smaller than those of the list
+ * @param n the number of record ids
+ */
+void BTreeIndex::appendPostingRids(PageId headPageNo, const RecordId *rids,
+                                   std::size_t n) {
+  PageHandle head = pinHandle(headPageNo);
+  head.markDirty();
+  PageId pageNo = head.as<PostingPage>()->lastPageNo;
+  PageHandle last;
+  if (pageNo != headPageNo) {
+    last = pinHandle(pageNo);
+    last.markDirty();
+  }
+  PostingPage *page = last ? last.as<PostingPage>() : head.as<PostingPage>();
+
+  for (std::size_t i = 0; i < n; i++) {
+    if (appendToPostingPage(page, rids[i])) continue;
+    PageId newPageNo;
+    last = linkPostingPage(head.as<PostingPage>(), pageNo, page, newPageNo);
+    pageNo = newPageNo;
+    page = last.as<PostingPage>();
+    appendToPostingPage(page, rids[i]);
+  }
+  head.as<PostingPage>()->totalRids += n;
+}
+
+/**
+ * Find the page of a posting list that holds, or would hold, a record id: the
+ * first page whose last record id is not smaller than it, or else the last
+ * page.
+ *
+ * @param head the first page of the list, pinned
+ * @param headPageNo the page number of the first page
+ * @param rid the record id
+ * @param pageNo set to the page number of the page
+ * @param page set to the page, pinned again if it is the first page
+ */
+void BTreeIndex::findPostingPage(PostingPage *head, PageId headPageNo,
+                                 const RecordId &rid, PageId &pageNo,
+                                 PageHandle &page) {
+  pageNo = headPageNo;
+  page = pinHandle(pageNo);
+  while (page.as<PostingPage>()->nextPageNo != 0 &&
+         ridLess(page.as<PostingPage>()->lastRid, rid)) {
+    pageNo = page.as<PostingPage>()->nextPageNo;
+    page.release();
+    page = pinHandle(pageNo);
+  }
+}
+
+/**
+ * Insert a record id into a posting list. It is appended to the page it
+ * belongs in if it comes after all of its record ids, and else the page is
+ * rewritten with it, moving half of the record ids to a new page if they no
+ * longer fit.
+ *
+ * @param headPageNo the page number of the first page of the list
+ * @param rid the record id
+ */
+void BTreeIndex::insertPostingRid(PageId headPageNo, RecordId rid) {
+  PageHandle headHandle = pinHandle(headPageNo);
+  headHandle.markDirty();
+  PostingPage *head = headHandle.as<PostingPage>();
+  PageId pageNo;
+  PageHandle pageHandle;
+  findPostingPage(head, headPageNo, rid, pageNo, pageHandle);
+  pageHandle.markDirty();
+  PostingPage *page = pageHandle.as<PostingPage>();
+  head->totalRids++;
+
+  const bool atEnd = !ridLess(rid, page->lastRid);
+  if (atEnd && appendToPostingPage(page, rid)) {
+  } else if (atEnd && page->nextPageNo == 0) {
+    // the last page is full
+    PageId newPageNo;
+    PageHandle newPage = linkPostingPage(head, pageNo, page, newPageNo);
+    appendToPostingPage(newPage.as<PostingPage>(), rid);
+  } else {
+    vector<RecordId> rids = postingPageRids(page);
+    rids.insert(upper_bound(rids.begin(), rids.end(), rid, ridLess), rid);
+    const int n = rids.size();
+    if (fillPostingPage(page, rids.data(), n) < n) {
+      PageId newPageNo;
+      PageHandle newPage = linkPostingPage(head, pageNo, page, newPageNo);
+      fillPostingPage(page, rids.data(), n / 2);
+      fillPostingPage(newPage.as<PostingPage>(), rids.data() + n / 2,
+                      n - n / 2);
+    }
+  }
+}
+
+/**
+ * Remove a record id from a posting list. A page left empty is unlinked and
+ * freed, except for the first page, which takes over the record ids of the
+ * second one so that the leaf entry of the list stays valid. A list left
+ * empty is freed.
+ *
+ * @param headPageNo the page number of the first page of the list
+ * @param rid the record id
+ * @param emptied set to true if the list was left empty and freed
+ * @return true if the record id was found and removed
+ */
+bool BTreeIndex::removePostingRid(PageId headPageNo, RecordId rid,
+                                  bool &emptied) {
+  emptied = false;
+  PageHandle headHandle = pinHandle(headPageNo);
+  PostingPage *head = headHandle.as<PostingPage>();
+  PageId pageNo;
+  PageHandle pageHandle;
+  findPostingPage(head, headPageNo, rid, pageNo, pageHandle);
+  PostingPage *page = pageHandle.as<PostingPage>();
+
+  vector<RecordId> rids = postingPageRids(page);
+  auto it = lower_bound(rids.begin(), rids.end(), rid, ridLess);
+  if (it == rids.end() || *it != rid) return false;
+  rids.erase(it);
+  head->totalRids--;
+  headHandle.markDirty();
+  pageHandle.markDirty();
+
+  if (!rids.empty()) {
+    // the differences of the remaining record ids take no more room
+    fillPostingPage(page, rids.data(), rids.size());
+  } else if (pageNo != headPageNo) {
+    const PageId prevPageNo = page->prevPageNo;
+    const PageId nextPageNo = page->nextPageNo;
+    freeNode(pageNo, pageHandle.detach());
+
+    {
+      PageHandle prev = pinHandle(prevPageNo);
+      prev.as<PostingPage>()->nextPageNo = nextPageNo;
+      prev.markDirty();
+    }
+    if (nextPageNo == 0) {
+      head->lastPageNo = prevPageNo;
+    } else {
+      PageHandle next = pinHandle(nextPageNo);
+      next.as<PostingPage>()->prevPageNo = prevPageNo;
+      next.markDirty();
+    }
+  } else if (head->nextPageNo != 0) {
+    pageHandle.release();
+    const PageId secondPageNo = head->nextPageNo;
+    PageHandle secondHandle = pinHandle(secondPageNo);
+    PostingPage *second = secondHandle.as<PostingPage>();
+    head->numRids = second->numRids;
+    head->numBytes = second->numBytes;
+    head->lastRid = second->lastRid;
+    memcpy(head->data, second->data, POSTINGDATASIZE);
+    head->nextPageNo = second->nextPageNo;
+    freeNode(secondPageNo, secondHandle.detach());
+
+    if (head->nextPageNo == 0) {
+      head->lastPageNo = headPageNo;
+    } else {
+      PageHandle next = pinHandle(head->nextPageNo);
+      next.as<PostingPage>()->prevPageNo = headPageNo;
+      next.markDirty();
+    }
+  } else {
+    pageHandle.release();
+    freeNode(headPageNo, headHandle.detach());
+    emptied = true;
+  }
+  return true;
+}
+
+/**
+ * Pass every record id of a posting list to emit, decoding its pages in turn.
+ * The page being decoded is unpinned if emit throws.
+ *
+ * @param headPageNo the page number of the first page of the list
+ * @param emit called with each record id
+ * @return the number of record ids of the list
+ */
+template <class Emit>
+std::size_t BTreeIndex::forEachPostingRid(PageId headPageNo, Emit &emit) {
+  std::size_t count = 0;
+  for (PageId pageNo = headPageNo; pageNo != 0;) {
+    PageHandle handle = pinHandle(pageNo);
+    PostingPage *page = handle.as<PostingPage>();
+    decodePostingPage(page, emit);
+    count += page->numRids;
+    pageNo = page->nextPageNo;
+  }
+  return count;
+}
+
+/**
+ * Insert the given key-record pair into a leaf without splitting it. The
+ * entries of the key are looked through for a posting list to insert the
+ * record id into. If there is none and the leaf is full, the entries of the
+ * key are moved to a new posting list if they fill half of the leaf, which
+ * makes room without a split.
+ *
+ * @param node a leaf node
+ * @param key the key of the key-record pair
+ * @param rid the record id of the key-record pair
+ * @return false if the leaf is full and must be split
+ */
+template <class T>
+bool BTreeIndex::tryInsertToLeaf(LeafNode<T> *node, const T &key,
+                                 RecordId rid) {
+  const int len = getLeafLen(node);
+  const int begin = findInsertionIndexLeaf(node, key);
+  int end = begin;
+  for (; end < len && getLeafKey(node, end) == key; end++) {
+    const RecordId entryRid = getLeafRid(node, end);
+    if (isPostingList(entryRid)) {
+      insertPostingRid(entryRid.page_number, rid);
+      return true;
+    }
+  }
+
+  if (!isLeafNodeFull(node, key)) {
+    char columns[MAXCOVEREDSIZE];
+    insertToLeafNode(node, begin, key, rid, readCoveredColumns(rid, columns));
+    return true;
+  }
+  if (end - begin < KeyTraits<T>::MINPOSTINGSIZE || coveredSize > 0)
+    return false;
+
+  vector<RecordId> rids;
+  for (int i = begin; i < end; i++) rids.push_back(getLeafRid(node, i));
+  rids.push_back(rid);
+  sort(rids.begin(), rids.end(), ridLess);
+  const PageId listPageNo = createPostingList(rids.data(), rids.size());
+
+  for (int i = end - 1; i >= begin; i--) removeFromLeafNode(node, i);
+  insertToLeafNode(node, begin, key, RecordId{listPageNo, POSTINGLISTSLOT});
+  return true;
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// #########################       Insert      ######################### //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+/**
+ * Insert the given key-(record id) pair into the given leaf node.
+ *
+ * @param origNode a leaf node
+ * @param origPageId the page id of the page that stores the leaf node
+ * @param key the key of the key-record pair
+ * @param rid the record id of the key-record pair
+ * @param midVal a reference to an integer in the parent node. If the insertion
+ *               requires a split in the leaf node, midVal is set to the
+ *               smallest element of the newly created node.
+ *
+ * @return The page number of the newly created page if insertion requires a
+ *         split, or 0 if no new node is created.
+ */
+template <class T>
+PageId BTreeIndex::insertToLeafPage(Page *origPage, PageId origPageId,
+                                    const T &key, RecordId rid, T &midVal) {
+  LeafNode<T> *origNode = (LeafNode<T> *)origPage;
+
+  // if not full, or room can be made with a posting list, insert the key and
+  // record id to the node
+  if (tryInsertToLeaf(origNode, key, rid)) {
+    bufMgr->unPinPage(origPage, true);
+    return 0;
+  }
+
+  // the node is full at this point
+
+  // alloc a page for the new node
+  PageId newPageId;
+  LeafNode<T> *newNode = allocLeafNode<T>(newPageId);
+
+  // split the node to origNode and newNode, and set the middle value
+  midVal =
+      splitLeafAndInsert(origNode, origPageId, newNode, newPageId, key, rid);
+
+  // unpin the new node and the original node
+  bufMgr->unPinPage(origPage, true);
+  bufMgr->unPinPage(file, newPageId, true);
+
+  return newPageId;
+}
+
+/**
+ * Split a full leaf node, moving its upper half to a new node, and insert the
+ * given key-record pair into the half it belongs to.
+ *
+ * @param node a full leaf node
+ * @param pageId the page number of the node
+ * @param newNode an empty leaf node to the right of it
+ * @param newPageId the page number of the new node
+ * @param key the key of the key-record pair to be inserted
+ * @param rid the record ID of the key-record pair to be inserted
+ * @return the smallest key of the new node
+ */
+template <class T>
+T BTreeIndex::splitLeafAndInsert(LeafNode<T> *node, PageId pageId,
+                                 LeafNode<T> *newNode, PageId newPageId,
+                                 const T &key, RecordId rid) {
+  int index = findInsertionIndexLeaf(node, key);
+
+  // the middle index for spliting the page
+  const int middleIndex = getLeafLen(node) / 2;
+
+  // whether the new element is insert to the left half of the original node
+  bool insertToLeft = index < middleIndex;
+
+  // split the node to node and newNode
+  splitLeafNode(node, newNode, middleIndex + insertToLeft);
+
+  // insert the key and record id to the node
+  char columns[MAXCOVEREDSIZE];
+  readCoveredColumns(rid, columns);
+  if (insertToLeft)
+    insertToLeafNode(node, index, key, rid, columns);
+  else
+    insertToLeafNode(newNode, index - middleIndex, key, rid, columns);
+
+  // set the next page id
+  newNode->rightSibPageNo = node->rightSibPageNo;
+  node->rightSibPageNo = newPageId;
+  newNode->leftSibPageNo = pageId;
+  if (newNode->rightSibPageNo != 0)
+    setLeftSibling<T>(newNode->rightSibPageNo, newPageId);
+
+  return getLeafKey(newNode, 0);
+}
+
+/**
+ * Recursively insert the given key-record pair into the subtree with the given
+ * root node. If the root node requires a split, the page number of the newly
+ * created node will be return
+ *
+ * @param origPageId page id of the page that stores the root node of the
+ *        subtree.
+ * @param key the key of the key-record pair to be inserted
+ * @param rid the record ID of the key-record pair to be inserted
+ * @param midVal a pointer to an integer value to be stored in the parent node.
+ *        If the insertion requires a split in the current level, midVal is set
+ *        to the smallest key stored in the subtree pointed by the newly created
+ *        node.
+ *
+ * @return the page number of the newly created node if a split occurs, or 0
+ *         otherwise.
+ */
+template <class T>
+PageId BTreeIndex::insert(PageId origPageId, const T &key, RecordId rid,
+                          T &midVal, int depth, Page **slot) {
+  Page *origPage;
+  PinnedNode *pinned = readNode(origPageId, origPage, depth, slot);
+
+  if (isLeaf(origPage))  // base case
+    return insertToLeafPage(origPage, origPageId, key, rid, midVal);
+
+  NonLeafNode<T> *origNode = (NonLeafNode<T> *)origPage;
+
+  // find the child page id
+  int origChildPageIndex = findIndexNonLeaf(origNode, key);
+  PageId origChildPageId = origNode->pageNoArray[origChildPageIndex];
+
+  // insert key, rid to child and check whether child is splitted
+  T newChildMidVal;
+  PageId newChildPageId =
+      insert(origChildPageId, key, rid, newChildMidVal, depth + 1,
+             childSlot<T>(pinned, origChildPageIndex));
+
+  // not split in child
+  if (newChildPageId == 0) {
+    if (pinned != NULL && pinned->leaves)
+      addToSummary(pinned->leaves[origChildPageIndex], key);
+    unPinNode(origPageId, false, depth);
+    return 0;
+  }
+
+  // split in child, need to add splitted child to currNode
+  int index = findIndexNonLeaf(origNode, newChildMidVal);
+  if (!isNonLeafNodeFull(origNode)) {  // current node is not full
+    insertToNonLeafNode(origNode, index, newChildMidVal, newChildPageId);
+    unPinNode(origPageId, true, depth);
+    return 0;
+  }
+
+  // the middle index for spliting the page
+  int middleIndex = (KeyTraits<T>::NONLEAFSIZE - 1) / 2;
+
+  // whether the new element is insert to the left half of the original node
+  bool insertToLeft = index < middleIndex;
+
+  // split
+  int splitIndex = middleIndex + insertToLeft;
+  int insertIndex = insertToLeft ? index : index - middleIndex - 1;
+
+  // the new key falls between the two halves
+  bool moveKeyUp = !insertToLeft && index == middleIndex;
+
+  // if we need to move key up, set midVal = key, else key at splited index
+  midVal = moveKeyUp ? newChildMidVal : origNode->keyArray[splitIndex];
+
+  // alloc a page for the new node
+  PageId newPageId;
+  NonLeafNode<T> *newNode = allocNonLeafNode<T>(newPageId);
+
+  // split the node to origNode and newNode
+  splitNonLeafNode(origNode, newNode, splitIndex, moveKeyUp);
+
+  // need to insert
+  if (moveKeyUp) {
+    newNode->pageNoArray[0] = newChildPageId;
+  } else {
+    NonLeafNode<T> *node = insertToLeft ? origNode : newNode;
+    insertToNonLeafNode(node, insertIndex, newChildMidVal, newChildPageId);
+  }
+
+  // write the page back
+  unPinNode(origPageId, true, depth);
+  bufMgr->unPinPage(file, newPageId, true);
+
+  // return new page
+  return newPageId;
+}
+
+/**
+ * Insert a new entry using the pair <value,rid>.
+ * Start from root to recursively find out the leaf to insert the entry in.
+ * The insertion may cause splitting of leaf node. This splitting will require
+ * addition of new leaf page number entry into the parent non-leaf, which may
+ * in-turn get split. This may continue all the way upto the root causing the
+ * root to get split. If root gets split, metapage needs to be changed
+ * accordingly. Make sure to unpin pages as soon as you can.
+ * @param key			Key to insert, pointer to integer/double/char
+ *string
+ * @param rid			Record ID of a record whose entry is getting
+ *inserted into the index.
+ **/
+const void BTreeIndex::insertEntry(const void *key, const RecordId rid) {
+  WriteScope scope(*this);
+  switch (keyType) {
+    case INTEGER_KEY:
+      insertOrBufferKey(KeyTraits<int>::fromPointer(key), rid);
+      break;
+    case DOUBLE_KEY:
+      insertOrBufferKey(KeyTraits<double>::fromPointer(key), rid);
+      break;
+    case STRING_KEY:
+      insertOrBufferKey(KeyTraits<StringKey>::fromPointer(key), rid);
+      break;
+    case INTEGER_INTEGER_KEY:
+      insertOrBufferKey(KeyTraits<IntIntKey>::fromPointer(key), rid);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      insertOrBufferKey(KeyTraits<IntDoubleKey>::fromPointer(key), rid);
+      break;
+    case INTEGER_STRING_KEY:
+      insertOrBufferKey(KeyTraits<IntStringKey>::fromPointer(key), rid);
+      break;
+  }
+  count(INSERTS);
+  if (bufMgr->getLog() != NULL) bufMgr->getLog()->commit();
+}
+
+/**
+ * Insert the given key-record pair, splitting the root if needed. A concurrent
+ * index repeats tryInsertConcurrent() until an attempt succeeds.
+ *
+ * @param key the key of the key-record pair to be inserted
+ * @param rid the record ID of the key-record pair to be inserted
+ */
+template <class T>
+void BTreeIndex::insertKey(const T &key, RecordId rid) {
+  if (concurrent) {
+    while (!tryInsertConcurrent(key, rid)) {
+    }
+    return;
+  }
+
+  T midval;
+  PageId pid = insert(indexMetaInfo.rootPageNo, key, rid, midval);
+
+  if (pid != 0)
+    storeRootPageNo(splitRoot(midval, indexMetaInfo.rootPageNo, pid));
+}
+
+/**
+ * Insert the given key-record pair, or add it to the pending inserts if the
+ * index buffers them.
+ *
+ * @param key the key of the key-record pair to be inserted
+ * @param rid the record ID of the key-record pair to be inserted
+ */
+template <class T>
+void BTreeIndex::insertOrBufferKey(const T &key, RecordId rid) {
+  if (maxPending > 0)
+    bufferInsert(key, rid);
+  else
+    insertKey(key, rid);
+}
+
+/**
+ * Returns the i-th of the keys stored one after another at keys.
+ */
+template <class T>
+static T keyAt(const void *keys, std::size_t i) {
+  return KeyTraits<T>::fromPointer((const char *)keys +
+                                   i * KeyTraits<T>::VALUESIZE);
+}
+
+/**
+ * Insert a batch of entries, given as arrays of n keys and n record ids.
+ *
+ * @param keys the keys, stored one after another
+ * @param rids the record ids of the entries
+ * @param n the number of entries
+ */
+const void BTreeIndex::insertBatch(const void *keys, const RecordId *rids,
+                                   const std::size_t n) {
+  WriteScope scope(*this);
+  switch (keyType) {
+    case INTEGER_KEY:
+      insertKeyBatch<int>(keys, rids, n);
+      break;
+    case DOUBLE_KEY:
+      insertKeyBatch<double>(keys, rids, n);
+      break;
+    case STRING_KEY:
+      insertKeyBatch<StringKey>(keys, rids, n);
+      break;
+    case INTEGER_INTEGER_KEY:
+      insertKeyBatch<IntIntKey>(keys, rids, n);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      insertKeyBatch<IntDoubleKey>(keys, rids, n);
+      break;
+    case INTEGER_STRING_KEY:
+      insertKeyBatch<IntStringKey>(keys, rids, n);
+      break;
+  }
+  count(INSERTS, n);
+  if (bufMgr->getLog() != NULL) bufMgr->getLog()->commit();
+}
+
+/**
+ * Insert a batch of entries in key order, or add them to the pending inserts
+ * if the index buffers them.
+ *
+ * @param keys the keys, stored one after another
+ * @param rids the record ids of the entries
+ * @param n the number of entries
+ */
+template <class T>
+void BTreeIndex::insertKeyBatch(const void *keys, const RecordId *rids,
+                                std::size_t n) {
+  if (maxPending > 0) {
+    for (std::size_t i = 0; i < n; i++)
+      bufferInsert(keyAt<T>(keys, i), rids[i]);
+    return;
+  }
+
+  vector<RIDKeyPair<T>> pairs(n);
+  for (std::size_t i = 0; i < n; i++)
+    pairs[i].set(rids[i], keyAt<T>(keys, i));
+  sort(pairs.begin(), pairs.end());
+  insertSortedPairs(pairs.data(), n);
+}
+
+/**
+ * Insert key-record pairs sorted in key order. The pairs of each run that
+ * falls into one leaf are inserted under a single descent from the root, and
+ * a pair whose leaf is full is inserted by insertKey(), which splits it.
+ *
+ * @param pairs the pairs
+ * @param n the number of pairs
+ */
+template <class T>
+void BTreeIndex::insertSortedPairs(const RIDKeyPair<T> *pairs, std::size_t n) {
+  for (std::size_t i = 0; i < n;) {
+    std::size_t count = concurrent ? 0 : insertRunToLeaf(pairs + i, pairs + n);
+    if (count == 0) {
+      insertKey(pairs[i].key, pairs[i].rid);
+      count = 1;
+    }
+    i += count;
+  }
+}
+
+/**
+ * Descend from the root to the leaf of the first of a sorted run of key-record
+ * pairs, and insert the pairs into it for as long as they belong in it and it
+ * has room.
+ *
+ * @param begin the first pair of the run
+ * @param end the end of the run
+ * @return the number of pairs inserted, 0 if the leaf of the first one is full
+ */
+template <class T>
+std::size_t BTreeIndex::insertRunToLeaf(const RIDKeyPair<T> *begin,
+                                        const RIDKeyPair<T> *end) {
+  PageId pageNo = indexMetaInfo.rootPageNo;
+  Page *page;
+  int depth = 0;
+  PinnedNode *pinned = readNode(pageNo, page, depth);
+
+  // the largest key that belongs in the subtree, once the descent has passed
+  // a key to its right
+  bool bounded = false;
+  T upper{};
+  LeafSummary *summary = NULL;
+  while (!isLeaf(page)) {
+    NonLeafNode<T> *node = (NonLeafNode<T> *)page;
+    const int index = findIndexNonLeaf(node, begin->key);
+    if (index < node->numKeys) {
+      bounded = true;
+      upper = node->keyArray[index];
+    }
+    summary = pinned != NULL && pinned->leaves ? &pinned->leaves[index] : NULL;
+    const PageId childPageNo = node->pageNoArray[index];
+    unPinNode(pageNo, false, depth);
+    pageNo = childPageNo;
+    pinned = readNode(pageNo, page, ++depth, childSlot<T>(pinned, index));
+  }
+
+  LeafNode<T> *leaf = (LeafNode<T> *)page;
+  const RIDKeyPair<T> *pair = begin;
+  while (pair != end && !(bounded && pair->key > upper) &&
+         tryInsertToLeaf(leaf, pair->key, pair->rid)) {
+    if (summary != NULL) addToSummary(*summary, pair->key);
+    pair++;
+  }
+  bufMgr->unPinPage(file, pageNo, pair != begin);
+  return pair - begin;
+}
+
+/**
+ * Sets how many inserts the index buffers before applying them to its leaves.
+ *
+ * @param maxEntries the number of inserts buffered at most, or 0
+ */
+void BTreeIndex::setInsertBuffer(std::size_t maxEntries) {
+  if (concurrent || bufMgr->getLog() != NULL) return;
+  flushInsertBuffer();
+  maxPending = maxEntries;
+  std::vector<char>().swap(pending);
+}
+
+/**
+ * Apply the inserts the index buffers to its leaves.
+ */
+void BTreeIndex::flushInsertBuffer() {
+  if (numPending == 0) return;
+  switch (keyType) {
+    case INTEGER_KEY:
+      flushPending<int>();
+      break;
+    case DOUBLE_KEY:
+      flushPending<double>();
+      break;
+    case STRING_KEY:
+      flushPending<StringKey>();
+      break;
+    case INTEGER_INTEGER_KEY:
+      flushPending<IntIntKey>();
+      break;
+    case INTEGER_DOUBLE_KEY:
+      flushPending<IntDoubleKey>();
+      break;
+    case INTEGER_STRING_KEY:
+      flushPending<IntStringKey>();
+      break;
+  }
+}
+
+/**
+ * Add a key-record pair to the pending inserts, applying them all to the
+ * leaves first if there is no room. The room is taken on the first insert,
+ * once the size of the pairs is known.
+ *
+ * @param key the key of the pair
+ * @param rid the record ID of the pair
+ */
+template <class T>
+void BTreeIndex::bufferInsert(const T &key, RecordId rid) {
+  if (pending.empty()) pending.resize(maxPending * sizeof(RIDKeyPair<T>));
+  if (numPending == maxPending) flushPending<T>();
+  pendingPairs<T>()[numPending++].set(rid, key);
+}
+
+/**
+ * Put the pending inserts in order. Those added since they last were are
+ * sorted on their own and merged into the rest, so that lookups between
+ * inserts sort only what was added meanwhile.
+ */
+template <class T>
+void BTreeIndex::sortPending() {
+  if (numSortedPending == numPending) return;
+  RIDKeyPair<T> *pairs = pendingPairs<T>();
+  std::sort(pairs + numSortedPending, pairs + numPending);
+  std::inplace_merge(pairs, pairs + numSortedPending, pairs + numPending);
+  numSortedPending = numPending;
+}
+
+/**
+ * Apply the pending inserts to the leaves in key order, a run of them per
+ * leaf, so that each leaf is read and written once however many of them it
+ * takes.
+ */
+template <class T>
+void BTreeIndex::flushPending() {
+  if (numPending == 0) return;
+  WriteScope scope(*this);
+  sortPending<T>();
+  const std::size_t n = numPending;
+  numPending = numSortedPending = 0;
+  insertSortedPairs(pendingPairs<T>(), n);
+  count(BUFFER_FLUSHES);
+}
+
+/**
+ * Call emit with the record id of each pending insert of the given key.
+ *
+ * @param key the key
+ * @param emit the function called with each record id
+ * @return the number of pending inserts of the key
+ */
+template <class T, class Emit>
+std::size_t BTreeIndex::forEachPendingMatch(const T &key, Emit emit) {
+  sortPending<T>();
+  const RIDKeyPair<T> *pairs = pendingPairs<T>();
+  const RIDKeyPair<T> *first = std::lower_bound(
+      pairs, pairs + numPending, key,
+      [](const RIDKeyPair<T> &pair, const T &k) { return pair.key < k; });
+  const RIDKeyPair<T> *pair = first;
+  for (; pair != pairs + numPending && pair->key == key; pair++)
+    emit(pair->rid);
+  return pair - first;
+}
+
+/**
+ * Remove the given key-record pair from the pending inserts.
+ *
+ * @param key the key of the pair
+ * @param rid the record ID of the pair
+ * @return true if the pair was pending
+ */
+template <class T>
+bool BTreeIndex::removePending(const T &key, RecordId rid) {
+  sortPending<T>();
+  RIDKeyPair<T> *pairs = pendingPairs<T>();
+  RIDKeyPair<T> sought;
+  sought.set(rid, key);
+  RIDKeyPair<T> *pair = std::lower_bound(pairs, pairs + numPending, sought);
+  if (pair == pairs + numPending || sought < *pair) return false;
+  memmove(pair, pair + 1, (pairs + numPending - pair - 1) * sizeof(*pair));
+  numPending--;
+  numSortedPending--;
+  return true;
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// #########################       Delete      ######################### //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+/**
+ * Merge two adjacent leaves if their entries fit in one, or else move entries
+ * between them until they hold about the same number.
+ *
+ * @param left the left leaf
+ * @param right the right leaf
+ * @param sep the key separating them in the parent, updated if entries move
+ * @return true if the right leaf was merged into the left one
+ */
+template <class T>
+bool BTreeIndex::rebalanceLeaves(LeafNode<T> *left, LeafNode<T> *right,
+                                 T &sep) {
+  const int leftLen = getLeafLen(left);
+  const int rightLen = getLeafLen(right);
+
+  // all keys of both leaves lie between the first and the last one, so the
+  // capacity of the merged leaf is that of the left one given the last key
+  if (rightLen == 0 ||
+      leftLen + rightLen <=
+          getLeafCapacity(left, getLeafKey(right, rightLen - 1))) {
+    for (int i = 0; i < rightLen; i++)
+      appendToLeafNode(left, getLeafLen(left), getLeafKey(right, i),
+                       getLeafRid(right, i), getLeafColumns(right, i));
+    left->rightSibPageNo = right->rightSibPageNo;
+    return true;
+  }
+
+  // move entries one at a time, as long as they fit in the receiving leaf
+  const int half = (leftLen + rightLen) / 2;
+  while (getLeafLen(left) < half) {
+    const T key = getLeafKey(right, 0);
+    if (isLeafNodeFull(left, key)) break;
+    appendToLeafNode(left, getLeafLen(left), key, getLeafRid(right, 0),
+                     getLeafColumns(right, 0));
+    removeFromLeafNode(right, 0);
+  }
+  while (getLeafLen(right) < half) {
+    const int last = getLeafLen(left) - 1;
+    const T key = getLeafKey(left, last);
+    if (isLeafNodeFull(right, key)) break;
+    insertToLeafNode(right, 0, key, getLeafRid(left, last),
+                     getLeafColumns(left, last));
+    removeFromLeafNode(left, last);
+  }
+
+  sep = getLeafKey(right, 0);
+  return false;
+}
+
+/**
+ * Merge two adjacent internal nodes with the key separating them if they fit
+ * in one, or else rotate keys through the separator until they hold about the
+ * same number.
+ *
+ * @param left the left node
+ * @param right the right node
+ * @param sep the key separating them in the parent, updated if keys move
+ * @return true if the right node was merged into the left one
+ */
+template <class T>
+bool BTreeIndex::rebalanceNonLeaves(NonLeafNode<T> *left,
+                                    NonLeafNode<T> *right, T &sep) {
+  const int leftLen = left->numKeys;
+  const int rightLen = right->numKeys;
+
+  // the separator comes down between the keys of the two nodes
+  if (leftLen + rightLen + 1 <= KeyTraits<T>::NONLEAFSIZE) {
+    left->keyArray[leftLen] = sep;
+    memcpy(&left->keyArray[leftLen + 1], right->keyArray, rightLen * sizeof(T));
+    memcpy(&left->pageNoArray[leftLen + 1], right->pageNoArray,
+           (rightLen + 1) * sizeof(PageId));
+    left->numKeys = leftLen + rightLen + 1;
+    indexNonLeaf(left);
+    return true;
+  }
+
+  const int half = (leftLen + rightLen) / 2;
+  if (leftLen < half) {
+    // the separator and the first k - 1 keys of the right node move left, and
+    // its k-th key becomes the separator
+    const int k = half - leftLen;
+    left->keyArray[leftLen] = sep;
+    memcpy(&left->keyArray[leftLen + 1], right->keyArray, (k - 1) * sizeof(T));
+    memcpy(&left->pageNoArray[leftLen + 1], right->pageNoArray,
+           k * sizeof(PageId));
+    sep = right->keyArray[k - 1];
+
+    memmove(right->keyArray, &right->keyArray[k], (rightLen - k) * sizeof(T));
+    memmove(right->pageNoArray, &right->pageNoArray[k],
+            (rightLen - k + 1) * sizeof(PageId));
+    memset(&right->keyArray[rightLen - k], 0, k * sizeof(T));
+    memset(&right->pageNoArray[rightLen - k + 1], 0, k * sizeof(PageId));
+
+    left->numKeys += k;
+    right->numKeys -= k;
+  } else if (rightLen < half) {
+    // the last k - 1 keys of the left node and the separator move right, and
+    // the key before them becomes the separator
+    const int k = half - rightLen;
+    memmove(&right->keyArray[k], right->keyArray, rightLen * sizeof(T));
+    memmove(&right->pageNoArray[k], right->pageNoArray,
+            (rightLen + 1) * sizeof(PageId));
+    right->keyArray[k - 1] = sep;
+    memcpy(right->keyArray, &left->keyArray[leftLen - k + 1],
+           (k - 1) * sizeof(T));
+    memcpy(right->pageNoArray, &left->pageNoArray[leftLen - k + 1],
+           k * sizeof(PageId));
+    sep = left->keyArray[leftLen - k];
+
+    memset(&left->keyArray[leftLen - k], 0, k * sizeof(T));
+    memset(&left->pageNoArray[leftLen - k + 1], 0, k * sizeof(PageId));
+
+    left->numKeys -= k;
+    right->numKeys += k;
+  }
+  indexNonLeaf(left);
+  indexNonLeaf(right);
+  return false;
+}
+
+/**
+ * Rebalance the child of the given node that holds too few keys with its left
+ * sibling, or its right one if it is the first child, freeing the right page
+ * of the two if they are merged.
+ *
+ * @param node an internal node
+ * @param c the index of the child that holds too few keys
+ */
+template <class T>
+void BTreeIndex::rebalanceChild(NonLeafNode<T> *node, int c) {
+  const int sepIndex = c > 0 ? c - 1 : c;
+  const PageId leftPageNo = node->pageNoArray[sepIndex];
+  const PageId rightPageNo = node->pageNoArray[sepIndex + 1];
+
+  Page *leftPage;
+  Page *rightPage;
+  pinPage(leftPageNo, leftPage);
+  pinPage(rightPageNo, rightPage);
+
+  T &sep = node->keyArray[sepIndex];
+  bool merged;
+  PageId nextLeafPageNo = 0;
+  if (isLeaf(leftPage)) {
+    merged = rebalanceLeaves((LeafNode<T> *)leftPage,
+                             (LeafNode<T> *)rightPage, sep);
+    nextLeafPageNo = ((LeafNode<T> *)leftPage)->rightSibPageNo;
+  } else {
+    // children move between the two nodes, so those kept pinned forget the
+    // slots and summaries of theirs
+    for (const PageId pageNo : {leftPageNo, rightPageNo}) {
+      auto pinned = pinnedNodes.find(pageNo);
+      if (pinned == pinnedNodes.end()) continue;
+      unswizzleChildren(pinned->second);
+      pinned->second.leaves.reset();
+    }
+    merged = rebalanceNonLeaves((NonLeafNode<T> *)leftPage,
+                                (NonLeafNode<T> *)rightPage, sep);
+  }
+
+  bufMgr->unPinPage(file, leftPageNo, true);
+  if (merged) {
+    removeFromNonLeafNode(node, sepIndex);
+    freeNode(rightPageNo, rightPage);
+    // the leaf after the merged pair now follows the left one
+    if (nextLeafPageNo != 0) setLeftSibling<T>(nextLeafPageNo, leftPageNo);
+  } else {
+    // the separator moved
+    indexNonLeaf(node);
+    bufMgr->unPinPage(file, rightPageNo, true);
+  }
+}
+
+/**
+ * Recursively remove the given key-record pair from the subtree with the given
+ * root node. Entries with the same key may be spread over several children,
+ * the first of which is the one an insertion of the key would go to, so the
+ * children are tried in turn while their separator is the key.
+ *
+ * @param pageNo page id of the page that stores the root node of the subtree
+ * @param key the key of the key-record pair to be removed
+ * @param rid the record ID of the key-record pair to be removed
+ * @param underflow set to whether the root node of the subtree is left with too
+ *        few keys
+ * @return true if the pair was found and removed
+ */
+template <class T>
+bool BTreeIndex::remove(PageId pageNo, const T &key, RecordId rid,
+                        bool &underflow, int depth, Page **slot) {
+  Page *page;
+  PinnedNode *pinned = readNode(pageNo, page, depth, slot);
+  bool found = false;
+
+  if (isLeaf(page)) {  // base case
+    LeafNode<T> *node = (LeafNode<T> *)page;
+    bool dirty = false;
+    int i = findScanIndexLeaf(node, key, true);
+    for (; i != -1 && i < getLeafLen(node) && getLeafKey(node, i) == key; i++) {
+      const RecordId entryRid = getLeafRid(node, i);
+      bool emptied = false;
+      if (isPostingList(entryRid))
+        found = removePostingRid(entryRid.page_number, rid, emptied);
+      else
+        found = dirty = entryRid == rid;
+
+      // the entry of a posting list goes once the list is left empty
+      if (emptied) dirty = true;
+      if (dirty) removeFromLeafNode(node, i);
+      if (found) break;
+    }
+    underflow = getLeafLen(node) < KeyTraits<T>::MINLEAFSIZE;
+    bufMgr->unPinPage(file, pageNo, dirty);
+    return found;
+  }
+
+  NonLeafNode<T> *node = (NonLeafNode<T> *)page;
+
+  int c = findIndexNonLeaf(node, key);
+  bool childUnderflow = false;
+  while (!(found = remove(node->pageNoArray[c], key, rid, childUnderflow,
+                          depth + 1, childSlot<T>(pinned, c))) &&
+         c < node->numKeys && node->keyArray[c] == key) {
+    c++;
+  }
+
+  // the node only changes if a child is rebalanced
+  const bool rebalance = found && childUnderflow;
+  if (rebalance) rebalanceChild(node, c);
+
+  underflow = node->numKeys < KeyTraits<T>::MINNONLEAFSIZE;
+  unPinNode(pageNo, rebalance, depth);
+  return found;
+}
+
+/**
+ * Delete the entry with the pair <value,rid>.
+ * Start from root to recursively find out the leaf holding the entry. A leaf
+ * left with too few entries is merged with a sibling, or refilled from it if
+ * they do not fit in one leaf, which may in turn leave the parent with too few
+ * keys, up to the root. A root left with a single child is replaced by it.
+ * @param key			Key to delete, pointer to integer/double/char
+ *string
+ * @param rid			Record ID of the record whose entry is getting
+ *deleted from the index.
+ * @throws  NoSuchKeyFoundException If the index holds no such entry.
+ **/
+const void BTreeIndex::deleteEntry(const void *key, const RecordId rid) {
+  WriteScope scope(*this);
+  bool found = false;
+  switch (keyType) {
+    case INTEGER_KEY:
+      found = deleteKey(KeyTraits<int>::fromPointer(key), rid);
+      break;
+    case DOUBLE_KEY:
+      found = deleteKey(KeyTraits<double>::fromPointer(key), rid);
+      break;
+    case STRING_KEY:
+      found = deleteKey(KeyTraits<StringKey>::fromPointer(key), rid);
+      break;
+    case INTEGER_INTEGER_KEY:
+      found = deleteKey(KeyTraits<IntIntKey>::fromPointer(key), rid);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      found = deleteKey(KeyTraits<IntDoubleKey>::fromPointer(key), rid);
+      break;
+    case INTEGER_STRING_KEY:
+      found = deleteKey(KeyTraits<IntStringKey>::fromPointer(key), rid);
+      break;
+  }
+  if (bufMgr->getLog() != NULL) bufMgr->getLog()->commit();
+  if (!found) throw NoSuchKeyFoundException();
+  count(DELETES);
+}
+
+/**
+ * Remove the given key-record pair, replacing the root if it is left with a
+ * single child. A concurrent index uses deleteKeyConcurrent() instead.
+ *
+ * @param key the key of the key-record pair to be removed
+ * @param rid the record ID of the key-record pair to be removed
+ * @return true if the pair was found and removed
+ */
+template <class T>
+bool BTreeIndex::deleteKey(const T &key, RecordId rid) {
+  if (concurrent) return deleteKeyConcurrent(key, rid);
+  if (numPending > 0 && removePending(key, rid)) return true;
+
+  bool underflow;
+  if (!remove(indexMetaInfo.rootPageNo, key, rid, underflow)) return false;
+  if (!underflow) return true;
+
+  // a leaf root may hold any number of entries
+  const PageId rootPageNo = indexMetaInfo.rootPageNo;
+  Page *rootPage;
+  pinPage(rootPageNo, rootPage);
+  if (isLeaf(rootPage) || ((NonLeafNode<T> *)rootPage)->numKeys > 0) {
+    bufMgr->unPinPage(file, rootPageNo, false);
+    return true;
+  }
+
+  // the nodes kept pinned are those below the old root
+  unpinNodes();
+  indexMetaInfo.rootPageNo = ((NonLeafNode<T> *)rootPage)->pageNoArray[0];
+  freeNode(rootPageNo, rootPage);
+  return true;
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// #######################  Concurrent Access  ######################### //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+/**
+ * Returns the version word of the node stored in the given page.
+ */
+static inline std::atomic<std::uint32_t> &nodeVersion(Page *page) {
+  return ((FreeNode *)page)->version;
+}
+
+/**
+ * Waits until no writer holds the node and returns its version.
+ */
+static std::uint32_t readLockNode(Page *page) {
+  std::uint32_t version;
+  while ((version = nodeVersion(page).load()) & 1) std::this_thread::yield();
+  return version;
+}
+
+/**
+ * Returns true if the node is unchanged since the given version was read, so
+ * that what was read from it in between is consistent.
+ */
+static bool validateNode(Page *page, std::uint32_t version) {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return nodeVersion(page).load() == version;
+}
+
+/**
+ * Takes the node for writing if it is unchanged since the given version was
+ * read. Never waits, so a writer cannot deadlock on the nodes it holds.
+ */
+static bool upgradeNode(Page *page, std::uint32_t version) {
+  return nodeVersion(page).compare_exchange_strong(version, version + 1);
+}
+
+/**
+ * Releases a node taken for writing, giving it a new version.
+ */
+static void writeUnlockNode(Page *page) { nodeVersion(page).fetch_add(1); }
+
+/**
+ * Set the left sibling link of a leaf. A writer of a concurrent index that
+ * holds the leaf only ever waits for leaves to its right, so waiting for it
+ * here cannot deadlock.
+ *
+ * @param pageNo the page number of the leaf
+ * @param leftPageNo the page number of its new left sibling
+ */
+template <class T>
+void BTreeIndex::setLeftSibling(PageId pageNo, PageId leftPageNo) {
+  Page *page;
+  pinPage(pageNo, page);
+  if (concurrent) {
+    while (!upgradeNode(page, readLockNode(page))) {
+    }
+  }
+  ((LeafNode<T> *)page)->leftSibPageNo = leftPageNo;
+  if (concurrent) writeUnlockNode(page);
+  bufMgr->unPinPage(file, pageNo, true);
+}
+
+/**
+ * Find the child of an internal node to descend to for the given key, while
+ * writers may be changing the node.
+ *
+ * @param node an internal node
+ * @param key the key to find
+ * @return the index of the child, which is only right if the version of the
+ *         node is unchanged afterwards
+ */
+template <class T>
+int BTreeIndex::findChildConcurrent(NonLeafNode<T> *node, const T &key) {
+  // the key count of a node being changed may be anything, so keep the search
+  // within the page
+  const int size = KeyTraits<T>::NONLEAFSIZE;
+  const int len = min(max(node->numKeys, 0), size);
+  int result = findArrayIndex(node->keyArray, len, key);
+  return result == -1 ? len : result;
+}
+
+/**
+ * Find the child of an internal node with INTEGER keys through its
+ * directory, while writers may be changing the node.
+ */
+template <>
+int BTreeIndex::findChildConcurrent<int>(NonLeafNode<int> *node,
+                                         const int &key) {
+  const int len = min(max(node->numKeys, 0), INTARRAYNONLEAFSIZE);
+  return searchIntDirectory(node->keyArray, len, node->blockKeys,
+                            node->lineKeys, node->pageNoArray, key, true);
+}
+
+/**
+ * Descend from the root to the leftmost leaf that may hold the given key,
+ * checking the version of each node after reading the child page number from
+ * it and restarting from the root if one changed.
+ *
+ * @param key the key to find
+ * @param pageNo set to the page number of the leaf
+ * @param page set to the leaf page, pinned
+ * @return the version of the leaf when it was reached
+ */
+template <class T>
+std::uint32_t BTreeIndex::findLeafConcurrent(const T &key, PageId &pageNo,
+                                             Page *&page) {
+  while (true) {
+    pageNo = loadRootPageNo();
+    pinPage(pageNo, page);
+    std::uint32_t version = readLockNode(page);
+
+    // the root is replaced while the old root is held, so once its version
+    // has been read the root page number is up to date
+    bool restart = loadRootPageNo() != pageNo;
+    while (!restart && !isLeaf(page)) {
+      NonLeafNode<T> *node = (NonLeafNode<T> *)page;
+      const PageId childPageNo =
+          node->pageNoArray[findChildConcurrent(node, key)];
+      if (!validateNode(page, version)) {
+        restart = true;
+        break;
+      }
+
+      // the child is only known to be in the tree if the node is still
+      // unchanged once the version of the child has been read
+      Page *child;
+      pinPage(childPageNo, child);
+      const std::uint32_t childVersion = readLockNode(child);
+      restart = !validateNode(page, version);
+
+      bufMgr->unPinPage(file, pageNo, false);
+      pageNo = childPageNo;
+      page = child;
+      version = childVersion;
+    }
+
+    if (!restart) return version;
+    bufMgr->unPinPage(file, pageNo, false);
+  }
+}
+
+/**
+ * Make one attempt at inserting the given key-record pair into a concurrent
+ * index. The tree is descended without holding any node, and full internal
+ * nodes are split on the way down so that a split below always finds room in
+ * its parent. Only the nodes being changed are taken for writing, a node and
+ * then its parent.
+ *
+ * @param key the key of the key-record pair to be inserted
+ * @param rid the record ID of the key-record pair to be inserted
+ * @return false if a node changed under the attempt, which has to be restarted
+ */
+template <class T>
+bool BTreeIndex::tryInsertConcurrent(const T &key, RecordId rid) {
+  PageId pageNo = loadRootPageNo();
+  Page *page;
+  pinPage(pageNo, page);
+  std::uint32_t version = readLockNode(page);
 
-  // copy elements from old node to new node
-  memcpy(&newNode->keyArray, &node->keyArray[index], len * sizeof(int));
-  memcpy(&newNode->ridArray, &node->ridArray[index], len * sizeof(RecordId));
+  PageId parentPageNo = 0;
+  Page *parent = NULL;
+  std::uint32_t parentVersion = 0;
 
-  // remove elements from old node
-  memset(&node->keyArray[index], 0, len * sizeof(int));
-  memset(&node->ridArray[index], 0, len * sizeof(RecordId));
+  auto unpinAll = [&](bool dirty) {
+    if (parent != NULL) bufMgr->unPinPage(file, parentPageNo, dirty);
+    bufMgr->unPinPage(file, pageNo, dirty);
+  };
+
+  // take the node and its parent for writing, for a split
+  auto upgradeNodeAndParent = [&]() {
+    if (parent != NULL && !upgradeNode(parent, parentVersion)) return false;
+    if (!upgradeNode(page, version)) {
+      if (parent != NULL) writeUnlockNode(parent);
+      return false;
+    }
+    return true;
+  };
+
+  // add the new node to the parent of the split one, or above it in a new root
+  auto insertSeparator = [&](const T &midVal, PageId newPageNo) {
+    if (parent != NULL) {
+      NonLeafNode<T> *parentNode = (NonLeafNode<T> *)parent;
+      insertToNonLeafNode(parentNode, findIndexNonLeaf(parentNode, midVal),
+                          midVal, newPageNo);
+      writeUnlockNode(parent);
+    } else {
+      storeRootPageNo(splitRoot(midVal, pageNo, newPageNo));
+    }
+    writeUnlockNode(page);
+  };
+
+  if (loadRootPageNo() != pageNo) {
+    unpinAll(false);
+    return false;
+  }
+
+  while (!isLeaf(page)) {
+    NonLeafNode<T> *node = (NonLeafNode<T> *)page;
+
+    if (isNonLeafNodeFull(node)) {
+      if (!upgradeNodeAndParent()) {
+        unpinAll(false);
+        return false;
+      }
+
+      PageId newPageNo;
+      NonLeafNode<T> *newNode = allocNonLeafNode<T>(newPageNo);
+      newNode->level = node->level;
+      const int middleIndex = node->numKeys / 2;
+      const T midVal = node->keyArray[middleIndex];
+      splitNonLeafNode(node, newNode, middleIndex, false);
+      bufMgr->unPinPage(file, newPageNo, true);
+
+      insertSeparator(midVal, newPageNo);
+      unpinAll(true);
+      return false;
+    }
+
+    const PageId childPageNo =
+        node->pageNoArray[findChildConcurrent(node, key)];
+    if (!validateNode(page, version)) {
+      unpinAll(false);
+      return false;
+    }
+
+    Page *child;
+    pinPage(childPageNo, child);
+    const std::uint32_t childVersion = readLockNode(child);
+    if (!validateNode(page, version)) {
+      bufMgr->unPinPage(file, childPageNo, false);
+      unpinAll(false);
+      return false;
+    }
+
+    if (parent != NULL) bufMgr->unPinPage(file, parentPageNo, false);
+    parentPageNo = pageNo;
+    parent = page;
+    parentVersion = version;
+    pageNo = childPageNo;
+    page = child;
+    version = childVersion;
+  }
+
+  LeafNode<T> *leaf = (LeafNode<T> *)page;
+
+  if (!isLeafNodeFull(leaf, key)) {
+    if (!upgradeNode(page, version)) {
+      unpinAll(false);
+      return false;
+    }
+    insertToLeafNode(leaf, findInsertionIndexLeaf(leaf, key), key, rid);
+    writeUnlockNode(page);
+
+    if (parent != NULL) bufMgr->unPinPage(file, parentPageNo, false);
+    bufMgr->unPinPage(file, pageNo, true);
+    return true;
+  }
+
+  if (!upgradeNodeAndParent()) {
+    unpinAll(false);
+    return false;
+  }
+
+  PageId newPageNo;
+  LeafNode<T> *newLeaf = allocLeafNode<T>(newPageNo);
+  const T midVal =
+      splitLeafAndInsert(leaf, pageNo, newLeaf, newPageNo, key, rid);
+  bufMgr->unPinPage(file, newPageNo, true);
+
+  insertSeparator(midVal, newPageNo);
+  unpinAll(true);
+  return true;
 }
 
 /**
- * Split the internal node by the given index. It moves the values stored in the
- * given node after the split index into a new internal node.
- *
- * @param node an internal node
- * @param i the index where the split occurs.
- * @param keepMidKey Whether the value at the index should be moved to the
- * parent internal node or not. If keepMidKey is true, then the pair at the
- * index does not need to be moved up and will be moved to the newly created
- *                   internal node.
+ * Remove the given key-record pair from a concurrent index. Entries with the
+ * same key may continue in the leaves to the right, which are followed through
+ * their sibling links. Leaves are not merged, so that pages are never freed
+ * under readers.
  *
- * @return a pointer to the newly created internal node.
+ * @param key the key of the key-record pair to be removed
+ * @param rid the record ID of the key-record pair to be removed
+ * @return true if the pair was found and removed
  */
-void BTreeIndex::splitNonLeafNode(NonLeafNodeInt *curr, NonLeafNodeInt *next,
-                                  int i, bool keepMidKey) {
-  size_t len = INTARRAYNONLEAFSIZE - i;
+template <class T>
+bool BTreeIndex::deleteKeyConcurrent(const T &key, RecordId rid) {
+  PageId pageNo;
+  Page *page;
+  std::uint32_t version = findLeafConcurrent(key, pageNo, page);
 
-  // copy keys from old node to new node
-  if (keepMidKey)
-    memcpy(&next->keyArray, &curr->keyArray[i], len * sizeof(int));
-  else
-    memcpy(&next->keyArray, &curr->keyArray[i + 1], (len - 1) * sizeof(int));
+  while (true) {
+    if (!upgradeNode(page, version)) {
+      version = readLockNode(page);
+      continue;
+    }
 
-  // copy values from old node to new node
-  memcpy(&next->pageNoArray, &curr->pageNoArray[i + 1], len * sizeof(PageId));
+    LeafNode<T> *leaf = (LeafNode<T> *)page;
+    const int len = getLeafLen(leaf);
+    int i = findScanIndexLeaf(leaf, key, true);
+    bool found = false;
+    for (; i != -1 && i < len && getLeafKey(leaf, i) == key; i++) {
+      if (getLeafRid(leaf, i) == rid) {
+        removeFromLeafNode(leaf, i);
+        found = true;
+        break;
+      }
+    }
+    const PageId nextPageNo = leaf->rightSibPageNo;
+    writeUnlockNode(page);
+    bufMgr->unPinPage(file, pageNo, found);
 
-  // remove elements from old node
-  memset(&curr->keyArray[i], 0, len * sizeof(int));
-  memset(&curr->pageNoArray[i + 1], 0, len * sizeof(PageId));
+    // keys in the leaf end before or at the key, so it may go on to the right
+    if (found || (i != -1 && i < len) || nextPageNo == 0) return found;
+
+    pageNo = nextPageNo;
+    pinPage(pageNo, page);
+    version = readLockNode(page);
+  }
 }
 
 /**
- * Create a new root with midVal, pid1 and pid2.
+ * Append the record ids of all entries in the given range to outRids, in key
+ * order, while other threads may insert and delete entries.
  *
- * @param midVal the first middle value of the new root
- * @param pid1 the first page number in the new root
- * @param pid2 the second page number in the new root
+ * @param lowValParm The low value to be tested.
+ * @param lowOpParm The operation to be used in testing the low range.
+ * @param highValParm The high value to be tested.
+ * @param highOpParm The operation to be used in testing the high range.
+ * @param outRids The vector the record ids are appended to.
+ */
+const void BTreeIndex::scanRange(const void *lowValParm,
+                                 const Operator lowOpParm,
+                                 const void *highValParm,
+                                 const Operator highOpParm,
+                                 vector<RecordId> &outRids) {
+  if (lowOpParm != GT && lowOpParm != GTE) throw BadOpcodesException();
+  if (highOpParm != LT && highOpParm != LTE) throw BadOpcodesException();
+
+  switch (keyType) {
+    case INTEGER_KEY:
+      scanKeyRange(KeyTraits<int>::fromPointer(lowValParm), lowOpParm,
+                   KeyTraits<int>::fromPointer(highValParm), highOpParm,
+                   outRids);
+      break;
+    case DOUBLE_KEY:
+      scanKeyRange(KeyTraits<double>::fromPointer(lowValParm), lowOpParm,
+                   KeyTraits<double>::fromPointer(highValParm), highOpParm,
+                   outRids);
+      break;
+    case STRING_KEY:
+      scanKeyRange(KeyTraits<StringKey>::fromPointer(lowValParm), lowOpParm,
+                   KeyTraits<StringKey>::fromPointer(highValParm), highOpParm,
+                   outRids);
+      break;
+    case INTEGER_INTEGER_KEY:
+      scanKeyRange(KeyTraits<IntIntKey>::fromPointer(lowValParm), lowOpParm,
+                   KeyTraits<IntIntKey>::fromPointer(highValParm),
+                   highOpParm, outRids);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      scanKeyRange(KeyTraits<IntDoubleKey>::fromPointer(lowValParm), lowOpParm,
+                   KeyTraits<IntDoubleKey>::fromPointer(highValParm),
+                   highOpParm, outRids);
+      break;
+    case INTEGER_STRING_KEY:
+      scanKeyRange(KeyTraits<IntStringKey>::fromPointer(lowValParm), lowOpParm,
+                   KeyTraits<IntStringKey>::fromPointer(highValParm),
+                   highOpParm, outRids);
+      break;
+  }
+}
+
+/**
+ * Append the record ids of the entries in the given range to outRids. Each
+ * leaf is copied and its version checked before its entries are read, and
+ * copied again if it changed. Entries only ever move to the right, into a leaf
+ * split off after the one they were in, so following the sibling link read
+ * with a consistent copy misses none of them.
  *
- * @return the page id of the new root
+ * @param lowValParm the low value of the range
+ * @param lowOpParm the operation to be used in testing the low range
+ * @param highValParm the high value of the range
+ * @param highOpParm the operation to be used in testing the high range
+ * @param outRids the vector the record ids are appended to
  */
-PageId BTreeIndex::splitRoot(int midVal, PageId pid1, PageId pid2) {
-  // alloc a new page for root
-  PageId newRootPageId;
-  NonLeafNodeInt *newRoot = allocNonLeafNode(newRootPageId);
+template <class T>
+void BTreeIndex::scanKeyRange(const T &lowValParm, const Operator lowOpParm,
+                              const T &highValParm, const Operator highOpParm,
+                              vector<RecordId> &outRids) {
+  if (lowValParm > highValParm) throw BadScanrangeException();
+  if (numPending > 0) flushPending<T>();
 
-  // set key and page numbers
-  newRoot->keyArray[0] = midVal;
-  newRoot->pageNoArray[0] = pid1;
-  newRoot->pageNoArray[1] = pid2;
+  PageId pageNo;
+  Page *page;
+  std::uint32_t version = findLeafConcurrent(lowValParm, pageNo, page);
 
-  // unpin the root page
-  bufMgr->unPinPage(file, newRootPageId, true);
+  alignas(LeafNode<T>) char copy[sizeof(LeafNode<T>)];
+  LeafNode<T> *leaf = (LeafNode<T> *)copy;
+  while (true) {
+    memcpy(copy, page, sizeof(LeafNode<T>));
+    if (!validateNode(page, version)) {
+      version = readLockNode(page);
+      continue;
+    }
+    bufMgr->unPinPage(file, pageNo, false);
 
-  return newRootPageId;
+    const int len = getLeafLen(leaf);
+    int i = findScanIndexLeaf(leaf, lowValParm, lowOpParm == GTE);
+    for (; i != -1 && i < len; i++) {
+      const T val = getLeafKey(leaf, i);
+      if (val > highValParm || (val == highValParm && highOpParm == LT))
+        return;
+      outRids.push_back(getLeafRid(leaf, i));
+    }
+
+    pageNo = leaf->rightSibPageNo;
+    if (pageNo == 0) return;
+    pinPage(pageNo, page);
+    version = readLockNode(page);
+  }
 }
 
 // ##################################################################### //
 // ##################################################################### //
 // ##################################################################### //
-// #########################       Insert      ######################### //
+// #########################       Lookup      ######################### //
 // ##################################################################### //
 // ##################################################################### //
 // ##################################################################### //
 
 /**
- * Insert the given key-(record id) pair into the given leaf node.
+ * Descend from the root to the leftmost leaf that may hold the given key,
+ * unless the summary of the leaf kept by its parent shows that the key is in
+ * no leaf. A leaf read below a node kept pinned is summarized.
  *
- * @param origNode a leaf node
- * @param origPageId the page id of the page that stores the leaf node
- * @param key the key of the key-record pair
- * @param rid the record id of the key-record pair
- * @param midVal a reference to an integer in the parent node. If the insertion
- *               requires a split in the leaf node, midVal is set to the
- *               smallest element of the newly created node.
+ * @param key the key to find
+ * @param pageNo set to the page number of the leaf
+ * @param page set to the leaf page, pinned
+ * @return false, with no page pinned, if the key is in no leaf
+ */
+template <class T>
+bool BTreeIndex::findLeafPage(const T &key, PageId &pageNo, Page *&page) {
+  pageNo = indexMetaInfo.rootPageNo;
+  int depth = 0;
+  PinnedNode *pinned = readNode(pageNo, page, depth);
+  while (!isLeaf(page)) {
+    NonLeafNode<T> *node = (NonLeafNode<T> *)page;
+    const int index = findIndexNonLeaf(node, key);
+    if (pinned != NULL && leafSummaries &&
+        summaryExcludes(*pinned, index, key, key)) {
+      count(LEAVES_SKIPPED);
+      return false;
+    }
+    const PageId childPageNo = node->pageNoArray[index];
+    unPinNode(pageNo, false, depth);
+    PinnedNode *parent = pinned;
+    pageNo = childPageNo;
+    pinned = readNode(pageNo, page, ++depth, childSlot<T>(pinned, index));
+    if (parent != NULL && leafSummaries && isLeaf(page))
+      summarizeLeaf(*parent, index, (LeafNode<T> *)page);
+  }
+  return true;
+}
+
+/**
+ * Pass the record id of every entry with the given key to emit, starting at
+ * the given index of a pinned leaf before which there is none, and following
+ * the sibling links while the entries continue. The last leaf visited is left
+ * pinned.
  *
- * @return The page number of the newly created page if insertion requires a
- *         split, or 0 if no new node is created.
+ * @param key the key to find
+ * @param index the index of the first entry of the leaf not smaller than key,
+ *        or the length of the leaf if there is none
+ * @param pageNo the page number of the leaf, updated as siblings are visited
+ * @param page the leaf page, updated as siblings are visited
+ * @param emit called with the record id of each entry
+ * @return the number of entries with the key
  */
-PageId BTreeIndex::insertToLeafPage(Page *origPage, PageId origPageId, int key,
-                                    RecordId rid, int &midVal) {
-  LeafNodeInt *origNode = (LeafNodeInt *)origPage;
+template <class T, class Emit>
+std::size_t BTreeIndex::forEachMatch(const T &key, int index, PageId &pageNo,
+                                     Page *&page, Emit emit) {
+  std::size_t count = 0;
+  while (true) {
+    LeafNode<T> *leaf = (LeafNode<T> *)page;
+    const int len = getLeafLen(leaf);
+    for (; index < len && getLeafKey(leaf, index) == key; index++) {
+      const RecordId rid = getLeafRid(leaf, index);
+      if (isPostingList(rid)) {
+        count += forEachPostingRid(rid.page_number, emit);
+      } else {
+        emit(rid);
+        count++;
+      }
+    }
+    if (index < len || leaf->rightSibPageNo == 0) return count;
 
-  // finde the insertion index
-  int index = findInsertionIndexLeaf(origNode, key);
+    // the entries with the key may go on in the next leaf
+    const PageId nextPageNo = leaf->rightSibPageNo;
+    bufMgr->unPinPage(file, pageNo, false);
+    pageNo = nextPageNo;
+    pinPage(pageNo, page);
+    index = 0;
+  }
+}
 
-  // if not full, directly insert the key and record id to the node
-  if (!isLeafNodeFull(origNode)) {
-    insertToLeafNode(origNode, index, key, rid);
-    bufMgr->unPinPage(file, origPageId, true);
-    return 0;
+/**
+ * Find the entries with the given key.
+ *
+ * @param key the key to find, a pointer to an integer, double or string
+ * @param outRids the array the record ids of the entries are copied to
+ * @param maxRids the number of record ids that fit in outRids
+ * @return the number of entries with the key, of which only the first maxRids
+ *         are copied
+ */
+std::size_t BTreeIndex::lookup(const void *key, RecordId *outRids,
+                               const std::size_t maxRids) {
+  switch (keyType) {
+    case INTEGER_KEY:
+      return lookupKey(KeyTraits<int>::fromPointer(key), outRids, maxRids);
+    case DOUBLE_KEY:
+      return lookupKey(KeyTraits<double>::fromPointer(key), outRids, maxRids);
+    case STRING_KEY:
+      return lookupKey(KeyTraits<StringKey>::fromPointer(key), outRids,
+                       maxRids);
+    case INTEGER_INTEGER_KEY:
+      return lookupKey(KeyTraits<IntIntKey>::fromPointer(key), outRids,
+                       maxRids);
+    case INTEGER_DOUBLE_KEY:
+      return lookupKey(KeyTraits<IntDoubleKey>::fromPointer(key), outRids,
+                       maxRids);
+    case INTEGER_STRING_KEY:
+      return lookupKey(KeyTraits<IntStringKey>::fromPointer(key), outRids,
+                       maxRids);
   }
+  return 0;
+}
 
-  // the node is full at this point
+/**
+ * Find the entries with the given key with one descent from the root.
+ *
+ * @param key the key to find
+ * @param outRids the array the record ids of the entries are copied to
+ * @param maxRids the number of record ids that fit in outRids
+ * @return the number of entries with the key
+ */
+template <class T>
+std::size_t BTreeIndex::lookupKey(const T &key, RecordId *outRids,
+                                  std::size_t maxRids) {
+  count(LOOKUPS);
+  if (concurrent) {
+    // kept by the thread so that its capacity is reused
+    static thread_local vector<RecordId> rids;
+    rids.clear();
+    scanKeyRange(key, GTE, key, LTE, rids);
+    copy(rids.begin(), rids.begin() + min(maxRids, rids.size()), outRids);
+    count(ENTRIES_RETURNED, min(maxRids, rids.size()));
+    return rids.size();
+  }
 
-  // the middle index for spliting the page
-  const int middleIndex = INTARRAYLEAFSIZE / 2;
+  std::size_t numRids = 0;
+  auto emit = [&](RecordId rid) {
+    if (numRids < maxRids) outRids[numRids++] = rid;
+  };
+  std::size_t numMatches = 0;
+  PageId pageNo;
+  Page *page;
+  if (findLeafPage(key, pageNo, page)) {
+    LeafNode<T> *leaf = (LeafNode<T> *)page;
+    int index = findScanIndexLeaf(leaf, key, true);
+    if (index == -1) index = getLeafLen(leaf);
+    numMatches = forEachMatch(key, index, pageNo, page, emit);
+    bufMgr->unPinPage(page, false);
+  }
+  if (numPending > 0) numMatches += forEachPendingMatch(key, emit);
+  count(ENTRIES_RETURNED, numRids);
+  return numMatches;
+}
 
-  // whether the new element is insert to the left half of the original node
-  bool insertToLeft = index < middleIndex;
+/**
+ * Find the entries of each of the given keys.
+ *
+ * @param keys the keys, stored one after another
+ * @param n the number of keys
+ * @param outRids the vector the record ids of the entries are appended to
+ * @param outCounts the vector the number of entries of each key is appended to
+ * @param maxRidsPerKey the number of record ids of a key appended at most
+ */
+const void BTreeIndex::lookupMany(const void *keys, const std::size_t n,
+                                  std::vector<RecordId> &outRids,
+                                  std::vector<std::size_t> &outCounts,
+                                  const std::size_t maxRidsPerKey) {
+  const std::size_t numRids = outRids.size();
+  switch (keyType) {
+    case INTEGER_KEY:
+      lookupManyKeys<int>(keys, n, outRids, outCounts, maxRidsPerKey);
+      break;
+    case DOUBLE_KEY:
+      lookupManyKeys<double>(keys, n, outRids, outCounts, maxRidsPerKey);
+      break;
+    case STRING_KEY:
+      lookupManyKeys<StringKey>(keys, n, outRids, outCounts, maxRidsPerKey);
+      break;
+    case INTEGER_INTEGER_KEY:
+      lookupManyKeys<IntIntKey>(keys, n, outRids, outCounts, maxRidsPerKey);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      lookupManyKeys<IntDoubleKey>(keys, n, outRids, outCounts, maxRidsPerKey);
+      break;
+    case INTEGER_STRING_KEY:
+      lookupManyKeys<IntStringKey>(keys, n, outRids, outCounts, maxRidsPerKey);
+      break;
+  }
+  count(LOOKUPS, n);
+  count(ENTRIES_RETURNED, outRids.size() - numRids);
+}
 
-  // alloc a page for the new node
-  PageId newPageId;
-  LeafNodeInt *newNode = allocLeafNode(newPageId);
+/**
+ * Find the entries of each of the given keys, keeping the leaf of the last key
+ * pinned. A key is looked for in that leaf without descending from the root
+ * if it lies after the first key of the leaf and not after the last one, so
+ * that all of its entries start in the leaf.
+ *
+ * @param keys the keys, stored one after another
+ * @param n the number of keys
+ * @param outRids the vector the record ids of the entries are appended to
+ * @param outCounts the vector the number of entries of each key is appended to
+ * @param maxRidsPerKey the number of record ids of a key appended at most
+ */
+template <class T>
+void BTreeIndex::lookupManyKeys(const void *keys, std::size_t n,
+                                vector<RecordId> &outRids,
+                                vector<std::size_t> &outCounts,
+                                std::size_t maxRidsPerKey) {
+  // where the record ids of the current key start
+  std::size_t keyStart = 0;
+  auto append = [&](RecordId rid) {
+    if (outRids.size() - keyStart < maxRidsPerKey) outRids.push_back(rid);
+  };
 
-  // split the node to origNode and newNode
-  splitLeafNode(origNode, newNode, middleIndex + insertToLeft);
+  if (concurrent) {
+    for (std::size_t i = 0; i < n; i++) {
+      const T key = keyAt<T>(keys, i);
+      keyStart = outRids.size();
+      scanKeyRange(key, GTE, key, LTE, outRids);
+      outCounts.push_back(outRids.size() - keyStart);
+      outRids.resize(keyStart + min(maxRidsPerKey, outCounts.back()));
+    }
+    return;
+  }
 
-  // insert the key and record id to the node
-  if (insertToLeft)
-    insertToLeafNode(origNode, index, key, rid);
-  else
-    insertToLeafNode(newNode, index - middleIndex, key, rid);
+  PageId pageNo = 0;
+  Page *page = NULL;
+  for (std::size_t i = 0; i < n; i++) {
+    const T key = keyAt<T>(keys, i);
+    keyStart = outRids.size();
 
-  // set the next page id
-  newNode->rightSibPageNo = origNode->rightSibPageNo;
-  origNode->rightSibPageNo = newPageId;
+    LeafNode<T> *leaf = (LeafNode<T> *)page;
+    const int len = leaf == NULL ? 0 : getLeafLen(leaf);
+    if (len == 0 || !(getLeafKey(leaf, 0) < key) ||
+        getLeafKey(leaf, len - 1) < key) {
+      if (page != NULL) bufMgr->unPinPage(page, false);
+      if (!findLeafPage(key, pageNo, page)) {
+        page = NULL;
+        outCounts.push_back(
+            numPending > 0 ? forEachPendingMatch(key, append) : 0);
+        continue;
+      }
+      leaf = (LeafNode<T> *)page;
+    }
 
-  // unpin the new node and the original node
-  bufMgr->unPinPage(file, origPageId, true);
-  bufMgr->unPinPage(file, newPageId, true);
+    int index = findScanIndexLeaf(leaf, key, true);
+    if (index == -1) index = getLeafLen(leaf);
+    std::size_t numMatches = forEachMatch(key, index, pageNo, page, append);
+    if (numPending > 0) numMatches += forEachPendingMatch(key, append);
+    outCounts.push_back(numMatches);
+  }
+  if (page != NULL) bufMgr->unPinPage(page, false);
+}
 
-  // set the middle value
-  midVal = newNode->keyArray[0];
-  return newPageId;
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// ############################  Snapshots  ############################ //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+/**
+ * Depth of the changes to an index the calling thread is making.
+ */
+static thread_local int writeDepth = 0;
+
+/**
+ * Mark the calling thread as changing the index, and for the outermost change
+ * of a concurrent index keep snapshots from being opened until it is done.
+ */
+BTreeIndex::WriteScope::WriteScope(BTreeIndex &index)
+    : index(index), outermost(writeDepth++ == 0) {
+  if (outermost && index.concurrent) index.snapshotLatch.lock_shared();
+}
+
+BTreeIndex::WriteScope::~WriteScope() {
+  writeDepth--;
+  if (outermost && index.concurrent) index.snapshotLatch.unlock_shared();
 }
 
 /**
- * Recursively insert the given key-record pair into the subtree with the given
- * root node. If the root node requires a split, the page number of the newly
- * created node will be return
- *
- * @param origPageId page id of the page that stores the root node of the
- *        subtree.
- * @param key the key of the key-record pair to be inserted
- * @param rid the record ID of the key-record pair to be inserted
- * @param midVal a pointer to an integer value to be stored in the parent node.
- *        If the insertion requires a split in the current level, midVal is set
- *        to the smallest key stored in the subtree pointed by the newly created
- *        node.
- *
- * @return the page number of the newly created node if a split occurs, or 0
- *         otherwise.
+ * Copy a page of the index, again for as long as a writer of a concurrent
+ * index changes it meanwhile, so that the copy is consistent.
  */
-PageId BTreeIndex::insert(PageId origPageId, int key, RecordId rid,
-                          int &midVal) {
-  Page *origPage;
-  bufMgr->readPage(file, origPageId, origPage);
+static void copyNode(Page *page, Page *copy, bool concurrent) {
+  while (true) {
+    const std::uint32_t version = concurrent ? readLockNode(page) : 0;
+    memcpy((void *)copy, (const void *)page, sizeof(Page));
+    if (!concurrent || validateNode(page, version)) return;
+  }
+}
 
-  if (isLeaf(origPage))  // base case
-    return insertToLeafPage(origPage, origPageId, key, rid, midVal);
+/**
+ * Save a copy of a leaf or posting list page pinned by a change, unless the
+ * page was saved in the current epoch already. The page is copied before the
+ * change pinning it makes any, and no change spans the start of an epoch, so
+ * the copy is the page as the epoch began.
+ *
+ * @param pageNo the page number
+ * @param page the page, pinned
+ */
+void BTreeIndex::savePageVersion(PageId pageNo, Page *page) {
+  if (writeDepth == 0 || ((FreeNode *)page)->level >= 0) return;
+  auto saved = [&]() {
+    auto versions = pageVersions.find(pageNo);
+    return versions != pageVersions.end() &&
+           versions->second.back().epoch == snapshotEpoch;
+  };
+  {
+    std::lock_guard<std::mutex> guard(versionLatch);
+    if (openSnapshots.empty() || saved()) return;
+  }
 
-  NonLeafNodeInt *origNode = (NonLeafNodeInt *)origPage;
+  std::unique_ptr<Page> copy(new Page);
+  copyNode(page, copy.get(), concurrent);
+  std::lock_guard<std::mutex> guard(versionLatch);
+  if (saved()) return;
+  pageVersions[pageNo].push_back(PageVersion{snapshotEpoch, std::move(copy)});
+  count(PAGES_SAVED);
+}
 
-  // find the child page id
-  int origChildPageIndex = findIndexNonLeaf(origNode, key);
-  PageId origChildPageId = origNode->pageNoArray[origChildPageIndex];
+/**
+ * Copy a page of the index as a snapshot sees it. The page itself is copied
+ * first, and replaced by a copy saved since the snapshot began if there is
+ * one; a change made after the page was copied saved such a copy first.
+ *
+ * @param epoch the epoch of the snapshot
+ * @param pageNo the page number
+ * @param copy the page the copy is made in
+ * @param hint the access hint given to the buffer manager
+ */
+void BTreeIndex::readSnapshotPage(std::uint64_t epoch, PageId pageNo,
+                                  Page *copy, AccessHint hint) {
+  {
+    PageHandle page = pinHandle(pageNo, hint);
+    copyNode(page.get(), copy, concurrent);
+  }
+  std::lock_guard<std::mutex> guard(versionLatch);
+  auto versions = pageVersions.find(pageNo);
+  if (versions == pageVersions.end()) return;
+  for (const PageVersion &version : versions->second) {
+    if (version.epoch >= epoch) {
+      memcpy((void *)copy, (const void *)version.page.get(), sizeof(Page));
+      return;
+    }
+  }
+}
 
-  // insert key, rid to child and check whether child is splitted
-  int newChildMidVal;
-  PageId newChildPageId = insert(origChildPageId, key, rid, newChildMidVal);
+/**
+ * Begin an epoch for a new snapshot and return it.
+ */
+std::uint64_t BTreeIndex::openSnapshot() {
+  std::lock_guard<std::mutex> guard(versionLatch);
+  openSnapshots.insert(++snapshotEpoch);
+  numSnapshots++;
+  return snapshotEpoch;
+}
 
-  // not split in child
-  if (newChildPageId == 0) {
-    bufMgr->unPinPage(file, origPageId, false);
-    return 0;
+/**
+ * Close the snapshot of the given epoch. A copy is read only by snapshots
+ * that began before it was saved, so those older than the oldest open
+ * snapshot are dropped.
+ *
+ * @param epoch the epoch of the snapshot
+ */
+void BTreeIndex::closeSnapshot(std::uint64_t epoch) {
+  std::lock_guard<std::mutex> guard(versionLatch);
+  openSnapshots.erase(openSnapshots.find(epoch));
+  numSnapshots--;
+  if (openSnapshots.empty()) {
+    pageVersions.clear();
+    return;
   }
+  const std::uint64_t oldest = *openSnapshots.begin();
+  for (auto versions = pageVersions.begin(); versions != pageVersions.end();) {
+    std::vector<PageVersion> &copies = versions->second;
+    auto kept = std::find_if(
+        copies.begin(), copies.end(),
+        [&](const PageVersion &version) { return version.epoch >= oldest; });
+    copies.erase(copies.begin(), kept);
+    if (copies.empty())
+      versions = pageVersions.erase(versions);
+    else
+      ++versions;
+  }
+}
 
-  // split in child, need to add splitted child to currNode
-  int index = findIndexNonLeaf(origNode, newChildMidVal);
-  if (!isNonLeafNodeFull(origNode)) {  // current node is not full
-    insertToNonLeafNode(origNode, index, newChildMidVal, newChildPageId);
-    bufMgr->unPinPage(file, origPageId, true);
-    return 0;
+/**
+ * Open a scan of the index as it is now. The scan is positioned while no
+ * change is under way, and its first leaf is then copied, so that the scan
+ * holds no page; the leaves it moves to later are read as of its epoch.
+ *
+ * @param lowValParm the low value of the range
+ * @param lowOpParm the operation to be used in testing the low range
+ * @param highValParm the high value of the range
+ * @param highOpParm the operation to be used in testing the high range
+ * @param hint access hint for the leaves read after the first one
+ * @param order order in which the entries are returned
+ * @return the cursor of the scan
+ */
+IndexScanCursor BTreeIndex::openSnapshotScan(const void *lowValParm,
+                                             Operator lowOpParm,
+                                             const void *highValParm,
+                                             Operator highOpParm,
+                                             AccessHint hint,
+                                             ScanOrder order) {
+  // the inserts still buffered belong to the snapshot
+  flushInsertBuffer();
+  std::unique_lock<std::shared_timed_mutex> changes(snapshotLatch,
+                                                    std::defer_lock);
+  if (concurrent) changes.lock();
+  const std::uint64_t epoch = openSnapshot();
+  IndexScanCursor cursor;
+  try {
+    cursor = openScan(lowValParm, lowOpParm, highValParm, highOpParm, hint,
+                      order);
+  } catch (...) {
+    closeSnapshot(epoch);
+    throw;
   }
+  cursor.snapshot = epoch;
+  cursor.snapshotPage.reset(new Page);
+  memcpy((void *)cursor.snapshotPage.get(),
+         (const void *)cursor.currentPageData, sizeof(Page));
+  bufMgr->unPinPage(file, cursor.currentPageNum, false);
+  cursor.currentPageData = cursor.snapshotPage.get();
+  return cursor;
+}
 
-  // the middle index for spliting the page
-  int middleIndex = (INTARRAYNONLEAFSIZE - 1) / 2;
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// #######################        Scan        ########################## //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
 
-  // whether the new element is insert to the left half of the original node
-  bool insertToLeft = index < middleIndex;
+template <>
+int &IndexScanCursor::lowVal<int>() {
+  return lowValInt;
+}
 
-  // split
-  int splitIndex = middleIndex + insertToLeft;
-  int insertIndex = insertToLeft ? index : index - middleIndex;
+template <>
+int &IndexScanCursor::highVal<int>() {
+  return highValInt;
+}
+
+template <>
+double &IndexScanCursor::lowVal<double>() {
+  return lowValDouble;
+}
+
+template <>
+double &IndexScanCursor::highVal<double>() {
+  return highValDouble;
+}
+
+template <>
+StringKey &IndexScanCursor::lowVal<StringKey>() {
+  return lowValString;
+}
+
+template <>
+StringKey &IndexScanCursor::highVal<StringKey>() {
+  return highValString;
+}
+
+template <>
+IntIntKey &IndexScanCursor::lowVal<IntIntKey>() {
+  return lowValIntInt;
+}
+
+template <>
+IntIntKey &IndexScanCursor::highVal<IntIntKey>() {
+  return highValIntInt;
+}
+
+template <>
+IntDoubleKey &IndexScanCursor::lowVal<IntDoubleKey>() {
+  return lowValIntDouble;
+}
+
+template <>
+IntDoubleKey &IndexScanCursor::highVal<IntDoubleKey>() {
+  return highValIntDouble;
+}
 
-  // insert to right[0]
-  bool moveKeyUp = !insertToLeft && insertIndex == 0;
+template <>
+IntStringKey &IndexScanCursor::lowVal<IntStringKey>() {
+  return lowValIntString;
+}
 
-  // if we need to move key up, set midVal = key, else key at splited index
-  midVal = moveKeyUp ? newChildMidVal : origNode->keyArray[splitIndex];
+template <>
+IntStringKey &IndexScanCursor::highVal<IntStringKey>() {
+  return highValIntString;
+}
 
-  // alloc a page for the new node
-  PageId newPageId;
-  NonLeafNodeInt *newNode = allocNonLeafNode(newPageId);
+/**
+ * Take over the scan of another cursor, which is left with no scan.
+ */
+IndexScanCursor::IndexScanCursor(IndexScanCursor &&other) {
+  *this = std::move(other);
+}
 
-  // split the node to origNode and newNode
-  splitNonLeafNode(origNode, newNode, splitIndex, moveKeyUp);
+/**
+ * End the scan of this cursor, if any, and take over the scan of another
+ * cursor, which is left with no scan.
+ */
+IndexScanCursor &IndexScanCursor::operator=(IndexScanCursor &&other) {
+  if (this == &other) return *this;
+  if (scanExecuting) endScan();
+  // the record ids of a posting list are moved rather than copied
+  std::vector<RecordId> rids;
+  rids.swap(other.postingRids);
+  *this = static_cast<const IndexScanCursor &>(other);
+  postingRids.swap(rids);
+  other.scanExecuting = false;
+  return *this;
+}
 
-  // need to insert
-  if (!moveKeyUp) {
-    NonLeafNodeInt *node = insertToLeft ? origNode : newNode;
-    insertToNonLeafNode(node, insertIndex, newChildMidVal, newChildPageId);
-  }
+IndexScanCursor::~IndexScanCursor() {
+  if (scanExecuting) endScan();
+}
 
-  // write the page back
-  bufMgr->unPinPage(file, origPageId, true);
-  bufMgr->unPinPage(file, newPageId, true);
+/**
+ * Return the sibling of a leaf that a scan in the given order moves to after
+ * it, or 0 if the leaf is the last one in that order.
+ */
+template <class T>
+static PageId scanSibling(const LeafNode<T> *node, ScanOrder order) {
+  return order == ASCENDING ? node->rightSibPageNo : node->leftSibPageNo;
+}
 
-  // return new page
-  return newPageId;
+/**
+ * Change the currently scanning page of a cursor to the next page pointed to by
+ * the current page in the order of the scan. Leaves left empty by deletions
+ * from a concurrent index, which does not merge them, are passed over. A
+ * snapshot scan copies the next page as of its snapshot instead of pinning it.
+ * @param cursor the cursor
+ * @param node the node stored in the currently scanning page.
+ */
+template <class T>
+void BTreeIndex::moveToNextPage(IndexScanCursor &cursor, LeafNode<T> *node) {
+  do {
+    const PageId nextPageNo = scanSibling(node, cursor.order);
+    if (cursor.snapshot == 0)
+      bufMgr->unPinPage(file, cursor.currentPageNum, false);
+    cursor.currentPageNum = nextPageNo;
+    try {
+      if (cursor.snapshot == 0)
+        pinPage(cursor.currentPageNum, cursor.currentPageData,
+                cursor.scanHint);
+      else
+        readSnapshotPage(cursor.snapshot, cursor.currentPageNum,
+                         cursor.currentPageData, cursor.scanHint);
+    } catch (...) {
+      // a corrupt sibling ends the scan, which holds no page any more
+      cursor.scanExecuting = false;
+      if (cursor.snapshot != 0) closeSnapshot(cursor.snapshot);
+      throw;
+    }
+    node = (LeafNode<T> *)cursor.currentPageData;
+  } while (getLeafLen(node) == 0 && scanSibling(node, cursor.order) != 0);
+  cursor.nextEntry = cursor.order == ASCENDING ? 0 : getLeafLen(node) - 1;
+  prefetchSiblings<T>(cursor);
 }
 
 /**
- * Insert a new entry using the pair <value,rid>.
- * Start from root to recursively find out the leaf to insert the entry in.
- * The insertion may cause splitting of leaf node. This splitting will require
- * addition of new leaf page number entry into the parent non-leaf, which may
- * in-turn get split. This may continue all the way upto the root causing the
- * root to get split. If root gets split, metapage needs to be changed
- * accordingly. Make sure to unpin pages as soon as you can.
- * @param key			Key to insert, pointer to integer/double/char
- *string
- * @param rid			Record ID of a record whose entry is getting
- *inserted into the index.
- **/
-const void BTreeIndex::insertEntry(const void *key, const RecordId rid) {
-  int midval;
-  PageId pid = insert(indexMetaInfo.rootPageNo, *(int *)key, rid, midval);
+ * Return the right sibling of the leaf stored in the given page.
+ */
+template <class T>
+static PageId nextLeafPage(const Page &page) {
+  return ((const LeafNode<T> *)&page)->rightSibPageNo;
+}
 
-  if (pid != 0)
-    indexMetaInfo.rootPageNo = splitRoot(midval, indexMetaInfo.rootPageNo, pid);
+/**
+ * Return the left sibling of the leaf stored in the given page.
+ */
+template <class T>
+static PageId prevLeafPage(const Page &page) {
+  return ((const LeafNode<T> *)&page)->leftSibPageNo;
 }
 
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
-// #######################        Scan        ########################## //
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
+/**
+ * Ask the buffer manager to read ahead the leaves that a cursor scans after
+ * its currently scanning page.
+ */
+template <class T>
+void BTreeIndex::prefetchSiblings(IndexScanCursor &cursor) {
+  LeafNode<T> *node = (LeafNode<T> *)cursor.currentPageData;
+  if (cursor.order == ASCENDING)
+    bufMgr->prefetch(file, node->rightSibPageNo, nextLeafPage<T>,
+                     cursor.scanHint);
+  else
+    bufMgr->prefetch(file, node->leftSibPageNo, prevLeafPage<T>,
+                     cursor.scanHint);
+}
 
 /**
- * Change the currently scanning page to the next page pointed to by the current
- * page.
- * @param node the node stored in the currently scanning page.
+ * Recursively find the page id of the leaf a cursor starts at: the first one
+ * that may hold its low bound, or for a descending scan the last one that may
+ * hold a key within its high bound.
+ */
+template <class T>
+void BTreeIndex::setPageIdForScan(IndexScanCursor &cursor, int depth,
+                                  Page **slot) {
+  PinnedNode *pinned;
+  try {
+    pinned = readNode(cursor.currentPageNum, cursor.currentPageData, depth,
+                      slot);
+  } catch (...) {
+    // the parent is unpinned already, so the scan holds no page
+    cursor.scanExecuting = false;
+    throw;
+  }
+  if (isLeaf(cursor.currentPageData)) {
+    prefetchSiblings<T>(cursor);
+    return;
+  }
+
+  NonLeafNode<T> *node = (NonLeafNode<T> *)cursor.currentPageData;
+  int childIndex;
+  if (cursor.order == ASCENDING) {
+    childIndex = findIndexNonLeaf(node, cursor.lowVal<T>());
+  } else {
+    const int len = getNonLeafLen(node);
+    childIndex = findArrayIndex(node->keyArray, len - 1, cursor.highVal<T>(),
+                                cursor.highOp == LT);
+    if (childIndex == -1) childIndex = len - 1;
+  }
+
+  unPinNode(cursor.currentPageNum, false, depth);
+  cursor.currentPageNum = node->pageNoArray[childIndex];
+  setPageIdForScan<T>(cursor, depth + 1, childSlot<T>(pinned, childIndex));
+}
+
+/**
+ * Find the first element of a cursor's scan that is within its bound, starting
+ * at the currently scanning page and moving on for as long as duplicates of
+ * the bound fill whole leaves. A descending scan starts at the last element
+ * within its high bound, and ends up at -1 if there is none.
  */
-void BTreeIndex::moveToNextPage(LeafNodeInt *node) {
-  bufMgr->unPinPage(file, currentPageNum, false);
-  currentPageNum = node->rightSibPageNo;
-  bufMgr->readPage(file, currentPageNum, currentPageData);
-  nextEntry = 0;
+template <class T>
+void BTreeIndex::setEntryIndexForScan(IndexScanCursor &cursor) {
+  LeafNode<T> *node = (LeafNode<T> *)cursor.currentPageData;
+  while (true) {
+    const int len = getLeafLen(node);
+    if (cursor.order == ASCENDING) {
+      const int begin =
+          findScanIndexLeaf(node, cursor.lowVal<T>(), cursor.lowOp == GTE);
+      cursor.nextEntry = begin == -1 ? len : begin;
+      if (cursor.nextEntry < len) return;
+    } else {
+      const int end = findScanIndexLeaf(node, cursor.highVal<T>(),
+                                        cursor.highOp == LT);
+      cursor.nextEntry = (end == -1 ? len : end) - 1;
+      if (cursor.nextEntry >= 0) return;
+    }
+    if (scanSibling(node, cursor.order) == 0) return;
+    moveToNextPage(cursor, node);
+    node = (LeafNode<T> *)cursor.currentPageData;
+  }
 }
 
 /**
- * Recursively find the page id of the first element larger than or equal to the
- * lower bound given.
+ * Open a filtered scan of the index in a cursor of its own.
+ *
+ * @param lowValParm The low value to be tested.
+ * @param lowOpParm The operation to be used in testing the low range.
+ * @param highValParm The high value to be tested.
+ * @param highOpParm The operation to be used in testing the high range.
+ * @param hint Access hint for the leaves read after the first one.
+ * @param order Order in which the entries are returned.
+ * @param snapshot Whether the scan returns the entries as they are now.
+ * @return the cursor of the scan
  */
-void BTreeIndex::setPageIdForScan() {
-  bufMgr->readPage(file, currentPageNum, currentPageData);
-  if (isLeaf(currentPageData)) return;
+IndexScanCursor BTreeIndex::openScan(const void *lowValParm,
+                                     const Operator lowOpParm,
+                                     const void *highValParm,
+                                     const Operator highOpParm,
+                                     const AccessHint hint,
+                                     const ScanOrder order,
+                                     const bool snapshot) {
+  if (lowOpParm != GT && lowOpParm != GTE) throw BadOpcodesException();
+  if (highOpParm != LT && highOpParm != LTE) throw BadOpcodesException();
+  if (snapshot)
+    return openSnapshotScan(lowValParm, lowOpParm, highValParm, highOpParm,
+                            hint, order);
 
-  NonLeafNodeInt *node = (NonLeafNodeInt *)currentPageData;
+  IndexScanCursor cursor;
+  switch (keyType) {
+    case INTEGER_KEY:
+      startKeyScan(cursor, KeyTraits<int>::fromPointer(lowValParm), lowOpParm,
+                   KeyTraits<int>::fromPointer(highValParm), highOpParm, hint,
+                   order);
+      break;
+    case DOUBLE_KEY:
+      startKeyScan(cursor, KeyTraits<double>::fromPointer(lowValParm),
+                   lowOpParm, KeyTraits<double>::fromPointer(highValParm),
+                   highOpParm, hint, order);
+      break;
+    case STRING_KEY:
+      startKeyScan(cursor, KeyTraits<StringKey>::fromPointer(lowValParm),
+                   lowOpParm, KeyTraits<StringKey>::fromPointer(highValParm),
+                   highOpParm, hint, order);
+      break;
+    case INTEGER_INTEGER_KEY:
+      startKeyScan(cursor, KeyTraits<IntIntKey>::fromPointer(lowValParm),
+                   lowOpParm, KeyTraits<IntIntKey>::fromPointer(highValParm),
+                   highOpParm, hint, order);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      startKeyScan(cursor, KeyTraits<IntDoubleKey>::fromPointer(lowValParm),
+                   lowOpParm, KeyTraits<IntDoubleKey>::fromPointer(highValParm),
+                   highOpParm, hint, order);
+      break;
+    case INTEGER_STRING_KEY:
+      startKeyScan(cursor, KeyTraits<IntStringKey>::fromPointer(lowValParm),
+                   lowOpParm,
+                   KeyTraits<IntStringKey>::fromPointer(highValParm),
+                   highOpParm, hint, order);
+      break;
+  }
+  return cursor;
+}
 
-  bufMgr->unPinPage(file, currentPageNum, false);
-  currentPageNum = node->pageNoArray[findIndexNonLeaf(node, lowValInt)];
-  setPageIdForScan();
+/**
+ * Open a scan from the given key to the end of the index in the order of the
+ * scan.
+ *
+ * @param key The key the scan starts at.
+ * @param hint Access hint for the leaves read after the first one.
+ * @param order Order in which the entries are returned.
+ * @return the cursor of the scan
+ */
+IndexScanCursor BTreeIndex::openScanFrom(const void *key,
+                                         const AccessHint hint,
+                                         const ScanOrder order) {
+  IndexScanCursor cursor;
+  switch (keyType) {
+    case INTEGER_KEY:
+      startScanFrom(cursor, KeyTraits<int>::fromPointer(key), hint, order);
+      break;
+    case DOUBLE_KEY:
+      startScanFrom(cursor, KeyTraits<double>::fromPointer(key), hint, order);
+      break;
+    case STRING_KEY:
+      startScanFrom(cursor, KeyTraits<StringKey>::fromPointer(key), hint,
+                    order);
+      break;
+    case INTEGER_INTEGER_KEY:
+      startScanFrom(cursor, KeyTraits<IntIntKey>::fromPointer(key), hint,
+                    order);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      startScanFrom(cursor, KeyTraits<IntDoubleKey>::fromPointer(key), hint,
+                    order);
+      break;
+    case INTEGER_STRING_KEY:
+      startScanFrom(cursor, KeyTraits<IntStringKey>::fromPointer(key), hint,
+                    order);
+      break;
+  }
+  return cursor;
 }
 
 /**
- * Find the first element in the currently scanning page that is within the
- * given bound.
+ * Begin a scan from the given key to the largest key, or for a descending
+ * scan from the smallest key up to the given key.
+ *
+ * @param cursor the cursor the scan is started in
+ * @param key the key the scan starts at
+ * @param hint access hint for the leaves read after the first one
+ * @param order order in which the entries are returned
  */
-void BTreeIndex::setEntryIndexForScan() {
-  LeafNodeInt *node = (LeafNodeInt *)currentPageData;
-  int entryIndex = findScanIndexLeaf(node, lowValInt, lowOp == GTE);
-  if (entryIndex == -1)
-    moveToNextPage(node);
+template <class T>
+void BTreeIndex::startScanFrom(IndexScanCursor &cursor, const T &key,
+                               const AccessHint hint, const ScanOrder order) {
+  if (order == ASCENDING)
+    startKeyScan(cursor, key, GTE, KeyTraits<T>::maxKey(), LTE, hint, order);
   else
-    nextEntry = entryIndex;
+    startKeyScan(cursor, KeyTraits<T>::minKey(), GTE, key, LTE, hint, order);
 }
 
 /**
@@ -660,48 +4695,220 @@ void BTreeIndex::setEntryIndexForScan() {
  * @param lowOpParm The operation to be used in testing the low range.
  * @param highValParm The high value to be tested.
  * @param highOpParm The operation to be used in testing the high range.
+ * @param hint Access hint for the leaves read after the first one.
+ * @param order Order in which scanNext returns the entries.
+ * @param snapshot Whether scanNext returns the entries as they are now.
  */
 const void BTreeIndex::startScan(const void *lowValParm,
                                  const Operator lowOpParm,
                                  const void *highValParm,
-                                 const Operator highOpParm) {
+                                 const Operator highOpParm,
+                                 const AccessHint hint, const ScanOrder order,
+                                 const bool snapshot) {
+  if (scanCursor.isExecuting()) scanCursor.endScan();
+  scanCursor = openScan(lowValParm, lowOpParm, highValParm, highOpParm, hint,
+                        order, snapshot);
+}
+
+/**
+ * Open a scan of the entries whose leading key columns lie in the given range,
+ * in a cursor of its own.
+ *
+ * @param lowValParm The low values of the leading columns.
+ * @param lowOpParm The operation to be used in testing the low range.
+ * @param highValParm The high values of the leading columns.
+ * @param highOpParm The operation to be used in testing the high range.
+ * @param numColumns The number of leading columns the values are given for.
+ * @param hint Access hint for the leaves read after the first one.
+ * @param order Order in which the entries are returned.
+ * @return the cursor of the scan
+ */
+IndexScanCursor BTreeIndex::openPrefixScan(
+    const void *lowValParm, const Operator lowOpParm, const void *highValParm,
+    const Operator highOpParm, const int numColumns, const AccessHint hint,
+    const ScanOrder order) {
   if (lowOpParm != GT && lowOpParm != GTE) throw BadOpcodesException();
   if (highOpParm != LT && highOpParm != LTE) throw BadOpcodesException();
+  if (numColumns < 1 || numColumns > indexMetaInfo.numKeyColumns)
+    throw BadScanrangeException();
+
+  IndexScanCursor cursor;
+  switch (keyType) {
+    case INTEGER_KEY:
+      startPrefixKeyScan<int>(cursor, lowValParm, lowOpParm, highValParm,
+                              highOpParm, numColumns, hint, order);
+      break;
+    case DOUBLE_KEY:
+      startPrefixKeyScan<double>(cursor, lowValParm, lowOpParm, highValParm,
+                                 highOpParm, numColumns, hint, order);
+      break;
+    case STRING_KEY:
+      startPrefixKeyScan<StringKey>(cursor, lowValParm, lowOpParm,
+                                    highValParm, highOpParm, numColumns, hint,
+                                    order);
+      break;
+    case INTEGER_INTEGER_KEY:
+      startPrefixKeyScan<IntIntKey>(cursor, lowValParm, lowOpParm,
+                                    highValParm, highOpParm, numColumns, hint,
+                                    order);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      startPrefixKeyScan<IntDoubleKey>(cursor, lowValParm, lowOpParm,
+                                       highValParm, highOpParm, numColumns,
+                                       hint, order);
+      break;
+    case INTEGER_STRING_KEY:
+      startPrefixKeyScan<IntStringKey>(cursor, lowValParm, lowOpParm,
+                                       highValParm, highOpParm, numColumns,
+                                       hint, order);
+      break;
+  }
+  return cursor;
+}
+
+/**
+ * Begin a scan of the entries whose leading key columns lie in the given
+ * range.
+ *
+ * @param lowValParm The low values of the leading columns.
+ * @param lowOpParm The operation to be used in testing the low range.
+ * @param highValParm The high values of the leading columns.
+ * @param highOpParm The operation to be used in testing the high range.
+ * @param numColumns The number of leading columns the values are given for.
+ * @param hint Access hint for the leaves read after the first one.
+ * @param order Order in which scanNext returns the entries.
+ */
+const void BTreeIndex::startPrefixScan(
+    const void *lowValParm, const Operator lowOpParm, const void *highValParm,
+    const Operator highOpParm, const int numColumns, const AccessHint hint,
+    const ScanOrder order) {
+  if (scanCursor.isExecuting()) scanCursor.endScan();
+  scanCursor = openPrefixScan(lowValParm, lowOpParm, highValParm, highOpParm,
+                              numColumns, hint, order);
+}
+
+/**
+ * Begin a scan for the given range, whose operators have been checked.
+ *
+ * @param cursor the cursor the scan is started in
+ * @param lowValParm the low value of the range
+ * @param lowOpParm the operation to be used in testing the low range
+ * @param highValParm the high value of the range
+ * @param highOpParm the operation to be used in testing the high range
+ * @param hint access hint for the leaves read after the first one
+ * @param order order in which the entries are returned
+ */
+template <class T>
+void BTreeIndex::startKeyScan(IndexScanCursor &cursor, const T &lowValParm,
+                              const Operator lowOpParm, const T &highValParm,
+                              const Operator highOpParm, const AccessHint hint,
+                              const ScanOrder order) {
+  if (lowValParm > highValParm) throw BadScanrangeException();
+  if (numPending > 0) flushPending<T>();
+  count(SCANS_STARTED);
+  cursor.index = this;
+  cursor.lowVal<T>() = lowValParm;
+  cursor.highVal<T>() = highValParm;
 
-  lowValInt = *((int *)lowValParm);
-  highValInt = *((int *)highValParm);
-  if (lowValInt > highValInt) throw BadScanrangeException();
+  cursor.lowOp = lowOpParm;
+  cursor.highOp = highOpParm;
+  cursor.scanHint = hint;
+  cursor.order = order;
+  cursor.inPostingList = false;
+  cursor.entriesLeft = std::numeric_limits<std::size_t>::max();
 
-  lowOp = lowOpParm;
-  highOp = highOpParm;
+  cursor.scanExecuting = true;
 
-  scanExecuting = true;
+  cursor.currentPageNum = indexMetaInfo.rootPageNo;
 
-  currentPageNum = indexMetaInfo.rootPageNo;
+  // an ascending scan whose range the summary of its first leaf excludes
+  // ends without reading the leaf
+  int index = 0;
+  PinnedNode *parent = order == ASCENDING && leafSummaries
+                           ? findPinnedParent(lowValParm, index)
+                           : NULL;
+  if (parent != NULL &&
+      summaryExcludes(*parent, index, lowValParm, highValParm)) {
+    count(LEAVES_SKIPPED);
+    cursor.scanExecuting = false;
+    throw NoSuchKeyFoundException();
+  }
 
-  setPageIdForScan();
-  setEntryIndexForScan();
+  setPageIdForScan<T>(cursor);
+  if (parent != NULL && ((NonLeafNode<T> *)parent->page)->pageNoArray[index] ==
+                            cursor.currentPageNum)
+    summarizeLeaf(*parent, index, (LeafNode<T> *)cursor.currentPageData);
+  setEntryIndexForScan<T>(cursor);
 
-  LeafNodeInt *node = (LeafNodeInt *)currentPageData;
-  RecordId outRid = node->ridArray[nextEntry];
-  if ((outRid.page_number == 0 && outRid.slot_number == 0) ||
-      node->keyArray[nextEntry] > highValInt ||
-      (node->keyArray[nextEntry] == highValInt && highOp == LT)) {
-    endScan();
+  LeafNode<T> *node = (LeafNode<T> *)cursor.currentPageData;
+  bool empty;
+  if (order == ASCENDING)
+    empty = cursor.nextEntry >= getLeafLen(node) ||
+            getLeafKey(node, cursor.nextEntry) > highValParm ||
+            (getLeafKey(node, cursor.nextEntry) == highValParm &&
+             cursor.highOp == LT);
+  else
+    empty = cursor.nextEntry < 0 ||
+            getLeafKey(node, cursor.nextEntry) < lowValParm ||
+            (getLeafKey(node, cursor.nextEntry) == lowValParm &&
+             cursor.lowOp == GT);
+  if (empty) {
+    cursor.endScan();
     throw NoSuchKeyFoundException();
   }
 }
 
+/**
+ * Begin a scan for the range bounded by the given values of the leading
+ * columns of the keys. A key after the low values, or before the high ones,
+ * is one after, or before, every key that starts with them; a key from the
+ * low values, or up to the high ones, includes every key that starts with
+ * them.
+ *
+ * @param cursor the cursor the scan is started in
+ * @param lowValParm the low values of the range
+ * @param lowOpParm the operation to be used in testing the low range
+ * @param highValParm the high values of the range
+ * @param highOpParm the operation to be used in testing the high range
+ * @param numColumns the number of leading columns the values are given for
+ * @param hint access hint for the leaves read after the first one
+ * @param order order in which the entries are returned
+ */
+template <class T>
+void BTreeIndex::startPrefixKeyScan(IndexScanCursor &cursor,
+                                    const void *lowValParm,
+                                    const Operator lowOpParm,
+                                    const void *highValParm,
+                                    const Operator highOpParm,
+                                    const int numColumns,
+                                    const AccessHint hint,
+                                    const ScanOrder order) {
+  T lowFirst, lowLast, highFirst, highLast;
+  KeyTraits<T>::prefixRange(lowValParm, numColumns, lowFirst, lowLast);
+  KeyTraits<T>::prefixRange(highValParm, numColumns, highFirst, highLast);
+  if (lowFirst > highFirst) throw BadScanrangeException();
+
+  const T &low = lowOpParm == GTE ? lowFirst : lowLast;
+  const T &high = highOpParm == LTE ? highLast : highFirst;
+  if (low > high) throw NoSuchKeyFoundException();
+  startKeyScan(cursor, low, lowOpParm, high, highOpParm, hint, order);
+}
+
 /**
  * Continue scanning the next entry. If the currently scanning entry is the last
  * element in this page, set the current scanning page to the next page.
  */
-void BTreeIndex::setNextEntry() {
-  nextEntry++;
-  LeafNodeInt *node = (LeafNodeInt *)currentPageData;
-  if (nextEntry >= INTARRAYLEAFSIZE ||
-      node->ridArray[nextEntry].page_number == 0) {
-    moveToNextPage(node);
+template <class T>
+void BTreeIndex::setNextEntry(IndexScanCursor &cursor) {
+  LeafNode<T> *node = (LeafNode<T> *)cursor.currentPageData;
+  if (cursor.order == ASCENDING) {
+    cursor.nextEntry++;
+    if (cursor.nextEntry >= getLeafLen(node) && node->rightSibPageNo != 0)
+      moveToNextPage(cursor, node);
+  } else {
+    cursor.nextEntry--;
+    if (cursor.nextEntry < 0 && node->leftSibPageNo != 0)
+      moveToNextPage(cursor, node);
   }
 }
 
@@ -722,20 +4929,468 @@ void BTreeIndex::setNextEntry() {
  *               This is the record id of the next entry that matches the scan
  * filter set in startScan.
  */
-const void BTreeIndex::scanNext(RecordId &outRid) {
+const void BTreeIndex::scanNext(RecordId &outRid, char *outColumns) {
+  scanCursor.scanNext(outRid, outColumns);
+}
+
+/**
+ * Fetch the record id of the next index entry that matches the scan.
+ *
+ * @param outRid the record id of the next matching entry
+ * @param outColumns the buffer the covered columns of the entry are copied
+ *        to, or NULL
+ */
+void IndexScanCursor::scanNext(RecordId &outRid, char *outColumns) {
+  if (!scanExecuting) throw ScanNotInitializedException();
+  if (entriesLeft == 0) throw IndexScanCompletedException();
+
+  switch (index->keyType) {
+    case INTEGER_KEY:
+      index->scanNextKey<int>(*this, outRid, outColumns);
+      break;
+    case DOUBLE_KEY:
+      index->scanNextKey<double>(*this, outRid, outColumns);
+      break;
+    case STRING_KEY:
+      index->scanNextKey<StringKey>(*this, outRid, outColumns);
+      break;
+    case INTEGER_INTEGER_KEY:
+      index->scanNextKey<IntIntKey>(*this, outRid, outColumns);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      index->scanNextKey<IntDoubleKey>(*this, outRid, outColumns);
+      break;
+    case INTEGER_STRING_KEY:
+      index->scanNextKey<IntStringKey>(*this, outRid, outColumns);
+      break;
+  }
+  entriesLeft--;
+  index->count(BTreeIndex::ENTRIES_RETURNED);
+}
+
+/**
+ * Fetch the record id of the next index entry that matches the scan of a
+ * cursor.
+ *
+ * @param cursor the cursor
+ * @param outRid the record id of the next matching entry
+ * @param outColumns the buffer the covered columns of the entry are copied
+ *        to, or NULL
+ */
+template <class T>
+void BTreeIndex::scanNextKey(IndexScanCursor &cursor, RecordId &outRid,
+                             char *outColumns) {
+  LeafNode<T> *node = (LeafNode<T> *)cursor.currentPageData;
+
+  if (cursor.order == DESCENDING) {
+    // past the first entry of the first leaf
+    if (cursor.nextEntry < 0) throw IndexScanCompletedException();
+
+    const T val = getLeafKey(node, cursor.nextEntry);
+    if (val < cursor.lowVal<T>() ||
+        (val == cursor.lowVal<T>() && cursor.lowOp == GT)) {
+      throw IndexScanCompletedException();
+    }
+  } else {
+    // past the last entry of the last leaf
+    if (cursor.nextEntry >= getLeafLen(node))
+      throw IndexScanCompletedException();
+
+    const T val = getLeafKey(node, cursor.nextEntry);
+    if (val > cursor.highVal<T>() ||  // value is out of range
+        (val == cursor.highVal<T>() &&
+         cursor.highOp == LT)) {  // value reaches the higher end
+      throw IndexScanCompletedException();
+    }
+  }
+
+  // the cursor stays on the entry of a posting list until the list is done
+  const RecordId rid = getLeafRid(node, cursor.nextEntry);
+  if (isPostingList(rid)) {
+    nextPostingRids(cursor, rid, &outRid, 1);
+    if (cursor.inPostingList) return;
+  } else {
+    outRid = rid;
+    if (outColumns != NULL && coveredSize > 0)
+      memcpy(outColumns, getLeafColumns(node, cursor.nextEntry), coveredSize);
+  }
+  setNextEntry<T>(cursor);
+}
+
+/**
+ * Copy the record ids of the next entries that match the scan to outRids, a
+ * leaf at a time, stopping at the end of the scan without throwing.
+ *
+ * @param outRids the array the record ids are copied to
+ * @param maxRids the number of record ids that fit in outRids
+ * @param outColumns the buffer the covered columns of the entries are copied
+ *        to, or NULL
+ * @param outKeys the buffer the keys of the entries are copied to, or NULL
+ * @return the number of record ids copied, which is less than maxRids only at
+ *         the end of the scan
+ */
+std::size_t BTreeIndex::scanNextBatch(RecordId *outRids,
+                                      const std::size_t maxRids,
+                                      char *outColumns, void *outKeys) {
+  return scanCursor.scanNextBatch(outRids, maxRids, outColumns, outKeys);
+}
+
+/**
+ * Copy the record ids of the next entries that match the scan to outRids, up
+ * to the limit of the scan.
+ *
+ * @param outRids the array the record ids are copied to
+ * @param maxRids the number of record ids that fit in outRids
+ * @param outColumns the buffer the covered columns of the entries are copied
+ *        to, or NULL
+ * @param outKeys the buffer the keys of the entries are copied to, or NULL
+ * @return the number of record ids copied
+ */
+std::size_t IndexScanCursor::scanNextBatch(RecordId *outRids,
+                                           std::size_t maxRids,
+                                           char *outColumns, void *outKeys) {
+  if (!scanExecuting) throw ScanNotInitializedException();
+  const std::size_t numRids = nextBatch(
+      outRids, std::min(maxRids, entriesLeft), outColumns, outKeys);
+  entriesLeft -= numRids;
+  index->count(BTreeIndex::ENTRIES_RETURNED, numRids);
+  return numRids;
+}
+
+/**
+ * Pass over the next entries of the scan, a batch at a time.
+ *
+ * @param n the number of entries passed over
+ * @return the number of entries passed over
+ */
+std::size_t IndexScanCursor::skip(std::size_t n) {
+  if (!scanExecuting) throw ScanNotInitializedException();
+  RecordId rids[256];
+  std::size_t skipped = 0;
+  while (skipped < n) {
+    const std::size_t want = std::min<std::size_t>(n - skipped, 256);
+    const std::size_t numRids = nextBatch(rids, want, NULL, NULL);
+    skipped += numRids;
+    if (numRids < want) break;
+  }
+  return skipped;
+}
+
+/**
+ * Copy the record ids of the next entries that match the scan to outRids.
+ *
+ * @param outRids the array the record ids are copied to
+ * @param maxRids the number of record ids that fit in outRids
+ * @param outColumns the buffer the covered columns of the entries are copied
+ *        to, or NULL
+ * @param outKeys the buffer the keys of the entries are copied to, or NULL
+ * @return the number of record ids copied
+ */
+std::size_t IndexScanCursor::nextBatch(RecordId *outRids, std::size_t maxRids,
+                                       char *outColumns, void *outKeys) {
+  switch (index->keyType) {
+    case INTEGER_KEY:
+      return index->scanNextBatchKey<int>(*this, outRids, maxRids,
+                                          outColumns, (char *)outKeys);
+    case DOUBLE_KEY:
+      return index->scanNextBatchKey<double>(*this, outRids, maxRids,
+                                             outColumns, (char *)outKeys);
+    case STRING_KEY:
+      return index->scanNextBatchKey<StringKey>(*this, outRids, maxRids,
+                                                outColumns, (char *)outKeys);
+    case INTEGER_INTEGER_KEY:
+      return index->scanNextBatchKey<IntIntKey>(*this, outRids, maxRids,
+                                                outColumns, (char *)outKeys);
+    case INTEGER_DOUBLE_KEY:
+      return index->scanNextBatchKey<IntDoubleKey>(*this, outRids, maxRids,
+                                                   outColumns, (char *)outKeys);
+    case INTEGER_STRING_KEY:
+      return index->scanNextBatchKey<IntStringKey>(*this, outRids, maxRids,
+                                                   outColumns, (char *)outKeys);
+  }
+  return 0;
+}
+
+/**
+ * Copy the record ids of the next entries that match the scan of a cursor to
+ * outRids. The high bound is found once in each leaf, and the entries before
+ * it are copied without comparing their keys; a descending scan does the same
+ * with the low bound.
+ *
+ * @param cursor the cursor
+ * @param outRids the array the record ids are copied to
+ * @param maxRids the number of record ids that fit in outRids
+ * @param outColumns the buffer the covered columns of the entries are copied
+ *        to, or NULL
+ * @param outKeys the buffer the keys of the entries are copied to, or NULL
+ * @return the number of record ids copied
+ */
+template <class T>
+std::size_t BTreeIndex::scanNextBatchKey(IndexScanCursor &cursor,
+                                         RecordId *outRids,
+                                         std::size_t maxRids,
+                                         char *outColumns, char *outKeys) {
+  const bool copyColumns = outColumns != NULL && coveredSize > 0;
+  const int keySize = KeyTraits<T>::VALUESIZE;
+  std::size_t numRids = 0;
+  if (cursor.order == DESCENDING) {
+    while (numRids < maxRids) {
+      LeafNode<T> *node = (LeafNode<T> *)cursor.currentPageData;
+      int begin =
+          findScanIndexLeaf(node, cursor.lowVal<T>(), cursor.lowOp == GTE);
+      if (begin == -1) begin = getLeafLen(node);
+      if (cursor.nextEntry < begin) break;
+
+      for (; cursor.nextEntry >= begin && numRids < maxRids;
+           cursor.nextEntry--) {
+        const RecordId rid = getLeafRid(node, cursor.nextEntry);
+        const std::size_t first = numRids;
+        if (!isPostingList(rid)) {
+          if (copyColumns)
+            memcpy(outColumns + numRids * coveredSize,
+                   getLeafColumns(node, cursor.nextEntry), coveredSize);
+          outRids[numRids++] = rid;
+        } else {
+          numRids += nextPostingRids(cursor, rid, outRids + numRids,
+                                     maxRids - numRids);
+        }
+        if (outKeys != NULL) {
+          const T key = getLeafKey(node, cursor.nextEntry);
+          for (std::size_t k = first; k < numRids; k++)
+            KeyTraits<T>::toPointer(key, outKeys + k * keySize);
+        }
+        if (cursor.inPostingList) break;
+      }
+
+      if (cursor.nextEntry < 0 && node->leftSibPageNo != 0)
+        moveToNextPage(cursor, node);
+    }
+    return numRids;
+  }
+
+  while (numRids < maxRids) {
+    LeafNode<T> *node = (LeafNode<T> *)cursor.currentPageData;
+    const int len = getLeafLen(node);
+    int end = findScanIndexLeaf(node, cursor.highVal<T>(), cursor.highOp == LT);
+    if (end == -1) end = len;
+    if (cursor.nextEntry >= end) break;
+
+    for (; cursor.nextEntry < end && numRids < maxRids; cursor.nextEntry++) {
+      const RecordId rid = getLeafRid(node, cursor.nextEntry);
+      const std::size_t first = numRids;
+      if (!isPostingList(rid)) {
+        if (copyColumns)
+          memcpy(outColumns + numRids * coveredSize,
+                 getLeafColumns(node, cursor.nextEntry), coveredSize);
+        outRids[numRids++] = rid;
+      } else {
+        numRids += nextPostingRids(cursor, rid, outRids + numRids,
+                                   maxRids - numRids);
+      }
+      if (outKeys != NULL) {
+        const T key = getLeafKey(node, cursor.nextEntry);
+        for (std::size_t k = first; k < numRids; k++)
+          KeyTraits<T>::toPointer(key, outKeys + k * keySize);
+      }
+      if (cursor.inPostingList) break;
+    }
+
+    if (cursor.nextEntry >= len && node->rightSibPageNo != 0)
+      moveToNextPage(cursor, node);
+  }
+  return numRids;
+}
+
+/**
+ * Move the scan to the first entry of its range not before the given key in
+ * the order of the scan.
+ *
+ * @param key the key
+ */
+void IndexScanCursor::seek(const void *key) {
   if (!scanExecuting) throw ScanNotInitializedException();
 
-  LeafNodeInt *node = (LeafNodeInt *)currentPageData;
-  outRid = node->ridArray[nextEntry];
-  int val = node->keyArray[nextEntry];
+  switch (index->keyType) {
+    case INTEGER_KEY:
+      index->seekKey(*this, KeyTraits<int>::fromPointer(key));
+      break;
+    case DOUBLE_KEY:
+      index->seekKey(*this, KeyTraits<double>::fromPointer(key));
+      break;
+    case STRING_KEY:
+      index->seekKey(*this, KeyTraits<StringKey>::fromPointer(key));
+      break;
+    case INTEGER_INTEGER_KEY:
+      index->seekKey(*this, KeyTraits<IntIntKey>::fromPointer(key));
+      break;
+    case INTEGER_DOUBLE_KEY:
+      index->seekKey(*this, KeyTraits<IntDoubleKey>::fromPointer(key));
+      break;
+    case INTEGER_STRING_KEY:
+      index->seekKey(*this, KeyTraits<IntStringKey>::fromPointer(key));
+      break;
+  }
+}
+
+/**
+ * Move the scan of a cursor to the first entry of its range not before the
+ * given key. A key outside of the range is moved to its bound. The entry is
+ * looked for in the leaf being scanned if that leaf has keys on both sides of
+ * the key, so that no entry of it lies in another leaf; otherwise the scan is
+ * started over from the root with the key as its bound, which is then put
+ * back.
+ *
+ * @param cursor the cursor
+ * @param keyParm the key
+ */
+template <class T>
+void BTreeIndex::seekKey(IndexScanCursor &cursor, const T &keyParm) {
+  cursor.inPostingList = false;
+  LeafNode<T> *node = (LeafNode<T> *)cursor.currentPageData;
+  const int len = getLeafLen(node);
+  const bool ascending = cursor.order == ASCENDING;
+
+  // the bound the scan restarts from, and whether it includes its key
+  T key = keyParm;
+  bool includeKey = true;
+  if (ascending && !(cursor.lowVal<T>() < key)) {
+    key = cursor.lowVal<T>();
+    includeKey = cursor.lowOp == GTE;
+  } else if (!ascending && !(key < cursor.highVal<T>())) {
+    key = cursor.highVal<T>();
+    includeKey = cursor.highOp == LTE;
+  }
+
+  // whether an entry of the given key comes before the position sought
+  auto before = [&](const T &entryKey) {
+    if (ascending) return entryKey < key || (!includeKey && entryKey == key);
+    return key < entryKey || (!includeKey && entryKey == key);
+  };
+  if (len > 0) {
+    const int first = ascending ? 0 : len - 1;
+    const int last = ascending ? len - 1 : 0;
+    if (before(getLeafKey(node, first)) && !before(getLeafKey(node, last))) {
+      const int index = findScanIndexLeaf(node, key, ascending == includeKey);
+      cursor.nextEntry = ascending ? index : (index == -1 ? len : index) - 1;
+      return;
+    }
+  }
+
+  T &bound = ascending ? cursor.lowVal<T>() : cursor.highVal<T>();
+  Operator &boundOp = ascending ? cursor.lowOp : cursor.highOp;
+  const T oldBound = bound;
+  const Operator oldBoundOp = boundOp;
+  bound = key;
+  boundOp = ascending ? (includeKey ? GTE : GT) : (includeKey ? LTE : LT);
+  if (cursor.snapshot != 0) {
+    // the upper levels are those of now, so a snapshot scan walks back over
+    // its leaves to one whose first entry lies before the position, and on
+    // from there
+    while (true) {
+      const int leafLen = getLeafLen(node);
+      if (leafLen > 0 &&
+          before(getLeafKey(node, ascending ? 0 : leafLen - 1)))
+        break;
+      const PageId prevPageNo = ascending ? node->leftSibPageNo
+                                          : node->rightSibPageNo;
+      if (prevPageNo == 0) break;
+      cursor.currentPageNum = prevPageNo;
+      readSnapshotPage(cursor.snapshot, prevPageNo, cursor.currentPageData,
+                       cursor.scanHint);
+    }
+  } else {
+    bufMgr->unPinPage(file, cursor.currentPageNum, false);
+    cursor.scanExecuting = false;
+    cursor.currentPageNum = indexMetaInfo.rootPageNo;
+    setPageIdForScan<T>(cursor);
+    cursor.scanExecuting = true;
+  }
+  setEntryIndexForScan<T>(cursor);
+  bound = oldBound;
+  boundOp = oldBoundOp;
+}
+
+/**
+ * Decode a page of a posting list into the posting list state of a cursor, in
+ * the order of its scan, and remember the page that comes after it in that
+ * order.
+ *
+ * @param cursor the cursor
+ * @param pageNo the page number of the posting list page
+ */
+void BTreeIndex::loadPostingPage(IndexScanCursor &cursor, PageId pageNo) {
+  PageHandle handle;
+  std::unique_ptr<Page> copy;
+  PostingPage *page;
+  if (cursor.snapshot == 0) {
+    handle = pinHandle(pageNo, cursor.scanHint);
+    page = handle.as<PostingPage>();
+  } else {
+    copy.reset(new Page);
+    readSnapshotPage(cursor.snapshot, pageNo, copy.get(), cursor.scanHint);
+    page = (PostingPage *)copy.get();
+  }
+  // the vector keeps its capacity from page to page, and from scan to scan
+  if (cursor.postingRids.capacity() == 0)
+    cursor.postingRids = postingBuffers.take();
+  cursor.postingRids.clear();
+  decodePostingPage(
+      page, [&](RecordId rid) { cursor.postingRids.push_back(rid); });
+  cursor.postingNext = 0;
+  if (cursor.order == ASCENDING) {
+    cursor.postingNextPageNo = page->nextPageNo;
+  } else {
+    reverse(cursor.postingRids.begin(), cursor.postingRids.end());
+    cursor.postingNextPageNo = page->prevPageNo;
+  }
+}
+
+/**
+ * Copy the next record ids of the posting list an entry stands for. A cursor
+ * enters the list at its first page, or at its last one when descending, and
+ * decodes one page at a time; it leaves the list as soon as the last record id
+ * has been copied.
+ *
+ * @param cursor the cursor
+ * @param listRid the record id of the entry
+ * @param outRids the array the record ids are copied to
+ * @param maxRids the number of record ids that fit in outRids
+ * @return the number of record ids copied
+ */
+std::size_t BTreeIndex::nextPostingRids(IndexScanCursor &cursor,
+                                        RecordId listRid, RecordId *outRids,
+                                        std::size_t maxRids) {
+  if (!cursor.inPostingList) {
+    PageId pageNo = listRid.page_number;
+    if (cursor.order == DESCENDING && cursor.snapshot != 0) {
+      std::unique_ptr<Page> head(new Page);
+      readSnapshotPage(cursor.snapshot, pageNo, head.get(), cursor.scanHint);
+      pageNo = ((PostingPage *)head.get())->lastPageNo;
+    } else if (cursor.order == DESCENDING) {
+      pageNo = pinHandle(pageNo).as<PostingPage>()->lastPageNo;
+    }
+    loadPostingPage(cursor, pageNo);
+    cursor.inPostingList = true;
+  }
+
+  std::size_t numRids = 0;
+  while (numRids < maxRids) {
+    const std::size_t count =
+        min(maxRids - numRids, cursor.postingRids.size() - cursor.postingNext);
+    copy(cursor.postingRids.begin() + cursor.postingNext,
+         cursor.postingRids.begin() + cursor.postingNext + count,
+         outRids + numRids);
+    numRids += count;
+    cursor.postingNext += count;
+    if (cursor.postingNext < cursor.postingRids.size()) break;
 
-  if ((outRid.page_number == 0 &&
-       outRid.slot_number == 0) ||            // current record ID is empty
-      val > highValInt ||                     // value is out of range
-      (val == highValInt && highOp == LT)) {  // value reaches the higher end
-    throw IndexScanCompletedException();
+    if (cursor.postingNextPageNo == 0) {
+      cursor.inPostingList = false;
+      break;
+    }
+    loadPostingPage(cursor, cursor.postingNextPageNo);
   }
-  setNextEntry();
+  return numRids;
 }
 
 /**
@@ -745,10 +5400,212 @@ const void BTreeIndex::scanNext(RecordId &outRid) {
  * It throws ScanNotInitializedException when called before a successful
  * startScan call.
  */
-const void BTreeIndex::endScan() {
+const void BTreeIndex::endScan() { scanCursor.endScan(); }
+
+/**
+ * Terminate the scan of the cursor and unpin the leaf being scanned. The
+ * posting list buffer of the cursor goes back to its index for a later scan.
+ */
+void IndexScanCursor::endScan() {
   if (!scanExecuting) throw ScanNotInitializedException();
   scanExecuting = false;
-  bufMgr->unPinPage(file, currentPageNum, false);
+  if (snapshot != 0) {
+    index->closeSnapshot(snapshot);
+    snapshot = 0;
+    snapshotPage.reset();
+  } else {
+    index->bufMgr->unPinPage(index->file, currentPageNum, false);
+  }
+  if (postingRids.capacity() > 0) {
+    std::vector<RecordId> rids;
+    rids.swap(postingRids);
+    index->postingBuffers.give(std::move(rids));
+  }
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// ########################     Statistics     ######################### //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+IndexStats BTreeIndex::getStats() {
+  flushInsertBuffer();
+  IndexStats stats{};
+  switch (keyType) {
+    case INTEGER_KEY:
+      collectStats<int>(stats);
+      break;
+    case DOUBLE_KEY:
+      collectStats<double>(stats);
+      break;
+    case STRING_KEY:
+      collectStats<StringKey>(stats);
+      break;
+    case INTEGER_INTEGER_KEY:
+      collectStats<IntIntKey>(stats);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      collectStats<IntDoubleKey>(stats);
+      break;
+    case INTEGER_STRING_KEY:
+      collectStats<IntStringKey>(stats);
+      break;
+  }
+  return stats;
+}
+
+/**
+ * Walk down the leftmost path of the tree and along its leaves. The capacity
+ * of a STRING leaf depends on the prefix its keys share, so each leaf is
+ * compared with what it could hold with the keys it has.
+ *
+ * @param stats the statistics filled in
+ */
+template <class T>
+void BTreeIndex::collectStats(IndexStats &stats) {
+  PageHandle page = pinHandle(loadRootPageNo());
+  stats.height = 1;
+  while (!isLeaf(page.get())) {
+    const PageId childPageNo = page.as<NonLeafNode<T>>()->pageNoArray[0];
+    page.release();
+    page = pinHandle(childPageNo);
+    stats.height++;
+  }
+
+  double capacity = 0;
+  std::size_t leafEntries = 0;
+  T lastKey{};
+  while (true) {
+    LeafNode<T> *leaf = page.as<LeafNode<T>>();
+    const int len = getLeafLen(leaf);
+    stats.numLeaves++;
+    leafEntries += len;
+    capacity += len == 0 ? maxLeafCapacity<T>()
+                         : getLeafCapacity(leaf, getLeafKey(leaf, 0));
+    for (int i = 0; i < len; i++) {
+      const T key = getLeafKey(leaf, i);
+      if (stats.distinctKeys == 0 || key != lastKey) stats.distinctKeys++;
+      lastKey = key;
+      const RecordId rid = getLeafRid(leaf, i);
+      if (isPostingList(rid)) {
+        stats.numEntries +=
+            pinHandle(rid.page_number).as<PostingPage>()->totalRids;
+      } else {
+        stats.numEntries++;
+      }
+    }
+    const PageId nextPageNo = leaf->rightSibPageNo;
+    page.release();
+    if (nextPageNo == 0) break;
+    page = pinHandle(nextPageNo);
+  }
+  stats.fillFactor = capacity == 0 ? 0 : leafEntries / capacity;
+}
+
+IndexCounters BTreeIndex::getCounters() const {
+  IndexCounters result;
+  result.inserts = counters[INSERTS];
+  result.deletes = counters[DELETES];
+  result.lookups = counters[LOOKUPS];
+  result.leafSplits = counters[LEAF_SPLITS];
+  result.nonLeafSplits = counters[NONLEAF_SPLITS];
+  result.rootSplits = counters[ROOT_SPLITS];
+  result.scansStarted = counters[SCANS_STARTED];
+  result.entriesReturned = counters[ENTRIES_RETURNED];
+  result.pagesPinned = counters[PAGES_PINNED];
+  result.leavesSkipped = counters[LEAVES_SKIPPED];
+  result.bufferFlushes = counters[BUFFER_FLUSHES];
+  result.pagesSaved = counters[PAGES_SAVED];
+  return result;
+}
+
+void BTreeIndex::clearCounters() {
+  for (std::atomic<std::uint64_t> &counter : counters) counter = 0;
+}
+
+IndexAnalysis BTreeIndex::analyze() {
+  flushInsertBuffer();
+  IndexAnalysis analysis{};
+  switch (keyType) {
+    case INTEGER_KEY:
+      analyzeTree<int>(analysis);
+      break;
+    case DOUBLE_KEY:
+      analyzeTree<double>(analysis);
+      break;
+    case STRING_KEY:
+      analyzeTree<StringKey>(analysis);
+      break;
+    case INTEGER_INTEGER_KEY:
+      analyzeTree<IntIntKey>(analysis);
+      break;
+    case INTEGER_DOUBLE_KEY:
+      analyzeTree<IntDoubleKey>(analysis);
+      break;
+    case INTEGER_STRING_KEY:
+      analyzeTree<IntStringKey>(analysis);
+      break;
+  }
+  return analysis;
+}
+
+/**
+ * Walk the internal nodes a level at a time, in key order, then the leaves
+ * along their chain. The capacity of the leaves is found as collectStats()
+ * finds it.
+ *
+ * @param analysis the analysis filled in
+ */
+template <class T>
+void BTreeIndex::analyzeTree(IndexAnalysis &analysis) {
+  std::vector<PageId> level(1, loadRootPageNo());
+  while (true) {
+    if (isLeaf(pinHandle(level[0]).get())) break;
+
+    LevelStats stats{};
+    std::vector<PageId> children;
+    for (PageId pageNo : level) {
+      PageHandle page = pinHandle(pageNo);
+      NonLeafNode<T> *node = page.as<NonLeafNode<T>>();
+      const int len = getNonLeafLen(node);
+      stats.numNodes++;
+      stats.numEntries += len;
+      children.insert(children.end(), node->pageNoArray,
+                      node->pageNoArray + len + 1);
+    }
+    stats.fillFactor = (double)stats.numEntries /
+                       (stats.numNodes * KeyTraits<T>::NONLEAFSIZE);
+    analysis.levels.push_back(stats);
+    level.swap(children);
+  }
+
+  LevelStats stats{};
+  double capacity = 0;
+  PageId pageNo = level[0];
+  while (true) {
+    PageHandle page = pinHandle(pageNo);
+    LeafNode<T> *leaf = page.as<LeafNode<T>>();
+    const int len = getLeafLen(leaf);
+    stats.numNodes++;
+    stats.numEntries += len;
+    capacity += len == 0 ? maxLeafCapacity<T>()
+                         : getLeafCapacity(leaf, getLeafKey(leaf, 0));
+    const PageId nextPageNo = leaf->rightSibPageNo;
+    page.release();
+    if (nextPageNo == 0) break;
+    if (nextPageNo < pageNo) analysis.outOfOrderLinks++;
+    pageNo = nextPageNo;
+  }
+  stats.fillFactor = capacity == 0 ? 0 : stats.numEntries / capacity;
+  analysis.levels.push_back(stats);
+  analysis.height = analysis.levels.size();
+  analysis.fragmentation =
+      stats.numNodes == 1
+          ? 0
+          : (double)analysis.outOfOrderLinks / (stats.numNodes - 1);
 }
 
 // ##################################################################### //
@@ -765,16 +5622,25 @@ const void BTreeIndex::endScan() {
  * Perform any cleanup that may be necessary, including
  *      clearing up any state variables,
  *      unpinning any B+ Tree pages that are pinned, and
- *      flushing the index file (by calling bufMgr->flushFile()).
+ *      flushing the index file (by calling bufMgr->flushFile()) and syncing
+ *      it to disk.
  *
  * Note that this method does not delete the index file! But, deletion of the
  * file object is required, which will call the destructor of File class causing
  * the index file to be closed.
  */
 BTreeIndex::~BTreeIndex() {
-  if (scanExecuting) endScan();
+  if (scanCursor.isExecuting()) scanCursor.endScan();
+  flushInsertBuffer();
+  unpinNodes();
   bufMgr->flushFile(file);
+  file->sync();
+  if (bufMgr->getLog() != NULL) bufMgr->getLog()->removeFile(file);
   delete file;
+  if (relationFile != NULL) {
+    bufMgr->flushFile(relationFile);
+    delete relationFile;
+  }
 }
 
 }  // namespace badgerdb
\ No newline at end of file
@@ -8,11 +8,23 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "string.h"
 
+#include "arena.h"
 #include "buffer.h"
 #include "file.h"
 #include "page.h"
@@ -21,462 +33,2967 @@
 namespace badgerdb {
 
 /**
- * @brief Datatype enumeration type.
+ * @brief Index construction methods. Passed to the BTreeIndex constructor.
  */
-enum Datatype { INTEGER = 0, DOUBLE = 1, STRING = 2 };
+enum BuildMethod {
+  INSERT_BUILD, /* Insert every tuple of the relation through insertEntry() */
+  BULK_BUILD    /* Sort all (key, rid) pairs and pack the nodes bottom-up */
+};
+
+/**
+ * @brief Records an index is bulk built from in place of a scan of its
+ * relation: called once with a function that is to be called with the id and
+ * the bytes of every record.  Only the key and covered columns of the bytes
+ * are read.
+ */
+typedef std::function<void(
+    const std::function<void(const RecordId &, const char *)> &)>
+    RecordFeed;
 
 /**
- * @brief Scan operations enumeration. Passed to BTreeIndex::startScan() method.
+ * @brief Order in which a scan returns the entries of its range.
  */
-enum Operator {
-  LT,  /* Less Than */
-  LTE, /* Less Than or Equal to */
-  GTE, /* Greater Than or Equal to */
-  GT   /* Greater Than */
+enum ScanOrder {
+  ASCENDING, /* From the low end of the range up, through right siblings */
+  DESCENDING /* From the high end of the range down, through left siblings */
 };
 
 /**
  * @brief Number of key slots in B+Tree leaf for INTEGER key.
  */
-//                                                  sibling ptr             key
-//                                                  rid
+//                                          level, numKeys, version
+//                                          sibling ptrs
+//                                          key              rid
 const int INTARRAYLEAFSIZE =
-    (Page::SIZE - sizeof(PageId)) / (sizeof(int) + sizeof(RecordId));
+    (Page::BLOB_SIZE - 3 * sizeof(int) - 2 * sizeof(PageId)) /
+    (sizeof(int) + sizeof(RecordId));
 
 /**
- * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ * @brief Number of INTEGER keys in a block of a B+Tree non-leaf, one cache
+ * line.
  */
-//                                                     level     extra pageNo
-//                                                     key       pageNo
-const int INTARRAYNONLEAFSIZE = (Page::SIZE - sizeof(int) - sizeof(PageId)) /
-                                (sizeof(int) + sizeof(PageId));
+const int INTKEYBLOCKSIZE = 16;
 
 /**
- * @brief The meta page, which holds metadata for Index file, is always first
- * page of the btree index file and is cast to the following structure to store
- * or retrieve information from it. Contains the relation name for which the
- * index is created, the byte offset of the key value on which the index is
- * made, the type of the key and the page no of the root page. Root page starts
- * as page 2 but since a split can occur at the root the root page may get moved
- * up and get a new page no.
+ * @brief Number of key slots in B+Tree non-leaf for INTEGER key, a whole
+ * number of blocks. Each array of the node starts on a cache line, see
+ * NonLeafNode<int>.
  */
-struct IndexMetaInfo {
-  /**
-   * Name of base relation.
-   */
-  char relationName[20];
+//                            header, extra pageNo, padding of the directory,
+//                            checksum: a cache line each
+//                            key, pageNo and a directory key per block
+const int INTARRAYNONLEAFSIZE =
+    (Page::SIZE - 5 * INTKEYBLOCKSIZE * sizeof(int)) * INTKEYBLOCKSIZE /
+    (INTKEYBLOCKSIZE * (sizeof(int) + sizeof(PageId)) + sizeof(int)) /
+    INTKEYBLOCKSIZE * INTKEYBLOCKSIZE;
+
+/**
+ * @brief Number of blocks of keys of a B+Tree non-leaf for INTEGER key, each
+ * with an entry in the first level of its directory.
+ */
+const int INTNONLEAFBLOCKS = INTARRAYNONLEAFSIZE / INTKEYBLOCKSIZE;
+
+/**
+ * @brief Number of entries in the second level of the directory of a B+Tree
+ * non-leaf for INTEGER key, one per cache line of the first level.
+ */
+const int INTNONLEAFLINES =
+    (INTNONLEAFBLOCKS + INTKEYBLOCKSIZE - 1) / INTKEYBLOCKSIZE;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+ */
+//                                             level, numKeys, version
+//                                             sibling ptrs
+//                                             key              rid
+const int DOUBLEARRAYLEAFSIZE =
+    (Page::BLOB_SIZE - 3 * sizeof(int) - 2 * sizeof(PageId)) /
+    (sizeof(double) + sizeof(RecordId));
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
+ */
+//                                             level, numKeys, version,
+//                                             padding aligning the keys
+//                                             extra pageNo
+//                                             key              pageNo
+const int DOUBLEARRAYNONLEAFSIZE =
+    (Page::BLOB_SIZE - 4 * sizeof(int) - sizeof(PageId)) /
+    (sizeof(double) + sizeof(PageId));
+
+/**
+ * @brief Number of characters of a STRING attribute the index is built on.
+ * Longer strings are indexed by their first STRINGSIZE characters.
+ */
+const int STRINGSIZE = 10;
+
+/**
+ * @brief Number of bytes of a B+Tree leaf for STRING key holding its entries.
+ */
+//                                                level, numKeys, version
+//                                                prefixLen
+//                                                sibling ptrs    prefix
+const int STRINGLEAFDATASIZE = Page::BLOB_SIZE - 4 * sizeof(int) -
+                               2 * sizeof(PageId) - STRINGSIZE;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for STRING key whose keys share no
+ * prefix.
+ */
+const int STRINGARRAYLEAFSIZE =
+    STRINGLEAFDATASIZE / (STRINGSIZE + sizeof(RecordId));
+
+/**
+ * @brief Maximum number of key slots in B+Tree leaf for STRING key. A leaf
+ * stores the prefix shared by its keys once, so it holds more than
+ * STRINGARRAYLEAFSIZE entries when its keys share a prefix. The bound makes
+ * sure that either half of a split leaf, with the new entry, fits in a leaf
+ * whose keys share no prefix.
+ */
+const int STRINGARRAYLEAFMAXSIZE = 2 * STRINGARRAYLEAFSIZE - 3;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for STRING key.
+ */
+//                                             level, numKeys, version
+//                                             extra pageNo
+//                                             key              pageNo
+const int STRINGARRAYNONLEAFSIZE =
+    (Page::BLOB_SIZE - 3 * sizeof(int) - sizeof(PageId)) /
+    (STRINGSIZE + sizeof(PageId));
+
+/**
+ * @brief Key of a STRING index: the first STRINGSIZE characters of the
+ * attribute, padded with NUL characters. Keys compare byte by byte.
+ */
+struct StringKey {
+  char data[STRINGSIZE];
+};
+
+inline bool operator<(const StringKey &k1, const StringKey &k2) {
+  return memcmp(k1.data, k2.data, STRINGSIZE) < 0;
+}
+
+inline bool operator>(const StringKey &k1, const StringKey &k2) {
+  return k2 < k1;
+}
+
+inline bool operator==(const StringKey &k1, const StringKey &k2) {
+  return memcmp(k1.data, k2.data, STRINGSIZE) == 0;
+}
+
+inline bool operator!=(const StringKey &k1, const StringKey &k2) {
+  return !(k1 == k2);
+}
+
+/**
+ * @brief Number of attributes a composite key is built from.
+ */
+const int MAXKEYCOLUMNS = 2;
+
+/**
+ * @brief Key of an index on two attributes, holding the value of each. Keys
+ * compare lexicographically: by their first value, then by their second. The
+ * comparison is instantiated for each pair of key types, so it compiles down
+ * to the comparisons of the two values.
+ */
+template <class A, class B>
+struct CompositeKey {
+  A first;
+  B second;
+};
+
+template <class A, class B>
+inline bool operator<(const CompositeKey<A, B> &k1,
+                      const CompositeKey<A, B> &k2) {
+  if (k1.first != k2.first) return k1.first < k2.first;
+  return k1.second < k2.second;
+}
+
+template <class A, class B>
+inline bool operator>(const CompositeKey<A, B> &k1,
+                      const CompositeKey<A, B> &k2) {
+  return k2 < k1;
+}
+
+template <class A, class B>
+inline bool operator==(const CompositeKey<A, B> &k1,
+                       const CompositeKey<A, B> &k2) {
+  return k1.first == k2.first && k1.second == k2.second;
+}
+
+template <class A, class B>
+inline bool operator!=(const CompositeKey<A, B> &k1,
+                       const CompositeKey<A, B> &k2) {
+  return !(k1 == k2);
+}
+
+/**
+ * @brief The composite keys an index may be built on: an INTEGER attribute,
+ * such as the id of a seller or an item, followed by an attribute of any type.
+ */
+typedef CompositeKey<int, int> IntIntKey;
+typedef CompositeKey<int, double> IntDoubleKey;
+typedef CompositeKey<int, StringKey> IntStringKey;
+
+/**
+ * @brief Number of bytes of the largest keys, which are composite ones.
+ */
+const std::size_t MAXKEYSIZE = sizeof(IntDoubleKey) > sizeof(IntStringKey)
+                                   ? sizeof(IntDoubleKey)
+                                   : sizeof(IntStringKey);
+
+/**
+ * @brief Type of the keys of an index, which picks the instantiation of the
+ * index code that is run: that of a single attribute, or that of a pair of
+ * attributes.
+ */
+enum KeyType {
+  INTEGER_KEY,
+  DOUBLE_KEY,
+  STRING_KEY,
+  INTEGER_INTEGER_KEY,
+  INTEGER_DOUBLE_KEY,
+  INTEGER_STRING_KEY
+};
+
+/**
+ * @brief Number of bytes of a posting list page holding record ids.
+ */
+//                                               level, numRids, version
+//                                               numBytes, totalRids
+//                                               prev, next, last page
+//                                               last rid
+const int POSTINGDATASIZE = Page::BLOB_SIZE - 5 * sizeof(int) -
+                            3 * sizeof(PageId) - sizeof(RecordId);
+
+/**
+ * @brief Slot number of the record id of a leaf entry that stands for a
+ * posting list, whose page number is that of the first page of the list.
+ * Records are never given this slot, since it is far more than fit in a page.
+ */
+const SlotId POSTINGLISTSLOT = 0xFFFF;
+
+/**
+ * @brief Number of columns an index may store alongside its keys.
+ */
+const int MAXCOVEREDCOLUMNS = 8;
+
+/**
+ * @brief Number of bytes of the covered columns of one leaf entry.
+ */
+const int MAXCOVEREDSIZE = 64;
+
+/**
+ * @brief Number of keys left to the SIMD comparison loop by the binary search
+ * of searchIntArray().
+ */
+const int INTSEARCHBLOCKSIZE = 32;
+
+/**
+ * @brief Search a sorted array of INTEGER keys. The range is narrowed by
+ * binary search to INTSEARCHBLOCKSIZE keys, which are then compared with the
+ * key a vector at a time (AVX2 if the processor has it, chosen at run time,
+ * else SSE2, else one key at a time).
+ *
+ * @param arr a sorted key array
+ * @param len the length of the array
+ * @param key the target key
+ * @param includeKey whether keys equal to the target key are included
+ * @return the index of the first key larger than (or equal to, if includeKey)
+ *         the given key, or len if there is none
+ */
+int searchIntArray(const int *arr, int len, int key, bool includeKey);
+
+/**
+ * @brief Fill the directory of a sorted array of INTEGER keys split into
+ * blocks of INTKEYBLOCKSIZE keys: the first key of every block, and the first
+ * of those of every INTKEYBLOCKSIZE blocks.
+ *
+ * @param arr a sorted key array
+ * @param len the length of the array
+ * @param blockKeys set to the first key of each block
+ * @param lineKeys set to every INTKEYBLOCKSIZE-th entry of blockKeys
+ */
+void indexIntKeys(const int *arr, int len, int *blockKeys, int *lineKeys);
+
+/**
+ * @brief Search a sorted array of INTEGER keys through its directory, filled
+ * by indexIntKeys(): one cache line of lineKeys picks a line of blockKeys,
+ * which picks the block of keys holding the result. The directory lines and
+ * the page numbers of the block are prefetched, so that a search waits for
+ * about three cache misses. A directory that does not match the keys gives
+ * the result of searchIntArray(), only more slowly.
+ *
+ * @param arr a sorted key array
+ * @param len the length of the array
+ * @param blockKeys the first level of the directory
+ * @param lineKeys the second level of the directory
+ * @param pageNos page numbers following the keys, or NULL
+ * @param key the target key
+ * @param includeKey whether keys equal to the target key are included
+ * @return the index of the first key larger than (or equal to, if includeKey)
+ *         the given key, or len if there is none
+ */
+int searchIntDirectory(const int *arr, int len, const int *blockKeys,
+                       const int *lineKeys, const PageId *pageNos, int key,
+                       bool includeKey);
+
+/**
+ * @brief Default fraction of each node filled when the index is bulk loaded.
+ */
+const double DEFAULT_FILL_FACTOR = 1.0;
+
+/**
+ * @brief Number of (key, rid) pairs sorted in memory during a bulk load before
+ * the sorted run is spilled to a temporary file.
+ */
+const int BULKLOAD_RUN_SIZE = 1 << 18;
+
+/**
+ * @brief Maximum number of spilled runs merged at once during a bulk load.
+ * Each run being merged keeps one page pinned in the buffer pool.
+ */
+const int BULKLOAD_MERGE_FANIN = 16;
+
+/**
+ * @brief Number of levels at the top of a B+Tree, that of the root included,
+ * whose internal nodes an index keeps pinned in the buffer pool once read.
+ */
+const int PINNED_LEVELS = 2;
+
+/**
+ * @brief An index keeps at most one frame in this many of its buffer pool
+ * pinned for its upper levels.
+ */
+const int PINNED_FRAME_SHARE = 8;
+
+/**
+ * @brief Number of posting list buffers of ended scans an index keeps for
+ * the scans opened next.
+ */
+const int SPARE_POSTING_BUFFERS = 16;
+
+/**
+ * @brief Bits of the Bloom filter of a leaf summary per key of the leaf, and
+ * number of bits a key sets, all in one word of the filter; about 3% of the
+ * keys missing from a leaf pass its filter.
+ */
+const int LEAF_FILTER_BITS_PER_KEY = 8;
+const int LEAF_FILTER_PROBES = 5;
+
+/**
+ * @brief Number of pending inserts applied to the leaves at once by an index
+ * that buffers its inserts, unless given otherwise.
+ */
+const std::size_t INSERT_BUFFER_ENTRIES = 1 << 16;
+
+/**
+ * @brief Structure to store a key and the record id of the record it belongs
+ * to. Pairs are ordered by key, then by record id.
+ */
+template <class T>
+class RIDKeyPair {
+ public:
+  RecordId rid;
+  T key;
+  void set(RecordId r, T k) {
+    rid = r;
+    key = k;
+  }
+};
+
+/**
+ * @brief Structure to store a key and the page number of the node whose
+ * smallest key it is.
+ */
+template <class T>
+class PageKeyPair {
+ public:
+  PageId pageNo;
+  T key;
+  void set(PageId p, T k) {
+    pageNo = p;
+    key = k;
+  }
+};
+
+/**
+ * Overloaded operator to compare the key values of two rid-key pairs and if
+ * they are the same compare to see if the first pair has a smaller rid.
+ */
+template <class T>
+bool operator<(const RIDKeyPair<T> &r1, const RIDKeyPair<T> &r2) {
+  if (r1.key != r2.key) return r1.key < r2.key;
+  if (r1.rid.page_number != r2.rid.page_number)
+    return r1.rid.page_number < r2.rid.page_number;
+  return r1.rid.slot_number < r2.rid.slot_number;
+}
+
+/**
+ * @brief Number of rid-key pairs stored in one page of a spilled sort run.
+ */
+const int INTRUNPAGESIZE = Page::BLOB_SIZE / sizeof(RIDKeyPair<int>);
+const int DOUBLERUNPAGESIZE = Page::BLOB_SIZE / sizeof(RIDKeyPair<double>);
+const int STRINGRUNPAGESIZE = Page::BLOB_SIZE / sizeof(RIDKeyPair<StringKey>);
+
+/**
+ * @brief Layout constants of the nodes for each key type, and the conversion
+ * of an attribute value to a key. A node holding fewer than MINLEAFSIZE or
+ * MINNONLEAFSIZE keys after a deletion is merged with or refilled from a
+ * sibling. The bounds are a quarter of the capacity, rather than half, so that
+ * a node does not bounce between splits and merges as entries come and go.
+ * A key with MINPOSTINGSIZE entries in a leaf, half of what the leaf holds,
+ * has them moved to a posting list rather than the leaf being split.
+ * A key is passed to the index as its VALUESIZE bytes of attribute values,
+ * one after another, and read from a record at the offsets of its columns;
+ * fromPointer() reads a key from that form, which need not be aligned, and
+ * toPointer() writes a key back in it.
+ * minKey() and maxKey() bound every key, and
+ * prefixRange() gives the range of the keys whose leading columns hold the
+ * given values. hash() mixes a key into 64 bits, the same for equal keys.
+ */
+template <class T>
+struct KeyTraits;
+
+/**
+ * Finalizer of MurmurHash3, spreading the bits of a value over all 64 bits.
+ */
+inline std::uint64_t mixKeyHash(std::uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdULL;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ULL;
+  return value ^ (value >> 33);
+}
+
+template <>
+struct KeyTraits<int> {
+  static const int LEAFSIZE = INTARRAYLEAFSIZE;
+  static const int NONLEAFSIZE = INTARRAYNONLEAFSIZE;
+  static const int MINLEAFSIZE = INTARRAYLEAFSIZE / 4;
+  static const int MINNONLEAFSIZE = INTARRAYNONLEAFSIZE / 4;
+  static const int MINPOSTINGSIZE = INTARRAYLEAFSIZE / 2;
+  static const int RUNPAGESIZE = INTRUNPAGESIZE;
+  static const int VALUESIZE = sizeof(int);
+  static int fromPointer(const void *value) {
+    int key;
+    memcpy(&key, value, sizeof(int));
+    return key;
+  }
+  static void toPointer(const int &key, void *value) {
+    memcpy(value, &key, sizeof(int));
+  }
+  static int fromRecord(const char *record, const KeyColumn *columns) {
+    return fromPointer(record + columns[0].byteOffset);
+  }
+  static int minKey() { return std::numeric_limits<int>::min(); }
+  static int maxKey() { return std::numeric_limits<int>::max(); }
+  static void prefixRange(const void *value, int, int &low, int &high) {
+    low = high = fromPointer(value);
+  }
+  static std::uint64_t hash(const int &key) {
+    return mixKeyHash((std::uint32_t)key);
+  }
+};
+
+template <>
+struct KeyTraits<double> {
+  static const int LEAFSIZE = DOUBLEARRAYLEAFSIZE;
+  static const int NONLEAFSIZE = DOUBLEARRAYNONLEAFSIZE;
+  static const int MINLEAFSIZE = DOUBLEARRAYLEAFSIZE / 4;
+  static const int MINNONLEAFSIZE = DOUBLEARRAYNONLEAFSIZE / 4;
+  static const int MINPOSTINGSIZE = DOUBLEARRAYLEAFSIZE / 2;
+  static const int RUNPAGESIZE = DOUBLERUNPAGESIZE;
+  static const int VALUESIZE = sizeof(double);
+  static double fromPointer(const void *value) {
+    double key;
+    memcpy(&key, value, sizeof(double));
+    return key;
+  }
+  static void toPointer(const double &key, void *value) {
+    memcpy(value, &key, sizeof(double));
+  }
+  static double fromRecord(const char *record, const KeyColumn *columns) {
+    return fromPointer(record + columns[0].byteOffset);
+  }
+  static double minKey() { return -std::numeric_limits<double>::infinity(); }
+  static double maxKey() { return std::numeric_limits<double>::infinity(); }
+  static void prefixRange(const void *value, int, double &low, double &high) {
+    low = high = fromPointer(value);
+  }
+  static std::uint64_t hash(const double &key) {
+    // -0.0 equals 0.0
+    const double value = key == 0 ? 0.0 : key;
+    std::uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return mixKeyHash(bits);
+  }
+};
+
+template <>
+struct KeyTraits<StringKey> {
+  static const int LEAFSIZE = STRINGARRAYLEAFMAXSIZE;
+  static const int NONLEAFSIZE = STRINGARRAYNONLEAFSIZE;
+  // bounded by the leaves whose keys share no prefix
+  static const int MINLEAFSIZE = STRINGARRAYLEAFSIZE / 4;
+  static const int MINNONLEAFSIZE = STRINGARRAYNONLEAFSIZE / 4;
+  static const int MINPOSTINGSIZE = STRINGARRAYLEAFMAXSIZE / 2;
+  static const int RUNPAGESIZE = STRINGRUNPAGESIZE;
+  static const int VALUESIZE = STRINGSIZE;
+  static StringKey fromPointer(const void *value) {
+    // zero padded, as strncpy would
+    StringKey key;
+    const char *chars = (const char *)value;
+    const std::size_t length = strnlen(chars, STRINGSIZE);
+    memcpy(key.data, chars, length);
+    memset(key.data + length, 0, STRINGSIZE - length);
+    return key;
+  }
+  static void toPointer(const StringKey &key, void *value) {
+    memcpy(value, key.data, STRINGSIZE);
+  }
+  static StringKey fromRecord(const char *record, const KeyColumn *columns) {
+    return fromPointer(record + columns[0].byteOffset);
+  }
+  static StringKey minKey() { return StringKey{}; }
+  static StringKey maxKey() {
+    StringKey key;
+    memset(key.data, 0xFF, STRINGSIZE);
+    return key;
+  }
+  static void prefixRange(const void *value, int, StringKey &low,
+                          StringKey &high) {
+    low = high = fromPointer(value);
+  }
+  static std::uint64_t hash(const StringKey &key) {
+    std::uint64_t value = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < STRINGSIZE; i++)
+      value = (value ^ (unsigned char)key.data[i]) * 0x100000001b3ULL;
+    return mixKeyHash(value);
+  }
+};
+
+/**
+ * Composite keys take their layout from the size of the pair, and their
+ * values and bounds from the traits of each attribute.
+ */
+template <class A, class B>
+struct KeyTraits<CompositeKey<A, B>> {
+  typedef CompositeKey<A, B> Key;
+
+  // the fields before the keys are padded, and the node as a whole, to the
+  // alignment of the keys
+  static const std::size_t ALIGNMENT = alignof(Key);
+  static const std::size_t NODESIZE = Page::BLOB_SIZE / ALIGNMENT * ALIGNMENT;
+
+  //                                    level, numKeys, version
+  //                                    sibling ptrs
+  //                                    key              rid
+  static const int LEAFSIZE =
+      (NODESIZE - (3 * sizeof(int) + 2 * sizeof(PageId) + ALIGNMENT - 1) /
+                      ALIGNMENT * ALIGNMENT) /
+      (sizeof(Key) + sizeof(RecordId));
+  //                                    level, numKeys, version
+  //                                    extra pageNo
+  //                                    key              pageNo
+  static const int NONLEAFSIZE =
+      (NODESIZE - (3 * sizeof(int) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT -
+       sizeof(PageId)) /
+      (sizeof(Key) + sizeof(PageId));
+  static const int MINLEAFSIZE = LEAFSIZE / 4;
+  static const int MINNONLEAFSIZE = NONLEAFSIZE / 4;
+  static const int MINPOSTINGSIZE = LEAFSIZE / 2;
+  static const int RUNPAGESIZE = Page::BLOB_SIZE / sizeof(RIDKeyPair<Key>);
+  static const int VALUESIZE =
+      KeyTraits<A>::VALUESIZE + KeyTraits<B>::VALUESIZE;
+
+  static Key fromPointer(const void *value) {
+    Key key{};
+    key.first = KeyTraits<A>::fromPointer(value);
+    key.second = KeyTraits<B>::fromPointer((const char *)value +
+                                           KeyTraits<A>::VALUESIZE);
+    return key;
+  }
+  static void toPointer(const Key &key, void *value) {
+    KeyTraits<A>::toPointer(key.first, value);
+    KeyTraits<B>::toPointer(key.second,
+                            (char *)value + KeyTraits<A>::VALUESIZE);
+  }
+  static Key fromRecord(const char *record, const KeyColumn *columns) {
+    Key key{};
+    key.first = KeyTraits<A>::fromPointer(record + columns[0].byteOffset);
+    key.second = KeyTraits<B>::fromPointer(record + columns[1].byteOffset);
+    return key;
+  }
+  static Key minKey() {
+    Key key{};
+    key.first = KeyTraits<A>::minKey();
+    key.second = KeyTraits<B>::minKey();
+    return key;
+  }
+  static Key maxKey() {
+    Key key{};
+    key.first = KeyTraits<A>::maxKey();
+    key.second = KeyTraits<B>::maxKey();
+    return key;
+  }
 
   /**
-   * Offset of attribute, over which index is built, inside the record stored in
-   * pages.
+   * The keys whose first value is given range over all second values, unless
+   * both values are given.
    */
-  int attrByteOffset;
+  static void prefixRange(const void *value, int numColumns, Key &low,
+                          Key &high) {
+    if (numColumns == 2) {
+      low = high = fromPointer(value);
+      return;
+    }
+    low = high = Key{};
+    low.first = high.first = KeyTraits<A>::fromPointer(value);
+    low.second = KeyTraits<B>::minKey();
+    high.second = KeyTraits<B>::maxKey();
+  }
+  static std::uint64_t hash(const Key &key) {
+    return mixKeyHash(KeyTraits<A>::hash(key.first) ^
+                      KeyTraits<B>::hash(key.second) * 0x9e3779b97f4a7c15ULL);
+  }
+};
 
+/**
+ * @brief A sorted run of rid-key pairs spilled to the temporary sort file
+ * during a bulk load. The pages of a run are contiguous in the file.
+ */
+struct SortRun {
   /**
-   * Type of the attribute over which index is built.
+   * Page number of the first page of the run.
    */
-  Datatype attrType;
+  PageId firstPageNo;
 
   /**
-   * Page number of root page of the B+ Tree inside the file index file.
+   * Number of pairs in the run.
    */
-  PageId rootPageNo;
+  std::size_t length;
 };
 
-/*
-Each node is a page, so once we read the page in we just cast the pointer to the
-page to this struct and use it to access the parts These structures basically
-are the format in which the information is stored in the pages for the index
-file depending on what kind of node they are. The level memeber of each non leaf
-structure seen below is set to 1 if the nodes at this level are just above the
-leaf nodes. Otherwise set to 0.
-*/
-
 /**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+ * @brief A fixed-width column of the records that an index stores in its leaf
+ * entries next to the key, so that queries reading only the key and such
+ * columns are answered from the leaves without fetching the records.
  */
-struct NonLeafNodeInt {
+struct CoveredColumn {
   /**
-   * Level of the node in the tree.
-   */
-  int level = 0;
-
-  /**
-   * Stores keys.
+   * Offset of the column inside the record.
    */
-  int keyArray[INTARRAYNONLEAFSIZE]{};
+  int byteOffset;
 
   /**
-   * Stores page numbers of child pages which themselves are other non-leaf/leaf
-   * nodes in the tree.
+   * Length of the column in bytes.
    */
-  PageId pageNoArray[INTARRAYNONLEAFSIZE + 1]{};
+  int length;
 };
 
 /**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
+ * @brief Statistics of the shape and the contents of an index, from which the
+ * cost of a scan of a range of it may be estimated.
  */
+struct IndexStats {
+  /**
+   * Number of levels of the tree, that of the leaves included.
+   */
+  int height;
 
-struct LeafNodeInt {
-  int level = -1;
+  /**
+   * Number of leaves.
+   */
+  std::size_t numLeaves;
 
   /**
-   * Stores keys.
+   * Number of record ids, those of posting lists included.
    */
-  int keyArray[INTARRAYLEAFSIZE]{};
+  std::size_t numEntries;
 
   /**
-   * Stores RecordIds.
+   * Number of different keys.
    */
-  RecordId ridArray[INTARRAYLEAFSIZE]{};
+  std::size_t distinctKeys;
 
   /**
-   * Page number of the leaf on the right side.
-   * This linking of leaves allows to easily move from one leaf to the next leaf
-   * during index scan.
+   * Entries of the leaves over the most entries they could hold.
    */
-  PageId rightSibPageNo = 0;
+  double fillFactor;
 };
 
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute
- * of a relation. This index supports only one scan at a time.
+ * @brief Counts of the operations of an index since it was opened or its
+ * counters were cleared.
  */
-class BTreeIndex {
- private:
+struct IndexCounters {
   /**
-   * File object for the index file.
+   * Number of entries inserted, one at a time, in batches or by an
+   * INSERT_BUILD.
    */
-  File *file{};
+  std::uint64_t inserts;
 
   /**
-   * Buffer Manager Instance.
+   * Number of entries deleted.
    */
-  BufMgr *bufMgr{};
+  std::uint64_t deletes;
 
   /**
-   * Datatype of attribute over which index is built.
+   * Number of keys looked up, one at a time or in batches.
    */
-  Datatype attributeType;
+  std::uint64_t lookups;
 
   /**
-   * Offset of attribute, over which index is built, inside records.
+   * Number of leaves and of internal nodes split in two, and of splits that
+   * gave the tree a new root.
    */
-  int attrByteOffset{};
+  std::uint64_t leafSplits;
+  std::uint64_t nonLeafSplits;
+  std::uint64_t rootSplits;
 
-  // MEMBERS SPECIFIC TO SCANNING
+  /**
+   * Number of scans started.
+   */
+  std::uint64_t scansStarted;
 
   /**
-   * True if an index scan has been started.
+   * Number of record ids returned by scans and lookups.
    */
-  bool scanExecuting{};
+  std::uint64_t entriesReturned;
 
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
+   * Number of pages of the index pinned in the buffer manager. Nodes the
+   * index keeps pinned are not pinned again by each descent.
    */
-  int nextEntry{};
+  std::uint64_t pagesPinned;
 
   /**
-   * Page number of current page being scanned.
+   * Number of lookups and scans that ended at an internal node kept pinned,
+   * since the summary of the leaf they led to showed that no key sought is
+   * in it or after it.
    */
-  PageId currentPageNum{};
+  std::uint64_t leavesSkipped;
 
   /**
-   * Current Page being scanned.
+   * Number of times an index that buffers its inserts applied the pending
+   * ones to its leaves.
    */
-  Page *currentPageData{};
+  std::uint64_t bufferFlushes;
 
   /**
-   * Low INTEGER value for scan.
+   * Number of pages copied before a change, for the snapshot scans open.
    */
-  int lowValInt{};
+  std::uint64_t pagesSaved;
 
   /**
-   * High INTEGER value for scan.
+   * Pages pinned per insertion, deletion, lookup or scan started.
    */
-  int highValInt{};
+  double pagesPerOperation() const {
+    const std::uint64_t operations = inserts + deletes + lookups + scansStarted;
+    return operations == 0 ? 0 : (double)pagesPinned / operations;
+  }
+};
 
+/**
+ * @brief The nodes of one level of an index.
+ */
+struct LevelStats {
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * Number of nodes of the level.
    */
-  Operator lowOp{GT};
+  std::size_t numNodes;
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * Number of keys of the nodes of the level; entries for the leaves.
    */
-  Operator highOp{LT};
+  std::size_t numEntries;
 
-  struct IndexMetaInfo indexMetaInfo {};
+  /**
+   * Keys or entries of the nodes over the most they could hold.
+   */
+  double fillFactor;
+};
 
+/**
+ * @brief The shape of an index, from which to tell whether it is worth
+ * rebuilding.
+ */
+struct IndexAnalysis {
   /**
-   * Alloc a page in the buffer for a leaf node
-   *
-   * @param newPageId the page number for the new node
-   * @return a pointer to the new leaf node
+   * Number of levels of the tree, that of the leaves included.
    */
-  LeafNodeInt *allocLeafNode(PageId &newPageId);
+  int height;
 
   /**
-   * Alloca a page in the buffer for an internal node
-   *
-   * @param newPageId the page number for the new node
-   * @return a pointer to the new internal node
+   * The levels of the tree, that of the root first and that of the leaves
+   * last.
+   */
+  std::vector<LevelStats> levels;
+
+  /**
+   * Number of leaves whose right sibling lies before them in the index file,
+   * so that a scan goes back on disk to reach it.
+   */
+  std::size_t outOfOrderLinks;
+
+  /**
+   * Out of order links over the links between leaves, 0 for a single leaf.
+   */
+  double fragmentation;
+};
+
+/**
+ * @brief The meta page, which holds metadata for Index file, is always first
+ * page of the btree index file and is cast to the following structure to store
+ * or retrieve information from it. Contains the relation name for which the
+ * index is created, the byte offset of the key value on which the index is
+ * made, the type of the key and the page no of the root page. Root page starts
+ * as page 2 but since a split can occur at the root the root page may get moved
+ * up and get a new page no.
+ */
+struct IndexMetaInfo {
+  /**
+   * Name of base relation.
+   */
+  char relationName[20];
+
+  /**
+   * Offset of attribute, over which index is built, inside the record stored in
+   * pages.
+   */
+  int attrByteOffset;
+
+  /**
+   * Type of the attribute over which index is built.
+   */
+  Datatype attrType;
+
+  /**
+   * Page number of root page of the B+ Tree inside the file index file.
+   */
+  PageId rootPageNo;
+
+  /**
+   * Page number of the first node page freed by a merge, or 0 if there is
+   * none. Freed pages are chained through FreeNode::nextFreePageNo.
+   */
+  PageId freePageNo;
+
+  /**
+   * True once a posting list has been created in the index file, which a
+   * concurrent index can then not be opened on.
+   */
+  bool hasPostingLists;
+
+  /**
+   * Number of columns stored in the leaf entries, and the columns.
+   */
+  int numCoveredColumns;
+  CoveredColumn coveredColumns[MAXCOVEREDCOLUMNS];
+
+  /**
+   * Number of attributes the keys are built from, and the attributes. The
+   * first one is also given by attrByteOffset and attrType.
+   */
+  int numKeyColumns;
+  KeyColumn keyColumns[MAXKEYCOLUMNS];
+};
+
+/*
+Each node is a page, so once we read the page in we just cast the pointer to the
+page to this struct and use it to access the parts These structures basically
+are the format in which the information is stored in the pages for the index
+file depending on what kind of node they are. The level memeber of each non leaf
+structure seen below is set to 1 if the nodes at this level are just above the
+leaf nodes. Otherwise set to 0.
+
+Every node starts with its level, its number of keys and a version word. The
+version is only used by a concurrent index: a writer takes a node by making its
+version odd and releases it by making it even again, and a reader checks that
+the version of a node is unchanged after reading it.
+*/
+
+/**
+ * @brief Structure for all non-leaf nodes with keys of type T.
+ */
+template <class T>
+struct NonLeafNode {
+  /**
+   * Level of the node in the tree.
+   */
+  int level = 0;
+
+  /**
+   * Number of keys stored in the node, one less than its number of children.
+   */
+  int numKeys = 0;
+
+  /**
+   * Version of the node, odd while a writer holds it.
+   */
+  std::atomic<std::uint32_t> version{0};
+
+  /**
+   * Stores keys.
+   */
+  T keyArray[KeyTraits<T>::NONLEAFSIZE]{};
+
+  /**
+   * Stores page numbers of child pages which themselves are other non-leaf/leaf
+   * nodes in the tree.
+   */
+  PageId pageNoArray[KeyTraits<T>::NONLEAFSIZE + 1]{};
+};
+
+/**
+ * @brief Structure of non-leaf nodes with INTEGER keys. The keys form blocks
+ * of one cache line, and a directory of two levels holds the first key of
+ * each block and of each cache line of the first level, so that a search
+ * reads a line of each level and one block; see searchIntDirectory(). Every
+ * change of the keys rebuilds the directory.
+ */
+template <>
+struct NonLeafNode<int> {
+  int level = 0;
+  int numKeys = 0;
+  std::atomic<std::uint32_t> version{0};
+
+  alignas(INTKEYBLOCKSIZE * sizeof(int)) int keyArray[INTARRAYNONLEAFSIZE]{};
+  PageId pageNoArray[INTARRAYNONLEAFSIZE + 1]{};
+
+  /**
+   * First key of each block of keyArray, then first key of each cache line
+   * of blockKeys.
+   */
+  alignas(INTKEYBLOCKSIZE * sizeof(int)) int blockKeys[INTNONLEAFBLOCKS]{};
+  alignas(INTKEYBLOCKSIZE * sizeof(int)) int lineKeys[INTNONLEAFLINES]{};
+};
+
+/**
+ * @brief Structure for all leaf nodes with keys of type T.
+ */
+template <class T>
+struct LeafNode {
+  int level = -1;
+
+  /**
+   * Number of entries stored in the leaf.
+   */
+  int numKeys = 0;
+
+  /**
+   * Version of the leaf, odd while a writer holds it.
+   */
+  std::atomic<std::uint32_t> version{0};
+
+  /**
+   * Page number of the leaf on the right side.
+   * This linking of leaves allows to easily move from one leaf to the next leaf
+   * during index scan.
+   */
+  PageId rightSibPageNo = 0;
+
+  /**
+   * Page number of the leaf on the left side, followed by descending scans.
+   */
+  PageId leftSibPageNo = 0;
+
+  /**
+   * Stores keys.
+   */
+  T keyArray[KeyTraits<T>::LEAFSIZE]{};
+
+  /**
+   * Stores RecordIds.
+   */
+  RecordId ridArray[KeyTraits<T>::LEAFSIZE]{};
+};
+
+/**
+ * @brief Structure for leaf nodes with STRING keys. The prefix shared by all
+ * keys of the leaf is stored once. Each entry holds a record id followed by
+ * the rest of its key, so entries are
+ * sizeof(RecordId) + STRINGSIZE - prefixLen bytes long and a leaf whose keys
+ * share a long prefix holds more of them.
+ */
+template <>
+struct LeafNode<StringKey> {
+  int level = -1;
+
+  /**
+   * Number of entries stored in the leaf.
+   */
+  int numKeys = 0;
+
+  /**
+   * Version of the leaf, odd while a writer holds it.
+   */
+  std::atomic<std::uint32_t> version{0};
+
+  /**
+   * Length of the prefix shared by all keys of the leaf.
+   */
+  int prefixLen = 0;
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+  PageId rightSibPageNo = 0;
+
+  /**
+   * Page number of the leaf on the left side.
+   */
+  PageId leftSibPageNo = 0;
+
+  /**
+   * Stores the entries, each a record id followed by the key suffix.
+   */
+  char data[STRINGLEAFDATASIZE]{};
+
+  /**
+   * Prefix shared by all keys of the leaf.
+   */
+  char prefix[STRINGSIZE]{};
+};
+
+/**
+ * @brief Structure of a node page freed by a merge, until it is reused for a
+ * new node. Its key count stays zero so that it reads as an empty node.
+ */
+struct FreeNode {
+  int level = -2;
+
+  int numKeys = 0;
+
+  std::atomic<std::uint32_t> version{0};
+
+  /**
+   * Page number of the next freed page, or 0 if this is the last one.
+   */
+  PageId nextFreePageNo = 0;
+};
+
+/**
+ * @brief Structure of a page of a posting list, which holds the record ids of
+ * the entries of one key of a leaf that has many of them. The record ids are
+ * sorted, and each page stores them as varint-encoded differences from the
+ * one before, the first from zero, so that a page is decoded on its own. The
+ * pages of a list are linked both ways; the first one also holds the number
+ * of record ids of the whole list and the page number of the last one.
+ */
+struct PostingPage {
+  int level = -3;
+
+  /**
+   * Number of record ids stored in the page.
+   */
+  int numRids = 0;
+
+  std::atomic<std::uint32_t> version{0};
+
+  /**
+   * Number of bytes of data in use.
+   */
+  int numBytes = 0;
+
+  /**
+   * Number of record ids of the whole list, kept in its first page.
+   */
+  int totalRids = 0;
+
+  /**
+   * Page numbers of the pages before and after this one, or 0 at the ends.
+   */
+  PageId prevPageNo = 0;
+  PageId nextPageNo = 0;
+
+  /**
+   * Page number of the last page of the list, kept in its first page.
+   */
+  PageId lastPageNo = 0;
+
+  /**
+   * Largest record id stored in the page.
+   */
+  RecordId lastRid{};
+
+  /**
+   * The encoded record ids.
+   */
+  unsigned char data[POSTINGDATASIZE]{};
+};
+
+typedef NonLeafNode<int> NonLeafNodeInt;
+typedef LeafNode<int> LeafNodeInt;
+typedef NonLeafNode<double> NonLeafNodeDouble;
+typedef LeafNode<double> LeafNodeDouble;
+typedef NonLeafNode<StringKey> NonLeafNodeString;
+typedef LeafNode<StringKey> LeafNodeString;
+
+static_assert(sizeof(LeafNode<IntIntKey>) <= Page::BLOB_SIZE &&
+                  sizeof(NonLeafNode<IntIntKey>) <= Page::BLOB_SIZE &&
+                  sizeof(LeafNode<IntDoubleKey>) <= Page::BLOB_SIZE &&
+                  sizeof(NonLeafNode<IntDoubleKey>) <= Page::BLOB_SIZE &&
+                  sizeof(LeafNode<IntStringKey>) <= Page::BLOB_SIZE &&
+                  sizeof(NonLeafNode<IntStringKey>) <= Page::BLOB_SIZE,
+              "B+Tree nodes with composite keys must fit in a page.");
+
+static_assert(sizeof(NonLeafNodeInt) <= Page::BLOB_SIZE &&
+                  sizeof(LeafNodeInt) <= Page::BLOB_SIZE &&
+                  sizeof(NonLeafNodeDouble) <= Page::BLOB_SIZE &&
+                  sizeof(LeafNodeDouble) <= Page::BLOB_SIZE &&
+                  sizeof(NonLeafNodeString) <= Page::BLOB_SIZE &&
+                  sizeof(LeafNodeString) <= Page::BLOB_SIZE &&
+                  sizeof(PostingPage) <= Page::BLOB_SIZE,
+              "B+Tree nodes must fit in a page.");
+
+static_assert(offsetof(NonLeafNodeInt, version) ==
+                      offsetof(FreeNode, version) &&
+                  offsetof(LeafNodeInt, version) ==
+                      offsetof(FreeNode, version) &&
+                  offsetof(NonLeafNodeDouble, version) ==
+                      offsetof(FreeNode, version) &&
+                  offsetof(LeafNodeDouble, version) ==
+                      offsetof(FreeNode, version) &&
+                  offsetof(NonLeafNodeString, version) ==
+                      offsetof(FreeNode, version) &&
+                  offsetof(LeafNodeString, version) ==
+                      offsetof(FreeNode, version) &&
+                  offsetof(PostingPage, version) ==
+                      offsetof(FreeNode, version),
+              "B+Tree nodes must keep their version at the same offset.");
+
+class BTreeIndex;
+
+/**
+ * @brief A range scan of a BTreeIndex, opened by BTreeIndex::openScan(). The
+ * cursor keeps the leaf it is scanning pinned until the scan ends, so any
+ * number of cursors may be open over one index at once. A cursor must be ended
+ * or destroyed before its index is, and entries should not be deleted while it
+ * is open, since the leaf being scanned may be merged away. A snapshot scan
+ * instead reads copies of the leaves as they were when it was opened, and
+ * holds no page, so entries may be inserted and deleted meanwhile.
+ */
+class IndexScanCursor {
+ public:
+  /**
+   * Creates a cursor with no scan, to be assigned one from openScan().
+   */
+  IndexScanCursor() = default;
+
+  /**
+   * Takes over the scan of another cursor, which is left with no scan.
+   */
+  IndexScanCursor(IndexScanCursor &&other);
+
+  /**
+   * Ends the scan of this cursor, if any, and takes over the scan of another
+   * cursor, which is left with no scan.
+   */
+  IndexScanCursor &operator=(IndexScanCursor &&other);
+
+  /**
+   * Ends the scan, if it has not been ended.
+   */
+  ~IndexScanCursor();
+
+  /**
+   * Fetch the record id of the next index entry that matches the scan.
+   * @param outRid	RecordId of next record found that satisfies the scan
+   *criteria returned in this
+   * @param outColumns if not NULL, the covered columns of the entry are
+   *copied here
+   * @throws ScanNotInitializedException If the scan has been ended.
+   * @throws IndexScanCompletedException If no more records, satisfying the scan
+   *criteria, are left to be scanned.
+   **/
+  void scanNext(RecordId &outRid, char *outColumns = NULL);
+
+  /**
+   * Copy the record ids of the next entries that match the scan to outRids.
+   * @param outRids the array the record ids are copied to
+   * @param maxRids the number of record ids that fit in outRids
+   * @param outColumns if not NULL, the covered columns of the entries are
+   *         copied here, one after another
+   * @param outKeys if not NULL, the keys of the entries are copied here, one
+   *         after another, in the form keys are passed to the index in
+   * @return the number of record ids copied, which is less than maxRids only
+   *         at the end of the scan
+   * @throws ScanNotInitializedException If the scan has been ended.
+   **/
+  std::size_t scanNextBatch(RecordId *outRids, std::size_t maxRids,
+                            char *outColumns = NULL,
+                            void *outKeys = NULL);
+
+  /**
+   * Let the scan return at most limit more entries, as LIMIT does. Once they
+   * have been returned, scanNext() throws IndexScanCompletedException and
+   * scanNextBatch() returns 0 without reading any further leaf. The cursor
+   * stays where it stopped, so a new limit returns the entries after them.
+   * @param limit the number of entries returned at most
+   **/
+  void setLimit(std::size_t limit) { entriesLeft = limit; }
+
+  /**
+   * Pass over the next entries of the scan without returning them, as OFFSET
+   * does. They do not count against the limit. The leaves holding them are
+   * still read, since the nodes do not count the entries below them.
+   * @param n the number of entries passed over
+   * @return the number of entries passed over, fewer than n only at the end
+   *         of the scan
+   * @throws ScanNotInitializedException If the scan has been ended.
+   **/
+  std::size_t skip(std::size_t n);
+
+  /**
+   * Move the scan to the first entry of its range whose key is not less than
+   * the given key, or for a descending scan the last one whose key is not
+   * greater, whether it lies ahead of the scan or behind it. If that entry is
+   * in the leaf being scanned, the leaf is searched without reading any other
+   * page; otherwise the tree is descended from the root, or a snapshot scan
+   * walks its leaves to it.
+   * @param key the key, as keys are passed to the index
+   * @throws ScanNotInitializedException If the scan has been ended.
+   **/
+  void seek(const void *key);
+
+  /**
+   * Terminate the scan and unpin the leaf being scanned.
+   * @throws ScanNotInitializedException If the scan has been ended.
+   **/
+  void endScan();
+
+  /**
+   * Returns true if the scan has been started and not yet ended.
+   */
+  bool isExecuting() const { return scanExecuting; }
+
+ private:
+  friend class BTreeIndex;
+
+  IndexScanCursor(const IndexScanCursor &) = default;
+  IndexScanCursor &operator=(const IndexScanCursor &) = default;
+
+  /**
+   * Copy the record ids of the next entries to outRids, regardless of the
+   * limit.
+   */
+  std::size_t nextBatch(RecordId *outRids, std::size_t maxRids,
+                        char *outColumns, void *outKeys);
+
+  /**
+   * Index being scanned.
+   */
+  BTreeIndex *index{};
+
+  /**
+   * True if the scan has been started and not yet ended.
+   */
+  bool scanExecuting{};
+
+  /**
+   * Number of entries the scan may still return.
+   */
+  std::size_t entriesLeft{std::numeric_limits<std::size_t>::max()};
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned.
+   */
+  int nextEntry{};
+
+  /**
+   * Page number of current page being scanned.
+   */
+  PageId currentPageNum{};
+
+  /**
+   * Current Page being scanned.
+   */
+  Page *currentPageData{};
+
+  /**
+   * Epoch of the snapshot the scan reads, or 0 if it reads the leaves as they
+   * are.
+   */
+  std::uint64_t snapshot{};
+
+  /**
+   * Copy of the leaf being scanned, as of the snapshot, for a snapshot scan.
+   */
+  std::shared_ptr<Page> snapshotPage;
+
+  /**
+   * Low INTEGER value for scan.
+   */
+  int lowValInt{};
+
+  /**
+   * High INTEGER value for scan.
+   */
+  int highValInt{};
+
+  /**
+   * Low DOUBLE value for scan.
+   */
+  double lowValDouble{};
+
+  /**
+   * High DOUBLE value for scan.
+   */
+  double highValDouble{};
+
+  /**
+   * Low STRING value for scan.
+   */
+  StringKey lowValString{};
+
+  /**
+   * High STRING value for scan.
+   */
+  StringKey highValString{};
+
+  /**
+   * Low and high values for scan of the composite keys.
+   */
+  IntIntKey lowValIntInt{};
+  IntIntKey highValIntInt{};
+  IntDoubleKey lowValIntDouble{};
+  IntDoubleKey highValIntDouble{};
+  IntStringKey lowValIntString{};
+  IntStringKey highValIntString{};
+
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+  Operator lowOp{GT};
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+  Operator highOp{LT};
+
+  /**
+   * Access hint for the leaves read by the scan.
+   */
+  AccessHint scanHint{NORMAL_ACCESS};
+
+  /**
+   * Order in which the scan returns its entries.
+   */
+  ScanOrder order{ASCENDING};
+
+  /**
+   * True while the scan returns the record ids of the posting list of the
+   * entry at nextEntry.
+   */
+  bool inPostingList{};
+
+  /**
+   * Record ids of the posting list page being read, decoded, in scan order.
+   */
+  std::vector<RecordId> postingRids;
+
+  /**
+   * Index of the next record id of postingRids to be returned.
+   */
+  std::size_t postingNext{};
+
+  /**
+   * Page number of the posting list page read after the current one, or 0 if
+   * it is the last one in scan order.
+   */
+  PageId postingNextPageNo{};
+
+  /**
+   * Returns the low value of the scan for keys of type T.
+   */
+  template <class T>
+  T &lowVal();
+
+  /**
+   * Returns the high value of the scan for keys of type T.
+   */
+  template <class T>
+  T &highVal();
+};
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute
+ * of a relation, or on a pair of them. Any number of scans may be open at
+ * once through openScan(), besides the one of startScan(). A concurrent
+ * index may be read with scanRange() and written with insertEntry() and
+ * deleteEntry() from many threads at once.
+ */
+class BTreeIndex {
+ private:
+  friend class IndexScanCursor;
+
+  /**
+   * File object for the index file.
+   */
+  File *file{};
+
+  /**
+   * Buffer Manager Instance.
+   */
+  BufMgr *bufMgr{};
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+  Datatype attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records.
+   */
+  int attrByteOffset{};
+
+  /**
+   * Type of the keys, which are built from the attributes of
+   * indexMetaInfo.keyColumns.
+   */
+  KeyType keyType{};
+
+  /**
+   * True if the index may be used from several threads at once.
+   */
+  bool concurrent{};
+
+  /**
+   * Number of bytes of the covered columns of each leaf entry, 0 if the index
+   * stores none.
+   */
+  int coveredSize{};
+
+  /**
+   * The base relation, from which the covered columns of inserted entries are
+   * read. NULL if the index stores no columns.
+   */
+  File *relationFile{};
+
+  /**
+   * Latch guarding the meta page and the free list of a concurrent index, or
+   * of one being built by several threads.
+   */
+  std::mutex metaLatch;
+
+  /**
+   * True while the leaves of the index are built by several threads.
+   */
+  bool parallelBuild{};
+
+  /**
+   * Buffers of the posting list record ids of ended scans, kept with their
+   * capacity for the scans opened next; declared before scanCursor, which
+   * gives its buffer back when destroyed.
+   */
+  ObjectPool<std::vector<RecordId>> postingBuffers{SPARE_POSTING_BUFFERS};
+
+  /**
+   * The scan started by startScan().
+   */
+  IndexScanCursor scanCursor;
+
+  /**
+   * @brief What a node kept pinned knows of a child that is a leaf, so that a
+   * lookup or a scan can end at the node when none of the keys it seeks is
+   * in the leaf: its lowest and highest keys, or fence keys, and a Bloom
+   * filter of its keys. It is built from the leaf the first time a descent
+   * reads it, and keys inserted into the leaf are added to it. Deleted keys
+   * are not taken out, so the summary may cover more keys than the leaf
+   * holds but never fewer. A change of the node drops the summaries of all
+   * its children, since they may have moved to other entries.
+   */
+  struct LeafSummary {
+    /**
+     * True once built from the leaf
+     */
+    bool built;
+
+    /**
+     * True if any key was added, and then the lowest and highest of them
+     */
+    bool hasKeys;
+    alignas(8) char lowKey[MAXKEYSIZE];
+    alignas(8) char highKey[MAXKEYSIZE];
+
+    /**
+     * The Bloom filter, LEAF_FILTER_BITS_PER_KEY bits per key of the leaf
+     * when built
+     */
+    std::vector<std::uint64_t> filter;
+  };
+
+  /**
+   * @brief An internal node kept pinned by the index, with a slot for each of
+   * its children. The buffer manager points the slot of a resident child
+   * that is not kept pinned itself at its frame, and clears it when the child
+   * leaves the frame (see BufMgr::swizzle()), so that descents follow the slot
+   * rather than look the child up.
+   */
+  struct PinnedNode {
+    Page *page;
+
+    /**
+     * The slots, one per entry of pageNoArray, allocated once a child is read
+     */
+    std::unique_ptr<Page *[]> children;
+    int numChildren;
+
+    /**
+     * The summaries of the children, one per entry of pageNoArray, allocated
+     * once a child that is a leaf is read
+     */
+    std::unique_ptr<LeafSummary[]> leaves;
+  };
+
+  /**
+   * Internal nodes of the upper PINNED_LEVELS levels that the index keeps
+   * pinned, by page number, so that descents read them without going through
+   * the buffer manager. A concurrent index pins none, nor does one whose
+   * buffer manager logs its changes, since checkpoints skip pinned pages.
+   */
+  std::unordered_map<PageId, PinnedNode> pinnedNodes;
+
+  /**
+   * True if descents follow the slots of the nodes kept pinned.
+   */
+  bool swizzling{true};
+
+  /**
+   * True if the nodes kept pinned summarize their leaf children, and lookups
+   * and scans consult the summaries.
+   */
+  bool leafSummaries{true};
+
+  /**
+   * Inserts made while the index buffers them and not yet applied to the
+   * leaves, as RIDKeyPair of the key type of the index; the first
+   * numSortedPending of them are in order. Room is kept for maxPending, and
+   * the index buffers no insert if it is 0.
+   */
+  std::vector<char> pending;
+  std::size_t numPending{0};
+  std::size_t numSortedPending{0};
+  std::size_t maxPending{0};
+
+  /**
+   * Counters of IndexCounters, added to with relaxed atomics.
+   */
+  enum Counter {
+    INSERTS,
+    DELETES,
+    LOOKUPS,
+    LEAF_SPLITS,
+    NONLEAF_SPLITS,
+    ROOT_SPLITS,
+    SCANS_STARTED,
+    ENTRIES_RETURNED,
+    PAGES_PINNED,
+    LEAVES_SKIPPED,
+    BUFFER_FLUSHES,
+    PAGES_SAVED,
+    NUM_COUNTERS
+  };
+  std::atomic<std::uint64_t> counters[NUM_COUNTERS]{};
+
+  /**
+   * Add to a counter.
+   *
+   * @param counter the counter
+   * @param n the amount added
+   */
+  void count(Counter counter, std::uint64_t n = 1) {
+    counters[counter].fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /**
+   * Pin a page of the index file, counting it.
+   *
+   * @param pageNo the page number
+   * @param page set to the page
+   * @param hint the access hint given to the buffer manager
+   * @param site where the page is pinned, for pin tracking
+   */
+  void pinPage(PageId pageNo, Page *&page, AccessHint hint = NORMAL_ACCESS,
+               const PinSite &site = PinSite()) {
+    count(PAGES_PINNED);
+    bufMgr->readPage(file, pageNo, page, hint, site);
+    if (numSnapshots.load(std::memory_order_relaxed) > 0)
+      savePageVersion(pageNo, page);
+  }
+
+  /**
+   * Pin a page of the index file, counting it, and return a handle that
+   * unpins it when it goes out of scope.
+   *
+   * @param pageNo the page number
+   * @param hint the access hint given to the buffer manager
+   * @param site where the page is pinned, for pin tracking
+   */
+  PageHandle pinHandle(PageId pageNo, AccessHint hint = NORMAL_ACCESS,
+                       const PinSite &site = PinSite()) {
+    count(PAGES_PINNED);
+    PageHandle handle = bufMgr->pin(file, pageNo, hint, site);
+    if (numSnapshots.load(std::memory_order_relaxed) > 0)
+      savePageVersion(pageNo, handle.get());
+    return handle;
+  }
+
+  /**
+   * @brief A copy of a page as it was when the epoch it is tagged with began,
+   * saved before the first change made to the page in that epoch.
+   */
+  struct PageVersion {
+    std::uint64_t epoch;
+    std::unique_ptr<Page> page;
+  };
+
+  /**
+   * Copies of the leaves and posting list pages changed while snapshot scans
+   * are open, by page number, in the order of their epochs. An epoch begins
+   * with each snapshot opened, and a snapshot reads a page as the first copy
+   * tagged with its epoch or a later one, or as the page itself if there is
+   * none. Copies no open snapshot reads are dropped as snapshots close.
+   */
+  std::unordered_map<PageId, std::vector<PageVersion>> pageVersions;
+
+  /**
+   * Epochs of the open snapshots, the last epoch begun, and the number of
+   * open snapshots, read without the latch by every pin.
+   */
+  std::multiset<std::uint64_t> openSnapshots;
+  std::uint64_t snapshotEpoch{0};
+  std::atomic<std::size_t> numSnapshots{0};
+
+  /**
+   * Latch of the copies and the open snapshots.
+   */
+  std::mutex versionLatch;
+
+  /**
+   * Held shared by each change of a concurrent index, and exclusive while a
+   * snapshot is opened, so that no change spans the start of an epoch.
+   */
+  std::shared_timed_mutex snapshotLatch;
+
+  /**
+   * @brief Marks the calling thread as changing the index while in scope, so
+   * that the pages it pins are saved for the open snapshots before it
+   * changes them.
+   */
+  class WriteScope {
+   public:
+    explicit WriteScope(BTreeIndex &index);
+    ~WriteScope();
+
+    WriteScope(const WriteScope &) = delete;
+    WriteScope &operator=(const WriteScope &) = delete;
+
+   private:
+    BTreeIndex &index;
+    bool outermost;
+  };
+
+  /**
+   * Save a copy of a leaf or posting list page pinned by a change, unless
+   * the page was saved in the current epoch already.
+   *
+   * @param pageNo the page number
+   * @param page the page, pinned
+   */
+  void savePageVersion(PageId pageNo, Page *page);
+
+  /**
+   * Copy a page of the index as a snapshot sees it.
+   *
+   * @param epoch the epoch of the snapshot
+   * @param pageNo the page number
+   * @param copy the page the copy is made in
+   * @param hint the access hint given to the buffer manager
+   */
+  void readSnapshotPage(std::uint64_t epoch, PageId pageNo, Page *copy,
+                        AccessHint hint);
+
+  /**
+   * Begin an epoch for a new snapshot and return it.
+   */
+  std::uint64_t openSnapshot();
+
+  /**
+   * Close the snapshot of the given epoch, dropping the copies no open
+   * snapshot reads any more.
+   *
+   * @param epoch the epoch of the snapshot
+   */
+  void closeSnapshot(std::uint64_t epoch);
+
+  /**
+   * Open a scan of the index as it is now, reading the leaves it moves to
+   * as of then.
+   *
+   * @param lowValParm the low value of the range
+   * @param lowOpParm the operation to be used in testing the low range
+   * @param highValParm the high value of the range
+   * @param highOpParm the operation to be used in testing the high range
+   * @param hint access hint for the leaves read after the first one
+   * @param order order in which the entries are returned
+   * @return the cursor of the scan
+   */
+  IndexScanCursor openSnapshotScan(const void *lowValParm,
+                                   Operator lowOpParm,
+                                   const void *highValParm,
+                                   Operator highOpParm, AccessHint hint,
+                                   ScanOrder order);
+
+  /**
+   * Allocate a page of the index file and pin it, counting it.
+   *
+   * @param pageNo set to the page number
+   * @param page set to the page
+   * @param site where the page is pinned, for pin tracking
+   */
+  void pinNewPage(PageId &pageNo, Page *&page,
+                  const PinSite &site = PinSite()) {
+    count(PAGES_PINNED);
+    bufMgr->allocPage(file, pageNo, page, site);
+  }
+
+  /**
+   * Page number of meta page.
+   */
+  PageId headerPageNum{};
+
+  struct IndexMetaInfo indexMetaInfo {};
+
+  /**
+   * Write indexMetaInfo to the meta page of the index file. Called whenever
+   * the root page changes so that the index can be reopened later.
+   */
+  void writeMetaInfo();
+
+  /**
+   * Returns a lock on metaLatch, held only if the index is concurrent or is
+   * being built by several threads.
+   */
+  std::unique_lock<std::mutex> latchMeta() {
+    std::unique_lock<std::mutex> lock(metaLatch, std::defer_lock);
+    if (concurrent || parallelBuild) lock.lock();
+    return lock;
+  }
+
+  /**
+   * Returns the page number of the root, which writers of a concurrent index
+   * may change at any time.
+   */
+  PageId loadRootPageNo();
+
+  /**
+   * Make the given page the root and write the meta page.
+   *
+   * @param pageNo the page number of the new root
+   */
+  void storeRootPageNo(PageId pageNo);
+
+  /**
+   * Put the given node page on the free list of the index file, from which
+   * allocNonLeafNode() and allocLeafNode() take pages before growing the file.
+   *
+   * @param pageNo the page number of the node
+   * @param page the node page, pinned; it is unpinned here
+   */
+  void freeNode(PageId pageNo, Page *page);
+
+  /**
+   * Read a node on the way down from the root. A node kept pinned by the
+   * index is returned as it is; any other node is pinned, and kept pinned from
+   * then on if it is an internal node of the upper PINNED_LEVELS levels and
+   * the index pins fewer than one frame in PINNED_FRAME_SHARE of the pool.
+   *
+   * @param pageNo the page number of the node
+   * @param page set to the node page
+   * @param depth the number of levels above the node
+   * @param slot the slot of the node in its parent, see childSlot(), or NULL
+   * @param site where the node is pinned, for pin tracking
+   * @return the node as kept pinned, or NULL if it is not
+   */
+  PinnedNode *readNode(PageId pageNo, Page *&page, int depth,
+                       Page **slot = NULL, const PinSite &site = PinSite());
+
+  /**
+   * Returns the slot of a child of a node kept pinned, or NULL if the node is
+   * not kept pinned or descents do not follow slots.
+   *
+   * @param parent the node as kept pinned, or NULL
+   * @param index the index of the child in pageNoArray
+   */
+  template <class T>
+  Page **childSlot(PinnedNode *parent, int index);
+
+  /**
+   * Clear the slots of the children of a node kept pinned, after its
+   * pageNoArray changed or before it is unpinned.
+   *
+   * @param pinned the node as kept pinned
+   */
+  void unswizzleChildren(PinnedNode &pinned);
+
+  /**
+   * Build the summary of a leaf child of a node kept pinned, unless it is
+   * built already, allocating the summaries of the node if it has none yet.
+   *
+   * @param parent the node as kept pinned
+   * @param index the index of the leaf in pageNoArray
+   * @param leaf the leaf, pinned
+   */
+  template <class T>
+  void summarizeLeaf(PinnedNode &parent, int index, LeafNode<T> *leaf);
+
+  /**
+   * Add a key inserted into a leaf to its summary, if that is built.
+   *
+   * @param summary the summary
+   * @param key the key
+   */
+  template <class T>
+  static void addToSummary(LeafSummary &summary, const T &key);
+
+  /**
+   * Returns true if the summary of a leaf child of an internal node, if built,
+   * shows that no key from low to high is in the leaf or in the leaves after
+   * it, the leaf being the leftmost one that may hold low. The bounds are
+   * taken as included.
+   *
+   * @param parent the node as kept pinned
+   * @param index the index of the leaf in pageNoArray
+   * @param low the lowest key sought
+   * @param high the highest key sought
+   */
+  template <class T>
+  bool summaryExcludes(const PinnedNode &parent, int index, const T &low,
+                       const T &high);
+
+  /**
+   * Walk down the nodes kept pinned towards the leftmost leaf that may hold
+   * the given key, without pinning anything.
+   *
+   * @param key the key
+   * @param index set to the index of the child taken from the node returned
+   * @return the last node kept pinned on the way, or NULL if the root is not
+   *         one
+   */
+  template <class T>
+  PinnedNode *findPinnedParent(const T &key, int &index);
+
+  /**
+   * Release a node read by readNode(). A node kept pinned stays pinned, and
+   * is only marked dirty.
+   *
+   * @param pageNo the page number of the node
+   * @param dirty whether the node was changed
+   * @param depth the number of levels above the node
+   */
+  void unPinNode(PageId pageNo, bool dirty, int depth);
+
+  /**
+   * Unpin the nodes kept pinned, after the root changed or before the index
+   * file is flushed.
+   */
+  void unpinNodes();
+
+  /**
+   * Alloc a page in the buffer for a leaf node
+   *
+   * @param newPageId the page number for the new node
+   * @return a pointer to the new leaf node
+   */
+  template <class T>
+  LeafNode<T> *allocLeafNode(PageId &newPageId);
+
+  /**
+   * Alloc a page in the buffer for a page of a posting list
+   *
+   * @param newPageId the page number for the new page
+   * @return a pointer to the new posting list page
+   */
+  PostingPage *allocPostingPage(PageId &newPageId);
+
+  /**
+   * Alloca a page in the buffer for an internal node
+   *
+   * @param newPageId the page number for the new node
+   * @return a pointer to the new internal node
+   */
+  template <class T>
+  NonLeafNode<T> *allocNonLeafNode(PageId &newPageId);
+
+  /**
+   * This method takes in a page and checks if the page stores a leaf node or
+   * an internal node.
+   *
+   * Assumption: The level for leaf node is -1.
+   *
+   * @param page the page being checked
+   * @return true if the page stores a leaf node
+   *         false if the page stores an internal node
+   */
+  bool isLeaf(Page *page);
+
+  /**
+   * Checks if an internal node is full
+   *
+   * @param node an internal node
+   * @return true if an internal node is full
+   *         false if an internal node is not full
+   */
+  template <class T>
+  bool isNonLeafNodeFull(NonLeafNode<T> *node);
+
+  /**
+   * Checks if a leaf node is full
+   *
+   * @param node a leaf node
+   * @param key the key to be inserted
+   * @return true if a leaf node has no room for the key
+   *         false if a leaf node is not full
+   */
+  template <class T>
+  bool isLeafNodeFull(LeafNode<T> *node, const T &key);
+
+  /**
+   * Returns the number of records the leaf node can hold once the given key
+   * is stored in it.
+   *
+   * @param node a leaf node
+   * @param key the key to be stored
+   * @return the capacity of the leaf node
+   */
+  template <class T>
+  int getLeafCapacity(LeafNode<T> *node, const T &key);
+
+  /**
+   * Returns the number of entries a leaf holds at most, which is less when
+   * its entries have covered columns.
+   *
+   * @return the largest capacity of a leaf
+   */
+  template <class T>
+  int maxLeafCapacity();
+
+  /**
+   * Returns the key of the given entry of the leaf node.
+   *
+   * @param node a leaf node
+   * @param i the index of the entry
+   * @return the key of the entry
+   */
+  template <class T>
+  T getLeafKey(LeafNode<T> *node, int i);
+
+  /**
+   * Returns the record id of the given entry of the leaf node.
+   *
+   * @param node a leaf node
+   * @param i the index of the entry
+   * @return the record id of the entry
+   */
+  template <class T>
+  RecordId getLeafRid(LeafNode<T> *node, int i);
+
+  /**
+   * Returns the covered columns of the given entry of the leaf node.
+   *
+   * @param node a leaf node
+   * @param i the index of the entry
+   * @return the covered columns of the entry
+   */
+  template <class T>
+  char *getLeafColumns(LeafNode<T> *node, int i);
+
+  /**
+   * Make room for the covered columns of an entry inserted at the given index
+   * of a leaf, and store them there.
+   *
+   * @param node a leaf node
+   * @param i the index of the entry
+   * @param len the number of entries before the insertion
+   * @param columns the covered columns, or NULL to store zeros
+   */
+  template <class T>
+  void insertLeafColumns(LeafNode<T> *node, int i, int len,
+                         const char *columns);
+
+  /**
+   * Remove the covered columns of the entry at the given index of a leaf.
+   *
+   * @param node a leaf node
+   * @param i the index of the entry
+   * @param len the number of entries before the removal
+   */
+  template <class T>
+  void removeLeafColumns(LeafNode<T> *node, int i, int len);
+
+  /**
+   * Move the covered columns of the entries from the given index of a leaf on
+   * to the front of a new leaf.
+   *
+   * @param node a leaf node
+   * @param newNode an empty leaf node
+   * @param index the index of the first entry moved
+   * @param len the number of entries before the split
+   */
+  template <class T>
+  void splitLeafColumns(LeafNode<T> *node, LeafNode<T> *newNode, int index,
+                        int len);
+
+  /**
+   * Copy the covered columns out of a record.
+   *
+   * @param record the record
+   * @param columns the buffer the columns are copied to, one after another
+   */
+  void copyCoveredColumns(const char *record, char *columns);
+
+  /**
+   * Read the covered columns of a record of the base relation.
+   *
+   * @param rid the record id of the record
+   * @param columns the buffer the columns are copied to
+   * @return columns, or NULL if the index stores no columns
+   */
+  const char *readCoveredColumns(RecordId rid, char *columns);
+
+  /**
+   * Returns the number of records stored in the leaf node.
+   *
+   * @param node a leaf node
+   * @return the number of records stored in the leaf node
+   */
+  template <class T>
+  int getLeafLen(LeafNode<T> *node);
+
+  /**
+   * Returns the number of records stored in the internal node.
+   *
+   * @param node an internal node
+   * @return the number of records stored in the internal node
+   */
+  template <class T>
+  int getNonLeafLen(NonLeafNode<T> *node);
+
+  /**
+   * Given a key array, find the index of the first key larger than (or equal
+   * to) the given key.
+   *
+   * Assumption: The array is sorted.
+   *
+   * @param arr a key array
+   * @param len the length of the array
+   * @param key the target key
+   * @param includeKey whether the current key is included
+   *
+   * @return a. the index of the first key larger than the given key if
+   *            includeKey = false
+   *         b. the index of the first key larger than or equal to the
+   *            given key if includeKey = true
+   *         c. -1 if the key is not found till the end of array
+   */
+  template <class T>
+  int findArrayIndex(const T *arr, int len, const T &key,
+                     bool includeKey = true);
+
+  /**
+   * Find the index of the first key smaller than the given key
+   *
+   * Assumption: All keys are sorted in the node.
+   *
+   * @param node an internal node
+   * @param key the key to find
+   * @return the index of the first key smaller than the given key
+   *         return the largest index if not found
+   */
+  template <class T>
+  int findIndexNonLeaf(NonLeafNode<T> *node, const T &key);
+
+  /**
+   * Find the insertaion index for a key in a leaf node
+   *
+   * Assumption: All keys are sorted in the node.
+   *
+   * @param node a leaf node
+   * @param key the key to be inserted
+   *
+   * @return the insertaion index for a key in a leaf node
+   */
+  template <class T>
+  int findInsertionIndexLeaf(LeafNode<T> *node, const T &key);
+
+  /**
+   * Find the index of the first key larger than the given key in the leaf node
+   *
+   * Assumption: All keys are sorted in the node.
+   *
+   * @param node a leaf node
+   * @param key the key to find
+   * @param includeKey whether the current key is included
+   *
+   * @return a. the index of the first key larger than the given key if
+   *            includeKey = false
+   *         b. the index of the first key larger than or equal to the
+   *            given key if includeKey = true
+   *         c. -1 if the key is not found till the end of array
+   */
+  template <class T>
+  int findScanIndexLeaf(LeafNode<T> *node, const T &key, bool includeKey);
+
+  /**
+   * Inserts the given key-record pair into the leaf node at the given insertion
+   * index.
+   *
+   * @param node a leaf node
+   * @param i the insertion index
+   * @param key the key of the key-record pair to be inserted
+   * @param rid the record ID of the key-record pair to be inserted
+   * @param columns the covered columns of the entry, or NULL
+   */
+  template <class T>
+  void insertToLeafNode(LeafNode<T> *node, int i, const T &key, RecordId rid,
+                        const char *columns = NULL);
+
+  /**
+   * Appends the given key-record pair to the leaf node, after its last entry.
+   *
+   * @param node a leaf node
+   * @param len the number of entries in the leaf node
+   * @param key the key of the key-record pair to be appended
+   * @param rid the record ID of the key-record pair to be appended
+   * @param columns the covered columns of the entry, or NULL
+   */
+  template <class T>
+  void appendToLeafNode(LeafNode<T> *node, int len, const T &key,
+                        RecordId rid, const char *columns = NULL);
+
+  /**
+   * Removes the key-record pair at the given index from the leaf node.
+   *
+   * @param node a leaf node
+   * @param i the index of the pair to be removed
+   */
+  template <class T>
+  void removeFromLeafNode(LeafNode<T> *node, int i);
+
+  /**
+   * Removes the key at the given index and the page number after it from the
+   * internal node.
+   *
+   * @param n an internal node
+   * @param i the index of the key to be removed
+   */
+  template <class T>
+  void removeFromNonLeafNode(NonLeafNode<T> *n, int i);
+
+  /**
+   * Inserts the given key-(page number) pair into the given leaf node at the
+   * given index.
+   *
+   * @param n an internal node
+   * @param i the insertion index
+   * @param key the key of the key-(page number) pair
+   * @param pid the page number of the key-(page number) pair
+   */
+  template <class T>
+  void insertToNonLeafNode(NonLeafNode<T> *n, int i, const T &key, PageId pid);
+
+  /**
+   * Splits a leaf node into two.
+   * It moves the records after the given index in the node into the new node.
+   *
+   * @param node a pointer to the original node
+   * @param newNode a pointer to the new node
+   * @param index the index where the split occurs.
+   */
+  template <class T>
+  void splitLeafNode(LeafNode<T> *node, LeafNode<T> *newNode, int index);
+
+  /**
+   * Split the internal node by the given index. It moves the values stored in
+   * the given node after the split index into a new internal node.
+   *
+   * @param node an internal node
+   * @param i the index where the split occurs.
+   * @param keepMidKey Whether the value at the index should be moved to the
+   * parent internal node or not. If keepMidKey is true, then the pair at the
+   * index does not need to be moved up and will be moved to the newly created
+   *                   internal node, whose first page number is left for
+   *                   the caller to set.
+   *
+   * @return a pointer to the newly created internal node.
+   */
+  template <class T>
+  void splitNonLeafNode(NonLeafNode<T> *curr, NonLeafNode<T> *next, int i,
+                        bool keepMidKey);
+
+  /**
+   * Split a full leaf node, moving its upper half to a new node, and insert
+   * the given key-record pair into the half it belongs to.
+   *
+   * @param node a full leaf node
+   * @param pageId the page number of the node
+   * @param newNode an empty leaf node to the right of it
+   * @param newPageId the page number of the new node
+   * @param key the key of the key-record pair to be inserted
+   * @param rid the record ID of the key-record pair to be inserted
+   * @return the smallest key of the new node
+   */
+  template <class T>
+  T splitLeafAndInsert(LeafNode<T> *node, PageId pageId, LeafNode<T> *newNode,
+                       PageId newPageId, const T &key, RecordId rid);
+
+  /**
+   * Set the left sibling link of a leaf, waiting for a writer of a concurrent
+   * index that holds the leaf to release it.
+   *
+   * @param pageNo the page number of the leaf
+   * @param leftPageNo the page number of its new left sibling
+   */
+  template <class T>
+  void setLeftSibling(PageId pageNo, PageId leftPageNo);
+
+  /**
+   * Create a new root with midVal, pid1 and pid2.
+   *
+   * @param midVal the first middle value of the new root
+   * @param pid1 the first page number in the new root
+   * @param pid2 the second page number in the new root
+   *
+   * @return the page id of the new root
+   */
+  template <class T>
+  PageId splitRoot(const T &midVal, PageId pid1, PageId pid2);
+
+  /**
+   * Constructor the public ones delegate to, opening or creating the given
+   * index file, and building a new index from the records given by a feed if
+   * there is one, or else from the relation.
+   */
+  BTreeIndex(const std::string &relationName, const std::string &indexFile,
+             BufMgr *bufMgrIn, const std::vector<KeyColumn> &keyColumns,
+             const BuildMethod buildMethod, const double fillFactor,
+             const bool concurrent,
+             const std::vector<CoveredColumn> &coveredColumns,
+             const int buildThreads, const RecordFeed *records);
+
+  /**
+   * Build the index by calling insertEntry() for every tuple of the relation.
+   *
+   * @param relationName the name of the relation to be indexed
+   */
+  template <class T>
+  void insertBuild(const std::string &relationName);
+
+  /**
+   * Build the index bottom-up. All (key, rid) pairs of the relation are
+   * sorted and packed into leaf pages from left to right, by buildLeaves() or
+   * by buildLeavesParallel(). Each level of internal nodes is then packed from
+   * the smallest keys of the level below until a single root remains.
+   *
+   * @param relationName the name of the relation to be indexed
+   * @param fillFactor the fraction of each node to be filled
+   * @param numThreads the number of threads the leaves are built on
+   * @param records the records to build from, or NULL to scan the relation
+   */
+  template <class T>
+  void bulkBuild(const std::string &relationName, double fillFactor,
+                 int numThreads, const RecordFeed *records);
+
+  /**
+   * Build the leaves of a bulk build on this thread. The pairs are sorted,
+   * spilling sorted runs to a temporary file when they do not fit in memory.
+   *
+   * @param relationName the name of the relation to be indexed
+   * @param fillFactor the fraction of each leaf to be filled
+   * @param records the records to build from, or NULL to scan the relation
+   * @return the smallest key and page number of every leaf, from left to
+   *         right, which is empty if the relation is
+   */
+  template <class T>
+  std::vector<PageKeyPair<T>> buildLeaves(const std::string &relationName,
+                                          double fillFactor,
+                                          const RecordFeed *records);
+
+  /**
+   * Build the leaves of a bulk build on several threads. Each thread reads
+   * and sorts the pairs of its share of the relation pages. The key range is
+   * then split at keys sampled from the sorted shares, and each thread packs
+   * the pairs of one part of the range into a chain of leaves, the chains
+   * being linked up afterwards. The pairs are sorted in memory.
+   *
+   * @param relationName the name of the relation to be indexed
+   * @param fillFactor the fraction of each leaf to be filled
+   * @param numThreads the number of threads
+   * @return the smallest key and page number of every leaf, from left to
+   *         right, which is empty if the relation is
+   */
+  template <class T>
+  std::vector<PageKeyPair<T>> buildLeavesParallel(
+      const std::string &relationName, double fillFactor, int numThreads);
+
+  /**
+   * Pack sorted pairs into a chain of new leaves, spread evenly over them. A
+   * key with MINPOSTINGSIZE pairs or more is given a posting list if
+   * bulkPostingLists().
+   *
+   * @param feed called with a function that is to be called with every
+   *        pair, in sorted order
+   * @param numEntries the number of leaf entries the pairs take, or more
+   * @param fillFactor the fraction of each leaf to be filled
+   * @param columnsOf returns the covered columns of the record of a record
+   *        id
+   * @param lastPageNo set to the page number of the last leaf
+   * @return the smallest key and page number of every leaf, from left to
+   *         right
+   */
+  template <class T, class Feed, class Columns>
+  std::vector<PageKeyPair<T>> packLeaves(Feed feed, std::size_t numEntries,
+                                         double fillFactor, Columns columnsOf,
+                                         PageId &lastPageNo);
+
+  /**
+   * Returns true if a bulk build gives the keys with many pairs posting
+   * lists, which a concurrent index, or one whose entries carry covered
+   * columns, does without.
+   */
+  bool bulkPostingLists() const { return !concurrent && coveredSize == 0; }
+
+  /**
+   * Sort the given pairs and write them to the end of the sort file.
+   *
+   * @param runFile the temporary sort file
+   * @param run the pairs of the run, cleared once written
+   * @return the run written to the file
+   */
+  template <class T>
+  SortRun spillRun(File *runFile, std::vector<RIDKeyPair<T>> &run);
+
+  /**
+   * Merge the given sorted runs, passing each pair in order to emit.
+   *
+   * @param runFile the temporary sort file
+   * @param runs the runs to be merged, at most BULKLOAD_MERGE_FANIN of them
+   * @param emit called once for every pair, in sorted order
+   */
+  template <class T, class Emit>
+  void mergeRuns(File *runFile, const std::vector<SortRun> &runs, Emit &emit);
+
+  /**
+   * Pack the given nodes into a new level of internal nodes.
+   *
+   * @param children the smallest key and page number of every node of the
+   *        level below, from left to right
+   * @param fanout the number of children given to each new node
+   * @param level the level of the new nodes
+   * @return the smallest key and page number of every new node
+   */
+  template <class T>
+  std::vector<PageKeyPair<T>> buildNonLeafLevel(
+      const std::vector<PageKeyPair<T>> &children, int fanout, int level);
+
+  /**
+   * Create a posting list holding the given record ids.
+   *
+   * @param rids the record ids, sorted
+   * @param n the number of record ids, at least one
+   * @return the page number of the first page of the list
+   */
+  PageId createPostingList(const RecordId *rids, std::size_t n);
+
+  /**
+   * Append record ids to the end of a posting list.
+   *
+   * @param headPageNo the page number of the first page of the list
+   * @param rids the record ids, sorted and none smaller than those of the list
+   * @param n the number of record ids
+   */
+  void appendPostingRids(PageId headPageNo, const RecordId *rids,
+                         std::size_t n);
+
+  /**
+   * Link a new page into a posting list after the given one.
+   *
+   * @param head the first page of the list, pinned
+   * @param pageNo the page number of the page the new one follows
+   * @param page that page, pinned
+   * @param newPageNo set to the page number of the new page
+   * @return the new page, pinned, to be unpinned dirty
+   */
+  PageHandle linkPostingPage(PostingPage *head, PageId pageNo,
+                             PostingPage *page, PageId &newPageNo);
+
+  /**
+   * Find the page of a posting list that holds, or would hold, a record id.
+   *
+   * @param head the first page of the list, pinned
+   * @param headPageNo the page number of the first page
+   * @param rid the record id
+   * @param pageNo set to the page number of the page
+   * @param page set to the page, pinned
+   */
+  void findPostingPage(PostingPage *head, PageId headPageNo,
+                       const RecordId &rid, PageId &pageNo,
+                       PageHandle &page);
+
+  /**
+   * Insert a record id into a posting list.
+   *
+   * @param headPageNo the page number of the first page of the list
+   * @param rid the record id
+   */
+  void insertPostingRid(PageId headPageNo, RecordId rid);
+
+  /**
+   * Remove a record id from a posting list, freeing the list if it is left
+   * empty.
+   *
+   * @param headPageNo the page number of the first page of the list
+   * @param rid the record id
+   * @param emptied set to true if the list was left empty and freed
+   * @return true if the record id was found and removed
+   */
+  bool removePostingRid(PageId headPageNo, RecordId rid, bool &emptied);
+
+  /**
+   * Pass every record id of a posting list to emit, in order.
+   *
+   * @param headPageNo the page number of the first page of the list
+   * @param emit called with each record id
+   * @return the number of record ids of the list
+   */
+  template <class Emit>
+  std::size_t forEachPostingRid(PageId headPageNo, Emit &emit);
+
+  /**
+   * Decode a page of a posting list into the posting list state of a cursor.
+   *
+   * @param cursor the cursor
+   * @param pageNo the page number of the posting list page
+   */
+  void loadPostingPage(IndexScanCursor &cursor, PageId pageNo);
+
+  /**
+   * Copy the next record ids of the posting list an entry stands for, taking
+   * the cursor into the list first if it is not yet in it. The cursor leaves
+   * the list once all of its record ids have been copied.
+   *
+   * @param cursor the cursor
+   * @param listRid the record id of the entry
+   * @param outRids the array the record ids are copied to
+   * @param maxRids the number of record ids that fit in outRids
+   * @return the number of record ids copied
+   */
+  std::size_t nextPostingRids(IndexScanCursor &cursor, RecordId listRid,
+                              RecordId *outRids, std::size_t maxRids);
+
+  /**
+   * Insert the given key-record pair into a leaf without splitting it: into
+   * the posting list of the key if the leaf has one, else into the leaf if
+   * it has room, else by moving the entries of the key to a new posting list
+   * if they fill half of the leaf.
+   *
+   * @param node a leaf node
+   * @param key the key of the key-record pair
+   * @param rid the record id of the key-record pair
+   * @return false if the leaf is full and must be split
+   */
+  template <class T>
+  bool tryInsertToLeaf(LeafNode<T> *node, const T &key, RecordId rid);
+
+  /**
+   * Insert the given key-(record id) pair into the given leaf node.
+   *
+   * @param origNode a leaf node
+   * @param origPageId the page id of the page that stores the leaf node
+   * @param key the key of the key-record pair
+   * @param rid the record id of the key-record pair
+   * @param midVal a reference to a key in the parent node. If the insertion
+   * requires a split in the leaf node, midVal is set to the smallest element
+   * of the newly created node.
+   *
+   * @return The page number of the newly created page if insertion requires a
+   *         split, or 0 if no new node is created.
+   */
+  template <class T>
+  PageId insertToLeafPage(Page *origPage, PageId origPageId, const T &key,
+                          RecordId rid, T &midVal);
+
+  /**
+   * Recursively insert the given key-record pair into the subtree with the
+   * given root node. If the root node requires a split, the page number of the
+   * newly created node will be return
+   *
+   * @param origPageId page id of the page that stores the root node of the
+   *        subtree.
+   * @param key the key of the key-record pair to be inserted
+   * @param rid the record ID of the key-record pair to be inserted
+   * @param midVal a reference to a key to be stored in the parent node. If
+   *        the insertion requires a split in the current level, midVal is set
+   *        to the smallest key stored in the subtree pointed by the newly
+   *        created node.
+   * @param depth the number of levels above the node
+   * @param slot the slot of the node in its parent, or NULL
+   *
+   * @return the page number of the newly created node if a split occurs, or 0
+   *         otherwise.
+   */
+  template <class T>
+  PageId insert(PageId origPageId, const T &key, RecordId rid, T &midVal,
+                int depth = 0, Page **slot = NULL);
+
+  /**
+   * Insert the given key-record pair, splitting the root if needed.
+   *
+   * @param key the key of the key-record pair to be inserted
+   * @param rid the record ID of the key-record pair to be inserted
+   */
+  template <class T>
+  void insertKey(const T &key, RecordId rid);
+
+  /**
+   * Insert a batch of entries in key order. The entries of each run that falls
+   * into one leaf are inserted under a single descent from the root.
+   *
+   * @param keys the keys, stored one after another
+   * @param rids the record ids of the entries
+   * @param n the number of entries
+   */
+  template <class T>
+  void insertKeyBatch(const void *keys, const RecordId *rids, std::size_t n);
+
+  /**
+   * Descend from the root to the leaf of the first of a sorted run of
+   * key-record pairs, and insert the pairs into it for as long as they belong
+   * in it and it has room.
+   *
+   * @param begin the first pair of the run
+   * @param end the end of the run
+   * @return the number of pairs inserted, 0 if the leaf of the first one is
+   *         full
+   */
+  template <class T>
+  std::size_t insertRunToLeaf(const RIDKeyPair<T> *begin,
+                              const RIDKeyPair<T> *end);
+
+  /**
+   * Insert key-record pairs sorted in key order, a run per leaf.
+   *
+   * @param pairs the pairs
+   * @param n the number of pairs
+   */
+  template <class T>
+  void insertSortedPairs(const RIDKeyPair<T> *pairs, std::size_t n);
+
+  /**
+   * Insert the given key-record pair, or add it to the pending inserts if the
+   * index buffers them.
+   *
+   * @param key the key of the key-record pair to be inserted
+   * @param rid the record ID of the key-record pair to be inserted
+   */
+  template <class T>
+  void insertOrBufferKey(const T &key, RecordId rid);
+
+  /**
+   * Returns the pending inserts.
+   */
+  template <class T>
+  RIDKeyPair<T> *pendingPairs() {
+    return (RIDKeyPair<T> *)pending.data();
+  }
+
+  /**
+   * Add a key-record pair to the pending inserts, applying them all to the
+   * leaves first if there is no room.
+   *
+   * @param key the key of the pair
+   * @param rid the record ID of the pair
+   */
+  template <class T>
+  void bufferInsert(const T &key, RecordId rid);
+
+  /**
+   * Put the pending inserts in order, merging those added since they last
+   * were into the ones that are.
    */
-  NonLeafNodeInt *allocNonLeafNode(PageId &newPageId);
+  template <class T>
+  void sortPending();
 
   /**
-   * This method takes in a page and checks if the page stores a leaf node or
-   * an internal node.
-   *
-   * Assumption: The level for leaf node is -1.
-   *
-   * @param page the page being checked
-   * @return true if the page stores a leaf node
-   *         false if the page stores an internal node
+   * Apply the pending inserts to the leaves, in key order.
    */
-  bool isLeaf(Page *page);
+  template <class T>
+  void flushPending();
 
   /**
-   * Checks if an internal node is full
+   * Call emit with the record id of each pending insert of the given key, in
+   * record id order.
    *
-   * Assumption: All valid page numbers are nonzero.
-   *
-   * @param node an internal node
-   * @return true if an internal node is full
-   *         false if an internal node is not full
+   * @param key the key
+   * @param emit the function called with each record id
+   * @return the number of pending inserts of the key
    */
-  bool isNonLeafNodeFull(NonLeafNodeInt *node);
+  template <class T, class Emit>
+  std::size_t forEachPendingMatch(const T &key, Emit emit);
 
   /**
-   * Checks if a leaf node is full
-   *
-   * Assumption: All valid records are nonzero.
+   * Remove the given key-record pair from the pending inserts.
    *
-   * @param node a leaf node
-   * @return true if a leaf node is full
-   *         false if a leaf node is not full
+   * @param key the key of the pair
+   * @param rid the record ID of the pair
+   * @return true if the pair was pending
    */
-  bool isLeafNodeFull(LeafNodeInt *node);
+  template <class T>
+  bool removePending(const T &key, RecordId rid);
 
   /**
-   * Returns the number of records stored in the leaf node.
-   *
-   * Assumption:
-   *             1. All records are continuously stored.
-   *             2. All valid records are nonzero.
+   * Merge two adjacent leaves if their entries fit in one, or else move
+   * entries between them until they hold about the same number.
    *
-   * @param node a leaf node
-   * @return the number of records stored in the leaf node
+   * @param left the left leaf
+   * @param right the right leaf
+   * @param sep the key separating them in the parent, updated if entries move
+   * @return true if the right leaf was merged into the left one
    */
-  int getLeafLen(LeafNodeInt *node);
+  template <class T>
+  bool rebalanceLeaves(LeafNode<T> *left, LeafNode<T> *right, T &sep);
 
   /**
-   * Returns the number of records stored in the internal node.
+   * Merge two adjacent internal nodes with the key separating them if they fit
+   * in one, or else rotate keys through the separator until they hold about
+   * the same number.
    *
-   * Assumption:
-   *             1. All records are continuously stored.
-   *             2. All valid page numbers are nonzero.
+   * @param left the left node
+   * @param right the right node
+   * @param sep the key separating them in the parent, updated if keys move
+   * @return true if the right node was merged into the left one
+   */
+  template <class T>
+  bool rebalanceNonLeaves(NonLeafNode<T> *left, NonLeafNode<T> *right,
+                          T &sep);
+
+  /**
+   * Rebalance the child of the given node that holds too few keys with one of
+   * its siblings, freeing the sibling page if they are merged.
    *
    * @param node an internal node
-   * @return the number of records stored in the internal node
+   * @param c the index of the child that holds too few keys
    */
-  int getNonLeafLen(NonLeafNodeInt *node);
+  template <class T>
+  void rebalanceChild(NonLeafNode<T> *node, int c);
 
   /**
-   * Given an integer array, find the index of the first integer larger than
-   * (or equal to) the given key.
-   *
-   * Assumption: The array is sorted.
-   *
-   * @param arr an interger array
-   * @param len the length of the array
-   * @param key the target key
-   * @param includeKey whether the current key is included
+   * Recursively remove the given key-record pair from the subtree with the
+   * given root node.
    *
-   * @return a. the index of the first integer larger than the given key if
-   *            includeKey = false
-   *         b. the index of the first integer larger than or equal to the
-   *            given key if includeKey = true
-   *         c. -1 if the key is not found till the end of array
+   * @param pageNo page id of the page that stores the root node of the subtree
+   * @param key the key of the key-record pair to be removed
+   * @param rid the record ID of the key-record pair to be removed
+   * @param underflow set to whether the root node of the subtree is left with
+   *        too few keys
+   * @param depth the number of levels above the node
+   * @param slot the slot of the node in its parent, or NULL
+   * @return true if the pair was found and removed
    */
-  int findArrayIndex(const int *arr, int len, int key, bool includeKey = true);
+  template <class T>
+  bool remove(PageId pageNo, const T &key, RecordId rid, bool &underflow,
+              int depth = 0, Page **slot = NULL);
 
   /**
-   * Find the index of the first key smaller than the given key
-   *
-   * Assumption:
-   *             1. All records are continuously stored.
-   *             2. All valid page numbers are nonzero.
-   *             3. All keys are sorted in the node.
+   * Remove the given key-record pair, replacing the root if it is left with a
+   * single child.
    *
-   * @param node an internal node
-   * @param key the key to find
-   * @return the index of the first key smaller than the given key
-   *         return the largest index if not found
+   * @param key the key of the key-record pair to be removed
+   * @param rid the record ID of the key-record pair to be removed
+   * @return true if the pair was found and removed
    */
-  int findIndexNonLeaf(NonLeafNodeInt *node, int key);
+  template <class T>
+  bool deleteKey(const T &key, RecordId rid);
 
   /**
-   * Find the insertaion index for a key in a leaf node
-   *
-   * Assumption:
-   *             1. All records are continuously stored.
-   *             2. All valid records are nonzero.
-   *             3. All keys are sorted in the node.
+   * Find the child of an internal node to descend to for the given key, while
+   * writers may be changing the node.
    *
-   * @param node a leaf node
-   * @param key the key to be inserted
-   *
-   * @return the insertaion index for a key in a leaf node
+   * @param node an internal node
+   * @param key the key to find
+   * @return the index of the child, which is only right if the version of the
+   *         node is unchanged afterwards
    */
-  int findInsertionIndexLeaf(LeafNodeInt *node, int key);
+  template <class T>
+  int findChildConcurrent(NonLeafNode<T> *node, const T &key);
 
   /**
-   * Find the index of the first key larger than the given key in the leaf node
-   *
-   * Assumption:
-   *             1. All records are continuously stored.
-   *             2. All valid records are nonzero.
-   *             3. All keys are sorted in the node.
+   * Descend from the root to the leftmost leaf that may hold the given key,
+   * checking the version of each node after reading the child page number
+   * from it and restarting from the root if one changed.
    *
-   * @param node a leaf node
    * @param key the key to find
-   * @param includeKey whether the current key is included
-   *
-   * @return a. the index of the first integer larger than the given key if
-   *            includeKey = false
-   *         b. the index of the first integer larger than or equal to the
-   *            given key if includeKey = true
-   *         c. -1 if the key is not found till the end of array
+   * @param pageNo set to the page number of the leaf
+   * @param page set to the leaf page, pinned
+   * @return the version of the leaf when it was reached
    */
-  int findScanIndexLeaf(LeafNodeInt *node, int key, bool includeKey);
+  template <class T>
+  std::uint32_t findLeafConcurrent(const T &key, PageId &pageNo, Page *&page);
 
   /**
-   * Inserts the given key-record pair into the leaf node at the given insertion
-   * index.
+   * Make one attempt at inserting the given key-record pair into a concurrent
+   * index. Full internal nodes are split on the way down, so that a split
+   * below always finds room in its parent.
    *
-   * @param node a leaf node
-   * @param i the insertion index
    * @param key the key of the key-record pair to be inserted
    * @param rid the record ID of the key-record pair to be inserted
+   * @return false if a node changed under the attempt, which has to be
+   *         restarted
    */
-  void insertToLeafNode(LeafNodeInt *node, int i, int key, RecordId rid);
+  template <class T>
+  bool tryInsertConcurrent(const T &key, RecordId rid);
 
   /**
-   * Inserts the given key-(page number) pair into the given leaf node at the
-   * given index.
+   * Remove the given key-record pair from a concurrent index. Leaves are not
+   * merged, so that pages are never freed under readers.
    *
-   * @param n an internal node
-   * @param i the insertion index
-   * @param key the key of the key-(page number) pair
-   * @param pid the page number of the key-(page number) pair
+   * @param key the key of the key-record pair to be removed
+   * @param rid the record ID of the key-record pair to be removed
+   * @return true if the pair was found and removed
    */
-  void insertToNonLeafNode(NonLeafNodeInt *n, int i, int key, PageId pid);
+  template <class T>
+  bool deleteKeyConcurrent(const T &key, RecordId rid);
 
   /**
-   * Splits a leaf node into two.
-   * It moves the records after the given index in the node into the new node.
+   * Append the record ids of the entries in the given range to outRids. Each
+   * leaf is copied and its version checked before its entries are read, and
+   * copied again if it changed.
    *
-   * @param node a pointer to the original node
-   * @param newNode a pointer to the new node
-   * @param index the index where the split occurs.
+   * @param lowValParm the low value of the range
+   * @param lowOpParm the operation to be used in testing the low range
+   * @param highValParm the high value of the range
+   * @param highOpParm the operation to be used in testing the high range
+   * @param outRids the vector the record ids are appended to
    */
-  void splitLeafNode(LeafNodeInt *node, LeafNodeInt *newNode, int index);
+  template <class T>
+  void scanKeyRange(const T &lowValParm, Operator lowOpParm,
+                    const T &highValParm, Operator highOpParm,
+                    std::vector<RecordId> &outRids);
 
   /**
-   * Split the internal node by the given index. It moves the values stored in
-   * the given node after the split index into a new internal node.
-   *
-   * @param node an internal node
-   * @param i the index where the split occurs.
-   * @param keepMidKey Whether the value at the index should be moved to the
-   * parent internal node or not. If keepMidKey is true, then the pair at the
-   * index does not need to be moved up and will be moved to the newly created
-   *                   internal node.
+   * Descend from the root to the leftmost leaf that may hold the given key,
+   * unless the summary of the leaf shows that the key is in no leaf.
    *
-   * @return a pointer to the newly created internal node.
+   * @param key the key to find
+   * @param pageNo set to the page number of the leaf
+   * @param page set to the leaf page, pinned
+   * @return false, with no page pinned, if the key is in no leaf
    */
-  void splitNonLeafNode(NonLeafNodeInt *curr, NonLeafNodeInt *next, int i,
-                        bool keepMidKey);
+  template <class T>
+  bool findLeafPage(const T &key, PageId &pageNo, Page *&page);
 
   /**
-   * Create a new root with midVal, pid1 and pid2.
+   * Pass the record id of every entry with the given key to emit, starting at
+   * the given index of a pinned leaf before which there is none, and following
+   * the sibling links while the entries continue. The last leaf visited is
+   * left pinned.
    *
-   * @param midVal the first middle value of the new root
-   * @param pid1 the first page number in the new root
-   * @param pid2 the second page number in the new root
+   * @param key the key to find
+   * @param index the index of the first entry of the leaf not smaller than
+   *        key, or the length of the leaf if there is none
+   * @param pageNo the page number of the leaf, updated as siblings are visited
+   * @param page the leaf page, updated as siblings are visited
+   * @param emit called with the record id of each entry
+   * @return the number of entries with the key
+   */
+  template <class T, class Emit>
+  std::size_t forEachMatch(const T &key, int index, PageId &pageNo,
+                           Page *&page, Emit emit);
+
+  /**
+   * Find the entries with the given key with one descent from the root.
    *
-   * @return the page id of the new root
+   * @param key the key to find
+   * @param outRids the array the record ids of the entries are copied to
+   * @param maxRids the number of record ids that fit in outRids
+   * @return the number of entries with the key
    */
-  PageId splitRoot(int midVal, PageId pid1, PageId pid2);
+  template <class T>
+  std::size_t lookupKey(const T &key, RecordId *outRids, std::size_t maxRids);
 
   /**
-   * Insert the given key-(record id) pair into the given leaf node.
+   * Find the entries of each of the given keys, keeping the leaf of the last
+   * key pinned and looking for the next key in it when all of its entries
+   * start there.
    *
-   * @param origNode a leaf node
-   * @param origPageId the page id of the page that stores the leaf node
-   * @param key the key of the key-record pair
-   * @param rid the record id of the key-record pair
-   * @param midVal a reference to an integer in the parent node. If the
-   * insertion requires a split in the leaf node, midVal is set to the smallest
-   * element of the newly created node.
+   * @param keys the keys, stored one after another
+   * @param n the number of keys
+   * @param outRids the vector the record ids of the entries are appended to
+   * @param outCounts the vector the number of entries of each key is appended
+   *        to
+   * @param maxRidsPerKey the number of record ids of a key appended at most
+   */
+  template <class T>
+  void lookupManyKeys(const void *keys, std::size_t n,
+                      std::vector<RecordId> &outRids,
+                      std::vector<std::size_t> &outCounts,
+                      std::size_t maxRidsPerKey);
+
+  /**
+   * Walk down the leftmost path of the tree and along its leaves, counting
+   * them and their entries and keys.
    *
-   * @return The page number of the newly created page if insertion requires a
-   *         split, or 0 if no new node is created.
+   * @param stats the statistics filled in
    */
-  PageId insertToLeafPage(Page *origPage, PageId origPageId, int key,
-                          RecordId rid, int &midVal);
+  template <class T>
+  void collectStats(IndexStats &stats);
 
   /**
-   * Recursively insert the given key-record pair into the subtree with the
-   * given root node. If the root node requires a split, the page number of the
-   * newly created node will be return
+   * Walk the tree a level at a time, counting the nodes and keys of each
+   * level, then along the leaves, counting the links out of file order.
    *
-   * @param origPageId page id of the page that stores the root node of the
-   *        subtree.
-   * @param key the key of the key-record pair to be inserted
-   * @param rid the record ID of the key-record pair to be inserted
-   * @param midVal a pointer to an integer value to be stored in the parent
-   * node. If the insertion requires a split in the current level, midVal is set
-   *        to the smallest key stored in the subtree pointed by the newly
-   * created node.
+   * @param analysis the analysis filled in
+   */
+  template <class T>
+  void analyzeTree(IndexAnalysis &analysis);
+
+  /**
+   * Move the scan of a cursor to the first entry of its range not before the
+   * given key in the order of the scan.
    *
-   * @return the page number of the newly created node if a split occurs, or 0
-   *         otherwise.
+   * @param cursor the cursor
+   * @param keyParm the key
    */
-  PageId insert(PageId origPageId, int key, RecordId rid, int &midVal);
+  template <class T>
+  void seekKey(IndexScanCursor &cursor, const T &keyParm);
 
   /**
-   * Change the currently scanning page to the next page pointed to by the
-   * current page.
+   * Change the currently scanning page of a cursor to the next page pointed to
+   * by the current page.
+   * @param cursor the cursor
    * @param node the node stored in the currently scanning page.
    */
-  void moveToNextPage(LeafNodeInt *node);
+  template <class T>
+  void moveToNextPage(IndexScanCursor &cursor, LeafNode<T> *node);
+
+  /**
+   * Ask the buffer manager to read ahead the leaves to the right of the
+   * currently scanning page of a cursor.
+   */
+  template <class T>
+  void prefetchSiblings(IndexScanCursor &cursor);
 
   /**
    * Recursively find the page id of the first element larger than or equal to
-   * the lower bound given.
+   * the lower bound of a cursor.
+   *
+   * @param cursor the cursor
+   * @param depth the number of levels above its currently scanning page
+   * @param slot the slot of that page in its parent, or NULL
    */
-  void setPageIdForScan();
+  template <class T>
+  void setPageIdForScan(IndexScanCursor &cursor, int depth = 0,
+                        Page **slot = NULL);
 
   /**
-   * Find the first element in the currently scanning page that is within the
-   * given bound.
+   * Find the first element in the currently scanning page of a cursor that is
+   * within its bound.
    */
-  void setEntryIndexForScan();
+  template <class T>
+  void setEntryIndexForScan(IndexScanCursor &cursor);
 
   /**
    * Continue scanning the next entry. If the currently scanning entry is the
    * last element in this page, set the current scanning page to the next page.
    */
-  void setNextEntry();
+  template <class T>
+  void setNextEntry(IndexScanCursor &cursor);
+
+  /**
+   * Begin a scan for the given range, whose operators have been checked.
+   *
+   * @param cursor the cursor the scan is started in
+   * @param lowValParm the low value of the range
+   * @param lowOpParm the operation to be used in testing the low range
+   * @param highValParm the high value of the range
+   * @param highOpParm the operation to be used in testing the high range
+   * @param hint access hint for the leaves read after the first one
+   * @param order order in which the entries are returned
+   */
+  template <class T>
+  void startKeyScan(IndexScanCursor &cursor, const T &lowValParm,
+                    Operator lowOpParm, const T &highValParm,
+                    Operator highOpParm, AccessHint hint, ScanOrder order);
+
+  /**
+   * Begin a scan from the given key to the end of the index in the order of
+   * the scan.
+   *
+   * @param cursor the cursor the scan is started in
+   * @param key the key the scan starts at
+   * @param hint access hint for the leaves read after the first one
+   * @param order order in which the entries are returned
+   */
+  template <class T>
+  void startScanFrom(IndexScanCursor &cursor, const T &key, AccessHint hint,
+                     ScanOrder order);
+
+  /**
+   * Begin a scan for the range bounded by the given values of the leading
+   * columns of the keys, whose operators have been checked.
+   *
+   * @param cursor the cursor the scan is started in
+   * @param lowValParm the low values of the range
+   * @param lowOpParm the operation to be used in testing the low range
+   * @param highValParm the high values of the range
+   * @param highOpParm the operation to be used in testing the high range
+   * @param numColumns the number of leading columns the values are given for
+   * @param hint access hint for the leaves read after the first one
+   * @param order order in which the entries are returned
+   */
+  template <class T>
+  void startPrefixKeyScan(IndexScanCursor &cursor, const void *lowValParm,
+                          Operator lowOpParm, const void *highValParm,
+                          Operator highOpParm, int numColumns,
+                          AccessHint hint, ScanOrder order);
+
+  /**
+   * Fetch the record id of the next index entry that matches the scan of a
+   * cursor.
+   *
+   * @param cursor the cursor
+   * @param outRid the record id of the next matching entry
+   */
+  template <class T>
+  void scanNextKey(IndexScanCursor &cursor, RecordId &outRid,
+                   char *outColumns);
+
+  /**
+   * Copy the record ids of the next entries that match the scan of a cursor to
+   * outRids.
+   *
+   * @param cursor the cursor
+   * @param outRids the array the record ids are copied to
+   * @param maxRids the number of record ids that fit in outRids
+   * @param outColumns the buffer the covered columns are copied to, or NULL
+   * @param outKeys the buffer the keys are copied to, or NULL
+   * @return the number of record ids copied
+   */
+  template <class T>
+  std::size_t scanNextBatchKey(IndexScanCursor &cursor, RecordId *outRids,
+                               std::size_t maxRids, char *outColumns,
+                               char *outKeys);
 
  public:
   /**
    * BTreeIndex Constructor.
    * Check to see if the corresponding index file exists. If so, open the
-   * file. If not, create it and insert entries for every tuple in the base
-   * relation using FileScan class.
+   * file and reuse the tree described by its meta page. If not, create it and
+   * insert entries for every tuple in the base relation using FileScan class.
    *
    * @param relationName        Name of file.
    * @param outIndexName        Return the name of index file.
@@ -486,6 +3003,15 @@ class BTreeIndex {
    * index is to be built, in the record
    * @param attrType						Datatype
    * of attribute over which index is built
+   * @param buildMethod         How the index is built if it is created
+   * @param fillFactor          Fraction of each node filled by a bulk build
+   * @param concurrent          Whether the index may be used from several
+   * threads at once, which needs a concurrent buffer manager; a buffer manager
+   * with a log can not hold a concurrent index
+   * @param coveredColumns      Columns stored in the leaf entries next to the
+   * key; a concurrent index can store none
+   * @param buildThreads        Number of threads a bulk build runs on; more
+   * than one needs a concurrent buffer manager
    * @throws  BadIndexInfoException     If the index file already exists for
    * the corresponding attribute, but values in metapage(relationName,
    * attribute byte offset, attribute type etc.) do not match with values
@@ -493,7 +3019,93 @@ class BTreeIndex {
    */
   BTreeIndex(const std::string &relationName, std::string &outIndexName,
              BufMgr *bufMgrIn, const int attrByteOffset,
-             const Datatype attrType);
+             const Datatype attrType, const BuildMethod buildMethod = BULK_BUILD,
+             const double fillFactor = DEFAULT_FILL_FACTOR,
+             const bool concurrent = false,
+             const std::vector<CoveredColumn> &coveredColumns =
+                 std::vector<CoveredColumn>(),
+             const int buildThreads = 1);
+
+  /**
+   * BTreeIndex Constructor for an index on several attributes, whose keys
+   * compare by their first attribute, then by the next. The index file name
+   * is the relation name followed by the offset of each attribute. A key is
+   * given to the other methods as the values of its attributes stored one
+   * after another, without padding: integers, doubles, or strings of
+   * STRINGSIZE characters. A single attribute makes the index the same as one
+   * built by the constructor above.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn            Buffer Manager Instance
+   * @param keyColumns          Attributes the keys are built from, in order:
+   * one, or an INTEGER attribute followed by one of any type
+   * @param buildMethod         How the index is built if it is created
+   * @param fillFactor          Fraction of each node filled by a bulk build
+   * @param concurrent          Whether the index may be used from several
+   * threads at once, which needs a concurrent buffer manager
+   * @param coveredColumns      Columns stored in the leaf entries next to the
+   * key; a concurrent index can store none
+   * @param buildThreads        Number of threads a bulk build runs on; more
+   * than one needs a concurrent buffer manager
+   * @throws  BadIndexInfoException     If no index is built on such attributes,
+   * or if the index file already exists but its metapage does not match the
+   * parameters.
+   */
+  BTreeIndex(const std::string &relationName, std::string &outIndexName,
+             BufMgr *bufMgrIn, const std::vector<KeyColumn> &keyColumns,
+             const BuildMethod buildMethod = BULK_BUILD,
+             const double fillFactor = DEFAULT_FILL_FACTOR,
+             const bool concurrent = false,
+             const std::vector<CoveredColumn> &coveredColumns =
+                 std::vector<CoveredColumn>(),
+             const int buildThreads = 1);
+
+  /**
+   * BTreeIndex Constructor bulk building a new index from the records given
+   * by a feed rather than from a scan of the relation, as a loader does with
+   * the records it has just written.  An index file already there is opened
+   * as by the constructor above, without calling the feed.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn            Buffer Manager Instance
+   * @param keyColumns          Attributes the keys are built from
+   * @param records             Every record of the relation
+   * @param fillFactor          Fraction of each node filled
+   * @param coveredColumns      Columns stored in the leaf entries next to the
+   * key, read from the records given
+   * @throws  BadIndexInfoException     As the constructor above.
+   */
+  BTreeIndex(const std::string &relationName, std::string &outIndexName,
+             BufMgr *bufMgrIn, const std::vector<KeyColumn> &keyColumns,
+             const RecordFeed &records,
+             const double fillFactor = DEFAULT_FILL_FACTOR,
+             const std::vector<CoveredColumn> &coveredColumns =
+                 std::vector<CoveredColumn>());
+
+  /**
+   * BTreeIndex Constructor for an index kept in a file of the given name,
+   * which may lie in any directory, rather than in one named after the
+   * relation and attributes, as the partitions of a PartitionedIndex are. An
+   * index file already there is opened as by the constructors above; a new
+   * index is bulk built from the records given by a feed.
+   *
+   * @param relationName        Name of file.
+   * @param indexFile           Name of the index file
+   * @param bufMgrIn            Buffer Manager Instance
+   * @param keyColumns          Attributes the keys are built from
+   * @param records             Every record to index, which may be a part of
+   * the relation
+   * @param fillFactor          Fraction of each node filled
+   * @param concurrent          Whether the index may be used from several
+   * threads at once, which needs a concurrent buffer manager
+   * @throws  BadIndexInfoException     As the constructors above.
+   */
+  BTreeIndex(const std::string &relationName, const std::string &indexFile,
+             BufMgr *bufMgrIn, const std::vector<KeyColumn> &keyColumns,
+             const RecordFeed &records, const double fillFactor,
+             const bool concurrent);
 
   /**
    * BTreeIndex Destructor.
@@ -511,7 +3123,10 @@ class BTreeIndex {
    *addition of new leaf page number entry into the parent non-leaf, which may
    *in-turn get split. This may continue all the way upto the root causing the
    *root to get split. If root gets split, metapage needs to be changed
-   *accordingly. Make sure to unpin pages as soon as you can.
+   *accordingly. Make sure to unpin pages as soon as you can. If the buffer
+   *manager has a log, the changed pages are committed to it as one group, so
+   *that recovery redoes all of the insertion or none of it; the same goes for
+   *insertBatch() and deleteEntry().
    * @param key			Key to insert, pointer to integer/double/char
    *string
    * @param rid			Record ID of a record whose entry is getting
@@ -519,6 +3134,115 @@ class BTreeIndex {
    **/
   const void insertEntry(const void *key, const RecordId rid);
 
+  /**
+   * Insert a batch of entries. The batch is sorted by key, and the entries
+   * that fall into the same leaf are inserted under one descent from the root,
+   * pinning each level once for the whole run rather than once per entry.
+   * Leaves are split as by insertEntry().
+   * @param keys		The n keys, stored one after another: n integers, n
+   *doubles, n strings of STRINGSIZE characters, or n composite keys
+   * @param rids		The record ids of the n entries
+   * @param n			Number of entries in the batch
+   **/
+  const void insertBatch(const void *keys, const RecordId *rids,
+                         const std::size_t n);
+
+  /**
+   * Delete the entry with the pair <value,rid>.
+   * Start from root to recursively find out the leaf holding the entry. A leaf
+   * left with too few entries is merged with a sibling, or refilled from it if
+   * they do not fit in one leaf, which may in turn leave the parent with too
+   * few keys, up to the root. A root left with a single child is replaced by
+   * it. Pages of merged nodes are reused by later insertions. Scans should be
+   * ended before deleting, since the leaf being scanned may be merged away.
+   * A concurrent index only removes the entry from its leaf.
+   * @param key			Key to delete, pointer to integer/double/char
+   *string
+   * @param rid			Record ID of the record whose entry is getting
+   *deleted from the index.
+   * @throws  NoSuchKeyFoundException If the index holds no such entry.
+   **/
+  const void deleteEntry(const void *key, const RecordId rid);
+
+  /**
+   * Find the entries with the given key, without setting up a scan. Finding
+   * no entry is not an error.
+   * @param key			Key to find, pointer to integer/double/char string
+   * @param outRids	Array the record ids of the entries are copied to
+   * @param maxRids	Number of record ids that fit in outRids
+   * @return the number of entries with the key, which may be more than
+   *         maxRids, in which case only the first maxRids are copied
+   **/
+  std::size_t lookup(const void *key, RecordId *outRids,
+                     const std::size_t maxRids);
+
+  /**
+   * Find the entries of each of n keys. The leaf of a key is kept pinned and
+   * the next key is looked for in it, without descending from the root, if
+   * the key falls within it, so keys given in ascending order are found with
+   * a descent per leaf rather than per key. Keys in any order are found.
+   * @param keys		The n keys, stored one after another: n integers, n
+   *doubles, n strings of STRINGSIZE characters, or n composite keys
+   * @param n			Number of keys
+   * @param outRids	Vector the record ids of the entries of each key are
+   *appended to, key after key
+   * @param outCounts	Vector the number of entries of each key is appended to
+   * @param maxRidsPerKey	Number of record ids of a key appended at most; the
+   *count of the key is the number of its entries all the same
+   **/
+  const void lookupMany(const void *keys, const std::size_t n,
+                        std::vector<RecordId> &outRids,
+                        std::vector<std::size_t> &outCounts,
+                        const std::size_t maxRidsPerKey = SIZE_MAX);
+
+  /**
+   * Open a filtered scan of the index in a cursor of its own, which may be
+   * open along with any number of other scans. The scan is set up as by
+   * startScan(), and its entries are fetched with IndexScanCursor::scanNext().
+   * @param lowVal	Low value of range, pointer to integer / double / char
+   *string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char
+   *string
+   * @param highOp	High operator (LT/LTE)
+   * @param hint    Access hint for the leaves read after the first one
+   * @param order   DESCENDING returns the entries from the high end of the
+   *                range down, reading only the leaves it returns from
+   * @param snapshot  If true, the scan returns the entries as they are when
+   *                it is opened, whatever is inserted or deleted while it is
+   *                open, also by other threads; the pages changed meanwhile
+   *                are copied for it before they are
+   * @return the cursor of the scan, holding its first leaf pinned unless it
+   *         is a snapshot scan
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of
+   *their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that
+   *satisfies the scan criteria.
+   **/
+  IndexScanCursor openScan(const void *lowVal, const Operator lowOp,
+                           const void *highVal, const Operator highOp,
+                           const AccessHint hint = NORMAL_ACCESS,
+                           const ScanOrder order = ASCENDING,
+                           const bool snapshot = false);
+
+  /**
+   * Open a scan from the first entry whose key is not less than the given
+   * key to the end of the index, or for a descending scan from the last entry
+   * whose key is not greater down to the start. This positions a cursor for
+   * pagination: it is given a limit for each page, and moved with
+   * IndexScanCursor::seek().
+   * @param key     Key the scan starts at, pointer to integer / double / char
+   *string, or a composite key
+   * @param hint    Access hint for the leaves read after the first one
+   * @param order   Order in which the entries are returned
+   * @return the cursor of the scan, holding its first leaf pinned
+   * @throws  NoSuchKeyFoundException If no key lies on that side of the key.
+   **/
+  IndexScanCursor openScanFrom(const void *key,
+                               const AccessHint hint = NORMAL_ACCESS,
+                               const ScanOrder order = ASCENDING);
+
   /**
    * Begin a filtered scan of the index.  For instance, if the method is called
    * using ("a",GT,"d",LTE) then we should seek all entries with a value
@@ -533,6 +3257,11 @@ class BTreeIndex {
    * @param highVal	High value of range, pointer to integer / double / char
    *string
    * @param highOp	High operator (LT/LTE)
+   * @param hint    Access hint for the leaves read after the first one;
+   *                SEQUENTIAL_ACCESS keeps a long scan from evicting the pool
+   * @param order   Order in which scanNext() returns the entries
+   * @param snapshot  If true, scanNext() returns the entries as they are now,
+   *                as with openScan()
    * @throws  BadOpcodesException If lowOp and highOp do not contain one of
    *their their expected values
    * @throws  BadScanrangeException If lowVal > highval
@@ -540,7 +3269,62 @@ class BTreeIndex {
    *satisfies the scan criteria.
    **/
   const void startScan(const void *lowVal, const Operator lowOp,
-                       const void *highVal, const Operator highOp);
+                       const void *highVal, const Operator highOp,
+                       const AccessHint hint = NORMAL_ACCESS,
+                       const ScanOrder order = ASCENDING,
+                       const bool snapshot = false);
+
+  /**
+   * Open a scan of the entries whose leading key columns lie in the given
+   * range, in a cursor of its own. The bounds hold the values of the first
+   * numColumns attributes of the keys, so that ((7), GTE, (7), LTE) over one
+   * column finds every key whose first attribute is 7, whatever the others.
+   * @param lowVal	Low values of range, stored one after another
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High values of range, stored one after another
+   * @param highOp	High operator (LT/LTE)
+   * @param numColumns	Number of leading attributes of the keys the bounds
+   *hold, from one to all of them
+   * @param hint    Access hint for the leaves read after the first one
+   * @param order   Order in which the entries are returned
+   * @return the cursor of the scan, holding its first leaf pinned
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of
+   *their their expected values
+   * @throws  BadScanrangeException If lowVal > highval, or if the keys have
+   *fewer than numColumns attributes
+   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that
+   *satisfies the scan criteria.
+   **/
+  IndexScanCursor openPrefixScan(const void *lowVal, const Operator lowOp,
+                                 const void *highVal, const Operator highOp,
+                                 const int numColumns,
+                                 const AccessHint hint = NORMAL_ACCESS,
+                                 const ScanOrder order = ASCENDING);
+
+  /**
+   * Begin a scan of the entries whose leading key columns lie in the given
+   * range, as by openPrefixScan(), whose entries are fetched by scanNext().
+   * If another scan is already executing, that is ended here.
+   * @param lowVal	Low values of range, stored one after another
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High values of range, stored one after another
+   * @param highOp	High operator (LT/LTE)
+   * @param numColumns	Number of leading attributes of the keys the bounds
+   *hold
+   * @param hint    Access hint for the leaves read after the first one
+   * @param order   Order in which scanNext() returns the entries
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of
+   *their their expected values
+   * @throws  BadScanrangeException If lowVal > highval, or if the keys have
+   *fewer than numColumns attributes
+   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that
+   *satisfies the scan criteria.
+   **/
+  const void startPrefixScan(const void *lowVal, const Operator lowOp,
+                             const void *highVal, const Operator highOp,
+                             const int numColumns,
+                             const AccessHint hint = NORMAL_ACCESS,
+                             const ScanOrder order = ASCENDING);
 
   /**
    * Fetch the record id of the next index entry that matches the scan.
@@ -550,11 +3334,51 @@ class BTreeIndex {
    *that are no longer required.
    * @param outRid	RecordId of next record found that satisfies the scan
    *criteria returned in this
+   * @param outColumns	If not NULL, the covered columns of the entry are
+   *copied here
    * @throws ScanNotInitializedException If no scan has been initialized.
    * @throws IndexScanCompletedException If no more records, satisfying the scan
    *criteria, are left to be scanned.
    **/
-  const void scanNext(RecordId &outRid);  // returned record id
+  const void scanNext(RecordId &outRid,
+                      char *outColumns = NULL);  // returned record id
+
+  /**
+   * Fetch the record ids of the next index entries that match the scan, up to
+   * maxRids of them. The entries of each leaf before the high end of the range
+   * are copied at once, and the end of the scan is reported by returning fewer
+   * than maxRids record ids instead of throwing.
+   * @param outRids	Array the record ids are copied to
+   * @param maxRids	Number of record ids that fit in outRids
+   * @param outColumns	If not NULL, the covered columns of the entries are
+   * copied here, one after another
+   * @param outKeys	If not NULL, the keys of the entries are copied here, one
+   * after another, in the form keys are passed to the index in
+   * @return the number of record ids copied; 0 once the scan is completed
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   **/
+  std::size_t scanNextBatch(RecordId *outRids, const std::size_t maxRids,
+                            char *outColumns = NULL, void *outKeys = NULL);
+
+  /**
+   * Append the record ids of all entries in the given range to outRids, in key
+   * order. Unlike startScan(), this may run while other threads insert and
+   * delete entries in a concurrent index: the entries of each leaf are read
+   * together, and an entry present for the whole call is returned once.
+   * @param lowVal	Low value of range, pointer to integer / double / char
+   *string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char
+   *string
+   * @param highOp	High operator (LT/LTE)
+   * @param outRids the vector the record ids are appended to
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of
+   *their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   **/
+  const void scanRange(const void *lowVal, const Operator lowOp,
+                       const void *highVal, const Operator highOp,
+                       std::vector<RecordId> &outRids);
 
   /**
    * Terminate the current scan. Unpin any pinned pages. Reset scan specific
@@ -562,5 +3386,121 @@ class BTreeIndex {
    * @throws ScanNotInitializedException If no scan has been initialized.
    **/
   const void endScan();
+
+  /**
+   * Compute the statistics of the index by reading every leaf, and the first
+   * page of every posting list. No entries should be inserted or deleted
+   * meanwhile.
+   * @return the height, the number of leaves, entries and distinct keys, and
+   *the fill factor of the leaves
+   **/
+  IndexStats getStats();
+
+  /**
+   * Returns the counts of the operations of the index since it was opened
+   * or clearCounters() was called.
+   **/
+  IndexCounters getCounters() const;
+
+  /**
+   * Reset the counts of the operations of the index.
+   **/
+  void clearCounters();
+
+  /**
+   * Analyze the shape of the index by reading every node: the nodes, keys
+   * and fill of each level, and how far the chain of leaves strays from the
+   * order of the index file. No entries should be inserted or deleted
+   * meanwhile.
+   * @return the analysis
+   **/
+  IndexAnalysis analyze();
+
+  /**
+   * Sets whether descents reach the resident children of the nodes kept
+   * pinned through slots the buffer manager keeps pointed at their frames,
+   * rather than look them up in the buffer manager. On by default.
+   *
+   * @param on whether descents follow the slots
+   */
+  void setSwizzling(bool on);
+
+  /**
+   * Sets whether the nodes kept pinned keep fence keys and a Bloom filter of
+   * each of their children that is a leaf, so that point lookups, and scans
+   * of ranges, that find nothing in the leaf they lead to end without reading
+   * it. On by default; the summaries take a byte per entry of the leaves
+   * summarized.
+   *
+   * @param on whether the leaves are summarized
+   */
+  void setLeafSummaries(bool on);
+
+  /**
+   * Sets how many inserts the index buffers before applying them to its
+   * leaves. Buffered inserts are sorted and applied together, a run of them
+   * per leaf, so that random inserts into an index larger than the buffer
+   * pool read and write each leaf once per batch rather than once per entry.
+   * Lookups see the pending inserts, and scans, statistics and the
+   * destructor apply them first. A concurrent index, or one whose buffer
+   * manager logs its changes, buffers none. Off, 0, by default.
+   *
+   * @param maxEntries the number of inserts buffered at most; 0 applies the
+   *        pending ones and turns buffering off
+   */
+  void setInsertBuffer(std::size_t maxEntries);
+
+  /**
+   * Apply the inserts the index buffers to its leaves.
+   */
+  void flushInsertBuffer();
+
+  /**
+   * Returns the attributes the keys of the index are built from, in order.
+   **/
+  std::vector<KeyColumn> getKeyColumns() const {
+    return std::vector<KeyColumn>(
+        indexMetaInfo.keyColumns,
+        indexMetaInfo.keyColumns + indexMetaInfo.numKeyColumns);
+  }
 };
+
+template <>
+int BTreeIndex::findArrayIndex<int>(const int *arr, int len, const int &key,
+                                    bool includeKey);
+
+// Leaves with STRING keys are prefix-compressed and have their own helpers.
+template <>
+bool BTreeIndex::isLeafNodeFull<StringKey>(LeafNode<StringKey> *node,
+                                           const StringKey &key);
+template <>
+int BTreeIndex::getLeafCapacity<StringKey>(LeafNode<StringKey> *node,
+                                           const StringKey &key);
+template <>
+int BTreeIndex::maxLeafCapacity<StringKey>();
+template <>
+StringKey BTreeIndex::getLeafKey<StringKey>(LeafNode<StringKey> *node, int i);
+template <>
+RecordId BTreeIndex::getLeafRid<StringKey>(LeafNode<StringKey> *node, int i);
+template <>
+int BTreeIndex::findScanIndexLeaf<StringKey>(LeafNode<StringKey> *node,
+                                             const StringKey &key,
+                                             bool includeKey);
+template <>
+void BTreeIndex::insertToLeafNode<StringKey>(LeafNode<StringKey> *node, int i,
+                                             const StringKey &key,
+                                             RecordId rid,
+                                             const char *columns);
+template <>
+void BTreeIndex::removeFromLeafNode<StringKey>(LeafNode<StringKey> *node,
+                                               int i);
+template <>
+void BTreeIndex::appendToLeafNode<StringKey>(LeafNode<StringKey> *node,
+                                             int len, const StringKey &key,
+                                             RecordId rid,
+                                             const char *columns);
+template <>
+void BTreeIndex::splitLeafNode<StringKey>(LeafNode<StringKey> *node,
+                                          LeafNode<StringKey> *newNode,
+                                          int index);
 }  // namespace badgerdb
@@ -5,8 +5,10 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <cstdlib>
 #include <memory>
 #include <iostream>
+#include <new>
 #include "buffer.h"
 #include "bufHashTbl.h"
 #include "exceptions/hash_already_present_exception.h"
@@ -15,90 +17,150 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File *file, const PageId pageNo) {
-  int tmp, value;
-  tmp = (long) file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+namespace {
+
+// rounds a number of buckets up to a power of two, with the shift that keeps
+// as many top bits of a 64-bit hash value
+void roundSize(int htSize, int &size, int &shift) {
+  size = 2;
+  shift = 63;
+  while (size < htSize) {
+    size <<= 1;
+    shift--;
+  }
+}
+
+// allocates a table with every bucket empty; calloc maps a large table
+// lazily, so it is not written over
+hashBucket *allocateBuckets(int size) {
+  void *table = std::calloc(size, sizeof(hashBucket));
+  if (table == NULL) throw std::bad_alloc();
+  return static_cast<hashBucket *>(table);
+}
+
 }
 
 BufHashTbl::BufHashTbl(int htSize)
-    : HTSIZE(htSize) {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket *[htSize];
-  for (int i = 0; i < HTSIZE; i++)
-    ht[i] = NULL;
+    : oldHt(NULL), OLDSIZE(0), OLDSHIFT(0), oldMigrated(0) {
+  roundSize(htSize, HTSIZE, HTSHIFT);
+
+  // allocate all buckets up front, marked empty
+  ht = allocateBuckets(HTSIZE);
 }
 
 BufHashTbl::~BufHashTbl() {
-  for (int i = 0; i < HTSIZE; i++) {
-    hashBucket *tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
+  std::free(ht);
+  std::free(oldHt);
+}
+
+bool BufHashTbl::put(const FileId fileId, const PageId pageNo,
+                     const FrameId frameNo) {
+  int index = hash(fileId, pageNo, HTSHIFT);
+
+  for (int probes = 0; probes < HTSIZE; probes++) {
+    hashBucket *tmpBuc = &ht[index];
+    if (tmpBuc->fileId == 0) {
+      tmpBuc->fileId = fileId;
+      tmpBuc->pageNo = pageNo;
+      tmpBuc->frameNo = frameNo;
+      return true;
     }
+    if (tmpBuc->fileId == fileId && tmpBuc->pageNo == pageNo) return false;
+    index = (index + 1) & (HTSIZE - 1);
   }
-  delete[] ht;
+
+  throw HashTableException();
 }
 
 void BufHashTbl::insert(const File *file, const PageId pageNo, const FrameId frameNo) {
-  int index = hash(file, pageNo);
-
-  hashBucket *tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-      throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
+  migrate(HT_MIGRATE_BUCKETS);
+  if (oldHt != NULL) {
+    const hashBucket &old =
+        oldHt[find(oldHt, OLDSIZE, OLDSHIFT, file->id(), pageNo)];
+    if (old.fileId != 0)
+      throw HashAlreadyPresentException(file->filename(), old.pageNo, old.frameNo);
   }
+  if (!put(file->id(), pageNo, frameNo)) {
+    FrameId present = 0;
+    lookup(file, pageNo, present);
+    throw HashAlreadyPresentException(file->filename(), pageNo, present);
+  }
+}
 
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
-    throw HashTableException();
-
-  tmpBuc->file = (File *) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+void BufHashTbl::remove(const File *file, const PageId pageNo) {
+  if (!remove(file->id(), pageNo))
+    throw HashNotFoundException(file->filename(), pageNo);
 }
 
-void BufHashTbl::lookup(const File *file, const PageId pageNo, FrameId &frameNo) {
-  int index = hash(file, pageNo);
-  hashBucket *tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo) {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
+bool BufHashTbl::remove(const FileId fileId, const PageId pageNo) {
+  migrate(HT_MIGRATE_BUCKETS);
+  int index = find(ht, HTSIZE, HTSHIFT, fileId, pageNo);
+  if (ht[index].fileId != 0) {
+    erase(ht, HTSIZE, HTSHIFT, index);
+    return true;
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  if (oldHt != NULL) {
+    index = find(oldHt, OLDSIZE, OLDSHIFT, fileId, pageNo);
+    if (oldHt[index].fileId != 0) {
+      erase(oldHt, OLDSIZE, OLDSHIFT, index);
+      return true;
+    }
+  }
+  return false;
 }
 
-void BufHashTbl::remove(const File *file, const PageId pageNo) {
+void BufHashTbl::erase(hashBucket *table, int size, int shift, int index) {
+  // shift back any following entry whose probe sequence passes through the
+  // freed bucket, so that lookups never stop early
+  int hole = index;
+  int next = (hole + 1) & (size - 1);
+  while (table[next].fileId != 0) {
+    int home = hash(table[next].fileId, table[next].pageNo, shift);
+    int distNext = (next - home) & (size - 1);
+    int distHole = (next - hole) & (size - 1);
+    if (distNext >= distHole) {
+      table[hole] = table[next];
+      hole = next;
+    }
+    next = (next + 1) & (size - 1);
+  }
+  table[hole].fileId = 0;
+}
 
-  int index = hash(file, pageNo);
-  hashBucket *tmpBuc = ht[index];
-  hashBucket *prevBuc = NULL;
-
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo) {
-      if (prevBuc)
-        prevBuc->next = tmpBuc->next;
-      else
-        ht[index] = tmpBuc->next;
-
-      delete tmpBuc;
-      return;
-    } else {
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
+void BufHashTbl::migrate(int buckets) {
+  if (oldHt == NULL) return;
+  // entries are only shifted back towards buckets not moved over yet, since
+  // those moved over stay empty
+  for (; buckets > 0 && oldMigrated < OLDSIZE; buckets--) {
+    hashBucket &bucket = oldHt[oldMigrated];
+    while (bucket.fileId != 0) {
+      put(bucket.fileId, bucket.pageNo, bucket.frameNo);
+      erase(oldHt, OLDSIZE, OLDSHIFT, oldMigrated);
     }
+    oldMigrated++;
+  }
+  if (oldMigrated == OLDSIZE) {
+    std::free(oldHt);
+    oldHt = NULL;
   }
+}
 
-  throw HashNotFoundException(file->filename(), pageNo);
+void BufHashTbl::resize(const int htSize) {
+  int size, shift;
+  roundSize(htSize, size, shift);
+  if (size <= HTSIZE) return;
+
+  // a resize still under way is finished first
+  migrate(OLDSIZE);
+  hashBucket *table = allocateBuckets(size);
+  oldHt = ht;
+  OLDSIZE = HTSIZE;
+  OLDSHIFT = HTSHIFT;
+  oldMigrated = 0;
+  ht = table;
+  HTSIZE = size;
+  HTSHIFT = shift;
 }
 
 }
@@ -7,18 +7,25 @@
 
 #pragma once
 
+#include <cstdint>
 #include "file.h"
 
 namespace badgerdb {
 
+/**
+* Number of buckets of the old table moved over by each insert and remove
+* while a hash table grows
+*/
+const int HT_MIGRATE_BUCKETS = 4;
+
 /**
 * @brief Declarations for buffer pool hash table
 */
 struct hashBucket {
   /**
-   * pointer a file object (more on this below)
+   * identifier of a file object, 0 if the bucket is empty
    */
-  File *file;
+  FileId fileId;
 
   /**
    * page number within a file
@@ -29,41 +36,104 @@ struct hashBucket {
    * frame number of page in the buffer pool
    */
   FrameId frameNo;
-
-  /**
-   * Next node in the hash table
-   */
-  hashBucket *next;
 };
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
+* The table uses open addressing with linear probing. All buckets are
+* allocated up front, so insert and remove never allocate memory, and removal
+* shifts later entries of the probe sequence back instead of leaving
+* tombstones.
+*
+* The table grows without a pause: resize() allocates the larger table, and
+* each insert and remove then moves the entries of HT_MIGRATE_BUCKETS buckets
+* of the old table over, lookups searching both tables meanwhile.
+*
 * @warning This class is not threadsafe.
 */
 class BufHashTbl {
  private:
   /**
-   *	Size of Hash Table
+   *	Size of Hash Table, always a power of two
    */
   int HTSIZE;
+  /**
+   * Shift that keeps the top log2(HTSIZE) bits of a 64-bit hash value
+   */
+  int HTSHIFT;
   /**
    * Actual Hash table object
    */
-  hashBucket **ht;
+  hashBucket *ht;
+
+  /**
+   * Table being moved over to ht after a resize, with its size and shift, or
+   * NULL; the buckets before oldMigrated are empty
+   */
+  hashBucket *oldHt;
+  int OLDSIZE;
+  int OLDSHIFT;
+  int oldMigrated;
 
   /**
-   * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+   * returns hash value between 0 and size-1 of a table computed using fileId
+   * and pageNo
    *
-   * @param file   	File object
+   * @param fileId 	Identifier of the file object
    * @param pageNo  Page number in the file
+   * @param shift   Shift of the table
    * @return  			Hash value.
    */
-  int hash(const File *file, const PageId pageNo);
+  static int hash(const FileId fileId, const PageId pageNo, int shift) {
+    // multiplicative hashing of the file and page numbers; the top bits of
+    // the product depend on every bit of the key, so neighbouring pages and
+    // files spread over the table
+    std::uint64_t value = (std::uint64_t) fileId << 32 | pageNo;
+    value *= 0x9e3779b97f4a7c15ULL;
+    return (int) (value >> shift);
+  }
+
+  /**
+   * Returns the bucket of (fileId, pageNo) in a table, or the empty bucket
+   * that ends its probe sequence.
+   */
+  static int find(const hashBucket *table, int size, int shift,
+                  const FileId fileId, const PageId pageNo) {
+    int index = hash(fileId, pageNo, shift);
+
+    // entries are never separated from their hash value by an empty bucket
+    while (table[index].fileId != 0 &&
+           !(table[index].fileId == fileId && table[index].pageNo == pageNo))
+      index = (index + 1) & (size - 1);
+    return index;
+  }
+
+  /**
+   * Inserts an entry into ht.
+   *
+   * @return  False if ht already has an entry for the page
+   * @throws  HashTableException if every bucket of the table is in use
+   */
+  bool put(const FileId fileId, const PageId pageNo, const FrameId frameNo);
+
+  /**
+   * Empties a bucket of a table, shifting back the entries after it.
+   */
+  static void erase(hashBucket *table, int size, int shift, int index);
+
+  /**
+   * Moves the entries of the given number of buckets of oldHt over to ht,
+   * and frees oldHt once it is empty.
+   */
+  void migrate(int buckets);
 
  public:
   /**
  * Constructor of BufHashTbl class
+   *
+   * @param htSize  Minimum number of buckets. Rounded up to a power of two; it
+   *                should be well above the number of entries ever stored.
    */
   BufHashTbl(const int htSize);  // constructor
 
@@ -79,7 +149,7 @@ class BufHashTbl {
    * @param pageNo 	Page number in the file
    * @param frameNo Frame number assigned to that page of the file
  * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
- * @throws  HashTableException (optional) if could not create a new bucket as running of memory
+ * @throws  HashTableException if every bucket of the table is in use
    */
   void insert(const File *file, const PageId pageNo, const FrameId frameNo);
 
@@ -89,10 +159,36 @@ class BufHashTbl {
    *
    * @param file  	File object
    * @param pageNo	Page number in the file
-   * @param frameNo Frame number reference
- * @throws HashNotFoundException if the page entry is not found in the hash table
+   * @param frameNo Frame number reference, set if the page is found
+   * @return  True if the page entry is found in the hash table
    */
-  void lookup(const File *file, const PageId pageNo, FrameId &frameNo);
+  bool lookup(const File *file, const PageId pageNo, FrameId &frameNo) const {
+    return lookup(file->id(), pageNo, frameNo);
+  }
+
+  /**
+   * Check if (fileId, pageNo) is in the hash table, without the file object,
+   * which may be gone.
+   *
+   * @param fileId  Identifier of the file object
+   * @param pageNo	Page number in the file
+   * @param frameNo Frame number reference, set if the page is found
+   * @return  True if the page entry is found in the hash table
+   */
+  bool lookup(const FileId fileId, const PageId pageNo,
+              FrameId &frameNo) const {
+    int index = find(ht, HTSIZE, HTSHIFT, fileId, pageNo);
+    if (ht[index].fileId != 0) {
+      frameNo = ht[index].frameNo; // return frameNo by reference
+      return true;
+    }
+    if (oldHt == NULL) return false;
+
+    index = find(oldHt, OLDSIZE, OLDSHIFT, fileId, pageNo);
+    if (oldHt[index].fileId == 0) return false;
+    frameNo = oldHt[index].frameNo;
+    return true;
+  }
 
   /**
  * Delete entry (file,pageNo) from hash table.
@@ -102,6 +198,35 @@ class BufHashTbl {
  * @throws HashNotFoundException if the page entry is not found in the hash table
    */
   void remove(const File *file, const PageId pageNo);
+
+  /**
+   * Delete entry (fileId, pageNo) from hash table, without the file object,
+   * which may be gone.
+   *
+   * @param fileId  Identifier of the file object
+   * @param pageNo  Page number in the file
+   * @return  False if the page entry is not found in the hash table
+   */
+  bool remove(const FileId fileId, const PageId pageNo);
+
+  /**
+   * Grows the table to the given number of buckets, rounded up to a power of
+   * two, moving the entries over a few at a time by later inserts and
+   * removes.  Does nothing if the table already has as many buckets.
+   *
+   * @param htSize  Minimum number of buckets
+   */
+  void resize(const int htSize);
+
+  /**
+   * Returns the number of buckets.
+   */
+  int size() const { return HTSIZE; }
+
+  /**
+   * Returns true while entries are still being moved over after a resize.
+   */
+  bool resizing() const { return oldHt != NULL; }
 };
 
 }
@@ -5,202 +5,1239 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <sys/mman.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
 #include <memory>
 #include <iostream>
+#include <new>
+#include <thread>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/corrupt_page_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "trace.h"
 
 namespace badgerdb {
 
+namespace {
+
+// number of the statistics shard the calling thread counts in
+std::uint32_t threadShard() {
+  static std::atomic<std::uint32_t> nextThread(0);
+  thread_local std::uint32_t shard = nextThread++ % BUF_STATS_SHARDS;
+  return shard;
+}
+
+// nanoseconds elapsed since the given time
+std::uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start).count();
+}
+
+// maps zeroed memory, backed by the system only where it is touched
+void *mapLazily(std::size_t length) {
+  void *region = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (region == MAP_FAILED) throw std::bad_alloc();
+  return region;
+}
+
+}
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-    : numBufs(bufs) {
-  bufDescTable = new BufDesc[bufs];
+BufMgr::BufMgr(std::uint32_t bufs, bool concurrent, ReplacementPolicy policy,
+               bool hugePages, std::uint32_t maxBufs,
+               const NumaTopology &numa)
+    : numBufs(bufs),
+      maxBufs(std::max<std::uint64_t>(
+          bufs, maxBufs != 0 ? maxBufs
+                             : std::min<std::uint64_t>(
+                                   (std::uint64_t)bufs * BUF_GROWTH_LIMIT,
+                                   UINT32_MAX / 2))),
+      initializedBufs(bufs), concurrent(concurrent), numa(numa),
+      statsShards(new StatsShard[numa.nodes() * BUF_STATS_SHARDS]),
+      flushedFiles(numa.nodes()), log(NULL), loggedImages(NULL) {
+  // the whole table is mapped, so that its entries never move
+  bufDescTable = static_cast<BufDesc *>(
+      mapLazily((std::size_t)this->maxBufs * sizeof(BufDesc)));
 
   for (FrameId i = 0; i < bufs; i++) {
+    new (&bufDescTable[i]) BufDesc();
     bufDescTable[i].frameNo = i;
     bufDescTable[i].valid = false;
   }
 
-  bufPool = new Page[bufs];
+  allocatePool(hugePages);
 
-  int htsize = ((((int) (bufs * 1.2)) * 2) / 2) + 1;
-  hashTable = new BufHashTbl(htsize);  // allocate the buffer hash table
+  // keep the open addressing tables at most half full, even if every frame
+  // hashes to the same partition
+  int htsize = 2 * bufs;
+  numPartitions = concurrent ? BUF_LATCH_PARTITIONS : 1;
+  partitions = new Partition[numPartitions];
+  for (std::uint32_t i = 0; i < numPartitions; i++)
+    partitions[i].hashTable = new BufHashTbl(htsize);  // allocate the buffer hash table
 
-  clockHand = bufs - 1;
+  replacer = Replacer::create(policy, bufs, this->maxBufs);
+  clearBufStats();
+
+  ringSize = std::max(1u, std::min(BUF_RING_SIZE, bufs / 8));
+  ringNext = 0;
+
+  prefetchDepth = 0;
+  stopPrefetchers = false;
+  checkpointRate = 0;
+  checkpointInterval = BUF_CHECKPOINT_INTERVAL;
+  stopCheckpointing = false;
+  checksumPolicy = CHECKSUM_ALWAYS;
+  checksumSample = BUF_CHECKSUM_SAMPLE;
+  checksumReads = 0;
+  pinTracking = false;
 }
 
 BufMgr::~BufMgr() {
+  stopCheckpointer();
+
+  // stop the read-ahead threads; requests still queued are dropped
+  {
+    std::unique_lock<std::mutex> lock(prefetchLatch);
+    stopPrefetchers = true;
+    prefetchReady.notify_all();
+  }
+  for (std::thread &prefetcher : prefetchers) prefetcher.join();
+
+  if (pinTracking && reportPins(std::cerr) > 0)
+    std::cerr << "Buffer manager destroyed with pages pinned" << std::endl;
+
   //Flush out all unwritten pages
   for (std::uint32_t i = 0; i < numBufs; i++) {
     BufDesc *tmpbuf = &bufDescTable[i];
     if (tmpbuf->valid == true && tmpbuf->dirty == true) {
-      tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+      writeFrame(i);
+    }
+  }
+
+  munmap(bufDescTable, (std::size_t)maxBufs * sizeof(BufDesc));
+  munmap(bufPool, poolLength);
+  if (loggedImages != NULL)
+    munmap(loggedImages, (std::size_t)maxBufs * Page::SIZE);
+  for (std::uint32_t i = 0; i < numPartitions; i++)
+    delete partitions[i].hashTable;
+  delete[] partitions;
+  delete replacer;
+}
+
+void BufMgr::allocatePool(bool hugePages) {
+  // the frames the pool may grow to are mapped up front, so that frames
+  // never move; those not in use take no memory
+  poolLength = (std::size_t)maxBufs * Page::SIZE;
+  if (hugePages) {
+    poolLength = (poolLength + BUF_POOL_ALIGNMENT - 1) / BUF_POOL_ALIGNMENT *
+                 BUF_POOL_ALIGNMENT;
+  }
+  void *region = MAP_FAILED;
+  if (hugePages) {
+    region = mmap(NULL, poolLength, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+  poolHugeTlb = region != MAP_FAILED;
+  if (region == MAP_FAILED) {
+    // map more than needed and trim it down to an aligned range
+    const std::size_t mapped = poolLength + BUF_POOL_ALIGNMENT;
+    char *start = static_cast<char *>(mapLazily(mapped));
+    char *aligned = start + (BUF_POOL_ALIGNMENT -
+                             reinterpret_cast<std::uintptr_t>(start) %
+                                 BUF_POOL_ALIGNMENT) % BUF_POOL_ALIGNMENT;
+    if (aligned > start) munmap(start, aligned - start);
+    munmap(aligned + poolLength, start + mapped - (aligned + poolLength));
+    region = aligned;
+    if (hugePages) madvise(region, poolLength, MADV_HUGEPAGE);
+  }
+  bufPool = static_cast<Page *>(region);
+
+  // the chunks are bound before any frame is touched, since memory is placed
+  // when first touched
+  if (numa.nodes() > 1) {
+    const std::size_t chunkLength = (std::size_t)NUMA_CHUNK_FRAMES * Page::SIZE;
+    for (std::size_t offset = 0; offset < poolLength; offset += chunkLength) {
+      numa.bindMemory(static_cast<char *>(region) + offset,
+                      std::min(chunkLength, poolLength - offset),
+                      frameNode(offset / Page::SIZE));
     }
   }
+  for (FrameId i = 0; i < numBufs; i++) new (&bufPool[i]) Page();
+}
+
+void BufMgr::claimFrame(FrameId frameNo) {
+  while (bufDescTable[frameNo].claimed.exchange(true))
+    std::this_thread::yield();
+}
+
+bool BufMgr::claimIfUnpinned(FrameId frameNo) {
+  BufDesc &desc = bufDescTable[frameNo];
+  if (desc.claimed.exchange(true)) return false;
+
+  // a victim() under way may offer a frame retired meanwhile
+  if (frameNo >= numBufs) {
+    desc.claimed = false;
+    return false;
+  }
 
-  delete[] bufDescTable;
-  delete[] bufPool;
+  // if invalid or not pinned, the frame can be used
+  if (!desc.valid || desc.pinCnt == 0) return true;
+  desc.claimed = false;
+  return false;
 }
 
 void BufMgr::allocBuf(FrameId &frame) {
-  // perform first part of clock algorithm to search for
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+  TRACE_SCOPE("allocBuf", "buffer", "frame", 0, "scanned", 0);
+  // the replacer offers frames in the order its policy prefers; frames
+  // claimed by other threads are skipped, so a frame is never handed out
+  // twice
+  const Replacer::Evictable evictable = [this](FrameId frameNo) {
+    return claimIfUnpinned(frameNo);
+  };
+
+  // a frame of the thread's own NUMA node is looked for first, then any,
+  // unless the pool is too small to have frames on that node
+  const std::uint32_t node = currentNode();
+  const Replacer::Evictable localEvictable = [this, node](FrameId frameNo) {
+    return frameNode(frameNo) == node && claimIfUnpinned(frameNo);
+  };
+  const bool local = numa.nodes() > 1 && numBufs > node * NUMA_CHUNK_FRAMES;
+
+  std::uint64_t sweepLength = 0;
+  for (int pass = local ? 0 : 1; pass < 2; pass++) {
+    for (std::uint32_t attempt = 0; attempt < numBufs; attempt++) {
+      FrameId hand;
+      std::uint32_t numScanned = 0;
+      const bool found = replacer->victim(
+          hand, pass == 0 ? localEvictable : evictable, numScanned);
+      sweepLength += numScanned;
+      if (!found) break;
+      if (evictClaimed(hand)) {
+        if (frameNode(hand) != node) count(REMOTE_ALLOCATIONS);
+        record(SWEEP_LENGTH, sweepLength);
+        TRACE_SET_ARG(0, hand);
+        TRACE_SET_ARG(1, sweepLength);
+        // return new frame number
+        frame = hand;
+        return;
+      }
+    }
+  }
 
-  while (numScanned < 2 * numBufs)    //Need to scn twice
+  // buffer pool is full
+  throw BufferExceededException();
+} // end allocBuf
+
+bool BufMgr::evictClaimed(FrameId frameNo) {
+  BufDesc &desc = bufDescTable[frameNo];
+
+  // if invalid, use frame
+  if (!desc.valid) {
+    desc.Clear();
+    return true;
+  }
+
+  // changes that may still be part of an unfinished group are not written,
+  // since redo only restores committed ones
+  if (log != NULL && desc.dirty && desc.pageLsn > log->committedLsn()) {
+    desc.claimed = false;
+    return false;
+  }
+
+  // flush any existing changes to disk if necessary.  The bit is cleared
+  // first so that a writer pinning the page meanwhile leaves it dirty.
+  const bool wasDirty = desc.dirty.exchange(false);
+  if (wasDirty) {
+    count(DISK_WRITES);
+    try {
+      writeFrame(frameNo);
+    } catch (...) {
+      desc.dirty = true;
+      desc.claimed = false;
+      throw;
+    }
+  }
+
+  // not pinned, use it unless it was pinned or written to while being flushed
+  bool evicted = false;
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    Partition &partition = partitionOf(desc.fileId, desc.pageNo);
+    std::unique_lock<std::mutex> lock = latch(partition);
+    if (desc.pinCnt == 0 && !desc.dirty) {
+      // remove previous entry from hash table
+      partition.hashTable->remove(desc.fileId, desc.pageNo);
+      evicted = true;
+    }
+  }
+  if (!evicted) {
+    desc.claimed = false;
+    return false;
+  }
+  if (desc.prefetched) count(PREFETCH_WASTED);
+  count(wasDirty ? DIRTY_EVICTIONS : CLEAN_EVICTIONS);
+  TRACE_EVENT("evict", "buffer", "page", desc.pageNo, "dirty", wasDirty);
+  replacer->recordEvict(frameNo, desc.file, desc.pageNo);
 
-    // if invalid, use frame
-    if (!bufDescTable[clockHand].valid) {
-      break;
+  //Reset all the BufDesc entry for the frame before returning the frame
+  desc.Clear();
+  return true;
+}
+
+void BufMgr::allocRingBuf(FrameId &frame) {
+  FrameId candidate = 0;
+  bool full;
+  {
+    std::unique_lock<std::mutex> lock(ringLatch, std::defer_lock);
+    if (concurrent) lock.lock();
+    full = ring.size() == ringSize;
+    if (full) {
+      candidate = ring[ringNext];
+      ringNext = (ringNext + 1) % ringSize;
     }
+  }
 
-    // is valid, check referenced bit
-    if (!bufDescTable[clockHand].refbit) {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0) {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
-      }
-    } else {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+  // the ringed bit is checked again once the frame is claimed, since a
+  // normal request may have taken the page over meanwhile
+  if (full && bufDescTable[candidate].ringed && claimIfUnpinned(candidate)) {
+    if (!bufDescTable[candidate].ringed) {
+      bufDescTable[candidate].claimed = false;
+    } else if (evictClaimed(candidate)) {
+      frame = candidate;
+      return;
     }
   }
 
-  // check for full buffer pool
-  if (!found && numScanned >= 2 * numBufs) {
-    throw BufferExceededException();
+  allocBuf(frame);
+
+  // the new frame replaces the candidate in the ring
+  std::unique_lock<std::mutex> lock(ringLatch, std::defer_lock);
+  if (concurrent) lock.lock();
+  if (ring.size() < ringSize)
+    ring.push_back(frame);
+  else
+    ring[(ringNext + ringSize - 1) % ringSize] = frame;
+}
+
+bool BufMgr::pinResident(File *file, const PageId pageNo, FrameId &frameNo,
+                         AccessHint hint) {
+  {
+    // only the waits for a latch held by another thread are timed
+    Partition &partition = partitionOf(file->id(), pageNo);
+    std::unique_lock<std::mutex> lock(partition.latch, std::defer_lock);
+    if (concurrent && !lock.try_lock()) {
+      const auto start = std::chrono::steady_clock::now();
+      lock.lock();
+      record(PIN_WAIT, nanosSince(start));
+    }
+    if (!partition.hashTable->lookup(file, pageNo, frameNo)) return false;
+
+    bufDescTable[frameNo].pinCnt++;
   }
 
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty) {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+  BufDesc &desc = bufDescTable[frameNo];
+  if (desc.loading) {
+    const auto start = std::chrono::steady_clock::now();
+    while (desc.loading) std::this_thread::yield();
+    record(PIN_WAIT, nanosSince(start));
+  }
+  if (!desc.valid) {
+    // the read failed, so the frame was dropped from the hash table
+    desc.pinCnt--;
+    return pinResident(file, pageNo, frameNo, hint);
   }
+  if (hint == NORMAL_ACCESS) {
+    replacer->recordHit(frameNo);
+    desc.ringed = false;
+  }
+  return true;
+}
 
-  //Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+bool BufMgr::loadPage(File *file, const PageId pageNo, AccessHint hint,
+                      FrameId &frameNo, bool prefetch) {
+  //not in the buffer pool, must allocate a new page
+  // alloc a new frame
+  if (hint == SEQUENTIAL_ACCESS)
+    allocRingBuf(frameNo);
+  else
+    allocBuf(frameNo);
+  BufDesc &desc = bufDescTable[frameNo];
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
+  {
+    Partition &partition = partitionOf(file->id(), pageNo);
+    std::unique_lock<std::mutex> lock = latch(partition);
+    FrameId residentFrameNo;
+    if (partition.hashTable->lookup(file, pageNo, residentFrameNo)) {
+      // another thread read the page in while we were looking for a frame
+      desc.claimed = false;
+      return false;
+    }
+
+    // set up the entry properly and insert it in the hash table, so that
+    // other readers of the page wait for it rather than reading it again
+    desc.Set(file, pageNo);
+    desc.loading = true;
+    partition.hashTable->insert(file, pageNo, frameNo);
+  }
+
+  // read the page into the new frame
+  count(DISK_READS);
+  if (prefetch) count(PREFETCHES);
+  try {
+    const auto start = std::chrono::steady_clock::now();
+    file->readPage(pageNo, bufPool[frameNo]);
+    record(READ_LATENCY, nanosSince(start));
+    verifyLoaded(frameNo);
+  } catch (...) {
+    abandonLoad(frameNo);
+    throw;
+  }
+  replacer->recordLoad(frameNo, file, pageNo);
+  desc.ringed = hint == SEQUENTIAL_ACCESS;
+  desc.prefetched = prefetch;
+  desc.loading = false;
+  desc.claimed = false;
+  return true;
+}
+
+void BufMgr::verifyLoaded(FrameId frameNo) {
+  const ChecksumPolicy policy = checksumPolicy;
+  if (policy == CHECKSUM_ALWAYS ||
+      (policy == CHECKSUM_SAMPLED &&
+       checksumReads++ % checksumSample == 0)) {
+    count(CHECKSUMS_VERIFIED);
+    if (!bufPool[frameNo].verifyChecksum()) {
+      count(CHECKSUM_FAILURES);
+      const BufDesc &desc = bufDescTable[frameNo];
+      throw CorruptPageException(desc.pageNo, desc.file->filename());
+    }
+  }
+}
 
+void BufMgr::abandonLoad(FrameId frameNo) {
+  BufDesc &desc = bufDescTable[frameNo];
+  {
+    Partition &partition = partitionOf(desc.fileId, desc.pageNo);
+    std::unique_lock<std::mutex> lock = latch(partition);
+    partition.hashTable->remove(desc.fileId, desc.pageNo);
+    desc.valid = false;
+  }
+  desc.loading = false;
+  // wait for the readers that pinned the page meanwhile to give up
+  while (desc.pinCnt > 1) std::this_thread::yield();
+  desc.Clear();
+  replacer->recordFree(frameNo);
+  desc.claimed = false;
+}
 
-void BufMgr::readPage(File *file, const PageId pageNo, Page *&page) {
+void BufMgr::readPage(File *file, const PageId pageNo, Page *&page,
+                      AccessHint hint, const PinSite &site) {
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
+  TRACE_SCOPE("readPage", "buffer", "page", pageNo, "hit", 1);
   FrameId frameNo = 0;
-  try {
-    hashTable->lookup(file, pageNo, frameNo);
+  while (true) {
+    if (pinResident(file, pageNo, frameNo, hint)) {
+      countAccess(file, frameNo, true);
+      if (bufDescTable[frameNo].prefetched.exchange(false))
+        count(PREFETCH_HITS);
+      break;
+    }
+    if (loadPage(file, pageNo, hint, frameNo, false)) {
+      countAccess(file, frameNo, false);
+      TRACE_SET_ARG(1, 0);
+      break;
+    }
+  }
+  trackPin(frameNo, site);
+  page = &bufPool[frameNo];
+}
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+PageHandle BufMgr::pin(File *file, const PageId pageNo, AccessHint hint,
+                       const PinSite &site) {
+  Page *page;
+  readPage(file, pageNo, page, hint, site);
+  return PageHandle(this, page);
+}
+
+PageHandle BufMgr::pinNew(File *file, PageId &pageNo, const PinSite &site) {
+  Page *page;
+  allocPage(file, pageNo, page, site);
+  return PageHandle(this, page);
+}
+
+void BufMgr::setPrefetchDepth(std::uint32_t depth) {
+  if (!concurrent) return;
+  prefetchDepth = depth;
+
+  // the ring must hold the page being scanned and the pages read ahead of it,
+  // with room for the read-ahead to run late
+  std::unique_lock<std::mutex> lock(ringLatch);
+  ringSize = std::max(ringSize, std::min(2 * depth + 2, std::max(1u, numBufs / 2)));
+}
+
+void BufMgr::setChecksumPolicy(ChecksumPolicy policy, std::uint32_t sample) {
+  checksumSample = std::max(1u, sample);
+  checksumPolicy = policy;
+}
+
+void BufMgr::prefetch(File *file, const PageId pageNo, NextPageFn next,
+                      AccessHint hint) {
+  if (prefetchDepth == 0 || pageNo == Page::INVALID_NUMBER) return;
+
+  std::unique_lock<std::mutex> lock(prefetchLatch);
+  if (prefetchers.empty()) {
+    for (std::uint32_t i = 0; i < BUF_PREFETCH_THREADS; i++)
+      prefetchers.emplace_back(&BufMgr::runPrefetcher, this);
   }
-  catch (HashNotFoundException e) //not in the buffer pool, must allocate a new page
-  {
-    // alloc a new frame
-    allocBuf(frameNo);
+  // a queued request for the file has fallen behind the scan making this one,
+  // so it is moved up rather than served as it is
+  for (PrefetchRequest &request : prefetchQueue) {
+    if (request.file == file && request.next == next) {
+      request.pageNo = pageNo;
+      request.hint = hint;
+      return;
+    }
+  }
+  // drop the request rather than fall further behind the scans
+  if (prefetchQueue.size() >= BUF_PREFETCH_QUEUE_SIZE) return;
+  prefetchQueue.push_back({file, pageNo, next, hint});
+  prefetchReady.notify_one();
+}
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+void BufMgr::prefetchPages(File *file, const std::vector<PageId> &pageNos) {
+  // a batch holds its frames claimed, so it takes at most half of the pool
+  const std::size_t batchSize =
+      std::max<std::size_t>(1, std::min<std::size_t>(BUF_IO_BATCH,
+                                                      numBufs / 2));
+  std::size_t next = 0;
+  while (next < pageNos.size()) {
+    std::vector<FrameId> frameNos;
+    std::vector<PageId> batchPageNos;
+    std::vector<Page *> pages;
+    try {
+      while (next < pageNos.size() && frameNos.size() < batchSize) {
+        const PageId pageNo = pageNos[next++];
+        if (pageNo == Page::INVALID_NUMBER) continue;
+        Partition &partition = partitionOf(file->id(), pageNo);
+        FrameId frameNo;
+        {
+          std::unique_lock<std::mutex> lock = latch(partition);
+          if (partition.hashTable->lookup(file, pageNo, frameNo)) continue;
+        }
+        allocBuf(frameNo);
+        BufDesc &desc = bufDescTable[frameNo];
+        {
+          // the page may have been read in meanwhile, or be in the batch
+          // twice
+          FrameId residentFrameNo;
+          std::unique_lock<std::mutex> lock = latch(partition);
+          if (partition.hashTable->lookup(file, pageNo, residentFrameNo)) {
+            desc.claimed = false;
+            continue;
+          }
+          desc.Set(file, pageNo);
+          desc.loading = true;
+          partition.hashTable->insert(file, pageNo, frameNo);
+        }
+        frameNos.push_back(frameNo);
+        batchPageNos.push_back(pageNo);
+        pages.push_back(&bufPool[frameNo]);
+      }
+      if (frameNos.empty()) continue;
+      count(DISK_READS, frameNos.size());
+      count(PREFETCHES, frameNos.size());
+      const auto start = std::chrono::steady_clock::now();
+      file->readPages(batchPageNos, pages);
+      record(READ_LATENCY, nanosSince(start));
+    } catch (...) {
+      for (FrameId frameNo : frameNos) abandonLoad(frameNo);
+      throw;
+    }
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+    for (FrameId frameNo : frameNos) {
+      BufDesc &desc = bufDescTable[frameNo];
+      try {
+        verifyLoaded(frameNo);
+      } catch (const CorruptPageException &) {
+        abandonLoad(frameNo);
+        continue;
+      }
+      replacer->recordLoad(frameNo, file, desc.pageNo);
+      desc.ringed = false;
+      desc.prefetched = true;
+      {
+        Partition &partition = partitionOf(file->id(), desc.pageNo);
+        std::unique_lock<std::mutex> lock = latch(partition);
+        desc.pinCnt--;
+      }
+      desc.loading = false;
+      desc.claimed = false;
+    }
+  }
+}
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+void BufMgr::runPrefetcher() {
+  std::unique_lock<std::mutex> lock(prefetchLatch);
+  while (true) {
+    prefetchReady.wait(lock, [this]() {
+      return stopPrefetchers || !prefetchQueue.empty();
+    });
+    if (stopPrefetchers) return;
+    PrefetchRequest request = prefetchQueue.front();
+    prefetchQueue.pop_front();
+    prefetchFiles.insert(request.file);
+    lock.unlock();
+
+    // walk the chain, reading in the pages that are not resident yet.  Each
+    // page is pinned while the next page number is taken from it.
+    PageId pageNo = request.pageNo;
+    for (std::uint32_t n = 0;
+         n < prefetchDepth && pageNo != Page::INVALID_NUMBER; n++) {
+      FrameId frameNo = 0;
+      try {
+        while (!pinResident(request.file, pageNo, frameNo, SEQUENTIAL_ACCESS))
+          if (loadPage(request.file, pageNo, request.hint, frameNo, true))
+            break;
+      } catch (...) {
+        // read-ahead is only a hint; the scan will run into the error itself
+        break;
+      }
+      const PageId nextPageNo = request.next(bufPool[frameNo]);
+      {
+        Partition &partition = partitionOf(request.file->id(), pageNo);
+        std::unique_lock<std::mutex> pinLock = latch(partition);
+        bufDescTable[frameNo].pinCnt--;
+      }
+      pageNo = nextPageNo;
+    }
+
+    lock.lock();
+    prefetchFiles.erase(prefetchFiles.find(request.file));
+    prefetchIdle.notify_all();
   }
 }
 
+void BufMgr::drainPrefetches(const File *file) {
+  std::unique_lock<std::mutex> lock(prefetchLatch);
+  for (auto it = prefetchQueue.begin(); it != prefetchQueue.end();) {
+    if (it->file == file)
+      it = prefetchQueue.erase(it);
+    else
+      ++it;
+  }
+  prefetchIdle.wait(lock, [this, file]() {
+    return prefetchFiles.find(file) == prefetchFiles.end();
+  });
+}
+
 void BufMgr::unPinPage(File *file, const PageId pageNo,
                        const bool dirty) {
   // lookup in hashtable
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  Partition &partition = partitionOf(file->id(), pageNo);
+  std::unique_lock<std::mutex> lock = latch(partition);
+  if (!partition.hashTable->lookup(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
 
   if (dirty == true) bufDescTable[frameNo].dirty = dirty;
 
   // make sure the page is actually pinned
   if (bufDescTable[frameNo].pinCnt == 0) {
     throw PageNotPinnedException(file->filename(), pageNo, frameNo);
-  } else bufDescTable[frameNo].pinCnt--;
+  }
+  if (dirty && log != NULL) logChanges(frameNo);
+  untrackPin(frameNo);
+  bufDescTable[frameNo].pinCnt--;
+  TRACE_EVENT("unPinPage", "buffer", "page", pageNo, "dirty", dirty);
+}
+
+void BufMgr::unPinPage(Page *page, const bool dirty) {
+  const FrameId frameNo = page - bufPool;
+  BufDesc &desc = bufDescTable[frameNo];
+  Partition &partition = partitionOf(desc.fileId, desc.pageNo);
+  std::unique_lock<std::mutex> lock = latch(partition);
+  if (desc.pinCnt == 0) {
+    throw PageNotPinnedException(desc.file->filename(), desc.pageNo, frameNo);
+  }
+
+  if (dirty == true) desc.dirty = dirty;
+  if (dirty && log != NULL) logChanges(frameNo);
+  untrackPin(frameNo);
+  desc.pinCnt--;
+  TRACE_EVENT("unPinPage", "buffer", "page", desc.pageNo, "dirty", dirty);
+}
+
+bool BufMgr::swizzle(Page *page, Page **slot) {
+  if (concurrent) return false;
+  BufDesc &desc = bufDescTable[page - bufPool];
+  if (desc.swizzledFrom != NULL) *desc.swizzledFrom = NULL;
+  desc.swizzledFrom = slot;
+  *slot = page;
+  return true;
+}
+
+void BufMgr::unswizzle(Page **slot) {
+  if (*slot == NULL) return;
+  bufDescTable[*slot - bufPool].swizzledFrom = NULL;
+  *slot = NULL;
+}
+
+void BufMgr::pinSwizzled(Page *page, const PinSite &site) {
+  const FrameId frameNo = page - bufPool;
+  countAccess(bufDescTable[frameNo].file, frameNo, true);
+  bufDescTable[frameNo].pinCnt++;
+  trackPin(frameNo, site);
+  replacer->recordHit(frameNo);
+  bufDescTable[frameNo].ringed = false;
+}
+
+void BufMgr::logChanges(FrameId frameNo) {
+  BufDesc &desc = bufDescTable[frameNo];
+  if (!log->isLogged(desc.file)) return;
+  const char *image = reinterpret_cast<const char *>(&bufPool[frameNo]);
+  char *logged = loggedImages + (std::size_t)frameNo * Page::SIZE;
+  const Lsn lsn = log->logPage(desc.file, desc.pageNo, image,
+                               desc.imaged ? logged : NULL);
+  if (lsn == 0) return;
+  memcpy(logged, image, Page::SIZE);
+  desc.imaged = true;
+  desc.pageLsn = lsn;
+  if (desc.recLsn == 0) desc.recLsn = lsn;
+}
+
+void BufMgr::writeFrame(FrameId frameNo) {
+  BufDesc &desc = bufDescTable[frameNo];
+  // the records of the page reach disk before the page does
+  if (log != NULL && desc.pageLsn > 0) log->flush(desc.pageLsn);
+  const auto start = std::chrono::steady_clock::now();
+  desc.file->writePage(desc.pageNo, bufPool[frameNo]);
+  record(WRITE_LATENCY, nanosSince(start));
+}
+
+void BufMgr::writeFrames(const std::vector<FrameId> &frameNos) {
+  if (frameNos.empty()) return;
+  File *file = bufDescTable[frameNos[0]].file;
+  std::vector<PageId> pageNos;
+  std::vector<const Page *> pages;
+  Lsn pageLsn = 0;
+  for (FrameId frameNo : frameNos) {
+    const BufDesc &desc = bufDescTable[frameNo];
+    pageLsn = std::max<Lsn>(pageLsn, desc.pageLsn);
+    pageNos.push_back(desc.pageNo);
+    pages.push_back(&bufPool[frameNo]);
+  }
+  // the records of the pages reach disk before the pages do
+  if (log != NULL && pageLsn > 0) log->flush(pageLsn);
+  const auto start = std::chrono::steady_clock::now();
+  file->writePages(pageNos, pages);
+  record(WRITE_LATENCY, nanosSince(start));
+}
+
+void BufMgr::dropFrame(FrameId frameNo) {
+  BufDesc &desc = bufDescTable[frameNo];
+  {
+    Partition &partition = partitionOf(desc.fileId, desc.pageNo);
+    std::unique_lock<std::mutex> lock = latch(partition);
+    partition.hashTable->remove(desc.fileId, desc.pageNo);
+  }
+  if (desc.prefetched) count(PREFETCH_WASTED);
+  desc.Clear();
+  replacer->recordFree(frameNo);
+}
+
+void BufMgr::setLog(LogManager *logIn) {
+  log = logIn;
+  if (log != NULL && loggedImages == NULL) {
+    loggedImages = static_cast<char *>(
+        mapLazily((std::size_t)maxBufs * Page::SIZE));
+  }
+}
+
+void BufMgr::checkpoint() {
+  if (log == NULL) return;
+  const Lsn startLsn = log->endLsn();
+  std::vector<FrameId> frameNos;
+  const std::uint32_t frames = numBufs;
+  for (FrameId i = 0; i < frames; i++) {
+    const BufDesc &desc = bufDescTable[i];
+    if (desc.valid && desc.dirty) frameNos.push_back(i);
+    if (frameNos.size() == BUF_IO_BATCH || i + 1 == frames) {
+      checkpointFrames(frameNos);
+      frameNos.clear();
+    }
+  }
+  retryCheckpoint(startLsn);
+  finishCheckpoint();
+}
+
+std::uint32_t BufMgr::checkpointFrames(const std::vector<FrameId> &frameNos) {
+  std::vector<FrameId> taken;
+  std::vector<Lsn> recLsns;
+  std::unique_ptr<Page[]> images(new Page[frameNos.size()]);
+  Lsn pageLsn = 0;
+  for (FrameId frameNo : frameNos) {
+    BufDesc &desc = bufDescTable[frameNo];
+    if (!desc.valid || !desc.dirty) continue;
+    if (desc.claimed.exchange(true)) continue;
+
+    bool write = false;
+    if (desc.valid && desc.dirty && log->isLogged(desc.file)) {
+      // pins are only taken under the latch, so the page does not change
+      // while it is copied; changes not committed yet are not written
+      Partition &partition = partitionOf(desc.fileId, desc.pageNo);
+      std::unique_lock<std::mutex> lock = latch(partition);
+      if (desc.pinCnt == 0 && desc.pageLsn <= log->committedLsn()) {
+        images[taken.size()] = bufPool[frameNo];
+        pageLsn = std::max<Lsn>(pageLsn, desc.pageLsn);
+        recLsns.push_back(desc.recLsn);
+        // the next change is logged whole, in case the write is torn
+        desc.dirty = false;
+        desc.imaged = false;
+        desc.recLsn = 0;
+        write = true;
+      }
+    }
+    // the frames written stay claimed until their pages are on disk
+    if (write)
+      taken.push_back(frameNo);
+    else
+      desc.claimed = false;
+  }
+  if (taken.empty()) return 0;
+
+  // the pages of each file are written together, in the order of the file
+  std::vector<std::size_t> order(taken.size());
+  for (std::size_t k = 0; k < order.size(); k++) order[k] = k;
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    const BufDesc &descA = bufDescTable[taken[a]];
+    const BufDesc &descB = bufDescTable[taken[b]];
+    if (descA.file != descB.file) return descA.file < descB.file;
+    return descA.pageNo < descB.pageNo;
+  });
+  count(DISK_WRITES, taken.size());
+  std::size_t written = 0;
+  try {
+    if (pageLsn > 0) log->flush(pageLsn);
+    while (written < order.size()) {
+      File *file = bufDescTable[taken[order[written]]].file;
+      std::vector<PageId> pageNos;
+      std::vector<const Page *> pages;
+      std::size_t end = written;
+      for (; end < order.size() &&
+             bufDescTable[taken[order[end]]].file == file; end++) {
+        pageNos.push_back(bufDescTable[taken[order[end]]].pageNo);
+        pages.push_back(&images[order[end]]);
+      }
+      const auto start = std::chrono::steady_clock::now();
+      file->writePages(pageNos, pages);
+      record(WRITE_LATENCY, nanosSince(start));
+      for (; written < end; written++)
+        bufDescTable[taken[order[written]]].claimed = false;
+    }
+  } catch (...) {
+    for (; written < order.size(); written++) {
+      BufDesc &desc = bufDescTable[taken[order[written]]];
+      desc.dirty = true;
+      desc.recLsn = recLsns[order[written]];
+      desc.claimed = false;
+    }
+    throw;
+  }
+  return taken.size();
+}
+
+void BufMgr::retryCheckpoint(Lsn startLsn) {
+  if (!concurrent) return;
+  for (std::uint32_t attempt = 0; attempt < BUF_CHECKPOINT_RETRIES; attempt++) {
+    bool skipped = false;
+    for (FrameId i = 0; i < numBufs; i++) {
+      BufDesc &desc = bufDescTable[i];
+      const Lsn recLsn = desc.recLsn;
+      if (!desc.valid || !desc.dirty || recLsn == 0 || recLsn >= startLsn)
+        continue;
+      if (!checkpointFrame(i)) skipped = true;
+    }
+    if (!skipped) return;
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+void BufMgr::finishCheckpoint() {
+  // records appended from now on are kept; so are those of the pages still
+  // dirty, from the first one holding the whole page.  Claiming each frame
+  // waits for a page being written out by another thread.
+  Lsn redoLsn = log->endLsn();
+  for (FrameId i = 0; i < numBufs; i++) {
+    BufDesc &desc = bufDescTable[i];
+    claimFrame(i);
+    const Lsn recLsn = desc.recLsn;
+    if (desc.valid && desc.dirty && recLsn > 0)
+      redoLsn = std::min(redoLsn, recLsn);
+    desc.claimed = false;
+  }
+  // pages written out by evictions are forced to disk before their records
+  // are dropped
+  log->syncFiles();
+  log->checkpoint(redoLsn);
+}
+
+void BufMgr::startCheckpointer(std::uint32_t pagesPerSecond,
+                               std::uint32_t interval) {
+  if (!concurrent || log == NULL || pagesPerSecond == 0) return;
+  std::unique_lock<std::mutex> lock(checkpointLatch);
+  checkpointRate = pagesPerSecond;
+  checkpointInterval = interval;
+  if (!checkpointer.joinable())
+    checkpointer = std::thread(&BufMgr::runCheckpointer, this);
+}
+
+void BufMgr::stopCheckpointer() {
+  {
+    std::unique_lock<std::mutex> lock(checkpointLatch);
+    if (!checkpointer.joinable()) return;
+    stopCheckpointing = true;
+    checkpointWake.notify_all();
+  }
+  checkpointer.join();
+  stopCheckpointing = false;
+}
+
+void BufMgr::runCheckpointer() {
+  std::unique_lock<std::mutex> lock(checkpointLatch);
+  while (!stopCheckpointing) {
+    // the pages of a pass are written no sooner than the rate allows
+    const auto start = std::chrono::steady_clock::now();
+    const Lsn startLsn = log->endLsn();
+    std::uint64_t written = 0;
+    for (FrameId i = 0; i < numBufs && !stopCheckpointing; i++) {
+      lock.unlock();
+      bool wrote = false;
+      try {
+        wrote = checkpointFrame(i);
+      } catch (...) {
+        // the page is tried again on the next pass
+      }
+      lock.lock();
+      if (!wrote) continue;
+      written++;
+      const std::chrono::duration<double> due((double)written / checkpointRate);
+      checkpointWake.wait_until(
+          lock, start + std::chrono::duration_cast<
+                            std::chrono::steady_clock::duration>(due),
+          [this]() { return stopCheckpointing; });
+    }
+    if (stopCheckpointing) break;
+    lock.unlock();
+    try {
+      retryCheckpoint(startLsn);
+      finishCheckpoint();
+    } catch (...) {
+      // the log keeps its segments until the next pass
+    }
+    lock.lock();
+    checkpointWake.wait_until(
+        lock, start + std::chrono::milliseconds(checkpointInterval),
+        [this]() { return stopCheckpointing; });
+  }
 }
 
 void BufMgr::flushFile(const File *file) {
+  // no read-ahead of the file may be left running once it has been flushed
+  drainPrefetches(file);
+
+  // the counts of the file are kept by name, since its File object may be
+  // closed and another opened at the same address
+  {
+    std::lock_guard<std::mutex> guard(statsLatch);
+    for (std::uint32_t i = 0; i < numa.nodes() * BUF_STATS_SHARDS; i++) {
+      StatsShard &shard = statsShards[i];
+      std::unique_lock<std::mutex> lock(shard.fileLatch, std::defer_lock);
+      if (concurrent) lock.lock();
+      auto entry = shard.files.find(file);
+      if (entry == shard.files.end()) continue;
+      FileStats &flushed =
+          flushedFiles[i / BUF_STATS_SHARDS][entry->second.name];
+      flushed.hits += entry->second.stats.hits;
+      flushed.misses += entry->second.stats.misses;
+      shard.files.erase(entry);
+      if (shard.lastFile == file) shard.lastFile = NULL;
+    }
+  }
+
+  // dirty frames stay claimed until their batch is written, then are
+  // dropped with it
+  std::vector<FrameId> batch;
+  auto releaseBatch = [&]() {
+    for (FrameId frameNo : batch) bufDescTable[frameNo].claimed = false;
+    batch.clear();
+  };
+  auto writeBatch = [&]() {
+    try {
+      writeFrames(batch);
+    } catch (...) {
+      releaseBatch();
+      throw;
+    }
+    for (FrameId frameNo : batch) {
+      bufDescTable[frameNo].dirty = false;
+      dropFrame(frameNo);
+    }
+    releaseBatch();
+  };
+
   for (std::uint32_t i = 0; i < numBufs; i++) {
     BufDesc *tmpbuf = &(bufDescTable[i]);
+    claimFrame(i);
     if (tmpbuf->valid == true && tmpbuf->file == file) {
-      if (tmpbuf->pinCnt > 0)
+      if (tmpbuf->pinCnt > 0) {
+        tmpbuf->claimed = false;
+        releaseBatch();
+        if (pinTracking) reportPins(std::cerr, file);
         throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+      }
 
       if (tmpbuf->dirty == true) {
-        //if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-        tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-        tmpbuf->dirty = false;
+        batch.push_back(i);
+        if (batch.size() == BUF_IO_BATCH) writeBatch();
+        continue;
       }
-
-      hashTable->remove(file, tmpbuf->pageNo);
-      tmpbuf->Clear();
-    } else if (tmpbuf->valid == false && tmpbuf->file == file)
-      throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+      dropFrame(i);
+    } else if (tmpbuf->valid == false && tmpbuf->file == file) {
+      tmpbuf->claimed = false;
+      releaseBatch();
+      // reference information is kept by the replacer, not the frame
+      throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, false);
+    }
+    tmpbuf->claimed = false;
   }
+  writeBatch();
 }
 
 void BufMgr::disposePage(File *file, const PageId pageNo) {
   //Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
-
-  // clear the page
-  bufDescTable[frameNo].Clear();
+  Partition &partition = partitionOf(file->id(), pageNo);
+  bool resident;
+  {
+    std::unique_lock<std::mutex> lock = latch(partition);
+    resident = partition.hashTable->lookup(file, pageNo, frameNo);
+  }
 
-  hashTable->remove(file, pageNo);
+  if (resident) {
+    // the frame may have been evicted before we claimed it
+    claimFrame(frameNo);
+    BufDesc &desc = bufDescTable[frameNo];
+    {
+      std::unique_lock<std::mutex> lock = latch(partition);
+      resident = desc.valid && desc.file == file && desc.pageNo == pageNo;
+      if (resident) partition.hashTable->remove(file, pageNo);
+    }
+    // clear the page
+    if (resident) {
+      desc.Clear();
+      replacer->recordFree(frameNo);
+    }
+    desc.claimed = false;
+  }
 
   // deallocate it in the file
   file->deletePage(pageNo);
 }
 
-void BufMgr::allocPage(File *file, PageId &pageNo, Page *&page) {
+void BufMgr::allocPage(File *file, PageId &pageNo, Page *&page,
+                       const PinSite &site) {
   FrameId frameNo;
 
   // alloc a new frame
   allocBuf(frameNo);
 
   // allocate a new page in the file
-  //std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
+  try {
+    file->allocatePage(pageNo, bufPool[frameNo]);
+  } catch (...) {
+    replacer->recordFree(frameNo);
+    bufDescTable[frameNo].claimed = false;
+    throw;
+  }
   page = &bufPool[frameNo];
 
   // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+  {
+    Partition &partition = partitionOf(file->id(), pageNo);
+    std::unique_lock<std::mutex> lock = latch(partition);
+    bufDescTable[frameNo].Set(file, pageNo);
 
-  // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+    // insert in the hash table
+    partition.hashTable->insert(file, pageNo, frameNo);
+  }
+  replacer->recordLoad(frameNo, file, pageNo);
+  trackPin(frameNo, site);
+  bufDescTable[frameNo].claimed = false;
+}
+
+std::uint32_t BufMgr::resize(std::uint32_t bufs) {
+  std::lock_guard<std::mutex> guard(resizeLatch);
+  bufs = std::max(1u, std::min(bufs, maxBufs));
+  const std::uint32_t oldBufs = numBufs;
+
+  if (bufs > oldBufs) {
+    for (FrameId i = oldBufs; i < bufs; i++) {
+      if (i >= initializedBufs) {
+        new (&bufDescTable[i]) BufDesc();
+        bufDescTable[i].frameNo = i;
+      }
+      new (&bufPool[i]) Page();
+    }
+    initializedBufs = std::max(initializedBufs, bufs);
+
+    // every partition keeps room for all the frames, as when constructed
+    for (std::uint32_t i = 0; i < numPartitions; i++) {
+      std::unique_lock<std::mutex> lock = latch(partitions[i]);
+      partitions[i].hashTable->resize(2 * bufs);
+    }
+    numBufs = bufs;
+    replacer->resize(bufs);
+    return bufs;
+  }
+
+  // retire frames from the end until one cannot be emptied; those retired
+  // stay claimed until nothing hands them out any more.  A frame claimed by
+  // another thread for long is given up on, since that thread may be
+  // waiting for the frames already retired, as flushFile() does.
+  FrameId end = oldBufs;
+  std::exception_ptr failure;
+  while (end > bufs) {
+    const FrameId frameNo = end - 1;
+    BufDesc &desc = bufDescTable[frameNo];
+    bool claimed = false;
+    for (int attempt = 0; attempt < BUF_RESIZE_CLAIM_ATTEMPTS && !claimed;
+         attempt++) {
+      claimed = !desc.claimed.exchange(true);
+      if (!claimed) std::this_thread::yield();
+    }
+    if (!claimed) break;
+    if (desc.valid && desc.pinCnt > 0) {
+      desc.claimed = false;
+      break;
+    }
+    try {
+      if (!evictClaimed(frameNo)) break;
+    } catch (...) {
+      failure = std::current_exception();
+      break;
+    }
+    end--;
+  }
+  if (end == oldBufs) {
+    if (failure) std::rethrow_exception(failure);
+    return end;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(ringLatch, std::defer_lock);
+    if (concurrent) lock.lock();
+    ring.erase(std::remove_if(ring.begin(), ring.end(),
+                              [end](FrameId frameNo) {
+                                return frameNo >= end;
+                              }),
+               ring.end());
+    ringSize = std::min(ringSize, std::max(1u, end / 2));
+    if (ring.size() > ringSize) ring.resize(ringSize);
+    ringNext = 0;
+  }
+  numBufs = end;
+  replacer->resize(end);
+
+  // give back the memory of the chunks retired whole
+  const std::size_t chunkStart =
+      ((std::size_t)end * Page::SIZE + BUF_POOL_ALIGNMENT - 1) /
+      BUF_POOL_ALIGNMENT * BUF_POOL_ALIGNMENT;
+  const std::size_t chunkEnd = std::min(
+      poolLength, ((std::size_t)oldBufs * Page::SIZE + BUF_POOL_ALIGNMENT - 1) /
+                      BUF_POOL_ALIGNMENT * BUF_POOL_ALIGNMENT);
+  if (chunkEnd > chunkStart) {
+    madvise(reinterpret_cast<char *>(bufPool) + chunkStart,
+            chunkEnd - chunkStart, MADV_DONTNEED);
+    const std::size_t imagesEnd =
+        std::min(chunkEnd, (std::size_t)maxBufs * Page::SIZE);
+    if (loggedImages != NULL && imagesEnd > chunkStart) {
+      madvise(loggedImages + chunkStart, imagesEnd - chunkStart,
+              MADV_DONTNEED);
+    }
+  }
+  for (FrameId i = end; i < oldBufs; i++) bufDescTable[i].claimed = false;
+  if (failure) std::rethrow_exception(failure);
+  return end;
+}
+
+void BufMgr::setPinTracking(bool on) {
+  std::lock_guard<std::mutex> guard(pinSitesLatch);
+  pinTracking = on;
+  if (!on) pinSites.clear();
+}
+
+void BufMgr::addPinSite(FrameId frameNo, const PinSite &site) {
+  std::lock_guard<std::mutex> guard(pinSitesLatch);
+  pinSites[frameNo].push_back(site);
+}
+
+void BufMgr::dropPinSite(FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(pinSitesLatch);
+  auto sites = pinSites.find(frameNo);
+  if (sites == pinSites.end()) return;
+  sites->second.pop_back();
+  if (sites->second.empty()) pinSites.erase(sites);
+}
+
+std::vector<PinnedPage> BufMgr::outstandingPins(const File *file) {
+  std::vector<PinnedPage> pinned;
+  std::lock_guard<std::mutex> guard(pinSitesLatch);
+  for (FrameId i = 0; i < numBufs; i++) {
+    const BufDesc &desc = bufDescTable[i];
+    const int pinCnt = desc.pinCnt;
+    if (!desc.valid || pinCnt <= 0) continue;
+    if (file != NULL && desc.file != file) continue;
+    PinnedPage page;
+    page.filename = desc.file->filename();
+    page.pageNo = desc.pageNo;
+    page.frameNo = i;
+    page.pinCnt = pinCnt;
+    auto sites = pinSites.find(i);
+    if (sites != pinSites.end()) page.sites = sites->second;
+    pinned.push_back(page);
+  }
+  return pinned;
+}
+
+std::size_t BufMgr::reportPins(std::ostream &out, const File *file) {
+  const std::vector<PinnedPage> pinned = outstandingPins(file);
+  for (const PinnedPage &page : pinned) {
+    out << page.filename << " page " << page.pageNo << " (frame "
+        << page.frameNo << ") pinned " << page.pinCnt << " times"
+        << std::endl;
+    for (const PinSite &site : page.sites) {
+      out << "  by " << site.function << " at " << site.file << ":"
+          << site.line << std::endl;
+    }
+    if (page.sites.size() < page.pinCnt) {
+      out << "  " << page.pinCnt - page.sites.size()
+          << " times while pins were not tracked" << std::endl;
+    }
+  }
+  return pinned.size();
 }
 
 void BufMgr::printSelf(void) {
@@ -219,4 +1256,172 @@ void BufMgr::printSelf(void) {
   std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
 }
 
+BufMgr::StatsShard &BufMgr::statsShard(std::uint32_t node) {
+  return statsShards[node * BUF_STATS_SHARDS + threadShard()];
+}
+
+void BufMgr::record(HistogramId histogram, std::uint64_t value) {
+  StatsShard &shard = statsShard();
+  shard.buckets[histogram][Histogram::bucketOf(value)].fetch_add(
+      1, std::memory_order_relaxed);
+  shard.sums[histogram].fetch_add(value, std::memory_order_relaxed);
+  std::uint64_t max = shard.maxes[histogram].load(std::memory_order_relaxed);
+  while (value > max &&
+         !shard.maxes[histogram].compare_exchange_weak(
+             max, value, std::memory_order_relaxed)) {
+  }
+}
+
+void BufMgr::countAccess(const File *file, FrameId frameNo, bool hit) {
+  const std::uint32_t node = currentNode();
+  StatsShard &shard = statsShard(node);
+  if (hit && frameNode(frameNo) != node)
+    shard.counters[REMOTE_HITS].fetch_add(1, std::memory_order_relaxed);
+  std::unique_lock<std::mutex> lock(shard.fileLatch, std::defer_lock);
+  if (concurrent) lock.lock();
+  if (shard.lastFile != file) {
+    auto entry = shard.files.find(file);
+    if (entry == shard.files.end()) {
+      entry = shard.files.emplace(file, StatsShard::FileEntry()).first;
+      entry->second.name = file->filename();
+    }
+    shard.lastFile = file;
+    shard.lastFileStats = &entry->second.stats;
+  }
+  if (hit)
+    shard.lastFileStats->hits++;
+  else
+    shard.lastFileStats->misses++;
+}
+
+BufStats BufMgr::getBufStats() { return sumStats(0, numa.nodes()); }
+
+BufStats BufMgr::getBufStats(std::uint32_t node) {
+  return sumStats(node, node + 1);
+}
+
+BufStats BufMgr::sumStats(std::uint32_t first, std::uint32_t last) {
+  std::uint64_t counters[NUM_COUNTERS] = {};
+  BufStats stats;
+  Histogram *histograms[NUM_HISTOGRAMS] = {
+      &stats.readLatency, &stats.writeLatency, &stats.pinWait,
+      &stats.sweepLength};
+  {
+    std::lock_guard<std::mutex> guard(statsLatch);
+    for (std::uint32_t node = first; node < last; node++) {
+      for (const auto &entry : flushedFiles[node]) {
+        FileStats &file = stats.files[entry.first];
+        file.hits += entry.second.hits;
+        file.misses += entry.second.misses;
+      }
+    }
+  }
+  for (std::uint32_t i = first * BUF_STATS_SHARDS;
+       i < last * BUF_STATS_SHARDS; i++) {
+    StatsShard &shard = statsShards[i];
+    for (int c = 0; c < NUM_COUNTERS; c++)
+      counters[c] += shard.counters[c].load(std::memory_order_relaxed);
+    for (int h = 0; h < NUM_HISTOGRAMS; h++) {
+      Histogram &histogram = *histograms[h];
+      for (int b = 0; b < Histogram::NUM_BUCKETS; b++) {
+        const std::uint64_t n =
+            shard.buckets[h][b].load(std::memory_order_relaxed);
+        histogram.counts[b] += n;
+        histogram.count += n;
+      }
+      histogram.sum += shard.sums[h].load(std::memory_order_relaxed);
+      histogram.max = std::max<std::uint64_t>(
+          histogram.max, shard.maxes[h].load(std::memory_order_relaxed));
+    }
+    std::unique_lock<std::mutex> lock(shard.fileLatch, std::defer_lock);
+    if (concurrent) lock.lock();
+    for (const auto &entry : shard.files) {
+      FileStats &file = stats.files[entry.second.name];
+      file.hits += entry.second.stats.hits;
+      file.misses += entry.second.stats.misses;
+    }
+  }
+  for (const auto &file : stats.files) {
+    stats.hits += file.second.hits;
+    stats.accesses += file.second.hits + file.second.misses;
+  }
+  stats.diskreads = counters[DISK_READS];
+  stats.diskwrites = counters[DISK_WRITES];
+  stats.prefetches = counters[PREFETCHES];
+  stats.prefetchHits = counters[PREFETCH_HITS];
+  stats.prefetchWasted = counters[PREFETCH_WASTED];
+  stats.checksumsVerified = counters[CHECKSUMS_VERIFIED];
+  stats.checksumFailures = counters[CHECKSUM_FAILURES];
+  stats.cleanEvictions = counters[CLEAN_EVICTIONS];
+  stats.dirtyEvictions = counters[DIRTY_EVICTIONS];
+  stats.remoteHits = counters[REMOTE_HITS];
+  stats.remoteAllocations = counters[REMOTE_ALLOCATIONS];
+  stats.policy = replacer->name();
+  return stats;
+}
+
+void BufMgr::clearBufStats() {
+  {
+    std::lock_guard<std::mutex> guard(statsLatch);
+    for (auto &files : flushedFiles) files.clear();
+  }
+  for (std::uint32_t i = 0; i < numa.nodes() * BUF_STATS_SHARDS; i++) {
+    StatsShard &shard = statsShards[i];
+    for (int c = 0; c < NUM_COUNTERS; c++) shard.counters[c] = 0;
+    for (int h = 0; h < NUM_HISTOGRAMS; h++) {
+      for (int b = 0; b < Histogram::NUM_BUCKETS; b++) shard.buckets[h][b] = 0;
+      shard.sums[h] = 0;
+      shard.maxes[h] = 0;
+    }
+    std::unique_lock<std::mutex> lock(shard.fileLatch, std::defer_lock);
+    if (concurrent) lock.lock();
+    shard.files.clear();
+    shard.lastFile = NULL;
+  }
+}
+
+std::uint64_t Histogram::percentile(double fraction) const {
+  if (count == 0) return 0;
+  const std::uint64_t rank = std::max<std::uint64_t>(
+      1, (std::uint64_t)std::ceil(fraction * count));
+  std::uint64_t seen = 0;
+  for (int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+    seen += counts[bucket];
+    // the largest value of the bucket
+    if (seen >= rank) return std::min(max, bucketStart(bucket + 1) - 1);
+  }
+  return max;
+}
+
+void BufStats::print(std::ostream &out) const {
+  out << "policy: " << policy << "\n";
+  out << "accesses: " << accesses << ", hits: " << hits
+      << ", hit ratio: " << hitRatio() << "\n";
+  out << "disk reads: " << diskreads << ", disk writes: " << diskwrites
+      << "\n";
+  out << "evictions: " << cleanEvictions << " clean, " << dirtyEvictions
+      << " dirty\n";
+  out << "prefetches: " << prefetches << ", hits: " << prefetchHits
+      << ", wasted: " << prefetchWasted << "\n";
+  out << "checksums verified: " << checksumsVerified
+      << ", failures: " << checksumFailures << "\n";
+  out << "remote hits: " << remoteHits
+      << ", remote allocations: " << remoteAllocations << "\n";
+  const std::pair<const char *, const Histogram *> histograms[] = {
+      {"read latency (ns)", &readLatency},
+      {"write latency (ns)", &writeLatency},
+      {"pin wait (ns)", &pinWait},
+      {"sweep length (frames)", &sweepLength}};
+  for (const auto &histogram : histograms) {
+    const Histogram &h = *histogram.second;
+    out << histogram.first << ": count " << h.count << ", mean " << h.mean()
+        << ", p50 " << h.percentile(0.5) << ", p99 " << h.percentile(0.99)
+        << ", p99.9 " << h.percentile(0.999) << ", max " << h.max << "\n";
+  }
+  for (const auto &file : files) {
+    out << "file " << file.first << ": " << file.second.hits << " hits, "
+        << file.second.misses << " misses\n";
+  }
+}
+
 }
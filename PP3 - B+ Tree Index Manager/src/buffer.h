@@ -9,10 +9,136 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "numa.h"
+#include "replacer.h"
+#include "wal.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace badgerdb {
 
+/**
+* Number of frame table partitions, each with its own latch, used by a
+* concurrent buffer manager
+*/
+const std::uint32_t BUF_LATCH_PARTITIONS = 16;
+
+/**
+* Largest number of frames recycled by SEQUENTIAL_ACCESS reads
+*/
+const std::uint32_t BUF_RING_SIZE = 16;
+
+/**
+* Number of threads reading pages ahead for a buffer manager
+*/
+const std::uint32_t BUF_PREFETCH_THREADS = 2;
+
+/**
+* Largest number of read-ahead requests waiting for a thread
+*/
+const std::uint32_t BUF_PREFETCH_QUEUE_SIZE = 64;
+
+/**
+* Default milliseconds from the start of a background checkpoint to the start
+* of the next
+*/
+const std::uint32_t BUF_CHECKPOINT_INTERVAL = 1000;
+
+/**
+* Number of times a checkpoint on a concurrent buffer manager goes back to the
+* pages it could not write out, 100us apart
+*/
+const std::uint32_t BUF_CHECKPOINT_RETRIES = 100;
+
+/**
+* Default number of pages read from disk per page whose checksum is verified
+* under CHECKSUM_SAMPLED
+*/
+const std::uint32_t BUF_CHECKSUM_SAMPLE = 16;
+
+/**
+* Alignment of the buffer pool, that of a huge page; each frame is thereby
+* aligned for direct I/O
+*/
+const std::size_t BUF_POOL_ALIGNMENT = 2 << 20;
+
+/**
+* Default factor a buffer pool may grow by through BufMgr::resize()
+*/
+const std::uint32_t BUF_GROWTH_LIMIT = 8;
+
+/**
+* Number of times BufMgr::resize() tries to claim a frame to retire, yielding
+* in between, before it stops shrinking the pool there
+*/
+const int BUF_RESIZE_CLAIM_ATTEMPTS = 1000;
+
+/**
+* Largest number of pages a buffer manager reads or writes in one batch
+*/
+const std::uint32_t BUF_IO_BATCH = 32;
+
+/**
+* Number of shards of the statistics of a buffer manager; each thread counts
+* in one shard, so that threads seldom share the cache lines they count in
+*/
+const std::uint32_t BUF_STATS_SHARDS = 16;
+
+/**
+* Returns the number of the page following the given one in a chain of
+* pages being read ahead, or Page::INVALID_NUMBER at the end of the chain
+*/
+typedef PageId (*NextPageFn)(const Page &page);
+
+/**
+* @brief How the caller of BufMgr::readPage expects to use the page
+*/
+enum AccessHint {
+  /**
+   * The page may well be read again soon
+   */
+  NORMAL_ACCESS,
+
+  /**
+   * The page is read once as part of a sequential scan.  Such pages are read
+   * into a small ring of frames that is recycled, so a scan can only evict
+   * the pages of its own ring, and hits do not count as references.
+   */
+  SEQUENTIAL_ACCESS
+};
+
+/**
+* @brief Which of the pages read from disk have their checksum verified
+*/
+enum ChecksumPolicy {
+  /**
+   * Every page read is verified
+   */
+  CHECKSUM_ALWAYS,
+
+  /**
+   * One page in every so many read is verified, bounding the cost while still
+   * catching a file corrupted throughout
+   */
+  CHECKSUM_SAMPLED,
+
+  /**
+   * No page is verified
+   */
+  CHECKSUM_OFF
+};
+
 /**
 * forward declaration of BufMgr class
 */
@@ -20,6 +146,11 @@ class BufMgr;
 
 /**
 * @brief Class for maintaining information about buffer pool frames
+*
+* file and pageNo are only changed by the thread holding the frame's claim.
+* pinCnt is updated without any latch; pins are only taken while holding the
+* latch of the frame's partition.  Reference information is kept by the
+* buffer manager's Replacer.
 */
 class BufDesc {
 
@@ -31,6 +162,12 @@ class BufDesc {
    */
   File *file;
 
+  /**
+ * Identifier of that file object, which the hash tables key the frame on; it
+ * stays usable should the object be destroyed without its pages flushed
+   */
+  FileId fileId;
+
   /**
  * Page within file to which corresponding frame is assigned
    */
@@ -44,22 +181,61 @@ class BufDesc {
   /**
  * Number of times this page has been pinned
    */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
   /**
  * True if page is dirty;  false otherwise
    */
-  bool dirty;
+  std::atomic<bool> dirty;
 
   /**
  * True if page is valid
    */
-  bool valid;
+  std::atomic<bool> valid;
 
   /**
- * Has this buffer frame been reference recently
+ * True while a thread is evicting, flushing or loading this frame
    */
-  bool refbit;
+  std::atomic<bool> claimed;
+
+  /**
+ * True until the page being read into this frame has arrived
+   */
+  std::atomic<bool> loading;
+
+  /**
+ * True if the frame belongs to the ring of SEQUENTIAL_ACCESS reads, i.e. its
+ * page was read sequentially and has not been requested normally since
+   */
+  std::atomic<bool> ringed;
+
+  /**
+ * True if the page was read ahead and has not been requested since
+   */
+  std::atomic<bool> prefetched;
+
+  /**
+ * Slot outside the pool pointing to the frame, see BufMgr::swizzle(); it is
+ * cleared before the frame holds another page.  NULL if there is none
+   */
+  Page **swizzledFrom;
+
+  /**
+ * True once the whole page has been logged since it was read in or last
+ * written out, so that its changes are logged as the ranges that changed
+   */
+  bool imaged;
+
+  /**
+ * LSN of the last log record of the page; 0 if it has none
+   */
+  std::atomic<Lsn> pageLsn;
+
+  /**
+ * LSN of the first log record of the page since it was read in or last
+ * written out, which holds the whole page; 0 if it has none
+   */
+  std::atomic<Lsn> recLsn;
 
   /**
  * Initialize buffer frame for a new user
@@ -67,10 +243,18 @@ class BufDesc {
   void Clear() {
     pinCnt = 0;
     file = NULL;
+    fileId = 0;
     pageNo = Page::INVALID_NUMBER;
     dirty = false;
-    refbit = false;
     valid = false;
+    loading = false;
+    ringed = false;
+    prefetched = false;
+    if (swizzledFrom != NULL) *swizzledFrom = NULL;
+    swizzledFrom = NULL;
+    imaged = false;
+    pageLsn = 0;
+    recLsn = 0;
   };
 
   /**
@@ -82,11 +266,14 @@ class BufDesc {
    */
   void Set(File *filePtr, PageId pageNum) {
     file = filePtr;
+    fileId = filePtr->id();
     pageNo = pageNum;
     pinCnt = 1;
     dirty = false;
     valid = true;
-    refbit = true;
+    imaged = false;
+    pageLsn = 0;
+    recLsn = 0;
   }
 
   void Print() {
@@ -96,184 +283,1374 @@ class BufDesc {
     } else
       std::cout << "file:NULL ";
 
-    std::cout << "valid:" << valid << " ";
-    std::cout << "pinCnt:" << pinCnt << " ";
-    std::cout << "dirty:" << dirty << " ";
-    std::cout << "refbit:" << refbit << "\n";
+    std::cout << "valid:" << valid.load() << " ";
+    std::cout << "pinCnt:" << pinCnt.load() << " ";
+    std::cout << "dirty:" << dirty.load() << "\n";
   }
 
   /**
  * Constructor of BufDesc class
    */
-  BufDesc() {
+  BufDesc() : claimed(false), swizzledFrom(NULL) {
     Clear();
   }
 };
 
 /**
-* @brief Class to maintain statistics of buffer usage
+* @brief Log-linear histogram of values such as durations in nanoseconds,
+* after HDR histograms: each power of two is split into SUB_BUCKETS buckets,
+* so a value is known to within 1 / SUB_BUCKETS of itself.
 */
-struct BufStats {
+struct Histogram {
   /**
- * Total number of accesses to buffer pool
+   * Bits of a value kept below its leading bit
    */
-  int accesses;
+  static const int SUB_BITS = 3;
 
   /**
- * Number of pages read from disk (including allocs)
+   * Buckets per power of two
    */
-  int diskreads;
+  static const int SUB_BUCKETS = 1 << SUB_BITS;
 
   /**
- * Number of pages written back to disk
+   * Number of buckets, enough for any 64-bit value
    */
-  int diskwrites;
+  static const int NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
 
   /**
- * Clear all values
+   * Number of values in each bucket
    */
-  void clear() {
-    accesses = diskreads = diskwrites = 0;
+  std::uint64_t counts[NUM_BUCKETS];
+
+  /**
+   * Number, sum and largest of the values
+   */
+  std::uint64_t count;
+  std::uint64_t sum;
+  std::uint64_t max;
+
+  /**
+   * Returns the bucket of a value.
+   */
+  static int bucketOf(std::uint64_t value) {
+    if (value < (std::uint64_t)SUB_BUCKETS) return (int)value;
+    const int top = 63 - __builtin_clzll(value);
+    return (top - SUB_BITS + 1) * SUB_BUCKETS +
+           (int)((value >> (top - SUB_BITS)) & (SUB_BUCKETS - 1));
   }
 
   /**
- * Constructor of BufStats class
+   * Returns the smallest value of a bucket.
    */
-  BufStats() {
-    clear();
+  static std::uint64_t bucketStart(int bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    const int top = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    return (std::uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS)
+           << (top - SUB_BITS);
+  }
+
+  /**
+   * Adds a value.
+   */
+  void record(std::uint64_t value) {
+    counts[bucketOf(value)]++;
+    count++;
+    sum += value;
+    max = std::max(max, value);
+  }
+
+  /**
+   * Adds the values of another histogram.
+   */
+  void add(const Histogram &other) {
+    for (int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+      counts[bucket] += other.counts[bucket];
+    }
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+  }
+
+  /**
+   * Returns the mean of the values, 0 if there are none.
+   */
+  double mean() const { return count == 0 ? 0 : (double)sum / count; }
+
+  /**
+   * Returns a value at least as large as the given fraction of the values
+   * and within 1 / SUB_BUCKETS of the smallest such value; 0 if there are
+   * none.
+   *
+   * @param fraction  Fraction from 0 to 1, e.g. 0.99 for the 99th percentile
+   */
+  std::uint64_t percentile(double fraction) const;
+
+  /**
+   * Clear all values
+   */
+  void clear() {
+    std::fill(counts, counts + NUM_BUCKETS, 0);
+    count = 0;
+    sum = 0;
+    max = 0;
   }
+
+  Histogram() { clear(); }
 };
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file
+* @brief Buffer pool accesses to the pages of one file
 */
-class BufMgr {
- private:
+struct FileStats {
+  /**
+   * Number of accesses to pages of the file already in the buffer pool
+   */
+  std::uint64_t hits;
+
+  /**
+   * Number of accesses that read the page from disk
+   */
+  std::uint64_t misses;
+
+  FileStats() : hits(0), misses(0) {}
+};
+
+/**
+* @brief Statistics of buffer usage, as a snapshot taken by
+* BufMgr::getBufStats()
+*/
+struct BufStats {
   /**
- * Current position of clockhand in our buffer pool
+ * Total number of accesses to buffer pool
    */
-  FrameId clockHand;
+  std::uint64_t accesses;
 
   /**
- * Number of frames in the buffer pool
+ * Number of accesses to pages already in the buffer pool
    */
-  std::uint32_t numBufs;
+  std::uint64_t hits;
 
   /**
- * Hash table mapping (File, page) to frame
+ * Number of pages read from disk (including allocs)
    */
-  BufHashTbl *hashTable;
+  std::uint64_t diskreads;
 
   /**
- * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+ * Number of pages written back to disk
    */
-  BufDesc *bufDescTable;
+  std::uint64_t diskwrites;
 
   /**
- * Maintains Buffer pool usage statistics
+ * Number of pages read ahead (also counted in diskreads)
    */
-  BufStats bufStats;
+  std::uint64_t prefetches;
 
   /**
-   * Allocate a free frame.
-   *
-   * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-   * @throws BufferExceededException If no such buffer is found which can be allocated
+ * Number of pages read ahead that were requested before being evicted
    */
-  void allocBuf(FrameId &frame);
+  std::uint64_t prefetchHits;
 
   /**
- * Advance clock to next frame in the buffer pool
+ * Number of pages read ahead that were evicted or flushed unrequested
    */
-  void advanceClock() {
-    clockHand = (clockHand + 1) % numBufs;
-  }
+  std::uint64_t prefetchWasted;
 
- public:
   /**
- * Actual buffer pool from which frames are allocated
+ * Number of pages read whose checksum was verified
    */
-  Page *bufPool;
+  std::uint64_t checksumsVerified;
 
   /**
- * Constructor of BufMgr class
+ * Number of pages read that did not match their checksum
    */
-  BufMgr(std::uint32_t bufs);
+  std::uint64_t checksumFailures;
 
   /**
- * Destructor of BufMgr class
+ * Number of pages evicted to make room for others that were clean, and that
+ * were written back first
    */
-  ~BufMgr();
+  std::uint64_t cleanEvictions;
+  std::uint64_t dirtyEvictions;
 
   /**
-   * Reads the given page from the file into a frame and returns the pointer to page.
-   * If the requested page is already present in the buffer pool pointer to that frame is returned
-   * otherwise a new frame is allocated from the buffer pool for reading the page.
-   *
-   * @param file   	File object
-   * @param PageNo  Page number in the file to be read
-   * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+ * Number of hits on pages in frames of another NUMA node than that of the
+ * thread, and of frames taken from another node for want of a local one
    */
-  void readPage(File *file, const PageId PageNo, Page *&page);
+  std::uint64_t remoteHits;
+  std::uint64_t remoteAllocations;
 
   /**
-   * Unpin a page from memory since it is no longer required for it to remain in memory.
-   *
-   * @param file   	File object
-   * @param PageNo  Page number
-   * @param dirty		True if the page to be unpinned needs to be marked dirty
- * @throws  PageNotPinnedException If the page is not already pinned
+ * Accesses by file name
    */
-  void unPinPage(File *file, const PageId PageNo, const bool dirty);
+  std::map<std::string, FileStats> files;
 
   /**
-   * Allocates a new, empty page in the file and returns the Page object.
-   * The newly allocated page is also assigned a frame in the buffer pool.
-   *
-   * @param file   	File object
-   * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
-   * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+ * Nanoseconds taken by each read from disk, a batch counting as one
    */
-  void allocPage(File *file, PageId &PageNo, Page *&page);
+  Histogram readLatency;
 
   /**
-   * Writes out all dirty pages of the file to disk.
-   * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-   * Otherwise Error returned.
-   *
-   * @param file   	File object
- * @throws  PagePinnedException If any page of the file is pinned in the buffer pool
- * @throws BadBufferException If any frame allocated to the file is found to be invalid
+ * Nanoseconds taken by each write to disk, a batch counting as one
    */
-  void flushFile(const File *file);
+  Histogram writeLatency;
 
   /**
-   * Delete page from file and also from buffer pool if present.
-   * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
-   *
-   * @param file   	File object
-   * @param PageNo  Page number
+ * Nanoseconds an access waited for a pin, each time it had to: for the latch
+ * of a partition held by another thread, or for a page another thread was
+ * reading in
    */
-  void disposePage(File *file, const PageId PageNo);
+  Histogram pinWait;
 
   /**
- * Print member variable values.
+ * Number of frames the replacement policy looked at to find each frame to
+ * reuse; for CLOCK, the distance the hand swept
    */
-  void printSelf();
+  Histogram sweepLength;
 
   /**
- * Get buffer pool usage statistics
+ * Clear all values
+   */
+  void clear() {
+    accesses = 0;
+    hits = 0;
+    diskreads = 0;
+    diskwrites = 0;
+    prefetches = 0;
+    prefetchHits = 0;
+    prefetchWasted = 0;
+    checksumsVerified = 0;
+    checksumFailures = 0;
+    cleanEvictions = 0;
+    dirtyEvictions = 0;
+    remoteHits = 0;
+    remoteAllocations = 0;
+    files.clear();
+    readLatency.clear();
+    writeLatency.clear();
+    pinWait.clear();
+    sweepLength.clear();
+  }
+
+  /**
+ * Fraction of accesses that found the page in the buffer pool
    */
-  BufStats &getBufStats() {
-    return bufStats;
+  double hitRatio() const {
+    return accesses == 0 ? 0 : (double)hits / accesses;
   }
 
   /**
- * Clear buffer pool usage statistics
+ * Writes the statistics as text, one line per counter, histogram or file.
+   *
+   * @param out   Stream to write to
+   */
+  void print(std::ostream &out) const;
+
+  /**
+ * Name of the replacement policy of the buffer pool
+   */
+  const char *policy;
+
+  /**
+ * Constructor of BufStats class
    */
-  void clearBufStats() {
-    bufStats.clear();
+  BufStats() : policy("") {
+    clear();
   }
 };
 
+/**
+* @brief The place in the code that pinned a page, as recorded by a buffer
+* manager tracking pins.  Taken as a defaulted argument, it names the caller
+* of the function declaring the argument.
+*/
+struct PinSite {
+  PinSite(const char *file = __builtin_FILE(), int line = __builtin_LINE(),
+          const char *function = __builtin_FUNCTION())
+      : file(file), line(line), function(function) {}
+
+  /**
+ * Source file, line and function of the pin
+   */
+  const char *file;
+  int line;
+  const char *function;
+};
+
+/**
+* @brief A page pinned when outstandingPins() was called, with the places
+* that pinned it if they were tracked
+*/
+struct PinnedPage {
+  std::string filename;
+  PageId pageNo;
+  FrameId frameNo;
+  std::uint32_t pinCnt;
+
+  /**
+ * Places of the pins tracked, oldest first; fewer than pinCnt if some pins
+ * were taken while tracking was off
+   */
+  std::vector<PinSite> sites;
+};
+
+class PageHandle;
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file
+*/
+class BufMgr {
+ private:
+  /**
+ * @brief A slice of the frame table guarded by its own latch
+   */
+  struct Partition {
+    /**
+   * Hash table mapping (File, page) to frame for the pages of this partition
+     */
+    BufHashTbl *hashTable;
+
+    /**
+   * Latch guarding hashTable and the taking of pins on its frames
+     */
+    std::mutex latch;
+  };
+
+  /**
+ * Number of frames in the buffer pool; the frames past it are retired
+   */
+  std::atomic<std::uint32_t> numBufs;
+
+  /**
+ * Number of frames the buffer pool may grow to, for which the memory of the
+ * frames and the frame table is reserved
+   */
+  std::uint32_t maxBufs;
+
+  /**
+ * Number of entries of the frame table constructed so far
+   */
+  std::uint32_t initializedBufs;
+
+  /**
+ * Latch serializing resizes of the buffer pool
+   */
+  std::mutex resizeLatch;
+
+  /**
+ * True if the buffer manager may be used from several threads at once
+   */
+  bool concurrent;
+
+  /**
+ * Number of frame table partitions, a power of two
+   */
+  std::uint32_t numPartitions;
+
+  /**
+ * Frame table partitions; a page always maps to the same partition
+   */
+  Partition *partitions;
+
+  /**
+ * Replacement policy choosing the frames to evict
+   */
+  Replacer *replacer;
+
+  /**
+ * NUMA nodes the frames are spread over, in chunks of NUMA_CHUNK_FRAMES
+ * frames dealt out to the nodes in turn
+   */
+  NumaTopology numa;
+
+  /**
+ * Number of frames in a chunk of the pool placed on one NUMA node, that of a
+ * huge page
+   */
+  static const std::uint32_t NUMA_CHUNK_FRAMES =
+      BUF_POOL_ALIGNMENT / Page::SIZE;
+
+  /**
+   * Returns the NUMA node the calling thread runs on.
+   */
+  std::uint32_t currentNode() const {
+    return numa.nodes() == 1 ? 0 : numa.currentNode();
+  }
+
+  /**
+ * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+ * Mapped for maxBufs entries, of which those in use are constructed
+   */
+  BufDesc *bufDescTable;
+
+  /**
+ * Counters of a statistics shard
+   */
+  enum Counter {
+    DISK_READS,
+    DISK_WRITES,
+    PREFETCHES,
+    PREFETCH_HITS,
+    PREFETCH_WASTED,
+    CHECKSUMS_VERIFIED,
+    CHECKSUM_FAILURES,
+    CLEAN_EVICTIONS,
+    DIRTY_EVICTIONS,
+    REMOTE_HITS,
+    REMOTE_ALLOCATIONS,
+    NUM_COUNTERS
+  };
+
+  /**
+ * Histograms of a statistics shard
+   */
+  enum HistogramId {
+    READ_LATENCY,
+    WRITE_LATENCY,
+    PIN_WAIT,
+    SWEEP_LENGTH,
+    NUM_HISTOGRAMS
+  };
+
+  /**
+ * @brief The part of the buffer pool statistics counted by some threads.
+ * Counters are only added to, with relaxed atomics, and summed over the
+ * shards by getBufStats().
+   */
+  struct StatsShard {
+    std::atomic<std::uint64_t> counters[NUM_COUNTERS];
+    std::atomic<std::uint64_t> buckets[NUM_HISTOGRAMS][Histogram::NUM_BUCKETS];
+    std::atomic<std::uint64_t> sums[NUM_HISTOGRAMS];
+    std::atomic<std::uint64_t> maxes[NUM_HISTOGRAMS];
+
+    struct FileEntry {
+      std::string name;
+      FileStats stats;
+    };
+
+    /**
+   * Hits and misses by file, named when first counted, and the file last
+   * counted, which is most often the next one; guarded by fileLatch if the
+   * buffer manager is concurrent.  The accesses of the pool are summed from
+   * them, so an access costs no atomic counter.
+     */
+    std::unordered_map<const File *, FileEntry> files;
+    const File *lastFile;
+    FileStats *lastFileStats;
+    std::mutex fileLatch;
+  };
+
+  /**
+ * Maintains Buffer pool usage statistics, in BUF_STATS_SHARDS shards per
+ * NUMA node, a thread counting in the shards of the node it runs on
+   */
+  std::unique_ptr<StatsShard[]> statsShards;
+
+  /**
+ * Hits and misses of the files flushed, by NUMA node and name, for their File
+ * objects may be gone; guarded by statsLatch
+   */
+  std::vector<std::map<std::string, FileStats>> flushedFiles;
+  std::mutex statsLatch;
+
+  /**
+   * Returns the shard the calling thread counts in.
+   */
+  StatsShard &statsShard() { return statsShard(currentNode()); }
+
+  /**
+   * Returns the shard the calling thread counts in when running on the given
+   * NUMA node.
+   *
+   * @param node  Node of the thread
+   */
+  StatsShard &statsShard(std::uint32_t node);
+
+  /**
+   * Sums up the statistics counted on a range of NUMA nodes.
+   *
+   * @param first   First node
+   * @param last    Node past the last one
+   * @return  Statistics of the nodes
+   */
+  BufStats sumStats(std::uint32_t first, std::uint32_t last);
+
+  /**
+   * Adds to a counter of the calling thread's shard.
+   *
+   * @param counter   Counter to add to
+   * @param n         Amount to add
+   */
+  void count(Counter counter, std::uint64_t n = 1) {
+    statsShard().counters[counter].fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /**
+   * Adds a value to a histogram of the calling thread's shard.
+   *
+   * @param histogram   Histogram to add to
+   * @param value       Value to add
+   */
+  void record(HistogramId histogram, std::uint64_t value);
+
+  /**
+   * Counts an access to a page of a file as a hit or a miss, and a hit on a
+   * frame of another NUMA node as a remote one.
+   *
+   * @param file   	File object
+   * @param frameNo Frame of the page
+   * @param hit     True if the page was already in the buffer pool
+   */
+  void countAccess(const File *file, FrameId frameNo, bool hit);
+
+  /**
+ * Write-ahead log of the changes to the pages of logged files, or NULL
+   */
+  LogManager *log;
+
+  /**
+ * Images of the frames as last logged, for the changes since to be found;
+ * allocated once a log is set
+   */
+  char *loggedImages;
+
+  /**
+   * Appends the changes of a frame being unpinned dirty to the log, if its
+   * file is logged.  The caller holds a pin on the frame.
+   *
+   * @param frameNo   Frame of the page
+   */
+  void logChanges(FrameId frameNo);
+
+  /**
+ * Whether pins are tracked, see setPinTracking()
+   */
+  std::atomic<bool> pinTracking;
+
+  /**
+ * Places of the pins tracked, by frame, oldest first; guarded by
+ * pinSitesLatch
+   */
+  std::unordered_map<FrameId, std::vector<PinSite>> pinSites;
+  std::mutex pinSitesLatch;
+
+  /**
+   * Records where a frame was pinned, if pins are tracked.
+   *
+   * @param frameNo   Frame pinned
+   * @param site      Where it was pinned
+   */
+  void trackPin(FrameId frameNo, const PinSite &site) {
+    if (pinTracking.load(std::memory_order_relaxed))
+      addPinSite(frameNo, site);
+  }
+
+  /**
+   * Drops the latest place a frame was pinned, if pins are tracked.
+   *
+   * @param frameNo   Frame unpinned
+   */
+  void untrackPin(FrameId frameNo) {
+    if (pinTracking.load(std::memory_order_relaxed)) dropPinSite(frameNo);
+  }
+
+  void addPinSite(FrameId frameNo, const PinSite &site);
+  void dropPinSite(FrameId frameNo);
+
+  /**
+   * Maps the memory of the frames, aligned to BUF_POOL_ALIGNMENT, and
+   * initializes them.
+   *
+   * @param hugePages   Whether to put the frames on huge pages
+   */
+  void allocatePool(bool hugePages);
+
+  /**
+   * Writes the page of a dirty frame to its file, forcing the log up to the
+   * last record of the page first.
+   *
+   * @param frameNo   Frame of the page
+   */
+  void writeFrame(FrameId frameNo);
+
+  /**
+   * Writes the pages of claimed dirty frames of one file as one batch,
+   * forcing the log up to the last record of any of them first.
+   *
+   * @param frameNos  Frames of the pages
+   */
+  void writeFrames(const std::vector<FrameId> &frameNos);
+
+  /**
+   * Removes the page of a claimed, unpinned frame from the buffer pool
+   * without writing it, and frees the frame.
+   *
+   * @param frameNo   Frame of the page
+   */
+  void dropFrame(FrameId frameNo);
+
+  /**
+   * Writes out the page of a frame for a checkpoint if it belongs to a logged
+   * file, is dirty and unpinned, and its changes are committed.  The page is
+   * copied while its partition is latched and written from the copy, so that
+   * it can be pinned again meanwhile.  Frames claimed by other threads are
+   * skipped.
+   *
+   * @param frameNo   Frame of the page
+   * @return  True if the page was written
+   */
+  bool checkpointFrame(FrameId frameNo) {
+    return checkpointFrames(std::vector<FrameId>(1, frameNo)) > 0;
+  }
+
+  /**
+   * Writes out the pages of some frames for a checkpoint as checkpointFrame()
+   * does, forcing the log once for all of them and writing those of each
+   * file as one batch.
+   *
+   * @param frameNos  Frames of the pages
+   * @return  Number of pages written
+   */
+  std::uint32_t checkpointFrames(const std::vector<FrameId> &frameNos);
+
+  /**
+   * Tries again to write out the pages a checkpoint skipped that were changed
+   * before it started, as they would keep their records in the log.  Such
+   * pages are mostly pinned by every operation, as the root of an index is,
+   * so they are tried between operations, a bounded number of times.  Only
+   * done by a concurrent buffer manager, whose pages other threads unpin.
+   *
+   * @param startLsn  End of the log when the checkpoint started
+   */
+  void retryCheckpoint(Lsn startLsn);
+
+  /**
+   * Ends a checkpoint: forces the logged files to disk and lets the log drop
+   * the records of the pages no frame holds changes of.
+   */
+  void finishCheckpoint();
+
+  /**
+   * Allocate a free frame.  The frame is returned cleared and claimed by the
+   * caller, who must release the claim once the frame has been set up.
+   * Dirty victims are written back without holding any latch.
+   *
+   * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+   * @throws BufferExceededException If no such buffer is found which can be allocated
+   */
+  void allocBuf(FrameId &frame);
+
+  /**
+   * Allocate a frame for a SEQUENTIAL_ACCESS read.  Once the ring is full its
+   * frames are reused in turn, unless they are pinned or their page has been
+   * requested normally since, in which case allocBuf() supplies the frame.
+   *
+   * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+   * @throws BufferExceededException If no such buffer is found which can be allocated
+   */
+  void allocRingBuf(FrameId &frame);
+
+  /**
+   * Empties a claimed frame, writing its page back first if it is dirty.
+   * Gives up and releases the claim if the page is pinned or written to
+   * meanwhile, or if it holds logged changes not committed yet.
+   *
+   * @param frameNo   Claimed frame
+   * @return  True if the frame is now empty and still claimed
+   */
+  bool evictClaimed(FrameId frameNo);
+
+  /**
+   * Claims the frame if it holds no page or an unpinned one.  Offered to the
+   * replacer when looking for a victim.
+   *
+   * @param frameNo   Frame to claim
+   * @return  True if the frame is now claimed by the caller
+   */
+  bool claimIfUnpinned(FrameId frameNo);
+
+  /**
+   * Returns the partition whose hash table holds the given page.
+   *
+   * @param fileId 	Identifier of the file object
+   * @param pageNo  Page number in the file
+   * @return  Partition of the page
+   */
+  Partition &partitionOf(const FileId fileId, const PageId pageNo) {
+    if (numPartitions == 1) return partitions[0];
+    std::uint64_t value = (std::uint64_t) fileId << 32 | pageNo;
+    value *= 0xff51afd7ed558ccdULL;
+    return partitions[(value >> 32) & (numPartitions - 1)];
+  }
+
+  /**
+   * Takes the latch of the given partition.  No latch is taken unless the
+   * buffer manager is concurrent.
+   *
+   * @param partition   Partition to latch
+   * @return  Lock holding the latch until it goes out of scope
+   */
+  std::unique_lock<std::mutex> latch(Partition &partition) {
+    std::unique_lock<std::mutex> lock(partition.latch, std::defer_lock);
+    if (concurrent) lock.lock();
+    return lock;
+  }
+
+  /**
+   * Claims a frame, waiting for any other thread holding its claim.
+   *
+   * @param frameNo   Frame to claim
+   */
+  void claimFrame(FrameId frameNo);
+
+  /**
+   * Pins the page if it is resident, waiting for the page to arrive if
+   * another thread is still reading it in.
+   *
+   * @param file   	File object
+   * @param pageNo  Page number in the file
+   * @param frameNo Frame holding the page is returned via this reference
+   * @param hint    How the page will be used
+   * @return  True if the page was resident and is now pinned
+   */
+  bool pinResident(File *file, const PageId pageNo, FrameId &frameNo,
+                   AccessHint hint);
+
+  /**
+ * Frames of the ring of SEQUENTIAL_ACCESS reads, in the order they are reused
+   */
+  std::vector<FrameId> ring;
+
+  /**
+ * Number of frames the ring grows to
+   */
+  std::uint32_t ringSize;
+
+  /**
+ * Position in ring of the frame to reuse next
+   */
+  std::uint32_t ringNext;
+
+  /**
+ * Latch guarding ring, ringNext and ringSize
+   */
+  std::mutex ringLatch;
+
+  /**
+   * Reads a page that was not resident into a new frame, pinned once.
+   *
+   * @param file   	File object
+   * @param pageNo  Page number in the file
+   * @param hint    How the page will be used
+   * @param frameNo Frame holding the page is returned via this reference
+   * @param prefetch  True if the page is being read ahead
+   * @return  False if another thread read the page in meanwhile; nothing is
+   *          pinned then
+   */
+  bool loadPage(File *file, const PageId pageNo, AccessHint hint,
+                FrameId &frameNo, bool prefetch);
+
+  /**
+   * Throws if the page just read into a frame is to have its checksum
+   * verified and it does not match.
+   *
+   * @param frameNo Frame holding the page
+   * @throws CorruptPageException If the checksum does not match
+   */
+  void verifyLoaded(FrameId frameNo);
+
+  /**
+   * Undoes a read of a page into a frame that failed: the page is removed
+   * from the hash table once the readers that pinned it meanwhile give up,
+   * and the frame is freed.
+   *
+   * @param frameNo Frame the page was being read into
+   */
+  void abandonLoad(FrameId frameNo);
+
+  /**
+ * @brief A chain of pages to read ahead
+   */
+  struct PrefetchRequest {
+    File *file;
+    PageId pageNo;
+    NextPageFn next;
+    AccessHint hint;
+  };
+
+  /**
+   * Body of the read-ahead threads: serves queued requests until the
+   * buffer manager is destroyed.
+   */
+  void runPrefetcher();
+
+  /**
+   * Drops the queued read-ahead requests for a file and waits for those
+   * being served.
+   *
+   * @param file   	File object
+   */
+  void drainPrefetches(const File *file);
+
+  /**
+ * Number of pages read ahead of a scan; 0 if read-ahead is off
+   */
+  std::atomic<std::uint32_t> prefetchDepth;
+
+  /**
+ * Read-ahead requests waiting for a thread
+   */
+  std::deque<PrefetchRequest> prefetchQueue;
+
+  /**
+ * Files of the requests being served, once per request
+   */
+  std::multiset<const File *> prefetchFiles;
+
+  /**
+ * Read-ahead threads, started by the first request
+   */
+  std::vector<std::thread> prefetchers;
+
+  /**
+ * True once the read-ahead threads are to exit
+   */
+  bool stopPrefetchers;
+
+  /**
+ * Latch guarding the read-ahead queue, files and threads
+   */
+  std::mutex prefetchLatch;
+
+  /**
+ * Signalled when a request is queued or the threads are to exit
+   */
+  std::condition_variable prefetchReady;
+
+  /**
+ * Signalled when a request has been served
+   */
+  std::condition_variable prefetchIdle;
+
+  /**
+   * Body of the checkpointer thread: passes over the buffer pool, writing out
+   * pages at the set rate and ending a checkpoint after each pass, until it
+   * is stopped.
+   */
+  void runCheckpointer();
+
+  /**
+ * Checkpointer thread, if started
+   */
+  std::thread checkpointer;
+
+  /**
+ * Largest number of pages the checkpointer writes a second
+   */
+  std::uint32_t checkpointRate;
+
+  /**
+ * Milliseconds from the start of a pass of the checkpointer to the next
+   */
+  std::uint32_t checkpointInterval;
+
+  /**
+ * True once the checkpointer is to exit
+   */
+  bool stopCheckpointing;
+
+  /**
+ * Latch guarding the checkpointer settings
+   */
+  std::mutex checkpointLatch;
+
+  /**
+ * Signalled when the checkpointer is to exit
+   */
+  std::condition_variable checkpointWake;
+
+  /**
+ * Pages read from disk whose checksum is verified
+   */
+  std::atomic<ChecksumPolicy> checksumPolicy;
+
+  /**
+ * Under CHECKSUM_SAMPLED, number of pages read per page verified
+   */
+  std::atomic<std::uint32_t> checksumSample;
+
+  /**
+ * Number of pages read from disk, picking the pages sampled
+   */
+  std::atomic<std::uint32_t> checksumReads;
+
+  /**
+ * Bytes mapped for the frames
+   */
+  std::size_t poolLength;
+
+  /**
+ * Whether the frames lie on huge pages reserved with MAP_HUGETLB
+   */
+  bool poolHugeTlb;
+
+ public:
+  /**
+ * Actual buffer pool from which frames are allocated
+   */
+  Page *bufPool;
+
+  /**
+ * Constructor of BufMgr class
+   *
+   * @param bufs        Number of frames in the buffer pool
+   * @param concurrent  Whether the buffer manager may be used from several
+   *                    threads at once. A concurrent buffer manager partitions
+   *                    its frame table into BUF_LATCH_PARTITIONS latched parts
+   *                    and never holds a latch while doing page I/O.
+   * @param policy      Replacement policy choosing the frames to evict
+   * @param hugePages   Whether to put the frames on huge pages: reserved ones
+   *                    if the system has enough for maxBufs frames, otherwise
+   *                    transparent ones where the kernel allows
+   * @param maxBufs     Number of frames resize() may grow the pool to; 0 for
+   *                    BUF_GROWTH_LIMIT times bufs.  Only address space is
+   *                    reserved for the frames not in use.
+   * @param numa        NUMA nodes to spread the frames over.  A thread takes
+   *                    the frames of its own node for the pages it reads
+   *                    while any of them can be evicted, and counts its
+   *                    statistics apart from other nodes.
+   */
+  BufMgr(std::uint32_t bufs, bool concurrent = false,
+         ReplacementPolicy policy = CLOCK_REPLACEMENT,
+         bool hugePages = false, std::uint32_t maxBufs = 0,
+         const NumaTopology &numa = NumaTopology::system());
+
+  /**
+ * Destructor of BufMgr class
+   */
+  ~BufMgr();
+
+  /**
+   * Reads the given page from the file into a frame and returns the pointer to page.
+   * If the requested page is already present in the buffer pool pointer to that frame is returned
+   * otherwise a new frame is allocated from the buffer pool for reading the page.
+   * Neither path uses exceptions to find out whether the page is resident.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number in the file to be read
+   * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+   * @param hint    How the page will be used
+   */
+  void readPage(File *file, const PageId PageNo, Page *&page,
+                AccessHint hint = NORMAL_ACCESS,
+                const PinSite &site = PinSite());
+
+  /**
+   * Reads a page as readPage() does and returns a handle holding the pin,
+   * which unpins the page when the handle goes out of scope.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number in the file to be read
+   * @param hint    How the page will be used
+   * @param site    Where the page is pinned, for pin tracking
+   * @return  Handle of the pinned page
+   */
+  PageHandle pin(File *file, const PageId PageNo,
+                 AccessHint hint = NORMAL_ACCESS,
+                 const PinSite &site = PinSite());
+
+  /**
+   * Allocates a page as allocPage() does and returns a handle holding the
+   * pin, which unpins the page when the handle goes out of scope.
+   *
+   * @param file   	File object
+   * @param PageNo  The number assigned to the page is returned via this
+   *                reference
+   * @param site    Where the page is pinned, for pin tracking
+   * @return  Handle of the pinned page
+   */
+  PageHandle pinNew(File *file, PageId &PageNo,
+                    const PinSite &site = PinSite());
+
+  /**
+   * Sets how many pages are read ahead of a scan by prefetch().  Read-ahead
+   * runs on background threads, so only a concurrent buffer manager honours
+   * the setting.  The ring of SEQUENTIAL_ACCESS frames is grown to hold the
+   * pages read ahead.
+   *
+   * @param depth   Number of pages to read ahead; 0 turns read-ahead off
+   */
+  void setPrefetchDepth(std::uint32_t depth);
+
+  /**
+   * Asks for the chain of pages starting at the given page to be read into
+   * the buffer pool in the background, up to the prefetch depth.  Pages
+   * already resident are skipped.  Returns at once; does nothing if
+   * read-ahead is off.  flushFile() waits for the read-ahead of its file.
+   *
+   * @param file   	File object
+   * @param PageNo  First page of the chain
+   * @param next    Returns the page following a page of the chain
+   * @param hint    Access hint for the pages read ahead
+   */
+  void prefetch(File *file, const PageId PageNo, NextPageFn next,
+                AccessHint hint = SEQUENTIAL_ACCESS);
+
+  /**
+   * Reads the pages of a file that are not resident into the buffer pool as
+   * batches of up to BUF_IO_BATCH pages, each one request to the file, and
+   * leaves them unpinned.  Returns once they are read; a page that fails its
+   * checksum is left out, since reading ahead is only a hint.
+   *
+   * @param file    File object
+   * @param pageNos Page numbers in the file
+   * @throws BufferExceededException If no frame is free for a page
+   */
+  void prefetchPages(File *file, const std::vector<PageId> &pageNos);
+
+  /**
+   * Unpin a page from memory since it is no longer required for it to remain in memory.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number
+   * @param dirty		True if the page to be unpinned needs to be marked dirty
+ * @throws  PageNotPinnedException If the page is not already pinned
+   */
+  void unPinPage(File *file, const PageId PageNo, const bool dirty);
+
+  /**
+   * Unpins the page in the given frame, as the method above does without
+   * looking the page up.
+   *
+   * @param page   Frame of the page, as returned by readPage()
+   * @param dirty  True if the page to be unpinned needs to be marked dirty
+ * @throws  PageNotPinnedException If the page is not already pinned
+   */
+  void unPinPage(Page *page, const bool dirty);
+
+  /**
+   * Points a slot kept outside the pool at the frame of a pinned page, and
+   * clears the slot again before the frame holds another page, so that the
+   * owner of the slot can pin the page through pinSwizzled() while the slot
+   * is set rather than look it up through readPage().  A frame is pointed to
+   * by one slot at a time.  Other threads may evict the frames of a
+   * concurrent buffer manager at any moment, so it points no slots.
+   *
+   * @param page  Frame of the page, as returned by readPage()
+   * @param slot  Slot to point at the frame
+   * @return  True if the slot was set
+   */
+  bool swizzle(Page *page, Page **slot);
+
+  /**
+   * Clears a slot set by swizzle(), if it is still set.
+   *
+   * @param slot  Slot
+   */
+  void unswizzle(Page **slot);
+
+  /**
+   * Pins the page a slot set by swizzle() points to, as readPage() would.
+   *
+   * @param page  Frame the slot points to
+   * @param site  Where the page is pinned, for pin tracking
+   */
+  void pinSwizzled(Page *page, const PinSite &site = PinSite());
+
+  /**
+   * Allocates a new, empty page in the file and returns the Page object.
+   * The newly allocated page is also assigned a frame in the buffer pool.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+   * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+   * @param site    Where the page is pinned, for pin tracking
+   */
+  void allocPage(File *file, PageId &PageNo, Page *&page,
+                 const PinSite &site = PinSite());
+
+  /**
+   * Writes out all dirty pages of the file to disk, in batches of up to
+   * BUF_IO_BATCH pages.
+   * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
+   * Otherwise Error returned, after the pins of the file are reported to
+   * std::cerr if pins are tracked.
+   *
+   * @param file   	File object
+ * @throws  PagePinnedException If any page of the file is pinned in the buffer pool
+ * @throws BadBufferException If any frame allocated to the file is found to be invalid
+   */
+  void flushFile(const File *file);
+
+  /**
+   * Delete page from file and also from buffer pool if present.
+   * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number
+   */
+  void disposePage(File *file, const PageId PageNo);
+
+  /**
+   * Logs the changes to the pages of the files logged by the given log from
+   * now on.  A page is written out only once the log is on disk up to its
+   * last change, and never while its last change is not committed.
+   *
+   * @param log   The log; it outlives the buffer manager
+   */
+  void setLog(LogManager *log);
+
+  /**
+   * Returns the log set, or NULL.
+   */
+  LogManager *getLog() { return log; }
+
+  /**
+   * Takes a fuzzy checkpoint: writes out the dirty pages of the logged files
+   * that are unpinned and hold committed changes only, forces the files to
+   * disk and drops the log segments recovery no longer needs.  Changes may
+   * go on meanwhile; the pages skipped keep their records in the log.
+   */
+  void checkpoint();
+
+  /**
+   * Starts taking checkpoints in the background, writing out at most the
+   * given number of pages a second so that the write-back does not stall
+   * foreground work.  Each pass over the buffer pool ends a checkpoint.  A
+   * page written out is logged whole on its next change, so shorter
+   * intervals bound recovery tighter at the cost of more log.
+   * Checkpointing runs on a background thread, so only a concurrent buffer
+   * manager with a log set honours the call; calling it again changes the
+   * settings.
+   *
+   * @param pagesPerSecond  Largest number of pages written a second
+   * @param interval        Milliseconds from the start of a checkpoint to the
+   *                        start of the next
+   */
+  void startCheckpointer(std::uint32_t pagesPerSecond,
+                         std::uint32_t interval = BUF_CHECKPOINT_INTERVAL);
+
+  /**
+   * Stops the background checkpoints, waiting for the pass in progress to
+   * reach the next page.
+   */
+  void stopCheckpointer();
+
+  /**
+   * Sets which of the pages read from disk have their checksum verified.  A
+   * page that does not match is not read in.  Files stamp a checksum on each
+   * page they write; verification costs about a CRC32C of the page per read.
+   * Verifying every page is the default.
+   *
+   * @param policy  Pages to verify
+   * @param sample  Under CHECKSUM_SAMPLED, number of pages read per page
+   *                verified
+   */
+  void setChecksumPolicy(ChecksumPolicy policy,
+                         std::uint32_t sample = BUF_CHECKSUM_SAMPLE);
+
+  /**
+   * Starts or stops recording where each pin is taken, to find the pins a
+   * caller never gives back.  Tracking costs a latched map update per pin
+   * and unpin; while it is off, a load and a branch.  Pins taken while it
+   * is off are counted but not placed.  With tracking on, flushFile() and
+   * the destructor report the pins left to std::cerr.
+   *
+   * @param on  Whether to track pins
+   */
+  void setPinTracking(bool on);
+
+  /**
+   * Returns the pages pinned, with the places that pinned them if pins are
+   * tracked.  Pins taken or given back meanwhile by other threads may be
+   * missed.  An unpin drops the latest place of its page, so the places
+   * listed for a page pinned several times are right in number but may not
+   * be those of the pins left if pins of the page were not given back in
+   * reverse order.
+   *
+   * @param file  File whose pages to list, or NULL for all files
+   * @return  The pages pinned, by frame
+   */
+  std::vector<PinnedPage> outstandingPins(const File *file = NULL);
+
+  /**
+   * Writes the pages pinned and the places that pinned them as text, one
+   * line per page and one per place.
+   *
+   * @param out   Stream to write to
+   * @param file  File whose pages to report, or NULL for all files
+   * @return  Number of pages pinned
+   */
+  std::size_t reportPins(std::ostream &out, const File *file = NULL);
+
+  /**
+   * Returns true if the frames lie on huge pages reserved with MAP_HUGETLB.
+   */
+  bool onReservedHugePages() const { return poolHugeTlb; }
+
+  /**
+   * Returns true if the buffer manager may be used from several threads at
+   * once.
+   */
+  bool isConcurrent() const { return concurrent; }
+
+  /**
+   * Returns the number of frames in the pool.
+   */
+  std::uint32_t numFrames() const { return numBufs; }
+
+  /**
+   * Returns the number of frames the pool may grow to.
+   */
+  std::uint32_t maxFrames() const { return maxBufs; }
+
+  /**
+   * Returns the number of NUMA nodes the frames are spread over.
+   */
+  std::uint32_t numaNodes() const { return numa.nodes(); }
+
+  /**
+   * Returns the NUMA node whose memory holds the given frame.
+   *
+   * @param frameNo   Frame number
+   */
+  std::uint32_t frameNode(FrameId frameNo) const {
+    return numa.nodes() == 1 ? 0 : frameNo / NUMA_CHUNK_FRAMES % numa.nodes();
+  }
+
+  /**
+   * Grows or shrinks the buffer pool while it is in use.  Frames are added
+   * to or retired from the end of the pool.  The hash tables of the
+   * partitions grow with the pool, moving their entries over a few at a time
+   * by later accesses rather than all at once.  Shrinking evicts the pages
+   * of the frames retired, writing back the dirty ones, and stops at a frame
+   * whose page is pinned or holds logged changes not committed yet, so the
+   * pool may be left larger than asked.  The memory of each
+   * BUF_POOL_ALIGNMENT chunk of frames wholly retired is given back to the
+   * system.
+   *
+   * @param bufs  Number of frames wanted, at most maxFrames()
+   * @return  Number of frames in the pool now
+   */
+  std::uint32_t resize(std::uint32_t bufs);
+
+  /**
+ * Print member variable values.
+   */
+  void printSelf();
+
+  /**
+ * Get buffer pool usage statistics.  The counts of each thread are summed
+ * up, so the snapshot is not atomic while other threads use the pool.
+   */
+  BufStats getBufStats();
+
+  /**
+ * Get the buffer pool usage statistics counted by threads while running on
+ * the given NUMA node.
+   *
+   * @param node  Node number, below numaNodes()
+   */
+  BufStats getBufStats(std::uint32_t node);
+
+  /**
+ * Clear buffer pool usage statistics.  Counts added meanwhile by other
+ * threads may be lost or kept.
+   */
+  void clearBufStats();
+};
+
+/**
+* @brief Holds the pin of a page and gives it back when it goes out of scope,
+* marking the page dirty if it was changed through the handle.  A handle can
+* be moved but not copied; an empty one holds nothing.
+*/
+class PageHandle {
+ public:
+  PageHandle() : bufMgr(NULL), page(NULL), dirty(false) {}
+
+  /**
+   * Takes over a pin already held on a page.
+   *
+   * @param bufMgr  Buffer manager the page is pinned in
+   * @param page    Frame of the page, as returned by readPage()
+   */
+  PageHandle(BufMgr *bufMgr, Page *page)
+      : bufMgr(bufMgr), page(page), dirty(false) {}
+
+  PageHandle(PageHandle &&other)
+      : bufMgr(other.bufMgr), page(other.page), dirty(other.dirty) {
+    other.page = NULL;
+    other.dirty = false;
+  }
+
+  PageHandle &operator=(PageHandle &&other) {
+    if (this != &other) {
+      release();
+      bufMgr = other.bufMgr;
+      page = other.page;
+      dirty = other.dirty;
+      other.page = NULL;
+      other.dirty = false;
+    }
+    return *this;
+  }
+
+  PageHandle(const PageHandle &) = delete;
+  PageHandle &operator=(const PageHandle &) = delete;
+
+  ~PageHandle() { release(); }
+
+  /**
+   * Returns the page, or NULL if the handle is empty.
+   */
+  Page *get() const { return page; }
+  Page *operator->() const { return page; }
+  Page &operator*() const { return *page; }
+  explicit operator bool() const { return page != NULL; }
+
+  /**
+   * Returns the page seen as a node or other layout of its contents.
+   */
+  template <class T>
+  T *as() const {
+    return reinterpret_cast<T *>(page);
+  }
+
+  /**
+   * Marks the page to be unpinned dirty.
+   */
+  void markDirty() { dirty = true; }
+
+  /**
+   * Unpins the page now, leaving the handle empty.  Does nothing if the
+   * handle is empty.
+   */
+  void release() {
+    if (page == NULL) return;
+    Page *held = page;
+    page = NULL;
+    const bool changed = dirty;
+    dirty = false;
+    bufMgr->unPinPage(held, changed);
+  }
+
+  /**
+   * Gives up the pin without unpinning, leaving the handle empty; the caller
+   * unpins the page, dirty if it was marked so.
+   *
+   * @return  Frame of the page
+   */
+  Page *detach() {
+    Page *held = page;
+    page = NULL;
+    dirty = false;
+    return held;
+  }
+
+ private:
+  BufMgr *bufMgr;
+  Page *page;
+  bool dirty;
+};
+
 }
@@ -0,0 +1,194 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "compression.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace badgerdb {
+
+// shortest copy; the low half of a sequence token holds its length less this
+static const std::size_t MIN_MATCH = 4;
+
+// a block ends with this many literals, and its last copy starts at least
+// MATCH_LIMIT bytes before its end
+static const std::size_t LAST_LITERALS = 5;
+static const std::size_t MATCH_LIMIT = 12;
+
+// farthest back a copy reaches
+static const std::size_t MAX_OFFSET = 65535;
+
+// positions of 4-byte sequences are hashed into a table of 2^HASH_BITS
+static const int HASH_BITS = 12;
+
+static std::uint32_t read32(const char *p) {
+  std::uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static std::uint64_t read64(const char *p) {
+  std::uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static std::uint32_t hashOf(std::uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// appends a length continued past a 4-bit token field, as bytes of 255
+// followed by the remainder
+static bool writeLength(std::size_t length, char *dst, std::size_t &pos,
+                        std::size_t capacity) {
+  for (; length >= 255; length -= 255) {
+    if (pos >= capacity) return false;
+    dst[pos++] = (char)255;
+  }
+  if (pos >= capacity) return false;
+  dst[pos++] = (char)length;
+  return true;
+}
+
+// appends a sequence of literals, followed by a copy unless matchLength is 0
+static bool writeSequence(const char *literals, std::size_t literalLength,
+                          std::size_t offset, std::size_t matchLength,
+                          char *dst, std::size_t &pos, std::size_t capacity) {
+  if (pos >= capacity) return false;
+  const std::size_t token = pos++;
+  const std::size_t matchCode = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+  dst[token] = (char)((std::min<std::size_t>(literalLength, 15) << 4) |
+                      std::min<std::size_t>(matchCode, 15));
+  if (literalLength >= 15 &&
+      !writeLength(literalLength - 15, dst, pos, capacity))
+    return false;
+  if (pos + literalLength > capacity) return false;
+  memcpy(dst + pos, literals, literalLength);
+  pos += literalLength;
+  if (matchLength == 0) return true;
+  if (pos + 2 > capacity) return false;
+  dst[pos++] = (char)(offset & 0xff);
+  dst[pos++] = (char)(offset >> 8);
+  return matchCode < 15 || writeLength(matchCode - 15, dst, pos, capacity);
+}
+
+std::size_t compressBlock(const char *src, std::size_t srcSize, char *dst,
+                          std::size_t dstCapacity) {
+  std::size_t pos = 0, anchor = 0;
+  if (srcSize > MATCH_LIMIT) {
+    // positions plus one of the last sequence seen with each hash
+    std::vector<std::uint32_t> table(std::size_t(1) << HASH_BITS, 0);
+    const std::size_t limit = srcSize - MATCH_LIMIT;
+    const std::size_t matchEnd = srcSize - LAST_LITERALS;
+    std::size_t i = 0;
+    while (i < limit) {
+      const std::uint32_t sequence = read32(src + i);
+      std::uint32_t &entry = table[hashOf(sequence)];
+      const std::size_t candidate = entry;
+      entry = (std::uint32_t)i + 1;
+      if (candidate == 0 || i + 1 - candidate > MAX_OFFSET ||
+          read32(src + candidate - 1) != sequence) {
+        // step faster through bytes that do not compress
+        i += 1 + ((i - anchor) >> 6);
+        continue;
+      }
+      const std::size_t match = candidate - 1;
+      // extend the copy 8 bytes at a time, then by the bytes equal at the
+      // low end of the first word that differs
+      std::size_t length = MIN_MATCH;
+      while (i + length + 8 <= matchEnd) {
+        const std::uint64_t diff =
+            read64(src + match + length) ^ read64(src + i + length);
+        if (diff != 0) {
+          length += __builtin_ctzll(diff) / 8;
+          break;
+        }
+        length += 8;
+      }
+      if (i + length + 8 > matchEnd) {
+        while (i + length < matchEnd && src[match + length] == src[i + length])
+          length++;
+      }
+      if (!writeSequence(src + anchor, i - anchor, i - match, length, dst, pos,
+                         dstCapacity))
+        return 0;
+      i += length;
+      anchor = i;
+    }
+  }
+  if (!writeSequence(src + anchor, srcSize - anchor, 0, 0, dst, pos,
+                     dstCapacity))
+    return 0;
+  return pos;
+}
+
+// reads a length continued past a 4-bit token field
+static bool readLength(const char *src, std::size_t srcSize, std::size_t &pos,
+                       std::size_t &length) {
+  unsigned char byte;
+  do {
+    if (pos >= srcSize) return false;
+    byte = (unsigned char)src[pos++];
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+bool decompressBlock(const char *src, std::size_t srcSize, char *dst,
+                     std::size_t dstSize) {
+  std::size_t pos = 0, out = 0;
+  while (pos < srcSize) {
+    const unsigned char token = (unsigned char)src[pos++];
+    std::size_t literalLength = token >> 4;
+    if (literalLength == 15 && !readLength(src, srcSize, pos, literalLength))
+      return false;
+    if (literalLength > srcSize - pos || literalLength > dstSize - out)
+      return false;
+    // short runs are copied 16 bytes at once where both buffers have room;
+    // the bytes past the run are overwritten by the sequences after it
+    if (literalLength <= 16 && srcSize - pos >= 16 && dstSize - out >= 16)
+      memcpy(dst + out, src + pos, 16);
+    else
+      memcpy(dst + out, src + pos, literalLength);
+    pos += literalLength;
+    out += literalLength;
+    // the last sequence has no copy
+    if (pos == srcSize) return out == dstSize;
+
+    if (srcSize - pos < 2) return false;
+    const std::size_t offset = (unsigned char)src[pos] |
+                               ((std::size_t)(unsigned char)src[pos + 1] << 8);
+    pos += 2;
+    std::size_t matchLength = token & 15;
+    if (matchLength == 15 && !readLength(src, srcSize, pos, matchLength))
+      return false;
+    matchLength += MIN_MATCH;
+    if (offset == 0 || offset > out || matchLength > dstSize - out)
+      return false;
+    // a copy may overlap its own output, repeating the last offset bytes;
+    // the bytes available to copy double with each step
+    const char *from = dst + out - offset;
+    char *to = dst + out;
+    out += matchLength;
+    if (matchLength <= 16 && offset >= 16 && dstSize - (to - dst) >= 16) {
+      memcpy(to, from, 16);
+      continue;
+    }
+    while (matchLength > 0) {
+      const std::size_t step =
+          std::min<std::size_t>(matchLength, (std::size_t)(to - from));
+      memcpy(to, from, step);
+      to += step;
+      matchLength -= step;
+    }
+  }
+  return false;
+}
+
+}
@@ -0,0 +1,44 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace badgerdb {
+
+/**
+ * Compresses a block of bytes in the LZ4 block format: runs of literal bytes
+ * alternating with copies of at least 4 bytes from up to 64KB back.  Fast
+ * rather than thorough, as it runs on every page written to a compressed
+ * file.
+ *
+ * @param src           Bytes to compress
+ * @param srcSize       Number of bytes to compress
+ * @param dst           Where to write the compressed block
+ * @param dstCapacity   Bytes available at dst
+ * @return  Size of the compressed block, or 0 if it would not fit in
+ *          dstCapacity bytes
+ */
+std::size_t compressBlock(const char *src, std::size_t srcSize, char *dst,
+                          std::size_t dstCapacity);
+
+/**
+ * Decompresses a block written by compressBlock.  Malformed blocks, such as
+ * corrupted ones, are detected rather than read or written past their bounds.
+ *
+ * @param src       Compressed block
+ * @param srcSize   Size of the compressed block
+ * @param dst       Where to write the bytes
+ * @param dstSize   Number of bytes the block decompresses to
+ * @return  False if the block is malformed or does not decompress to exactly
+ *          dstSize bytes
+ */
+bool decompressBlock(const char *src, std::size_t srcSize, char *dst,
+                     std::size_t dstSize);
+
+}
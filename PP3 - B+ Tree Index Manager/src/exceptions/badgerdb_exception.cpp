@@ -10,7 +10,9 @@
 namespace badgerdb {
 
 BadgerDbException::BadgerDbException(const std::string &msg)
-    : message_(msg) {
+    : message_(msg), literal_("") {
 }
 
+BadgerDbException::BadgerDbException(const char *msg) : literal_(msg) {}
+
 }
@@ -24,6 +24,16 @@ class BadgerDbException : public std::exception {
    */
   explicit BadgerDbException(const std::string &msg);
 
+  /**
+   * Constructs a new exception with a message that outlives it, such as a
+   * string literal, which is not copied unless message() is called.
+   * Exceptions thrown as a matter of course, such as at the end of every
+   * scan, are thus built without allocating.
+   *
+   * @param msg Message with information about the exception.
+   */
+  explicit BadgerDbException(const char *msg);
+
   /**
    * Destroys the exception.  Does nothing special; just included to make the
    * compiler happy.
@@ -35,14 +45,19 @@ class BadgerDbException : public std::exception {
    *
    * @return  Message describing the problem that caused this exception.
    */
-  virtual const std::string &message() const { return message_; }
+  virtual const std::string &message() const {
+    if (message_.empty()) message_ = literal_;
+    return message_;
+  }
 
   /**
    * Returns a description of the exception.
    *
    * @return  Description of the exception.
    */
-  virtual const char *what() const throw() { return message_.c_str(); }
+  virtual const char *what() const throw() {
+    return message_.empty() ? literal_ : message_.c_str();
+  }
 
   /**
    * Formats this exception for printing on the given stream.
@@ -61,7 +76,12 @@ class BadgerDbException : public std::exception {
   /**
    * Message describing the problem that caused this exception.
    */
-  std::string message_;
+  mutable std::string message_;
+
+  /**
+   * Message not copied into message_ yet
+   */
+  const char *literal_;
 };
 
 }
@@ -0,0 +1,24 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "corrupt_page_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+CorruptPageException::CorruptPageException(const PageId page_number,
+                                           const std::string &file)
+    : BadgerDbException(""), page_number_(page_number), filename_(file) {
+  std::stringstream ss;
+  ss << "Page is corrupt."
+     << " Page " << page_number_ << " of file '" << filename_ << "'";
+  message_.assign(ss.str());
+}
+
+}
@@ -7,16 +7,12 @@
 
 #include "end_of_file_exception.h"
 
-#include <sstream>
 #include <string>
 
 namespace badgerdb {
 
+// thrown at the end of every file scan, so its message is not copied
 EndOfFileException::EndOfFileException()
-    : BadgerDbException("") {
-  std::stringstream ss;
-  ss << "End of File reached.";
-  message_.assign(ss.str());
-}
+    : BadgerDbException("End of File reached.") {}
 
 }
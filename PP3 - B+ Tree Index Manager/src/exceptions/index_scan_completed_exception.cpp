@@ -7,16 +7,12 @@
 
 #include "index_scan_completed_exception.h"
 
-#include <sstream>
 #include <string>
 
 namespace badgerdb {
 
+// thrown at the end of every scan, so its message is not copied
 IndexScanCompletedException::IndexScanCompletedException()
-    : BadgerDbException("") {
-  std::stringstream ss;
-  ss << "Index Scan Completed";
-  message_.assign(ss.str());
-}
+    : BadgerDbException("Index Scan Completed") {}
 
 }
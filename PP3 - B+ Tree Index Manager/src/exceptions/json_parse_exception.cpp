@@ -0,0 +1,23 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "json_parse_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+JsonParseException::JsonParseException(const std::uint64_t offset,
+                                       const std::string &reason)
+    : BadgerDbException(""), offset_(offset) {
+  std::stringstream ss;
+  ss << "Malformed JSON at byte " << offset_ << ": " << reason;
+  message_.assign(ss.str());
+}
+
+}
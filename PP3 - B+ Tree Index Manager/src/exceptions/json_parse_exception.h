@@ -0,0 +1,49 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a JSON document being read is not
+ *        well formed, or not of the shape its reader expects.
+ */
+class JsonParseException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a JSON parse exception.
+   *
+   * @param offset  Offset in bytes of the document where reading failed.
+   * @param reason  What was wrong there.
+   */
+  JsonParseException(const std::uint64_t offset, const std::string &reason);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~JsonParseException() throw() {}
+
+  /**
+   * Returns the offset in bytes of the document where reading failed.
+   */
+  virtual std::uint64_t offset() const { return offset_; }
+
+ protected:
+  /**
+   * Offset in bytes of the document where reading failed.
+   */
+  const std::uint64_t offset_;
+};
+
+}
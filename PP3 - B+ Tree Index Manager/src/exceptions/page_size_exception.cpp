@@ -0,0 +1,26 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "page_size_exception.h"
+
+#include <sstream>
+#include <string>
+
+#include "page.h"
+
+namespace badgerdb {
+
+PageSizeException::PageSizeException(const std::string &name,
+                                     const std::size_t page_size)
+    : BadgerDbException(""), filename_(name), page_size_(page_size) {
+  std::stringstream ss;
+  ss << "File has pages of " << page_size_ << " bytes, not "
+     << Page::SIZE << ": " << filename_;
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,59 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a file is opened whose pages are of
+ *        another size than Page::SIZE, the size the code was built with.
+ */
+class PageSizeException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a page size exception for the given file.
+   *
+   * @param name        Name of the file.
+   * @param page_size   Size in bytes of the pages of the file.
+   */
+  PageSizeException(const std::string &name, const std::size_t page_size);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~PageSizeException() throw() {}
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string &filename() const { return filename_; }
+
+  /**
+   * Returns the size in bytes of the pages of the file.
+   */
+  virtual std::size_t page_size() const { return page_size_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * Size in bytes of the pages of the file.
+   */
+  const std::size_t page_size_;
+};
+
+}
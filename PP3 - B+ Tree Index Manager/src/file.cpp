@@ -8,24 +8,315 @@
 
 #include "file.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <new>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "compression.h"
+#include "exceptions/corrupt_page_exception.h"
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
+#include "exceptions/file_map_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/page_size_exception.h"
 #include "file_iterator.h"
 #include "page.h"
+#include "trace.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
-File::CountMap File::open_counts_;
+File::OpenFileMap File::open_files_;
+File::OpenNameMap File::open_names_;
+std::mutex File::open_files_mutex_;
+std::atomic<FileId> File::next_id_(1);
+
+namespace {
+
+// the write-behind flusher; defined after the registry above so that it is
+// stopped before they are destroyed
+struct Flusher {
+  ~Flusher() {
+    {
+      std::lock_guard<std::mutex> guard(latch);
+      stop = true;
+    }
+    wakeup.notify_all();
+    if (thread.joinable()) thread.join();
+  }
+
+  std::mutex latch;
+  std::condition_variable wakeup;
+  bool stop = false;
+  std::thread thread;
+} flusher;
+
+}
+
+void File::startFlusher() {
+  std::lock_guard<std::mutex> guard(flusher.latch);
+  if (flusher.thread.joinable()) return;
+  flusher.thread = std::thread([] {
+    std::unique_lock<std::mutex> lock(flusher.latch);
+    while (!flusher.stop) {
+      flusher.wakeup.wait_for(
+          lock, std::chrono::milliseconds(WRITE_BEHIND_INTERVAL_MS));
+      if (flusher.stop) break;
+      lock.unlock();
+      writeAllPending(false /* durable */);
+      lock.lock();
+    }
+  });
+}
+
+void File::writeAllPending(const bool durable) {
+  // the entries keep their streams alive if the files are closed meanwhile
+  std::vector<std::shared_ptr<OpenFile>> files;
+  {
+    std::lock_guard<std::mutex> guard(open_files_mutex_);
+    for (const OpenFileMap::value_type &entry : open_files_) {
+      files.push_back(entry.second);
+    }
+  }
+  for (const std::shared_ptr<OpenFile> &open : files) {
+    OpenFile &file = *open;
+    std::lock_guard<std::recursive_mutex> guard(*file.latch);
+    if (durable && file.pending->compressed) {
+      writeMap(*file.stream, file.filename, *file.pending->compressed);
+    }
+    if (!file.pending->enabled) continue;
+    writePending(*file.stream, *file.pending);
+    if (durable) syncToDisk(file.filename);
+  }
+}
+
+void File::writePending(std::fstream &stream, PendingWrites &pending) {
+  if (pending.compressed) writeExtent(stream, *pending.compressed);
+  if (pending.pages.empty() && !pending.header_dirty) return;
+  TRACE_SCOPE("writePending", "file", "pages", pending.pages.size(), NULL, 0);
+  // runs of consecutive pages are gathered and written with a single call
+  std::vector<char> &run = pending.run;
+  PageId run_start = Page::INVALID_NUMBER;
+  PendingWrites::PageMap::const_iterator it = pending.pages.begin();
+  while (it != pending.pages.end()) {
+    run_start = it->first;
+    run.clear();
+    do {
+      run.insert(run.end(), it->second.begin(), it->second.end());
+      ++it;
+    } while (it != pending.pages.end() &&
+             it->first == run_start + run.size() / Page::SIZE &&
+             run.size() < WRITE_BEHIND_BATCH * Page::SIZE);
+    stream.seekp(pagePosition(run_start), std::ios::beg);
+    stream.write(run.data(), run.size());
+  }
+  if (pending.header_dirty) {
+    stream.seekp(0 /* pos */, std::ios::beg);
+    stream.write(reinterpret_cast<const char *>(&pending.header),
+                 sizeof(FileHeader));
+  }
+  stream.flush();
+  pending.pages.clear();
+  pending.header_dirty = false;
+}
+
+void File::writeExtent(std::fstream &stream, CompressedPages &compressed) {
+  if (compressed.extent.empty()) return;
+  stream.seekp(compressed.extent_offset, std::ios::beg);
+  stream.write(compressed.extent.data(), compressed.extent.size());
+  stream.flush();
+  compressed.extent_offset += compressed.extent.size();
+  compressed.extent.clear();
+}
+
+void File::writeMap(std::fstream &stream, const std::string &filename,
+                    CompressedPages &compressed) {
+  if (!compressed.map_dirty) return;
+  writeExtent(stream, compressed);
+  // the map goes where the next extent would, which follows it instead
+  const CompressedHeader header = {compressed.extent_offset,
+                                   compressed.locations.size()};
+  const std::size_t map_size =
+      compressed.locations.size() * sizeof(PageLocation);
+  stream.seekp(header.map_offset, std::ios::beg);
+  stream.write(reinterpret_cast<const char *>(compressed.locations.data()),
+               map_size);
+  stream.flush();
+  compressed.extent_offset += map_size;
+  // the header points to the map only once the map is on disk
+  syncToDisk(filename);
+  stream.seekp(sizeof(FileHeader), std::ios::beg);
+  stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  stream.flush();
+  compressed.map_dirty = false;
+}
+
+void File::writeCompressed(const PageId page_number, const char *head,
+                           const std::size_t head_size, const char *tail,
+                           const std::size_t tail_size) {
+  assert(head_size + tail_size == Page::SIZE);
+  PageImage image;
+  std::copy(head, head + head_size, image.begin());
+  std::copy(tail, tail + tail_size, image.begin() + head_size);
+  PageImage packed;
+  std::size_t length =
+      compressBlock(image.data(), Page::SIZE, packed.data(), Page::SIZE - 1);
+  const char *bytes = packed.data();
+  if (length == 0) {
+    bytes = image.data();
+    length = Page::SIZE;
+  }
+
+  CompressedPages &compressed = *pending_->compressed;
+  if (compressed.extent.size() + length > COMPRESSED_EXTENT_SIZE) {
+    writeExtent(*stream_, compressed);
+  }
+  if (page_number >= compressed.locations.size()) {
+    compressed.locations.resize(page_number + 1, PageLocation());
+  }
+  PageLocation &location = compressed.locations[page_number];
+  compressed.stored_bytes += length;
+  compressed.stored_bytes -= location.length;
+  location.offset = compressed.extent_offset + compressed.extent.size();
+  location.length = length;
+  compressed.extent.insert(compressed.extent.end(), bytes, bytes + length);
+  compressed.map_dirty = true;
+}
+
+bool File::readCompressed(const PageId page_number, char *head,
+                          const std::size_t head_size, char *tail,
+                          const std::size_t tail_size) const {
+  const CompressedPages &compressed = *pending_->compressed;
+  if (page_number >= compressed.locations.size() ||
+      compressed.locations[page_number].length == 0) {
+    return false;
+  }
+  const PageLocation &location = compressed.locations[page_number];
+  PageImage stored;
+  const char *bytes = stored.data();
+  if (location.offset >= compressed.extent_offset) {
+    bytes = compressed.extent.data() +
+            (location.offset - compressed.extent_offset);
+  } else {
+    stream_->seekg(location.offset, std::ios::beg);
+    if (!stream_->read(stored.data(), location.length)) {
+      stream_->clear();
+      throw CorruptPageException(page_number, filename_);
+    }
+  }
+
+  // a whole page is decompressed straight into place, e.g. a buffer frame
+  PageImage image;
+  char *target = head_size == Page::SIZE ? head : image.data();
+  if (location.length == Page::SIZE) {
+    memcpy(target, bytes, Page::SIZE);
+  } else if (!decompressBlock(bytes, location.length, target, Page::SIZE)) {
+    throw CorruptPageException(page_number, filename_);
+  }
+  if (target == image.data()) {
+    std::copy(image.begin(), image.begin() + head_size, head);
+    std::copy(image.begin() + head_size,
+              image.begin() + head_size + tail_size, tail);
+  }
+  return true;
+}
+
+void File::checkPageSize() {
+  FileHeader header;
+  stream_->seekg(0 /* pos */, std::ios::beg);
+  if (!stream_->read(reinterpret_cast<char *>(&header), sizeof(header))) {
+    stream_->clear();
+    return;
+  }
+  const std::size_t page_size = header.page_size == 0 ? 8192
+                                                      : header.page_size;
+  if (page_size != Page::SIZE) {
+    throw PageSizeException(filename_, page_size);
+  }
+}
+
+void File::loadCompressed() {
+  FileHeader header;
+  stream_->seekg(0 /* pos */, std::ios::beg);
+  if (!stream_->read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      !header.compressed) {
+    stream_->clear();
+    return;
+  }
+  CompressedHeader compressed_header;
+  stream_->read(reinterpret_cast<char *>(&compressed_header),
+                sizeof(compressed_header));
+  std::unique_ptr<CompressedPages> compressed(new CompressedPages);
+  if (compressed_header.map_offset != 0) {
+    compressed->locations.resize(compressed_header.map_entries);
+    stream_->seekg(compressed_header.map_offset, std::ios::beg);
+    stream_->read(reinterpret_cast<char *>(compressed->locations.data()),
+                  compressed_header.map_entries * sizeof(PageLocation));
+    compressed->extent_offset = compressed_header.map_offset +
+        compressed_header.map_entries * sizeof(PageLocation);
+  }
+  for (const PageLocation &location : compressed->locations) {
+    compressed->stored_bytes += location.length;
+  }
+  stream_->clear();
+  pending_->compressed = std::move(compressed);
+}
+
+void File::compress(const std::string &filename) {
+  if (!exists(filename)) {
+    throw FileNotFoundException(filename);
+  }
+  if (isOpen(filename)) {
+    throw FileOpenException(filename);
+  }
+  const std::string packed_name = filename + ".compressing";
+  std::remove(packed_name.c_str());
+  {
+    // pages are copied as images, whatever the kind of file
+    BlobFile source(filename, false /* create_new */);
+    BlobFile packed(packed_name, true /* create_new */);
+    std::lock_guard<std::recursive_mutex> guard(*packed.latch_);
+    FileHeader header = source.readHeader();
+    header.compressed = 1;
+    packed.pending_->compressed.reset(new CompressedPages);
+    packed.writeHeader(header);
+    PageImage image;
+    for (PageId page_number = 1; page_number < header.num_pages;
+         ++page_number) {
+      if (source.readImage(page_number, image.data(), Page::SIZE)) {
+        packed.writeImage(page_number, image.data(), Page::SIZE);
+      }
+    }
+  }
+  std::rename(packed_name.c_str(), filename.c_str());
+}
+
+void File::syncToDisk(const std::string &filename) {
+  // fsync covers writes made through any descriptor of the file
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  ::fsync(fd);
+  ::close(fd);
+}
+
+void File::syncAll() { writeAllPending(true /* durable */); }
 
 void File::remove(const std::string &filename) {
   if (!exists(filename)) {
@@ -38,49 +329,129 @@ void File::remove(const std::string &filename) {
 }
 
 bool File::isOpen(const std::string &filename) {
-  if (!exists(filename)) {
+  {
+    std::lock_guard<std::mutex> guard(open_files_mutex_);
+    if (open_names_.find(filename) != open_names_.end()) return true;
+  }
+  FileKey key;
+  if (!statFile(filename, key)) {
     return false;
   }
-  return open_counts_.find(filename) != open_counts_.end();
+  std::lock_guard<std::mutex> guard(open_files_mutex_);
+  return open_files_.find(key) != open_files_.end();
 }
 
 bool File::exists(const std::string &filename) {
-  std::fstream file(filename);
-  if (file) {
-    file.close();
-    return true;
-  }
+  FileKey key;
+  return statFile(filename, key);
+}
 
-  return false;
+bool File::statFile(const std::string &filename, FileKey &key) {
+  struct stat status;
+  if (::stat(filename.c_str(), &status) != 0 || !S_ISREG(status.st_mode)) {
+    return false;
+  }
+  key.device = status.st_dev;
+  key.inode = status.st_ino;
+  return true;
 }
 
 File::~File() { close(); }
 
+void File::setWriteBehind(const bool enabled) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  if (!enabled) writePending(*stream_, *pending_);
+  pending_->enabled = enabled;
+  if (enabled) startFlusher();
+}
+
+bool File::writeBehind() const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  return pending_->enabled;
+}
+
+bool File::compressed() const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  return pending_->compressed != nullptr;
+}
+
+std::uint64_t File::storedBytes() const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  if (pending_->compressed) return pending_->compressed->stored_bytes;
+  return (std::uint64_t)(readHeader().num_pages - 1) * Page::SIZE;
+}
+
+void File::readPages(const std::vector<PageId> &page_numbers,
+                     const std::vector<Page *> &pages) const {
+  for (std::size_t i = 0; i < page_numbers.size(); i++) {
+    readPage(page_numbers[i], *pages[i]);
+  }
+}
+
+void File::writePages(const std::vector<PageId> &page_numbers,
+                      const std::vector<const Page *> &pages) {
+  for (std::size_t i = 0; i < page_numbers.size(); i++) {
+    writePage(page_numbers[i], *pages[i]);
+  }
+}
+
+void File::sync() {
+  {
+    std::lock_guard<std::recursive_mutex> guard(*latch_);
+    writePending(*stream_, *pending_);
+    if (pending_->compressed) {
+      writeMap(*stream_, filename_, *pending_->compressed);
+    }
+  }
+  syncToDisk(filename_);
+}
+
 PageId File::getFirstPageNo() {
   const FileHeader &header = readHeader();
   return header.first_used_page;
 }
 
+PageId File::getNumPages() {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  return readHeader().num_pages;
+}
+
 File::File(const std::string &name, const bool create_new) : filename_(name) {
   openIfNeeded(create_new);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         0 /* last_used_page */, 0 /* compressed */,
+                         Page::SIZE /* page_size */};
     writeHeader(header);
   }
 }
 
 void File::openIfNeeded(const bool create_new) {
-  if (open_counts_.find(filename_) !=
-      open_counts_.end()) {  // exists an entry already
-    ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+  std::lock_guard<std::mutex> guard(open_files_mutex_);
+  OpenNameMap::iterator named = open_names_.find(filename_);
+  FileKey key = {0, 0};
+  const bool already_exists =
+      named != open_names_.end() || statFile(filename_, key);
+  if (named == open_names_.end() && already_exists) {
+    // the file may be open under another name
+    OpenFileMap::iterator entry = open_files_.find(key);
+    if (entry != open_files_.end()) {
+      entry->second->names.push_back(filename_);
+      named = open_names_.emplace(filename_, entry->second).first;
+    }
+  }
+  if (named != open_names_.end()) {  // exists an entry already
+    open_ = named->second;
+    ++open_->count;
+    stream_ = open_->stream;
+    latch_ = open_->latch;
+    pending_ = open_->pending;
   } else {
     std::ios_base::openmode mode =
         std::fstream::in | std::fstream::out | std::fstream::binary;
-    const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
       if (already_exists) {
@@ -95,24 +466,51 @@ void File::openIfNeeded(const bool create_new) {
       }
     }
     stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
-    open_counts_[filename_] = 1;
+    latch_.reset(new std::recursive_mutex);
+    pending_.reset(new PendingWrites);
+    if (already_exists && !create_new) {
+      checkPageSize();
+      loadCompressed();
+    }
+    // a new file is only named once it has been created
+    if (!already_exists) statFile(filename_, key);
+    open_ = std::make_shared<OpenFile>(OpenFile{
+        key, filename_, {filename_}, stream_, latch_, pending_, 1 /* count */});
+    open_files_[key] = open_;
+    open_names_[filename_] = open_;
   }
+  // 0 is no file, should the identifiers ever wrap around
+  id_ = next_id_++;
+  if (id_ == 0) id_ = next_id_++;
 }
 
 void File::close() {
-  if (open_counts_[filename_] > 0) --open_counts_[filename_];
-
+  if (latch_) {
+    // deferred writes go out before the stream may be closed
+    std::lock_guard<std::recursive_mutex> guard(*latch_);
+    writePending(*stream_, *pending_);
+    if (pending_->compressed) {
+      writeMap(*stream_, filename_, *pending_->compressed);
+    }
+  }
+  std::lock_guard<std::mutex> guard(open_files_mutex_);
   stream_.reset();
-  assert(open_counts_[filename_] >= 0);
+  latch_.reset();
+  pending_.reset();
+  id_ = 0;
+  if (!open_) return;
 
-  if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+  assert(open_->count > 0);
+  if (--open_->count == 0) {
+    open_files_.erase(open_->key);
+    for (const std::string &name : open_->names) open_names_.erase(name);
   }
+  open_.reset();
 }
 
 FileHeader File::readHeader() const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  if (pending_->header_dirty) return pending_->header;
   FileHeader header;
   stream_->seekg(0 /* pos */, std::ios::beg);
   stream_->read(reinterpret_cast<char *>(&header), sizeof(FileHeader));
@@ -120,11 +518,72 @@ FileHeader File::readHeader() const {
 }
 
 void File::writeHeader(const FileHeader &header) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  if (pending_->enabled) {
+    pending_->header = header;
+    pending_->header_dirty = true;
+    return;
+  }
   stream_->seekp(0 /* pos */, std::ios::beg);
   stream_->write(reinterpret_cast<const char *>(&header), sizeof(FileHeader));
   stream_->flush();
 }
 
+void File::writeImage(const PageId page_number, const char *head,
+                      const std::size_t head_size, const char *tail,
+                      const std::size_t tail_size) {
+  if (pending_->compressed) {
+    writeCompressed(page_number, head, head_size, tail, tail_size);
+    return;
+  }
+  TRACE_SCOPE("write", "file", "page", page_number, "bytes",
+              head_size + tail_size);
+  if (pending_->enabled) {
+    PageImage &image = pending_->pages[page_number];
+    std::copy(head, head + head_size, image.begin());
+    std::copy(tail, tail + tail_size, image.begin() + head_size);
+    if (pending_->pages.size() >= WRITE_BEHIND_LIMIT) {
+      writePending(*stream_, *pending_);
+    } else if (pending_->pages.size() >= WRITE_BEHIND_BATCH) {
+      flusher.wakeup.notify_one();
+    }
+    return;
+  }
+  stream_->seekp(pagePosition(page_number), std::ios::beg);
+  stream_->write(head, head_size);
+  if (tail_size > 0) stream_->write(tail, tail_size);
+  stream_->flush();
+}
+
+bool File::readImage(const PageId page_number, char *head,
+                     const std::size_t head_size, char *tail,
+                     const std::size_t tail_size) const {
+  if (page_number == Page::INVALID_NUMBER) return false;
+  if (pending_->compressed) {
+    return readCompressed(page_number, head, head_size, tail, tail_size);
+  }
+  TRACE_SCOPE("read", "file", "page", page_number, "bytes",
+              head_size + tail_size);
+  if (!pending_->pages.empty()) {
+    PendingWrites::PageMap::const_iterator it =
+        pending_->pages.find(page_number);
+    if (it != pending_->pages.end()) {
+      const PageImage &image = it->second;
+      std::copy(image.begin(), image.begin() + head_size, head);
+      std::copy(image.begin() + head_size,
+                image.begin() + head_size + tail_size, tail);
+      return true;
+    }
+  }
+  stream_->seekg(pagePosition(page_number), std::ios::beg);
+  if (!stream_->read(head, head_size) ||
+      (tail_size > 0 && !stream_->read(tail, tail_size))) {
+    stream_->clear();
+    return false;
+  }
+  return true;
+}
+
 PageFile PageFile::create(const std::string &filename) {
   return PageFile(filename, true /* create_new */);
 }
@@ -134,12 +593,13 @@ PageFile PageFile::open(const std::string &filename) {
 }
 
 PageFile::PageFile(const std::string &name, const bool create_new)
-    : File(name, create_new) {}
+    : File(name, create_new), fsm_cursor_(Page::INVALID_NUMBER) {}
 
 PageFile::~PageFile() {}
 
 PageFile::PageFile(const PageFile &other)
-    : File(other.filename_, false /* create_new */) {}
+    : File(other.filename_, false /* create_new */),
+      fsm_cursor_(Page::INVALID_NUMBER) {}
 
 PageFile &PageFile::operator=(const PageFile &rhs) {
   // This accounts for self-assignment and assignment of a File object for the
@@ -151,60 +611,61 @@ PageFile &PageFile::operator=(const PageFile &rhs) {
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
   Page new_page;
+  allocatePage(new_page_number, new_page);
+  return new_page;
+}
+
+void PageFile::allocatePage(PageId &new_page_number, Page &new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader header = readHeader();
   Page existing_page;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
+    // The free list is kept in page order, so every page before its head is
+    // in use and the data page right before the head precedes it in the used
+    // list.
+    readPage(header.first_free_page, new_page, true /* allow_free */);
     new_page.set_page_number(header.first_free_page);
     new_page_number = new_page.page_number();
     header.first_free_page = new_page.next_page_number();
     --header.num_free_pages;
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
+    const PageId previous_page_number = previousDataPage(new_page_number);
+    if (previous_page_number == Page::INVALID_NUMBER) {
+      new_page.set_next_page_number(header.first_used_page);
+      header.first_used_page = new_page_number;
     } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
+      readPage(previous_page_number, existing_page, false /* allow_free */);
+      new_page.set_next_page_number(existing_page.next_page_number());
+      existing_page.set_next_page_number(new_page_number);
+    }
+    if (new_page.next_page_number() == Page::INVALID_NUMBER) {
+      header.last_used_page = new_page_number;
     }
 
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
   } else {
+    if (isMapPage(header.num_pages)) {
+      // The file has grown past the pages covered by the last map page.
+      PageImage map;
+      map.fill(0);
+      writeImage(header.num_pages, map.data(), Page::SIZE);
+      ++header.num_pages;
+    }
+    new_page.initialize();
     new_page.set_page_number(header.num_pages);
     new_page_number = new_page.page_number();
 
-    if (header.first_used_page == Page::INVALID_NUMBER) {
-      header.first_used_page = new_page.page_number();
+    if (header.last_used_page == Page::INVALID_NUMBER) {
+      header.first_used_page = new_page_number;
     } else {
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
+      // The new page is the last page of the file, so it goes at the tail of
+      // the used list.
+      readPage(header.last_used_page, existing_page, false /* allow_free */);
+      existing_page.set_next_page_number(new_page_number);
     }
+    header.last_used_page = new_page_number;
     ++header.num_pages;
   }
   writePage(new_page_number, new_page.header_, new_page);
@@ -215,32 +676,42 @@ Page PageFile::allocatePage(PageId &new_page_number) {
               existing_page);
   }
   writeHeader(header);
-
-  return new_page;
 }
 
 Page PageFile::readPage(const PageId page_number) const {
+  Page page;
+  readPage(page_number, page);
+  return page;
+}
+
+void PageFile::readPage(const PageId page_number, Page &page) const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   FileHeader header = readHeader();
 
-  if (page_number >= header.num_pages) {
+  if (page_number >= header.num_pages || isMapPage(page_number)) {
     throw InvalidPageException(page_number, filename_);
   }
-  return readPage(page_number, false /* allow_free */);
+  readPage(page_number, page, false /* allow_free */);
 }
 
-Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
-  Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char *>(&page.data_[0]), Page::DATA_SIZE);
+void PageFile::readPage(const PageId page_number, Page &page,
+                        const bool allow_free) const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  // pages are stored header first
+  if (!readImage(page_number, reinterpret_cast<char *>(&page.header_),
+                 sizeof(PageHeader), &page.data_[0], Page::DATA_SIZE)) {
+    page.initialize();
+  }
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-
-  return page;
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page &new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  if (isMapPage(new_page_number)) {
+    throw InvalidPageException(new_page_number, filename_);
+  }
   PageHeader header = readPageHeader(new_page_number);
   if (header.current_page_number == Page::INVALID_NUMBER) {
     // Page has been deleted since it was read.
@@ -256,29 +727,52 @@ void PageFile::writePage(const PageId new_page_number, const Page &new_page) {
 }
 
 void PageFile::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   FileHeader header = readHeader();
 
   Page existing_page = readPage(page_number);
+  const PageId next_used_page = existing_page.next_page_number();
+
+  // The used list is in page order, so the page pointing to this one is the
+  // closest data page before it that is not free.
+  PageId previous_page_number = previousDataPage(page_number);
+  while (previous_page_number != Page::INVALID_NUMBER &&
+         readPageHeader(previous_page_number).current_page_number ==
+             Page::INVALID_NUMBER) {
+    previous_page_number = previousDataPage(previous_page_number);
+  }
   Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
-    header.first_used_page = existing_page.next_page_number();
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = next_used_page;
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    readPage(previous_page_number, previous_page, false /* allow_free */);
+    previous_page.set_next_page_number(next_used_page);
+  }
+  if (header.last_used_page == page_number) {
+    header.last_used_page = previous_page_number;
   }
-  // Clear the page and add it to the head of the free list.
+
+  // Clear the page and add it to the free list, keeping the list in page
+  // order.
   existing_page.initialize();
-  existing_page.set_next_page_number(header.first_free_page);
-  header.first_free_page = page_number;
+  PageId previous_free_number = Page::INVALID_NUMBER;
+  Page previous_free;
+  PageId next_free_number = header.first_free_page;
+  while (next_free_number != Page::INVALID_NUMBER &&
+         next_free_number < page_number) {
+    previous_free_number = next_free_number;
+    readPage(previous_free_number, previous_free, true /* allow_free */);
+    next_free_number = previous_free.next_page_number();
+  }
+  existing_page.set_next_page_number(next_free_number);
+  if (previous_free_number == Page::INVALID_NUMBER) {
+    header.first_free_page = page_number;
+  } else {
+    previous_free.set_next_page_number(page_number);
+    writePage(previous_free_number, previous_free.header_, previous_free);
+  }
   ++header.num_free_pages;
+
   if (previous_page.isUsed()) {
     writePage(previous_page.page_number(), previous_page.header_,
               previous_page);
@@ -298,17 +792,135 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader &header,
                          const Page &new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char *>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char *>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  PageHeader stamped = header;
+  stamped.checksum = new_page.computeChecksum(stamped);
+  writeImage(page_number, reinterpret_cast<const char *>(&stamped),
+             sizeof(PageHeader), &new_page.data_[0], Page::DATA_SIZE);
+  updateFreeSpace(page_number, new_page);
+}
+
+void PageFile::updateFreeSpace(const PageId page_number, const Page &page) {
+  const char category = freeSpaceCategory(page);
+  const PageId map_page = mapPageOf(page_number);
+  PageImage map;
+  if (!readImage(map_page, map.data(), Page::SIZE)) {
+    map.fill(0);
+  }
+  char &entry = map[page_number - map_page - 1];
+  if (entry == category) return;
+  entry = category;
+  writeImage(map_page, map.data(), Page::SIZE);
+}
+
+char PageFile::freeSpaceCategory(const Page &page) {
+  // free pages are found through the free list, not the map
+  if (!page.isUsed()) return 0;
+  return static_cast<char>(
+      std::min<std::size_t>(255, page.getFreeSpace() / FSM_CATEGORY_SIZE));
+}
+
+void PageFile::appendPages(std::vector<Page> &pages) {
+  if (pages.empty()) return;
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader header = readHeader();
+  PageImage map;
+  map.fill(0);
+  for (Page &page : pages) {
+    if (isMapPage(header.num_pages)) {
+      writeImage(header.num_pages, map.data(), Page::SIZE);
+      ++header.num_pages;
+    }
+    page.set_page_number(header.num_pages++);
+  }
+  for (std::size_t i = 0; i + 1 < pages.size(); i++) {
+    pages[i].set_next_page_number(pages[i + 1].page_number());
+  }
+  pages.back().set_next_page_number(Page::INVALID_NUMBER);
+
+  if (header.last_used_page == Page::INVALID_NUMBER) {
+    header.first_used_page = pages.front().page_number();
+  } else {
+    Page tail;
+    readPage(header.last_used_page, tail, false /* allow_free */);
+    tail.set_next_page_number(pages.front().page_number());
+    writePage(tail.page_number(), tail.header_, tail);
+  }
+  header.last_used_page = pages.back().page_number();
+
+  // the map entries of the pages are gathered and written per map page
+  PageId map_page = Page::INVALID_NUMBER;
+  for (const Page &page : pages) {
+    if (mapPageOf(page.page_number()) != map_page) {
+      if (map_page != Page::INVALID_NUMBER) {
+        writeImage(map_page, map.data(), Page::SIZE);
+      }
+      map_page = mapPageOf(page.page_number());
+      if (!readImage(map_page, map.data(), Page::SIZE)) map.fill(0);
+    }
+    map[page.page_number() - map_page - 1] = freeSpaceCategory(page);
+
+    PageHeader stamped = page.header_;
+    stamped.checksum = page.computeChecksum(stamped);
+    writeImage(page.page_number(), reinterpret_cast<const char *>(&stamped),
+               sizeof(PageHeader), &page.data_[0], Page::DATA_SIZE);
+  }
+  writeImage(map_page, map.data(), Page::SIZE);
+  writeHeader(header);
+}
+
+PageId PageFile::findPageWithSpace(const std::size_t record_size) const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  // a record may need a new slot as well
+  const std::size_t category =
+      (record_size + sizeof(PageSlot) + FSM_CATEGORY_SIZE - 1) /
+      FSM_CATEGORY_SIZE;
+  if (category > 255) return Page::INVALID_NUMBER;
+
+  const PageId num_pages = readHeader().num_pages;
+  if (fsm_cursor_ == Page::INVALID_NUMBER || fsm_cursor_ >= num_pages) {
+    fsm_cursor_ = 1;
+  }
+  // search from the cursor to the end of the file, then from the start
+  const PageId bounds[][2] = {{fsm_cursor_, num_pages}, {1, fsm_cursor_}};
+  PageImage map;
+  for (const PageId *bound : bounds) {
+    PageId page_number = bound[0];
+    while (page_number < bound[1]) {
+      const PageId map_page = mapPageOf(page_number);
+      const PageId map_end = std::min(bound[1], map_page + MAP_STRIDE);
+      if (!readImage(map_page, map.data(), Page::SIZE)) break;
+      for (; page_number < map_end; ++page_number) {
+        if (page_number != map_page &&
+            static_cast<unsigned char>(map[page_number - map_page - 1]) >=
+                category) {
+          fsm_cursor_ = page_number;
+          return page_number;
+        }
+      }
+    }
+  }
+  return Page::INVALID_NUMBER;
+}
+
+RecordId PageFile::insertRecord(const std::string &record_data) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  PageId page_number = findPageWithSpace(record_data.length());
+  Page page;
+  if (page_number == Page::INVALID_NUMBER) {
+    allocatePage(page_number, page);
+  } else {
+    readPage(page_number, page);
+  }
+  const RecordId record_id = page.insertRecord(record_data);
+  writePage(page_number, page);
+  return record_id;
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&header), sizeof(PageHeader));
+  readImage(page_number, reinterpret_cast<char *>(&header), sizeof(PageHeader));
   return header;
 }
 
@@ -338,34 +950,50 @@ BlobFile &BlobFile::operator=(const BlobFile &rhs) {
 }
 
 Page BlobFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
   Page new_page;
+  allocatePage(new_page_number, new_page);
+  return new_page;
+}
+
+void BlobFile::allocatePage(PageId &new_page_number, Page &new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader header = readHeader();
+  new_page.initialize();
 
   new_page_number = header.num_pages;
 
   if (header.first_used_page == Page::INVALID_NUMBER) {
     header.first_used_page = header.num_pages;
   }
+  header.last_used_page = new_page_number;
 
   ++header.num_pages;
 
   writePage(new_page_number, new_page);
   writeHeader(header);
-
-  return new_page;
 }
 
 Page BlobFile::readPage(const PageId page_number) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&page), Page::SIZE);
+  readPage(page_number, page);
   return page;
 }
 
+void BlobFile::readPage(const PageId page_number, Page &page) const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  // blob pages are stored as they are laid out in memory
+  if (!readImage(page_number, reinterpret_cast<char *>(&page), Page::SIZE)) {
+    page.initialize();
+  }
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page &new_page) {
-  stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char *>(&new_page), Page::SIZE);
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  // the checksum is written in place of the end of the page
+  const std::uint32_t checksum = new_page.computeChecksum();
+  writeImage(new_page_number, reinterpret_cast<const char *>(&new_page),
+             Page::BLOB_SIZE, reinterpret_cast<const char *>(&checksum),
+             sizeof(checksum));
 }
 
 // delePage should not be called for a blob_file, not supported
@@ -373,4 +1001,377 @@ void BlobFile::deletePage(const PageId page_number) {
   throw InvalidPageException(page_number, filename_);
 }
 
+MappedBlobFile MappedBlobFile::create(const std::string &filename) {
+  return MappedBlobFile(filename, true /* create_new */);
+}
+
+MappedBlobFile MappedBlobFile::open(const std::string &filename) {
+  return MappedBlobFile(filename, false /* create_new */);
+}
+
+MappedBlobFile::MappedBlobFile(const std::string &name, const bool create_new)
+    : File(name, create_new), fd_(-1), map_(nullptr), map_length_(0) {
+  map();
+}
+
+MappedBlobFile::~MappedBlobFile() { unmap(); }
+
+MappedBlobFile::MappedBlobFile(const MappedBlobFile &other)
+    : File(other.filename_, false /* create_new */),
+      fd_(-1),
+      map_(nullptr),
+      map_length_(0) {
+  map();
+}
+
+MappedBlobFile &MappedBlobFile::operator=(const MappedBlobFile &rhs) {
+  // This accounts for self-assignment and assignment of a File object for the
+  // same file.
+  unmap();
+  close();  // close my file and associate me with the new one
+  filename_ = rhs.filename_;
+  openIfNeeded(false /* create_new */);
+  map();
+  return *this;
+}
+
+void MappedBlobFile::map() {
+  if (compressed()) {
+    // compressed pages have no place of their own to map
+    throw FileMapException(filename_);
+  }
+  fd_ = ::open(filename_.c_str(), O_RDWR);
+  if (fd_ < 0) {
+    throw FileMapException(filename_);
+  }
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  cover(Page::INVALID_NUMBER);
+}
+
+void MappedBlobFile::unmap() {
+  if (map_ != nullptr) munmap(map_, map_length_);
+  if (fd_ >= 0) ::close(fd_);
+  map_ = nullptr;
+  map_length_ = 0;
+  fd_ = -1;
+}
+
+void MappedBlobFile::cover(const PageId page_number) const {
+  if (map_ != nullptr &&
+      map_length_ >= static_cast<std::size_t>(pagePosition(page_number + 1))) {
+    return;
+  }
+  const std::size_t num_pages =
+      (page_number / MAPPED_FILE_CHUNK_PAGES + 1) * MAPPED_FILE_CHUNK_PAGES;
+  const std::size_t length = pagePosition(num_pages);
+  void *region =
+      mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (region == MAP_FAILED) {
+    throw FileMapException(filename_);
+  }
+  if (map_ != nullptr) munmap(map_, map_length_);
+  map_ = static_cast<char *>(region);
+  map_length_ = length;
+}
+
+Page MappedBlobFile::allocatePage(PageId &new_page_number) {
+  Page new_page;
+  allocatePage(new_page_number, new_page);
+  return new_page;
+}
+
+void MappedBlobFile::allocatePage(PageId &new_page_number, Page &new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  new_page_number = header()->num_pages;
+  if (ftruncate(fd_, pagePosition(new_page_number + 1)) != 0) {
+    throw FileMapException(filename_);
+  }
+  cover(new_page_number);
+
+  FileHeader *file_header = header();
+  if (file_header->first_used_page == Page::INVALID_NUMBER) {
+    file_header->first_used_page = file_header->num_pages;
+  }
+  file_header->last_used_page = new_page_number;
+  ++file_header->num_pages;
+
+  new_page.initialize();
+  writeMapped(new_page_number, new_page);
+}
+
+Page MappedBlobFile::readPage(const PageId page_number) const {
+  Page page;
+  readPage(page_number, page);
+  return page;
+}
+
+void MappedBlobFile::readPage(const PageId page_number, Page &page) const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  if (page_number == Page::INVALID_NUMBER ||
+      page_number >= header()->num_pages) {
+    page.initialize();
+    return;
+  }
+  // another object for this file may have grown it past our mapping
+  cover(page_number);
+  memcpy(&page, map_ + pagePosition(page_number), Page::SIZE);
+}
+
+void MappedBlobFile::writePage(const PageId page_number, const Page &new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  if (page_number == Page::INVALID_NUMBER ||
+      page_number >= header()->num_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  cover(page_number);
+  writeMapped(page_number, new_page);
+}
+
+void MappedBlobFile::writeMapped(const PageId page_number, const Page &page) {
+  char *mapped = map_ + pagePosition(page_number);
+  memcpy(mapped, &page, Page::BLOB_SIZE);
+  const std::uint32_t checksum = page.computeChecksum();
+  memcpy(mapped + Page::BLOB_SIZE, &checksum, sizeof(checksum));
+}
+
+// deletePage is not supported for a blob file
+void MappedBlobFile::deletePage(const PageId page_number) {
+  throw InvalidPageException(page_number, filename_);
+}
+
+void MappedBlobFile::sync() {
+  {
+    std::lock_guard<std::recursive_mutex> guard(*latch_);
+    const PageId num_pages = header()->num_pages;
+    cover(num_pages - 1);
+    msync(map_, pagePosition(num_pages), MS_SYNC);
+  }
+  File::sync();
+}
+
+namespace {
+
+// a page in memory aligned for direct I/O
+struct alignas(DIRECT_IO_ALIGNMENT) AlignedPage {
+  char bytes[Page::SIZE];
+};
+
+bool isAligned(const void *address) {
+  return reinterpret_cast<std::uintptr_t>(address) % DIRECT_IO_ALIGNMENT == 0;
+}
+
+// pages in memory aligned for direct I/O, as many as a batch needs
+struct AlignedPages {
+  explicit AlignedPages(std::size_t count)
+      : bytes(static_cast<char *>(
+            aligned_alloc(DIRECT_IO_ALIGNMENT,
+                          std::max<std::size_t>(count, 1) * Page::SIZE))) {
+    if (bytes == NULL) throw std::bad_alloc();
+  }
+  ~AlignedPages() { free(bytes); }
+  char *page(std::size_t i) { return bytes + i * Page::SIZE; }
+  char *bytes;
+};
+
+}
+
+DirectBlobFile DirectBlobFile::create(const std::string &filename) {
+  return DirectBlobFile(filename, true /* create_new */);
+}
+
+DirectBlobFile DirectBlobFile::open(const std::string &filename) {
+  return DirectBlobFile(filename, false /* create_new */);
+}
+
+DirectBlobFile::DirectBlobFile(const std::string &name, const bool create_new)
+    : File(name, create_new), fd_(-1), engine_(&IoEngine::standard()) {
+  openDirect();
+}
+
+DirectBlobFile::~DirectBlobFile() { closeDirect(); }
+
+DirectBlobFile::DirectBlobFile(const DirectBlobFile &other)
+    : File(other.filename_, false /* create_new */),
+      fd_(-1),
+      engine_(other.engine_) {
+  openDirect();
+}
+
+DirectBlobFile &DirectBlobFile::operator=(const DirectBlobFile &rhs) {
+  // This accounts for self-assignment and assignment of a File object for the
+  // same file.
+  closeDirect();
+  close();  // close my file and associate me with the new one
+  filename_ = rhs.filename_;
+  engine_ = rhs.engine_;
+  openIfNeeded(false /* create_new */);
+  openDirect();
+  return *this;
+}
+
+void DirectBlobFile::openDirect() {
+  fd_ = ::open(filename_.c_str(), O_RDWR | O_DIRECT);
+  if (fd_ < 0) {
+    throw FileIOException(filename_);
+  }
+}
+
+void DirectBlobFile::closeDirect() {
+  if (fd_ >= 0) ::close(fd_);
+  fd_ = -1;
+}
+
+Page DirectBlobFile::allocatePage(PageId &new_page_number) {
+  Page new_page;
+  allocatePage(new_page_number, new_page);
+  return new_page;
+}
+
+void DirectBlobFile::allocatePage(PageId &new_page_number, Page &new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader header = readHeader();
+  new_page.initialize();
+
+  new_page_number = header.num_pages;
+
+  if (header.first_used_page == Page::INVALID_NUMBER) {
+    header.first_used_page = header.num_pages;
+  }
+  header.last_used_page = new_page_number;
+
+  ++header.num_pages;
+
+  writePage(new_page_number, new_page);
+  writeHeader(header);
+}
+
+Page DirectBlobFile::readPage(const PageId page_number) const {
+  Page page;
+  readPage(page_number, page);
+  return page;
+}
+
+void DirectBlobFile::readPage(const PageId page_number, Page &page) const {
+  if (pending_->compressed) {
+    std::lock_guard<std::recursive_mutex> guard(*latch_);
+    if (!readImage(page_number, reinterpret_cast<char *>(&page), Page::SIZE)) {
+      page.initialize();
+    }
+    return;
+  }
+  if (page_number == Page::INVALID_NUMBER) {
+    page.initialize();
+    return;
+  }
+  TRACE_SCOPE("read", "file", "page", page_number, "bytes", Page::SIZE);
+  AlignedPage copy;
+  char *target = isAligned(&page) ? reinterpret_cast<char *>(&page)
+                                  : copy.bytes;
+  const ssize_t bytes =
+      pread(fd_, target, Page::SIZE, pagePosition(page_number));
+  if (bytes < 0) {
+    throw FileIOException(filename_);
+  }
+  // a page past the end of the file reads short
+  if (bytes < static_cast<ssize_t>(Page::SIZE)) {
+    page.initialize();
+    return;
+  }
+  if (target == copy.bytes) memcpy(&page, copy.bytes, Page::SIZE);
+}
+
+void DirectBlobFile::writePage(const PageId page_number, const Page &new_page) {
+  if (pending_->compressed) {
+    std::lock_guard<std::recursive_mutex> guard(*latch_);
+    const std::uint32_t checksum = new_page.computeChecksum();
+    writeImage(page_number, reinterpret_cast<const char *>(&new_page),
+               Page::BLOB_SIZE, reinterpret_cast<const char *>(&checksum),
+               sizeof(checksum));
+    return;
+  }
+  // the checksum is written in place of the end of the page
+  TRACE_SCOPE("write", "file", "page", page_number, "bytes", Page::SIZE);
+  AlignedPage copy;
+  memcpy(copy.bytes, &new_page, Page::BLOB_SIZE);
+  const std::uint32_t checksum = new_page.computeChecksum();
+  memcpy(copy.bytes + Page::BLOB_SIZE, &checksum, sizeof(checksum));
+  if (pwrite(fd_, copy.bytes, Page::SIZE, pagePosition(page_number)) !=
+      static_cast<ssize_t>(Page::SIZE)) {
+    throw FileIOException(filename_);
+  }
+}
+
+void DirectBlobFile::readPages(const std::vector<PageId> &page_numbers,
+                               const std::vector<Page *> &pages) const {
+  if (pending_->compressed) {
+    File::readPages(page_numbers, pages);
+    return;
+  }
+  TRACE_SCOPE("readPages", "file", "pages", page_numbers.size(), NULL, 0);
+  // pages in memory not aligned are read into aligned copies
+  std::size_t num_copies = 0;
+  for (const Page *page : pages) num_copies += !isAligned(page);
+  AlignedPages copies(num_copies);
+  std::vector<IoRequest> requests;
+  std::vector<std::size_t> requested;
+  std::size_t next_copy = 0;
+  for (std::size_t i = 0; i < page_numbers.size(); i++) {
+    if (page_numbers[i] == Page::INVALID_NUMBER) {
+      pages[i]->initialize();
+      continue;
+    }
+    char *target = isAligned(pages[i]) ? reinterpret_cast<char *>(pages[i])
+                                       : copies.page(next_copy++);
+    requests.push_back({fd_, static_cast<std::uint64_t>(
+                                 pagePosition(page_numbers[i])),
+                        target, Page::SIZE, false /* write */, 0});
+    requested.push_back(i);
+  }
+  engine_->run(requests);
+  for (std::size_t r = 0; r < requests.size(); r++) {
+    Page &page = *pages[requested[r]];
+    if (requests[r].result < 0) {
+      throw FileIOException(filename_);
+    }
+    // a page past the end of the file reads short
+    if (requests[r].result < static_cast<std::int64_t>(Page::SIZE)) {
+      page.initialize();
+    } else if (requests[r].data != reinterpret_cast<char *>(&page)) {
+      memcpy(&page, requests[r].data, Page::SIZE);
+    }
+  }
+}
+
+void DirectBlobFile::writePages(const std::vector<PageId> &page_numbers,
+                                const std::vector<const Page *> &pages) {
+  if (pending_->compressed) {
+    File::writePages(page_numbers, pages);
+    return;
+  }
+  // the checksum is written in place of the end of each page
+  TRACE_SCOPE("writePages", "file", "pages", pages.size(), NULL, 0);
+  AlignedPages copies(pages.size());
+  std::vector<IoRequest> requests;
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    char *copy = copies.page(i);
+    memcpy(copy, pages[i], Page::BLOB_SIZE);
+    const std::uint32_t checksum = pages[i]->computeChecksum();
+    memcpy(copy + Page::BLOB_SIZE, &checksum, sizeof(checksum));
+    requests.push_back({fd_, static_cast<std::uint64_t>(
+                                 pagePosition(page_numbers[i])),
+                        copy, Page::SIZE, true /* write */, 0});
+  }
+  engine_->run(requests);
+  for (const IoRequest &request : requests) {
+    if (request.result != static_cast<std::int64_t>(Page::SIZE)) {
+      throw FileIOException(filename_);
+    }
+  }
+}
+
+// deletePage is not supported for a blob file
+void DirectBlobFile::deletePage(const PageId page_number) {
+  throw InvalidPageException(page_number, filename_);
+}
+
 }  // namespace badgerdb
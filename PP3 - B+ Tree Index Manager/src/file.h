@@ -8,11 +8,19 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <fstream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "arena.h"
+#include "io.h"
 #include "page.h"
 
 namespace badgerdb {
@@ -43,6 +51,23 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Page number of the last used page in the file.
+   */
+  PageId last_used_page;
+
+  /**
+   * Nonzero if the pages are stored compressed, see File::compress().
+   */
+  std::uint32_t compressed;
+
+  /**
+   * Size in bytes of the pages of the file, Page::SIZE when it was created;
+   * 0 in files created before the size was recorded, whose pages are of
+   * 8192 bytes.
+   */
+  std::uint32_t page_size;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,10 +77,164 @@ struct FileHeader {
   bool operator==(const FileHeader &rhs) const {
     return num_pages == rhs.num_pages && num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        last_used_page == rhs.last_used_page &&
+        compressed == rhs.compressed && page_size == rhs.page_size;
   }
 };
 
+/**
+ * Number of deferred page writes of a file at which the write-behind flusher
+ * is woken.
+ */
+const std::size_t WRITE_BEHIND_BATCH = 64;
+
+/**
+ * Number of deferred page writes of a file at which the writer writes them out
+ * itself instead of waiting for the flusher.
+ */
+const std::size_t WRITE_BEHIND_LIMIT = 1024;
+
+/**
+ * Interval in milliseconds at which the flusher writes out deferred writes
+ * that have not filled a batch.
+ */
+const int WRITE_BEHIND_INTERVAL_MS = 50;
+
+/**
+ * Bytes of free space one step of a free-space map entry stands for.
+ */
+const std::size_t FSM_CATEGORY_SIZE = 32;
+
+/**
+ * Number of pages by which a MappedBlobFile grows its mapping.
+ */
+const std::size_t MAPPED_FILE_CHUNK_PAGES = 256;
+
+/**
+ * Alignment of the offset, length and memory of each direct read or write.
+ */
+const std::size_t DIRECT_IO_ALIGNMENT = 4096;
+
+/**
+ * Bytes of compressed pages a compressed file gathers before writing them out
+ * together.
+ */
+const std::size_t COMPRESSED_EXTENT_SIZE = 256 << 10;
+
+/**
+ * Bytes of a page as stored in a file.
+ */
+typedef std::array<char, Page::SIZE> PageImage;
+
+/**
+ * @brief Where the compressed image of a page lies in a compressed file.
+ */
+struct PageLocation {
+  /**
+   * Offset of the image from the beginning of the file.
+   */
+  std::uint64_t offset;
+
+  /**
+   * Bytes of the image; Page::SIZE for a page stored as it is, 0 for a page
+   * never written.
+   */
+  std::uint32_t length;
+
+  std::uint32_t unused;
+};
+
+/**
+ * @brief Header of a compressed file, following its FileHeader.
+ */
+struct CompressedHeader {
+  /**
+   * Offset of the page map, the PageLocation of each page by number, or 0
+   * before it is first written.
+   */
+  std::uint64_t map_offset;
+
+  /**
+   * Number of entries of the page map.
+   */
+  std::uint64_t map_entries;
+};
+
+/**
+ * @brief Page map and unwritten pages of a compressed file.
+ */
+struct CompressedPages {
+  /**
+   * Location of each page by number.
+   */
+  std::vector<PageLocation> locations;
+
+  /**
+   * Whether locations changed since the map was last written.
+   */
+  bool map_dirty = false;
+
+  /**
+   * Compressed images not written yet, which go to the file at extent_offset.
+   */
+  std::vector<char> extent;
+  std::uint64_t extent_offset = sizeof(FileHeader) + sizeof(CompressedHeader);
+
+  /**
+   * Bytes of the images the map points to.
+   */
+  std::uint64_t stored_bytes = 0;
+};
+
+/**
+ * @brief Writes of a file in write-behind mode not yet handed to its stream.
+ */
+struct PendingWrites {
+  /**
+   * Whether writes to the file are deferred.
+   */
+  bool enabled = false;
+
+  /**
+   * Whether header holds a header not yet written.
+   */
+  bool header_dirty = false;
+
+  /**
+   * Latest header written to the file.
+   */
+  FileHeader header;
+
+  typedef std::map<PageId, PageImage, std::less<PageId>,
+                   PoolAllocator<std::pair<const PageId, PageImage>>>
+      PageMap;
+
+  /**
+   * Nodes of pages written out, reused for the next pages deferred so that
+   * deferring a page does not allocate a page image
+   */
+  FreeList freePages{WRITE_BEHIND_BATCH};
+
+  /**
+   * Latest image of every page written, ordered by page number and hence by
+   * offset in the file.
+   */
+  PageMap pages{std::less<PageId>(),
+                PageMap::allocator_type(freePages)};
+
+  /**
+   * Run of consecutive pages gathered to be written with a single call, kept
+   * for the next runs so that it is allocated once.
+   */
+  std::vector<char> run;
+
+  /**
+   * Page map of a compressed file, whose pages are never deferred, or null.
+   */
+  std::unique_ptr<CompressedPages> compressed;
+};
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
@@ -65,11 +244,32 @@ struct FileHeader {
  * deleted pages if possible).  If multiple File objects refer to the same
  * underlying file, they will share the stream in memory.
  * If a file that has already been opened (possibly by another query), then the
- * File class detects this (by looking in the open_streams_ map) and just
- * returns a file object with the already created stream for the file without
- * actually opening the UNIX file again.
+ * File class detects this (by looking up the device and inode of the file in
+ * a registry of open files) and just returns a file object with the already
+ * created stream for the file without actually opening the UNIX file again.
+ * Each File object has its own FileId, by which the buffer pool keys the pages
+ * read through it.
  *
- * @warning This class is not threadsafe.
+ * File objects for the same file also share a latch which is held for every
+ * operation on the shared stream, so one file may be read and written from
+ * several threads.  Iterators over a file are not threadsafe.
+ *
+ * By default every write is flushed to the operating system before it
+ * returns.  In write-behind mode writes are kept in memory instead, repeated
+ * writes of a page replacing each other; a background flusher writes them out
+ * in page order, flushing the stream once per batch.  sync() is the
+ * durability point of a file in this mode.
+ *
+ * The pages of a compressed file, made by compress(), are stored compressed
+ * in the LZ4 block format, or as they are if that does not make them
+ * smaller, and packed one after the other.  A page map gives the location of
+ * each.  Written pages are gathered into extents of COMPRESSED_EXTENT_SIZE
+ * bytes written at the end of the file, so that rewriting a page leaves its
+ * former image behind until the file is compressed again; compression suits
+ * files mostly read.  The map is kept in memory and written at the end of the
+ * file on sync() and close, where the header is then pointed to it once it is
+ * on disk, so that a crash goes back to the pages as of the last sync.
+ * Readers of a compressed file see the pages as they were written.
  */
 
 class File {
@@ -83,6 +283,8 @@ class File {
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  PageSizeException       If the underlying file exists with pages
+   *                                  of another size than Page::SIZE.
    */
   File(const std::string &name, const bool create_new);
 
@@ -103,12 +305,29 @@ class File {
   static bool isOpen(const std::string &filename);
 
   /**
-   * Returns true if the file exists and is open.
+   * Returns true if the file exists, checked by stat() without opening it.
    *
    * @param filename  Name of the file.
    */
   static bool exists(const std::string &filename);
 
+  /**
+   * Writes out the deferred writes of every open file in write-behind mode and
+   * forces those files to stable storage.
+   */
+  static void syncAll();
+
+  /**
+   * Rewrites a file that is not open with its pages compressed.  Rewriting a
+   * compressed file drops the images of its pages that were replaced.  Either
+   * kind of file is opened by the same classes as before.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the file doesn't exist.
+   * @throws  FileOpenException       If the file is currently open.
+   */
+  static void compress(const std::string &filename);
+
   /**
    * Destructor that automatically closes the underlying file if no other
    * File objects are using it.
@@ -122,6 +341,14 @@ class File {
    */
   virtual Page allocatePage(PageId &new_page_number) = 0;
 
+  /**
+   * Allocates a new page in the file, building it in place.
+   *
+   * @param new_page_number   Number of the new page is returned here.
+   * @param new_page          Page to hold the new page.
+   */
+  virtual void allocatePage(PageId &new_page_number, Page &new_page) = 0;
+
   /**
    * Reads an existing page from the file.
    *
@@ -132,6 +359,16 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file straight into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into, e.g. a buffer pool frame.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPage(const PageId page_number, Page &page) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -141,6 +378,26 @@ class File {
    */
   virtual void writePage(const PageId page_number, const Page &new_page) = 0;
 
+  /**
+   * Reads several pages, each as readPage() would.  Files doing their own
+   * I/O run the reads as one batch.
+   *
+   * @param page_numbers  Numbers of the pages to read.
+   * @param pages         Pages to read into, one per page number.
+   */
+  virtual void readPages(const std::vector<PageId> &page_numbers,
+                         const std::vector<Page *> &pages) const;
+
+  /**
+   * Writes several pages, each as writePage() would.  Files doing their own
+   * I/O run the writes as one batch.
+   *
+   * @param page_numbers  Numbers of the pages to write, all different.
+   * @param pages         Pages to write, one per page number.
+   */
+  virtual void writePages(const std::vector<PageId> &page_numbers,
+                          const std::vector<const Page *> &pages);
+
   /**
    * Deletes a page from the file.
    *
@@ -155,6 +412,12 @@ class File {
    */
   const std::string &filename() const { return filename_; }
 
+  /**
+   * Returns the identifier of this object, which the buffer pool keys the
+   * pages read through it on.
+   */
+  FileId id() const { return id_; }
+
   /**
    * Returns pageid of first page in the file.
    *
@@ -162,16 +425,56 @@ class File {
    */
   PageId getFirstPageNo();
 
+  /**
+   * Returns the number of pages allocated in the file, the header included,
+   * so that pages are numbered below it.  Some of them may be free.
+   *
+   * @return  Number of pages allocated.
+   */
+  PageId getNumPages();
+
+  /**
+   * Turns write-behind mode on or off for this file, including the other
+   * File objects sharing its stream.  Turning it off writes out the deferred
+   * writes.
+   *
+   * @param enabled   Whether writes are to be deferred.
+   */
+  void setWriteBehind(const bool enabled);
+
+  /**
+   * Returns true if writes to this file are deferred.
+   */
+  bool writeBehind() const;
+
+  /**
+   * Returns true if the pages of this file are stored compressed.
+   */
+  bool compressed() const;
+
+  /**
+   * Returns the bytes the images of the pages take in the file: compressed,
+   * in a compressed file, without those of pages since replaced.
+   */
+  std::uint64_t storedBytes() const;
+
+  /**
+   * Writes out the deferred writes of this file and forces the file to stable
+   * storage.
+   */
+  virtual void sync();
+
  protected:
   /**
    * Returns the position of the page with the given number in the file (as an
-   * offset from the beginning of the file).
+   * offset from the beginning of the file).  The header takes the place of
+   * page 0, so that every page is aligned for direct I/O.
    *
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
   static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+    return static_cast<std::streamoff>(page_number) * Page::SIZE;
   }
 
   /**
@@ -184,6 +487,8 @@ class File {
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  PageSizeException       If the underlying file exists with pages
+   *                                  of another size than Page::SIZE.
    */
   void openIfNeeded(const bool create_new);
 
@@ -208,32 +513,229 @@ class File {
    */
   void writeHeader(const FileHeader &header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
-  typedef std::map<std::string, int> CountMap;
+  /**
+   * Writes a page whose image is the head bytes followed by the tail bytes,
+   * or defers the write in write-behind mode.  The caller holds latch_.
+   *
+   * @param page_number Number of page whose contents to replace.
+   * @param head        Start of the image.
+   * @param head_size   Number of bytes at head.
+   * @param tail        Rest of the image.
+   * @param tail_size   Number of bytes at tail.
+   */
+  void writeImage(const PageId page_number, const char *head,
+                  const std::size_t head_size, const char *tail = nullptr,
+                  const std::size_t tail_size = 0);
+
+  /**
+   * Reads the leading bytes of the image of a page into head and tail,
+   * taking a deferred write of the page into account.  The caller holds
+   * latch_.
+   *
+   * @param page_number   Number of page to read.
+   * @param head          Where to read the first head_size bytes to.
+   * @param head_size     Number of bytes to read to head.
+   * @param tail          Where to read the next tail_size bytes to.
+   * @param tail_size     Number of bytes to read to tail.
+   * @return  False if the page lies outside the file; head and tail are then
+   *          not to be used, but the stream stays usable.
+   */
+  bool readImage(const PageId page_number, char *head,
+                 const std::size_t head_size, char *tail = nullptr,
+                 const std::size_t tail_size = 0) const;
+
+  /**
+   * Writes out deferred writes in page order and flushes the stream.  The
+   * caller holds the latch of the file.
+   *
+   * @param stream    Stream of the file.
+   * @param pending   Deferred writes of the file.
+   */
+  static void writePending(std::fstream &stream, PendingWrites &pending);
+
+  /**
+   * Compresses a page into the extent of a compressed file, writing out the
+   * extent first if it is full.  The caller holds latch_.
+   */
+  void writeCompressed(const PageId page_number, const char *head,
+                       const std::size_t head_size, const char *tail,
+                       const std::size_t tail_size);
+
+  /**
+   * Reads the image of a page of a compressed file into head and tail.  The
+   * caller holds latch_.
+   *
+   * @return  False if the page was never written.
+   * @throws  CorruptPageException  If the image can not be decompressed.
+   */
+  bool readCompressed(const PageId page_number, char *head,
+                      const std::size_t head_size, char *tail,
+                      const std::size_t tail_size) const;
+
+  /**
+   * Checks that the pages of the file are of Page::SIZE bytes when it is
+   * first opened.
+   *
+   * @throws PageSizeException If they are not
+   */
+  void checkPageSize();
+
+  /**
+   * Reads the page map of a compressed file when it is first opened.
+   */
+  void loadCompressed();
+
+  /**
+   * Writes out the extent of a compressed file.  The caller holds the latch
+   * of the file.
+   *
+   * @param stream      Stream of the file.
+   * @param compressed  Page map of the file.
+   */
+  static void writeExtent(std::fstream &stream, CompressedPages &compressed);
+
+  /**
+   * Writes out the extent and the page map of a compressed file, forces them
+   * to disk and points the header to the map.  The caller holds the latch of
+   * the file.
+   *
+   * @param stream      Stream of the file.
+   * @param filename    Name of the file.
+   * @param compressed  Page map of the file.
+   */
+  static void writeMap(std::fstream &stream, const std::string &filename,
+                       CompressedPages &compressed);
+
+  /**
+   * Forces the named file to stable storage.
+   *
+   * @param filename  Name of the file.
+   */
+  static void syncToDisk(const std::string &filename);
+
+  /**
+   * Starts the write-behind flusher unless it is running.
+   */
+  static void startFlusher();
+
+  /**
+   * Writes out the deferred writes of every open file in write-behind mode.
+   *
+   * @param durable   Whether to also force the files to stable storage.
+   */
+  static void writeAllPending(const bool durable);
+
+  /**
+   * Device and inode of a file on disk, which name it whatever path it is
+   * opened by.
+   */
+  struct FileKey {
+    std::uint64_t device;
+    std::uint64_t inode;
+
+    bool operator==(const FileKey &rhs) const {
+      return device == rhs.device && inode == rhs.inode;
+    }
+  };
+
+  struct FileKeyHash {
+    std::size_t operator()(const FileKey &key) const {
+      return (key.inode ^ key.device * 0x9e3779b97f4a7c15ULL) *
+             0xbf58476d1ce4e5b9ULL >> 32;
+    }
+  };
+
+  /**
+   * A file opened by one or more File objects, under one or more names.
+   */
+  struct OpenFile {
+    FileKey key;
+    std::string filename;
+    std::vector<std::string> names;
+    std::shared_ptr<std::fstream> stream;
+    std::shared_ptr<std::recursive_mutex> latch;
+    std::shared_ptr<PendingWrites> pending;
+    int count;
+  };
+
+  typedef std::unordered_map<FileKey, std::shared_ptr<OpenFile>, FileKeyHash>
+      OpenFileMap;
+  typedef std::unordered_map<std::string, std::shared_ptr<OpenFile> >
+      OpenNameMap;
+
+  /**
+   * Looks up the device and inode of the named file.
+   *
+   * @param filename  Name of the file.
+   * @param key       Set to the device and inode if the file exists.
+   * @return  False if the file does not exist.
+   */
+  static bool statFile(const std::string &filename, FileKey &key);
+
+  /**
+   * Opened files, by device and inode.
+   */
+  static OpenFileMap open_files_;
+
+  /**
+   * Opened files, by the names they were opened under, so that opening an
+   * open file again needs no stat().
+   */
+  static OpenNameMap open_names_;
 
   /**
-   * Streams for opened files.
+   * Protects open_files_, open_names_ and the counts of their entries.
    */
-  static StreamMap open_streams_;
+  static std::mutex open_files_mutex_;
 
   /**
-   * Counts for opened files.
+   * Identifier given to the next File object opened.
    */
-  static CountMap open_counts_;
+  static std::atomic<FileId> next_id_;
 
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
+  /**
+   * Identifier of this object; 0 while it is not open.
+   */
+  FileId id_ = 0;
+
+  /**
+   * Entry of open_files_ for the file; shared by all objects for this file.
+   */
+  std::shared_ptr<OpenFile> open_;
+
   /**
    * Stream for underlying filesystem object.
    */
   std::shared_ptr<std::fstream> stream_;
 
+  /**
+   * Latch held while using stream_; shared by all objects for this file.
+   */
+  std::shared_ptr<std::recursive_mutex> latch_;
+
+  /**
+   * Deferred writes, guarded by latch_; shared by all objects for this file.
+   */
+  std::shared_ptr<PendingWrites> pending_;
+
   friend class FileIterator;
 };
 
+/**
+ * @brief File of slotted pages kept on a linked list in page order.
+ *
+ * Page 1 and every (Page::SIZE + 1)-th page after it hold the free-space map
+ * of the Page::SIZE pages that follow: one byte per page giving its free space
+ * in units of FSM_CATEGORY_SIZE bytes, rounded down.  Map pages are not on the
+ * used list and cannot be read, written or deleted.  Every write of a page
+ * updates its map entry, so the map tracks the file rather than copies of
+ * pages held elsewhere, e.g. in a buffer pool.
+ */
 class PageFile : public File {
  public:
   /**
@@ -248,11 +750,10 @@ class PageFile : public File {
    * Opens the file named fileName and returns the corresponding File object.
    * It first checks if the file is already open. If so, then the new File
    * object created uses the same input-output stream to read to or write fom
-   * that already open file. Reference count (open_counts_ static variable
-   * inside the File object) is incremented whenever an already open file is
-   * opened again. Otherwise the UNIX file is actually opened. The fileName and
-   * the stream associated with this File object are inserted into the
-   * open_streams_ map.
+   * that already open file. Its reference count, in the registry of open
+   * files, is incremented whenever an already open file is opened again.
+   * Otherwise the UNIX file is actually opened and entered in the registry
+   * under its device and inode.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -300,6 +801,14 @@ class PageFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, building it in place.
+   *
+   * @param new_page_number   Number of the new page is returned here.
+   * @param new_page          Page to hold the new page.
+   */
+  void allocatePage(PageId &new_page_number, Page &new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -310,6 +819,16 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page &page) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -326,6 +845,38 @@ class PageFile : public File {
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Finds a used page with room for a record of the given size according to
+   * the free-space map.  The search resumes where the last one of this object
+   * succeeded and wraps around, so filling a file is amortized constant time.
+   *
+   * @param record_size   Length of the record in bytes.
+   * @return  Number of the page, or Page::INVALID_NUMBER if no page has room.
+   */
+  PageId findPageWithSpace(const std::size_t record_size) const;
+
+  /**
+   * Inserts a record into a page with room for it, allocating a page if none
+   * has room.  The page is read and written directly, bypassing any buffer
+   * pool.
+   *
+   * @param record_data   Bytes of the record.
+   * @return  ID of the record.
+   * @throws  InsufficientSpaceException  If the record does not fit on an
+   *                                      empty page.
+   */
+  RecordId insertRecord(const std::string &record_data);
+
+  /**
+   * Appends filled pages at the end of the file, past any free page, in the
+   * given order.  The pages are numbered and chained here, the previous last
+   * page is linked to them once, each free-space map page is written once and
+   * the file header once, so a load costs about one write per page.
+   *
+   * @param pages   Pages to append; their numbers are set to those given.
+   */
+  void appendPages(std::vector<Page> &pages);
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -346,16 +897,17 @@ class PageFile : public File {
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file is read
+   * as a fresh page.
    *
    * @param page_number   Number of page to read.
+   * @param page          Page to read into.
    * @param allow_free    Whether to allow reading a free (unused) page.
-   * @return  The page.
    * @throws  InvalidPageException  If the page is free (unused) and
    *                                allow_free is false.
    */
-  Page readPage(const PageId page_number, const bool allow_free) const;
+  void readPage(const PageId page_number, Page &page,
+                const bool allow_free) const;
 
   /**
    * Writes a page into the file at the given page number with the given header.
@@ -378,6 +930,55 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Number of pages from one free-space map page to the next.
+   */
+  static const PageId MAP_STRIDE = Page::SIZE + 1;
+
+  /**
+   * Returns true if the given page holds free-space map entries.
+   */
+  static bool isMapPage(const PageId page_number) {
+    return page_number != Page::INVALID_NUMBER &&
+        (page_number - 1) % MAP_STRIDE == 0;
+  }
+
+  /**
+   * Returns the free-space map page holding the entry of the given page.
+   */
+  static PageId mapPageOf(const PageId page_number) {
+    return page_number - (page_number - 1) % MAP_STRIDE;
+  }
+
+  /**
+   * Returns the page before the given one that is not a map page, or
+   * Page::INVALID_NUMBER if there is none.
+   */
+  static PageId previousDataPage(const PageId page_number) {
+    PageId previous_page_number = page_number - 1;
+    if (isMapPage(previous_page_number)) --previous_page_number;
+    return previous_page_number;
+  }
+
+  /**
+   * Updates the free-space map entry of a page being written.  The caller
+   * holds latch_.
+   *
+   * @param page_number   Number of page being written.
+   * @param page          Page being written.
+   */
+  void updateFreeSpace(const PageId page_number, const Page &page);
+
+  /**
+   * Returns the free-space map entry of a page.
+   */
+  static char freeSpaceCategory(const Page &page);
+
+  /**
+   * Page the next free-space search starts at.
+   */
+  mutable PageId fsm_cursor_;
+
   friend class FileIterator;
 };
 
@@ -395,11 +996,10 @@ class BlobFile : public File {
    * Opens the file named fileName and returns the corresponding File object.
    * It first checks if the file is already open. If so, then the new File
    * object created uses the same input-output stream to read to or write fom
-   * that already open file. Reference count (open_counts_ static variable
-   * inside the File object) is incremented whenever an already open file is
-   * opened again. Otherwise the UNIX file is actually opened. The fileName and
-   * the stream associated with this File object are inserted into the
-   * open_streams_ map.
+   * that already open file. Its reference count, in the registry of open
+   * files, is incremented whenever an already open file is opened again.
+   * Otherwise the UNIX file is actually opened and entered in the registry
+   * under its device and inode.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -449,6 +1049,14 @@ class BlobFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, building it in place.
+   *
+   * @param new_page_number   Number of the new page is returned here.
+   * @param new_page          Page to hold the new page.
+   */
+  void allocatePage(PageId &new_page_number, Page &new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -459,6 +1067,16 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page &page) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -476,4 +1094,345 @@ class BlobFile : public File {
   void deletePage(const PageId page_number);
 };
 
+/**
+ * @brief BlobFile whose pages are read and written through a shared memory
+ *        mapping of the file instead of its stream.
+ *
+ * The file format is that of BlobFile, so either class can open a file written
+ * by the other.  Reads copy a page straight out of the mapping and writes copy
+ * it straight in, leaving write-back to the operating system; sync() forces
+ * the mapping to disk.  allocatePage extends the file by one page and the
+ * mapping, which may reach past the end of the file, in chunks of
+ * MAPPED_FILE_CHUNK_PAGES pages.  Write-behind mode has no effect.  A
+ * compressed file (File::compress) can not be mapped.
+ */
+class MappedBlobFile : public File {
+ public:
+  /**
+   * Creates a new MappedBlobFile.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileExistsException     If the requested file already exists.
+   */
+  static MappedBlobFile create(const std::string &filename);
+
+  /**
+   * Opens the file named fileName and returns the corresponding File object.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileMapException        If the file is compressed.
+   */
+  static MappedBlobFile open(const std::string &filename);
+
+  /**
+   * Constructs a file object representing a file on the filesystem and maps
+   * the file.
+   *
+   * @param name        Name of file.
+   * @param create_new  Whether to create a new file.
+   * @throws  FileExistsException     If the underlying file exists and
+   *                                  create_new is true.
+   * @throws  FileNotFoundException   If the underlying file doesn't exist and
+   *                                  create_new is false.
+   */
+  MappedBlobFile(const std::string &name, const bool create_new);
+
+  /**
+   * Copy constructor.
+   *
+   * @param other File object to copy.
+   * @return      A copy of the File object.
+   */
+  MappedBlobFile(const MappedBlobFile &other);
+
+  /**
+   * Assignment operator.
+   *
+   * @param rhs File object to assign.
+   * @return    Newly assigned file object.
+   */
+  MappedBlobFile &operator=(const MappedBlobFile &rhs);
+
+  /**
+   * Destructor that unmaps the file and closes the underlying file if no other
+   * File objects are using it.
+   */
+  ~MappedBlobFile();
+
+  /**
+   * Allocates a new page at the end of the file.
+   *
+   * @return The new page.
+   */
+  Page allocatePage(PageId &new_page_number);
+
+  /**
+   * Allocates a new page at the end of the file, building it in place.
+   *
+   * @param new_page_number   Number of the new page is returned here.
+   * @param new_page          Page to hold the new page.
+   */
+  void allocatePage(PageId &new_page_number, Page &new_page);
+
+  /**
+   * Reads an existing page from the file.
+   *
+   * @param page_number   Number of page to read.
+   * @return  The page; a fresh page if page_number lies outside the file.
+   */
+  Page readPage(const PageId page_number) const;
+
+  /**
+   * Copies an existing page out of the mapping into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into; a fresh page if page_number lies
+   *                      outside the file.
+   */
+  void readPage(const PageId page_number, Page &page) const;
+
+  /**
+   * Writes a page into the file at the given page number.
+   *
+   * @param page_number Number of page whose contents to replace.
+   * @param new_page    Page to write.
+   * @throws  InvalidPageException  If the page lies outside the file.
+   */
+  void writePage(const PageId page_number, const Page &new_page);
+
+  /**
+   * Deletes a page from the file.
+   *
+   * @param page_number   Number of page to delete.
+   */
+  void deletePage(const PageId page_number);
+
+  /**
+   * Forces the mapped pages and the file to stable storage.
+   */
+  void sync();
+
+ private:
+  /**
+   * Opens a descriptor for the file and maps it.
+   */
+  void map();
+
+  /**
+   * Unmaps the file and closes the descriptor.
+   */
+  void unmap();
+
+  /**
+   * Grows the mapping to cover the given page.  The caller holds latch_.
+   *
+   * @param page_number   Number of page to cover.
+   */
+  void cover(const PageId page_number) const;
+
+  /**
+   * Copies a page into the mapping with its checksum.  The caller holds
+   * latch_ and has covered the page.
+   *
+   * @param page_number   Number of page to write.
+   * @param page          Page to write.
+   */
+  void writeMapped(const PageId page_number, const Page &page);
+
+  /**
+   * Header of the file inside the mapping.  The caller holds latch_.
+   */
+  FileHeader *header() const { return reinterpret_cast<FileHeader *>(map_); }
+
+  /**
+   * Descriptor the file is mapped through.
+   */
+  int fd_;
+
+  /**
+   * Start of the mapping.
+   */
+  mutable char *map_;
+
+  /**
+   * Length of the mapping in bytes.
+   */
+  mutable std::size_t map_length_;
+};
+
+/**
+ * @brief BlobFile whose pages are read and written with direct I/O, bypassing
+ *        the operating system's page cache.
+ *
+ * The file format is that of BlobFile, so either class can open a file written
+ * by the other.  Pages are read and written with pread and pwrite through a
+ * descriptor opened with O_DIRECT, so that a buffer pool reading through it
+ * is the only cache of the file.  A page read into memory aligned to
+ * DIRECT_IO_ALIGNMENT, such as a buffer pool frame, is read straight into
+ * place; other pages, and every page written, since the checksum has to be
+ * added, go through an aligned copy.  The header is read and written through
+ * the stream.  Reads and writes of pages do not hold the latch of the file, so
+ * threads reading different pages do so in parallel.  Write-behind mode has
+ * no effect, and the pages of a compressed file (File::compress) are read and
+ * written through the stream.
+ *
+ * readPages and writePages run their pages as one batch on an I/O engine,
+ * by default IoEngine::standard(), each page at its own offset.
+ */
+class DirectBlobFile : public File {
+ public:
+  /**
+   * Creates a new DirectBlobFile.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileExistsException     If the requested file already exists.
+   * @throws  FileIOException         If the file does not allow direct I/O.
+   */
+  static DirectBlobFile create(const std::string &filename);
+
+  /**
+   * Opens the file named fileName and returns the corresponding File object.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileIOException         If the file does not allow direct I/O.
+   */
+  static DirectBlobFile open(const std::string &filename);
+
+  /**
+   * Constructs a file object representing a file on the filesystem and opens
+   * a descriptor for direct I/O on it.
+   *
+   * @param name        Name of file.
+   * @param create_new  Whether to create a new file.
+   * @throws  FileExistsException     If the underlying file exists and
+   *                                  create_new is true.
+   * @throws  FileNotFoundException   If the underlying file doesn't exist and
+   *                                  create_new is false.
+   * @throws  FileIOException         If the file does not allow direct I/O.
+   */
+  DirectBlobFile(const std::string &name, const bool create_new);
+
+  /**
+   * Copy constructor.
+   *
+   * @param other File object to copy.
+   * @return      A copy of the File object.
+   */
+  DirectBlobFile(const DirectBlobFile &other);
+
+  /**
+   * Assignment operator.
+   *
+   * @param rhs File object to assign.
+   * @return    Newly assigned file object.
+   */
+  DirectBlobFile &operator=(const DirectBlobFile &rhs);
+
+  /**
+   * Destructor that closes the descriptor, and the underlying file if no
+   * other File objects are using it.
+   */
+  ~DirectBlobFile();
+
+  /**
+   * Allocates a new page in the file.
+   *
+   * @return The new page.
+   */
+  Page allocatePage(PageId &new_page_number);
+
+  /**
+   * Allocates a new page in the file, building it in place.
+   *
+   * @param new_page_number   Number of the new page is returned here.
+   * @param new_page          Page to hold the new page.
+   */
+  void allocatePage(PageId &new_page_number, Page &new_page);
+
+  /**
+   * Reads an existing page from the file.
+   *
+   * @param page_number   Number of page to read.
+   * @return  The page; a fresh page if page_number lies outside the file.
+   */
+  Page readPage(const PageId page_number) const;
+
+  /**
+   * Reads an existing page from the file into the given page, straight into
+   * it if it is aligned to DIRECT_IO_ALIGNMENT.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into; a fresh page if page_number lies
+   *                      outside the file.
+   * @throws  FileIOException  If the page can not be read.
+   */
+  void readPage(const PageId page_number, Page &page) const;
+
+  /**
+   * Writes a page into the file at the given page number.
+   *
+   * @param page_number Number of page whose contents to replace.
+   * @param new_page    Page to write.
+   * @throws  FileIOException  If the page can not be written.
+   */
+  void writePage(const PageId page_number, const Page &new_page);
+
+  /**
+   * Reads several pages as one batch on the I/O engine.
+   *
+   * @param page_numbers  Numbers of the pages to read.
+   * @param pages         Pages to read into, one per page number.
+   * @throws  FileIOException  If a page can not be read.
+   */
+  void readPages(const std::vector<PageId> &page_numbers,
+                 const std::vector<Page *> &pages) const;
+
+  /**
+   * Writes several pages as one batch on the I/O engine.
+   *
+   * @param page_numbers  Numbers of the pages to write, all different.
+   * @param pages         Pages to write, one per page number.
+   * @throws  FileIOException  If a page can not be written.
+   */
+  void writePages(const std::vector<PageId> &page_numbers,
+                  const std::vector<const Page *> &pages);
+
+  /**
+   * Deletes a page from the file.
+   *
+   * @param page_number   Number of page to delete.
+   */
+  void deletePage(const PageId page_number);
+
+  /**
+   * Sets the engine batches of pages run on.
+   *
+   * @param engine  Engine, which must outlive this object
+   */
+  void setIoEngine(IoEngine &engine) { engine_ = &engine; }
+
+ private:
+  /**
+   * Opens the descriptor for direct I/O.
+   */
+  void openDirect();
+
+  /**
+   * Closes the descriptor.
+   */
+  void closeDirect();
+
+  /**
+   * Descriptor the pages are read and written through.
+   */
+  int fd_;
+
+  /**
+   * Engine batches of pages run on.
+   */
+  IoEngine *engine_;
+};
+
 }  // namespace badgerdb
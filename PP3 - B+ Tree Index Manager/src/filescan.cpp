@@ -6,56 +6,126 @@
  */
 
 #include "filescan.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include "arena.h"
 #include "exceptions/end_of_file_exception.h"
 
 namespace badgerdb {
 
-FileScan::FileScan(const std::string &name, BufMgr *bufferMgr) {
-  file = new PageFile(name, false);    //dont create new file
+// pages of a relation are chained in the order FileIterator visits them
+static PageId nextUsedPage(const Page &page) {
+  return page.next_page_number();
+}
+
+ScanPredicate::ScanPredicate(int offset, Datatype attrType, Operator oper,
+                             const void *constant)
+    : byteOffset(offset), type(attrType), op(oper) {
+  const char *bytes = (const char *)constant;
+  switch (type) {
+    case INTEGER:
+      value.assign(bytes, sizeof(int));
+      break;
+    case DOUBLE:
+      value.assign(bytes, sizeof(double));
+      break;
+    case STRING:
+      value.assign(bytes);
+      break;
+  }
+}
+
+// copies the attribute of each record into an array, and drops the records
+// too short to hold it
+template <class V>
+static const V *gatherValues(const std::vector<RecordView> &views,
+                             int byteOffset, std::vector<char> &values,
+                             std::uint8_t *keep) {
+  values.resize(views.size() * sizeof(V));
+  V *out = (V *)values.data();
+  for (std::size_t k = 0; k < views.size(); k++) {
+    if (views[k].length >= byteOffset + sizeof(V)) {
+      memcpy(&out[k], views[k].data + byteOffset, sizeof(V));
+    } else {
+      out[k] = V();
+      keep[k] = 0;
+    }
+  }
+  return out;
+}
+
+FileScan::FileScan(const std::string &name, BufMgr *bufferMgr,
+                   AccessHint accessHint)
+    : file(name, false) {  // dont create new file
   bufMgr = bufferMgr;
-  curDirtyFlag = false;
-  curPage = NULL;
-  filePageIter = file->begin();
+  hint = accessHint;
+  matchPos = 0;
+  filePageIter = file.begin();
+}
+
+FileScan::FileScan(const std::string &name, BufMgr *bufferMgr,
+                   const std::vector<ScanPredicate> &scanPredicates,
+                   AccessHint accessHint)
+    : FileScan(name, bufferMgr, accessHint) {
+  predicates = scanPredicates;
 }
 
 FileScan::~FileScan() {
   // generally must unpin last page of the scan
-  if (curPage != NULL) {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-    curDirtyFlag = false;
-    filePageIter = file->begin();
-  }
-  bufMgr->flushFile(file);
-  delete file;
+  curPage.release();
+  bufMgr->flushFile(&file);
 }
 
 void FileScan::scanNext(RecordId &outRid) {
-  std::string rec;
-
-  if (filePageIter == file->end()) {
+  if (filePageIter == file.end()) {
     throw EndOfFileException();
   }
 
+  if (!predicates.empty()) {
+    if (!curPage) {
+      // read the first page of the file
+      filePageIter = file.begin();
+      if (filePageIter == file.end()) {
+        throw EndOfFileException();
+      }
+      readFilteredPage((*filePageIter).page_number());
+    } else {
+      matchPos++;
+    }
+
+    while (matchPos == matches.size()) {
+      curPage.release();
+
+      filePageIter++;
+      if (filePageIter == file.end()) {
+        throw EndOfFileException();
+      }
+      readFilteredPage((*filePageIter).page_number());
+    }
+
+    outRid = {curPage->page_number(), matches[matchPos]};
+    pageRecordIter = PageIterator(curPage.get(), outRid);
+    return;
+  }
+
   // special case of the first record of the first page of the file
-  if (curPage == NULL) {
+  if (!curPage) {
     // need to get the first page of the file
-    filePageIter = file->begin();
-    if (filePageIter == file->end()) {
+    filePageIter = file.begin();
+    if (filePageIter == file.end()) {
       throw EndOfFileException();
     }
 
     // read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
-    curDirtyFlag = false;
+    curPage = bufMgr->pin(&file, (*filePageIter).page_number(), hint);
+    bufMgr->prefetch(&file, curPage->next_page_number(), nextUsedPage, hint);
 
     // get the first record off the page
     pageRecordIter = curPage->begin();
 
     if (pageRecordIter != curPage->end()) {
-      // get pointer to record
-      rec = *pageRecordIter;
-
       outRid = pageRecordIter.getCurrentRecord();
       return;
     }
@@ -67,28 +137,22 @@ void FileScan::scanNext(RecordId &outRid) {
 
   while (pageRecordIter == curPage->end()) {
     // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-    curDirtyFlag = false;
+    curPage.release();
 
     filePageIter++;
-    if (filePageIter == file->end()) {
-      curPage = NULL;
+    if (filePageIter == file.end()) {
       throw EndOfFileException();
     }
 
     // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    curPage = bufMgr->pin(&file, (*filePageIter).page_number(), hint);
+    bufMgr->prefetch(&file, curPage->next_page_number(), nextUsedPage, hint);
 
     // get the first record off the page
     pageRecordIter = curPage->begin();
   }
 
   // curRec points at a valid record
-  // see if the record satisfies the scan's predicate
-  // get a pointer to the record
-  rec = *pageRecordIter;
-
   // return rid of the record
   outRid = pageRecordIter.getCurrentRecord();
   return;
@@ -100,9 +164,306 @@ std::string FileScan::getRecord() {
   return *pageRecordIter;
 }
 
+// returns the current record without a copy; the view is valid until the
+// next call to scanNext
+RecordView FileScan::getRecordView() {
+  return pageRecordIter.view();
+}
+
+std::size_t FileScan::nextBatch(TupleBatch &batch) {
+  batch.clear();
+  RecordId rid;
+  try {
+    while (!batch.full()) {
+      // the next record is found as by scanNext(), and the records after it
+      // on its page are added along with it
+      scanNext(rid);
+      const std::size_t room = TupleBatch::CAPACITY - batch.numRows();
+      batchRids.assign(1, rid);
+      batchViews.assign(1, pageRecordIter.view());
+      if (predicates.empty()) {
+        PageIterator next = pageRecordIter;
+        while (batchRids.size() < room && ++next != curPage->end()) {
+          pageRecordIter = next;
+          batchRids.push_back(next.getCurrentRecord());
+          batchViews.push_back(next.view());
+        }
+      } else {
+        while (batchRids.size() < room && matchPos + 1 < matches.size()) {
+          matchPos++;
+          batchRids.push_back({curPage->page_number(), matches[matchPos]});
+          batchViews.push_back(views[matchPos]);
+        }
+        pageRecordIter = PageIterator(curPage.get(), batchRids.back());
+      }
+      batch.append(batchRids.data(), batchViews.data(), batchRids.size());
+    }
+  } catch (const EndOfFileException &e) {
+  }
+  return batch.numRows();
+}
+
 // mark current page of scan dirty
 void FileScan::markDirty() {
-  curDirtyFlag = true;
+  curPage.markDirty();
+}
+
+void FileScan::readFilteredPage(PageId pageNo) {
+  curPage = bufMgr->pin(&file, pageNo, hint);
+  bufMgr->prefetch(&file, curPage->next_page_number(), nextUsedPage, hint);
+
+  matches.clear();
+  views.clear();
+  for (PageIterator it = curPage->begin(); it != curPage->end(); ++it) {
+    matches.push_back(it.getCurrentRecord().slot_number);
+    views.push_back(it.view());
+  }
+  for (const ScanPredicate &predicate : predicates) {
+    if (matches.empty()) break;
+    applyPredicate(predicate);
+  }
+  matchPos = 0;
+}
+
+void FileScan::applyPredicate(const ScanPredicate &predicate) {
+  const std::size_t n = matches.size();
+  keep.assign(n, 1);
+  switch (predicate.type) {
+    case INTEGER: {
+      int constant;
+      memcpy(&constant, predicate.value.data(), sizeof(int));
+      const int *column = gatherValues<int>(views, predicate.byteOffset,
+                                            values, keep.data());
+      compareValues(column, n, predicate.op, constant, keep.data());
+      break;
+    }
+    case DOUBLE: {
+      double constant;
+      memcpy(&constant, predicate.value.data(), sizeof(double));
+      const double *column = gatherValues<double>(views, predicate.byteOffset,
+                                                  values, keep.data());
+      compareValues(column, n, predicate.op, constant, keep.data());
+      break;
+    }
+    case STRING: {
+      // strings are compared one record at a time, as -1, 0 or 1
+      const std::size_t length = predicate.value.size();
+      values.resize(n * sizeof(int));
+      int *order = (int *)values.data();
+      for (std::size_t k = 0; k < n; k++) {
+        if (views[k].length >= predicate.byteOffset + length) {
+          const int c = memcmp(views[k].data + predicate.byteOffset,
+                               predicate.value.data(), length);
+          order[k] = (c > 0) - (c < 0);
+        } else {
+          order[k] = 0;
+          keep[k] = 0;
+        }
+      }
+      compareValues(order, n, predicate.op, 0, keep.data());
+      break;
+    }
+  }
+
+  // keep the matches which satisfy the predicate, in order
+  std::size_t kept = 0;
+  for (std::size_t k = 0; k < n; k++) {
+    matches[kept] = matches[k];
+    views[kept] = views[k];
+    kept += keep[k];
+  }
+  matches.resize(kept);
+  views.resize(kept);
+}
+
+HeapFetch::HeapFetch(const std::string &name, BufMgr *bufferMgr,
+                     AccessHint accessHint)
+    : file(name, false) {  // dont create new file
+  bufMgr = bufferMgr;
+  hint = accessHint;
+  pagesRead = 0;
+}
+
+HeapFetch::~HeapFetch() {
+  bufMgr->flushFile(&file);
+}
+
+void HeapFetch::fetch(
+    const std::vector<RecordId> &rids,
+    const std::function<void(const RecordId &, const RecordView &)> &fn,
+    FetchOrder order) {
+  // the temporaries of the call live in the arena of the thread, so that
+  // repeated fetches allocate nothing
+  Arena &arena = Arena::local();
+  Arena::Scope scope(arena);
+
+  // the positions of the record ids given, sorted by page and slot, equal
+  // ones by position
+  ArenaVector<std::size_t> positions(rids.size(), 0,
+                                     ArenaAllocator<std::size_t>(arena));
+  for (std::size_t k = 0; k < rids.size(); k++) positions[k] = k;
+  auto ridLess = [&rids](std::size_t a, std::size_t b) {
+    if (rids[a].page_number != rids[b].page_number)
+      return rids[a].page_number < rids[b].page_number;
+    if (rids[a].slot_number != rids[b].slot_number)
+      return rids[a].slot_number < rids[b].slot_number;
+    return a < b;
+  };
+  std::sort(positions.begin(), positions.end(), ridLess);
+
+  // in GIVEN_ORDER, the records are copied into a buffer, each once, and the
+  // record of each position is found by its offset and length in it
+  typedef std::pair<std::size_t, std::size_t> Extent;
+  ArenaVector<char> copies{ArenaAllocator<char>(arena)};
+  ArenaVector<Extent> recordOf{ArenaAllocator<Extent>(arena)};
+  if (order == GIVEN_ORDER) recordOf.resize(rids.size());
+
+  pagesRead = 0;
+  for (std::size_t k = 0; k < positions.size();) {
+    const PageId pageNo = rids[positions[k]].page_number;
+    // unpinned as the loop moves on, or if fn throws
+    PageHandle page = bufMgr->pin(&file, pageNo, hint);
+    pagesRead++;
+    for (; k < positions.size() && rids[positions[k]].page_number == pageNo;
+         k++) {
+      const RecordId &rid = rids[positions[k]];
+      const bool repeat = k > 0 && rids[positions[k - 1]] == rid;
+      if (order == PAGE_ORDER) {
+        if (!repeat) fn(rid, page->getRecordView(rid));
+      } else if (repeat) {
+        recordOf[positions[k]] = recordOf[positions[k - 1]];
+      } else {
+        const RecordView view = page->getRecordView(rid);
+        recordOf[positions[k]] = std::make_pair(copies.size(), view.length);
+        copies.insert(copies.end(), view.data, view.data + view.length);
+      }
+    }
+  }
+
+  if (order == GIVEN_ORDER) {
+    for (std::size_t k = 0; k < rids.size(); k++) {
+      const RecordView view = {copies.data() + recordOf[k].first,
+                               recordOf[k].second};
+      fn(rids[k], view);
+    }
+  }
+}
+
+void HeapFetch::fetch(const std::vector<RecordId> &rids, TupleBatch &batch,
+                      FetchOrder order) {
+  batch.clear();
+  fetch(rids,
+        [&batch](const RecordId &rid, const RecordView &record) {
+          batch.append(rid, record);
+        },
+        order);
+}
+
+ParallelFileScan::ParallelFileScan(const std::string &name,
+                                   BufMgr *bufferMgr, int numWorkers,
+                                   std::size_t morselPages,
+                                   AccessHint accessHint)
+    : file(name, false), queues(std::max(1, numWorkers)), steals(0) {
+  bufMgr = bufferMgr;
+  hint = accessHint;
+  morselSize = std::max<std::size_t>(1, morselPages);
+  for (FileIterator it = file.begin(); it != file.end(); ++it)
+    pageNos.push_back(it.pageNumber());
+}
+
+ParallelFileScan::~ParallelFileScan() {
+  bufMgr->flushFile(&file);
+}
+
+void ParallelFileScan::run(const std::function<void(Worker &)> &fn) {
+  // deal the morsels out evenly
+  const std::size_t numMorsels = (pageNos.size() + morselSize - 1) / morselSize;
+  const std::size_t n = queues.size();
+  for (std::size_t w = 0; w < n; w++) {
+    queues[w].next = numMorsels * w / n;
+    queues[w].end = numMorsels * (w + 1) / n;
+  }
+  steals = 0;
+
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(n);
+  for (std::size_t w = 0; w < n; w++) {
+    threads.emplace_back([this, &fn, &errors, w] {
+      try {
+        Worker worker(this, (int)w);
+        fn(worker);
+      } catch (...) {
+        errors[w] = std::current_exception();
+      }
+    });
+  }
+  for (std::thread &thread : threads) thread.join();
+  for (const std::exception_ptr &error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+}
+
+bool ParallelFileScan::nextMorsel(int worker, std::size_t &morsel) {
+  MorselQueue &own = queues[worker];
+  {
+    std::lock_guard<std::mutex> guard(own.latch);
+    if (own.next < own.end) {
+      morsel = own.next++;
+      return true;
+    }
+  }
+
+  // take the back half of the morsels of the first worker with any left
+  const int n = numWorkers();
+  for (int i = 1; i < n; i++) {
+    MorselQueue &victim = queues[(worker + i) % n];
+    std::size_t begin, end;
+    {
+      std::lock_guard<std::mutex> guard(victim.latch);
+      const std::size_t left = victim.end - victim.next;
+      if (left == 0) continue;
+      begin = victim.end - (left + 1) / 2;
+      end = victim.end;
+      victim.end = begin;
+    }
+    steals++;
+
+    std::lock_guard<std::mutex> guard(own.latch);
+    own.next = begin + 1;
+    own.end = end;
+    morsel = begin;
+    return true;
+  }
+  return false;
+}
+
+ParallelFileScan::Worker::Worker(ParallelFileScan *parallelScan, int id)
+    : scan(parallelScan), workerId(id), nextPage(0), endPage(0),
+      curPageNo(Page::INVALID_NUMBER) {}
+
+void ParallelFileScan::Worker::scanNext(RecordId &outRid) {
+  if (curPage) pageRecordIter++;
+
+  while (!curPage || pageRecordIter == curPage->end()) {
+    curPage.release();
+
+    if (nextPage == endPage) {
+      std::size_t morsel;
+      if (!scan->nextMorsel(workerId, morsel)) throw EndOfFileException();
+      nextPage = morsel * scan->morselSize;
+      endPage = std::min(scan->pageNos.size(), nextPage + scan->morselSize);
+    }
+
+    // read the next page of the morsel
+    curPageNo = scan->pageNos[nextPage++];
+    curPage = scan->bufMgr->pin(&scan->file, curPageNo, scan->hint);
+    if (nextPage < endPage)
+      scan->bufMgr->prefetch(&scan->file, curPage->next_page_number(),
+                             nextUsedPage, scan->hint);
+    pageRecordIter = curPage->begin();
+  }
+
+  outRid = pageRecordIter.getCurrentRecord();
 }
 
 }
@@ -8,8 +8,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "types.h"
+#include "batch.h"
 #include "page.h"
 #include "buffer.h"
 #include "file_iterator.h"
@@ -17,30 +22,105 @@
 
 namespace badgerdb {
 
+/**
+ * @brief A comparison of an attribute of a record with a constant.  A
+ * filtered scan returns the records which satisfy all of its predicates.
+ */
+struct ScanPredicate {
+  /**
+   * Builds a predicate.  A string attribute is compared on as many bytes as
+   * the constant has, so that a shorter constant compares with a prefix.
+   *
+   * @param byteOffset  Offset of the attribute in the record
+   * @param type        Type of the attribute
+   * @param op          Comparison of the attribute with the constant
+   * @param value       The constant: an int, a double, or a string ended by
+   *                    a zero byte
+   */
+  ScanPredicate(int byteOffset, Datatype type, Operator op, const void *value);
+
+  int byteOffset;
+  Datatype type;
+  Operator op;
+
+  /**
+   * Bytes of the constant.
+   */
+  std::string value;
+};
+
 /**
  * @brief This class is used to sequentially scan records in a relation.
  */
 class FileScan {
  public:
 
-  FileScan(const std::string &name, BufMgr *bufMgr);
+  /**
+   * Opens the relation for a scan.
+   *
+   * @param name    Name of the relation file
+   * @param bufMgr  Buffer manager to read the pages through
+   * @param hint    Access hint for the pages; by default they go through the
+   *                buffer manager's ring of sequentially read frames
+   */
+  FileScan(const std::string &name, BufMgr *bufMgr,
+           AccessHint hint = SEQUENTIAL_ACCESS);
+
+  /**
+   * Opens the relation for a scan of the records which satisfy all of the
+   * given predicates.  The predicates are evaluated on the pinned page for a
+   * whole page of records at a time, so that comparisons of int and double
+   * attributes run over arrays.
+   *
+   * @param name        Name of the relation file
+   * @param bufMgr      Buffer manager to read the pages through
+   * @param predicates  Predicates the records returned satisfy
+   * @param hint        Access hint for the pages
+   */
+  FileScan(const std::string &name, BufMgr *bufMgr,
+           const std::vector<ScanPredicate> &predicates,
+           AccessHint hint = SEQUENTIAL_ACCESS);
 
   ~FileScan();
 
   //return RecordId of next record that satisfies the scan
   void scanNext(RecordId &outRid);
 
-  //read current record, returning pointer and length
+  //read current record, returning a copy
   std::string getRecord();
 
+  //read current record, returning pointer and length into the pinned page
+  RecordView getRecordView();
+
+  /**
+   * Clears the batch and fills it with the next records of the scan, as many
+   * as it holds.
+   *
+   * @param batch  Batch the records are added to
+   * @return  Number of records added, 0 at the end of the relation
+   */
+  std::size_t nextBatch(TupleBatch &batch);
+
   //marks current page of scan dirty
   void markDirty();
 
  private:
+  /**
+   * Reads the given page as the current page, leaving the slots of its
+   * records which satisfy the predicates in matches.
+   */
+  void readFilteredPage(PageId pageNo);
+
+  /**
+   * Removes the records which do not satisfy the given predicate from
+   * matches.
+   */
+  void applyPredicate(const ScanPredicate &predicate);
+
   /**
    * File which is being scanned.
    */
-  PageFile *file;
+  PageFile file;
 
   /**
    * Buffer Manager instance used to read/write pages into/from buffer pool.
@@ -48,17 +128,260 @@ class FileScan {
   BufMgr *bufMgr;
 
   /**
-   * Current page being scanned.
+   * Current page being scanned, marked dirty once it has been updated; empty
+   * before the first page and after the last.
    */
-  Page *curPage;
+  PageHandle curPage;
 
   FileIterator filePageIter;
   PageIterator pageRecordIter;
 
   /**
-   * True if page has been updated
+   * Access hint passed with every page read
+   */
+  AccessHint hint;
+
+  /**
+   * Predicates of a filtered scan, all of which the records returned satisfy
+   */
+  std::vector<ScanPredicate> predicates;
+
+  /**
+   * Slots of the records of the current page which satisfy the predicates,
+   * and the position of the current record among them
+   */
+  std::vector<SlotId> matches;
+  std::size_t matchPos;
+
+  /**
+   * Records of the current page in the order of matches, and the values of
+   * an attribute of them, while the predicates are evaluated
+   */
+  std::vector<RecordView> views;
+  std::vector<char> values;
+  std::vector<std::uint8_t> keep;
+
+  /**
+   * Records of the current page being added to a batch
+   */
+  std::vector<RecordId> batchRids;
+  std::vector<RecordView> batchViews;
+};
+
+/**
+ * @brief Order in which HeapFetch::fetch() returns the records.
+ */
+enum FetchOrder {
+  PAGE_ORDER, /* By page and slot, each record once */
+  GIVEN_ORDER /* In the order of the record ids given, such as key order */
+};
+
+/**
+ * @brief This class is used to fetch the records of a list of record ids, such
+ * as those an index scan returns, from a relation.
+ *
+ * The record ids are sorted by page first, so that each page of the relation
+ * is read and pinned once however many of the records are on it.  Records
+ * are returned in page order straight off the pinned pages, or in the order
+ * of the record ids given through a buffer of copies.
+ */
+class HeapFetch {
+ public:
+  /**
+   * Opens the relation to fetch records from.
+   *
+   * @param name    Name of the relation file
+   * @param bufMgr  Buffer manager to read the pages through
+   * @param hint    Access hint for the pages
+   */
+  HeapFetch(const std::string &name, BufMgr *bufMgr,
+            AccessHint hint = NORMAL_ACCESS);
+
+  ~HeapFetch();
+
+  /**
+   * Calls fn with the record of each record id.  In PAGE_ORDER the view
+   * points into the pinned page, and a record id given more than once is
+   * returned once; in GIVEN_ORDER it points into a copy, and every record id
+   * given is returned.  The view is valid until fn returns.
+   *
+   * @param rids    Record ids of the records
+   * @param fn      Called with each record id and its record
+   * @param order   Order in which the records are returned
+   */
+  void fetch(const std::vector<RecordId> &rids,
+             const std::function<void(const RecordId &, const RecordView &)>
+                 &fn,
+             FetchOrder order = PAGE_ORDER);
+
+  /**
+   * Clears the batch and adds the record of each record id to it, in the
+   * given order.  At most TupleBatch::CAPACITY record ids are given.
+   *
+   * @param rids    Record ids of the records
+   * @param batch   Batch the records are added to
+   * @param order   Order in which the records are added
+   */
+  void fetch(const std::vector<RecordId> &rids, TupleBatch &batch,
+             FetchOrder order = PAGE_ORDER);
+
+  //number of pages read by the last fetch
+  std::size_t numPagesRead() const { return pagesRead; }
+
+ private:
+  /**
+   * File records are fetched from.
+   */
+  PageFile file;
+
+  /**
+   * Buffer Manager instance used to read pages into the buffer pool.
+   */
+  BufMgr *bufMgr;
+
+  /**
+   * Access hint passed with every page read
+   */
+  AccessHint hint;
+
+  std::size_t pagesRead;
+};
+
+/**
+ * @brief This class is used to scan the records of a relation on several
+ * threads at once.
+ *
+ * The pages of the relation are split into morsels of a few consecutive
+ * pages, which are dealt out evenly to the workers when a scan is run.  A
+ * worker that has run out of morsels takes half of those another worker has
+ * left, so that a worker held up by slow pages does not hold up the scan.
+ * The buffer manager must be concurrent.
+ */
+class ParallelFileScan {
+ public:
+  /**
+   * @brief The part of a scan run on one thread.  Each worker has a page of
+   * its own pinned while it returns the records of that page.
+   */
+  class Worker {
+   public:
+    //return RecordId of next record of the morsels of this worker
+    void scanNext(RecordId &outRid);
+
+    //read current record, returning pointer and length into the pinned page
+    RecordView getRecordView() { return pageRecordIter.view(); }
+
+    //number of this worker, from 0
+    int id() const { return workerId; }
+
+   private:
+    friend class ParallelFileScan;
+
+    Worker(ParallelFileScan *scan, int id);
+
+    /**
+     * Scan the worker belongs to.
+     */
+    ParallelFileScan *scan;
+
+    int workerId;
+
+    /**
+     * Positions in the page list of the next and past the last page of the
+     * current morsel.
+     */
+    std::size_t nextPage, endPage;
+
+    /**
+     * Current page being scanned, or empty.
+     */
+    PageHandle curPage;
+
+    PageId curPageNo;
+    PageIterator pageRecordIter;
+  };
+
+  /**
+   * Opens the relation for a scan.
+   *
+   * @param name        Name of the relation file
+   * @param bufMgr      Concurrent buffer manager to read the pages through
+   * @param numWorkers  Number of threads a scan runs on
+   * @param morselSize  Number of consecutive pages in a morsel
+   * @param hint        Access hint for the pages
+   */
+  ParallelFileScan(const std::string &name, BufMgr *bufMgr, int numWorkers,
+                   std::size_t morselSize = 16,
+                   AccessHint hint = SEQUENTIAL_ACCESS);
+
+  ~ParallelFileScan();
+
+  /**
+   * Runs fn on a worker of its own on each of numWorkers threads, and waits
+   * for all of them.  Every record of the relation is returned to exactly
+   * one of the workers.  The first exception thrown by fn on any thread is
+   * then rethrown.
+   *
+   * @param fn  Scan of one worker, which calls scanNext until it throws
+   *            EndOfFileException
+   */
+  void run(const std::function<void(Worker &)> &fn);
+
+  //number of threads a scan runs on
+  int numWorkers() const { return (int)queues.size(); }
+
+  //number of morsel ranges taken from another worker by the last scan
+  std::size_t numSteals() const { return steals; }
+
+ private:
+  /**
+   * @brief The morsels a worker has left, as a range of morsel numbers.  The
+   * worker takes them from the front and other workers from the back.
+   */
+  struct MorselQueue {
+    std::mutex latch;
+    std::size_t next;
+    std::size_t end;
+  };
+
+  /**
+   * Takes the next morsel for the given worker, from another worker if it
+   * has none left.
+   *
+   * @param worker  Number of the worker
+   * @param morsel  Set to the number of the morsel
+   * @return  False if no worker has a morsel left
+   */
+  bool nextMorsel(int worker, std::size_t &morsel);
+
+  /**
+   * File which is being scanned.
+   */
+  PageFile file;
+
+  /**
+   * Buffer Manager instance used to read pages into the buffer pool.
+   */
+  BufMgr *bufMgr;
+
+  /**
+   * Page numbers of the relation in the order of its page list.
+   */
+  std::vector<PageId> pageNos;
+
+  std::size_t morselSize;
+
+  /**
+   * Morsels left to each worker.
+   */
+  std::vector<MorselQueue> queues;
+
+  std::atomic<std::size_t> steals;
+
+  /**
+   * Access hint passed with every page read
    */
-  bool curDirtyFlag;
+  AccessHint hint;
 };
 
 }
@@ -0,0 +1,456 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "hash_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include "btree.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "filescan.h"
+
+namespace badgerdb {
+
+namespace {
+
+// Number of page numbers of the directory stored in a page, after the number
+// of the next page
+const std::size_t DIRECTORY_PAGE_SLOTS =
+    (Page::BLOB_SIZE - sizeof(PageId)) / sizeof(PageId);
+
+// Bytes of the record id of an entry: its page number, then its slot number
+const std::size_t STORED_RID_SIZE = sizeof(PageId) + sizeof(SlotId);
+
+}  // namespace
+
+HashIndex::HashIndex(const std::string &relationName,
+                     std::string &outIndexName, BufMgr *bufMgrIn,
+                     const int attrByteOffset, const Datatype attrType)
+    : bufMgr(bufMgrIn) {
+  if (bufMgr->getLog() != NULL)
+    throw BadIndexInfoException("a hash index can not be logged");
+  keySize = attrType == INTEGER  ? sizeof(int)
+            : attrType == DOUBLE ? sizeof(double)
+                                 : STRINGSIZE;
+  entrySize = keySize + STORED_RID_SIZE;
+  bucketCapacity = (Page::BLOB_SIZE - sizeof(HashBucket)) / entrySize;
+
+  outIndexName =
+      relationName + ',' + std::to_string(attrByteOffset) + ",hash";
+  relationName.copy(indexMetaInfo.relationName, 20, 0);
+  indexMetaInfo.attrByteOffset = attrByteOffset;
+  indexMetaInfo.attrType = attrType;
+
+  if (File::exists(outIndexName)) {
+    file = new BlobFile(outIndexName, false);
+    file->setWriteBehind(true);
+
+    // the meta page is always the first page of the index file
+    headerPageNum = file->getFirstPageNo();
+    std::string reason;
+    {
+      PageHandle header = bufMgr->pin(file, headerPageNum);
+      const HashIndexMetaInfo *meta = header.as<HashIndexMetaInfo>();
+      if (strncmp(meta->relationName, indexMetaInfo.relationName, 20) != 0)
+        reason = "relation name does not match";
+      else if (meta->attrByteOffset != attrByteOffset)
+        reason = "attribute byte offset does not match";
+      else if (meta->attrType != attrType)
+        reason = "attribute type does not match";
+      indexMetaInfo = *meta;
+    }
+    if (!reason.empty()) {
+      bufMgr->flushFile(file);
+      delete file;
+      throw BadIndexInfoException(reason);
+    }
+    readDirectory();
+    return;
+  }
+
+  // index pages are written out in batches; the destructor syncs the file
+  file = new BlobFile(outIndexName, true);
+  file->setWriteBehind(true);
+  {
+    PageHandle header = bufMgr->pinNew(file, headerPageNum);
+    header.markDirty();
+  }
+
+  // a single empty bucket, which all keys agree on no bits with
+  PageId bucketPageNo;
+  {
+    PageHandle bucket = allocBucketPage(bucketPageNo);
+    bucket.markDirty();
+  }
+  directory.push_back(bucketPageNo);
+
+  FileScan fscan(relationName, bufMgr);
+  try {
+    RecordId scanRid;
+    while (1) {
+      fscan.scanNext(scanRid);
+      insertEntry(fscan.getRecordView().data + attrByteOffset, scanRid);
+    }
+  } catch (EndOfFileException e) {
+  }
+  writeDirectory();
+}
+
+HashIndex::~HashIndex() {
+  writeDirectory();
+  bufMgr->flushFile(file);
+  file->sync();
+  delete file;
+}
+
+void HashIndex::insertEntry(const void *key, const RecordId rid) {
+  char stored[std::max<std::size_t>(sizeof(double), STRINGSIZE)];
+  normalizeKey(key, stored);
+  const std::uint64_t hash = hashKey(stored);
+
+  while (true) {
+    const std::size_t slot =
+        hash & ((std::uint64_t(1) << indexMetaInfo.globalDepth) - 1);
+    PageHandle primary = bufMgr->pin(file, directory[slot]);
+    HashBucket *bucket = primary.as<HashBucket>();
+    PageHandle tail;
+    HashBucket *last = bucket;
+    if (bucket->tailPageNo != Page::INVALID_NUMBER) {
+      tail = bufMgr->pin(file, bucket->tailPageNo);
+      last = tail.as<HashBucket>();
+    }
+    const bool empty =
+        bucket->numEntries == 0 && bucket->tailPageNo == Page::INVALID_NUMBER;
+    const bool sameKey = bucket->numEntries > 0 &&
+                         memcmp(entryAt(bucket, 0), stored, keySize) == 0;
+
+    if (last->numEntries < bucketCapacity) {
+      addEntry(last, stored, rid);
+      bucket->singleKey = empty || (bucket->singleKey && sameKey);
+      primary.markDirty();
+      if (tail) tail.markDirty();
+      indexMetaInfo.numEntries++;
+      return;
+    }
+
+    // a split makes room unless every entry has this key
+    if (bucket->localDepth < HASH_MAX_DEPTH && !(bucket->singleKey && sameKey)) {
+      tail.release();
+      primary.release();
+      splitBucket(slot);
+      continue;
+    }
+
+    PageId overflowPageNo;
+    PageHandle overflow = allocBucketPage(overflowPageNo);
+    addEntry(overflow.as<HashBucket>(), stored, rid);
+    overflow.markDirty();
+    last->overflowPageNo = overflowPageNo;
+    bucket->tailPageNo = overflowPageNo;
+    bucket->singleKey = bucket->singleKey && sameKey;
+    primary.markDirty();
+    if (tail) tail.markDirty();
+    indexMetaInfo.numEntries++;
+    return;
+  }
+}
+
+void HashIndex::deleteEntry(const void *key, const RecordId rid) {
+  char stored[std::max<std::size_t>(sizeof(double), STRINGSIZE)];
+  normalizeKey(key, stored);
+  const std::uint64_t hash = hashKey(stored);
+  const std::size_t slot =
+      hash & ((std::uint64_t(1) << indexMetaInfo.globalDepth) - 1);
+
+  PageHandle primary = bufMgr->pin(file, directory[slot]);
+  HashBucket *bucket = primary.as<HashBucket>();
+  PageHandle current;
+  HashBucket *page = bucket;
+  while (true) {
+    for (int i = findEntry(page, stored); i < page->numEntries; i++) {
+      char *entry = entryAt(page, i);
+      if (memcmp(entry, stored, keySize) != 0) break;
+      PageId pageNo;
+      SlotId slotNo;
+      memcpy(&pageNo, entry + keySize, sizeof(PageId));
+      memcpy(&slotNo, entry + keySize + sizeof(PageId), sizeof(SlotId));
+      if (pageNo != rid.page_number || slotNo != rid.slot_number) continue;
+      page->numEntries--;
+      memmove(entry, entry + entrySize, (page->numEntries - i) * entrySize);
+      // the key of the bucket is no longer known
+      if (bucket->numEntries == 0) bucket->singleKey = false;
+      if (current) current.markDirty();
+      primary.markDirty();
+      indexMetaInfo.numEntries--;
+      return;
+    }
+    if (page->overflowPageNo == Page::INVALID_NUMBER) break;
+    current = bufMgr->pin(file, page->overflowPageNo);
+    page = current.as<HashBucket>();
+  }
+  throw NoSuchKeyFoundException();
+}
+
+std::size_t HashIndex::lookup(const void *key, RecordId *outRids,
+                              const std::size_t maxRids) {
+  char stored[std::max<std::size_t>(sizeof(double), STRINGSIZE)];
+  normalizeKey(key, stored);
+  const std::uint64_t hash = hashKey(stored);
+  const std::size_t slot =
+      hash & ((std::uint64_t(1) << indexMetaInfo.globalDepth) - 1);
+
+  std::size_t found = 0;
+  PageHandle handle = bufMgr->pin(file, directory[slot]);
+  HashBucket *bucket = handle.as<HashBucket>();
+  // the overflow pages of a bucket of one other key are not read
+  if (bucket->singleKey && bucket->numEntries > 0 &&
+      memcmp(entryAt(bucket, 0), stored, keySize) != 0) {
+    return 0;
+  }
+  while (true) {
+    for (int i = findEntry(bucket, stored); i < bucket->numEntries; i++) {
+      const char *entry = entryAt(bucket, i);
+      if (memcmp(entry, stored, keySize) != 0) break;
+      if (found < maxRids) {
+        memcpy(&outRids[found].page_number, entry + keySize, sizeof(PageId));
+        memcpy(&outRids[found].slot_number, entry + keySize + sizeof(PageId),
+               sizeof(SlotId));
+      }
+      found++;
+    }
+    const PageId next = bucket->overflowPageNo;
+    if (next == Page::INVALID_NUMBER) return found;
+    handle = bufMgr->pin(file, next);
+    bucket = handle.as<HashBucket>();
+  }
+}
+
+HashIndexStats HashIndex::getStats() {
+  HashIndexStats stats = {indexMetaInfo.globalDepth, 0, 0,
+                          indexMetaInfo.numEntries};
+  std::vector<PageId> buckets(directory);
+  std::sort(buckets.begin(), buckets.end());
+  buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+  stats.buckets = buckets.size();
+  for (PageId pageNo : buckets) {
+    PageHandle handle = bufMgr->pin(file, pageNo);
+    PageId next = handle.as<HashBucket>()->overflowPageNo;
+    while (next != Page::INVALID_NUMBER) {
+      stats.overflowPages++;
+      handle = bufMgr->pin(file, next);
+      next = handle.as<HashBucket>()->overflowPageNo;
+    }
+  }
+  return stats;
+}
+
+void HashIndex::normalizeKey(const void *key, char *out) const {
+  switch (indexMetaInfo.attrType) {
+    case INTEGER:
+      memcpy(out, key, sizeof(int));
+      break;
+    case DOUBLE: {
+      double value;
+      memcpy(&value, key, sizeof(double));
+      if (value == 0) value = 0;  // -0.0 equals 0.0
+      memcpy(out, &value, sizeof(double));
+      break;
+    }
+    case STRING: {
+      // zero padded, as strncpy would
+      const char *value = static_cast<const char *>(key);
+      const std::size_t length = strnlen(value, STRINGSIZE);
+      memcpy(out, value, length);
+      memset(out + length, 0, STRINGSIZE - length);
+      break;
+    }
+  }
+}
+
+std::uint64_t HashIndex::hashKey(const char *key) const {
+  // FNV-1a, then the finalizer of MurmurHash3, since the directory is indexed
+  // by the low bits
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (std::size_t i = 0; i < keySize; i++) {
+    hash = (hash ^ static_cast<unsigned char>(key[i])) * 0x100000001b3ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+int HashIndex::findEntry(HashBucket *bucket, const char *key) const {
+  int low = 0, high = bucket->numEntries;
+  while (low < high) {
+    const int middle = (low + high) / 2;
+    if (memcmp(entryAt(bucket, middle), key, keySize) < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+void HashIndex::addEntry(HashBucket *bucket, const char *key,
+                         const RecordId &rid) const {
+  const int position = findEntry(bucket, key);
+  char *entry = entryAt(bucket, position);
+  memmove(entry + entrySize, entry, (bucket->numEntries - position) * entrySize);
+  bucket->numEntries++;
+  memcpy(entry, key, keySize);
+  memcpy(entry + keySize, &rid.page_number, sizeof(PageId));
+  memcpy(entry + keySize + sizeof(PageId), &rid.slot_number, sizeof(SlotId));
+}
+
+PageHandle HashIndex::allocBucketPage(PageId &pageNo) {
+  PageHandle handle;
+  if (indexMetaInfo.freePageNo != Page::INVALID_NUMBER) {
+    pageNo = indexMetaInfo.freePageNo;
+    handle = bufMgr->pin(file, pageNo);
+    indexMetaInfo.freePageNo = handle.as<HashBucket>()->overflowPageNo;
+  } else {
+    handle = bufMgr->pinNew(file, pageNo);
+  }
+  new (handle.get()) HashBucket();
+  return handle;
+}
+
+void HashIndex::splitBucket(std::size_t slot) {
+  const PageId oldPageNo = directory[slot];
+  int depth;
+
+  // take the entries out of the bucket, freeing its overflow pages
+  std::vector<char> entries;
+  {
+    PageHandle primary = bufMgr->pin(file, oldPageNo);
+    HashBucket *bucket = primary.as<HashBucket>();
+    depth = bucket->localDepth;
+    entries.insert(entries.end(), entryAt(bucket, 0),
+                   entryAt(bucket, bucket->numEntries));
+    PageId next = bucket->overflowPageNo;
+    while (next != Page::INVALID_NUMBER) {
+      PageHandle overflow = bufMgr->pin(file, next);
+      HashBucket *page = overflow.as<HashBucket>();
+      entries.insert(entries.end(), entryAt(page, 0),
+                     entryAt(page, page->numEntries));
+      const PageId freed = next;
+      next = page->overflowPageNo;
+      page->numEntries = 0;
+      page->overflowPageNo = indexMetaInfo.freePageNo;
+      indexMetaInfo.freePageNo = freed;
+      overflow.markDirty();
+    }
+  }
+
+  if (depth == indexMetaInfo.globalDepth) {
+    directory.insert(directory.end(), directory.begin(), directory.end());
+    indexMetaInfo.globalDepth++;
+  }
+
+  // the entries whose hash has the next bit set go to a new bucket; pages
+  // are filled with the entries in order
+  std::vector<const char *> sorted;
+  sorted.reserve(entries.size() / entrySize);
+  for (std::size_t offset = 0; offset < entries.size(); offset += entrySize)
+    sorted.push_back(&entries[offset]);
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [this](const char *a, const char *b) {
+                     return memcmp(a, b, keySize) < 0;
+                   });
+  PageId newPageNo;
+  PageHandle newPrimary = allocBucketPage(newPageNo);
+  PageHandle oldPrimary = bufMgr->pin(file, oldPageNo);
+  const PageId pageNos[2] = {oldPageNo, newPageNo};
+  PageHandle *primaries[2] = {&oldPrimary, &newPrimary};
+  for (int side = 0; side < 2; side++) {
+    HashBucket *bucket = primaries[side]->as<HashBucket>();
+    memset(bucket, 0, sizeof(HashBucket));
+    bucket->localDepth = depth + 1;
+    bucket->singleKey = true;
+    primaries[side]->markDirty();
+
+    PageHandle tail;
+    HashBucket *last = bucket;
+    for (const char *entry : sorted) {
+      if ((int)((hashKey(entry) >> depth) & 1) != side) continue;
+      if (last->numEntries == bucketCapacity) {
+        PageId overflowPageNo;
+        PageHandle overflow = allocBucketPage(overflowPageNo);
+        overflow.markDirty();
+        last->overflowPageNo = overflowPageNo;
+        bucket->tailPageNo = overflowPageNo;
+        tail = std::move(overflow);
+        last = tail.as<HashBucket>();
+      }
+      if (bucket->numEntries > 0 &&
+          memcmp(entryAt(bucket, 0), entry, keySize) != 0) {
+        bucket->singleKey = false;
+      }
+      memcpy(entryAt(last, last->numEntries++), entry, entrySize);
+    }
+  }
+
+  // the slots that agree with this one on the old bits are shared by the two
+  const std::size_t mask = (std::size_t(1) << depth) - 1;
+  for (std::size_t i = 0; i < directory.size(); i++) {
+    if ((i & mask) == (slot & mask)) directory[i] = pageNos[(i >> depth) & 1];
+  }
+}
+
+void HashIndex::writeDirectory() {
+  const std::size_t needed =
+      (directory.size() + DIRECTORY_PAGE_SLOTS - 1) / DIRECTORY_PAGE_SLOTS;
+  while (directoryPages.size() < needed) {
+    PageId pageNo;
+    PageHandle page = allocBucketPage(pageNo);
+    page.markDirty();
+    directoryPages.push_back(pageNo);
+  }
+  for (std::size_t k = 0; k < needed; k++) {
+    PageHandle page = bufMgr->pin(file, directoryPages[k]);
+    PageId *words = page.as<PageId>();
+    words[0] =
+        k + 1 < needed ? directoryPages[k + 1] : (PageId)Page::INVALID_NUMBER;
+    const std::size_t first = k * DIRECTORY_PAGE_SLOTS;
+    const std::size_t count =
+        std::min(DIRECTORY_PAGE_SLOTS, directory.size() - first);
+    memcpy(words + 1, &directory[first], count * sizeof(PageId));
+    page.markDirty();
+  }
+  indexMetaInfo.directoryPageNo = directoryPages[0];
+
+  PageHandle header = bufMgr->pin(file, headerPageNum);
+  memcpy(reinterpret_cast<char *>(header.get()), &indexMetaInfo,
+         sizeof(HashIndexMetaInfo));
+  header.markDirty();
+}
+
+void HashIndex::readDirectory() {
+  directory.resize(std::size_t(1) << indexMetaInfo.globalDepth);
+  PageId pageNo = indexMetaInfo.directoryPageNo;
+  for (std::size_t first = 0; first < directory.size();
+       first += DIRECTORY_PAGE_SLOTS) {
+    directoryPages.push_back(pageNo);
+    PageHandle page = bufMgr->pin(file, pageNo);
+    const PageId *words = page.as<PageId>();
+    const std::size_t count =
+        std::min(DIRECTORY_PAGE_SLOTS, directory.size() - first);
+    memcpy(&directory[first], words + 1, count * sizeof(PageId));
+    pageNo = words[0];
+  }
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,320 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * Number of bits of the hash of a key a hash index directory is indexed by
+ * at most; buckets of keys agreeing on as many bits overflow instead
+ */
+const int HASH_MAX_DEPTH = 24;
+
+/**
+ * @brief Meta page of a hash index file, its first page.
+ */
+struct HashIndexMetaInfo {
+  /**
+   * Name of base relation.
+   */
+  char relationName[20];
+
+  /**
+   * Offset of attribute, over which index is built, inside the record stored
+   * in pages.
+   */
+  int attrByteOffset;
+
+  /**
+   * Type of the attribute over which index is built.
+   */
+  Datatype attrType;
+
+  /**
+   * Number of bits of the hash of a key the directory is indexed by.
+   */
+  int globalDepth;
+
+  /**
+   * Number of entries in the index.
+   */
+  std::uint64_t numEntries;
+
+  /**
+   * Page number of the first page the directory is stored in, or 0 if it
+   * has not been written yet.
+   */
+  PageId directoryPageNo;
+
+  /**
+   * Page number of the first bucket page freed by a split, or 0 if there is
+   * none.  Freed pages are chained through HashBucket::overflowPageNo.
+   */
+  PageId freePageNo;
+};
+
+/**
+ * @brief Header of a page of a bucket of a hash index, followed by its
+ * entries, in the order of their key bytes: the key, then the record id,
+ * without padding.
+ *
+ * A bucket is a primary page, the one the directory points to, and a chain of
+ * overflow pages, added only when splitting the bucket would not make room:
+ * when all its entries have the key of the entry to insert, or when its
+ * entries agree on HASH_MAX_DEPTH bits of their hashes.  Entries are inserted
+ * into the last page of the chain.  The fields but numEntries and
+ * overflowPageNo are only kept on the primary page.
+ */
+struct HashBucket {
+  /**
+   * Number of bits of the hash that all keys of the bucket agree on.
+   */
+  int localDepth;
+
+  /**
+   * Number of entries on this page.
+   */
+  int numEntries;
+
+  /**
+   * Next page of the chain, or 0 if this is the last.
+   */
+  PageId overflowPageNo;
+
+  /**
+   * Last page of the chain, or 0 if the primary page is the only one.
+   */
+  PageId tailPageNo;
+
+  /**
+   * True if every entry of the bucket has the key of the first entry of the
+   * primary page.
+   */
+  bool singleKey;
+};
+
+/**
+ * @brief Counts of the pages and entries of a hash index.
+ */
+struct HashIndexStats {
+  /**
+   * Number of bits of the hash of a key the directory is indexed by.
+   */
+  int globalDepth;
+
+  /**
+   * Number of buckets, that is of primary pages.
+   */
+  std::uint64_t buckets;
+
+  /**
+   * Number of overflow pages.
+   */
+  std::uint64_t overflowPages;
+
+  /**
+   * Number of entries.
+   */
+  std::uint64_t entries;
+};
+
+/**
+ * @brief Disk-based index of the records of a relation by the value of one
+ * attribute, by extendible hashing, answering equality lookups only.
+ *
+ * The directory of 2^globalDepth bucket page numbers is held in memory, so a
+ * lookup reads the primary page of its bucket, and an overflow page for every
+ * page of entries of its key beyond the first.  A full bucket is split in two
+ * by one more bit of the hash of its keys, doubling the directory if the
+ * bucket was pointed to by a single slot of it.  Deletes do not merge buckets.
+ *
+ * The pages are kept in a BlobFile through a buffer manager, which must have
+ * no log; the index is used by one thread at a time.  The directory is written
+ * to the file by the destructor.
+ */
+class HashIndex {
+ public:
+  /**
+   * HashIndex Constructor, with the contract of the BTreeIndex one.
+   * Check to see if the corresponding index file exists. If so, open the
+   * file and reuse the buckets described by its meta page. If not, create it
+   * and insert entries for every tuple in the base relation using FileScan.
+   * The index file name is the relation name followed by the offset of the
+   * attribute and ",hash".
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn            Buffer Manager Instance, without a log
+   * @param attrByteOffset      Offset of attribute, over which index is to be
+   * built, in the record
+   * @param attrType            Datatype of attribute over which index is built
+   * @throws  BadIndexInfoException     If the index file already exists for
+   * the corresponding attribute, but values in its meta page do not match
+   * the parameters, or if the buffer manager has a log.
+   */
+  HashIndex(const std::string &relationName, std::string &outIndexName,
+            BufMgr *bufMgrIn, const int attrByteOffset,
+            const Datatype attrType);
+
+  /**
+   * HashIndex Destructor.
+   * Writes the directory and the meta page, flushes the index file from the
+   * buffer manager and closes it.  Does not throw.
+   */
+  ~HashIndex();
+
+  HashIndex(const HashIndex &) = delete;
+  HashIndex &operator=(const HashIndex &) = delete;
+
+  /**
+   * Insert a new entry using the pair <value,rid>.
+   *
+   * @param key   Key to insert, pointer to integer/double/char string
+   * @param rid   Record ID of a record whose entry is getting inserted into
+   * the index.
+   */
+  void insertEntry(const void *key, const RecordId rid);
+
+  /**
+   * Delete the entry with the pair <value,rid>.
+   *
+   * @param key   Key to delete, pointer to integer/double/char string
+   * @param rid   Record ID of the record whose entry is getting deleted from
+   * the index.
+   * @throws  NoSuchKeyFoundException If the index holds no such entry.
+   */
+  void deleteEntry(const void *key, const RecordId rid);
+
+  /**
+   * Find the entries with the given key, as BTreeIndex::lookup() does.
+   * Finding no entry is not an error.
+   *
+   * @param key       Key to find, pointer to integer/double/char string
+   * @param outRids   Array the record ids of the entries are copied to
+   * @param maxRids   Number of record ids that fit in outRids
+   * @return the number of entries with the key, which may be more than
+   *         maxRids, in which case only the first maxRids are copied
+   */
+  std::size_t lookup(const void *key, RecordId *outRids,
+                     const std::size_t maxRids);
+
+  /**
+   * Returns the counts of the pages and entries of the index, reading every
+   * overflow page.
+   */
+  HashIndexStats getStats();
+
+ private:
+  /**
+   * Copies a key into the fixed-width form it is stored and hashed in:
+   * STRINGSIZE characters of a string, zero padded, and 0 for -0.0.
+   */
+  void normalizeKey(const void *key, char *out) const;
+
+  /**
+   * Returns the hash of a key in stored form.
+   */
+  std::uint64_t hashKey(const char *key) const;
+
+  /**
+   * Returns the entry at the given position of a bucket page.
+   */
+  char *entryAt(HashBucket *bucket, int position) const {
+    return reinterpret_cast<char *>(bucket) + sizeof(HashBucket) +
+           position * entrySize;
+  }
+
+  /**
+   * Returns the position of the first entry of a bucket page whose key is not
+   * below the given key.
+   */
+  int findEntry(HashBucket *bucket, const char *key) const;
+
+  /**
+   * Inserts an entry in order into a bucket page with room for it.
+   */
+  void addEntry(HashBucket *bucket, const char *key,
+                   const RecordId &rid) const;
+
+  /**
+   * Allocates a page for a bucket, reusing a freed one if there is any, and
+   * returns it pinned and empty.
+   */
+  PageHandle allocBucketPage(PageId &pageNo);
+
+  /**
+   * Splits the bucket the given directory slot points to by one more bit of
+   * the hash, doubling the directory first if needed.
+   */
+  void splitBucket(std::size_t slot);
+
+  /**
+   * Writes the directory and the meta page.
+   */
+  void writeDirectory();
+
+  /**
+   * Reads the directory written by writeDirectory().
+   */
+  void readDirectory();
+
+  /**
+   * Buffer manager the pages are read through.
+   */
+  BufMgr *bufMgr;
+
+  /**
+   * File the index is stored in.
+   */
+  File *file;
+
+  /**
+   * Page number of the meta page.
+   */
+  PageId headerPageNum;
+
+  /**
+   * Contents of the meta page, kept in memory.
+   */
+  HashIndexMetaInfo indexMetaInfo{};
+
+  /**
+   * Page number of the primary page of the bucket of every value of the
+   * low globalDepth bits of the hash.
+   */
+  std::vector<PageId> directory;
+
+  /**
+   * Pages the directory is stored in.
+   */
+  std::vector<PageId> directoryPages;
+
+  /**
+   * Length of a key in stored form, and of an entry.
+   */
+  std::size_t keySize;
+  std::size_t entrySize;
+
+  /**
+   * Number of entries that fit in a bucket page.
+   */
+  int bucketCapacity;
+};
+
+}  // namespace badgerdb
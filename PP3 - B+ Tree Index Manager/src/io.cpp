@@ -0,0 +1,189 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "io.h"
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#include <memory>
+
+namespace badgerdb {
+
+IoEngine *IoEngine::create(IoEngineKind kind) {
+  if (kind == URING_IO) {
+    std::unique_ptr<UringIoEngine> engine(new UringIoEngine);
+    if (engine->ready()) return engine.release();
+  }
+  return new SyncIoEngine;
+}
+
+IoEngine &IoEngine::standard() {
+  static std::unique_ptr<IoEngine> engine(create(URING_IO));
+  return *engine;
+}
+
+namespace {
+
+void runSync(IoRequest &request) {
+  std::uint32_t done = 0;
+  // a transfer may stop short of the block, except at the end of the file
+  while (done < request.length) {
+    const ssize_t bytes =
+        request.write
+            ? pwrite(request.fd, request.data + done, request.length - done,
+                     request.offset + done)
+            : pread(request.fd, request.data + done, request.length - done,
+                    request.offset + done);
+    if (bytes < 0 && errno == EINTR) continue;
+    if (bytes < 0) {
+      request.result = -errno;
+      return;
+    }
+    if (bytes == 0) break;
+    done += bytes;
+  }
+  request.result = done;
+}
+
+unsigned loadAcquire(const unsigned *p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void storeRelease(unsigned *p, unsigned value) {
+  __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+}
+
+void SyncIoEngine::run(std::vector<IoRequest> &requests) {
+  for (IoRequest &request : requests) runSync(request);
+}
+
+UringIoEngine::UringIoEngine()
+    : ringFd(-1),
+      sqRing(MAP_FAILED),
+      sqRingSize(0),
+      sqes(NULL),
+      sqesSize(0),
+      cqRing(MAP_FAILED),
+      cqRingSize(0) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ringFd = syscall(__NR_io_uring_setup, IO_URING_DEPTH, &params);
+  if (ringFd < 0) return;
+
+  sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+  void *entries = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || entries == MAP_FAILED) {
+    if (entries != MAP_FAILED) munmap(entries, sqesSize);
+    tearDown();
+    return;
+  }
+  sqes = static_cast<io_uring_sqe *>(entries);
+
+  char *sq = static_cast<char *>(sqRing);
+  sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  char *cq = static_cast<char *>(cqRing);
+  cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+UringIoEngine::~UringIoEngine() { tearDown(); }
+
+void UringIoEngine::tearDown() {
+  if (sqes != NULL) munmap(sqes, sqesSize);
+  if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+  if (cqRing != MAP_FAILED) munmap(cqRing, cqRingSize);
+  if (ringFd >= 0) close(ringFd);
+  sqes = NULL;
+  sqRing = MAP_FAILED;
+  cqRing = MAP_FAILED;
+  ringFd = -1;
+}
+
+void UringIoEngine::run(std::vector<IoRequest> &requests) {
+  std::lock_guard<std::mutex> guard(latch);
+  const std::size_t count = requests.size();
+  std::vector<bool> completed(count, false);
+  std::size_t next = 0, done = 0, inFlight = 0;
+  while (ready() && done < count) {
+    // queue as many requests as the ring holds
+    unsigned tail = *sqTail;
+    while (next < count && inFlight < IO_URING_DEPTH) {
+      IoRequest &request = requests[next];
+      const unsigned index = tail & *sqMask;
+      io_uring_sqe &sqe = sqes[index];
+      memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+      sqe.fd = request.fd;
+      sqe.off = request.offset;
+      sqe.addr = reinterpret_cast<std::uint64_t>(request.data);
+      sqe.len = request.length;
+      sqe.user_data = next;
+      sqArray[index] = index;
+      tail++;
+      next++;
+      inFlight++;
+    }
+    storeRelease(sqTail, tail);
+
+    // submit what the kernel has not taken yet and wait for a completion
+    const unsigned toSubmit = tail - loadAcquire(sqHead);
+    const int entered = syscall(__NR_io_uring_enter, ringFd, toSubmit, 1,
+                                IORING_ENTER_GETEVENTS, NULL, 0);
+    if (entered < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      tearDown();
+      break;
+    }
+
+    unsigned head = *cqHead;
+    const unsigned cqTailNow = loadAcquire(cqTail);
+    for (; head != cqTailNow; head++) {
+      const io_uring_cqe &cqe = cqes[head & *cqMask];
+      IoRequest &request = requests[cqe.user_data];
+      completed[cqe.user_data] = true;
+      request.result = cqe.res;
+      done++;
+      inFlight--;
+    }
+    storeRelease(cqHead, head);
+  }
+
+  // the ring failed: what did not complete runs synchronously
+  for (std::size_t i = 0; i < count; i++) {
+    if (!completed[i]) runSync(requests[i]);
+  }
+
+  // a transfer stopping short of the block is finished synchronously
+  for (IoRequest &request : requests) {
+    if (request.result > 0 && request.result < request.length) {
+      IoRequest rest = request;
+      rest.offset += request.result;
+      rest.data += request.result;
+      rest.length -= request.result;
+      runSync(rest);
+      if (rest.result >= 0) request.result += rest.result;
+    }
+  }
+}
+
+}
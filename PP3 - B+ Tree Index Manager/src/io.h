@@ -0,0 +1,184 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace badgerdb {
+
+/**
+* @brief Kinds of engine page reads and writes can be run on
+*/
+enum IoEngineKind {
+  SYNC_IO, /* One pread or pwrite call per request */
+  URING_IO /* Batches submitted to an io_uring */
+};
+
+/**
+* Largest number of requests an io_uring engine has in flight at once
+*/
+const std::uint32_t IO_URING_DEPTH = 64;
+
+/**
+* @brief A read or write of a block of a file at a given offset
+*/
+struct IoRequest {
+  /**
+   * Descriptor of the file
+   */
+  int fd;
+
+  /**
+   * Offset of the block in the file
+   */
+  std::uint64_t offset;
+
+  /**
+   * Memory the block is read into or written from
+   */
+  char *data;
+
+  /**
+   * Bytes of the block
+   */
+  std::uint32_t length;
+
+  /**
+   * Whether the block is written rather than read
+   */
+  bool write;
+
+  /**
+   * Once run, the bytes transferred, or the error number negated
+   */
+  std::int64_t result;
+};
+
+/**
+* @brief Runs batches of reads and writes on file descriptors
+*
+* Each request carries its own offset, so that no seek position is shared:
+* the requests of a batch may run in any order and at the same time, and
+* several threads may run batches on the same descriptor at once.  The
+* requests of one batch must not overlap where one of them writes.
+*/
+class IoEngine {
+ public:
+  /**
+   * Creates an engine.  An io_uring engine the kernel does not allow falls
+   * back to pread and pwrite.
+   *
+   * @param kind  Kind of engine
+   * @return  The new engine, owned by the caller
+   */
+  static IoEngine *create(IoEngineKind kind);
+
+  /**
+   * Returns the engine files use unless given another: an io_uring engine
+   * where the kernel allows one.
+   */
+  static IoEngine &standard();
+
+  virtual ~IoEngine() {}
+
+  /**
+   * Returns the name of the engine.
+   */
+  virtual const char *name() const = 0;
+
+  /**
+   * Runs the requests, returning once all of them have completed.  A read
+   * reaching past the end of the file transfers fewer bytes than asked.
+   *
+   * @param requests  Requests to run; their results are set
+   */
+  virtual void run(std::vector<IoRequest> &requests) = 0;
+};
+
+/**
+* @brief Runs each request with a pread or pwrite call of its own
+*/
+class SyncIoEngine : public IoEngine {
+ public:
+  const char *name() const { return "sync"; }
+  void run(std::vector<IoRequest> &requests);
+};
+
+/**
+* @brief Submits the requests of a batch to an io_uring together, keeping up
+* to IO_URING_DEPTH of them in flight, and reaps their completions
+*
+* Batches run one at a time on the ring.  The ring is set up and driven with
+* the system calls directly.
+*/
+class UringIoEngine : public IoEngine {
+ public:
+  /**
+   * Sets up the ring; ready() tells whether the kernel allowed it.
+   */
+  UringIoEngine();
+
+  ~UringIoEngine();
+
+  /**
+   * Returns true if the ring is set up.
+   */
+  bool ready() const { return ringFd >= 0; }
+
+  const char *name() const { return "io_uring"; }
+
+  /**
+   * Runs the requests on the ring.  Should the ring fail, the requests not
+   * completed yet are run with pread and pwrite, and so are later batches.
+   */
+  void run(std::vector<IoRequest> &requests);
+
+ private:
+  /**
+   * Unmaps the rings and closes the ring descriptor.
+   */
+  void tearDown();
+
+  int ringFd;
+
+  /**
+   * Mappings of the submission queue ring, the submission queue entries and
+   * the completion queue ring
+   */
+  void *sqRing;
+  std::size_t sqRingSize;
+  io_uring_sqe *sqes;
+  std::size_t sqesSize;
+  void *cqRing;
+  std::size_t cqRingSize;
+
+  /**
+   * Fields of the rings shared with the kernel
+   */
+  unsigned *sqHead;
+  unsigned *sqTail;
+  unsigned *sqMask;
+  unsigned *sqArray;
+  unsigned *cqHead;
+  unsigned *cqTail;
+  unsigned *cqMask;
+  io_uring_cqe *cqes;
+
+  /**
+   * Latch held while a batch runs on the ring
+   */
+  std::mutex latch;
+};
+
+}
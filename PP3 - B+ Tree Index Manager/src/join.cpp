@@ -0,0 +1,251 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "join.h"
+#include <algorithm>
+#include <cstring>
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+
+namespace badgerdb {
+
+// Number of bytes a value of a key attribute takes in a packed key, the form
+// lookupMany() and the batched scans use.
+static std::size_t columnSize(Datatype type) {
+  switch (type) {
+    case INTEGER:
+      return sizeof(int);
+    case DOUBLE:
+      return sizeof(double);
+    default:
+      return STRINGSIZE;
+  }
+}
+
+static std::size_t keySizeOf(const std::vector<KeyColumn> &columns) {
+  std::size_t size = 0;
+  for (const KeyColumn &column : columns) size += columnSize(column.type);
+  return size;
+}
+
+// Packs the key attributes of a record one after another into key.
+static void packKey(const char *record, const std::vector<KeyColumn> &columns,
+                    char *key) {
+  for (const KeyColumn &column : columns) {
+    const char *value = record + column.byteOffset;
+    if (column.type == STRING)
+      strncpy(key, value, STRINGSIZE);
+    else
+      memcpy(key, value, columnSize(column.type));
+    key += columnSize(column.type);
+  }
+}
+
+// Compares two packed keys attribute by attribute, as the index orders them.
+static int compareKeys(const char *a, const char *b,
+                       const std::vector<KeyColumn> &columns) {
+  for (const KeyColumn &column : columns) {
+    int c;
+    if (column.type == INTEGER) {
+      int x, y;
+      memcpy(&x, a, sizeof(int));
+      memcpy(&y, b, sizeof(int));
+      c = (x > y) - (x < y);
+    } else if (column.type == DOUBLE) {
+      double x, y;
+      memcpy(&x, a, sizeof(double));
+      memcpy(&y, b, sizeof(double));
+      c = (x > y) - (x < y);
+    } else {
+      c = memcmp(a, b, STRINGSIZE);
+    }
+    if (c != 0) return c;
+    a += columnSize(column.type);
+    b += columnSize(column.type);
+  }
+  return 0;
+}
+
+static bool sameTypes(const std::vector<KeyColumn> &a,
+                      const std::vector<KeyColumn> &b) {
+  if (a.size() != b.size()) return false;
+  for (std::size_t i = 0; i < a.size(); i++)
+    if (a[i].type != b[i].type) return false;
+  return true;
+}
+
+IndexNestedLoopJoin::IndexNestedLoopJoin(
+    const std::string &outerName, const std::vector<KeyColumn> &outerColumns,
+    BTreeIndex *inner, BufMgr *bufMgr, std::size_t batchSize)
+    : scan(outerName, bufMgr),
+      inner(inner),
+      columns(outerColumns),
+      batchSize(std::max<std::size_t>(batchSize, 1)),
+      outerDone(false),
+      pendingPos(0) {
+  if (!sameTypes(columns, inner->getKeyColumns()))
+    throw BadIndexInfoException(
+        "Join attributes are not of the types of the keys of the index");
+}
+
+bool IndexNestedLoopJoin::nextBatch() {
+  const std::size_t keySize = keySizeOf(columns);
+  outerRids.clear();
+  keys.resize(batchSize * keySize);
+  while (!outerDone && outerRids.size() < batchSize) {
+    RecordId rid;
+    try {
+      scan.scanNext(rid);
+    } catch (const EndOfFileException &e) {
+      outerDone = true;
+      break;
+    }
+    packKey(scan.getRecordView().data, columns,
+            keys.data() + outerRids.size() * keySize);
+    outerRids.push_back(rid);
+  }
+  const std::size_t n = outerRids.size();
+  if (n == 0) return false;
+
+  // Sorted keys fall in the leaves in order, and lookupMany() then descends
+  // once per leaf rather than once per key.
+  order.resize(n);
+  for (std::size_t i = 0; i < n; i++) order[i] = i;
+  const char *base = keys.data();
+  const std::vector<KeyColumn> &cols = columns;
+  std::sort(order.begin(), order.end(),
+            [base, keySize, &cols](std::size_t a, std::size_t b) {
+              return compareKeys(base + a * keySize, base + b * keySize,
+                                 cols) < 0;
+            });
+  sortedKeys.resize(n * keySize);
+  for (std::size_t i = 0; i < n; i++)
+    memcpy(sortedKeys.data() + i * keySize, base + order[i] * keySize,
+           keySize);
+
+  innerRids.clear();
+  innerCounts.clear();
+  inner->lookupMany(sortedKeys.data(), n, innerRids, innerCounts);
+
+  pending.clear();
+  pendingPos = 0;
+  std::size_t at = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    for (std::size_t j = 0; j < innerCounts[i]; j++)
+      pending.push_back(JoinPair{outerRids[order[i]], innerRids[at + j]});
+    at += innerCounts[i];
+  }
+  return true;
+}
+
+std::size_t IndexNestedLoopJoin::next(JoinPair *outPairs,
+                                      std::size_t maxPairs) {
+  std::size_t numPairs = 0;
+  while (numPairs < maxPairs) {
+    if (pendingPos == pending.size()) {
+      if (!nextBatch()) break;
+      continue;
+    }
+    const std::size_t take =
+        std::min(maxPairs - numPairs, pending.size() - pendingPos);
+    std::copy(pending.begin() + pendingPos,
+              pending.begin() + pendingPos + take, outPairs + numPairs);
+    pendingPos += take;
+    numPairs += take;
+  }
+  return numPairs;
+}
+
+SortMergeJoin::SortMergeJoin(BTreeIndex *left, BTreeIndex *right,
+                             const void *lowVal, Operator lowOp,
+                             const void *highVal, Operator highOp,
+                             std::size_t batchSize)
+    : columns(left->getKeyColumns()),
+      keySize(keySizeOf(columns)),
+      batchSize(std::max<std::size_t>(batchSize, 1)),
+      pendingPos(0) {
+  if (!sameTypes(columns, right->getKeyColumns()))
+    throw BadIndexInfoException("Joined indexes have keys of different types");
+  BTreeIndex *indexes[2] = {left, right};
+  for (int side = 0; side < 2; side++) {
+    Input &input = inputs[side];
+    input.rids.resize(this->batchSize);
+    input.keys.resize(this->batchSize * keySize);
+    try {
+      input.cursor =
+          indexes[side]->openScan(lowVal, lowOp, highVal, highOp);
+    } catch (const NoSuchKeyFoundException &e) {
+      // an empty side leaves the cursor with no scan, and the join empty
+    }
+  }
+}
+
+bool SortMergeJoin::fill(Input &input) {
+  if (input.pos < input.len) return true;
+  input.pos = 0;
+  input.len = 0;
+  if (!input.cursor.isExecuting()) return false;
+  input.len = input.cursor.scanNextBatch(input.rids.data(), batchSize, NULL,
+                                         input.keys.data());
+  return input.len > 0;
+}
+
+void SortMergeJoin::takeKey(Input &input, const char *keyValue,
+                            std::vector<RecordId> &outRids) {
+  while (fill(input) && compareKeys(key(input), keyValue, columns) == 0)
+    outRids.push_back(input.rids[input.pos++]);
+}
+
+bool SortMergeJoin::nextKey() {
+  Input &l = inputs[0];
+  Input &r = inputs[1];
+  while (fill(l) && fill(r)) {
+    const int c = compareKeys(key(l), key(r), columns);
+    if (c < 0) {
+      l.pos++;
+      continue;
+    }
+    if (c > 0) {
+      r.pos++;
+      continue;
+    }
+    // The group of a key may run on into the next batch of either side, which
+    // overwrites the key, so it is kept aside.
+    groupKey.assign(key(l), key(l) + keySize);
+    groupRids[0].clear();
+    groupRids[1].clear();
+    takeKey(l, groupKey.data(), groupRids[0]);
+    takeKey(r, groupKey.data(), groupRids[1]);
+    pending.clear();
+    pendingPos = 0;
+    for (const RecordId &a : groupRids[0])
+      for (const RecordId &b : groupRids[1]) pending.push_back(JoinPair{a, b});
+    return true;
+  }
+  return false;
+}
+
+std::size_t SortMergeJoin::next(JoinPair *outPairs, std::size_t maxPairs) {
+  std::size_t numPairs = 0;
+  while (numPairs < maxPairs) {
+    if (pendingPos == pending.size()) {
+      if (!nextKey()) break;
+      continue;
+    }
+    const std::size_t take =
+        std::min(maxPairs - numPairs, pending.size() - pendingPos);
+    std::copy(pending.begin() + pendingPos,
+              pending.begin() + pendingPos + take, outPairs + numPairs);
+    pendingPos += take;
+    numPairs += take;
+  }
+  return numPairs;
+}
+
+}
@@ -0,0 +1,213 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "btree.h"
+#include "filescan.h"
+
+namespace badgerdb {
+
+/**
+ * @brief The record ids of a record of each side of a join whose join
+ * attributes are equal.
+ */
+struct JoinPair {
+  /**
+   * Record of the outer relation, or of the relation of the left index.
+   */
+  RecordId left;
+
+  /**
+   * Record of the relation of the inner, or right, index.
+   */
+  RecordId right;
+};
+
+/**
+ * @brief Joins the records of a relation with the entries of an index whose
+ * keys equal an attribute of them.
+ *
+ * The outer relation is read by a FileScan, a batch of records at a time.
+ * The keys of a batch are sorted and looked up in the index together, so
+ * that consecutive keys falling in the same leaf are found without another
+ * descent from the root.  The pairs of a batch come in key order.
+ */
+class IndexNestedLoopJoin {
+ public:
+  /**
+   * Opens the outer relation for a join.
+   *
+   * @param outerName     Name of the outer relation file
+   * @param outerColumns  Attributes of the outer records that are looked up,
+   *                      of the types of the key attributes of the index
+   * @param inner         Index the attributes are looked up in
+   * @param bufMgr        Buffer manager to read the outer pages through
+   * @param batchSize     Number of outer records looked up at once
+   * @throws  BadIndexInfoException If the attributes are not of the types of
+   *                                the keys of the index
+   */
+  IndexNestedLoopJoin(const std::string &outerName,
+                      const std::vector<KeyColumn> &outerColumns,
+                      BTreeIndex *inner, BufMgr *bufMgr,
+                      std::size_t batchSize = 1024);
+
+  /**
+   * Copies the next pairs of the join to outPairs.
+   *
+   * @param outPairs  Array the pairs are copied to
+   * @param maxPairs  Number of pairs that fit in outPairs
+   * @return  Number of pairs copied, less than maxPairs only at the end of the
+   *          join
+   */
+  std::size_t next(JoinPair *outPairs, std::size_t maxPairs);
+
+ private:
+  /**
+   * Reads the next batch of outer records and looks up their keys, leaving
+   * their pairs in pending.
+   *
+   * @return  False at the end of the outer relation
+   */
+  bool nextBatch();
+
+  FileScan scan;
+
+  BTreeIndex *inner;
+
+  std::vector<KeyColumn> columns;
+
+  std::size_t batchSize;
+
+  /**
+   * True once the outer relation has been read to its end.
+   */
+  bool outerDone;
+
+  /**
+   * Pairs found but not yet returned, from pendingPos on.
+   */
+  std::vector<JoinPair> pending;
+  std::size_t pendingPos;
+
+  /**
+   * Record ids and keys of the outer records of a batch, the order of the
+   * keys, and the result of looking them up.
+   */
+  std::vector<RecordId> outerRids;
+  std::vector<char> keys;
+  std::vector<std::size_t> order;
+  std::vector<char> sortedKeys;
+  std::vector<RecordId> innerRids;
+  std::vector<std::size_t> innerCounts;
+};
+
+/**
+ * @brief Joins the entries of two indexes on keys of the same types by
+ * merging two scans of a range of keys.
+ *
+ * Both scans return their entries in key order, a batch at a time with their
+ * keys, so the join reads each leaf of either index once.  Every entry of a
+ * key on the left is paired with every entry of that key on the right.
+ */
+class SortMergeJoin {
+ public:
+  /**
+   * Opens a scan of the given range of keys on each index.
+   *
+   * @param left      Index of the left side
+   * @param right     Index of the right side
+   * @param lowVal    Low value of range of keys
+   * @param lowOp     Low operator (GT/GTE)
+   * @param highVal   High value of range of keys
+   * @param highOp    High operator (LT/LTE)
+   * @param batchSize Number of entries read from a scan at once
+   * @throws  BadIndexInfoException If the keys of the indexes are not of the
+   *                                same types
+   * @throws  BadOpcodesException If the operators are not the ones expected
+   * @throws  BadScanrangeException If lowVal > highVal
+   */
+  SortMergeJoin(BTreeIndex *left, BTreeIndex *right, const void *lowVal,
+                Operator lowOp, const void *highVal, Operator highOp,
+                std::size_t batchSize = 1024);
+
+  /**
+   * Copies the next pairs of the join to outPairs.
+   *
+   * @param outPairs  Array the pairs are copied to
+   * @param maxPairs  Number of pairs that fit in outPairs
+   * @return  Number of pairs copied, less than maxPairs only at the end of the
+   *          join
+   */
+  std::size_t next(JoinPair *outPairs, std::size_t maxPairs);
+
+ private:
+  /**
+   * @brief One side of the join: its scan and the batch of entries read from
+   * it, of which those from pos on are still to be merged.
+   */
+  struct Input {
+    IndexScanCursor cursor;
+    std::vector<RecordId> rids;
+    std::vector<char> keys;
+    std::size_t pos = 0;
+    std::size_t len = 0;
+  };
+
+  /**
+   * Reads the next batch of an input if all of its entries have been merged.
+   *
+   * @return  False at the end of the scan of the input
+   */
+  bool fill(Input &input);
+
+  /**
+   * Key of the next entry of an input.
+   */
+  const char *key(const Input &input) const {
+    return input.keys.data() + input.pos * keySize;
+  }
+
+  /**
+   * Takes the record ids of the entries of an input with the given key.
+   */
+  void takeKey(Input &input, const char *keyValue,
+               std::vector<RecordId> &outRids);
+
+  /**
+   * Merges the inputs up to the next key found in both, leaving its pairs in
+   * pending.
+   *
+   * @return  False at the end of either input
+   */
+  bool nextKey();
+
+  Input inputs[2];
+
+  std::vector<KeyColumn> columns;
+
+  std::size_t keySize;
+
+  std::size_t batchSize;
+
+  /**
+   * Key of the last group found in both inputs, and the record ids of its
+   * entries on each side.
+   */
+  std::vector<char> groupKey;
+  std::vector<RecordId> groupRids[2];
+
+  /**
+   * Pairs found but not yet returned, from pendingPos on.
+   */
+  std::vector<JoinPair> pending;
+  std::size_t pendingPos;
+};
+
+}
@@ -0,0 +1,241 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "json.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "exceptions/json_parse_exception.h"
+
+namespace badgerdb {
+
+JsonReader::JsonReader(std::istream &in) : buf_(in.rdbuf()) {}
+
+JsonReader::Type JsonReader::peek() {
+  const int c = skipSpace();
+  switch (c) {
+    case '{':
+      return OBJECT;
+    case '[':
+      return ARRAY;
+    case '"':
+      return STRING;
+    case 't':
+    case 'f':
+      return BOOLEAN;
+    case 'n':
+      return NULL_VALUE;
+    default:
+      if (c == '-' || (c >= '0' && c <= '9')) return NUMBER;
+      fail("expected a value");
+  }
+}
+
+void JsonReader::beginObject() {
+  expect('{');
+  first_.push_back(true);
+}
+
+bool JsonReader::nextKey(std::string &key) {
+  if (first_.empty()) fail("no object is open");
+  if (skipSpace() == '}') {
+    getChar();
+    first_.pop_back();
+    return false;
+  }
+  if (!first_.back()) expect(',');
+  first_.back() = false;
+  readString(key);
+  expect(':');
+  return true;
+}
+
+void JsonReader::beginArray() {
+  expect('[');
+  first_.push_back(true);
+}
+
+bool JsonReader::nextElement() {
+  if (first_.empty()) fail("no array is open");
+  if (skipSpace() == ']') {
+    getChar();
+    first_.pop_back();
+    return false;
+  }
+  if (!first_.back()) expect(',');
+  first_.back() = false;
+  return true;
+}
+
+void JsonReader::readString(std::string &value) {
+  expect('"');
+  value.clear();
+  while (true) {
+    int c = getChar();
+    if (c == EOF) fail("unterminated string");
+    if (c == '"') return;
+    if (c != '\\') {
+      value.push_back(static_cast<char>(c));
+      continue;
+    }
+    c = getChar();
+    switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        value.push_back(static_cast<char>(c));
+        break;
+      case 'b':
+        value.push_back('\b');
+        break;
+      case 'f':
+        value.push_back('\f');
+        break;
+      case 'n':
+        value.push_back('\n');
+        break;
+      case 'r':
+        value.push_back('\r');
+        break;
+      case 't':
+        value.push_back('\t');
+        break;
+      case 'u': {
+        std::uint32_t code = readHex();
+        if (code >= 0xd800 && code < 0xdc00) {
+          // a character past the basic plane, as a surrogate pair
+          if (getChar() != '\\' || getChar() != 'u') {
+            fail("unpaired surrogate");
+          }
+          const std::uint32_t low = readHex();
+          if (low < 0xdc00 || low >= 0xe000) fail("unpaired surrogate");
+          code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+        }
+        if (code < 0x80) {
+          value.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+          value.push_back(static_cast<char>(0xc0 | (code >> 6)));
+          value.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        } else if (code < 0x10000) {
+          value.push_back(static_cast<char>(0xe0 | (code >> 12)));
+          value.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+          value.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        } else {
+          value.push_back(static_cast<char>(0xf0 | (code >> 18)));
+          value.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+          value.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+          value.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+        break;
+      }
+      default:
+        fail("bad escape in string");
+    }
+  }
+}
+
+double JsonReader::readNumber() {
+  skipSpace();
+  number_.clear();
+  for (int c = peekChar();
+       c != EOF && std::strchr("+-.0123456789Ee", c) != nullptr;
+       c = peekChar()) {
+    number_.push_back(static_cast<char>(getChar()));
+  }
+  char *end = nullptr;
+  const double value = std::strtod(number_.c_str(), &end);
+  if (number_.empty() || *end != '\0') fail("expected a number");
+  return value;
+}
+
+bool JsonReader::readBoolean() {
+  if (skipSpace() == 't') {
+    expectWord("true");
+    return true;
+  }
+  expectWord("false");
+  return false;
+}
+
+void JsonReader::readNull() {
+  skipSpace();
+  expectWord("null");
+}
+
+void JsonReader::skipValue() {
+  std::string text;
+  switch (peek()) {
+    case OBJECT:
+      beginObject();
+      while (nextKey(text)) skipValue();
+      break;
+    case ARRAY:
+      beginArray();
+      while (nextElement()) skipValue();
+      break;
+    case STRING:
+      readString(text);
+      break;
+    case NUMBER:
+      readNumber();
+      break;
+    case BOOLEAN:
+      readBoolean();
+      break;
+    case NULL_VALUE:
+      readNull();
+      break;
+  }
+}
+
+bool JsonReader::atEnd() { return skipSpace() == EOF; }
+
+int JsonReader::skipSpace() {
+  int c = peekChar();
+  while (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+    getChar();
+    c = peekChar();
+  }
+  return c;
+}
+
+void JsonReader::expect(const char c) {
+  if (skipSpace() != c) fail(std::string("expected '") + c + "'");
+  getChar();
+}
+
+void JsonReader::expectWord(const char *word) {
+  for (const char *c = word; *c != '\0'; c++) {
+    if (getChar() != *c) fail("expected true, false or null");
+  }
+}
+
+std::uint32_t JsonReader::readHex() {
+  std::uint32_t code = 0;
+  for (int i = 0; i < 4; i++) {
+    const int c = getChar();
+    code <<= 4;
+    if (c >= '0' && c <= '9') {
+      code |= c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      code |= c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      code |= c - 'A' + 10;
+    } else {
+      fail("bad \\u escape");
+    }
+  }
+  return code;
+}
+
+void JsonReader::fail(const std::string &reason) const {
+  throw JsonParseException(offset_, reason);
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,169 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * @brief Reader of a JSON document from a stream, one value at a time, so
+ * that documents larger than memory can be loaded.
+ *
+ * The caller walks the document in order: it opens an object and asks for its
+ * keys one after another, or an array and asks for its elements, and reads or
+ * skips each value in turn.  Strings are unescaped, \\u escapes included, into
+ * UTF-8.  Errors throw JsonParseException with the offset they were met at.
+ */
+class JsonReader {
+ public:
+  /**
+   * @brief Type of a JSON value
+   */
+  enum Type { OBJECT, ARRAY, STRING, NUMBER, BOOLEAN, NULL_VALUE };
+
+  /**
+   * Creates a reader of the document the stream holds.
+   *
+   * @param in  Stream positioned at the start of the document
+   */
+  explicit JsonReader(std::istream &in);
+
+  /**
+   * Returns the type of the next value, without reading it.
+   *
+   * @throws  JsonParseException  If no value starts there.
+   */
+  Type peek();
+
+  /**
+   * Reads the opening brace of an object; its keys are then read by nextKey.
+   */
+  void beginObject();
+
+  /**
+   * Reads the next key of the object opened last, or its closing brace.
+   *
+   * @param key   Set to the key, whose value is to be read next.
+   * @return  False if the object has ended.
+   */
+  bool nextKey(std::string &key);
+
+  /**
+   * Reads the opening bracket of an array; its elements are then gone
+   * through with nextElement.
+   */
+  void beginArray();
+
+  /**
+   * Moves to the next element of the array opened last, or reads its closing
+   * bracket.
+   *
+   * @return  True if an element, to be read next, follows; false if the
+   *          array has ended.
+   */
+  bool nextElement();
+
+  /**
+   * Reads a string.
+   *
+   * @param value   Set to the string, unescaped.
+   */
+  void readString(std::string &value);
+
+  /**
+   * Reads a number.
+   */
+  double readNumber();
+
+  /**
+   * Reads true or false.
+   */
+  bool readBoolean();
+
+  /**
+   * Reads null.
+   */
+  void readNull();
+
+  /**
+   * Reads a value of any type, nested values included, and throws it away.
+   */
+  void skipValue();
+
+  /**
+   * Returns true if nothing but white space is left in the stream.
+   */
+  bool atEnd();
+
+  /**
+   * Returns the number of bytes read so far.
+   */
+  std::uint64_t offset() const { return offset_; }
+
+ private:
+  /**
+   * Returns the next character without reading it, or EOF.
+   */
+  int peekChar() { return buf_->sgetc(); }
+
+  /**
+   * Reads the next character, or EOF.
+   */
+  int getChar() {
+    const int c = buf_->sbumpc();
+    if (c != EOF) offset_++;
+    return c;
+  }
+
+  /**
+   * Reads white space up to the next token, and returns its first character
+   * without reading it.
+   */
+  int skipSpace();
+
+  /**
+   * Reads the given character after any white space.
+   */
+  void expect(const char c);
+
+  /**
+   * Reads the given word, which starts with the next character.
+   */
+  void expectWord(const char *word);
+
+  /**
+   * Reads the four hexadecimal digits of a \\u escape.
+   */
+  std::uint32_t readHex();
+
+  /**
+   * Throws JsonParseException at the current offset.
+   */
+  [[noreturn]] void fail(const std::string &reason) const;
+
+  std::streambuf *buf_;
+  std::uint64_t offset_ = 0;
+
+  /**
+   * For each object or array open, whether no key or element of it has been
+   * read yet
+   */
+  std::vector<bool> first_;
+
+  /**
+   * Digits of the number being read
+   */
+  std::string number_;
+};
+
+}  // namespace badgerdb
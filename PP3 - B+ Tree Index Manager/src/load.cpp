@@ -0,0 +1,81 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+// Bulk loader of the eBay data set of PP1: streams its JSON files into the
+// relations <prefix>.items, .users, .bids and .categories and their indexes,
+// and writes what it loaded and how long it took as one JSON object.
+//
+//   PP3_load --prefix ebay ../PP1*/ebay_data/items-*.json
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "buffer.h"
+#include "exceptions/badgerdb_exception.h"
+#include "loader.h"
+
+using namespace badgerdb;
+
+namespace {
+
+void usage(const char *program) {
+  std::cerr << "usage: " << program << " [options] file.json...\n"
+            << "  --prefix P           prefix of the relation names (ebay)\n"
+            << "  --frames N           frames in the buffer pool the indexes\n"
+            << "                       are built through (10000)\n";
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string prefix = "ebay";
+  std::uint32_t frames = 10000;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg.compare(0, 2, "--") != 0) {
+      files.push_back(arg);
+    } else if (i + 1 == argc) {
+      files.clear();
+      break;
+    } else if (arg == "--prefix") {
+      prefix = argv[++i];
+    } else if (arg == "--frames") {
+      frames = std::strtoul(argv[++i], NULL, 10);
+    } else {
+      files.clear();
+      break;
+    }
+  }
+  if (files.empty() || frames == 0) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  try {
+    std::unique_ptr<BufMgr> pool(new BufMgr(frames));
+    const auto start = std::chrono::steady_clock::now();
+    const EbayLoadStats stats = loadEbay(files, prefix, pool.get());
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    std::cout << "{\"items\": " << stats.items << ", \"users\": " << stats.users
+              << ", \"bids\": " << stats.bids
+              << ", \"categories\": " << stats.categories
+              << ", \"pages\": " << stats.pages
+              << ", \"bytes_read\": " << stats.bytesRead
+              << ", \"seconds\": " << seconds << "}" << std::endl;
+  } catch (const BadgerDbException &e) {
+    std::cerr << e.message() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,356 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "loader.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <unordered_set>
+
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "json.h"
+
+namespace badgerdb {
+
+namespace {
+
+// bytes of an attribute a key is built from
+std::size_t columnSize(const Datatype type) {
+  switch (type) {
+    case INTEGER:
+      return sizeof(int);
+    case DOUBLE:
+      return sizeof(double);
+    case STRING:
+      return STRINGSIZE;
+  }
+  return 0;
+}
+
+}  // namespace
+
+RelationLoader::RelationLoader(const std::string &relationName,
+                               std::size_t recordSize)
+    : relationName(relationName),
+      recordSize(recordSize),
+      file(PageFile::create(relationName)) {
+  if (recordSize + sizeof(PageSlot) > Page::DATA_SIZE) {
+    throw InsufficientSpaceException(Page::INVALID_NUMBER, recordSize,
+                                     Page::DATA_SIZE - sizeof(PageSlot));
+  }
+  file.setWriteBehind(true);
+  batch.reserve(LOAD_BATCH_PAGES);
+}
+
+RelationLoader::~RelationLoader() {
+  if (finished) return;
+  try {
+    flushBatch();
+    file.setWriteBehind(false);
+  } catch (...) {
+  }
+}
+
+void RelationLoader::addIndex(const std::vector<KeyColumn> &keyColumns) {
+  IndexKeys keys;
+  keys.keyColumns = keyColumns;
+  std::size_t end = 0;
+  keys.offset = recordSize;
+  for (const KeyColumn &column : keyColumns) {
+    keys.offset = std::min<std::size_t>(keys.offset, column.byteOffset);
+    end = std::max(end, column.byteOffset + columnSize(column.type));
+  }
+  keys.length = end - keys.offset;
+  indexes.push_back(std::move(keys));
+}
+
+void RelationLoader::append(const char *record) {
+  SlotId slot = Page::INVALID_SLOT;
+  if (!batch.empty()) slot = batch.back().appendRecord(record, recordSize);
+  if (slot == Page::INVALID_SLOT) {
+    if (batch.size() == LOAD_BATCH_PAGES) flushBatch();
+    batch.emplace_back();
+    numPages++;
+    slot = batch.back().appendRecord(record, recordSize);
+  }
+  rids.push_back(RecordId{static_cast<PageId>(batch.size() - 1), slot});
+  for (IndexKeys &keys : indexes) {
+    keys.bytes.insert(keys.bytes.end(), record + keys.offset,
+                      record + keys.offset + keys.length);
+  }
+}
+
+void RelationLoader::flushBatch() {
+  if (batch.empty()) return;
+  file.appendPages(batch);
+  for (std::size_t i = batchStart; i < rids.size(); i++) {
+    rids[i].page_number = batch[rids[i].page_number].page_number();
+  }
+  batchStart = rids.size();
+  batch.clear();
+}
+
+std::vector<std::string> RelationLoader::finish(BufMgr *bufMgr,
+                                                double fillFactor) {
+  flushBatch();
+  file.setWriteBehind(false);
+  finished = true;
+
+  std::vector<std::string> names;
+  std::vector<char> record(recordSize);
+  for (IndexKeys &keys : indexes) {
+    const RecordFeed feed =
+        [&](const std::function<void(const RecordId &, const char *)> &add) {
+          const char *bytes = keys.bytes.data();
+          for (const RecordId &rid : rids) {
+            std::memcpy(&record[keys.offset], bytes, keys.length);
+            add(rid, record.data());
+            bytes += keys.length;
+          }
+        };
+    std::string name;
+    {
+      BTreeIndex index(relationName, name, bufMgr, keys.keyColumns, feed,
+                       fillFactor);
+    }
+    names.push_back(name);
+    std::vector<char>().swap(keys.bytes);
+  }
+  return names;
+}
+
+namespace {
+
+// copies a string into a zero-padded field, cutting it to leave a terminator
+void copyField(char *field, std::size_t size, const std::string &value) {
+  const std::size_t length = std::min(value.size(), size - 1);
+  std::memcpy(field, value.data(), length);
+  std::memset(field + length, 0, size - length);
+}
+
+// parses a dollar amount such as "$1,234.56"
+double parseDollars(const std::string &text) {
+  std::string digits;
+  for (char c : text) {
+    if ((c >= '0' && c <= '9') || c == '.') digits.push_back(c);
+  }
+  return std::atof(digits.c_str());
+}
+
+// parses a time such as "Dec-03-01 18:10:40", in the 2000s
+int parseTime(const std::string &text) {
+  static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  std::tm tm = {};
+  for (int month = 0; month < 12; month++) {
+    if (text.compare(0, 3, MONTHS + 3 * month, 3) == 0) tm.tm_mon = month;
+  }
+  if (std::sscanf(text.c_str() + 3, "-%d-%d %d:%d:%d", &tm.tm_mday,
+                  &tm.tm_year, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 5) {
+    return 0;
+  }
+  tm.tm_year += 100;
+  return static_cast<int>(timegm(&tm));
+}
+
+// a bid of the item being read, with its bidder
+struct PendingBid {
+  EbayBid bid;
+  EbayUser bidder;
+};
+
+// reads the fields of a user object into a user
+void readUser(JsonReader &reader, EbayUser &user, std::string &key,
+              std::string &value) {
+  reader.beginObject();
+  while (reader.nextKey(key)) {
+    if (reader.peek() != JsonReader::STRING) {
+      reader.skipValue();
+      continue;
+    }
+    reader.readString(value);
+    if (key == "UserID") {
+      copyField(user.userId, sizeof(user.userId), value);
+    } else if (key == "Rating") {
+      user.rating = std::atoi(value.c_str());
+    } else if (key == "Location") {
+      copyField(user.location, sizeof(user.location), value);
+    } else if (key == "Country") {
+      copyField(user.country, sizeof(user.country), value);
+    }
+  }
+}
+
+// reads a bid object, {"Bid": {"Bidder": {...}, "Time": ..., "Amount": ...}}
+void readBid(JsonReader &reader, PendingBid &pending, std::string &key,
+             std::string &value) {
+  std::memset(&pending, 0, sizeof(pending));
+  reader.beginObject();
+  while (reader.nextKey(key)) {
+    if (key != "Bid") {
+      reader.skipValue();
+      continue;
+    }
+    reader.beginObject();
+    while (reader.nextKey(key)) {
+      if (key == "Bidder") {
+        readUser(reader, pending.bidder, key, value);
+      } else if (key == "Time") {
+        reader.readString(value);
+        pending.bid.time = parseTime(value);
+      } else if (key == "Amount") {
+        reader.readString(value);
+        pending.bid.amount = parseDollars(value);
+      } else {
+        reader.skipValue();
+      }
+    }
+  }
+  std::memcpy(pending.bid.bidder, pending.bidder.userId,
+              sizeof(pending.bid.bidder));
+}
+
+}  // namespace
+
+EbayLoadStats loadEbay(const std::vector<std::string> &jsonFiles,
+                       const std::string &prefix, BufMgr *bufMgr) {
+  RelationLoader items(prefix + ".items", sizeof(EbayItem));
+  items.addIndex({{(int)offsetof(EbayItem, itemId), INTEGER}});
+  RelationLoader users(prefix + ".users", sizeof(EbayUser));
+  users.addIndex({{(int)offsetof(EbayUser, userId), STRING}});
+  RelationLoader bids(prefix + ".bids", sizeof(EbayBid));
+  bids.addIndex({{(int)offsetof(EbayBid, itemId), INTEGER},
+                 {(int)offsetof(EbayBid, amount), DOUBLE}});
+  RelationLoader categories(prefix + ".categories", sizeof(EbayCategory));
+  categories.addIndex({{(int)offsetof(EbayCategory, itemId), INTEGER}});
+
+  EbayLoadStats stats = {};
+  std::unordered_set<std::string> seenUsers;
+  auto addUser = [&](const EbayUser &user) {
+    if (seenUsers.insert(user.userId).second) {
+      users.append(reinterpret_cast<const char *>(&user));
+    }
+  };
+
+  // reused from item to item
+  std::string key;
+  std::string value;
+  std::vector<std::string> itemCategories;
+  std::vector<PendingBid> itemBids;
+  EbayItem item;
+  EbayUser seller;
+  EbayCategory category;
+
+  for (const std::string &name : jsonFiles) {
+    std::ifstream in(name, std::ios::binary);
+    if (!in) throw FileNotFoundException(name);
+    JsonReader reader(in);
+    reader.beginObject();
+    while (reader.nextKey(key)) {
+      if (key != "Items") {
+        reader.skipValue();
+        continue;
+      }
+      reader.beginArray();
+      while (reader.nextElement()) {
+        std::memset(&item, 0, sizeof(item));
+        std::memset(&seller, 0, sizeof(seller));
+        itemCategories.clear();
+        itemBids.clear();
+
+        reader.beginObject();
+        while (reader.nextKey(key)) {
+          const JsonReader::Type type = reader.peek();
+          if (key == "Category" && type == JsonReader::ARRAY) {
+            reader.beginArray();
+            while (reader.nextElement()) {
+              reader.readString(value);
+              // the data set repeats some categories of an item
+              if (std::find(itemCategories.begin(), itemCategories.end(),
+                            value) == itemCategories.end()) {
+                itemCategories.push_back(value);
+              }
+            }
+          } else if (key == "Bids" && type == JsonReader::ARRAY) {
+            reader.beginArray();
+            while (reader.nextElement()) {
+              itemBids.emplace_back();
+              readBid(reader, itemBids.back(), key, value);
+            }
+          } else if (key == "Seller" && type == JsonReader::OBJECT) {
+            readUser(reader, seller, key, value);
+          } else if (type != JsonReader::STRING) {
+            reader.skipValue();
+          } else {
+            reader.readString(value);
+            if (key == "ItemID") {
+              item.itemId = std::atoi(value.c_str());
+            } else if (key == "Name") {
+              copyField(item.name, sizeof(item.name), value);
+            } else if (key == "Currently") {
+              item.currently = parseDollars(value);
+            } else if (key == "Buy_Price") {
+              item.buyPrice = parseDollars(value);
+            } else if (key == "First_Bid") {
+              item.firstBid = parseDollars(value);
+            } else if (key == "Number_of_Bids") {
+              item.numberOfBids = std::atoi(value.c_str());
+            } else if (key == "Location") {
+              copyField(item.location, sizeof(item.location), value);
+            } else if (key == "Country") {
+              copyField(item.country, sizeof(item.country), value);
+            } else if (key == "Started") {
+              item.started = parseTime(value);
+            } else if (key == "Ends") {
+              item.ends = parseTime(value);
+            } else if (key == "Description") {
+              copyField(item.description, sizeof(item.description), value);
+            }
+          }
+        }
+
+        std::memcpy(item.seller, seller.userId, sizeof(item.seller));
+        items.append(reinterpret_cast<const char *>(&item));
+        std::memcpy(seller.location, item.location, sizeof(seller.location));
+        std::memcpy(seller.country, item.country, sizeof(seller.country));
+        addUser(seller);
+        for (PendingBid &pending : itemBids) {
+          pending.bid.itemId = item.itemId;
+          bids.append(reinterpret_cast<const char *>(&pending.bid));
+          addUser(pending.bidder);
+        }
+        for (const std::string &text : itemCategories) {
+          std::memset(&category, 0, sizeof(category));
+          category.itemId = item.itemId;
+          copyField(category.category, sizeof(category.category), text);
+          categories.append(reinterpret_cast<const char *>(&category));
+        }
+      }
+    }
+    stats.bytesRead += reader.offset();
+  }
+
+  stats.items = items.records();
+  stats.users = users.records();
+  stats.bids = bids.records();
+  stats.categories = categories.records();
+  stats.pages =
+      items.pages() + users.pages() + bids.pages() + categories.pages();
+  items.finish(bufMgr);
+  users.finish(bufMgr);
+  bids.finish(bufMgr);
+  categories.finish(bufMgr);
+  return stats;
+}
+
+}  // namespace badgerdb
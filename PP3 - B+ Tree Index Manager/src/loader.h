@@ -0,0 +1,219 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * Number of filled pages a loader appends to its file at once
+ */
+const std::size_t LOAD_BATCH_PAGES = 64;
+
+/**
+ * @brief Bulk loader of a new relation of fixed-width records.
+ *
+ * Records are packed into pages in memory until they are full, and the pages
+ * are appended to the file a batch at a time, bypassing any buffer pool.  The
+ * key columns of every record are kept as it is appended, so that when the
+ * load finishes each index of the relation is bulk built from them without
+ * reading the relation back.
+ */
+class RelationLoader {
+ public:
+  /**
+   * Creates the relation file.
+   *
+   * @param relationName  Name of the relation.
+   * @param recordSize    Length of every record in bytes.
+   * @throws  FileExistsException   If the relation already exists.
+   */
+  RelationLoader(const std::string &relationName, std::size_t recordSize);
+
+  /**
+   * Writes out the records appended, unless finish was called.
+   */
+  ~RelationLoader();
+
+  RelationLoader(const RelationLoader &) = delete;
+  RelationLoader &operator=(const RelationLoader &) = delete;
+
+  /**
+   * Adds an index to be built by finish; must be called before any record is
+   * appended.
+   *
+   * @param keyColumns  Attributes the keys are built from, as given to
+   *                    BTreeIndex.
+   */
+  void addIndex(const std::vector<KeyColumn> &keyColumns);
+
+  /**
+   * Appends a record.
+   *
+   * @param record  First byte of the record, of the record size.
+   */
+  void append(const char *record);
+
+  /**
+   * Writes out the records appended and builds the indexes, closing them
+   * again.  No record may be appended afterwards.
+   *
+   * @param bufMgr      Buffer manager the indexes are built through.
+   * @param fillFactor  Fraction of each index node filled.
+   * @return  Names of the index files, in the order the indexes were added.
+   */
+  std::vector<std::string> finish(BufMgr *bufMgr,
+                                  double fillFactor = DEFAULT_FILL_FACTOR);
+
+  /**
+   * Returns the number of records appended.
+   */
+  std::uint64_t records() const { return rids.size(); }
+
+  /**
+   * Returns the number of data pages filled so far.
+   */
+  std::uint64_t pages() const { return numPages; }
+
+ private:
+  /**
+   * Appends the pages of the batch to the file and gives the records of the
+   * batch their page numbers.
+   */
+  void flushBatch();
+
+  /**
+   * Bytes of the records an index is built from: those from the first of its
+   * key columns to the end of the last
+   */
+  struct IndexKeys {
+    std::vector<KeyColumn> keyColumns;
+    std::size_t offset;
+    std::size_t length;
+    std::vector<char> bytes;
+  };
+
+  const std::string relationName;
+  const std::size_t recordSize;
+  PageFile file;
+
+  /**
+   * Pages being filled; the last is the one records go to
+   */
+  std::vector<Page> batch;
+
+  /**
+   * Ids of the records appended; those of the batch hold the position of
+   * their page in the batch until it is appended
+   */
+  std::vector<RecordId> rids;
+
+  /**
+   * Number of the first record of the batch
+   */
+  std::size_t batchStart = 0;
+
+  std::vector<IndexKeys> indexes;
+  std::uint64_t numPages = 0;
+  bool finished = false;
+};
+
+/**
+ * @brief An item of the eBay data set of PP1, with its seller.  Prices are in
+ * dollars, times in seconds since the epoch, UTC.  Strings are zero padded,
+ * and cut to fit if they are longer.
+ */
+struct EbayItem {
+  int itemId;
+  int numberOfBids;
+  int started;
+  int ends;
+  double currently;
+  double firstBid;
+  /**
+   * 0 if the item has no buy price
+   */
+  double buyPrice;
+  char name[80];
+  char seller[40];
+  char location[96];
+  char country[32];
+  char description[256];
+};
+
+/**
+ * @brief A seller or bidder of the eBay data set, at the location it was
+ * first seen with; a seller is at the location of its item.
+ */
+struct EbayUser {
+  char userId[40];
+  int rating;
+  char location[96];
+  char country[32];
+};
+
+/**
+ * @brief A bid of the eBay data set.
+ */
+struct EbayBid {
+  int itemId;
+  int time;
+  double amount;
+  char bidder[40];
+};
+
+/**
+ * @brief A category of an item of the eBay data set, once per item.
+ */
+struct EbayCategory {
+  int itemId;
+  char category[32];
+};
+
+/**
+ * @brief Counts of what a load of the eBay data set wrote.
+ */
+struct EbayLoadStats {
+  std::uint64_t items;
+  std::uint64_t users;
+  std::uint64_t bids;
+  std::uint64_t categories;
+  std::uint64_t pages;
+  std::uint64_t bytesRead;
+};
+
+/**
+ * Loads the JSON files of the eBay data set of PP1 into the relations
+ * <prefix>.items, <prefix>.users, <prefix>.bids and <prefix>.categories,
+ * reading each file once as a stream.  The relations are indexed on
+ * EbayItem::itemId, EbayUser::userId, EbayBid::itemId and amount, and
+ * EbayCategory::itemId, the index files being named as by BTreeIndex.
+ *
+ * @param jsonFiles   Files to load, each an object whose "Items" are items.
+ * @param prefix      Prefix of the relation names.
+ * @param bufMgr      Buffer manager the indexes are built through.
+ * @return  Counts of what was loaded.
+ * @throws  FileExistsException   If a relation already exists.
+ * @throws  FileNotFoundException If a JSON file does not exist.
+ * @throws  JsonParseException    If a JSON file is not well formed.
+ */
+EbayLoadStats loadEbay(const std::vector<std::string> &jsonFiles,
+                       const std::string &prefix, BufMgr *bufMgr);
+
+}  // namespace badgerdb
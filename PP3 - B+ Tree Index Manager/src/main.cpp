@@ -6,21 +6,63 @@
  * of Wisconsin-Madison.
  */
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <new>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <tuple>
 #include <vector>
+#include "aggregate.h"
+#include "arena.h"
+#include "batch.h"
 #include "btree.h"
+#include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/corrupt_page_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/file_exists_exception.h"
+#include "exceptions/file_map_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/insufficient_space_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/json_parse_exception.h"
 #include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "exceptions/page_size_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "file_iterator.h"
 #include "filescan.h"
+#include "hash_index.h"
+#include "join.h"
+#include "json.h"
+#include "loader.h"
+#include "numa.h"
 #include "page.h"
 #include "page_iterator.h"
+#include "partitioned_index.h"
+#include "service.h"
+#include "sort.h"
+#include "stats.h"
+#include "trace.h"
+#include "wal.h"
 
 #define checkPassFail(a, b)                                         \
   {                                                                 \
@@ -75,6 +117,14 @@ void createRelationBackward(int rel = relationSize);
 
 void createRelationRandom(int rel = relationSize);
 
+void createRelationItemIds(int rel = relationSize);
+
+void createRelationCategories(int rel, int numCategories);
+
+void createRelationSellers(int rel, int numSellers);
+
+void createRelationBids(const std::string &name, int numBids, int numItems);
+
 std::vector<int> *createTrueRandom(int from, int to, int rate);
 
 void intTests();
@@ -82,6 +132,36 @@ void intTests();
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
             Operator highOp, std::vector<int> *ret_vector = nullptr);
 
+void doubleTests();
+
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp,
+               double highVal, Operator highOp);
+
+void stringTests();
+
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
+               Operator highOp);
+
+int countScan(BTreeIndex *index, const void *lowVal, Operator lowOp,
+              const void *highVal, Operator highOp);
+
+std::vector<RecordId> scanRids(BTreeIndex *index, const void *lowVal,
+                               Operator lowOp, const void *highVal,
+                               Operator highOp, ScanOrder order = ASCENDING);
+
+std::vector<RecordId> batchScanRids(BTreeIndex *index, const void *lowVal,
+                                    Operator lowOp, const void *highVal,
+                                    Operator highOp, std::size_t batchSize,
+                                    ScanOrder order = ASCENDING);
+
+void stringIndexShape(const std::string &indexName, int &height,
+                      int &numLeaves);
+
+bool intDirectoriesMatch(const std::string &indexName);
+
+std::vector<std::pair<int, RecordId>> relationEntries(
+    const std::string &name = relationName);
+
 void indexTests();
 
 void test1_contiguous_ascending();
@@ -93,6 +173,122 @@ void test6_contiguous_ascending_stress();
 void test7_contiguous_descending_stress();
 void test8_contiguous_random_stress();
 void test9_error_test();
+void test10_reopen_index();
+void test11_write_behind();
+void test12_mapped_blob_file();
+void test13_page_reuse();
+void test14_free_space_map();
+void test15_record_view();
+void test16_page_compaction();
+void test17_free_slot_list();
+void test18_string_prefix_compression();
+void test19_zero_record_id();
+void test20_delete_entry();
+void test21_concurrent_index();
+void test22_scan_cursors();
+void test23_batched_scan();
+void test24_insert_batch();
+void test25_point_lookup();
+void test26_descending_scan();
+void test27_posting_lists();
+void test28_covering_index();
+void test29_composite_keys();
+void test30_parallel_build();
+void test31_parallel_scan();
+void test32_filtered_scan();
+void test33_heap_fetch();
+void test34_joins();
+void test35_tuple_batches();
+void test36_hash_aggregate();
+void test37_external_sort();
+void test38_statistics();
+void test39_limit_scans();
+void test40_wal_recovery();
+void test41_fuzzy_checkpoint();
+void test42_page_checksums();
+void test43_compressed_files();
+void test44_direct_io();
+void test45_io_engines();
+void test46_page_size();
+void test47_int_node_directory();
+void test48_pinned_upper_levels();
+void test49_swizzled_children();
+void test50_buf_stats();
+void test51_index_counters();
+
+void test52_tracing();
+void test53_pin_tracking();
+void test54_resize_pool();
+void test55_numa_partitions();
+void test56_arena();
+void test57_file_registry();
+void test58_ebay_loader();
+void test59_hash_index();
+void test60_leaf_summaries();
+void test61_insert_buffer();
+void test62_snapshot_scans();
+void test63_partitioned_index();
+void test64_index_service();
+
+void bench1_bulk_build_vs_insert_build();
+void bench2_buf_hash_table();
+void bench3_buffer_miss_heavy();
+void bench4_concurrent_scan();
+void bench5_replacement_policies();
+void bench6_scan_access_hints();
+void bench7_read_ahead();
+void bench8_write_behind();
+void bench9_mapped_blob_file();
+void bench10_relation_load();
+void bench11_record_view_scan();
+void bench12_record_updates();
+void bench13_slot_reuse();
+void bench14_string_prefix_compression();
+void bench15_int_node_search();
+void bench16_delete_vs_rebuild();
+void bench17_concurrent_index();
+void bench18_batched_scan();
+void bench19_insert_batch();
+void bench20_point_lookup();
+void bench21_descending_top_k();
+void bench22_posting_lists();
+void bench23_covering_index();
+void bench24_composite_keys();
+void bench25_parallel_build();
+void bench26_parallel_scan();
+void bench27_filtered_scan();
+void bench28_heap_fetch();
+void bench29_joins();
+void bench30_tuple_batches();
+void bench31_hash_aggregate();
+void bench32_external_sort();
+void bench33_statistics();
+void bench34_limit_scans();
+void bench35_wal();
+void bench36_fuzzy_checkpoint();
+void bench37_page_checksums();
+void bench38_compressed_files();
+void bench39_direct_io();
+void bench40_io_engines();
+void bench41_page_size();
+void bench42_int_node_directory();
+void bench43_pinned_upper_levels();
+void bench44_swizzled_children();
+void bench45_buf_stats();
+void bench46_index_counters();
+
+void bench47_tracing();
+void bench48_pin_tracking();
+void bench49_resize_pool();
+void bench50_numa();
+void bench52_file_registry();
+void bench53_ebay_loader();
+void bench54_hash_index();
+void bench55_leaf_summaries();
+void bench56_insert_buffer();
+void bench57_snapshot_scans();
+void bench58_partitioned_index();
+void bench59_index_service();
 
 void randomIntTests(std::vector<int> *sortedvec);
 
@@ -149,8 +345,7 @@ int main(int argc, char **argv) {
         fscan.scanNext(scanRid);
         // Assuming RECORD.i is our key, lets extract the key, which we know is
         // INTEGER and whose byte offset is also know inside the record.
-        std::string recordStr = fscan.getRecord();
-        const char *record = recordStr.c_str();
+        const char *record = fscan.getRecordView().data;
         int key = *((int *)(record + offsetof(RECORD, i)));
         std::cout << "Extracted : " << key << std::endl;
       }
@@ -171,6 +366,123 @@ int main(int argc, char **argv) {
   test7_contiguous_descending_stress();
   test8_contiguous_random_stress();
   test9_error_test();
+  test10_reopen_index();
+  test11_write_behind();
+  test12_mapped_blob_file();
+  test13_page_reuse();
+  test14_free_space_map();
+  test15_record_view();
+  test16_page_compaction();
+  test17_free_slot_list();
+  test18_string_prefix_compression();
+  test19_zero_record_id();
+  test20_delete_entry();
+  test21_concurrent_index();
+  test22_scan_cursors();
+  test23_batched_scan();
+  test24_insert_batch();
+  test25_point_lookup();
+  test26_descending_scan();
+  test27_posting_lists();
+  test28_covering_index();
+  test29_composite_keys();
+  test30_parallel_build();
+  test31_parallel_scan();
+  test32_filtered_scan();
+  test33_heap_fetch();
+  test34_joins();
+  test35_tuple_batches();
+  test36_hash_aggregate();
+  test37_external_sort();
+  test38_statistics();
+  test39_limit_scans();
+  test40_wal_recovery();
+  test41_fuzzy_checkpoint();
+  test42_page_checksums();
+  test43_compressed_files();
+  test44_direct_io();
+  test45_io_engines();
+  test46_page_size();
+  test47_int_node_directory();
+  test48_pinned_upper_levels();
+  test49_swizzled_children();
+  test50_buf_stats();
+  test51_index_counters();
+  test52_tracing();
+  test53_pin_tracking();
+  test54_resize_pool();
+  test55_numa_partitions();
+  test56_arena();
+  test57_file_registry();
+  test58_ebay_loader();
+  test59_hash_index();
+  test60_leaf_summaries();
+  test61_insert_buffer();
+  test62_snapshot_scans();
+  test63_partitioned_index();
+  test64_index_service();
+
+  // the timed benchmarks run only when asked for, with --bench
+  if (argc < 2 || std::string(argv[1]) != "--bench") return 1;
+
+  bench1_bulk_build_vs_insert_build();
+  bench2_buf_hash_table();
+  bench3_buffer_miss_heavy();
+  bench4_concurrent_scan();
+  bench5_replacement_policies();
+  bench6_scan_access_hints();
+  bench7_read_ahead();
+  bench8_write_behind();
+  bench9_mapped_blob_file();
+  bench10_relation_load();
+  bench11_record_view_scan();
+  bench12_record_updates();
+  bench13_slot_reuse();
+  bench14_string_prefix_compression();
+  bench15_int_node_search();
+  bench16_delete_vs_rebuild();
+  bench17_concurrent_index();
+  bench18_batched_scan();
+  bench19_insert_batch();
+  bench20_point_lookup();
+  bench21_descending_top_k();
+  bench22_posting_lists();
+  bench23_covering_index();
+  bench24_composite_keys();
+  bench25_parallel_build();
+  bench26_parallel_scan();
+  bench27_filtered_scan();
+  bench28_heap_fetch();
+  bench29_joins();
+  bench30_tuple_batches();
+  bench31_hash_aggregate();
+  bench32_external_sort();
+  bench33_statistics();
+  bench34_limit_scans();
+  bench35_wal();
+  bench36_fuzzy_checkpoint();
+  bench37_page_checksums();
+  bench38_compressed_files();
+  bench39_direct_io();
+  bench40_io_engines();
+  bench41_page_size();
+  bench42_int_node_directory();
+  bench43_pinned_upper_levels();
+  bench44_swizzled_children();
+  bench45_buf_stats();
+  bench46_index_counters();
+  bench47_tracing();
+  bench48_pin_tracking();
+  bench49_resize_pool();
+  bench50_numa();
+  bench52_file_registry();
+  bench53_ebay_loader();
+  bench54_hash_index();
+  bench55_leaf_summaries();
+  bench56_insert_buffer();
+  bench57_snapshot_scans();
+  bench58_partitioned_index();
+  bench59_index_service();
 
   return 1;
 }
@@ -190,6 +502,8 @@ void test1_contiguous_ascending() {
   std::cout << "test1_contiguous_ascending" << std::endl;
   createRelationForward();
   intTests();
+  doubleTests();
+  stringTests();
   deleteIndexFile();
   deleteRelation();
 }
@@ -201,6 +515,8 @@ void test2_contiguous_descending() {
   std::cout << "test2_contiguous_descending" << std::endl;
   createRelationBackward();
   intTests();
+  doubleTests();
+  stringTests();
   deleteIndexFile();
   deleteRelation();
 }
@@ -212,6 +528,8 @@ void test3_contiguous_random() {
   std::cout << "test3_contiguous_random" << std::endl;
   createRelationRandom();
   intTests();
+  doubleTests();
+  stringTests();
   deleteIndexFile();
   deleteRelation();
 }
@@ -262,79 +580,9490 @@ void test8_contiguous_random_stress() {
   deleteRelation();
 }
 
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
-// ######################     Test B+ Tree      ######################## //
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
+void test10_reopen_index() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test10_reopen_index" << std::endl;
+  deleteIndexFile();
+  createRelationRandom();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, INSERT_BUILD);
+    checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+  }
+  // the index file is still there, so it is reopened instead of rebuilt
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+    checkPassFail(intScan(&index, -3000, GT, 200, LT), 200);
+  }
 
-void randomIntTests(std::vector<int> *sortedvec) {
-  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
-                   INTEGER);
-  std::vector<int> resultvec;
+  std::cout << "Reopen with mismatching attribute type" << std::endl;
+  try {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     DOUBLE);
+    std::cout << "BadIndexInfoException Test 1 Failed." << std::endl;
+  } catch (BadIndexInfoException e) {
+    std::cout << "BadIndexInfoException Test 1 Passed." << std::endl;
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
 
-  int minVal = sortedvec->front();
-  int maxVal = sortedvec->back();
-  int numElem = sortedvec->size();
+void test11_write_behind() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test11_write_behind" << std::endl;
+  deleteRelation();
+  {
+    PageFile relFile = PageFile::create(relationName);
+    relFile.setWriteBehind(true);
+    for (int i = 0; i < 300; i++) {
+      PageId pageNo;
+      Page page = relFile.allocatePage(pageNo);
+      record1.i = i;
+      page.insertRecord(
+          std::string(reinterpret_cast<char *>(&record1), sizeof(record1)));
+      relFile.writePage(pageNo, page);
+    }
 
-  checkPassFail(intScan(&index, minVal, GTE, maxVal, LTE, &resultvec), numElem);
-  if (*sortedvec == resultvec)
-    std::cout << "Random int test passed at line no:" << __LINE__ << std::endl;
-  else
-    std::cout << "Random int test failed at line no:" << __LINE__ << std::endl;
+    // deferred writes are seen through every object for the file
+    PageFile other = PageFile::open(relationName);
+    checkPassFail(other.writeBehind(), true);
+    int numPages = 0;
+    int keySum = 0;
+    for (FileIterator iter = other.begin(); iter != other.end(); ++iter) {
+      Page page = *iter;
+      std::string record = *page.begin();
+      keySum += reinterpret_cast<const RECORD *>(record.data())->i;
+      numPages++;
+    }
+    checkPassFail(numPages, 300);
+    checkPassFail(keySum, 299 * 300 / 2);
+    relFile.sync();
+  }
+  {
+    std::ifstream onDisk(relationName, std::ios::binary | std::ios::ate);
+    // the 300 pages follow the header and a free-space map page
+    checkPassFail(static_cast<long>(onDisk.tellg()),
+                  static_cast<long>(302 * Page::SIZE));
+  }
+  {
+    PageFile relFile = PageFile::open(relationName);
+    checkPassFail(relFile.writeBehind(), false);
+    int numPages = 0;
+    for (FileIterator iter = relFile.begin(); iter != relFile.end(); ++iter)
+      numPages++;
+    checkPassFail(numPages, 300);
+  }
+  deleteRelation();
 }
 
-void intTests() {
-  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
-                   INTEGER);
+void test12_mapped_blob_file() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test12_mapped_blob_file" << std::endl;
+  const std::string fileName = relationName + ".mapped";
+  try {
+    File::remove(fileName);
+  } catch (FileNotFoundException e) {
+  }
+  // enough pages for the mapping to grow several times
+  const int numPages = 3 * MAPPED_FILE_CHUNK_PAGES + 10;
+  {
+    MappedBlobFile mapped = MappedBlobFile::create(fileName);
+    MappedBlobFile other = MappedBlobFile::open(fileName);
+    for (int i = 0; i < numPages; i++) {
+      PageId pageNo;
+      Page page = mapped.allocatePage(pageNo);
+      record1.i = i;
+      page.insertRecord(
+          std::string(reinterpret_cast<char *>(&record1), sizeof(record1)));
+      mapped.writePage(pageNo, page);
+    }
+    int keySum = 0;
+    for (PageId pageNo = 1; pageNo <= PageId(numPages); pageNo++) {
+      Page page = other.readPage(pageNo);
+      std::string record = *page.begin();
+      keySum += reinterpret_cast<const RECORD *>(record.data())->i;
+    }
+    checkPassFail(keySum, (numPages - 1) * numPages / 2);
+    checkPassFail(other.getFirstPageNo(), PageId(1));
+    mapped.sync();
+  }
+  {
+    // the file format is that of BlobFile
+    BlobFile blobFile = BlobFile::open(fileName);
+    Page page = blobFile.readPage(numPages);
+    std::string record = *page.begin();
+    checkPassFail(reinterpret_cast<const RECORD *>(record.data())->i,
+                  numPages - 1);
+  }
+  File::remove(fileName);
+}
 
-  // run some tests
-  checkPassFail(intScan(&index, 25, GT, 40, LT), 14);
-  checkPassFail(intScan(&index, 20, GTE, 35, LTE), 16);
-  checkPassFail(intScan(&index, -3, GT, 3, LT), 3);
-  checkPassFail(intScan(&index, 996, GT, 1001, LT), 4);
-  checkPassFail(intScan(&index, 0, GT, 1, LT), 0);
-  checkPassFail(intScan(&index, 300, GT, 400, LT), 99);
-  checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+// page numbers of the used pages of the file, in list order
+std::string usedPages(PageFile &pageFile) {
+  std::string pages;
+  for (FileIterator iter = pageFile.begin(); iter != pageFile.end(); ++iter)
+    pages += std::to_string((*iter).page_number()) + " ";
+  return pages;
 }
 
-void test_int_out_of_bound() {
-  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
-                   INTEGER);
+void test13_page_reuse() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test13_page_reuse" << std::endl;
+  deleteRelation();
+  {
+    PageFile relFile = PageFile::create(relationName);
+    for (int i = 0; i < 10; i++) {
+      PageId pageNo;
+      relFile.allocatePage(pageNo);
+    }
+    // page 1 holds the free-space map
+    relFile.deletePage(8);
+    relFile.deletePage(4);
+    relFile.deletePage(11);
+    relFile.deletePage(2);
+    checkPassFail(usedPages(relFile), std::string("3 5 6 7 9 10 "));
 
-  checkPassFail(intScan(&index, 3000, GTE, 6000, LT), 2000);
-  checkPassFail(intScan(&index, 4999, GTE, 5010, LT), 1);
+    // freed pages are reused lowest first and keep the list in page order
+    const PageId expected[] = {2, 4, 8, 11, 12};
+    for (PageId pageNo : expected) {
+      PageId newPageNo;
+      relFile.allocatePage(newPageNo);
+      checkPassFail(newPageNo, pageNo);
+    }
+    checkPassFail(usedPages(relFile),
+                  std::string("2 3 4 5 6 7 8 9 10 11 12 "));
+  }
+  deleteRelation();
+}
 
-  checkPassFail(intScan(&index, 5500, GTE, 6000, LT), 0);
-  checkPassFail(intScan(&index, 4999, GT, 6000, LT), 0);
-  checkPassFail(intScan(&index, -3000, GT, 0, LT), 0);
+void test14_free_space_map() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test14_free_space_map" << std::endl;
+  deleteRelation();
+  {
+    PageFile relFile = PageFile::create(relationName);
+    std::string small(sizeof(RECORD), 's');
+    std::string large(3 * Page::DATA_SIZE / 4, 'l');
 
-  checkPassFail(intScan(&index, -3000, GT, 0, LTE), 1);
-  checkPassFail(intScan(&index, -3000, GT, 5, LTE), 6);
-  checkPassFail(intScan(&index, -3000, GT, 200, LT), 200);
+    // a large record takes a new page whose remainder then takes small ones
+    checkPassFail(relFile.insertRecord(large).page_number, PageId(2));
+    checkPassFail(relFile.findPageWithSpace(small.length()), PageId(2));
+    checkPassFail(relFile.insertRecord(small).page_number, PageId(2));
+    checkPassFail(relFile.findPageWithSpace(large.length()),
+                  Page::INVALID_NUMBER);
+    checkPassFail(relFile.insertRecord(large).page_number, PageId(3));
+
+    // small records fill each page, up to the rounding of the map entries,
+    // before the next is allocated
+    int perPage = 0;
+    for (Page page; page.hasSpaceForRecord(small); perPage++)
+      page.insertRecord(small);
+    for (int i = 0; i < 10 * perPage; i++) relFile.insertRecord(small);
+    int numPages = 0;
+    for (FileIterator iter = relFile.begin(); iter != relFile.end(); ++iter)
+      numPages++;
+    checkPassFail((numPages <= 2 + 10), true);
+
+    // map pages cannot be read as data pages
+    try {
+      relFile.readPage(1);
+      std::cout << "InvalidPageException Test 1 Failed." << std::endl;
+    } catch (InvalidPageException e) {
+      std::cout << "InvalidPageException Test 1 Passed." << std::endl;
+    }
+  }
+  deleteRelation();
+}
+
+void test15_record_view() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test15_record_view" << std::endl;
+  Page page;
+  const RecordId first = page.insertRecord("first");
+  const RecordId second = page.insertRecord("second record");
+
+  // a view points into the page and holds the same bytes as a copy
+  RecordView view = page.getRecordView(second);
+  checkPassFail(view.length, std::size_t(13));
+  checkPassFail(view.str(), page.getRecord(second));
+  checkPassFail((view.data >= reinterpret_cast<const char *>(&page) &&
+                 view.data + view.length <=
+                     reinterpret_cast<const char *>(&page + 1)),
+                true);
+
+  // the iterator views the records in slot order
+  PageIterator iter = page.begin();
+  checkPassFail(iter.view().str(), std::string("first"));
+  checkPassFail((iter.getCurrentRecord() == first), true);
+  ++iter;
+  checkPassFail(iter.view().data, view.data);
+}
+
+void test16_page_compaction() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test16_page_compaction" << std::endl;
+  Page::stats().clear();
+  Page page;
+  RecordId rids[4];
+  for (int i = 0; i < 4; i++)
+    rids[i] = page.insertRecord(std::string(1000, 'a' + i));
+
+  // a deleted record in the middle leaves a hole that still counts as free
+  const std::uint16_t contiguous = page.getContiguousFreeSpace();
+  page.deleteRecord(rids[1]);
+  checkPassFail(page.getContiguousFreeSpace(), contiguous);
+  checkPassFail(page.getFreeSpace(), contiguous + 1000);
+
+  // an insert needing the hole compacts the page and reuses the slot
+  const std::string big(contiguous + 500, 'x');
+  const RecordId bigRid = page.insertRecord(big);
+  checkPassFail(bigRid.slot_number, rids[1].slot_number);
+  checkPassFail(page.getFreeSpace(), 500);
+  checkPassFail(Page::stats().compactions, 1u);
+  checkPassFail(Page::stats().reclaimedBytes, 1000u);
+  checkPassFail(page.getRecord(rids[0]), std::string(1000, 'a'));
+  checkPassFail(page.getRecord(rids[3]), std::string(1000, 'd'));
+  checkPassFail(page.getRecord(bigRid), big);
+
+  // the record bordering the free space grows into it without a compaction
+  page.updateRecord(bigRid, big + std::string(400, 'y'));
+  checkPassFail(page.getRecord(bigRid), big + std::string(400, 'y'));
+  checkPassFail(Page::stats().compactions, 1u);
+
+  // a record shrunk in place leaves a hole that compact reclaims
+  page.updateRecord(rids[2], "short");
+  checkPassFail(page.getFreeSpace(), 100 + 995);
+  checkPassFail(page.compact(), 995);
+  checkPassFail(page.compact(), 0);
+  checkPassFail(page.getContiguousFreeSpace(), 100 + 995);
+  checkPassFail(page.getRecord(rids[2]), std::string("short"));
+  checkPassFail(page.getRecord(rids[3]), std::string(1000, 'd'));
+  checkPassFail(Page::stats().reclaimedBytes, 1995u);
+}
+
+void test17_free_slot_list() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test17_free_slot_list" << std::endl;
+  Page page;
+  std::vector<RecordId> rids(301);
+  for (int i = 0; i < 300; i++) rids[i] = page.insertRecord("t");
+
+  // freed slots are reused most recently freed first
+  page.deleteRecord(rids[9]);
+  page.deleteRecord(rids[199]);
+  page.deleteRecord(rids[49]);
+  const SlotId expected[] = {50, 200, 10, 301};
+  for (SlotId slot : expected) {
+    rids[slot - 1] = page.insertRecord("u");
+    checkPassFail(rids[slot - 1].slot_number, slot);
+  }
+
+  // slots trimmed from the end of the slot array leave the list
+  page.deleteRecord(rids[298]);
+  page.deleteRecord(rids[149]);
+  page.deleteRecord(rids[299]);
+  page.deleteRecord(rids[300]);
+  RecordId rid = page.insertRecord("u");
+  checkPassFail(rid.slot_number, SlotId(150));
+  rid = page.insertRecord("u");
+  checkPassFail(rid.slot_number, SlotId(299));
+  checkPassFail(page.getRecord(rids[0]), std::string("t"));
+}
+
+void test18_string_prefix_compression() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test18_string_prefix_compression" << std::endl;
+  deleteIndexFile();
+  createRelationItemIds(100000);
+
+  const BuildMethod methods[] = {INSERT_BUILD, BULK_BUILD};
+  for (BuildMethod method : methods) {
+    {
+      BTreeIndex index(relationName, stringIndexName, bufMgr,
+                       offsetof(tuple, s), STRING, method);
+      const char *low = "1043000500";
+      const char *high = "1043001500";
+      checkPassFail(countScan(&index, low, GT, high, LT), 999);
+      checkPassFail(countScan(&index, "1043099990", GTE, "2", LT), 10);
+
+      // keys sharing no prefix with the item ids shorten the leaf prefixes
+      for (int i = 0; i < 2000; i++) {
+        char key[STRINGSIZE + 1];
+        sprintf(key, "%d", i * 4999);
+        index.insertEntry(key, RecordId{1, (SlotId)(i + 1)});
+      }
+      checkPassFail(countScan(&index, "", GTE, "~", LTE), 102000);
+      checkPassFail(countScan(&index, low, GT, high, LT), 999);
+      checkPassFail(countScan(&index, "1", GTE, "2", LT), 100222);
+    }
+
+    // leaves of item ids sharing a prefix hold more than the uncompressed
+    // STRINGARRAYLEAFSIZE entries
+    int height, numLeaves;
+    stringIndexShape(stringIndexName, height, numLeaves);
+    if (method == BULK_BUILD) {
+      bool compressed = numLeaves < 102000 / STRINGARRAYLEAFSIZE;
+      checkPassFail(compressed, true);
+    }
+    deleteIndexFile();
+  }
+  deleteRelation();
+}
+
+void test19_zero_record_id() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test19_zero_record_id" << std::endl;
+  deleteIndexFile();
+  createRelationForward();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+
+    // leaves count their entries, so a zero record id is a valid entry
+    int low = -10, high = 7000;
+    int key = -5;
+    index.insertEntry(&key, RecordId{0, 0});
+    key = 6000;
+    index.insertEntry(&key, RecordId{0, 0});
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), relationSize + 2);
+
+    RecordId scanRid;
+    index.startScan(&low, GTE, &high, LT);
+    index.scanNext(scanRid);
+    checkPassFail(scanRid.page_number, PageId(0));
+    index.scanNext(scanRid);
+    bool fromRelation = scanRid.page_number != 0;
+    checkPassFail(fromRelation, true);
+    index.endScan();
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test20_delete_entry() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test20_delete_entry" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 50000;
+  createRelationRandom(numRecords);
+
+  // the entries in the order an insert build adds them, and in random order
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+  std::vector<std::pair<int, RecordId>> shuffled = entries;
+  std::srand(2);
+  std::random_shuffle(shuffled.begin(), shuffled.end());
+
+  int low = 0, high = numRecords;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, INSERT_BUILD);
+  }
+  std::ifstream builtFile(intIndexName, std::ios::binary | std::ios::ate);
+  std::streamoff builtSize = builtFile.tellg();
+  builtFile.close();
+
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    bool thrown = false;
+    try {
+      index.deleteEntry(&entries[0].first, RecordId{0, 0});
+    } catch (NoSuchKeyFoundException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+
+    for (const auto &entry : shuffled)
+      if (entry.first % 2 == 1) index.deleteEntry(&entry.first, entry.second);
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), numRecords / 2);
+    checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 500);
+    checkPassFail(intScan(&index, 3001, GTE, 3002, LTE), 1);
+  }
+
+  // the tree and its free pages are found again when the index is reopened
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), numRecords / 2);
+    for (const auto &entry : shuffled)
+      if (entry.first % 2 == 0) index.deleteEntry(&entry.first, entry.second);
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), 0);
+
+    // inserting the entries again takes all new nodes from the free list
+    for (const auto &entry : entries)
+      index.insertEntry(&entry.first, entry.second);
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), numRecords);
+    checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+  }
+  std::ifstream reusedFile(intIndexName, std::ios::binary | std::ios::ate);
+  checkPassFail(reusedFile.tellg(), builtSize);
+  reusedFile.close();
+  deleteIndexFile();
+
+  // STRING leaves are refilled and merged by entries of varying size
+  {
+    BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple, s),
+                     STRING);
+    for (const auto &entry : shuffled) {
+      if (entry.first < 10000 || entry.first >= 40000) continue;
+      char key[100];
+      sprintf(key, "%05d string record", entry.first);
+      index.deleteEntry(key, entry.second);
+    }
+    checkPassFail(countScan(&index, "", GTE, "~", LTE), numRecords - 30000);
+    checkPassFail(stringScan(&index, 9000, GTE, 41000, LT), 2000);
+
+    for (const auto &entry : shuffled) {
+      if (entry.first < 10000 || entry.first >= 40000) continue;
+      char key[100];
+      sprintf(key, "%05d string record", entry.first);
+      index.insertEntry(key, entry.second);
+    }
+    checkPassFail(countScan(&index, "", GTE, "~", LTE), numRecords);
+    checkPassFail(stringScan(&index, 30000, GTE, 31000, LT), 1000);
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test21_concurrent_index() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test21_concurrent_index" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 40000;
+  createRelationRandom(numRecords);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+  std::srand(4);
+  std::random_shuffle(entries.begin(), entries.end());
+
+  BufMgr *pool = new BufMgr(1000, true);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+    auto rangeCount = [&](int low, int high) {
+      std::vector<RecordId> rids;
+      index.scanRange(&low, GTE, &high, LT, rids);
+      return (int)rids.size();
+    };
+
+    // each thread adds a second entry for its share of the keys in the middle
+    // half, splitting the leaves there, and removes the entries of the top
+    // quarter; scans of the middle half must never lose an entry to a split
+    const int numThreads = 4;
+    std::vector<int> errors(numThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+      threads.emplace_back([&, t]() {
+        int lastCount = 0;
+        for (std::size_t i = t; i < entries.size(); i += numThreads) {
+          const int key = entries[i].first;
+          if (key >= numRecords / 4 && key < 3 * numRecords / 4)
+            index.insertEntry(&key, entries[i].second);
+          else if (key >= 3 * numRecords / 4)
+            index.deleteEntry(&key, entries[i].second);
+
+          if (i % 1000 >= numThreads) continue;
+          const int count = rangeCount(numRecords / 4, 3 * numRecords / 4);
+          errors[t] += count < lastCount || count > numRecords;
+          lastCount = count;
+          errors[t] += rangeCount(0, numRecords / 4) != numRecords / 4;
+        }
+      });
+    }
+    for (std::thread &thread : threads) thread.join();
+
+    int numErrors = 0;
+    for (int count : errors) numErrors += count;
+    checkPassFail(numErrors, 0);
+    checkPassFail(rangeCount(0, numRecords / 4), numRecords / 4);
+    checkPassFail(rangeCount(numRecords / 4, 3 * numRecords / 4), numRecords);
+    checkPassFail(rangeCount(3 * numRecords / 4, numRecords), 0);
+    int low = 0, high = numRecords;
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), 5 * numRecords / 4);
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test22_scan_cursors() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test22_scan_cursors" << std::endl;
+  deleteIndexFile();
+  createRelationForward(5000);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+
+    // two overlapping scans advanced in turn, with a startScan() scan run to
+    // its end in between
+    int low1 = 0, high1 = 2000, low2 = 1000, high2 = 3000;
+    IndexScanCursor first = index.openScan(&low1, GTE, &high1, LT);
+    IndexScanCursor second = index.openScan(&low2, GTE, &high2, LTE);
+    std::vector<RecordId> firstRids, secondRids;
+    RecordId scanRid;
+    for (int i = 0; i < 2000; i++) {
+      first.scanNext(scanRid);
+      firstRids.push_back(scanRid);
+      second.scanNext(scanRid);
+      secondRids.push_back(scanRid);
+      if (i == 1000) {
+        int low = 0, high = 5000;
+        checkPassFail(countScan(&index, &low, GTE, &high, LT), 5000);
+      }
+    }
+    bool completed = false;
+    try {
+      first.scanNext(scanRid);
+    } catch (IndexScanCompletedException e) {
+      completed = true;
+    }
+    checkPassFail(completed, true);
+    bool sameEntries = std::equal(firstRids.begin() + 1000, firstRids.end(),
+                                  secondRids.begin());
+    checkPassFail(sameEntries, true);
+    first.endScan();
+
+    // a cursor moved away from is left with no scan
+    IndexScanCursor moved = std::move(second);
+    checkPassFail(second.isExecuting(), false);
+    bool thrown = false;
+    try {
+      second.scanNext(scanRid);
+    } catch (ScanNotInitializedException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+    moved.scanNext(scanRid);
+    checkPassFail(moved.isExecuting(), true);
+
+    // a cursor for each of fifty ranges, all open at once
+    std::vector<IndexScanCursor> cursors;
+    for (int i = 0; i < 50; i++) {
+      int low = 100 * i, high = 100 * i + 99;
+      cursors.push_back(index.openScan(&low, GTE, &high, LTE));
+    }
+    std::vector<int> counts(cursors.size());
+    for (int round = 0; round <= 100; round++) {
+      for (std::size_t c = 0; c < cursors.size(); c++) {
+        try {
+          cursors[c].scanNext(scanRid);
+          counts[c]++;
+        } catch (IndexScanCompletedException e) {
+        }
+      }
+    }
+    int numRanges = std::count(counts.begin(), counts.end(), 100);
+    checkPassFail(numRanges, 50);
+
+    thrown = false;
+    try {
+      int low = 5000, high = 6000;
+      index.openScan(&low, GTE, &high, LT);
+    } catch (NoSuchKeyFoundException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+    // the cursors still open are ended as they go out of scope, before the
+    // index is closed
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test23_batched_scan() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test23_batched_scan" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000;
+  createRelationRandom(numRecords);
+
+  // batches of every size return the entries of single scanNext() calls
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    bool thrown = false;
+    try {
+      RecordId rids[1];
+      index.scanNextBatch(rids, 1);
+    } catch (ScanNotInitializedException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+
+    const int bounds[][2] = {{0, numRecords},  {-10, 2 * numRecords},
+                             {100, 5000},      {5000, 5000},
+                             {7000, 7010},     {numRecords - 1, numRecords}};
+    const Operator ops[][2] = {{GTE, LT}, {GT, LTE}, {GT, LT}, {GTE, LTE}};
+    for (const auto &bound : bounds) {
+      for (const auto &op : ops) {
+        std::vector<RecordId> rids =
+            scanRids(&index, &bound[0], op[0], &bound[1], op[1]);
+        for (std::size_t batchSize : {1, 7, INTARRAYLEAFSIZE, 5000}) {
+          bool sameRids = batchScanRids(&index, &bound[0], op[0], &bound[1],
+                                        op[1], batchSize) == rids;
+          checkPassFail(sameRids, true);
+        }
+      }
+    }
+
+    // the end of the scan is reported again by every later call
+    int low = 100, high = 200;
+    index.startScan(&low, GTE, &high, LT);
+    RecordId rids[256];
+    checkPassFail(index.scanNextBatch(rids, 256), 100u);
+    checkPassFail(index.scanNextBatch(rids, 256), 0u);
+    checkPassFail(index.scanNextBatch(rids, 256), 0u);
+    index.endScan();
+  }
+  deleteIndexFile();
+
+  {
+    BTreeIndex index(relationName, doubleIndexName, bufMgr,
+                     offsetof(tuple, d), DOUBLE);
+    double low = 1000.5, high = 9000;
+    bool sameRids = batchScanRids(&index, &low, GT, &high, LTE, 100) ==
+                    scanRids(&index, &low, GT, &high, LTE);
+    checkPassFail(sameRids, true);
+  }
+  deleteIndexFile();
+
+  {
+    BTreeIndex index(relationName, stringIndexName, bufMgr,
+                     offsetof(tuple, s), STRING);
+    bool sameRids =
+        batchScanRids(&index, "01000", GTE, "09000", LT, 100) ==
+        scanRids(&index, "01000", GTE, "09000", LT);
+    checkPassFail(sameRids, true);
+  }
+  deleteIndexFile();
+
+  // the leaves a concurrent index empties are not merged, and scans pass
+  // over them
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+  BufMgr *pool = new BufMgr(1000, true);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+    for (const auto &entry : entries)
+      if (entry.first >= 5000 && entry.first < 15000)
+        index.deleteEntry(&entry.first, entry.second);
+    int low = 0, high = numRecords;
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), numRecords / 2);
+    checkPassFail(batchScanRids(&index, &low, GTE, &high, LT, 256).size(),
+                  std::size_t(numRecords / 2));
+    low = 4000;
+    high = 16000;
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), 2000);
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
 }
 
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
-// ######################    Create Relation    ######################## //
-// ##################################################################### //
-// ##################################################################### //
-// ##################################################################### //
+void test24_insert_batch() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test24_insert_batch" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 50000;
+  createRelationRandom(numRecords);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+  std::srand(5);
+  std::random_shuffle(entries.begin(), entries.end());
+
+  // every entry of the relation is added again, in batches of varying size
+  std::vector<int> intKeys;
+  std::vector<double> doubleKeys;
+  std::vector<char> stringKeys;
+  std::vector<RecordId> rids;
+  for (const auto &entry : entries) {
+    intKeys.push_back(entry.first);
+    doubleKeys.push_back(entry.first);
+    char key[sizeof(tuple::s)];
+    sprintf(key, "%05d string record", entry.first);
+    stringKeys.insert(stringKeys.end(), key, key + STRINGSIZE);
+    rids.push_back(entry.second);
+  }
+  const std::size_t batchSizes[] = {1, 10, 1000, 20000};
+  auto insertBatches = [&](BTreeIndex &index, const char *keys,
+                           std::size_t keySize) {
+    std::size_t i = 0;
+    for (int b = 0; i < rids.size(); b++) {
+      std::size_t n = std::min(batchSizes[b % 4], rids.size() - i);
+      index.insertBatch(keys + i * keySize, &rids[i], n);
+      i += n;
+    }
+    index.insertBatch(keys, rids.data(), 0);
+  };
+
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    insertBatches(index, (const char *)intKeys.data(), sizeof(int));
+    int low = 0, high = numRecords;
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), 2 * numRecords);
+    checkPassFail(intScan(&index, 25, GT, 40, LT), 28);
+    low = 1000;
+    high = 2000;
+    checkPassFail(countScan(&index, &low, GTE, &high, LTE), 2002);
+  }
+  deleteIndexFile();
+
+  {
+    BTreeIndex index(relationName, doubleIndexName, bufMgr,
+                     offsetof(tuple, d), DOUBLE);
+    insertBatches(index, (const char *)doubleKeys.data(), sizeof(double));
+    double low = 0, high = numRecords;
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), 2 * numRecords);
+    checkPassFail(doubleScan(&index, 25, GT, 40, LT), 28);
+  }
+  deleteIndexFile();
+
+  {
+    BTreeIndex index(relationName, stringIndexName, bufMgr,
+                     offsetof(tuple, s), STRING);
+    insertBatches(index, stringKeys.data(), STRINGSIZE);
+    checkPassFail(countScan(&index, "", GTE, "~", LTE), 2 * numRecords);
+    checkPassFail(stringScan(&index, 25, GT, 40, LT), 28);
+  }
+  deleteIndexFile();
+
+  // a concurrent index inserts the sorted batch one entry at a time
+  BufMgr *pool = new BufMgr(1000, true);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+    index.insertBatch(intKeys.data(), rids.data(), rids.size());
+    int low = 0, high = numRecords;
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), 2 * numRecords);
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test25_point_lookup() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test25_point_lookup" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000;
+  createRelationRandom(numRecords);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+
+  // every third key has a second entry, and key 7777 enough to fill leaves
+  std::vector<int> keys;
+  std::vector<RecordId> rids;
+  for (const auto &entry : entries) {
+    if (entry.first % 3 == 0) {
+      keys.push_back(entry.first);
+      rids.push_back(entry.second);
+    }
+  }
+  for (int i = 0; i < 2000; i++) {
+    keys.push_back(7777);
+    rids.push_back(RecordId{1, (SlotId)i});
+  }
+  auto expected = [&](int key) {
+    if (key < 0 || key >= numRecords) return 0;
+    return key == 7777 ? 2001 : key % 3 == 0 ? 2 : 1;
+  };
+
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    index.insertBatch(keys.data(), rids.data(), keys.size());
+
+    RecordId found[4];
+    int wrong = 0;
+    for (int key = -5; key < numRecords + 5; key++)
+      wrong += (int)index.lookup(&key, found, 4) != expected(key);
+    checkPassFail(wrong, 0);
+
+    // the record ids are those of a scan, and only as many as fit are copied
+    int key = 300;
+    checkPassFail(index.lookup(&key, found, 4), 2u);
+    bool sameRids = std::vector<RecordId>(found, found + 2) ==
+                    scanRids(&index, &key, GTE, &key, LTE);
+    checkPassFail(sameRids, true);
+    key = 7777;
+    std::vector<RecordId> all(2001);
+    checkPassFail(index.lookup(&key, all.data(), all.size()), 2001u);
+    sameRids = all == scanRids(&index, &key, GTE, &key, LTE);
+    checkPassFail(sameRids, true);
+    checkPassFail(index.lookup(&key, found, 1), 2001u);
+    sameRids = found[0] == all[0];
+    checkPassFail(sameRids, true);
+
+    // ascending, descending and repeated keys
+    std::vector<int> probes;
+    for (int key = -5; key < numRecords + 5; key += 2) probes.push_back(key);
+    std::vector<int> reversed(probes.rbegin(), probes.rend());
+    const std::vector<int> repeated = {7777, 7777, 5, 5, 4, 7777};
+    const std::vector<int> *lists[] = {&probes, &reversed, &repeated};
+    for (const std::vector<int> *list : lists) {
+      std::vector<RecordId> manyRids;
+      std::vector<std::size_t> counts;
+      index.lookupMany(list->data(), list->size(), manyRids, counts);
+      std::vector<RecordId> oneRids;
+      wrong = counts.size() != list->size();
+      for (std::size_t i = 0; i < list->size(); i++) {
+        std::vector<RecordId> rids(2001);
+        rids.resize(index.lookup(&(*list)[i], rids.data(), rids.size()));
+        oneRids.insert(oneRids.end(), rids.begin(), rids.end());
+        wrong += (int)counts[i] != expected((*list)[i]);
+      }
+      checkPassFail(wrong, 0);
+      sameRids = manyRids == oneRids;
+      checkPassFail(sameRids, true);
+    }
+
+    // at most maxRidsPerKey record ids of each key, but all of it counted
+    std::vector<RecordId> manyRids, cappedRids;
+    std::vector<std::size_t> counts, cappedCounts;
+    index.lookupMany(repeated.data(), repeated.size(), manyRids, counts);
+    index.lookupMany(repeated.data(), repeated.size(), cappedRids,
+                     cappedCounts, 3);
+    std::vector<RecordId> firstRids;
+    std::size_t first = 0;
+    for (std::size_t count : counts) {
+      const std::size_t n = std::min<std::size_t>(count, 3);
+      firstRids.insert(firstRids.end(), manyRids.begin() + first,
+                       manyRids.begin() + first + n);
+      first += count;
+    }
+    sameRids = cappedCounts == counts && cappedRids == firstRids;
+    checkPassFail(sameRids, true);
+  }
+  deleteIndexFile();
+
+  {
+    BTreeIndex index(relationName, doubleIndexName, bufMgr,
+                     offsetof(tuple, d), DOUBLE);
+    RecordId found[1];
+    double key = 1234;
+    checkPassFail(index.lookup(&key, found, 1), 1u);
+    key = 1234.5;
+    checkPassFail(index.lookup(&key, found, 1), 0u);
+  }
+  deleteIndexFile();
+
+  {
+    BTreeIndex index(relationName, stringIndexName, bufMgr,
+                     offsetof(tuple, s), STRING);
+    const char probes[] = "00010 stri00011 stri19999 stri20000 stri";
+    std::vector<RecordId> manyRids;
+    std::vector<std::size_t> counts;
+    index.lookupMany(probes, 4, manyRids, counts);
+    bool found = counts == std::vector<std::size_t>{1, 1, 1, 0};
+    checkPassFail(found, true);
+  }
+  deleteIndexFile();
+
+  BufMgr *pool = new BufMgr(1000, true);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+    RecordId found[1];
+    int key = 4321;
+    checkPassFail(index.lookup(&key, found, 1), 1u);
+    std::vector<RecordId> manyRids;
+    std::vector<std::size_t> counts;
+    index.lookupMany(&key, 1, manyRids, counts);
+    bool sameRid = manyRids[0] == found[0];
+    checkPassFail(sameRid, true);
+    manyRids.clear();
+    counts.clear();
+    index.lookupMany(&key, 1, manyRids, counts, 0);
+    const bool counted = manyRids.empty() && counts[0] == 1;
+    checkPassFail(counted, true);
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test26_descending_scan() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test26_descending_scan" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000;
+  createRelationRandom(numRecords);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+
+  // a descending scan returns the entries of an ascending one in reverse,
+  // one at a time and in batches, for every pair of operators
+  const Operator lowOps[] = {GT, GTE};
+  const Operator highOps[] = {LT, LTE};
+  auto wrongRanges = [&](BTreeIndex &index, const std::vector<int> &bounds) {
+    int wrong = 0;
+    for (std::size_t i = 0; i + 1 < bounds.size(); i++) {
+      for (Operator lowOp : lowOps) {
+        for (Operator highOp : highOps) {
+          const int low = bounds[i], high = bounds[i + 1];
+          std::vector<RecordId> rids =
+              scanRids(&index, &low, lowOp, &high, highOp);
+          std::reverse(rids.begin(), rids.end());
+          wrong += rids != scanRids(&index, &low, lowOp, &high, highOp,
+                                    DESCENDING);
+          wrong += rids != batchScanRids(&index, &low, lowOp, &high, highOp,
+                                         7, DESCENDING);
+        }
+      }
+    }
+    return wrong;
+  };
+  const std::vector<int> bounds = {-5,   0,    1,    100,  7776,  7777,
+                                   7777, 7778, 9000, 9000, 15000, 19999,
+                                   20003};
+
+  // leaves split by inserts, with key 7777 spanning several of them
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, INSERT_BUILD);
+    std::vector<int> keys(2000, 7777);
+    std::vector<RecordId> rids;
+    for (int i = 0; i < 2000; i++) rids.push_back(RecordId{1, (SlotId)i});
+    index.insertBatch(keys.data(), rids.data(), keys.size());
+    checkPassFail(wrongRanges(index, bounds), 0);
+    checkPassFail(wrongRanges(index, {-1000, 30000}), 0);
+
+    // leaves merged by deletes
+    for (const auto &entry : entries) {
+      if (entry.first >= 3000 && entry.first < 12000 && entry.first % 8 != 0)
+        index.deleteEntry(&entry.first, entry.second);
+    }
+    for (int i = 0; i < 1990; i++) index.deleteEntry(&keys[i], rids[i]);
+    checkPassFail(wrongRanges(index, bounds), 0);
+    int low = 3000, high = 12000;
+    checkPassFail(scanRids(&index, &low, GTE, &high, LT, DESCENDING).size(),
+                  9000u / 8 + 10);
+  }
+  deleteIndexFile();
+
+  {
+    BTreeIndex index(relationName, doubleIndexName, bufMgr,
+                     offsetof(tuple, d), DOUBLE);
+    double low = 25, high = 40;
+    std::vector<RecordId> rids = scanRids(&index, &low, GT, &high, LTE);
+    std::reverse(rids.begin(), rids.end());
+    bool reversed =
+        rids == scanRids(&index, &low, GT, &high, LTE, DESCENDING);
+    checkPassFail(reversed, true);
+  }
+  deleteIndexFile();
+
+  {
+    BTreeIndex index(relationName, stringIndexName, bufMgr,
+                     offsetof(tuple, s), STRING);
+    std::vector<RecordId> rids = scanRids(&index, "", GTE, "~", LTE);
+    std::reverse(rids.begin(), rids.end());
+    bool reversed = rids == scanRids(&index, "", GTE, "~", LTE, DESCENDING);
+    checkPassFail(reversed, true);
+    checkPassFail(rids.size(), (std::size_t)numRecords);
+
+    // the last entry below a bound comes first
+    IndexScanCursor cursor =
+        index.openScan("00100 stri", GT, "00200 stri", LT, NORMAL_ACCESS,
+                       DESCENDING);
+    RecordId rid;
+    cursor.scanNext(rid);
+    bool last = rid == scanRids(&index, "00199 stri", GTE, "00199 stri",
+                                LTE)[0];
+    checkPassFail(last, true);
+  }
+  deleteIndexFile();
+
+  // leaves split by two threads inserting into a concurrent index
+  BufMgr *pool = new BufMgr(1000, true);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; t++) {
+      threads.emplace_back([&, t]() {
+        for (std::size_t i = t; i < entries.size(); i += 2)
+          index.insertEntry(&entries[i].first, entries[i].second);
+      });
+    }
+    for (std::thread &thread : threads) thread.join();
+    checkPassFail(wrongRanges(index, bounds), 0);
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test27_posting_lists() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test27_posting_lists" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 30000;
+  const int numCategories = 20;
+  createRelationCategories(numRecords, numCategories);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+
+  auto ridLess = [](const RecordId &r1, const RecordId &r2) {
+    return r1.page_number != r2.page_number
+               ? r1.page_number < r2.page_number
+               : r1.slot_number < r2.slot_number;
+  };
+  std::vector<std::vector<RecordId>> expected(numCategories);
+  for (const auto &entry : entries)
+    expected[entry.first].push_back(entry.second);
+
+  std::vector<int> intKeys(numCategories);
+  std::vector<double> doubleKeys(numCategories);
+  std::vector<std::string> stringKeys(numCategories);
+  std::vector<const void *> keys[3];
+  for (int c = 0; c < numCategories; c++) {
+    intKeys[c] = c;
+    doubleKeys[c] = c;
+    char key[STRINGSIZE + 1];
+    sprintf(key, "%05d stri", c);
+    stringKeys[c] = key;
+  }
+  for (int c = 0; c < numCategories; c++) {
+    keys[0].push_back(&intKeys[c]);
+    keys[1].push_back(&doubleKeys[c]);
+    keys[2].push_back(stringKeys[c].c_str());
+  }
+
+  // every key has its entries, found by lookups and by scans, which return
+  // them in reverse when descending, one at a time and in batches
+  auto wrongKeys = [&](BTreeIndex &index, const std::vector<const void *> &k) {
+    int wrong = 0;
+    for (int c = 0; c < numCategories; c++) {
+      std::vector<RecordId> rids = scanRids(&index, k[c], GTE, k[c], LTE);
+      std::vector<RecordId> sorted = rids;
+      std::sort(sorted.begin(), sorted.end(), ridLess);
+      std::vector<RecordId> want = expected[c];
+      std::sort(want.begin(), want.end(), ridLess);
+      wrong += sorted != want;
+      wrong += index.lookup(k[c], NULL, 0) != want.size();
+      wrong += rids != batchScanRids(&index, k[c], GTE, k[c], LTE, 100);
+      std::reverse(rids.begin(), rids.end());
+      wrong += rids != scanRids(&index, k[c], GTE, k[c], LTE, DESCENDING);
+      wrong +=
+          rids != batchScanRids(&index, k[c], GTE, k[c], LTE, 7, DESCENDING);
+    }
+
+    // ranges that start and end at keys held in posting lists
+    std::vector<RecordId> rids = scanRids(&index, k[2], GT, k[9], LTE);
+    std::size_t count = 0;
+    for (int c = 3; c <= 9; c++) count += expected[c].size();
+    wrong += rids.size() != count;
+    wrong += rids != batchScanRids(&index, k[2], GT, k[9], LTE, 333);
+    std::reverse(rids.begin(), rids.end());
+    wrong += rids != scanRids(&index, k[2], GT, k[9], LTE, DESCENDING);
+    return wrong;
+  };
+
+  // bulk built indexes of every key type hold a posting list per key
+  const Datatype types[] = {INTEGER, DOUBLE, STRING};
+  std::string names[] = {intIndexName, doubleIndexName,
+                               stringIndexName};
+  const int offsets[] = {offsetof(tuple, i), offsetof(tuple, d),
+                         offsetof(tuple, s)};
+  for (int t = 0; t < 3; t++) {
+    {
+      BTreeIndex index(relationName, names[t], bufMgr, offsets[t], types[t]);
+      checkPassFail(wrongKeys(index, keys[t]), 0);
+    }
+    std::ifstream indexFile(names[t], std::ios::binary | std::ios::ate);
+    // pages past the header
+    bool compact = indexFile.tellg() / Page::SIZE - 1 <= numCategories + 3;
+    checkPassFail(compact, true);
+  }
+  deleteIndexFile();
+
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, INSERT_BUILD);
+    checkPassFail(wrongKeys(index, keys[0]), 0);
+
+    // emptying a posting list removes its entry, and a batch refills it
+    std::vector<RecordId> removed = expected[3];
+    for (const RecordId &rid : removed) index.deleteEntry(&intKeys[3], rid);
+    expected[3].clear();
+    for (std::size_t i = 0; i < expected[5].size(); i += 2)
+      index.deleteEntry(&intKeys[5], expected[5][i]);
+    std::vector<RecordId> kept;
+    for (std::size_t i = 1; i < expected[5].size(); i += 2)
+      kept.push_back(expected[5][i]);
+    expected[5] = kept;
+    checkPassFail(wrongKeys(index, keys[0]), 0);
+
+    std::random_shuffle(removed.begin(), removed.end());
+    std::vector<int> threes(removed.size(), 3);
+    index.insertBatch(threes.data(), removed.data(), removed.size());
+    expected[3] = removed;
+    checkPassFail(wrongKeys(index, keys[0]), 0);
+
+    // a long list spans several posting pages, which are unlinked again as
+    // it shrinks
+    std::vector<RecordId> extra;
+    for (int i = 0; i < 20000; i++)
+      extra.push_back(RecordId{(PageId)(100000 + i / 50), (SlotId)(i % 50)});
+    std::random_shuffle(extra.begin(), extra.end());
+    for (const RecordId &rid : extra) index.insertEntry(&intKeys[7], rid);
+    std::vector<RecordId> sevens = expected[7];
+    expected[7].insert(expected[7].end(), extra.begin(), extra.end());
+    checkPassFail(wrongKeys(index, keys[0]), 0);
+
+    std::random_shuffle(extra.begin(), extra.end());
+    for (std::size_t i = 0; i < extra.size(); i++) {
+      index.deleteEntry(&intKeys[7], extra[i]);
+      if (i == extra.size() / 2) {
+        expected[7] = sevens;
+        expected[7].insert(expected[7].end(), extra.begin() + i + 1,
+                           extra.end());
+        checkPassFail(wrongKeys(index, keys[0]), 0);
+      }
+    }
+    expected[7] = sevens;
+    checkPassFail(wrongKeys(index, keys[0]), 0);
+  }
+
+  // the lists survive a reopen, but a concurrent index can not use them
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(wrongKeys(index, keys[0]), 0);
+  }
+  BufMgr *pool = new BufMgr(1000, true);
+  bool thrown = false;
+  try {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+  } catch (BadIndexInfoException e) {
+    thrown = true;
+  }
+  checkPassFail(thrown, true);
+  deleteIndexFile();
+
+  // a concurrent index keeps every entry in its leaves
+  for (auto &rids : expected) rids.clear();
+  for (const auto &entry : entries)
+    expected[entry.first].push_back(entry.second);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+    checkPassFail(wrongKeys(index, keys[0]), 0);
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test28_covering_index() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test28_covering_index" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000;
+  createRelationRandom(numRecords);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+  std::map<std::pair<PageId, SlotId>, int> keyOf;
+  for (const auto &entry : entries)
+    keyOf[std::make_pair(entry.second.page_number, entry.second.slot_number)] =
+        entry.first;
+
+  // every field of the records, of 22 bytes in all
+  const std::vector<CoveredColumn> columns = {{offsetof(tuple, i), 4},
+                                              {offsetof(tuple, d), 8},
+                                              {offsetof(tuple, s), 10}};
+  const int size = 22;
+  const Datatype types[] = {INTEGER, DOUBLE, STRING};
+  std::string names[] = {intIndexName, doubleIndexName, stringIndexName};
+  const int offsets[] = {offsetof(tuple, i), offsetof(tuple, d),
+                         offsetof(tuple, s)};
+
+  // the columns of each entry returned by scans, one at a time and in batches,
+  // in both orders, are those of its record
+  auto wrongEntries = [&](BTreeIndex &index, int t, std::size_t &count) {
+    int wrong = 0;
+    int low = -1, high = numRecords;
+    double lowDouble = low, highDouble = high;
+    const void *lowKey = &low, *highKey = &high;
+    if (types[t] == DOUBLE) {
+      lowKey = &lowDouble;
+      highKey = &highDouble;
+    } else if (types[t] == STRING) {
+      lowKey = "";
+      highKey = "~";
+    }
+    auto check = [&](RecordId rid, const char *cols) {
+      int i;
+      double d;
+      memcpy(&i, cols, 4);
+      memcpy(&d, cols + 4, 8);
+      char s[STRINGSIZE + 1];
+      sprintf(s, "%05d stri", i);
+      wrong += keyOf[std::make_pair(rid.page_number, rid.slot_number)] != i ||
+               d != i || memcmp(cols + 12, s, STRINGSIZE) != 0;
+    };
+
+    const ScanOrder orders[] = {ASCENDING, DESCENDING};
+    for (ScanOrder order : orders) {
+      RecordId rid;
+      char cols[size];
+      std::size_t scanned = 0;
+      index.startScan(lowKey, GT, highKey, LT, NORMAL_ACCESS, order);
+      try {
+        while (1) {
+          index.scanNext(rid, cols);
+          check(rid, cols);
+          scanned++;
+        }
+      } catch (IndexScanCompletedException e) {
+      }
+      index.endScan();
+
+      RecordId rids[100];
+      char batchCols[100 * size];
+      std::size_t numRids;
+      std::size_t batched = 0;
+      index.startScan(lowKey, GT, highKey, LT, NORMAL_ACCESS, order);
+      while ((numRids = index.scanNextBatch(rids, 100, batchCols)) != 0) {
+        for (std::size_t j = 0; j < numRids; j++)
+          check(rids[j], batchCols + j * size);
+        batched += numRids;
+      }
+      index.endScan();
+      wrong += scanned != batched;
+      count = scanned;
+    }
+    return wrong;
+  };
+
+  // bulk built indexes of every key type
+  for (int t = 0; t < 3; t++) {
+    BTreeIndex index(relationName, names[t], bufMgr, offsets[t], types[t],
+                     BULK_BUILD, DEFAULT_FILL_FACTOR, false, columns);
+    std::size_t count = 0;
+    checkPassFail(wrongEntries(index, t, count), 0);
+    checkPassFail(count, (std::size_t)numRecords);
+  }
+  deleteIndexFile();
+
+  for (int t = 0; t < 3; t++) {
+    BTreeIndex index(relationName, names[t], bufMgr, offsets[t], types[t],
+                     INSERT_BUILD, DEFAULT_FILL_FACTOR, false, columns);
+
+    // leaves split by inserts, merged by deletes and split again by a batch
+    std::size_t count = 0;
+    checkPassFail(wrongEntries(index, t, count), 0);
+    std::vector<std::pair<int, RecordId>> removed;
+    for (const auto &entry : entries) {
+      if (entry.first % 4 != 0) removed.push_back(entry);
+    }
+    for (const auto &entry : removed) {
+      const double d = entry.first;
+      char s[STRINGSIZE + 1];
+      sprintf(s, "%05d stri", entry.first);
+      const void *key = types[t] == INTEGER  ? (const void *)&entry.first
+                        : types[t] == DOUBLE ? (const void *)&d
+                                             : (const void *)s;
+      index.deleteEntry(key, entry.second);
+    }
+    checkPassFail(wrongEntries(index, t, count), 0);
+    checkPassFail(count, (std::size_t)numRecords / 4);
+
+    if (types[t] == INTEGER) {
+      std::random_shuffle(removed.begin(), removed.end());
+      std::vector<int> keys;
+      std::vector<RecordId> rids;
+      for (const auto &entry : removed) {
+        keys.push_back(entry.first);
+        rids.push_back(entry.second);
+      }
+      index.insertBatch(keys.data(), rids.data(), keys.size());
+      checkPassFail(wrongEntries(index, t, count), 0);
+      checkPassFail(count, (std::size_t)numRecords);
+    }
+  }
+
+  // the columns are part of the index file
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, false, columns);
+    std::size_t count = 0;
+    checkPassFail(wrongEntries(index, 0, count), 0);
+  }
+  const std::vector<std::vector<CoveredColumn>> badColumns = {
+      {},
+      {{offsetof(tuple, d), 8}},
+      {{0, 40}, {40, 40}},
+  };
+  for (const auto &bad : badColumns) {
+    bool thrown = false;
+    try {
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                       INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, false, bad);
+    } catch (BadIndexInfoException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+  }
+  deleteIndexFile();
+
+  BufMgr *pool = new BufMgr(100, true);
+  bool thrown = false;
+  try {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true, columns);
+  } catch (BadIndexInfoException e) {
+    thrown = true;
+  }
+  checkPassFail(thrown, true);
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test29_composite_keys() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test29_composite_keys" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000;
+  const int numSellers = 50;
+  const int perSeller = numRecords / numSellers;
+  createRelationSellers(numRecords, numSellers);
+
+  // the record of each seller and rank
+  std::map<std::pair<int, int>, RecordId> ridOf;
+  {
+    FileScan fscan(relationName, bufMgr);
+    try {
+      RecordId scanRid;
+      while (1) {
+        fscan.scanNext(scanRid);
+        const RECORD *record = (const RECORD *)fscan.getRecordView().data;
+        ridOf[std::make_pair(record->i, (int)record->d)] = scanRid;
+      }
+    } catch (EndOfFileException e) {
+    }
+  }
+  auto wantRids = [&](int seller, int fromRank, int toRank) {
+    std::vector<RecordId> rids;
+    for (int rank = fromRank; rank < toRank; rank++)
+      rids.push_back(ridOf[std::make_pair(seller, rank)]);
+    return rids;
+  };
+  auto cursorRids = [](IndexScanCursor cursor) {
+    std::vector<RecordId> rids;
+    RecordId rid;
+    try {
+      while (1) {
+        cursor.scanNext(rid);
+        rids.push_back(rid);
+      }
+    } catch (IndexScanCompletedException e) {
+    }
+    return rids;
+  };
+
+  // keys of the seller and the rank, as a double or as a string
+  const std::vector<KeyColumn> keyColumns[] = {
+      {{offsetof(tuple, i), INTEGER}, {offsetof(tuple, d), DOUBLE}},
+      {{offsetof(tuple, i), INTEGER}, {offsetof(tuple, s), STRING}}};
+  auto packKey = [](int k, int seller, int rank, char *key) {
+    memcpy(key, &seller, sizeof(int));
+    const double d = rank;
+    if (k == 0)
+      memcpy(key + sizeof(int), &d, sizeof(double));
+    else
+      sprintf(key + sizeof(int), "%05d stri", rank);
+  };
+
+  // the entries of a seller come in the order of their rank, and a range of
+  // ranks, a single key and a range of sellers are found
+  auto wrongEntries = [&](BTreeIndex &index, int k) {
+    int wrong = 0;
+    for (int seller = 0; seller < numSellers; seller++) {
+      std::vector<RecordId> rids = wantRids(seller, 0, perSeller);
+      wrong += cursorRids(index.openPrefixScan(&seller, GTE, &seller, LTE,
+                                               1)) != rids;
+      std::reverse(rids.begin(), rids.end());
+      wrong += cursorRids(index.openPrefixScan(&seller, GTE, &seller, LTE, 1,
+                                               NORMAL_ACCESS,
+                                               DESCENDING)) != rids;
+
+      char low[4 + STRINGSIZE + 1], high[4 + STRINGSIZE + 1];
+      packKey(k, seller, 100, low);
+      packKey(k, seller, 200, high);
+      wrong += cursorRids(index.openScan(low, GTE, high, LT)) !=
+               wantRids(seller, 100, 200);
+      wrong += cursorRids(index.openPrefixScan(low, GT, high, LTE, 2)) !=
+               wantRids(seller, 101, 201);
+
+      RecordId rid;
+      wrong += index.lookup(low, &rid, 1) != 1;
+      wrong += rid != ridOf[std::make_pair(seller, 100)];
+    }
+    int from = 10, to = 20;
+    wrong += cursorRids(index.openPrefixScan(&from, GT, &to, LT, 1)).size() !=
+             9u * perSeller;
+    wrong += cursorRids(index.openPrefixScan(&from, GTE, &to, LTE, 1))
+                 .size() != 11u * perSeller;
+    return wrong;
+  };
+
+  const BuildMethod methods[] = {BULK_BUILD, INSERT_BUILD};
+  for (int k = 0; k < 2; k++) {
+    for (BuildMethod method : methods) {
+      BTreeIndex index(relationName, intIndexName, bufMgr, keyColumns[k],
+                       method);
+      checkPassFail(wrongEntries(index, k), 0);
+
+      // entries deleted and inserted again by key
+      const int seller = 7;
+      char key[4 + STRINGSIZE + 1];
+      for (int rank = 1; rank < perSeller; rank += 2) {
+        packKey(k, seller, rank, key);
+        index.deleteEntry(key, ridOf[std::make_pair(seller, rank)]);
+      }
+      checkPassFail(
+          cursorRids(index.openPrefixScan(&seller, GTE, &seller, LTE, 1))
+              .size(),
+          (std::size_t)perSeller / 2);
+      for (int rank = 1; rank < perSeller; rank += 2) {
+        packKey(k, seller, rank, key);
+        index.insertEntry(key, ridOf[std::make_pair(seller, rank)]);
+      }
+      checkPassFail(wrongEntries(index, k), 0);
+
+      // the scan of the index itself
+      int count = 0;
+      RecordId rid;
+      index.startPrefixScan(&seller, GTE, &seller, LTE, 1);
+      try {
+        while (1) {
+          index.scanNext(rid);
+          count++;
+        }
+      } catch (IndexScanCompletedException e) {
+      }
+      index.endScan();
+      checkPassFail(count, perSeller);
+    }
+
+    // the attributes are part of the index file
+    bool thrown = false;
+    try {
+      BTreeIndex index(relationName, intIndexName, bufMgr,
+                       {keyColumns[k][0], {keyColumns[k][1].byteOffset,
+                                           INTEGER}});
+    } catch (BadIndexInfoException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+    deleteIndexFile();
+  }
+
+  // a key of the same attribute twice, whose entries are all duplicates and
+  // so go to posting lists
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr,
+                     {{offsetof(tuple, i), INTEGER},
+                      {offsetof(tuple, i), INTEGER}});
+    int wrong = 0;
+    for (int seller = 0; seller < numSellers; seller++) {
+      const int key[] = {seller, seller};
+      wrong += cursorRids(index.openPrefixScan(&seller, GTE, &seller, LTE, 1))
+                   .size() != (std::size_t)perSeller;
+      wrong += index.lookup(key, NULL, 0) != (std::size_t)perSeller;
+    }
+    checkPassFail(wrong, 0);
+  }
+  deleteIndexFile();
+
+  // keys of attributes with no composite key, and prefixes with no columns
+  // or more columns than the keys
+  const std::vector<std::vector<KeyColumn>> badColumns = {
+      {},
+      {{offsetof(tuple, d), DOUBLE}, {offsetof(tuple, i), INTEGER}},
+      {{offsetof(tuple, i), INTEGER},
+       {offsetof(tuple, d), DOUBLE},
+       {offsetof(tuple, s), STRING}},
+  };
+  for (const auto &bad : badColumns) {
+    bool thrown = false;
+    try {
+      BTreeIndex index(relationName, intIndexName, bufMgr, bad);
+    } catch (BadIndexInfoException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+  }
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    const int seller = 3;
+    checkPassFail(
+        cursorRids(index.openPrefixScan(&seller, GTE, &seller, LTE, 1)).size(),
+        (std::size_t)perSeller);
+    const int numColumns[] = {0, 2};
+    for (int n : numColumns) {
+      bool thrown = false;
+      try {
+        index.openPrefixScan(&seller, GTE, &seller, LTE, n);
+      } catch (BadScanrangeException e) {
+        thrown = true;
+      }
+      checkPassFail(thrown, true);
+    }
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test30_parallel_build() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test30_parallel_build" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000;
+  BufMgr *pool = new BufMgr(1000, true);
+
+  // the entries of an index, in both orders, with their covered columns
+  struct Entries {
+    std::vector<RecordId> rids, descRids;
+    std::vector<char> columns;
+  };
+  auto entriesOf = [](BTreeIndex &index, const void *low, const void *high,
+                      int columnsSize) {
+    Entries entries;
+    RecordId rids[100];
+    std::vector<char> columns(100 * std::max(1, columnsSize));
+    std::size_t numRids;
+    index.startScan(low, GTE, high, LTE);
+    while ((numRids = index.scanNextBatch(
+                rids, 100, columnsSize > 0 ? columns.data() : NULL)) != 0) {
+      entries.rids.insert(entries.rids.end(), rids, rids + numRids);
+      entries.columns.insert(entries.columns.end(), columns.begin(),
+                             columns.begin() + numRids * columnsSize);
+    }
+    index.endScan();
+    entries.descRids = scanRids(&index, low, GTE, high, LTE, DESCENDING);
+    return entries;
+  };
+
+  // an index built on several threads holds the same entries as one built on
+  // a single thread, for any number of threads, even with more threads than
+  // keys
+  const int threadCounts[] = {2, 4, 7, 64};
+  auto checkBuilds = [&](const std::vector<KeyColumn> &keyColumns,
+                         const void *low, const void *high,
+                         const std::vector<CoveredColumn> &covered = {}) {
+    int columnsSize = 0;
+    for (const CoveredColumn &column : covered) columnsSize += column.length;
+    std::string indexName;
+    Entries want;
+    {
+      BTreeIndex index(relationName, indexName, pool, keyColumns, BULK_BUILD,
+                       DEFAULT_FILL_FACTOR, false, covered);
+      want = entriesOf(index, low, high, columnsSize);
+    }
+    File::remove(indexName);
+    for (int numThreads : threadCounts) {
+      {
+        BTreeIndex index(relationName, indexName, pool, keyColumns, BULK_BUILD,
+                         DEFAULT_FILL_FACTOR, false, covered, numThreads);
+        Entries got = entriesOf(index, low, high, columnsSize);
+        const bool same = got.rids == want.rids &&
+                          got.descRids == want.descRids &&
+                          got.columns == want.columns;
+        checkPassFail(same, true);
+
+        // and takes inserts afterwards
+        if (columnsSize == 0) {
+          const std::size_t count = index.lookup(low, NULL, 0);
+          index.insertEntry(low, RecordId{100000, 1});
+          checkPassFail(index.lookup(low, NULL, 0), count + 1);
+        }
+      }
+      File::remove(indexName);
+    }
+    checkPassFail(want.rids.size(), (std::size_t)numRecords);
+  };
+
+  // distinct keys of every type
+  createRelationRandom(numRecords);
+  int lowInt = 0, highInt = numRecords;
+  double lowDouble = 0, highDouble = numRecords;
+  char lowPair[12] = {}, highPair[12];
+  memcpy(highPair, &highInt, 4);
+  memcpy(highPair + 4, &highDouble, 8);
+  checkBuilds({{offsetof(tuple, i), INTEGER}}, &lowInt, &highInt);
+  checkBuilds({{offsetof(tuple, d), DOUBLE}}, &lowDouble, &highDouble);
+  checkBuilds({{offsetof(tuple, s), STRING}}, "", "~");
+  checkBuilds({{offsetof(tuple, i), INTEGER}, {offsetof(tuple, d), DOUBLE}},
+              lowPair, highPair);
+
+  // entries carrying covered columns
+  checkBuilds({{offsetof(tuple, i), INTEGER}}, &lowInt, &highInt,
+              {{offsetof(tuple, d), 8}, {offsetof(tuple, s), 10}});
+  deleteRelation();
+
+  // few keys of many records each, whose entries go to posting lists
+  createRelationSellers(numRecords, 20);
+  checkBuilds({{offsetof(tuple, i), INTEGER}}, &lowInt, &highInt);
+  deleteRelation();
+
+  // an empty relation
+  createRelationSellers(0, 1);
+  std::string indexName;
+  {
+    BTreeIndex index(relationName, indexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, false, {}, 4);
+    checkPassFail(countScan(&index, &lowInt, GTE, &highInt, LTE), 0);
+    index.insertEntry(&lowInt, RecordId{1, 1});
+    checkPassFail(countScan(&index, &lowInt, GTE, &highInt, LTE), 1);
+  }
+  File::remove(indexName);
+  deleteRelation();
+  delete pool;
+}
+
+void test31_parallel_scan() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test31_parallel_scan" << std::endl;
+  const int numRecords = 20000;
+  BufMgr *pool = new BufMgr(200, true);
+  createRelationRandom(numRecords);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+  std::map<std::pair<PageId, SlotId>, int> keyOf;
+  for (const auto &entry : entries)
+    keyOf[std::make_pair(entry.second.page_number, entry.second.slot_number)] =
+        entry.first;
+
+  // every record is returned to exactly one worker, with its own contents,
+  // however the pages are split; a worker that is held up on its first page
+  // has the rest of its morsels taken by the others
+  const int workerCounts[] = {1, 4, 7};
+  const std::size_t morselSizes[] = {1, 16, 1000};
+  for (int numWorkers : workerCounts) {
+    for (std::size_t morselSize : morselSizes) {
+      for (int slow = 0; slow < 2; slow++) {
+        ParallelFileScan scan(relationName, pool, numWorkers, morselSize);
+        std::vector<std::vector<std::pair<int, RecordId>>> found(numWorkers);
+        scan.run([&](ParallelFileScan::Worker &worker) {
+          try {
+            RecordId rid;
+            while (1) {
+              worker.scanNext(rid);
+              const RECORD *record =
+                  (const RECORD *)worker.getRecordView().data;
+              found[worker.id()].push_back(std::make_pair(record->i, rid));
+              if (slow && worker.id() == 0 && found[0].size() == 1)
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+          } catch (EndOfFileException e) {
+          }
+        });
+
+        std::vector<std::pair<int, RecordId>> all;
+        for (const auto &part : found)
+          all.insert(all.end(), part.begin(), part.end());
+        int wrong = all.size() != (std::size_t)numRecords;
+        std::map<std::pair<PageId, SlotId>, int> seen;
+        for (const auto &entry : all) {
+          const auto pos = std::make_pair(entry.second.page_number,
+                                          entry.second.slot_number);
+          wrong += keyOf.count(pos) == 0 || keyOf[pos] != entry.first ||
+                   seen[pos]++ != 0;
+        }
+        checkPassFail(wrong, 0);
+        if (slow && numWorkers > 1 && morselSize == 1) {
+          const bool stolen = scan.numSteals() > 0 &&
+                              found[0].size() < (std::size_t)numRecords / 10;
+          checkPassFail(stolen, true);
+        }
+      }
+    }
+  }
+
+  // an exception on one worker ends the scan, with no page left pinned
+  {
+    ParallelFileScan scan(relationName, pool, 4, 1);
+    bool thrown = false;
+    try {
+      scan.run([&](ParallelFileScan::Worker &worker) {
+        RecordId rid;
+        worker.scanNext(rid);
+        if (worker.id() == 2) throw BadScanrangeException();
+      });
+    } catch (BadScanrangeException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+  }
+  deleteRelation();
+
+  // a relation of a single empty page
+  createRelationSellers(0, 1);
+  {
+    ParallelFileScan scan(relationName, pool, 4);
+    int count = 0;
+    scan.run([&](ParallelFileScan::Worker &worker) {
+      try {
+        RecordId rid;
+        worker.scanNext(rid);
+        count++;
+      } catch (EndOfFileException e) {
+      }
+    });
+    checkPassFail(count, 0);
+  }
+  deleteRelation();
+  delete pool;
+}
+
+void test32_filtered_scan() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test32_filtered_scan" << std::endl;
+  const int numRecords = 20000;
+  createRelationRandom(numRecords);
+
+  // every record of the relation, in the order of a scan
+  std::vector<std::pair<RecordId, RECORD>> records;
+  {
+    FileScan fscan(relationName, bufMgr);
+    try {
+      RecordId scanRid;
+      while (1) {
+        fscan.scanNext(scanRid);
+        RECORD record;
+        memcpy(&record, fscan.getRecordView().data, sizeof(RECORD));
+        records.push_back(std::make_pair(scanRid, record));
+      }
+    } catch (EndOfFileException e) {
+    }
+  }
+  checkPassFail(records.size(), (std::size_t)numRecords);
+
+  // a filtered scan returns the records a filter over all records keeps, in
+  // the same order, and their contents
+  auto wrongScan = [&](const std::vector<ScanPredicate> &predicates,
+                       const std::function<bool(const RECORD &)> &keep,
+                       std::size_t &count) {
+    std::vector<RecordId> want;
+    for (const auto &record : records) {
+      if (keep(record.second)) want.push_back(record.first);
+    }
+    std::vector<RecordId> got;
+    int wrong = 0;
+    {
+      FileScan fscan(relationName, bufMgr, predicates);
+      try {
+        RecordId scanRid;
+        while (1) {
+          fscan.scanNext(scanRid);
+          got.push_back(scanRid);
+          const RECORD *record = (const RECORD *)fscan.getRecordView().data;
+          std::string copy = fscan.getRecord();
+          wrong += !keep(*record) || copy.size() != sizeof(RECORD) ||
+                   memcmp(copy.data(), record, sizeof(RECORD)) != 0;
+        }
+      } catch (EndOfFileException e) {
+      }
+    }
+    count = got.size();
+    return wrong + (got != want);
+  };
+
+  // every operator on every type
+  const Operator ops[] = {LT, LTE, GTE, GT, EQ, NE};
+  auto compare = [](Operator op, int c) {
+    switch (op) {
+      case LT: return c < 0;
+      case LTE: return c <= 0;
+      case GTE: return c >= 0;
+      case GT: return c > 0;
+      case EQ: return c == 0;
+      default: return c != 0;
+    }
+  };
+  const int key = 4321;
+  const double d = key;
+  const char *s = "04321";
+  for (Operator op : ops) {
+    std::size_t count;
+    checkPassFail(wrongScan({{offsetof(tuple, i), INTEGER, op, &key}},
+                            [&](const RECORD &r) {
+                              return compare(op, (r.i > key) - (r.i < key));
+                            },
+                            count),
+                  0);
+    checkPassFail(wrongScan({{offsetof(tuple, d), DOUBLE, op, &d}},
+                            [&](const RECORD &r) {
+                              return compare(op, (r.d > d) - (r.d < d));
+                            },
+                            count),
+                  0);
+    checkPassFail(wrongScan({{offsetof(tuple, s), STRING, op, s}},
+                            [&](const RECORD &r) {
+                              return compare(op, strncmp(r.s, s, 5));
+                            },
+                            count),
+                  0);
+    const std::size_t want[] = {key, key + 1, numRecords - key,
+                                numRecords - key - 1, 1, numRecords - 1};
+    checkPassFail(count, want[op]);
+  }
+
+  // conjunctions, a string prefix, and no predicates at all
+  std::size_t count;
+  const int low = 100;
+  const double high = 5000;
+  checkPassFail(wrongScan({{offsetof(tuple, i), INTEGER, GTE, &low},
+                           {offsetof(tuple, d), DOUBLE, LT, &high},
+                           {offsetof(tuple, s), STRING, NE, s},
+                           {offsetof(tuple, i), INTEGER, NE, &low}},
+                          [&](const RECORD &r) {
+                            return r.i > low && r.d < high && r.i != key;
+                          },
+                          count),
+                0);
+  checkPassFail(count, (std::size_t)4898);
+  checkPassFail(wrongScan({{offsetof(tuple, s), STRING, EQ, "001"}},
+                          [](const RECORD &r) {
+                            return strncmp(r.s, "001", 3) == 0;
+                          },
+                          count),
+                0);
+  checkPassFail(count, (std::size_t)100);
+  checkPassFail(wrongScan({}, [](const RECORD &) { return true; }, count), 0);
+  checkPassFail(count, (std::size_t)numRecords);
+
+  // predicates no record satisfies, and attributes past the end of the records
+  const int none = -1;
+  const int pastEnd = sizeof(RECORD);
+  checkPassFail(wrongScan({{offsetof(tuple, i), INTEGER, LT, &key},
+                           {offsetof(tuple, i), INTEGER, LTE, &none}},
+                          [](const RECORD &) { return false; }, count),
+                0);
+  checkPassFail(wrongScan({{pastEnd, INTEGER, NE, &key}},
+                          [](const RECORD &) { return false; }, count),
+                0);
+  checkPassFail(wrongScan({{pastEnd - 2, STRING, NE, s}},
+                          [](const RECORD &) { return false; }, count),
+                0);
+  deleteRelation();
+}
+
+void test33_heap_fetch() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test33_heap_fetch" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000;
+  createRelationRandom(numRecords);
+
+  // the record ids of a range of keys, in key order, and their records read
+  // one record id at a time
+  std::vector<RecordId> rids;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    int low = 1000, high = 3000;
+    rids = scanRids(&index, &low, GTE, &high, LT);
+  }
+  deleteIndexFile();
+  checkPassFail(rids.size(), (std::size_t)2000);
+  auto recordsOf = [](const std::vector<RecordId> &rids) {
+    std::vector<std::string> records;
+    PageFile relation(relationName, false);
+    for (const RecordId &rid : rids) {
+      Page *page;
+      bufMgr->readPage(&relation, rid.page_number, page);
+      records.push_back(page->getRecordView(rid).str());
+      bufMgr->unPinPage(&relation, rid.page_number, false);
+    }
+    bufMgr->flushFile(&relation);
+    return records;
+  };
+
+  // in the order given, every record id is returned with its record, also
+  // when given more than once; in page order, each record once
+  std::vector<RecordId> given = rids;
+  given.insert(given.end(), rids.begin(), rids.begin() + 100);
+  std::vector<RecordId> sorted = rids;
+  std::sort(sorted.begin(), sorted.end(),
+            [](const RecordId &a, const RecordId &b) {
+              return std::make_pair(a.page_number, a.slot_number) <
+                     std::make_pair(b.page_number, b.slot_number);
+            });
+  std::set<PageId> pages;
+  for (const RecordId &rid : rids) pages.insert(rid.page_number);
+
+  const FetchOrder orders[] = {GIVEN_ORDER, PAGE_ORDER};
+  for (FetchOrder order : orders) {
+    std::vector<RecordId> gotRids;
+    std::vector<std::string> gotRecords;
+    std::size_t pagesRead;
+    {
+      HeapFetch fetch(relationName, bufMgr);
+      fetch.fetch(given,
+                  [&](const RecordId &rid, const RecordView &record) {
+                    gotRids.push_back(rid);
+                    gotRecords.push_back(record.str());
+                  },
+                  order);
+      pagesRead = fetch.numPagesRead();
+    }
+    const std::vector<RecordId> &want = order == GIVEN_ORDER ? given : sorted;
+    const bool same = gotRids == want && gotRecords == recordsOf(want);
+    checkPassFail(same, true);
+    checkPassFail(pagesRead, pages.size());
+  }
+
+  // no record ids, and an exception thrown from the callback, after which no
+  // page is left pinned
+  {
+    HeapFetch fetch(relationName, bufMgr);
+    int calls = 0;
+    fetch.fetch({}, [&](const RecordId &, const RecordView &) { calls++; });
+    checkPassFail(calls, 0);
+    checkPassFail(fetch.numPagesRead(), (std::size_t)0);
+
+    bool thrown = false;
+    try {
+      fetch.fetch(rids, [&](const RecordId &, const RecordView &) {
+        if (++calls == 10) throw EndOfFileException();
+      });
+    } catch (EndOfFileException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+  }
+  deleteRelation();
+}
+
+// The pairs of a join, as (left page, left slot, right page, right slot), in
+// one order.
+std::vector<std::tuple<PageId, SlotId, PageId, SlotId>> sortedPairs(
+    const std::vector<JoinPair> &pairs) {
+  std::vector<std::tuple<PageId, SlotId, PageId, SlotId>> sorted;
+  for (const JoinPair &p : pairs)
+    sorted.push_back(std::make_tuple(p.left.page_number, p.left.slot_number,
+                                     p.right.page_number,
+                                     p.right.slot_number));
+  std::sort(sorted.begin(), sorted.end());
+  return sorted;
+}
+
+// Joins the entries of two relations whose keys are equal and lie in
+// [low, high), pair by pair.
+std::vector<JoinPair> bruteForceJoin(
+    const std::vector<std::pair<int, RecordId>> &left,
+    const std::vector<std::pair<int, RecordId>> &right, int low, int high) {
+  std::multimap<int, RecordId> rightOf(right.begin(), right.end());
+  std::vector<JoinPair> pairs;
+  for (const auto &l : left) {
+    if (l.first < low || l.first >= high) continue;
+    auto range = rightOf.equal_range(l.first);
+    for (auto it = range.first; it != range.second; ++it)
+      pairs.push_back(JoinPair{l.second, it->second});
+  }
+  return pairs;
+}
+
+template <class Join>
+std::vector<JoinPair> drainJoin(Join &join, std::size_t maxPairs) {
+  std::vector<JoinPair> pairs;
+  std::vector<JoinPair> batch(maxPairs);
+  std::size_t n;
+  do {
+    n = join.next(batch.data(), maxPairs);
+    pairs.insert(pairs.end(), batch.begin(), batch.begin() + n);
+  } while (n == maxPairs);
+  return pairs;
+}
+
+void test34_joins() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test34_joins" << std::endl;
+  deleteIndexFile();
+  const int numItems = 5000;
+  createRelationRandom(numItems);
+  // bids on items, some of them on items which are not in relA, and several
+  // on most items
+  const std::string bidsName = "relB";
+  createRelationBids(bidsName, 8000, numItems + 1000);
+  const std::vector<std::pair<int, RecordId>> items = relationEntries();
+  const std::vector<std::pair<int, RecordId>> bids = relationEntries(bidsName);
+  const int all = std::numeric_limits<int>::max();
+  const auto bidsItems = sortedPairs(bruteForceJoin(bids, items, 0, all));
+  const auto bidsBids = sortedPairs(bruteForceJoin(bids, bids, 0, all));
+  checkPassFail(bidsItems.empty(), false);
+
+  std::string itemsIntName, itemsDoubleName, itemsStringName;
+  std::string bidsIntName, bidsDoubleName;
+  {
+    BTreeIndex itemsInt(relationName, itemsIntName, bufMgr,
+                        offsetof(tuple, i), INTEGER);
+    BTreeIndex itemsString(relationName, itemsStringName, bufMgr,
+                           offsetof(tuple, s), STRING);
+
+    // for each bid, the item bid on, looked up a batch of bids at a time, on
+    // the item id or on its string form
+    const std::size_t batchSizes[] = {1, 7, 1024};
+    for (std::size_t batchSize : batchSizes) {
+      IndexNestedLoopJoin byInt(bidsName, {{offsetof(tuple, i), INTEGER}},
+                                &itemsInt, bufMgr, batchSize);
+      bool same = sortedPairs(drainJoin(byInt, 100)) == bidsItems;
+      checkPassFail(same, true);
+      IndexNestedLoopJoin byString(bidsName,
+                                   {{offsetof(tuple, s), STRING}},
+                                   &itemsString, bufMgr, batchSize);
+      same = sortedPairs(drainJoin(byString, 1)) == bidsItems;
+      checkPassFail(same, true);
+    }
+
+    // the attributes must be of the types of the keys
+    bool thrown = false;
+    try {
+      IndexNestedLoopJoin join(bidsName, {{offsetof(tuple, d), DOUBLE}},
+                               &itemsInt, bufMgr);
+    } catch (BadIndexInfoException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+  }
+
+  {
+    BTreeIndex itemsInt(relationName, itemsIntName, bufMgr,
+                        offsetof(tuple, i), INTEGER);
+    BTreeIndex itemsDouble(relationName, itemsDoubleName, bufMgr,
+                           offsetof(tuple, d), DOUBLE);
+    BTreeIndex bidsInt(bidsName, bidsIntName, bufMgr, offsetof(tuple, i),
+                       INTEGER);
+    BTreeIndex bidsDouble(bidsName, bidsDoubleName, bufMgr,
+                          offsetof(tuple, d), DOUBLE);
+
+    // bids and items merged on the whole range of keys and on part of it,
+    // with batches smaller than the groups of bids on an item
+    const std::size_t batchSizes[] = {1, 3, 1024};
+    for (std::size_t batchSize : batchSizes) {
+      int low = 0, high = all;
+      SortMergeJoin byInt(&bidsInt, &itemsInt, &low, GTE, &high, LT,
+                          batchSize);
+      bool same = sortedPairs(drainJoin(byInt, 64)) == bidsItems;
+      checkPassFail(same, true);
+
+      double lowD = 1000, highD = 2000;
+      SortMergeJoin byDouble(&bidsDouble, &itemsDouble, &lowD, GTE, &highD,
+                             LT, batchSize);
+      same = sortedPairs(drainJoin(byDouble, 5)) ==
+             sortedPairs(bruteForceJoin(bids, items, 1000, 2000));
+      checkPassFail(same, true);
+
+      // bids paired with every bid on the same item, themselves included,
+      // from two scans of one index
+      SortMergeJoin self(&bidsInt, &bidsInt, &low, GTE, &high, LT, batchSize);
+      same = sortedPairs(drainJoin(self, 1000)) == bidsBids;
+      checkPassFail(same, true);
+    }
+
+    // a range no key falls in joins nothing; keys must be of the same types
+    int low = numItems + 5000, high = numItems + 6000;
+    SortMergeJoin empty(&bidsInt, &itemsInt, &low, GTE, &high, LT);
+    JoinPair pair;
+    checkPassFail(empty.next(&pair, 1), (std::size_t)0);
+    bool thrown = false;
+    try {
+      SortMergeJoin join(&bidsInt, &itemsDouble, &low, GTE, &high, LT);
+    } catch (BadIndexInfoException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+  }
+
+  const std::string indexNames[] = {itemsIntName, itemsDoubleName,
+                                    itemsStringName, bidsIntName,
+                                    bidsDoubleName};
+  for (const std::string &name : indexNames) File::remove(name);
+  File::remove(bidsName);
+  deleteRelation();
+}
+
+void test35_tuple_batches() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test35_tuple_batches" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 5000;
+  createRelationRandom(numRecords);
+  const std::vector<KeyColumn> columns = {{offsetof(tuple, i), INTEGER},
+                                          {offsetof(tuple, d), DOUBLE},
+                                          {offsetof(tuple, s), STRING}};
+
+  // the batches of a scan hold every record once, as records do
+  {
+    FileScan scan(relationName, bufMgr);
+    TupleBatch batch(columns);
+    std::size_t numRows = 0, numBatches = 0, n;
+    std::int64_t sumI = 0;
+    double sumD = 0;
+    bool same = true;
+    while ((n = scan.nextBatch(batch)) > 0) {
+      numRows += n;
+      numBatches++;
+      sumI += batch.sumInt(0);
+      sumD += batch.sumDouble(1);
+      for (std::size_t row = 0; row < n; row++) {
+        char s[64];
+        sprintf(s, "%05d string record", batch.intColumn(0)[row]);
+        same &= batch.doubleColumn(1)[row] == batch.intColumn(0)[row] &&
+                strcmp(batch.stringColumn(2) + row * TupleBatch::STRINGWIDTH,
+                       s) == 0;
+      }
+      same &= batch.numSelected() == n;
+    }
+    checkPassFail(numRows, (std::size_t)numRecords);
+    checkPassFail(numBatches, (std::size_t)(numRecords - 1) / 1024 + 1);
+    checkPassFail(sumI, (std::int64_t)numRecords * (numRecords - 1) / 2);
+    checkPassFail(sumD, (double)numRecords * (numRecords - 1) / 2);
+    checkPassFail(same, true);
+    checkPassFail(scan.nextBatch(batch), (std::size_t)0);
+  }
+
+  // filters on each type narrow the selection as a filter on the records
+  // would, and keep it in row order
+  {
+    const int low = 1000;
+    const double skipped = 1500;
+    const char *high = "02500";
+    const std::vector<ScanPredicate> predicates = {
+        ScanPredicate(offsetof(tuple, i), INTEGER, GTE, &low),
+        ScanPredicate(offsetof(tuple, d), DOUBLE, NE, &skipped),
+        ScanPredicate(offsetof(tuple, s), STRING, LT, high)};
+    FileScan scan(relationName, bufMgr);
+    TupleBatch batch(columns);
+    std::size_t count = 0;
+    std::int64_t sum = 0;
+    bool ordered = true;
+    while (scan.nextBatch(batch) > 0) {
+      batch.filter(0, GTE, &low);
+      batch.filter(1, NE, &skipped);
+      batch.filter(2, LT, high);
+      count += batch.numSelected();
+      sum += batch.sumInt(0);
+      for (std::size_t k = 1; k < batch.numSelected(); k++)
+        ordered &= batch.selection()[k - 1] < batch.selection()[k];
+    }
+    checkPassFail(count, (std::size_t)1499);
+    checkPassFail(sum, (std::int64_t)(1000 + 2499) * 1500 / 2 - 1500);
+    checkPassFail(ordered, true);
+
+    // a filtered scan fills its batches with the records it returns only
+    FileScan filtered(relationName, bufMgr, predicates);
+    count = 0;
+    while (filtered.nextBatch(batch) > 0) count += batch.numSelected();
+    checkPassFail(count, (std::size_t)1499);
+  }
+
+  // the records of the record ids of an index scan, in key order
+  {
+    std::vector<RecordId> rids;
+    {
+      BTreeIndex index(relationName, intIndexName, bufMgr,
+                       offsetof(tuple, i), INTEGER);
+      int low = 100, high = 1100;
+      rids = scanRids(&index, &low, GTE, &high, LT);
+    }
+    deleteIndexFile();
+    HeapFetch fetch(relationName, bufMgr);
+    TupleBatch batch(columns);
+    fetch.fetch(rids, batch, GIVEN_ORDER);
+    bool same = batch.numRows() == rids.size();
+    for (std::size_t row = 0; same && row < batch.numRows(); row++)
+      same = batch.intColumn(0)[row] == 100 + (int)row &&
+             batch.recordIds()[row] == rids[row];
+    checkPassFail(same, true);
+  }
+
+  // a record too short for the attributes is kept out of the selection
+  {
+    TupleBatch batch(columns);
+    const RECORD record = {7, 7.0, "00007"};
+    batch.append({1, 1}, {(const char *)&record, sizeof(RECORD)});
+    batch.append({1, 2}, {(const char *)&record, offsetof(tuple, d)});
+    checkPassFail(batch.numRows(), (std::size_t)2);
+    checkPassFail(batch.numSelected(), (std::size_t)1);
+    checkPassFail(batch.sumInt(0), (std::int64_t)7);
+  }
+  deleteRelation();
+}
+
+void test36_hash_aggregate() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test36_hash_aggregate" << std::endl;
+  deleteIndexFile();
+  const std::string bidsName = "relB";
+  const int numBids = 20000, numItems = 3000;
+  createRelationBids(bidsName, numBids, numItems);
+  const std::vector<KeyColumn> columns = {{offsetof(tuple, i), INTEGER},
+                                          {offsetof(tuple, d), DOUBLE}};
+  const std::vector<AggregateSpec> aggregates = {
+      {COUNT, 0}, {SUM, 0}, {MIN, 1}, {MAX, 1}, {SUM, 1}, {MIN, 0}};
+
+  // the groups of each item as the records give them
+  struct Group {
+    std::int64_t count = 0, sumI = 0, minI = 0;
+    double minD = 0, maxD = 0, sumD = 0;
+  };
+  std::map<int, Group> expected;
+  for (const auto &entry : relationEntries(bidsName)) {
+    Group &g = expected[entry.first];
+    const double d = entry.first;
+    if (g.count == 0) g.minI = entry.first, g.minD = g.maxD = d;
+    g.count++;
+    g.sumI += entry.first;
+    g.minI = std::min<std::int64_t>(g.minI, entry.first);
+    g.minD = std::min(g.minD, d);
+    g.maxD = std::max(g.maxD, d);
+    g.sumD += d;
+  }
+  auto sameGroups = [&](const std::map<int, Group> &got) {
+    if (got.size() != expected.size()) return false;
+    for (const auto &e : expected) {
+      auto it = got.find(e.first);
+      if (it == got.end()) return false;
+      const Group &a = it->second, &b = e.second;
+      if (a.count != b.count || a.sumI != b.sumI || a.minI != b.minI ||
+          a.minD != b.minD || a.maxD != b.maxD || a.sumD != b.sumD)
+        return false;
+    }
+    return true;
+  };
+  auto collect = [](std::map<int, Group> &got, bool &repeated) {
+    return [&got, &repeated](const void *key, const AggregateValue *values) {
+      const int item = *(const int *)key;
+      repeated |= got.count(item) > 0;
+      Group &g = got[item];
+      g.count = values[0].i;
+      g.sumI = values[1].i;
+      g.minD = values[2].d;
+      g.maxD = values[3].d;
+      g.sumD = values[4].d;
+      g.minI = values[5].i;
+    };
+  };
+
+  // in memory, and spilled to partitions once, and several times over
+  const std::size_t maxGroups[] = {65536, 500, 3};
+  for (std::size_t groupsInMemory : maxGroups) {
+    std::map<int, Group> got;
+    bool repeated = false;
+    std::size_t spilled;
+    {
+      HashAggregate aggregate(columns, 0, aggregates, bufMgr, "relB.agg",
+                              groupsInMemory);
+      FileScan scan(bidsName, bufMgr);
+      TupleBatch batch(columns);
+      while (scan.nextBatch(batch) > 0) aggregate.consume(batch);
+      aggregate.finish(collect(got, repeated));
+      spilled = aggregate.numSpilledRows();
+    }
+    checkPassFail(sameGroups(got), true);
+    checkPassFail(repeated, false);
+    const bool spilledAny = spilled > 0;
+    const bool overflowed = groupsInMemory < (std::size_t)numItems;
+    checkPassFail(spilledAny, overflowed);
+    checkPassFail(File::exists("relB.agg.0"), false);
+  }
+
+  // the records of an index scan, grouped by a double, filtered first
+  {
+    std::string indexName;
+    std::vector<RecordId> rids;
+    {
+      BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, i),
+                       INTEGER);
+      int low = 100, high = 400;
+      rids = scanRids(&index, &low, GTE, &high, LT);
+    }
+    File::remove(indexName);
+    HashAggregate aggregate(columns, 1, {{COUNT, 0}, {MAX, 0}}, bufMgr,
+                            "relB.agg", 50);
+    HeapFetch fetch(bidsName, bufMgr);
+    TupleBatch batch(columns);
+    const int skipped = 200;
+    for (std::size_t k = 0; k < rids.size(); k += TupleBatch::CAPACITY) {
+      std::vector<RecordId> some(
+          rids.begin() + k,
+          rids.begin() + std::min(rids.size(), k + TupleBatch::CAPACITY));
+      fetch.fetch(some, batch);
+      batch.filter(0, NE, &skipped);
+      aggregate.consume(batch);
+    }
+    bool same = true;
+    std::size_t numGroups = 0;
+    aggregate.finish([&](const void *key, const AggregateValue *values) {
+      const double d = *(const double *)key;
+      numGroups++;
+      same &= d != skipped && values[0].i == expected[(int)d].count &&
+              values[1].i == (int)d;
+    });
+    checkPassFail(same, true);
+    checkPassFail(numGroups, (std::size_t)299);
+  }
+
+  // strings can be neither grouped by nor aggregated
+  bool thrown = false;
+  try {
+    HashAggregate aggregate({{offsetof(tuple, s), STRING}}, 0, {{COUNT, 0}},
+                            bufMgr, "relB.agg");
+  } catch (BadIndexInfoException e) {
+    thrown = true;
+  }
+  checkPassFail(thrown, true);
+  File::remove(bidsName);
+}
+
+void test37_external_sort() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test37_external_sort" << std::endl;
+  deleteIndexFile();
+  const std::string bidsName = "relB";
+  const int numBids = 20000, numItems = 3000;
+  createRelationBids(bidsName, numBids, numItems);
+  std::vector<RECORD> records;
+  {
+    FileScan scan(bidsName, bufMgr);
+    RecordId rid;
+    try {
+      while (1) {
+        scan.scanNext(rid);
+        records.push_back(*(const RECORD *)scan.getRecordView().data);
+      }
+    } catch (EndOfFileException e) {
+    }
+  }
+  // the position of each bid in the relation, to check the sort is stable
+  for (std::size_t k = 0; k < records.size(); k++) records[k].d = k;
+
+  // sorts the bids in memory and with a buffer of memoryPages pages, and
+  // checks the rows come out in the same order
+  auto sortsLike = [&](const std::vector<KeyColumn> &keys,
+                       std::size_t memoryPages,
+                       bool (*less)(const RECORD &, const RECORD &),
+                       std::size_t &runs, std::size_t &passes) {
+    std::vector<RECORD> expected = records;
+    std::stable_sort(expected.begin(), expected.end(), less);
+    ExternalSort sort(sizeof(RECORD), keys, bufMgr, "relB.sort",
+                      memoryPages);
+    for (const RECORD &record : records) sort.add(&record);
+    bool same = true;
+    std::size_t n = 0;
+    while (const char *row = sort.next()) {
+      const RECORD *record = (const RECORD *)row;
+      same &= n < expected.size() && record->i == expected[n].i &&
+              record->d == expected[n].d &&
+              strcmp(record->s, expected[n].s) == 0;
+      n++;
+    }
+    runs = sort.numRuns();
+    passes = sort.numMergePasses();
+    return same && n == expected.size() && sort.next() == NULL;
+  };
+  auto byItem = [](const RECORD &a, const RECORD &b) { return a.i < b.i; };
+  auto byString = [](const RECORD &a, const RECORD &b) {
+    return strcmp(a.s, b.s) < 0;
+  };
+  auto byItemAndD = [](const RECORD &a, const RECORD &b) {
+    return a.i < b.i || (a.i == b.i && a.d < b.d);
+  };
+  std::size_t runs, passes;
+
+  // all of the rows in memory
+  checkPassFail(sortsLike({{offsetof(tuple, i), INTEGER}}, 1000, byItem, runs,
+                          passes),
+                true);
+  checkPassFail(runs, (std::size_t)0);
+
+  // 49 runs of 4 pages, merged 2 at a time in 5 passes
+  checkPassFail(sortsLike({{offsetof(tuple, i), INTEGER}}, 4, byItem, runs,
+                          passes),
+                true);
+  checkPassFail(passes, (std::size_t)5);
+  checkPassFail(File::exists("relB.sort.run0"), false);
+
+  // one merge of all of the runs
+  checkPassFail(sortsLike({{offsetof(tuple, s), STRING}}, 40, byString, runs,
+                          passes),
+                true);
+  checkPassFail(passes, (std::size_t)0);
+  checkPassFail(runs, (std::size_t)5);
+
+  // two keys, the second of them reversing the order of equal items
+  std::vector<RECORD> original = records;
+  for (RECORD &record : records) record.d = -record.d;
+  checkPassFail(sortsLike({{offsetof(tuple, i), INTEGER},
+                           {offsetof(tuple, d), DOUBLE}},
+                          8, byItemAndD, runs, passes),
+                true);
+  records.swap(original);
+
+  // rows left unread are removed with their runs
+  {
+    ExternalSort sort(sizeof(RECORD), {{offsetof(tuple, i), INTEGER}}, bufMgr,
+                      "relB.sort", 4);
+    for (const RECORD &record : records) sort.add(&record);
+    sort.next();
+  }
+  bool left = false;
+  for (int k = 0; k < 100; k++)
+    left |= File::exists("relB.sort.run" + std::to_string(k));
+  checkPassFail(left, false);
+  File::remove(bidsName);
+}
+
+void test38_statistics() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test38_statistics" << std::endl;
+  deleteIndexFile();
+  const std::string bidsName = "relB";
+  const int numBids = 20000, numItems = 4000;
+  createRelationBids(bidsName, numBids, numItems);
+  const std::vector<std::pair<int, RecordId>> entries =
+      relationEntries(bidsName);
+  std::set<int> items;
+  for (const auto &entry : entries) items.insert(entry.first);
+
+  // every page read gives every record
+  {
+    RelationSample sample(bidsName, bufMgr, numBids * 2, 1000000);
+    checkPassFail(sample.getRecords().size(), (std::size_t)numBids);
+    checkPassFail(sample.estimatedRecords(), (double)numBids);
+  }
+
+  // a fifth of the pages, and records of bids from them
+  std::vector<int> sampled;
+  {
+    RelationSample sample(bidsName, bufMgr, 2000, 40);
+    checkPassFail(sample.numPagesRead(), (std::size_t)40);
+    checkPassFail(sample.getRecords().size(), (std::size_t)2000);
+    const bool close = std::abs(sample.estimatedRecords() - numBids) <
+                       numBids * 0.1;
+    checkPassFail(close, true);
+    bool valid = true;
+    for (const std::string &record : sample.getRecords()) {
+      const RECORD *bid = (const RECORD *)record.data();
+      valid &= record.size() == sizeof(RECORD) && items.count(bid->i) > 0 &&
+               atoi(bid->s) == bid->i;
+    }
+    checkPassFail(valid, true);
+    sampled = sample.intValues(offsetof(tuple, i));
+    RelationSample other(bidsName, bufMgr, 2000, 40, 2);
+    const bool differ = other.intValues(offsetof(tuple, i)) != sampled;
+    checkPassFail(differ, true);
+  }
+
+  // buckets of uniform values split ranges exactly
+  std::vector<int> uniform;
+  for (int v = 0; v < 10000; v++) uniform.push_back(v);
+  std::random_shuffle(uniform.begin(), uniform.end());
+  {
+    EquiDepthHistogram histogram(uniform, 10);
+    checkPassFail(histogram.numBuckets(), 10);
+    const bool tenth =
+        std::abs(histogram.selectivity(1000, GTE, 2000, LT) - 0.1) < 1e-9;
+    checkPassFail(tenth, true);
+    const bool open =
+        std::abs(histogram.selectivity(1000, GT, 2000, LTE) - 0.1) < 1e-9;
+    checkPassFail(open, true);
+    const bool one = std::abs(histogram.selectivity(5) - 1e-4) < 1e-9;
+    checkPassFail(one, true);
+    checkPassFail(histogram.selectivity(20000, GTE, 30000, LT), 0.0);
+  }
+
+  // a frequent value takes buckets of its own
+  {
+    std::vector<int> skewed(uniform.begin(), uniform.begin() + 5000);
+    for (int v = 0; v < 5000; v++) skewed[v] %= 5000;
+    skewed.insert(skewed.end(), 5000, 7);
+    EquiDepthHistogram histogram(skewed, 20);
+    const double seven = histogram.selectivity(7);
+    const bool frequent = seven > 0.45 && seven < 0.55;
+    checkPassFail(frequent, true);
+    const double range = histogram.selectivity(100, GTE, 200, LT);
+    const bool rare = range > 0.005 && range < 0.015;
+    checkPassFail(rare, true);
+  }
+
+  // a histogram of the sample estimates the relation
+  {
+    EquiDepthHistogram histogram(sampled, 20);
+    std::size_t inRange = 0;
+    for (const auto &entry : entries) inRange += entry.first < 1000;
+    const double estimate = histogram.selectivity(0, GTE, 1000, LT);
+    const bool close = std::abs(estimate - (double)inRange / numBids) < 0.05;
+    checkPassFail(close, true);
+    EquiDepthHistogram few({3, 1, 2}, 10);
+    checkPassFail(few.numBuckets(), 3);
+    EquiDepthHistogram none({}, 10);
+    checkPassFail(none.selectivity(1), 0.0);
+  }
+
+  // indexes on the bids, full and half full
+  std::string indexName;
+  {
+    BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    const IndexStats stats = index.getStats();
+    checkPassFail(stats.numEntries, (std::size_t)numBids);
+    checkPassFail(stats.distinctKeys, items.size());
+    checkPassFail(stats.height, 2);
+    const bool full = stats.fillFactor > 0.9 && stats.fillFactor <= 1;
+    checkPassFail(full, true);
+  }
+  File::remove(indexName);
+  {
+    BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, 0.5);
+    const IndexStats stats = index.getStats();
+    checkPassFail(stats.numEntries, (std::size_t)numBids);
+    const bool half = stats.fillFactor > 0.45 && stats.fillFactor < 0.55;
+    checkPassFail(half, true);
+  }
+  File::remove(indexName);
+
+  // a STRING index has the shape its pages give once it is written out
+  {
+    IndexStats stats;
+    {
+      BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, s),
+                       STRING);
+      stats = index.getStats();
+    }
+    int height, numLeaves;
+    stringIndexShape(indexName, height, numLeaves);
+    checkPassFail(stats.height, height);
+    checkPassFail(stats.numLeaves, (std::size_t)numLeaves);
+    checkPassFail(stats.distinctKeys, items.size());
+  }
+  File::remove(indexName);
+
+  // the entries of posting lists are counted
+  createRelationBids(bidsName, numBids, 10);
+  {
+    BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    const IndexStats stats = index.getStats();
+    checkPassFail(stats.numEntries, (std::size_t)numBids);
+    checkPassFail(stats.distinctKeys, (std::size_t)10);
+    checkPassFail(stats.numLeaves, (std::size_t)1);
+  }
+  File::remove(indexName);
+  File::remove(bidsName);
+}
+
+void test39_limit_scans() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test39_limit_scans" << std::endl;
+  deleteIndexFile();
+  const std::string bidsName = "relB";
+  const int numBids = 20000;
+  std::string indexName;
+
+  auto checkScans = [&](int numItems) {
+    BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    const int low = 0, high = numItems;
+    const std::vector<RecordId> all = scanRids(&index, &low, GTE, &high, LT);
+    const std::vector<RecordId> allDesc =
+        scanRids(&index, &low, GTE, &high, LT, DESCENDING);
+    std::vector<int> keys(numBids);
+    {
+      std::vector<RecordId> rids(numBids);
+      IndexScanCursor cursor = index.openScan(&low, GTE, &high, LT);
+      cursor.scanNextBatch(rids.data(), numBids, NULL, keys.data());
+    }
+    auto firstOf = [&](int key) {
+      return std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+    };
+    auto slice = [](const std::vector<RecordId> &rids, std::size_t from,
+                    std::size_t n) {
+      return std::vector<RecordId>(rids.begin() + from,
+                                   rids.begin() + from + n);
+    };
+    std::vector<RecordId> rids(100);
+
+    // LIMIT 10, then 5 more
+    {
+      IndexScanCursor cursor = index.openScan(&low, GTE, &high, LT);
+      cursor.setLimit(10);
+      std::size_t n = cursor.scanNextBatch(rids.data(), 100);
+      rids.resize(n);
+      const bool first = rids == slice(all, 0, 10);
+      checkPassFail(first, true);
+      rids.resize(100);
+      checkPassFail(cursor.scanNextBatch(rids.data(), 100), (std::size_t)0);
+      bool completed = false;
+      RecordId rid;
+      try {
+        cursor.scanNext(rid);
+      } catch (IndexScanCompletedException e) {
+        completed = true;
+      }
+      checkPassFail(completed, true);
+      checkPassFail(cursor.isExecuting(), true);
+      cursor.setLimit(5);
+      n = cursor.scanNextBatch(rids.data(), 100);
+      rids.resize(n);
+      const bool next = rids == slice(all, 10, 5);
+      checkPassFail(next, true);
+      rids.resize(100);
+    }
+
+    // scanNext stops at the limit
+    {
+      IndexScanCursor cursor =
+          index.openScan(&low, GTE, &high, LT, NORMAL_ACCESS, DESCENDING);
+      cursor.setLimit(7);
+      std::vector<RecordId> got;
+      RecordId rid;
+      try {
+        while (1) {
+          cursor.scanNext(rid);
+          got.push_back(rid);
+        }
+      } catch (IndexScanCompletedException e) {
+      }
+      const bool same = got == slice(allDesc, 0, 7);
+      checkPassFail(same, true);
+    }
+
+    // OFFSET 1234 LIMIT 50, then past the end
+    {
+      IndexScanCursor cursor = index.openScan(&low, GTE, &high, LT);
+      checkPassFail(cursor.skip(1234), (std::size_t)1234);
+      cursor.setLimit(50);
+      rids.resize(cursor.scanNextBatch(rids.data(), 100));
+      const bool same = rids == slice(all, 1234, 50);
+      checkPassFail(same, true);
+      rids.resize(100);
+      checkPassFail(cursor.skip(numBids), all.size() - 1284);
+      checkPassFail(cursor.skip(1), (std::size_t)0);
+    }
+
+    // seeks forward, backward, below the range and past it
+    {
+      const int start = numItems / 3;
+      IndexScanCursor cursor = index.openScanFrom(&start);
+      rids.resize(cursor.scanNextBatch(rids.data(), 3));
+      bool same = rids == slice(all, firstOf(start), 3);
+      const int seeks[] = {start + numItems / 3, start + 1, start};
+      for (int key : seeks) {
+        cursor.seek(&key);
+        rids.resize(20);
+        rids.resize(cursor.scanNextBatch(rids.data(), 20));
+        same &= rids == slice(all, firstOf(key), 20);
+      }
+      checkPassFail(same, true);
+      const int past = numItems;
+      cursor.seek(&past);
+      rids.resize(100);
+      checkPassFail(cursor.scanNextBatch(rids.data(), 100), (std::size_t)0);
+    }
+    {
+      const int bound = 5, below = -1;
+      IndexScanCursor cursor = index.openScan(&bound, GT, &high, LT);
+      cursor.skip(100);
+      cursor.seek(&below);
+      rids.resize(cursor.scanNextBatch(rids.data(), 10));
+      const bool same = rids == slice(all, firstOf(bound + 1), 10);
+      checkPassFail(same, true);
+      rids.resize(100);
+    }
+    {
+      const int start = numItems / 2;
+      const std::size_t after = keys.end() - std::upper_bound(keys.begin(),
+                                                              keys.end(),
+                                                              start);
+      IndexScanCursor cursor =
+          index.openScanFrom(&start, NORMAL_ACCESS, DESCENDING);
+      rids.resize(cursor.scanNextBatch(rids.data(), 10));
+      bool same = rids == slice(allDesc, after, 10);
+      const int key = start - 3;
+      const std::size_t afterKey =
+          keys.end() - std::upper_bound(keys.begin(), keys.end(), key);
+      cursor.seek(&key);
+      rids.resize(cursor.scanNextBatch(rids.data(), 10));
+      same &= rids == slice(allDesc, afterKey, 10);
+      // a key past the start of the scan is moved back to it
+      const int past = start + 1;
+      cursor.seek(&past);
+      rids.resize(cursor.scanNextBatch(rids.data(), 10));
+      same &= rids == slice(allDesc, after, 10);
+      checkPassFail(same, true);
+      rids.resize(100);
+    }
+
+    // seeks to the next keys stay in the leaves they are in
+    {
+      const int start = numItems / 4;
+      IndexScanCursor cursor = index.openScanFrom(&start);
+      bufMgr->clearBufStats();
+      bool same = true;
+      RecordId rid;
+      for (int key = start; key < start + 100 && key < numItems; key++) {
+        cursor.seek(&key);
+        cursor.scanNext(rid);
+        same &= rid == all[firstOf(key)];
+      }
+      checkPassFail(same, true);
+      const bool few = bufMgr->getBufStats().accesses < 20;
+      checkPassFail(few, true);
+    }
+
+    bool thrown = false;
+    try {
+      const int past = numItems;
+      index.openScanFrom(&past);
+    } catch (NoSuchKeyFoundException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+  };
+
+  // items with a few bids each, and items whose bids fill posting lists
+  const int itemCounts[] = {3000, 10};
+  for (int numItems : itemCounts) {
+    createRelationBids(bidsName, numBids, numItems);
+    checkScans(numItems);
+    File::remove(indexName);
+  }
+  File::remove(bidsName);
+}
+
+void test40_wal_recovery() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test40_wal_recovery" << std::endl;
+  deleteIndexFile();
+  const std::string bidsName = "relB";
+  const std::string logName = "relB.log";
+  const int numBids = 20000, numItems = 2000;
+  const int numInserts = 3000, numForced = 2000;
+  std::string indexName;
+
+  // the entries inserted after the build, with keys past those of the items
+  auto insertedRid = [](int k) {
+    RecordId rid;
+    rid.page_number = 1000 + k / 50;
+    rid.slot_number = k % 50 + 1;
+    return rid;
+  };
+  RecordId changedRid;
+  changedRid.slot_number = 1;
+  auto changeRecord = [&](BufMgr &pool, File &relation, int value) {
+    Page *page;
+    pool.readPage(&relation, changedRid.page_number, page);
+    std::string record = page->getRecord(changedRid);
+    memcpy(&record[offsetof(tuple, i)], &value, sizeof(value));
+    page->updateRecord(changedRid, record);
+    pool.unPinPage(&relation, changedRid.page_number, true);
+  };
+
+  struct Crash {
+    std::uint32_t commitGroup;
+    bool checkpoint;
+    bool tornTail;
+  };
+  const Crash crashes[] = {{1, false, false}, {64, true, true}};
+  for (const Crash &crash : crashes) {
+    createRelationBids(bidsName, numBids, numItems);
+    changedRid.page_number = PageFile(bidsName, false).getFirstPageNo();
+    LogManager::remove(logName);
+    { BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, i),
+                       INTEGER); }
+
+    // a process inserts entries through a small pool, forcing the log after
+    // numForced of them, then changes a record of the relation twice and
+    // commits the first change only, and crashes
+    const pid_t pid = fork();
+    if (pid == 0) {
+      LogManager log(logName, crash.commitGroup);
+      BufMgr pool(30);
+      pool.setLog(&log);
+      BTreeIndex index(bidsName, indexName, &pool, offsetof(tuple, i),
+                       INTEGER);
+      PageFile relation(bidsName, false);
+      log.addFile(&relation);
+      for (int k = 0; k < numInserts; k++) {
+        const int key = numItems + k;
+        index.insertEntry(&key, insertedRid(k));
+        if (crash.checkpoint && k + 1 == numForced / 2) pool.checkpoint();
+        if (k + 1 == numForced) log.flush();
+      }
+      changeRecord(pool, relation, -1);
+      log.commit();
+      log.flush();
+      changeRecord(pool, relation, -2);
+      _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (crash.tornTail) {
+      std::ofstream tail(LogManager::segmentNames(logName).back(),
+                         std::ios::binary | std::ios::app);
+      tail << "a record torn by the crash";
+    }
+
+    // opening the log redoes it and empties it
+    {
+      LogManager log(logName);
+      const bool redone = log.numRedone() > 0;
+      checkPassFail(redone, true);
+    }
+    checkPassFail(LogManager(logName).numRedone(), (std::size_t)0);
+
+    {
+      BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, i),
+                       INTEGER);
+      const int low = numItems, high = numItems + numInserts;
+      const std::vector<RecordId> rids =
+          scanRids(&index, &low, GTE, &high, LT);
+      // the entries forced to disk are all there, and the others that are
+      // there were inserted before them
+      bool prefix = rids.size() >= (std::size_t)numForced;
+      if (crash.commitGroup == 1) prefix &= rids.size() == (size_t)numInserts;
+      for (std::size_t k = 0; k < rids.size(); k++)
+        prefix &= rids[k] == insertedRid(k);
+      checkPassFail(prefix, true);
+      const int first = 0;
+      checkPassFail(scanRids(&index, &first, GTE, &low, LT).size(),
+                    (std::size_t)numBids);
+    }
+    File::remove(indexName);
+
+    PageFile relation(bidsName, false);
+    tuple record;
+    const std::string bytes = relation.readPage(changedRid.page_number)
+                                  .getRecord(changedRid);
+    memcpy(&record, bytes.data(), sizeof(record));
+    checkPassFail(record.i, -1);
+  }
+
+  // the changes of a concurrent index are not logged
+  {
+    LogManager log(logName);
+    BufMgr pool(30, true);
+    pool.setLog(&log);
+    bool thrown = false;
+    try {
+      BTreeIndex index(bidsName, indexName, &pool, offsetof(tuple, i),
+                       INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+    } catch (BadIndexInfoException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+  }
+  LogManager::remove(logName);
+  File::remove(bidsName);
+}
+
+void test41_fuzzy_checkpoint() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test41_fuzzy_checkpoint" << std::endl;
+  deleteIndexFile();
+  const std::string bidsName = "relB";
+  const std::string logName = "relB.log";
+  const int numBids = 20000, numItems = 2000, numInserts = 3000;
+  const std::size_t segmentSize = 16 << 10;
+  std::string indexName;
+
+  auto insertedRid = [](int k) {
+    RecordId rid;
+    rid.page_number = 1000 + k / 50;
+    rid.slot_number = k % 50 + 1;
+    return rid;
+  };
+  auto buildIndex = [&]() {
+    File::remove(indexName);
+    LogManager::remove(logName);
+    BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+  };
+  createRelationBids(bidsName, numBids, numItems);
+  { BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER); }
+
+  // checkpoints taken while a scan holds a leaf pinned write pages out and
+  // keep the log down to the segment being appended to and the one before
+  {
+    buildIndex();
+    LogManager log(logName, 64, segmentSize);
+    BufMgr pool(100);
+    pool.setLog(&log);
+    BTreeIndex index(bidsName, indexName, &pool, offsetof(tuple, i), INTEGER);
+    bool wrote = true;
+    std::size_t mostSegments = 0;
+    for (int k = 0; k < numInserts; k++) {
+      const int key = numItems + k;
+      index.insertEntry(&key, insertedRid(k));
+      if ((k + 1) % 250 != 0) continue;
+      const int low = 0;
+      RecordId rid;
+      index.startScan(&low, GTE, &numItems, LT);
+      index.scanNext(rid);
+      pool.clearBufStats();
+      pool.checkpoint();
+      wrote &= pool.getBufStats().diskwrites > 0;
+      index.scanNext(rid);
+      index.endScan();
+      mostSegments = std::max(mostSegments,
+                              LogManager::segmentNames(logName).size());
+    }
+    checkPassFail(wrote, true);
+    const bool bounded = mostSegments <= 2 &&
+                         log.getLogStats().bytes > 10 * segmentSize;
+    checkPassFail(bounded, true);
+    const bool checkpointed = log.checkpointLsn() > 0;
+    checkPassFail(checkpointed, true);
+  }
+
+  // a checkpointer in the background does the same on its own
+  {
+    buildIndex();
+    LogManager log(logName, 64, segmentSize);
+    BufMgr pool(100, true);
+    pool.setLog(&log);
+    pool.startCheckpointer(100000, 50);
+    BTreeIndex index(bidsName, indexName, &pool, offsetof(tuple, i), INTEGER);
+    for (int k = 0; k < numInserts; k++) {
+      const int key = numItems + k;
+      index.insertEntry(&key, insertedRid(k));
+    }
+    bool dropped = false;
+    for (int wait = 0; wait < 100 && !dropped; wait++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      dropped = log.getLogStats().segmentsDropped > 0 &&
+                LogManager::segmentNames(logName).size() <= 2;
+    }
+    checkPassFail(dropped, true);
+    pool.stopCheckpointer();
+  }
+
+  // a process crashes while checkpoints are being taken; recovery restores
+  // every entry, and redoes only the records since about the last checkpoint
+  buildIndex();
+  const pid_t pid = fork();
+  if (pid == 0) {
+    LogManager log(logName, 1, segmentSize);
+    BufMgr pool(30, true);
+    pool.setLog(&log);
+    pool.startCheckpointer(100000, 50);
+    BTreeIndex index(bidsName, indexName, &pool, offsetof(tuple, i), INTEGER);
+    for (int k = 0; k < numInserts; k++) {
+      const int key = numItems + k;
+      index.insertEntry(&key, insertedRid(k));
+      if ((k + 1) % 500 == 0) pool.checkpoint();
+    }
+    _exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  {
+    LogManager log(logName);
+    const bool bounded =
+        log.numRedone() > 0 && log.numRedone() < (std::size_t)numInserts / 2;
+    checkPassFail(bounded, true);
+  }
+  {
+    BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    const int low = numItems, high = numItems + numInserts;
+    const std::vector<RecordId> rids = scanRids(&index, &low, GTE, &high, LT);
+    bool all = rids.size() == (std::size_t)numInserts;
+    for (std::size_t k = 0; k < rids.size(); k++)
+      all &= rids[k] == insertedRid(k);
+    checkPassFail(all, true);
+  }
+  File::remove(indexName);
+  LogManager::remove(logName);
+  File::remove(bidsName);
+}
+
+void test42_page_checksums() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test42_page_checksums" << std::endl;
+  deleteIndexFile();
+  const std::string fileName = relationName + ".blob";
+  if (File::exists(fileName)) File::remove(fileName);
+
+  // flips a bit of a page on disk
+  auto corrupt = [](const std::string &name, PageId pageNo,
+                    std::size_t offset) {
+    std::fstream file(name, std::ios::in | std::ios::out | std::ios::binary);
+    const std::streamoff pos = pageNo * Page::SIZE + offset;
+    char byte;
+    file.seekg(pos);
+    file.read(&byte, 1);
+    byte ^= 0x10;
+    file.seekp(pos);
+    file.write(&byte, 1);
+  };
+  // true if reading the page fails its checksum
+  auto corrupted = [](BufMgr &pool, File *file, PageId pageNo) {
+    Page *page;
+    try {
+      pool.readPage(file, pageNo, page);
+    } catch (CorruptPageException e) {
+      return true;
+    }
+    pool.unPinPage(file, pageNo, false);
+    return false;
+  };
+
+  // pages written out by the pool carry their checksum; a change anywhere in
+  // a page, also in the checksum, or half of a page torn, fails it
+  const int numPages = 32;
+  std::vector<PageId> pages;
+  {
+    BlobFile blobFile = BlobFile::create(fileName);
+    BufMgr pool(numPages);
+    for (int i = 0; i < numPages; i++) {
+      PageId pageNo;
+      Page *page;
+      pool.allocPage(&blobFile, pageNo, page);
+      memset(reinterpret_cast<char *>(page), i + 1, Page::BLOB_SIZE);
+      pool.unPinPage(&blobFile, pageNo, true);
+      pages.push_back(pageNo);
+    }
+    pool.flushFile(&blobFile);
+  }
+  corrupt(fileName, pages[0], 0);
+  corrupt(fileName, pages[1], Page::BLOB_SIZE - 1);
+  corrupt(fileName, pages[2], Page::BLOB_SIZE + 1);
+  {
+    std::fstream file(fileName,
+                      std::ios::in | std::ios::out | std::ios::binary);
+    std::vector<char> half(Page::SIZE / 2);
+    file.seekg(pages[4] * Page::SIZE + half.size());
+    file.read(half.data(), half.size());
+    file.seekp(pages[3] * Page::SIZE + half.size());
+    file.write(half.data(), half.size());
+  }
+  {
+    BlobFile blobFile = BlobFile::open(fileName);
+    BufMgr pool(numPages);
+    int failed = 0;
+    for (PageId pageNo : pages) failed += corrupted(pool, &blobFile, pageNo);
+    checkPassFail(failed, 4);
+    checkPassFail(pool.getBufStats().checksumFailures, 4);
+    checkPassFail(pool.getBufStats().checksumsVerified, numPages);
+    // a page failing its checksum is not kept in the pool
+    checkPassFail(corrupted(pool, &blobFile, pages[0]), true);
+    pool.flushFile(&blobFile);
+  }
+
+  // with verification off, the pages are read in as they are; sampled, one
+  // page read in so many is verified
+  {
+    BlobFile blobFile = BlobFile::open(fileName);
+    BufMgr pool(numPages);
+    pool.setChecksumPolicy(CHECKSUM_OFF);
+    int failed = 0;
+    for (PageId pageNo : pages) failed += corrupted(pool, &blobFile, pageNo);
+    checkPassFail(failed, 0);
+    checkPassFail(pool.getBufStats().checksumsVerified, 0);
+    pool.flushFile(&blobFile);
+  }
+  {
+    BlobFile blobFile = BlobFile::open(fileName);
+    BufMgr pool(numPages);
+    pool.setChecksumPolicy(CHECKSUM_SAMPLED, 4);
+    int failed = 0;
+    for (PageId pageNo : pages) failed += corrupted(pool, &blobFile, pageNo);
+    checkPassFail(failed, 1);
+    checkPassFail(pool.getBufStats().checksumsVerified, numPages / 4);
+    pool.flushFile(&blobFile);
+  }
+  File::remove(fileName);
+
+  // pages written to a file directly carry it too, in the header of a
+  // page of records
+  createRelationRandom(5000);
+  bufMgr->flushFile(file1);
+  corrupt(relationName, 3, 0);
+  corrupt(relationName, 4, sizeof(PageHeader) + 100);
+  {
+    BufMgr pool(10);
+    const bool detected = !corrupted(pool, file1, 2) &&
+                          corrupted(pool, file1, 3) &&
+                          corrupted(pool, file1, 4);
+    checkPassFail(detected, true);
+    pool.flushFile(file1);
+  }
+  deleteRelation();
+  createRelationRandom(5000);
+
+  // a scan reaching a corrupt leaf stops rather than following its links
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+  }
+  PageId lastPage;
+  {
+    BlobFile indexFile = BlobFile::open(intIndexName);
+    lastPage = indexFile.getNumPages() - 1;
+  }
+  corrupt(intIndexName, lastPage, 100);
+  {
+    BufMgr pool(100);
+    bool detected = false;
+    try {
+      BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                       INTEGER);
+      const int low = 0, high = 5000;
+      scanRids(&index, &low, GTE, &high, LT);
+    } catch (CorruptPageException e) {
+      detected = true;
+    }
+    checkPassFail(detected, true);
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test43_compressed_files() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test43_compressed_files" << std::endl;
+  deleteIndexFile();
+  auto fileSize = [](const std::string &name) {
+    std::ifstream file(name, std::ios::binary | std::ios::ate);
+    return static_cast<std::uint64_t>(file.tellg());
+  };
+
+  // a compressed relation reads back record for record, also when an index
+  // is built on it
+  const int numRecords = 20000;
+  createRelationRandom(numRecords);
+  bufMgr->flushFile(file1);
+  delete file1;
+  file1 = NULL;
+  const std::vector<std::pair<int, RecordId>> entries = relationEntries();
+  std::uint64_t plainBytes;
+  {
+    PageFile relation = PageFile::open(relationName);
+    checkPassFail(relation.compressed(), false);
+    plainBytes = relation.storedBytes();
+  }
+  File::compress(relationName);
+  {
+    PageFile relation = PageFile::open(relationName);
+    checkPassFail(relation.compressed(), true);
+    const bool smaller = relation.storedBytes() < plainBytes / 2 &&
+                         fileSize(relationName) < plainBytes / 2;
+    checkPassFail(smaller, true);
+  }
+  const bool same = relationEntries() == entries;
+  checkPassFail(same, true);
+
+  const int low = 0, high = numRecords;
+  std::vector<RecordId> rids;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    rids = scanRids(&index, &low, GTE, &high, LT);
+    checkPassFail(rids.size(), (std::size_t)numRecords);
+  }
+
+  // a compressed index is scanned and changed like any other
+  File::compress(intIndexName);
+  {
+    BufMgr pool(50);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    const bool same = scanRids(&index, &low, GTE, &high, LT) == rids;
+    checkPassFail(same, true);
+    for (int key = numRecords; key < 2 * numRecords; key++) {
+      RecordId rid;
+      rid.page_number = key / 100 + 1;
+      rid.slot_number = key % 100 + 1;
+      index.insertEntry(&key, rid);
+    }
+  }
+  std::uint64_t grownBytes, grownSize;
+  {
+    BlobFile indexFile = BlobFile::open(intIndexName);
+    checkPassFail(indexFile.compressed(), true);
+    grownBytes = indexFile.storedBytes();
+  }
+  grownSize = fileSize(intIndexName);
+  {
+    BufMgr pool(50);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    const int all = 2 * numRecords;
+    const std::vector<RecordId> found =
+        scanRids(&index, &low, GTE, &all, LT);
+    const bool same = found.size() == (std::size_t)all &&
+                      std::equal(rids.begin(), rids.end(), found.begin());
+    checkPassFail(same, true);
+  }
+
+  // compressing it again drops the images of the pages since replaced
+  File::compress(intIndexName);
+  {
+    BlobFile indexFile = BlobFile::open(intIndexName);
+    const bool smaller = indexFile.storedBytes() <= grownBytes &&
+                         fileSize(intIndexName) < grownSize;
+    checkPassFail(smaller, true);
+  }
+  {
+    BufMgr pool(50);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    const int all = 2 * numRecords;
+    checkPassFail(scanRids(&index, &low, GTE, &all, LT).size(),
+                  (std::size_t)all);
+  }
+
+  // a compressed file can not be mapped
+  bool refused = false;
+  try {
+    MappedBlobFile mapped = MappedBlobFile::open(intIndexName);
+  } catch (FileMapException e) {
+    refused = true;
+  }
+  checkPassFail(refused, true);
+
+  // a damaged image fails to decompress or fails its checksum
+  {
+    std::fstream file(intIndexName,
+                      std::ios::in | std::ios::out | std::ios::binary);
+    for (std::size_t pos = 1000; pos < 4000; pos += 100) {
+      char byte;
+      file.seekg(sizeof(FileHeader) + pos);
+      file.read(&byte, 1);
+      byte ^= 0x5a;
+      file.seekp(sizeof(FileHeader) + pos);
+      file.write(&byte, 1);
+    }
+  }
+  {
+    BlobFile indexFile = BlobFile::open(intIndexName);
+    BufMgr pool(50);
+    int failed = 0;
+    for (PageId pageNo = 1; pageNo < indexFile.getNumPages(); pageNo++) {
+      Page *page;
+      try {
+        pool.readPage(&indexFile, pageNo, page);
+        pool.unPinPage(&indexFile, pageNo, false);
+      } catch (CorruptPageException e) {
+        failed++;
+      }
+    }
+    const bool detected = failed > 0;
+    checkPassFail(detected, true);
+    pool.flushFile(&indexFile);
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+// number of pages of the file, past its header, held in the operating
+// system's page cache
+std::size_t cachedPages(const std::string &name) {
+  const int fd = ::open(name.c_str(), O_RDONLY);
+  struct stat st;
+  fstat(fd, &st);
+  const std::size_t length = st.st_size;
+  std::size_t cached = 0;
+  if (length > 0) {
+    void *region = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    const std::size_t osPage = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> resident((length + osPage - 1) / osPage);
+    mincore(region, length, resident.data());
+    for (std::size_t i = Page::SIZE / osPage; i < resident.size(); i++)
+      cached += resident[i] & 1;
+    munmap(region, length);
+  }
+  ::close(fd);
+  return cached * sysconf(_SC_PAGESIZE) / Page::SIZE;
+}
+
+void test44_direct_io() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test44_direct_io" << std::endl;
+  const std::string fileName = relationName + ".direct";
+  if (File::exists(fileName)) File::remove(fileName);
+  auto aligned = [](const void *address) {
+    return reinterpret_cast<std::uintptr_t>(address) % DIRECT_IO_ALIGNMENT ==
+           0;
+  };
+
+  // the frames of a pool are aligned for direct I/O, also on huge pages
+  const int numPages = 300;
+  std::vector<PageId> pages;
+  {
+    DirectBlobFile direct = DirectBlobFile::create(fileName);
+    BufMgr pool(64, false, CLOCK_REPLACEMENT, true /* hugePages */);
+    bool allAligned = true;
+    for (int i = 0; i < numPages; i++) {
+      PageId pageNo;
+      Page *page;
+      pool.allocPage(&direct, pageNo, page);
+      allAligned &= aligned(page);
+      memset(reinterpret_cast<char *>(page), i + 1, Page::BLOB_SIZE);
+      pool.unPinPage(&direct, pageNo, true);
+      pages.push_back(pageNo);
+    }
+    checkPassFail(allAligned, true);
+    pool.flushFile(&direct);
+  }
+
+  // pages written directly are not kept in the page cache
+  checkPassFail(cachedPages(fileName), std::size_t(0));
+
+  // pages read through the pool come back whole, past its size
+  {
+    DirectBlobFile direct = DirectBlobFile::open(fileName);
+    BufMgr pool(16);
+    bool same = true;
+    for (int i = 0; i < numPages; i++) {
+      Page *page;
+      pool.readPage(&direct, pages[i], page);
+      const char *bytes = reinterpret_cast<const char *>(page);
+      same &= bytes[0] == char(i + 1) &&
+              bytes[Page::BLOB_SIZE - 1] == char(i + 1);
+      pool.unPinPage(&direct, pages[i], false);
+    }
+    checkPassFail(same, true);
+    checkPassFail(pool.getBufStats().checksumFailures, 0);
+    pool.flushFile(&direct);
+  }
+  checkPassFail(cachedPages(fileName), std::size_t(0));
+
+  // pages in memory not aligned are read through a copy, and pages outside
+  // the file read as fresh pages
+  {
+    DirectBlobFile direct = DirectBlobFile::open(fileName);
+    std::vector<char> memory(2 * Page::SIZE);
+    Page *page = reinterpret_cast<Page *>(memory.data() + 8);
+    direct.readPage(pages[7], *page);
+    const bool copied = !aligned(page) && memory[8] == char(8) &&
+                        memory[8 + Page::BLOB_SIZE - 1] == char(8);
+    checkPassFail(copied, true);
+    Page fresh = direct.readPage(numPages + 10);
+    checkPassFail(fresh.getFreeSpace(), Page().getFreeSpace());
+  }
+
+  // the file format is that of BlobFile
+  {
+    BlobFile blobFile = BlobFile::open(fileName);
+    BufMgr pool(16);
+    Page *page;
+    pool.readPage(&blobFile, pages[numPages - 1], page);
+    checkPassFail(reinterpret_cast<const char *>(page)[100], char(numPages));
+    pool.unPinPage(&blobFile, pages[numPages - 1], false);
+    pool.flushFile(&blobFile);
+  }
+  File::remove(fileName);
+}
+
+void test45_io_engines() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test45_io_engines" << std::endl;
+  const std::string fileName = relationName + ".direct";
+  if (File::exists(fileName)) File::remove(fileName);
+  const int numPages = 100;
+
+  // batches written and read through either engine come back whole, into
+  // memory not aligned too, and pages past the end read as fresh pages
+  for (int kind = SYNC_IO; kind <= URING_IO; kind++) {
+    std::unique_ptr<IoEngine> engine(IoEngine::create(IoEngineKind(kind)));
+    if (File::exists(fileName)) File::remove(fileName);
+    {
+      DirectBlobFile direct = DirectBlobFile::create(fileName);
+      direct.setIoEngine(*engine);
+      std::vector<PageId> pageNos;
+      std::vector<Page> images(numPages);
+      std::vector<const Page *> pages;
+      for (int i = 0; i < numPages; i++) {
+        PageId pageNo;
+        direct.allocatePage(pageNo);
+        memset(reinterpret_cast<char *>(&images[i]), i + 1, Page::BLOB_SIZE);
+        pageNos.push_back(pageNo);
+        pages.push_back(&images[i]);
+      }
+      direct.writePages(pageNos, pages);
+    }
+    DirectBlobFile direct = DirectBlobFile::open(fileName);
+    direct.setIoEngine(*engine);
+    // every other page is 8 bytes off the alignment
+    const std::size_t stride = Page::SIZE + DIRECT_IO_ALIGNMENT;
+    char *memory = static_cast<char *>(
+        aligned_alloc(DIRECT_IO_ALIGNMENT, (numPages + 2) * stride));
+    std::vector<PageId> pageNos;
+    std::vector<Page *> pages;
+    for (int i = 0; i < numPages + 2; i++) {
+      pageNos.push_back(i < numPages ? i + 1 : numPages + 10 + i);
+      pages.push_back(
+          reinterpret_cast<Page *>(memory + i * stride + (i % 2) * 8));
+    }
+    direct.readPages(pageNos, pages);
+    bool same = true;
+    for (int i = 0; i < numPages; i++) {
+      const char *bytes = reinterpret_cast<const char *>(pages[i]);
+      same &= bytes[0] == char(i + 1) &&
+              bytes[Page::BLOB_SIZE - 1] == char(i + 1);
+    }
+    checkPassFail(same, true);
+    checkPassFail(pages[numPages]->getFreeSpace(), Page().getFreeSpace());
+    checkPassFail(pages[numPages + 1]->getFreeSpace(), Page().getFreeSpace());
+    free(memory);
+  }
+
+  // pages read ahead as a batch are hits afterwards
+  {
+    DirectBlobFile direct = DirectBlobFile::open(fileName);
+    BufMgr pool(64);
+    std::vector<PageId> pageNos;
+    for (int i = 0; i < 40; i++) pageNos.push_back(i * 2 + 1);
+    pageNos.push_back(1);
+    pool.prefetchPages(&direct, pageNos);
+    checkPassFail(pool.getBufStats().diskreads, 40);
+    bool same = true;
+    for (int i = 0; i < 40; i++) {
+      Page *page;
+      pool.readPage(&direct, i * 2 + 1, page);
+      same &= reinterpret_cast<const char *>(page)[100] == char(i * 2 + 1);
+      pool.unPinPage(&direct, i * 2 + 1, false);
+    }
+    checkPassFail(same, true);
+    checkPassFail(pool.getBufStats().diskreads, 40);
+    checkPassFail(pool.getBufStats().prefetchHits, 40);
+    pool.flushFile(&direct);
+  }
+
+  // a file flushed in batches reads back through the stream
+  {
+    DirectBlobFile direct = DirectBlobFile::open(fileName);
+    BufMgr pool(256);
+    for (int i = 0; i < numPages; i++) {
+      Page *page;
+      pool.readPage(&direct, i + 1, page);
+      memset(reinterpret_cast<char *>(page), numPages - i, Page::BLOB_SIZE);
+      pool.unPinPage(&direct, i + 1, true);
+    }
+    pool.flushFile(&direct);
+  }
+  {
+    BlobFile blobFile = BlobFile::open(fileName);
+    bool same = true;
+    for (int i = 0; i < numPages; i++) {
+      Page page = blobFile.readPage(i + 1);
+      same &= reinterpret_cast<const char *>(&page)[7] == char(numPages - i);
+    }
+    checkPassFail(same, true);
+  }
+
+  // threads sharing the ring all read their own pages
+  {
+    DirectBlobFile direct = DirectBlobFile::open(fileName);
+    std::atomic<int> wrong(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.push_back(std::thread([&direct, &wrong, t]() {
+        for (int round = 0; round < 20; round++) {
+          std::vector<PageId> pageNos;
+          std::vector<Page> images(10);
+          std::vector<Page *> pages;
+          for (int i = 0; i < 10; i++) {
+            pageNos.push_back((t * 10 + i + round) % numPages + 1);
+            pages.push_back(&images[i]);
+          }
+          direct.readPages(pageNos, pages);
+          for (int i = 0; i < 10; i++) {
+            const char expected = char(numPages + 1 - pageNos[i]);
+            if (reinterpret_cast<const char *>(pages[i])[9] != expected)
+              wrong++;
+          }
+        }
+      }));
+    }
+    for (std::thread &thread : threads) thread.join();
+    checkPassFail(wrong.load(), 0);
+  }
+  File::remove(fileName);
+}
+
+void test46_page_size() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test46_page_size" << std::endl;
+  const std::string fileName = relationName + ".sized";
+  if (File::exists(fileName)) File::remove(fileName);
+  auto setPageSize = [&](std::uint32_t pageSize) {
+    std::fstream file(fileName, std::ios::in | std::ios::out |
+                                    std::ios::binary);
+    file.seekp(offsetof(FileHeader, page_size));
+    file.write(reinterpret_cast<const char *>(&pageSize), sizeof(pageSize));
+  };
+  auto opens = [&]() {
+    try {
+      BlobFile blobFile = BlobFile::open(fileName);
+      return true;
+    } catch (const PageSizeException &) {
+      return false;
+    }
+  };
+
+  // a new file records the size of its pages
+  {
+    BlobFile blobFile = BlobFile::create(fileName);
+    PageId pageNo;
+    blobFile.allocatePage(pageNo);
+  }
+  {
+    std::ifstream file(fileName, std::ios::binary);
+    std::uint32_t pageSize = 0;
+    file.seekg(offsetof(FileHeader, page_size));
+    file.read(reinterpret_cast<char *>(&pageSize), sizeof(pageSize));
+    checkPassFail(pageSize, Page::SIZE);
+  }
+  checkPassFail(opens(), true);
+
+  // a file of another page size fails to open, whatever kind of file opens
+  // it, and is left closed
+  const std::size_t otherSize = Page::SIZE == 4096 ? 8192 : 4096;
+  setPageSize(otherSize);
+  checkPassFail(opens(), false);
+  std::size_t reportedSize = 0;
+  try {
+    DirectBlobFile direct = DirectBlobFile::open(fileName);
+  } catch (const PageSizeException &e) {
+    reportedSize = e.page_size();
+  }
+  checkPassFail(reportedSize, otherSize);
+  checkPassFail(File::isOpen(fileName), false);
+
+  // files from before the size was recorded have pages of 8192 bytes
+  setPageSize(0);
+  const bool legacySize = Page::SIZE == 8192;
+  checkPassFail(opens(), legacySize);
+  setPageSize(Page::SIZE);
+  checkPassFail(opens(), true);
+  File::remove(fileName);
+
+  // the nodes of the B+ tree fill the pages of the size built with
+  const bool leafFits = sizeof(LeafNodeInt) <= Page::SIZE &&
+                        sizeof(LeafNodeInt) > Page::SIZE / 2;
+  const bool nonLeafFits = sizeof(NonLeafNodeInt) <= Page::SIZE &&
+                           sizeof(NonLeafNodeInt) > Page::SIZE / 2;
+  checkPassFail(leafFits, true);
+  checkPassFail(nonLeafFits, true);
+}
+
+void test47_int_node_directory() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test47_int_node_directory" << std::endl;
+
+  // searches through the directory agree with searchIntArray, for sorted
+  // keys with duplicates of any length a node holds, also when the directory
+  // is stale
+  const bool aligned = sizeof(NonLeafNodeInt) <= Page::BLOB_SIZE &&
+                       offsetof(NonLeafNodeInt, keyArray) % 64 == 0 &&
+                       offsetof(NonLeafNodeInt, blockKeys) % 64 == 0 &&
+                       offsetof(NonLeafNodeInt, lineKeys) % 64 == 0 &&
+                       INTARRAYNONLEAFSIZE % INTKEYBLOCKSIZE == 0;
+  checkPassFail(aligned, true);
+  srand(47);
+  bool same = true, sameStale = true;
+  for (int len : {0, 1, 15, 16, 17, 100, 255, 256, 257, 300,
+                  INTARRAYNONLEAFSIZE - 1, INTARRAYNONLEAFSIZE}) {
+    std::vector<int> keys(len);
+    for (int &key : keys) key = rand() % (len * 2 + 1) - len;
+    std::sort(keys.begin(), keys.end());
+    std::vector<int> blockKeys(INTNONLEAFBLOCKS), lineKeys(INTNONLEAFLINES);
+    indexIntKeys(keys.data(), len, blockKeys.data(), lineKeys.data());
+    std::vector<int> staleBlockKeys(INTNONLEAFBLOCKS);
+    std::vector<int> staleLineKeys(INTNONLEAFLINES);
+    for (int &key : staleBlockKeys) key = rand() % (len * 2 + 1) - len;
+    for (int &key : staleLineKeys) key = rand() % (len * 2 + 1) - len;
+    std::vector<int> probes = {std::numeric_limits<int>::min(),
+                               std::numeric_limits<int>::max()};
+    for (int p = 0; p < 500; p++) probes.push_back(rand() % (len * 2 + 3) -
+                                                   len - 1);
+    for (int probe : probes) {
+      for (int includeKey = 0; includeKey < 2; includeKey++) {
+        const int expected = searchIntArray(keys.data(), len, probe,
+                                            includeKey);
+        same &= searchIntDirectory(keys.data(), len, blockKeys.data(),
+                                   lineKeys.data(), NULL, probe,
+                                   includeKey) == expected;
+        sameStale &= searchIntDirectory(keys.data(), len,
+                                        staleBlockKeys.data(),
+                                        staleLineKeys.data(), NULL, probe,
+                                        includeKey) == expected;
+      }
+    }
+  }
+  checkPassFail(same, true);
+  checkPassFail(sameStale, true);
+
+  // the directories follow the keys through bulk loads, splits, merges and
+  // rotations
+  deleteIndexFile();
+  const int numRecords = 60000;
+  createRelationRandom(numRecords);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+  const int low = 0, high = numRecords;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+  }
+  checkPassFail(intDirectoriesMatch(intIndexName), true);
+  deleteIndexFile();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, INSERT_BUILD);
+    checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+  }
+  checkPassFail(intDirectoriesMatch(intIndexName), true);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    std::random_shuffle(entries.begin(), entries.end());
+    for (int e = 0; e < numRecords * 9 / 10; e++)
+      index.deleteEntry(&entries[e].first, entries[e].second);
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), numRecords / 10);
+    bool found = true;
+    RecordId rids[2];
+    for (int e = numRecords * 9 / 10; e < numRecords; e++)
+      found &= index.lookup(&entries[e].first, rids, 2) == 1;
+    checkPassFail(found, true);
+  }
+  checkPassFail(intDirectoriesMatch(intIndexName), true);
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test48_pinned_upper_levels() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test48_pinned_upper_levels" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 300000;
+  createRelationRandom(numRecords);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+  std::srand(48);
+  std::random_shuffle(entries.begin(), entries.end());
+
+  // half full nodes make a tree of three levels; a lookup reads only the
+  // nodes below those kept pinned, which a pool of 8 frames limits to the
+  // root and one of 7 frames to none
+  const int numLookups = 1000;
+  std::vector<int> accesses;
+  for (int numFrames : {4000, 8, 7}) {
+    BufMgr *pool = new BufMgr(numFrames);
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER, BULK_BUILD, 0.5);
+      checkPassFail(index.getStats().height, 3);
+      RecordId rids[2];
+      int numFound = 0;
+      for (int round = 0; round < 2; round++) {
+        pool->clearBufStats();
+        for (int e = 0; e < numLookups; e++)
+          numFound += index.lookup(&entries[e].first, rids, 2);
+      }
+      checkPassFail(numFound, 2 * numLookups);
+      accesses.push_back(pool->getBufStats().accesses);
+    }
+    delete pool;
+  }
+  // the leaves read are the same, a few lookups reading on to a sibling
+  const bool fewSiblings = accesses[0] < numLookups * 11 / 10;
+  checkPassFail(fewSiblings, true);
+  checkPassFail(accesses[1] - accesses[0], numLookups);
+  checkPassFail(accesses[2] - accesses[1], numLookups);
+  File::remove(intIndexName);
+
+  // the pinned nodes follow the root as deletions take levels away and
+  // insertions add them back, and are unpinned when the index is closed
+  BufMgr *pool = new BufMgr(4000);
+  const int numDeleted = numRecords * 9 / 10;
+  const int low = 0, high = numRecords;
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, 0.5);
+    for (int e = 0; e < numDeleted; e++)
+      index.deleteEntry(&entries[e].first, entries[e].second);
+    checkPassFail(countScan(&index, &low, GTE, &high, LT),
+                  numRecords - numDeleted);
+    const int shrunk = index.getStats().height;
+    checkPassFail(shrunk, 2);
+    for (int e = 0; e < numDeleted; e++)
+      index.insertEntry(&entries[e].first, entries[e].second);
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), numRecords);
+    RecordId rids[2];
+    bool found = true;
+    for (int e = 0; e < numRecords; e += 7)
+      found &= index.lookup(&entries[e].first, rids, 2) == 1 &&
+               rids[0] == entries[e].second;
+    checkPassFail(found, true);
+  }
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(intScan(&index, 25, GT, 40, LT), 14);
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void test49_swizzled_children() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test49_swizzled_children" << std::endl;
+
+  // a slot pointed at a frame is cleared once its page leaves the frame, and
+  // a concurrent buffer manager points none
+  const std::string fileName = relationName + ".swizzle";
+  if (File::exists(fileName)) File::remove(fileName);
+  {
+    BlobFile blobFile = BlobFile::create(fileName);
+    BufMgr pool(3);
+    std::vector<PageId> pageNos(6);
+    for (PageId &pageNo : pageNos) {
+      Page *page;
+      pool.allocPage(&blobFile, pageNo, page);
+      pool.unPinPage(page, true);
+    }
+    Page *page, *slot = NULL;
+    pool.readPage(&blobFile, pageNos[0], page);
+    checkPassFail(pool.swizzle(page, &slot), true);
+    const bool pointed = slot == page;
+    checkPassFail(pointed, true);
+    pool.unPinPage(page, false);
+    pool.pinSwizzled(slot);
+    bool thrown = false;
+    try {
+      pool.unPinPage(slot, false);
+      pool.unPinPage(slot, false);
+    } catch (PageNotPinnedException e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+    for (int i = 1; i < 6; i++) {
+      pool.readPage(&blobFile, pageNos[i], page);
+      pool.unPinPage(page, false);
+    }
+    const bool cleared = slot == NULL;
+    checkPassFail(cleared, true);
+    pool.flushFile(&blobFile);
+
+    BufMgr concurrentPool(3, true);
+    concurrentPool.readPage(&blobFile, pageNos[0], page);
+    checkPassFail(concurrentPool.swizzle(page, &slot), false);
+    const bool unset = slot == NULL;
+    checkPassFail(unset, true);
+    concurrentPool.unPinPage(page, false);
+    concurrentPool.flushFile(&blobFile);
+  }
+  File::remove(fileName);
+
+  // insertions, deletions, lookups and scans agree with a map of the
+  // entries while the leaves the slots point to are evicted all the time,
+  // in a pool of 64 frames, or stay resident, in one of 4000, and while
+  // descents follow the slots or not
+  deleteIndexFile();
+  const int numRecords = 100000, numOps = 40000;
+  createRelationRandom(numRecords);
+  for (int numFrames : {64, 4000}) {
+    std::map<int, RecordId> model;
+    for (const auto &entry : relationEntries()) model.insert(entry);
+    BufMgr *pool = new BufMgr(numFrames);
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER, BULK_BUILD, 0.5);
+      std::srand(49);
+      bool same = true;
+      int nextKey = numRecords;
+      for (int op = 0; op < numOps; op++) {
+        if (op % 10000 == 0) index.setSwizzling(op % 20000 == 0);
+        int key = std::rand() % nextKey;
+        RecordId rids[2];
+        switch (op % 4) {
+          case 0:
+            same &= index.lookup(&key, rids, 2) == model.count(key);
+            break;
+          case 1: {
+            const int high = key + 20;
+            const auto end = model.lower_bound(high);
+            same &= countScan(&index, &key, GTE, &high, LT) ==
+                    std::distance(model.lower_bound(key), end);
+            break;
+          }
+          case 2:
+            if (model.count(key) == 0) break;
+            index.deleteEntry(&key, model[key]);
+            model.erase(key);
+            break;
+          case 3:
+            key = nextKey++;
+            index.insertEntry(&key, RecordId{1, (SlotId)(key % 100 + 1)});
+            model[key] = RecordId{1, (SlotId)(key % 100 + 1)};
+            break;
+        }
+      }
+      checkPassFail(same, true);
+      const int low = 0;
+      checkPassFail(countScan(&index, &low, GTE, &nextKey, LT),
+                    (int)model.size());
+    }
+    delete pool;
+    File::remove(intIndexName);
+  }
+  deleteRelation();
+}
+
+void test50_buf_stats() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test50_buf_stats" << std::endl;
+
+  // values land in the bucket they start, and percentiles are within a
+  // bucket of the exact ones
+  {
+    bool roundTrip = true;
+    for (int bucket = 0; bucket < Histogram::NUM_BUCKETS; bucket++)
+      roundTrip &= Histogram::bucketOf(Histogram::bucketStart(bucket)) ==
+                   bucket;
+    checkPassFail(roundTrip, true);
+    Histogram histogram;
+    for (std::uint64_t value = 1; value <= 1000; value++)
+      histogram.record(value);
+    checkPassFail(histogram.count, 1000);
+    checkPassFail(histogram.max, 1000);
+    checkPassFail(histogram.percentile(1), 1000);
+    const std::uint64_t p50 = histogram.percentile(0.5);
+    const bool close = p50 >= 500 && p50 <= 500 + 500 / Histogram::SUB_BUCKETS;
+    checkPassFail(close, true);
+    const bool mean = histogram.mean() == 500.5;
+    checkPassFail(mean, true);
+  }
+
+  // reading six pages through three frames full of dirty pages evicts the
+  // dirty pages, then the clean ones read, each read from disk once
+  const std::string fileName = relationName + ".stats";
+  if (File::exists(fileName)) File::remove(fileName);
+  {
+    BlobFile blobFile = BlobFile::create(fileName);
+    BufMgr pool(3);
+    std::vector<PageId> pageNos(6);
+    Page *page;
+    for (PageId &pageNo : pageNos) {
+      pool.allocPage(&blobFile, pageNo, page);
+      pool.unPinPage(page, true);
+    }
+    pool.clearBufStats();
+    for (PageId pageNo : pageNos) {
+      pool.readPage(&blobFile, pageNo, page);
+      pool.unPinPage(page, false);
+    }
+    pool.readPage(&blobFile, pageNos[5], page);
+    pool.unPinPage(page, false);
+    BufStats stats = pool.getBufStats();
+    checkPassFail(stats.accesses, 7);
+    checkPassFail(stats.hits, 1);
+    checkPassFail(stats.diskreads, 6);
+    checkPassFail(stats.diskwrites, 3);
+    checkPassFail(stats.dirtyEvictions, 3);
+    checkPassFail(stats.cleanEvictions, 3);
+    checkPassFail(stats.readLatency.count, 6);
+    checkPassFail(stats.writeLatency.count, 3);
+    checkPassFail(stats.sweepLength.count, 6);
+    checkPassFail(stats.files[fileName].hits, 1);
+    checkPassFail(stats.files[fileName].misses, 6);
+    std::ostringstream text;
+    stats.print(text);
+    const bool printed =
+        text.str().find("evictions: 3 clean, 3 dirty") != std::string::npos;
+    checkPassFail(printed, true);
+
+    // the counts of a file outlive its flush, and add up with later ones
+    pool.flushFile(&blobFile);
+    pool.readPage(&blobFile, pageNos[0], page);
+    pool.unPinPage(page, false);
+    stats = pool.getBufStats();
+    checkPassFail(stats.files[fileName].misses, 7);
+    pool.flushFile(&blobFile);
+    pool.clearBufStats();
+    stats = pool.getBufStats();
+    checkPassFail(stats.accesses, 0);
+    checkPassFail(stats.files.size(), 0);
+
+    // threads counting in their own shards lose no access
+    BufMgr concurrentPool(8, true);
+    const int numThreads = 4, numReads = 10000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+      threads.emplace_back([&concurrentPool, &blobFile, &pageNos, t]() {
+        for (int i = 0; i < numReads; i++) {
+          Page *threadPage;
+          const PageId pageNo = pageNos[(i + t) % pageNos.size()];
+          concurrentPool.readPage(&blobFile, pageNo, threadPage);
+          concurrentPool.unPinPage(&blobFile, pageNo, false);
+        }
+      });
+    }
+    for (std::thread &thread : threads) thread.join();
+    stats = concurrentPool.getBufStats();
+    checkPassFail(stats.accesses, numThreads * numReads);
+    const FileStats &file = stats.files[fileName];
+    checkPassFail(file.hits + file.misses, numThreads * numReads);
+    checkPassFail(file.misses, stats.diskreads);
+    concurrentPool.flushFile(&blobFile);
+  }
+  File::remove(fileName);
+}
+
+void test51_index_counters() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test51_index_counters" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000;
+  createRelationRandom(numRecords);
+
+  // an index built by insertions in random order: each split adds a node,
+  // each root split a level, and leaves split off to the end of the file
+  // leave the chain out of order
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, INSERT_BUILD);
+    IndexCounters counters = index.getCounters();
+    const IndexAnalysis analysis = index.analyze();
+    checkPassFail(counters.inserts, numRecords);
+    checkPassFail(analysis.height, index.getStats().height);
+    checkPassFail((std::uint64_t)analysis.height, counters.rootSplits + 1);
+    const LevelStats &leaves = analysis.levels.back();
+    checkPassFail(leaves.numNodes, counters.leafSplits + 1);
+    checkPassFail(leaves.numEntries, numRecords);
+    std::uint64_t numNonLeaves = 0;
+    for (int l = 0; l + 1 < analysis.height; l++)
+      numNonLeaves += analysis.levels[l].numNodes;
+    checkPassFail(numNonLeaves, counters.nonLeafSplits + counters.rootSplits);
+    checkPassFail(analysis.levels[0].numNodes, 1);
+    const bool halfFull = leaves.fillFactor > 0.5 && leaves.fillFactor < 1;
+    checkPassFail(halfFull, true);
+    const bool fragmented =
+        analysis.outOfOrderLinks > 0 && analysis.fragmentation > 0.1;
+    checkPassFail(fragmented, true);
+
+    // lookups, scans and deletions are counted, with the pages they pin
+    index.clearCounters();
+    RecordId rids[4];
+    for (int key = 0; key < 100; key++) index.lookup(&key, rids, 4);
+    const int low = 0, high = 500;
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), 500);
+    const int key = 7;
+    index.lookup(&key, rids, 4);
+    index.deleteEntry(&key, rids[0]);
+    counters = index.getCounters();
+    checkPassFail(counters.lookups, 101);
+    checkPassFail(counters.scansStarted, 1);
+    checkPassFail(counters.entriesReturned, 601);
+    checkPassFail(counters.deletes, 1);
+    checkPassFail(counters.inserts, 0);
+    const bool pinned = counters.pagesPinned >= 102 &&
+                        counters.pagesPerOperation() <= analysis.height + 1;
+    checkPassFail(pinned, true);
+  }
+  File::remove(intIndexName);
+
+  // a bulk-built index has no splits, and its leaves in file order
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, 1.0);
+    const IndexCounters counters = index.getCounters();
+    const IndexAnalysis analysis = index.analyze();
+    checkPassFail(counters.leafSplits + counters.rootSplits, 0);
+    checkPassFail(analysis.outOfOrderLinks, 0);
+    checkPassFail(analysis.levels.back().numEntries, numRecords);
+    const bool full = analysis.levels.back().fillFactor > 0.95;
+    checkPassFail(full, true);
+  }
+  File::remove(intIndexName);
+  deleteRelation();
+}
+
+void test52_tracing() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test52_tracing" << std::endl;
+  deleteIndexFile();
+  createRelationRandom(5000);
+  Tracer::clear();
+
+#ifdef BADGERDB_TRACING
+  // an index built by insertions through a small pool traces its reads,
+  // evictions and splits, and nothing once tracing is off
+  {
+    BufMgr *pool = new BufMgr(50);
+    Tracer::enable(true);
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER, INSERT_BUILD);
+      Tracer::enable(false);
+      std::ostringstream trace;
+      Tracer::dump(trace);
+      const std::string json = trace.str();
+      checkPassFail(json.compare(0, 19, "{\"displayTimeUnit\":"), 0);
+      checkPassFail(json.compare(json.size() - 4, 4, "\n]}\n"), 0);
+      const char *const names[] = {"readPage", "allocBuf",  "evict",
+                                   "unPinPage", "splitLeaf", "splitRoot"};
+      for (const char *name : names) {
+        const bool traced = json.find(std::string("{\"name\": \"") + name +
+                                      "\"") != std::string::npos;
+        checkPassFail(traced, true);
+      }
+      const bool fileTraced =
+          json.find("\"cat\": \"file\"") != std::string::npos;
+      checkPassFail(fileTraced, true);
+
+      const int key = 5;
+      RecordId rids[2];
+      checkPassFail(index.lookup(&key, rids, 2), 1);
+      std::ostringstream again;
+      Tracer::dump(again);
+      checkPassFail(again.str().size(), json.size());
+    }
+    delete pool;
+    File::remove(intIndexName);
+  }
+#endif
+
+  // a ring keeps the last RING_EVENTS events of its thread, and a dump
+  // taken while a thread records holds whole events only
+  static const TracePoint spin{"spin", "test", {"n", NULL}, true};
+  Tracer::clear();
+  std::thread([] {
+    for (std::uint64_t n = 0; n < 3 * Tracer::RING_EVENTS; n++)
+      Tracer::record(spin, Tracer::now(), 0, n, 0);
+  }).join();
+  std::ostringstream trace;
+  Tracer::dump(trace);
+  std::string json = trace.str();
+  std::size_t numEvents = 0;
+  for (std::size_t at = json.find("\"spin\""); at != std::string::npos;
+       at = json.find("\"spin\"", at + 1))
+    numEvents++;
+  checkPassFail(numEvents, Tracer::RING_EVENTS);
+  const bool lastKept =
+      json.find("\"n\": " + std::to_string(3 * Tracer::RING_EVENTS - 1) +
+                "}") != std::string::npos;
+  checkPassFail(lastKept, true);
+
+  std::atomic<bool> done(false);
+  std::thread recorder([&done] {
+    for (std::uint64_t n = 0; !done; n++)
+      Tracer::record(spin, Tracer::now(), 0, n, 0);
+  });
+  bool whole = true;
+  for (int dump = 0; dump < 20; dump++) {
+    std::ostringstream concurrent;
+    Tracer::dump(concurrent);
+    std::istringstream lines(concurrent.str());
+    std::string line;
+    std::getline(lines, line);
+    while (std::getline(lines, line) && line != "]}") {
+      if (line.back() == ',') line.pop_back();
+      whole = whole && line.compare(0, 16, "{\"name\": \"spin\",") == 0 &&
+              line.compare(line.size() - 2, 2, "}}") == 0;
+    }
+  }
+  done = true;
+  recorder.join();
+  checkPassFail(whole, true);
+  Tracer::clear();
+  deleteRelation();
+}
+
+void test53_pin_tracking() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test53_pin_tracking" << std::endl;
+  deleteIndexFile();
+  createRelationRandom(5000);
+  std::ostringstream report;
+  std::streambuf *cerrBuf = std::cerr.rdbuf(report.rdbuf());
+
+  BufMgr *pool = new BufMgr(100);
+  {
+    PageFile relation = PageFile::open(relationName);
+    const PageId firstPageNo = relation.getFirstPageNo();
+    pool->setPinTracking(true);
+
+    // a pin never given back is listed with the line that took it, and
+    // reported when the file is flushed
+    Page *page;
+    const int leakLine = __LINE__ + 1;
+    pool->readPage(&relation, firstPageNo, page);
+    std::vector<PinnedPage> pinned = pool->outstandingPins(&relation);
+    checkPassFail(pinned.size(), (std::size_t)1);
+    checkPassFail(pinned[0].pageNo, firstPageNo);
+    checkPassFail(pinned[0].pinCnt, 1u);
+    checkPassFail(pinned[0].sites.size(), (std::size_t)1);
+    checkPassFail(pinned[0].sites[0].line, leakLine);
+    const bool inThisFile =
+        std::string(pinned[0].sites[0].file).find("main.cpp") !=
+        std::string::npos;
+    checkPassFail(inThisFile, true);
+    checkPassFail(std::string(pinned[0].sites[0].function),
+                  std::string("test53_pin_tracking"));
+    bool thrown = false;
+    try {
+      pool->flushFile(&relation);
+    } catch (const PagePinnedException &e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+    const bool reported =
+        report.str().find("main.cpp:" + std::to_string(leakLine)) !=
+        std::string::npos;
+    checkPassFail(reported, true);
+    pool->unPinPage(page, false);
+    checkPassFail(pool->outstandingPins().size(), (std::size_t)0);
+
+    // a handle unpins on leaving its scope, also through an exception, and
+    // moves its pin along
+    {
+      PageHandle handle = pool->pin(&relation, firstPageNo);
+      checkPassFail(pool->outstandingPins().size(), (std::size_t)1);
+      PageHandle moved = std::move(handle);
+      const bool handedOver = !handle && moved.get() != NULL;
+      checkPassFail(handedOver, true);
+      checkPassFail(pool->outstandingPins()[0].pinCnt, 1u);
+    }
+    checkPassFail(pool->outstandingPins().size(), (std::size_t)0);
+    thrown = false;
+    try {
+      PageHandle handle = pool->pin(&relation, firstPageNo);
+      throw std::runtime_error("failed while pinned");
+    } catch (const std::runtime_error &e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+    checkPassFail(pool->outstandingPins().size(), (std::size_t)0);
+
+    // pins taken while tracking was off are counted but not placed
+    pool->setPinTracking(false);
+    pool->readPage(&relation, firstPageNo, page);
+    pool->setPinTracking(true);
+    pool->readPage(&relation, firstPageNo, page);
+    pinned = pool->outstandingPins();
+    checkPassFail(pinned[0].pinCnt, 2u);
+    checkPassFail(pinned[0].sites.size(), (std::size_t)1);
+    std::ostringstream partial;
+    pool->reportPins(partial);
+    const bool untracked =
+        partial.str().find("1 times while pins were not tracked") !=
+        std::string::npos;
+    checkPassFail(untracked, true);
+    pool->unPinPage(page, false);
+    pool->unPinPage(page, false);
+    pool->flushFile(&relation);
+  }
+
+  // a scan holds the pin of its current page only, and none once it ends
+  // or is destroyed
+  {
+    FileScan scan(relationName, pool);
+    RecordId rid;
+    scan.scanNext(rid);
+    scan.scanNext(rid);
+    checkPassFail(pool->outstandingPins().size(), (std::size_t)1);
+  }
+  checkPassFail(pool->outstandingPins().size(), (std::size_t)0);
+  {
+    FileScan scan(relationName, pool);
+    RecordId rid;
+    std::vector<RecordId> rids;
+    try {
+      while (true) {
+        scan.scanNext(rid);
+        rids.push_back(rid);
+      }
+    } catch (const EndOfFileException &e) {
+    }
+    checkPassFail(rids.size(), (std::size_t)5000);
+    checkPassFail(pool->outstandingPins().size(), (std::size_t)0);
+
+    // a fetch whose callback throws leaves no page pinned
+    HeapFetch fetch(relationName, pool);
+    bool thrown = false;
+    try {
+      fetch.fetch(rids, [](const RecordId &, const RecordView &) {
+        throw std::runtime_error("failed while fetching");
+      });
+    } catch (const std::runtime_error &e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+    checkPassFail(pool->outstandingPins().size(), (std::size_t)0);
+  }
+
+  // an index leaves nothing pinned but the nodes it keeps pinned, which it
+  // gives back when it is destroyed
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, INSERT_BUILD);
+    const int low = 100, high = 200;
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), 100);
+  }
+  checkPassFail(pool->outstandingPins().size(), (std::size_t)0);
+
+  // the destructor reports the pins left
+  {
+    PageFile relation = PageFile::open(relationName);
+    Page *page;
+    pool->readPage(&relation, relation.getFirstPageNo(), page);
+    delete pool;
+  }
+  std::cerr.rdbuf(cerrBuf);
+  const bool destroyedReported =
+      report.str().find("destroyed with pages pinned") != std::string::npos;
+  checkPassFail(destroyedReported, true);
+  File::remove(intIndexName);
+  deleteRelation();
+}
+
+void test54_resize_pool() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test54_resize_pool" << std::endl;
+  deleteIndexFile();
+  createRelationRandom(20000);
+  std::vector<PageId> pageNos;
+  {
+    PageFile relation = PageFile::open(relationName);
+    for (FileIterator it = relation.begin(); it != relation.end(); ++it)
+      pageNos.push_back((*it).page_number());
+  }
+  const std::size_t numPages = pageNos.size();
+
+  // a hash table grown while full keeps finding its entries, and frees the
+  // old table once later inserts and removes have moved them all over
+  {
+    BufHashTbl table(64);
+    PageFile relation = PageFile::open(relationName);
+    for (int i = 0; i < 30; i++) table.insert(&relation, i, i);
+    table.resize(1024);
+    checkPassFail(table.size(), 1024);
+    checkPassFail(table.resizing(), true);
+    bool allFound = true;
+    FrameId frameNo;
+    for (int i = 30; i < 300; i++) {
+      table.insert(&relation, i, i);
+      for (int j = 0; j <= i; j += 7)
+        allFound = allFound && table.lookup(&relation, j, frameNo) &&
+                   frameNo == (FrameId)j;
+    }
+    checkPassFail(allFound, true);
+    checkPassFail(table.resizing(), false);
+    for (int i = 0; i < 300; i++) table.remove(&relation, i);
+    checkPassFail(table.lookup(&relation, 5, frameNo), false);
+  }
+
+  const ReplacementPolicy policies[] = {CLOCK_REPLACEMENT, LRUK_REPLACEMENT,
+                                        TWOQ_REPLACEMENT, ARC_REPLACEMENT};
+  for (ReplacementPolicy policy : policies) {
+    BufMgr *pool = new BufMgr(50, false, policy);
+    checkPassFail(pool->maxFrames(), 50 * BUF_GROWTH_LIMIT);
+    PageFile relation = PageFile::open(relationName);
+
+    // grown beyond the relation, the pool reads each page once
+    checkPassFail(pool->resize(numPages + 10), numPages + 10);
+    for (int pass = 0; pass < 2; pass++) {
+      for (PageId pageNo : pageNos) {
+        PageHandle page = pool->pin(&relation, pageNo);
+      }
+    }
+    checkPassFail(pool->getBufStats().diskreads, numPages);
+
+    // shrinking stops at a pinned page and evicts the others; the pool
+    // then holds no more pages than frames
+    Page *pinned;
+    pool->readPage(&relation, pageNos[numPages - 1], pinned);
+    const FrameId pinnedFrame = pool->outstandingPins()[0].frameNo;
+    checkPassFail(pool->resize(1), pinnedFrame + 1);
+    pool->unPinPage(pinned, false);
+    checkPassFail(pool->resize(20), 20u);
+    std::vector<PageHandle> pins;
+    bool exceeded = false;
+    try {
+      for (PageId pageNo : pageNos) {
+        pins.push_back(pool->pin(&relation, pageNo));
+      }
+    } catch (const BufferExceededException &e) {
+      exceeded = true;
+    }
+    checkPassFail(exceeded, true);
+    checkPassFail(pins.size(), (std::size_t)20);
+    pins.clear();
+
+    // and grows again over the frames it retired
+    checkPassFail(pool->resize(numPages), numPages);
+    for (PageId pageNo : pageNos) pins.push_back(pool->pin(&relation, pageNo));
+    pins.clear();
+    pool->flushFile(&relation);
+    delete pool;
+  }
+
+  // an index built in a large pool is still right once the pool shrinks
+  // under it, its dirty pages written back as their frames are retired
+  {
+    BufMgr *pool = new BufMgr(1000);
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER, INSERT_BUILD);
+      const std::uint32_t frames = pool->resize(30);
+      const bool shrunk = frames < 1000;
+      checkPassFail(shrunk, true);
+      const int low = 1000, high = 3000;
+      checkPassFail(countScan(&index, &low, GTE, &high, LT), 2000);
+      pool->resize(300);
+      checkPassFail(countScan(&index, &low, GTE, &high, LT), 2000);
+    }
+    delete pool;
+    pool = new BufMgr(30);
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER);
+      const int low = 0, high = 20000;
+      checkPassFail(countScan(&index, &low, GTE, &high, LT), 20000);
+    }
+    delete pool;
+    File::remove(intIndexName);
+  }
+
+  // scans on other threads go on while the pool grows and shrinks
+  {
+    BufMgr *pool = new BufMgr(64, true);
+    std::atomic<bool> wrong(false);
+    std::vector<std::thread> scanners;
+    for (int t = 0; t < 2; t++) {
+      scanners.emplace_back([&, t] {
+        PageFile relation = PageFile::open(relationName);
+        for (int pass = 0; pass < 3; pass++) {
+          std::size_t records = 0;
+          for (std::size_t i = t; i < numPages + t; i++) {
+            PageHandle page = pool->pin(&relation, pageNos[i % numPages]);
+            for (PageIterator it = page->begin(); it != page->end(); ++it)
+              records++;
+          }
+          if (records != 20000) wrong = true;
+        }
+      });
+    }
+    for (int round = 0; round < 40; round++)
+      pool->resize(round % 2 == 0 ? 400 : 16);
+    for (std::thread &scanner : scanners) scanner.join();
+    checkPassFail(wrong.load(), false);
+    checkPassFail(pool->outstandingPins().size(), (std::size_t)0);
+    delete pool;
+  }
+  deleteRelation();
+}
+
+void test55_numa_partitions() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test55_numa_partitions" << std::endl;
+  createRelationRandom(100000);
+  std::vector<PageId> pageNos;
+  {
+    PageFile relation = PageFile::open(relationName);
+    for (FileIterator it = relation.begin(); it != relation.end(); ++it)
+      pageNos.push_back((*it).page_number());
+  }
+
+  const NumaTopology &machine = NumaTopology::system();
+  const bool onMachineNode = machine.currentNode() < machine.nodes();
+  checkPassFail(onMachineNode, true);
+
+  // two nodes the thread is moved between by hand; with 8KB pages, frames
+  // 256 to 511 and 768 to 1023 of a 1024 frame pool lie on node 1
+  const NumaTopology twoNodes(std::vector<std::vector<int>>(2));
+  const std::uint32_t chunk = BUF_POOL_ALIGNMENT / Page::SIZE;
+  const ReplacementPolicy policies[] = {CLOCK_REPLACEMENT, LRUK_REPLACEMENT,
+                                        TWOQ_REPLACEMENT, ARC_REPLACEMENT};
+  for (ReplacementPolicy policy : policies) {
+    BufMgr *pool = new BufMgr(4 * chunk, true, policy, false, 0, twoNodes);
+    checkPassFail(pool->numaNodes(), 2u);
+    checkPassFail(pool->frameNode(chunk - 1), 0u);
+    checkPassFail(pool->frameNode(chunk), 1u);
+    checkPassFail(pool->frameNode(3 * chunk), 1u);
+    PageFile relation = PageFile::open(relationName);
+
+    // pages read on node 1 go to its frames, evicting its own pages once
+    // they are full rather than taking the free frames of node 0
+    NumaTopology::setThreadNode(1);
+    bool allLocal = true;
+    for (std::size_t i = 0; i < 3 * chunk; i++) {
+      PageHandle page = pool->pin(&relation, pageNos[i]);
+      allLocal = allLocal && pool->frameNode(page.get() - pool->bufPool) == 1;
+    }
+    checkPassFail(allLocal, true);
+    BufStats node1 = pool->getBufStats(1);
+    checkPassFail(node1.diskreads, 3 * chunk);
+    checkPassFail(node1.remoteAllocations, 0u);
+    checkPassFail(pool->getBufStats(0).accesses, 0u);
+
+    // hits from node 0 on them are remote
+    NumaTopology::setThreadNode(0);
+    for (std::size_t i = chunk; i < 3 * chunk; i++)
+      PageHandle page = pool->pin(&relation, pageNos[i]);
+    BufStats node0 = pool->getBufStats(0);
+    checkPassFail(node0.hits, 2 * chunk);
+    checkPassFail(node0.remoteHits, 2 * chunk);
+    checkPassFail(pool->getBufStats().accesses, 5 * chunk);
+
+    // with every frame of node 1 pinned, a page read on node 1 takes a frame
+    // of node 0
+    NumaTopology::setThreadNode(1);
+    std::vector<PageHandle> pins;
+    for (std::size_t i = 0; i < 2 * chunk; i++)
+      pins.push_back(pool->pin(&relation, pageNos[i]));
+    {
+      PageHandle page = pool->pin(&relation, pageNos[2 * chunk]);
+      checkPassFail(pool->frameNode(page.get() - pool->bufPool), 0u);
+    }
+    checkPassFail(pool->getBufStats(1).remoteAllocations, 1u);
+    pins.clear();
+    pool->flushFile(&relation);
+    delete pool;
+  }
+
+  // a pool smaller than a chunk lies on node 0 alone
+  {
+    BufMgr pool(100, false, CLOCK_REPLACEMENT, false, 0, twoNodes);
+    PageFile relation = PageFile::open(relationName);
+    for (std::size_t i = 0; i < 50; i++)
+      PageHandle page = pool.pin(&relation, pageNos[i]);
+    checkPassFail(pool.getBufStats(1).remoteAllocations, 50u);
+    pool.flushFile(&relation);
+  }
+  NumaTopology::setThreadNode(-1);
+  deleteRelation();
+}
+
+void test56_arena() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test56_arena" << std::endl;
+
+  // a scope gives back what was allocated in it, and the same memory is
+  // handed out again without taking more blocks
+  {
+    Arena arena(4096);
+    char *first = static_cast<char *>(arena.allocate(10, 1));
+    double *aligned = static_cast<double *>(arena.allocate(8, alignof(double)));
+    const bool isAligned =
+        reinterpret_cast<std::uintptr_t>(aligned) % alignof(double) == 0;
+    checkPassFail(isAligned, true);
+    const bool sameBlock = reinterpret_cast<char *>(aligned) - first < 32;
+    checkPassFail(sameBlock, true);
+    void *inScope;
+    {
+      Arena::Scope scope(arena);
+      inScope = arena.allocate(100);
+      Arena::Scope inner(arena);
+      arena.allocate(3000);
+      arena.allocate(3000);
+    }
+    const std::size_t reserved = arena.reserved();
+    checkPassFail(reserved, (std::size_t)2 * 4096);
+    for (int round = 0; round < 10; round++) {
+      Arena::Scope scope(arena);
+      checkPassFail(arena.allocate(100), inScope);
+      arena.allocate(3000);
+      arena.allocate(3000);
+    }
+    checkPassFail(arena.reserved(), reserved);
+
+    // an allocation larger than a block gets a block of its own
+    {
+      Arena::Scope scope(arena);
+      char *large = static_cast<char *>(arena.allocate(10000));
+      std::memset(large, 1, 10000);
+    }
+    checkPassFail(arena.reserved(), reserved + 10000);
+    arena.reset();
+    checkPassFail(arena.allocate(10, 1), static_cast<void *>(first));
+  }
+
+  // containers of temporaries grow within the arena
+  {
+    Arena arena;
+    Arena::Scope scope(arena);
+    ArenaVector<int> values{ArenaAllocator<int>(arena)};
+    for (int i = 0; i < 1000; i++) values.push_back(i);
+    checkPassFail(values[999], 999);
+    checkPassFail(arena.reserved(), ARENA_BLOCK_SIZE);
+  }
+
+  // nodes freed by a map are reused for the nodes inserted next
+  {
+    FreeList nodes(2);
+    typedef std::map<int, PageImage, std::less<int>,
+                     PoolAllocator<std::pair<const int, PageImage>>>
+        ImageMap;
+    ImageMap images{std::less<int>(), ImageMap::allocator_type(nodes)};
+    PageImage *first = &images[1];
+    PageImage *second = &images[2];
+    images.clear();
+    PageImage *reused = &images[3];
+    const bool isReused = reused == first || reused == second;
+    checkPassFail(isReused, true);
+  }
+
+  // pooled buffers keep their capacity
+  {
+    ObjectPool<std::vector<RecordId>> buffers(1);
+    std::vector<RecordId> rids(500);
+    const RecordId *data = rids.data();
+    buffers.give(std::move(rids));
+    buffers.give(std::vector<RecordId>(10));
+    std::vector<RecordId> taken = buffers.take();
+    checkPassFail(taken.data(), data);
+    checkPassFail(buffers.take().capacity(), (std::size_t)0);
+  }
+
+  // the exceptions ending scans keep their messages without copying them
+  {
+    const IndexScanCompletedException completed;
+    checkPassFail(std::string(completed.what()), "Index Scan Completed");
+    checkPassFail(completed.message(), "Index Scan Completed");
+    const EndOfFileException end;
+    checkPassFail(std::string(end.what()), "End of File reached.");
+    const FileNotFoundException missing("relX");
+    const bool named = missing.message().find("relX") != std::string::npos;
+    checkPassFail(named, true);
+  }
+}
+
+void test57_file_registry() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test57_file_registry" << std::endl;
+
+  createRelationRandom(20000);
+  const PageId firstPage = file1->getFirstPageNo();
+
+  // existence is checked without opening; a directory is no file
+  checkPassFail(File::exists(relationName), true);
+  checkPassFail(File::exists("relA.missing"), false);
+  checkPassFail(File::exists("."), false);
+
+  // a file opened under another path shares the stream of the open file
+  {
+    checkPassFail(File::isOpen("./" + relationName), true);
+    PageFile other = PageFile::open("./" + relationName);
+    checkPassFail(other.getNumPages(), file1->getNumPages());
+    Page page = other.readPage(firstPage);
+    checkPassFail(page.page_number(), firstPage);
+
+    // every object has its own identifier, copies included
+    PageFile copy = other;
+    const bool distinct = other.id() != 0 && copy.id() != 0 &&
+                          other.id() != copy.id() &&
+                          other.id() != file1->id();
+    checkPassFail(distinct, true);
+  }
+  checkPassFail(File::isOpen(relationName), true);
+
+  // frames of a destroyed file object are not found through another object,
+  // wherever it is allocated
+  {
+    BufMgr pool(10);
+    Page *page;
+    for (int round = 0; round < 3; round++) {
+      PageFile *relation = new PageFile(relationName, false);
+      pool.readPage(relation, firstPage, page);
+      pool.unPinPage(relation, firstPage, false);
+      delete relation;
+    }
+    checkPassFail(pool.getBufStats().diskreads, 3);
+  }
+
+  deleteRelation();
+  checkPassFail(File::isOpen(relationName), false);
+  checkPassFail(File::exists(relationName), false);
+}
+
+void test58_ebay_loader() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test58_ebay_loader" << std::endl;
+
+  // the reader unescapes strings, reads every type and rejects stray commas
+  {
+    std::istringstream in(
+        "{\"a\": [1, -2.5e1, true, null, {\"b\": \"\\u00e9\\n\"}], "
+        "\"c\": \"\\ud83d\\ude00\"}");
+    JsonReader reader(in);
+    std::string key, value;
+    reader.beginObject();
+    checkPassFail(reader.nextKey(key), true);
+    reader.beginArray();
+    double sum = 0;
+    while (reader.nextElement()) {
+      if (reader.peek() == JsonReader::NUMBER) {
+        sum += reader.readNumber();
+      } else {
+        reader.skipValue();
+      }
+    }
+    checkPassFail(sum, -24.0);
+    checkPassFail(reader.nextKey(key), true);
+    reader.readString(value);
+    checkPassFail(value, std::string("\xf0\x9f\x98\x80"));
+    checkPassFail(reader.nextKey(key), false);
+    checkPassFail(reader.atEnd(), true);
+
+    std::istringstream bad("[1, 2,, 3]");
+    JsonReader badReader(bad);
+    std::uint64_t offset = 0;
+    try {
+      badReader.skipValue();
+    } catch (const JsonParseException &e) {
+      offset = e.offset();
+    }
+    checkPassFail(offset, 6u);
+  }
+
+  // an item with escapes, repeated categories and bids, and one without bids
+  // sold by a user seen bidding before
+  const std::string jsonName = "relA.json";
+  {
+    std::ofstream json(jsonName);
+    json << R"json({"Items": [
+  {"ItemID": "1043374545", "Name": "say \"hi\" \\ café",
+   "Category": ["Toys", "Games", "Toys"], "Currently": "$1,234.50",
+   "First_Bid": "$1.00", "Number_of_Bids": "2",
+   "Bids": [{"Bid": {"Bidder": {"UserID": "bob", "Rating": "7",
+                                "Location": "Paris", "Country": "France"},
+                     "Time": "Dec-10-01 09:00:05", "Amount": "$2.00"}},
+            {"Bid": {"Bidder": {"UserID": "carol", "Rating": "3"},
+                     "Time": "Dec-11-01 10:00:00", "Amount": "$1,234.50"}}],
+   "Location": "Madison", "Country": "USA",
+   "Started": "Dec-03-01 18:10:40", "Ends": "Dec-13-01 18:10:40",
+   "Seller": {"UserID": "alice", "Rating": "1035"}, "Description": null},
+  {"ItemID": "1043374546", "Name": "line\nbreak", "Category": ["Toys"],
+   "Currently": "$5.00", "Buy_Price": "$9.99", "First_Bid": "$5.00",
+   "Number_of_Bids": "0", "Bids": null, "Location": "Oslo",
+   "Country": "Norway", "Started": "Dec-03-01 18:10:40",
+   "Ends": "Dec-13-01 18:10:40", "Seller": {"UserID": "bob", "Rating": "7"},
+   "Description": "x😀"}]}
+)json";
+  }
+  const EbayLoadStats stats = loadEbay({jsonName}, relationName, bufMgr);
+  checkPassFail(stats.items, 2u);
+  checkPassFail(stats.users, 3u);
+  checkPassFail(stats.bids, 2u);
+  checkPassFail(stats.categories, 3u);
+  checkPassFail(stats.pages, 4u);
+
+  {
+    std::vector<EbayItem> items;
+    FileScan scan(relationName + ".items", bufMgr);
+    try {
+      RecordId scanRid;
+      while (1) {
+        scan.scanNext(scanRid);
+        items.push_back(*(const EbayItem *)scan.getRecordView().data);
+      }
+    } catch (EndOfFileException e) {
+    }
+    checkPassFail(items.size(), 2u);
+    checkPassFail(std::string(items[0].name),
+                  std::string("say \"hi\" \\ caf\xc3\xa9"));
+    checkPassFail(items[0].currently, 1234.5);
+    checkPassFail(items[0].buyPrice, 0.0);
+    checkPassFail(items[0].started, 1007403040);
+    checkPassFail(std::string(items[0].seller), std::string("alice"));
+    checkPassFail(std::string(items[0].description), std::string());
+    checkPassFail(std::string(items[1].name), std::string("line\nbreak"));
+    checkPassFail(items[1].buyPrice, 9.99);
+    checkPassFail(std::string(items[1].description),
+                  std::string("x\xf0\x9f\x98\x80"));
+
+    // a user keeps the location it was first seen with
+    std::map<std::string, EbayUser> users;
+    FileScan userScan(relationName + ".users", bufMgr);
+    try {
+      RecordId scanRid;
+      while (1) {
+        userScan.scanNext(scanRid);
+        const EbayUser &user = *(const EbayUser *)userScan.getRecordView().data;
+        users[user.userId] = user;
+      }
+    } catch (EndOfFileException e) {
+    }
+    checkPassFail(users.size(), 3u);
+    checkPassFail(std::string(users["alice"].location), std::string("Madison"));
+    checkPassFail(std::string(users["bob"].location), std::string("Paris"));
+    checkPassFail(users["carol"].rating, 3);
+  }
+
+  // the indexes were built with the relations and open as they were built
+  std::vector<std::string> indexNames;
+  {
+    std::string name;
+    const int first = 1043374545, second = 1043374546;
+    BTreeIndex items(relationName + ".items", name, bufMgr,
+                     offsetof(EbayItem, itemId), INTEGER);
+    indexNames.push_back(name);
+    checkPassFail(countScan(&items, &second, GTE, &second, LTE), 1);
+
+    BTreeIndex categories(relationName + ".categories", name, bufMgr,
+                          offsetof(EbayCategory, itemId), INTEGER);
+    indexNames.push_back(name);
+    checkPassFail(countScan(&categories, &first, GTE, &first, LTE), 2);
+
+    BTreeIndex users(relationName + ".users", name, bufMgr,
+                     offsetof(EbayUser, userId), STRING);
+    indexNames.push_back(name);
+    char bob[STRINGSIZE] = "bob";
+    checkPassFail(countScan(&users, bob, GTE, bob, LTE), 1);
+
+    BTreeIndex bids(relationName + ".bids", name, bufMgr,
+                    {{offsetof(EbayBid, itemId), INTEGER},
+                     {offsetof(EbayBid, amount), DOUBLE}});
+    indexNames.push_back(name);
+    char low[12], high[12];
+    const double lowAmount = 100, highAmount = 1e9;
+    memcpy(low, &first, 4);
+    memcpy(low + 4, &lowAmount, 8);
+    memcpy(high, &first, 4);
+    memcpy(high + 4, &highAmount, 8);
+    checkPassFail(countScan(&bids, low, GTE, high, LTE), 1);
+  }
+
+  // the relations are not loaded over
+  bool exists = false;
+  try {
+    loadEbay({jsonName}, relationName, bufMgr);
+  } catch (FileExistsException e) {
+    exists = true;
+  }
+  checkPassFail(exists, true);
+
+  for (const std::string &name : indexNames) File::remove(name);
+  for (const char *suffix : {".items", ".users", ".bids", ".categories"}) {
+    File::remove(relationName + suffix);
+  }
+  File::remove(jsonName);
+
+  // records fill every page but the last, and the index built from the keys
+  // gathered leads to the records
+  const int numRecords = 20000;
+  std::vector<std::string> names;
+  {
+    RelationLoader loader(relationName, sizeof(RECORD));
+    loader.addIndex({{offsetof(tuple, i), INTEGER}});
+    RECORD record;
+    memset(&record, 0, sizeof(record));
+    for (int k = 0; k < numRecords; k++) {
+      record.i = k * 7 % numRecords;
+      record.d = record.i;
+      sprintf(record.s, "%05d string record", record.i);
+      loader.append((const char *)&record);
+    }
+    names = loader.finish(bufMgr);
+    const std::uint64_t perPage =
+        Page::DATA_SIZE / (sizeof(RECORD) + sizeof(PageSlot));
+    checkPassFail(loader.pages(), (numRecords + perPage - 1) / perPage);
+  }
+  checkPassFail(names.size(), 1u);
+  file1 = new PageFile(relationName, false);
+  PageId lastPage = Page::INVALID_NUMBER;
+  for (FileIterator it = file1->begin(); it != file1->end(); ++it) {
+    lastPage = (*it).page_number();
+  }
+  const PageId roomy = file1->findPageWithSpace(sizeof(RECORD));
+  const bool onlyLastHasRoom =
+      roomy == Page::INVALID_NUMBER || roomy == lastPage;
+  checkPassFail(onlyLastHasRoom, true);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(intIndexName, names[0]);
+    const int low = 100, high = 199;
+    int matching = 0;
+    for (const RecordId &found : scanRids(&index, &low, GTE, &high, LTE)) {
+      const Page page = file1->readPage(found.page_number);
+      const RECORD *stored =
+          (const RECORD *)page.getRecordView(found).data;
+      matching += stored->i >= low && stored->i <= high;
+    }
+    checkPassFail(matching, 100);
+  }
+  int scanned = 0;
+  {
+    FileScan scan(relationName, bufMgr);
+    try {
+      RecordId scanRid;
+      while (1) {
+        scan.scanNext(scanRid);
+        scanned++;
+      }
+    } catch (EndOfFileException e) {
+    }
+  }
+  checkPassFail(scanned, numRecords);
+  File::remove(intIndexName);
+  deleteRelation();
+}
+
+void test59_hash_index() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test59_hash_index" << std::endl;
+  const int numRecords = 5000;
+  std::string hashIndexName;
+
+  // point lookups find what the B+ tree finds, over many bucket splits
+  createRelationRandom(numRecords);
+  {
+    HashIndex hash(relationName, hashIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER);
+    checkPassFail(hashIndexName, relationName + ",0,hash");
+    BTreeIndex tree(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                    INTEGER);
+    RecordId hashRids[4], treeRids[4];
+    bool agree = true;
+    for (int key = -10; key < numRecords + 10; key++) {
+      const std::size_t found = hash.lookup(&key, hashRids, 4);
+      agree &= found == tree.lookup(&key, treeRids, 4);
+      agree &= found == (key >= 0 && key < numRecords ? 1u : 0u);
+      agree &= found == 0 || hashRids[0] == treeRids[0];
+    }
+    checkPassFail(agree, true);
+    const HashIndexStats stats = hash.getStats();
+    checkPassFail(stats.entries, (std::uint64_t)numRecords);
+    const bool split = stats.buckets > 1 && stats.overflowPages == 0;
+    checkPassFail(split, true);
+
+    // deleted entries are no longer found, and deleting one twice throws
+    for (int key = 0; key < numRecords; key += 2) {
+      hash.lookup(&key, hashRids, 1);
+      hash.deleteEntry(&key, hashRids[0]);
+    }
+    bool halved = true;
+    for (int key = 0; key < numRecords; key++)
+      halved &= hash.lookup(&key, hashRids, 1) == (std::size_t)(key % 2);
+    checkPassFail(halved, true);
+    bool thrown = false;
+    try {
+      const int key = 0;
+      hash.deleteEntry(&key, treeRids[0]);
+    } catch (const NoSuchKeyFoundException &e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+  }
+  File::remove(intIndexName);
+
+  // an index opened again reads its directory back from the file, and one
+  // opened on another attribute or type is rejected
+  {
+    HashIndex hash(relationName, hashIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER);
+    RecordId rids[1];
+    int found = 0;
+    for (int key = 0; key < numRecords; key++)
+      found += hash.lookup(&key, rids, 1);
+    checkPassFail(found, numRecords / 2);
+    checkPassFail(hash.getStats().entries, (std::uint64_t)numRecords / 2);
+  }
+  bool rejected = false;
+  try {
+    HashIndex hash(relationName, hashIndexName, bufMgr, offsetof(tuple, i),
+                   DOUBLE);
+  } catch (const BadIndexInfoException &e) {
+    rejected = true;
+  }
+  checkPassFail(rejected, true);
+  File::remove(hashIndexName);
+  deleteRelation();
+
+  // a key shared by many entries overflows its bucket rather than splitting
+  // it, and each double and string key finds all of its entries
+  const int numCategories = 2;
+  createRelationCategories(numRecords, numCategories);
+  {
+    HashIndex ints(relationName, hashIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER);
+    const HashIndexStats stats = ints.getStats();
+    const bool overflowed =
+        stats.overflowPages > 0 && stats.globalDepth < HASH_MAX_DEPTH;
+    checkPassFail(overflowed, true);
+  }
+  File::remove(hashIndexName);
+  std::string doubleIndexName, stringIndexName;
+  {
+    HashIndex doubles(relationName, doubleIndexName, bufMgr,
+                      offsetof(tuple, d), DOUBLE);
+    HashIndex strings(relationName, stringIndexName, bufMgr,
+                      offsetof(tuple, s), STRING);
+    std::vector<RecordId> rids(numRecords);
+    bool complete = true;
+    for (int category = 0; category < numCategories; category++) {
+      const std::size_t expected =
+          numRecords / numCategories + (category < numRecords % numCategories);
+      const double d = category;
+      char s[sizeof(tuple::s)];
+      sprintf(s, "%05d string record", category);
+      complete &= doubles.lookup(&d, rids.data(), rids.size()) == expected;
+      complete &= strings.lookup(s, rids.data(), rids.size()) == expected;
+    }
+    const double zero = 0.0, negativeZero = -0.0;
+    complete &= doubles.lookup(&negativeZero, rids.data(), 1) ==
+                doubles.lookup(&zero, rids.data(), 1);
+    checkPassFail(complete, true);
+  }
+  File::remove(doubleIndexName);
+  File::remove(stringIndexName);
+  deleteRelation();
+}
+
+void test60_leaf_summaries() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test60_leaf_summaries" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000;
+  createRelationRandom(numRecords);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+
+    // the odd keys are deleted before the leaves are summarized
+    RecordId rid;
+    for (int key = 1; key < numRecords; key += 2) {
+      index.lookup(&key, &rid, 1);
+      index.deleteEntry(&key, rid);
+    }
+    index.setLeafSummaries(false);
+    index.setLeafSummaries(true);
+    bool found = true;
+    for (int key = 0; key < numRecords; key += 2)
+      found &= index.lookup(&key, &rid, 1) == 1;
+    checkPassFail(found, true);
+
+    // lookups of the deleted keys end above the leaves, but for the few
+    // passing a filter
+    index.clearCounters();
+    std::size_t numFound = 0;
+    for (int key = 1; key < numRecords; key += 2)
+      numFound += index.lookup(&key, &rid, 1);
+    checkPassFail(numFound, 0u);
+    IndexCounters counters = index.getCounters();
+    const bool skipped = counters.leavesSkipped > counters.lookups * 9 / 10 &&
+                         counters.pagesPinned < counters.lookups / 10;
+    checkPassFail(skipped, true);
+
+    // a scan of a range between the keys of a leaf, or of a deleted key,
+    // throws without reading a leaf; other scans are unchanged
+    index.clearCounters();
+    int low = 101, high = 101;
+    bool thrown = false;
+    try {
+      index.startScan(&low, GTE, &high, LTE);
+    } catch (const NoSuchKeyFoundException &e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+    checkPassFail(index.getCounters().leavesSkipped, 1u);
+    low = 99;
+    high = 103;
+    checkPassFail(countScan(&index, &low, GTE, &high, LTE), 2);
+    low = numRecords;
+    high = numRecords + 100;
+    checkPassFail(countScan(&index, &low, GTE, &high, LTE), 0);
+
+    // keys inserted one at a time, in batches and past the last one are
+    // found, through the summaries they were added to or rebuilt
+    for (int key = 1; key < numRecords / 2; key += 2)
+      index.insertEntry(&key, RecordId{1, 1});
+    std::vector<int> batch;
+    for (int key = numRecords / 2 + 1; key < numRecords + 2000; key += 2)
+      batch.push_back(key);
+    std::vector<RecordId> rids(batch.size(), RecordId{1, 2});
+    index.insertBatch(batch.data(), rids.data(), batch.size());
+    found = true;
+    for (int key = 0; key < numRecords + 2000; key++)
+      found &= index.lookup(&key, &rid, 1) == (key < numRecords || key % 2);
+    checkPassFail(found, true);
+
+    // the same keys in one batch of lookups, and with the summaries off
+    std::vector<int> keys(numRecords + 4000);
+    for (std::size_t k = 0; k < keys.size(); k++) keys[k] = (int)k - 2000;
+    for (int on = 1; on >= 0; on--) {
+      index.setLeafSummaries(on);
+      index.clearCounters();
+      std::vector<RecordId> outRids;
+      std::vector<std::size_t> outCounts;
+      index.lookupMany(keys.data(), keys.size(), outRids, outCounts);
+      bool counted = true;
+      for (std::size_t k = 0; k < keys.size(); k++) {
+        const int key = keys[k];
+        counted &= outCounts[k] ==
+                   (key >= 0 && (key < numRecords || (key < numRecords + 2000 &&
+                                                      key % 2)));
+      }
+      checkPassFail(counted, true);
+      const bool counterAgrees = (index.getCounters().leavesSkipped > 0) == on;
+      checkPassFail(counterAgrees, true);
+    }
+  }
+  File::remove(intIndexName);
+
+  // -0.0 passes the filter of 0.0, and string keys find their entries
+  {
+    BTreeIndex doubles(relationName, doubleIndexName, bufMgr,
+                       offsetof(tuple, d), DOUBLE);
+    BTreeIndex strings(relationName, stringIndexName, bufMgr,
+                       offsetof(tuple, s), STRING);
+    RecordId rid;
+    bool found = true;
+    for (int key = 0; key < numRecords; key += 7) {
+      const double d = key;
+      char s[sizeof(tuple::s)];
+      sprintf(s, "%05d string record", key);
+      found &= doubles.lookup(&d, &rid, 1) == 1;
+      found &= strings.lookup(s, &rid, 1) == 1;
+    }
+    const double negativeZero = -0.0, half = 0.5;
+    found &= doubles.lookup(&negativeZero, &rid, 1) == 1;
+    found &= doubles.lookup(&half, &rid, 1) == 0;
+    checkPassFail(found, true);
+  }
+  File::remove(doubleIndexName);
+  File::remove(stringIndexName);
+  deleteRelation();
+}
+
+void test61_insert_buffer() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test61_insert_buffer" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000, numExtra = 10000, bufferSize = 1000;
+  createRelationRandom(numRecords);
+  std::vector<int> extra(numExtra);
+  for (int k = 0; k < numExtra; k++) extra[k] = numRecords + k;
+  std::srand(61);
+  std::random_shuffle(extra.begin(), extra.end());
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    index.setInsertBuffer(bufferSize);
+    index.clearCounters();
+
+    // keys still pending are found by lookups, after those of the leaves
+    for (int k = 0; k < bufferSize / 2; k++)
+      index.insertEntry(&extra[k], RecordId{(PageId)extra[k], 1});
+    int key = 5;
+    index.insertEntry(&key, RecordId{1, 7});
+    checkPassFail(index.getCounters().bufferFlushes, 0u);
+    RecordId rids[2];
+    checkPassFail(index.lookup(&key, rids, 2), 2u);
+    checkPassFail(rids[1].slot_number, 7);
+    bool found = true;
+    for (int k = 0; k < numExtra; k++) {
+      const bool pending = k < bufferSize / 2;
+      found &= index.lookup(&extra[k], rids, 1) == (pending ? 1u : 0u) &&
+               (!pending || rids[0].page_number == (PageId)extra[k]);
+    }
+    checkPassFail(found, true);
+    std::vector<int> keys(numRecords + numExtra);
+    for (std::size_t k = 0; k < keys.size(); k++) keys[k] = (int)k;
+    std::vector<RecordId> outRids;
+    std::vector<std::size_t> outCounts;
+    index.lookupMany(keys.data(), keys.size(), outRids, outCounts);
+    std::set<int> inserted(extra.begin(), extra.begin() + bufferSize / 2);
+    bool counted = outRids.size() == numRecords + bufferSize / 2 + 1u;
+    for (std::size_t k = 0; k < keys.size(); k++) {
+      const bool present = keys[k] < numRecords || inserted.count(keys[k]);
+      counted &= outCounts[k] == (k == 5 ? 2u : present ? 1u : 0u);
+    }
+    checkPassFail(counted, true);
+
+    // deleting a pending entry takes it out of the buffer
+    index.deleteEntry(&key, RecordId{1, 7});
+    checkPassFail(index.lookup(&key, rids, 2), 1u);
+    bool thrown = false;
+    try {
+      index.deleteEntry(&key, RecordId{1, 7});
+    } catch (const NoSuchKeyFoundException &e) {
+      thrown = true;
+    }
+    checkPassFail(thrown, true);
+
+    // a full buffer is applied to the leaves, and a scan applies the rest
+    for (int k = bufferSize / 2; k < numExtra / 2; k++)
+      index.insertEntry(&extra[k], RecordId{(PageId)extra[k], 1});
+    const bool flushed =
+        index.getCounters().bufferFlushes == numExtra / 2 / bufferSize - 1;
+    checkPassFail(flushed, true);
+    int low = numRecords, high = numRecords + numExtra;
+    checkPassFail(countScan(&index, &low, GTE, &high, LT), numExtra / 2);
+
+    // batches are buffered too, and the statistics count every entry
+    std::vector<RecordId> batchRids;
+    for (int k = numExtra / 2; k < numExtra; k++)
+      batchRids.push_back(RecordId{(PageId)extra[k], 1});
+    index.insertBatch(&extra[numExtra / 2], batchRids.data(),
+                      batchRids.size());
+    checkPassFail(index.getStats().numEntries,
+                  (std::size_t)(numRecords + numExtra));
+    for (int k = 0; k < numExtra / 10; k++)
+      index.insertEntry(&keys[k], RecordId{2, 2});
+  }
+
+  // the index applies what it still buffers when it is closed
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    RecordId rids[2];
+    bool found = true;
+    for (int key = 0; key < numRecords + numExtra; key++)
+      found &= index.lookup(&key, rids, 2) == (key < numExtra / 10 ? 2u : 1u);
+    checkPassFail(found, true);
+    int low = 0, high = numRecords + numExtra;
+    checkPassFail(countScan(&index, &low, GTE, &high, LT),
+                  numRecords + numExtra + numExtra / 10);
+  }
+  File::remove(intIndexName);
+  deleteRelation();
+}
+
+void test62_snapshot_scans() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test62_snapshot_scans" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000;
+  createRelationRandom(numRecords);
+  std::vector<int> keys(numRecords);
+  for (int k = 0; k < numRecords; k++) keys[k] = k;
+  std::srand(62);
+  std::random_shuffle(keys.begin(), keys.end());
+  auto secondRid = [](int key) {
+    return RecordId{(PageId)(numRecords + key), 1};
+  };
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    int low = 0, high = numRecords;
+    const std::vector<RecordId> before =
+        scanRids(&index, &low, GTE, &high, LT);
+
+    // snapshot scans in both orders, and one to seek in, opened part way
+    IndexScanCursor ascending = index.openScan(&low, GTE, &high, LT,
+                                               NORMAL_ACCESS, ASCENDING, true);
+    IndexScanCursor descending = index.openScan(
+        &low, GTE, &high, LT, NORMAL_ACCESS, DESCENDING, true);
+    IndexScanCursor seeking = index.openScan(&low, GTE, &high, LT,
+                                             NORMAL_ACCESS, ASCENDING, true);
+    std::vector<RecordId> ascendingRids, descendingRids;
+    RecordId rid;
+    for (int k = 0; k < numRecords / 4; k++) {
+      ascending.scanNext(rid);
+      ascendingRids.push_back(rid);
+      descending.scanNext(rid);
+      descendingRids.push_back(rid);
+    }
+
+    // a second entry for every key splits leaves on both sides of the scans,
+    // deleting both entries of an eighth of the keys merges leaves, and keys
+    // past the range take the pages freed
+    index.clearCounters();
+    for (int key : keys) index.insertEntry(&key, secondRid(key));
+    for (int key = numRecords / 2; key < 5 * numRecords / 8; key++) {
+      RecordId rids[2];
+      index.lookup(&key, rids, 2);
+      index.deleteEntry(&key, rids[0]);
+      index.deleteEntry(&key, rids[1]);
+    }
+    for (int key = numRecords; key < numRecords + numRecords / 4; key++)
+      index.insertEntry(&key, secondRid(key));
+    const bool saved = index.getCounters().pagesSaved > 0;
+    checkPassFail(saved, true);
+
+    // seeks ahead and back find the entries as they were
+    bool sought = true;
+    for (int key : {100, numRecords - 5, 3, 5 * numRecords / 8 - 1}) {
+      seeking.seek(&key);
+      seeking.scanNext(rid);
+      sought &= rid == before[key];
+    }
+    checkPassFail(sought, true);
+
+    try {
+      while (true) {
+        ascending.scanNext(rid);
+        ascendingRids.push_back(rid);
+      }
+    } catch (const IndexScanCompletedException &e) {
+    }
+    try {
+      while (true) {
+        descending.scanNext(rid);
+        descendingRids.push_back(rid);
+      }
+    } catch (const IndexScanCompletedException &e) {
+    }
+    const bool ascendingSame = ascendingRids == before;
+    checkPassFail(ascendingSame, true);
+    std::reverse(descendingRids.begin(), descendingRids.end());
+    const bool descendingSame = descendingRids == before;
+    checkPassFail(descendingSame, true);
+
+    // with the snapshots closed, changes copy nothing
+    ascending.endScan();
+    descending.endScan();
+    seeking.endScan();
+    index.clearCounters();
+    int key = numRecords / 2;
+    index.insertEntry(&key, rid);
+    checkPassFail(index.getCounters().pagesSaved, 0u);
+    checkPassFail(countScan(&index, &low, GTE, &high, LT),
+                  2 * numRecords - numRecords / 4 + 1);
+  }
+  File::remove(intIndexName);
+
+  // a writer thread changes a concurrent index while a snapshot is scanned
+  BufMgr *pool = new BufMgr(1000, true);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+    int low = 0, high = numRecords;
+    const std::vector<RecordId> before =
+        scanRids(&index, &low, GTE, &high, LT);
+    IndexScanCursor snapshot = index.openScan(&low, GTE, &high, LT,
+                                              NORMAL_ACCESS, ASCENDING, true);
+    std::thread writer([&]() {
+      for (int key : keys) {
+        index.insertEntry(&key, secondRid(key));
+        if (key % 4 == 0) index.deleteEntry(&key, secondRid(key));
+      }
+    });
+    std::vector<RecordId> rids(before.size() + 1);
+    std::size_t numRids = 0, n;
+    while ((n = snapshot.scanNextBatch(&rids[numRids], 7)) > 0) {
+      numRids += n;
+      std::this_thread::yield();
+    }
+    writer.join();
+    rids.resize(numRids);
+    const bool same = rids == before;
+    checkPassFail(same, true);
+    snapshot.endScan();
+
+    std::vector<RecordId> live;
+    index.scanRange(&low, GTE, &high, LT, live);
+    const bool liveSame = scanRids(&index, &low, GTE, &high, LT) == live;
+    checkPassFail(liveSame, true);
+    checkPassFail(live.size(), (std::size_t)(2 * numRecords - numRecords / 4));
+  }
+  delete pool;
+  File::remove(intIndexName);
+  deleteRelation();
+
+  // entries added to posting lists after a snapshot began are not returned
+  const int numCategories = 8;
+  createRelationCategories(numRecords, numCategories);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    int low = 0, high = numCategories;
+    IndexScanCursor ascending = index.openScan(&low, GTE, &high, LT,
+                                               NORMAL_ACCESS, ASCENDING, true);
+    IndexScanCursor descending = index.openScan(
+        &low, GTE, &high, LT, NORMAL_ACCESS, DESCENDING, true);
+    RecordId rid;
+    ascending.scanNext(rid);
+    descending.scanNext(rid);
+    for (int k = 0; k < numRecords; k++) {
+      const int key = k % numCategories;
+      index.insertEntry(&key, RecordId{(PageId)(numRecords + k), 2});
+    }
+    int numAscending = 1, numDescending = 1;
+    try {
+      while (true) {
+        ascending.scanNext(rid);
+        numAscending++;
+      }
+    } catch (const IndexScanCompletedException &e) {
+    }
+    try {
+      while (true) {
+        descending.scanNext(rid);
+        numDescending++;
+      }
+    } catch (const IndexScanCompletedException &e) {
+    }
+    checkPassFail(numAscending, numRecords);
+    checkPassFail(numDescending, numRecords);
+  }
+  File::remove(intIndexName);
+  deleteRelation();
+}
+
+void test63_partitioned_index() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test63_partitioned_index" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 20000, numPartitions = 4;
+  createRelationRandom(numRecords);
+  const std::vector<std::string> directories{"partsA", "partsB"};
+  for (const std::string &directory : directories)
+    mkdir(directory.c_str(), 0755);
+  auto drain = [](PartitionScanCursor &cursor) {
+    std::vector<RecordId> rids(numRecords);
+    rids.resize(cursor.scanNextBatch(rids.data(), rids.size()));
+    return rids;
+  };
+  std::string catalogName;
+  std::vector<std::string> partitionFiles;
+  {
+    BTreeIndex plain(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    int low = 0, high = numRecords, mid = numRecords / 3,
+        upper = 2 * numRecords / 3;
+    const std::vector<RecordId> all = scanRids(&plain, &low, GTE, &high, LT);
+    const std::vector<RecordId> middle =
+        scanRids(&plain, &mid, GTE, &upper, LTE);
+    const std::vector<RecordId> middleDown =
+        scanRids(&plain, &mid, GTE, &upper, LTE, DESCENDING);
+
+    {
+      // range partitions split the keys evenly, over both directories
+      PartitionedIndex index(relationName, catalogName, bufMgr,
+                             offsetof(tuple, i), INTEGER, RANGE_PARTITIONS,
+                             numPartitions, directories);
+      checkPassFail(catalogName, relationName + ",0,parts");
+      bool placed = true, even = true;
+      for (int p = 0; p < numPartitions; p++) {
+        partitionFiles.push_back(directories[p % 2] + '/' + catalogName +
+                                 ',' + std::to_string(p));
+        placed &= File::exists(partitionFiles[p]);
+        even &= index.partition(p).getStats().numEntries ==
+                (std::size_t)(numRecords / numPartitions);
+        const int first = p * numRecords / numPartitions;
+        even &= index.partitionOf(&first) == p;
+      }
+      checkPassFail(placed, true);
+      checkPassFail(even, true);
+
+      std::vector<RecordId> rids;
+      index.scanRange(&low, GTE, &high, LT, rids);
+      const bool same = rids == all;
+      checkPassFail(same, true);
+      PartitionScanCursor up =
+          index.openScan(&mid, GTE, &upper, LTE, ASCENDING);
+      PartitionScanCursor down =
+          index.openScan(&mid, GTE, &upper, LTE, DESCENDING);
+      const bool sameUp = drain(up) == middle;
+      const bool sameDown = drain(down) == middleDown;
+      checkPassFail(sameUp, true);
+      checkPassFail(sameDown, true);
+
+      // keys past the last bound go to the last partition
+      for (int key = numRecords; key < numRecords + 100; key++)
+        index.insertEntry(&key, RecordId{(PageId)key, 1});
+      int key = numRecords + 50;
+      RecordId rid;
+      checkPassFail(index.lookup(&key, &rid, 1), 1u);
+      checkPassFail(index.partition(numPartitions - 1).getStats().numEntries,
+                    (std::size_t)(numRecords / numPartitions + 100));
+      index.deleteEntry(&key, rid);
+      checkPassFail(index.lookup(&key, &rid, 1), 0u);
+      int past = numRecords + 1000;
+      bool empty = false;
+      try {
+        index.openScan(&past, GTE, &past, LTE);
+      } catch (const NoSuchKeyFoundException &e) {
+        empty = true;
+      }
+      checkPassFail(empty, true);
+      bool badRange = false;
+      try {
+        index.openScan(&high, GTE, &low, LTE);
+      } catch (const BadScanrangeException &e) {
+        badRange = true;
+      }
+      checkPassFail(badRange, true);
+    }
+
+    // a reopened index keeps its bounds, and rebuilds a missing partition
+    File::remove(partitionFiles[1]);
+    {
+      PartitionedIndex index(relationName, catalogName, bufMgr,
+                             offsetof(tuple, i), INTEGER, RANGE_PARTITIONS,
+                             numPartitions, directories);
+      checkPassFail(index.partition(1).getStats().numEntries,
+                    (std::size_t)(numRecords / numPartitions));
+      std::vector<RecordId> rids;
+      int top = numRecords + 100;
+      index.scanRange(&low, GTE, &top, LT, rids);
+      const bool reopened = rids.size() == all.size() + 99 &&
+                            std::equal(all.begin(), all.end(), rids.begin());
+      checkPassFail(reopened, true);
+    }
+    bool rejected = false;
+    try {
+      PartitionedIndex index(relationName, catalogName, bufMgr,
+                             offsetof(tuple, i), INTEGER, HASH_PARTITIONS,
+                             numPartitions, directories);
+    } catch (const BadIndexInfoException &e) {
+      rejected = true;
+    }
+    checkPassFail(rejected, true);
+  }
+  for (const std::string &name : partitionFiles) File::remove(name);
+  File::remove(catalogName);
+  File::remove(intIndexName);
+  deleteRelation();
+
+  // hash partitions hold every entry of a key together, are built on a
+  // thread each, and are merged by key
+  const int numCategories = 50, numHashPartitions = 5;
+  createRelationCategories(numRecords, numCategories);
+  std::map<std::pair<PageId, SlotId>, int> keyOf;
+  for (const std::pair<int, RecordId> &entry : relationEntries())
+    keyOf[{entry.second.page_number, entry.second.slot_number}] = entry.first;
+  auto recordKey = [&keyOf](const RecordId &rid) {
+    return keyOf[{rid.page_number, rid.slot_number}];
+  };
+  BufMgr *pool = new BufMgr(1000, true);
+  {
+    BTreeIndex plain(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER);
+    PartitionedIndex index(relationName, catalogName, pool,
+                           offsetof(tuple, i), INTEGER, HASH_PARTITIONS,
+                           numHashPartitions);
+    std::size_t total = 0;
+    bool spread = true;
+    for (int p = 0; p < numHashPartitions; p++) {
+      const std::size_t entries = index.partition(p).getStats().numEntries;
+      spread &= entries > 0;
+      total += entries;
+    }
+    checkPassFail(spread, true);
+    checkPassFail(total, (std::size_t)numRecords);
+    bool together = true;
+    std::vector<RecordId> rids(numRecords);
+    for (int key = 0; key < numCategories; key++)
+      together &= index.lookup(&key, rids.data(), rids.size()) ==
+                  (std::size_t)(numRecords / numCategories);
+    checkPassFail(together, true);
+
+    int low = 0, high = numCategories, mid = 10, upper = 30;
+    std::vector<RecordId> all;
+    index.scanRange(&low, GTE, &high, LT, all);
+    std::vector<int> keys;
+    for (const RecordId &rid : all) keys.push_back(recordKey(rid));
+    const bool ordered = all.size() == (std::size_t)numRecords &&
+                         std::is_sorted(keys.begin(), keys.end());
+    checkPassFail(ordered, true);
+    std::vector<int> plainKeys;
+    for (const RecordId &rid : scanRids(&plain, &low, GTE, &high, LT))
+      plainKeys.push_back(recordKey(rid));
+    const bool merged = keys == plainKeys;
+    checkPassFail(merged, true);
+
+    PartitionScanCursor down =
+        index.openScan(&mid, GT, &upper, LT, DESCENDING);
+    keys.clear();
+    for (const RecordId &rid : drain(down)) keys.push_back(recordKey(rid));
+    const bool descending =
+        keys.size() == (std::size_t)(19 * numRecords / numCategories) &&
+        std::is_sorted(keys.rbegin(), keys.rend()) && keys.front() == 29 &&
+        keys.back() == 11;
+    checkPassFail(descending, true);
+    down.endScan();
+    checkPassFail(down.isExecuting(), false);
+  }
+  delete pool;
+  for (int p = 0; p < numHashPartitions; p++)
+    File::remove(catalogName + ',' + std::to_string(p));
+  File::remove(catalogName);
+  File::remove(intIndexName);
+  for (const std::string &directory : directories) rmdir(directory.c_str());
+  deleteRelation();
+}
+
+void test64_index_service() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "test64_index_service" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 10000, numCategories = 100;
+  const std::size_t perKey = numRecords / numCategories;
+  createRelationCategories(numRecords, numCategories);
+  std::map<int, std::set<std::pair<PageId, SlotId>>> ridsOf;
+  std::map<std::pair<PageId, SlotId>, int> keyOf;
+  for (const std::pair<int, RecordId> &entry : relationEntries()) {
+    ridsOf[entry.first].insert(
+        {entry.second.page_number, entry.second.slot_number});
+    keyOf[{entry.second.page_number, entry.second.slot_number}] = entry.first;
+  }
+  auto sameRids = [&ridsOf](int key, const std::vector<RecordId> &rids) {
+    std::set<std::pair<PageId, SlotId>> found;
+    for (const RecordId &rid : rids)
+      found.insert({rid.page_number, rid.slot_number});
+    return found.size() == rids.size() && found == ridsOf.at(key);
+  };
+  auto readCount = [](const ServiceClient::Response &response,
+                      std::size_t &pos) {
+    std::uint32_t count;
+    memcpy(&count, &response.body[pos], sizeof(count));
+    pos += sizeof(count);
+    return count;
+  };
+
+  BufMgr *pool = new BufMgr(1000, true);
+  std::string indexName;
+  {
+    IndexService service(pool);
+    const int index = service.addIndex(
+        relationName, {KeyColumn{offsetof(tuple, i), INTEGER}});
+    checkPassFail(index, 0);
+    const int port = service.bind(0);
+    std::thread server([&service] { service.run(); });
+
+    {
+      // pipelined lookups are answered in order, each with every entry of
+      // its key, up to maxRids of them
+      ServiceClient client("127.0.0.1", port);
+      std::vector<std::uint32_t> tags;
+      for (int key = 0; key < numCategories; key++)
+        tags.push_back(client.addLookup(index, &key, sizeof(key), 1000));
+      int missing = numCategories + 5, capped = 7;
+      client.addLookup(index, &missing, sizeof(missing), 1000);
+      client.addLookup(index, &capped, sizeof(capped), 10);
+      client.flush();
+      bool inOrder = true, found = true;
+      for (int key = 0; key < numCategories; key++) {
+        const ServiceClient::Response response = client.next();
+        inOrder &= response.tag == tags[key] && response.status == SERVICE_OK;
+        std::size_t pos = 0;
+        found &= readCount(response, pos) == perKey;
+        found &= sameRids(key, ServiceClient::readEntries(response, pos,
+                                                          false));
+      }
+      checkPassFail(inOrder, true);
+      checkPassFail(found, true);
+      ServiceClient::Response response = client.next();
+      std::size_t pos = 0;
+      const bool none = readCount(response, pos) == 0 &&
+                        ServiceClient::readEntries(response, pos, false)
+                            .empty();
+      checkPassFail(none, true);
+      response = client.next();
+      pos = 0;
+      checkPassFail(readCount(response, pos), perKey);
+      checkPassFail(ServiceClient::readEntries(response, pos, false).size(),
+                    10u);
+
+      // scans return their range in key order, at most limit entries
+      int low = 10, high = 20, past = numCategories + 10;
+      client.addScan(index, &low, GTE, &high, LT, sizeof(int), 100000);
+      client.addScan(index, &low, GT, &high, LTE, sizeof(int), 5);
+      client.addScan(index, &past, GTE, &past, LTE, sizeof(int), 100);
+      client.addScan(index, &high, GTE, &low, LTE, sizeof(int), 100);
+      client.addScan(index, &low, LT, &high, LTE, sizeof(int), 100);
+      client.addScan(index, &low, (Operator)9, &high, LTE, sizeof(int), 100);
+      pos = 0;
+      const std::vector<RecordId> range =
+          ServiceClient::readEntries(client.next(), pos, false);
+      std::vector<int> keys;
+      for (const RecordId &rid : range)
+        keys.push_back(keyOf[{rid.page_number, rid.slot_number}]);
+      const bool ordered = range.size() == 10 * perKey &&
+                           std::is_sorted(keys.begin(), keys.end()) &&
+                           keys.front() == low && keys.back() == high - 1;
+      checkPassFail(ordered, true);
+      pos = 0;
+      response = client.next();
+      const std::vector<RecordId> limited =
+          ServiceClient::readEntries(response, pos, false);
+      bool first = limited.size() == 5;
+      for (const RecordId &rid : limited)
+        first &= keyOf[{rid.page_number, rid.slot_number}] == low + 1;
+      checkPassFail(first, true);
+      pos = 0;
+      response = client.next();
+      const bool empty = response.status == SERVICE_OK &&
+                         ServiceClient::readEntries(response, pos, false)
+                             .empty();
+      checkPassFail(empty, true);
+      checkPassFail(client.next().status, SERVICE_BAD_REQUEST);
+      checkPassFail(client.next().status, SERVICE_BAD_REQUEST);
+      checkPassFail(client.next().status, SERVICE_BAD_REQUEST);
+
+      // a probe answers each key as a lookup would
+      const int probeKeys[] = {3, numCategories + 1, 42};
+      client.addProbe(index, probeKeys, 3, sizeof(int), 1000);
+      response = client.next();
+      pos = 0;
+      bool probed = true;
+      for (int key : probeKeys) {
+        const std::uint32_t count = readCount(response, pos);
+        const std::vector<RecordId> rids =
+            ServiceClient::readEntries(response, pos, false);
+        probed &= key < numCategories ? count == perKey && sameRids(key, rids)
+                                      : count == 0 && rids.empty();
+      }
+      probed &= pos == response.body.size();
+      checkPassFail(probed, true);
+
+      // and caps the entries of each key at maxRids, but not too many keys
+      client.addProbe(index, probeKeys, 3, sizeof(int), 10);
+      std::vector<int> manyKeys(SERVICE_MAX_KEYS + 1, 3);
+      client.addProbe(index, manyKeys.data(), manyKeys.size(), sizeof(int),
+                      1);
+      response = client.next();
+      pos = 0;
+      bool capped10 = true;
+      for (int key : probeKeys) {
+        const std::uint32_t count = readCount(response, pos);
+        const std::size_t n =
+            ServiceClient::readEntries(response, pos, false).size();
+        capped10 &= key < numCategories ? count == perKey && n == 10
+                                        : count == 0 && n == 0;
+      }
+      checkPassFail(capped10, true);
+      checkPassFail(client.next().status, SERVICE_BAD_REQUEST);
+
+      // records come with their entries when asked for
+      client.addLookup(index, &capped, sizeof(capped), 1000, SERVICE_RECORDS);
+      response = client.next();
+      pos = 0;
+      readCount(response, pos);
+      std::vector<std::string> records;
+      ServiceClient::readEntries(response, pos, true, &records);
+      bool fetched = records.size() == perKey;
+      for (const std::string &record : records) {
+        RECORD tuple;
+        fetched &= record.size() == sizeof(RECORD);
+        memcpy(&tuple, record.data(), sizeof(RECORD));
+        fetched &= tuple.i == capped;
+      }
+      checkPassFail(fetched, true);
+      response.body.pop_back();
+      pos = 4;
+      bool truncated = false;
+      try {
+        ServiceClient::readEntries(response, pos, true);
+      } catch (const BadgerDbException &e) {
+        truncated = true;
+      }
+      checkPassFail(truncated, true);
+
+      // malformed requests are refused, and the connection goes on
+      client.addLookup(5, &capped, sizeof(capped), 10);
+      client.add(SERVICE_LOOKUP, 0, index, &capped, sizeof(capped));
+      client.add((ServiceOp)9, 0, index, NULL, 0);
+      client.add(SERVICE_INDEXES, 0, 0, NULL, 0);
+      checkPassFail(client.next().status, SERVICE_BAD_REQUEST);
+      checkPassFail(client.next().status, SERVICE_BAD_REQUEST);
+      checkPassFail(client.next().status, SERVICE_BAD_REQUEST);
+      response = client.next();
+      std::uint16_t numIndexes, keyLength, nameLength;
+      memcpy(&numIndexes, &response.body[0], 2);
+      memcpy(&keyLength, &response.body[2], 2);
+      memcpy(&nameLength, &response.body[4], 2);
+      indexName.assign(&response.body[6], nameLength);
+      const bool listed = response.status == SERVICE_OK && numIndexes == 1 &&
+                          keyLength == sizeof(int) &&
+                          indexName == relationName + ",0";
+      checkPassFail(listed, true);
+    }
+
+    // clients on connections of their own are served at once
+    const int numClients = 4;
+    std::vector<std::thread> clients;
+    std::vector<int> correct(numClients);
+    for (int c = 0; c < numClients; c++) {
+      clients.emplace_back([&, c] {
+        ServiceClient client("127.0.0.1", port);
+        for (int round = 0; round < 5; round++) {
+          for (int key = c; key < numCategories; key += numClients)
+            client.addLookup(index, &key, sizeof(key), 1000);
+          for (int key = c; key < numCategories; key += numClients) {
+            std::size_t pos = 0;
+            const ServiceClient::Response response = client.next();
+            correct[c] += readCount(response, pos) == perKey &&
+                          sameRids(key, ServiceClient::readEntries(
+                                            response, pos, false));
+          }
+        }
+      });
+    }
+    for (std::thread &client : clients) client.join();
+    bool served = true;
+    for (int n : correct) served &= n == 5 * numCategories / numClients;
+    checkPassFail(served, true);
+
+    // a partial frame waits for the rest, and too long a frame is refused
+    std::vector<char> out;
+    const std::uint32_t tooLong = SERVICE_MAX_FRAME + 1, partial = 20;
+    checkPassFail(service.answer((const char *)&partial, 4, out), 0);
+    checkPassFail(service.answer((const char *)&tooLong, 4, out), -1);
+
+    service.stop();
+    server.join();
+    const ServiceStats stats = service.getStats();
+    checkPassFail(stats.connections, (std::uint64_t)(1 + numClients));
+    checkPassFail(stats.badRequests, 7u);
+  }
+  File::remove(indexName);
+  delete pool;
+  deleteRelation();
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// ######################     Test B+ Tree      ######################## //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+void randomIntTests(std::vector<int> *sortedvec) {
+  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER);
+  std::vector<int> resultvec;
+
+  int minVal = sortedvec->front();
+  int maxVal = sortedvec->back();
+  int numElem = sortedvec->size();
+
+  checkPassFail(intScan(&index, minVal, GTE, maxVal, LTE, &resultvec), numElem);
+  if (*sortedvec == resultvec)
+    std::cout << "Random int test passed at line no:" << __LINE__ << std::endl;
+  else
+    std::cout << "Random int test failed at line no:" << __LINE__ << std::endl;
+}
+
+void intTests() {
+  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER);
+
+  // run some tests
+  checkPassFail(intScan(&index, 25, GT, 40, LT), 14);
+  checkPassFail(intScan(&index, 20, GTE, 35, LTE), 16);
+  checkPassFail(intScan(&index, -3, GT, 3, LT), 3);
+  checkPassFail(intScan(&index, 996, GT, 1001, LT), 4);
+  checkPassFail(intScan(&index, 0, GT, 1, LT), 0);
+  checkPassFail(intScan(&index, 300, GT, 400, LT), 99);
+  checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+}
+
+void doubleTests() {
+  std::cout << "Create a B+ Tree index on the double field" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple, d),
+                   DOUBLE);
+
+  // run some tests
+  checkPassFail(doubleScan(&index, 25, GT, 40, LT), 14);
+  checkPassFail(doubleScan(&index, 20, GTE, 35, LTE), 16);
+  checkPassFail(doubleScan(&index, -3, GT, 3, LT), 3);
+  checkPassFail(doubleScan(&index, 996, GT, 1001, LT), 4);
+  checkPassFail(doubleScan(&index, 0, GT, 1, LT), 0);
+  checkPassFail(doubleScan(&index, 300, GT, 400, LT), 99);
+  checkPassFail(doubleScan(&index, 3000, GTE, 4000, LT), 1000);
+  checkPassFail(doubleScan(&index, 24.5, GT, 25.5, LT), 1);
+}
+
+void stringTests() {
+  std::cout << "Create a B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple, s),
+                   STRING);
+
+  // run some tests
+  checkPassFail(stringScan(&index, 25, GT, 40, LT), 14);
+  checkPassFail(stringScan(&index, 20, GTE, 35, LTE), 16);
+  checkPassFail(stringScan(&index, -3, GT, 3, LT), 3);
+  checkPassFail(stringScan(&index, 996, GT, 1001, LT), 4);
+  checkPassFail(stringScan(&index, 0, GT, 1, LT), 0);
+  checkPassFail(stringScan(&index, 300, GT, 400, LT), 99);
+  checkPassFail(stringScan(&index, 3000, GTE, 4000, LT), 1000);
+}
+
+void test_int_out_of_bound() {
+  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER);
+
+  checkPassFail(intScan(&index, 3000, GTE, 6000, LT), 2000);
+  checkPassFail(intScan(&index, 4999, GTE, 5010, LT), 1);
+
+  checkPassFail(intScan(&index, 5500, GTE, 6000, LT), 0);
+  checkPassFail(intScan(&index, 4999, GT, 6000, LT), 0);
+  checkPassFail(intScan(&index, -3000, GT, 0, LT), 0);
+
+  checkPassFail(intScan(&index, -3000, GT, 0, LTE), 1);
+  checkPassFail(intScan(&index, -3000, GT, 5, LTE), 6);
+  checkPassFail(intScan(&index, -3000, GT, 200, LT), 200);
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// ######################       Benchmarks      ######################## //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+void bench1_bulk_build_vs_insert_build() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench1_bulk_build_vs_insert_build" << std::endl;
+  deleteIndexFile();
+  createRelationRandom(350000);
+
+  const BuildMethod methods[] = {INSERT_BUILD, BULK_BUILD};
+  const char *names[] = {"insert build", "bulk build"};
+  for (int m = 0; m < 2; m++) {
+    {
+      auto start = std::chrono::steady_clock::now();
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                       INTEGER, methods[m]);
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << names[m] << ": " << elapsed.count() << "s" << std::endl;
+
+      checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+      checkPassFail(intScan(&index, 349990, GT, 400000, LT), 9);
+    }
+    std::ifstream indexFile(intIndexName, std::ios::binary | std::ios::ate);
+    std::cout << names[m] << " index size: " << indexFile.tellg() / Page::SIZE
+              << " pages" << std::endl;
+    indexFile.close();
+    deleteIndexFile();
+  }
+  deleteRelation();
+}
+
+void bench2_buf_hash_table() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench2_buf_hash_table" << std::endl;
+
+  // a table sized for a 1000-frame buffer pool, keyed on scattered pages of
+  // two files
+  const int numFrames = 1000;
+  const int rounds = 2000;
+  const std::string fileNames[] = {relationName + ".bench0",
+                                   relationName + ".bench1"};
+  for (const std::string &name : fileNames) {
+    try {
+      File::remove(name);
+    } catch (FileNotFoundException e) {
+    }
+  }
+  BlobFile *blob0 = new BlobFile(fileNames[0], true);
+  BlobFile *blob1 = new BlobFile(fileNames[1], true);
+  const File *files[] = {blob0, blob1};
+
+  BufHashTbl table(2 * numFrames);
+  std::chrono::duration<double> inserts{}, hits{}, misses{}, removes{};
+  std::vector<PageId> pageNos(numFrames);
+  FrameId frameNo;
+  int found = 0;
+
+  for (int r = 0; r < rounds; r++) {
+    for (int i = 0; i < numFrames; i++)
+      pageNos[i] = (rand() % 1000) * numFrames + i;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numFrames; i++)
+      table.insert(files[i % 2], pageNos[i], i);
+    auto end = std::chrono::steady_clock::now();
+    inserts += end - start;
+
+    start = end;
+    for (int i = 0; i < numFrames; i++)
+      found += table.lookup(files[i % 2], pageNos[i], frameNo);
+    end = std::chrono::steady_clock::now();
+    hits += end - start;
+
+    start = end;
+    for (int i = 0; i < numFrames; i++)
+      found += table.lookup(files[i % 2], pageNos[i] + 1000 * numFrames,
+                            frameNo);
+    end = std::chrono::steady_clock::now();
+    misses += end - start;
+
+    start = end;
+    for (int i = 0; i < numFrames; i++) table.remove(files[i % 2], pageNos[i]);
+    end = std::chrono::steady_clock::now();
+    removes += end - start;
+  }
+  checkPassFail(found, rounds * numFrames);
+
+  const double ops = (double)rounds * numFrames / 1e6;
+  std::cout << "insert: " << ops / inserts.count() << " Mops/s" << std::endl;
+  std::cout << "lookup hit: " << ops / hits.count() << " Mops/s" << std::endl;
+  std::cout << "lookup miss: " << ops / misses.count() << " Mops/s"
+            << std::endl;
+  std::cout << "remove: " << ops / removes.count() << " Mops/s" << std::endl;
+
+  delete blob0;
+  delete blob1;
+  for (const std::string &name : fileNames) File::remove(name);
+}
+
+void bench3_buffer_miss_heavy() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench3_buffer_miss_heavy" << std::endl;
+  deleteIndexFile();
+  createRelationRandom(350000);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+
+    // fetching the tuples in key order from a randomly ordered relation makes
+    // nearly every heap page access a miss in the 100-frame pool
+    int lowVal = 0;
+    int highVal = 350000;
+    int numResults = 0;
+    RecordId scanRid;
+    Page *curPage;
+    bufMgr->clearBufStats();
+    auto start = std::chrono::steady_clock::now();
+
+    index.startScan(&lowVal, GTE, &highVal, LT);
+    try {
+      while (1) {
+        index.scanNext(scanRid);
+        bufMgr->readPage(file1, scanRid.page_number, curPage);
+        bufMgr->unPinPage(file1, scanRid.page_number, false);
+        numResults++;
+      }
+    } catch (IndexScanCompletedException e) {
+    }
+    index.endScan();
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(numResults, 350000);
+    std::cout << "disk reads: " << bufMgr->getBufStats().diskreads
+              << std::endl;
+    std::cout << "fetch time: " << elapsed.count() << "s" << std::endl;
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench4_concurrent_scan() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench4_concurrent_scan" << std::endl;
+  createRelationForward(100000);
+
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+    pageNos.push_back((*iter).page_number());
+
+  // a concurrent pool holding the whole relation, warmed before timing
+  BufMgr *pool = new BufMgr(2 * pageNos.size(), true);
+  Page *curPage;
+  for (PageId pageNo : pageNos) {
+    pool->readPage(file1, pageNo, curPage);
+    pool->unPinPage(file1, pageNo, false);
+  }
+
+  const int passes = 20;
+  const unsigned maxThreads =
+      std::max(1u, std::thread::hardware_concurrency());
+  double singleThreaded = 0;
+  for (unsigned numThreads = 1;; numThreads = std::min(2 * numThreads,
+                                                       maxThreads)) {
+    std::vector<int> records(numThreads);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < numThreads; t++) {
+      threads.emplace_back([&, t]() {
+        // each thread scans every page of its share of the relation
+        for (int pass = 0; pass < passes; pass++) {
+          for (std::size_t p = t; p < pageNos.size(); p += numThreads) {
+            Page *page;
+            pool->readPage(file1, pageNos[p], page);
+            for (PageIterator iter = page->begin(); iter != page->end();
+                 ++iter) {
+              records[t] += iter.view().length == sizeof(RECORD);
+            }
+            pool->unPinPage(file1, pageNos[p], false);
+          }
+        }
+      });
+    }
+    for (std::thread &thread : threads) thread.join();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    int numRecords = 0;
+    for (int count : records) numRecords += count;
+    checkPassFail(numRecords, passes * 100000);
+    if (numThreads == 1) singleThreaded = elapsed.count();
+    std::cout << numThreads << " threads: " << elapsed.count()
+              << "s, speedup " << singleThreaded / elapsed.count()
+              << std::endl;
+    if (numThreads == maxThreads) break;
+  }
+
+  pool->flushFile(file1);
+  delete pool;
+  deleteRelation();
+}
+
+void bench5_replacement_policies() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench5_replacement_policies" << std::endl;
+  deleteIndexFile();
+  createRelationForward(100000);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+  }
+
+  // a relation scan interleaved with point lookups on the index pages
+  // covering the lowest half of the keys, through a 100-frame pool. The scan
+  // is not hinted, so the policy alone has to protect the index pages.
+  const ReplacementPolicy policies[] = {CLOCK_REPLACEMENT, LRUK_REPLACEMENT,
+                                        TWOQ_REPLACEMENT, ARC_REPLACEMENT};
+  for (ReplacementPolicy policy : policies) {
+    BufMgr *pool = new BufMgr(100, false, policy);
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER);
+      pool->clearBufStats();
+      srand(1);
+      int numResults = 0;
+      for (int pass = 0; pass < 3; pass++) {
+        FileScan fscan(relationName, pool, NORMAL_ACCESS);
+        RecordId scanRid;
+        try {
+          for (int numRecords = 1;; numRecords++) {
+            fscan.scanNext(scanRid);
+            if (numRecords % 25 != 0) continue;
+            int key = rand() % 50000;
+            index.startScan(&key, GTE, &key, LTE);
+            index.scanNext(scanRid);
+            index.endScan();
+            numResults++;
+          }
+        } catch (EndOfFileException e) {
+        }
+      }
+      checkPassFail(numResults, 3 * 100000 / 25);
+
+      const BufStats stats = pool->getBufStats();
+      std::cout << stats.policy << ": hit ratio " << stats.hitRatio()
+                << ", disk reads " << stats.diskreads << std::endl;
+    }
+    delete pool;
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench6_scan_access_hints() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench6_scan_access_hints" << std::endl;
+  deleteIndexFile();
+  createRelationForward(100000);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+  }
+
+  // the workload of bench5 through a 100-frame CLOCK pool, with the relation
+  // scans hinted as normal and as sequential accesses
+  const AccessHint hints[] = {NORMAL_ACCESS, SEQUENTIAL_ACCESS};
+  const char *names[] = {"normal scan", "sequential scan"};
+  for (int h = 0; h < 2; h++) {
+    BufMgr *pool = new BufMgr(100);
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER);
+      pool->clearBufStats();
+      srand(1);
+      int numResults = 0;
+      for (int pass = 0; pass < 3; pass++) {
+        FileScan fscan(relationName, pool, hints[h]);
+        RecordId scanRid;
+        try {
+          for (int numRecords = 1;; numRecords++) {
+            fscan.scanNext(scanRid);
+            if (numRecords % 25 != 0) continue;
+            int key = rand() % 50000;
+            index.startScan(&key, GTE, &key, LTE);
+            index.scanNext(scanRid);
+            index.endScan();
+            numResults++;
+          }
+        } catch (EndOfFileException e) {
+        }
+      }
+      checkPassFail(numResults, 3 * 100000 / 25);
+
+      const BufStats stats = pool->getBufStats();
+      std::cout << names[h] << ": hit ratio " << stats.hitRatio()
+                << ", disk reads " << stats.diskreads << std::endl;
+    }
+    delete pool;
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench7_read_ahead() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench7_read_ahead" << std::endl;
+  deleteIndexFile();
+  createRelationForward(100000);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+  }
+
+  // a relation scan and a full index range scan through a concurrent
+  // 100-frame pool, without and with pages read ahead
+  const std::uint32_t depths[] = {0, 8};
+  for (std::uint32_t depth : depths) {
+    BufMgr *pool = new BufMgr(100, true);
+    pool->setPrefetchDepth(depth);
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER);
+      pool->clearBufStats();
+      auto start = std::chrono::steady_clock::now();
+      int numRecords = 0;
+      {
+        FileScan fscan(relationName, pool);
+        RecordId scanRid;
+        try {
+          while (1) {
+            fscan.scanNext(scanRid);
+            numRecords++;
+          }
+        } catch (EndOfFileException e) {
+        }
+      }
+      std::chrono::duration<double> scanTime =
+          std::chrono::steady_clock::now() - start;
+
+      start = std::chrono::steady_clock::now();
+      int lowVal = 0;
+      int highVal = 100000;
+      int numResults = 0;
+      RecordId scanRid;
+      index.startScan(&lowVal, GTE, &highVal, LT, SEQUENTIAL_ACCESS);
+      try {
+        while (1) {
+          index.scanNext(scanRid);
+          numResults++;
+        }
+      } catch (IndexScanCompletedException e) {
+      }
+      index.endScan();
+      std::chrono::duration<double> indexScanTime =
+          std::chrono::steady_clock::now() - start;
+      checkPassFail(numRecords, 100000);
+      checkPassFail(numResults, 100000);
+
+      const BufStats stats = pool->getBufStats();
+      std::cout << "depth " << depth << ": file scan " << scanTime.count()
+                << "s, index scan " << indexScanTime.count()
+                << "s, disk reads " << stats.diskreads << ", read ahead "
+                << stats.prefetches << ", hits " << stats.prefetchHits
+                << ", wasted " << stats.prefetchWasted << std::endl;
+    }
+    delete pool;
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench8_write_behind() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench8_write_behind" << std::endl;
+
+  // allocating and writing pages the way an index build does, with every
+  // write flushed and with writes deferred until a final sync
+  const int numPages = 20000;
+  const std::string fileName = relationName + ".bench0";
+  const bool modes[] = {false, true};
+  for (bool writeBehind : modes) {
+    try {
+      File::remove(fileName);
+    } catch (FileNotFoundException e) {
+    }
+    auto start = std::chrono::steady_clock::now();
+    {
+      BlobFile blobFile = BlobFile::create(fileName);
+      blobFile.setWriteBehind(writeBehind);
+      for (int i = 0; i < numPages; i++) {
+        PageId pageNo;
+        Page page = blobFile.allocatePage(pageNo);
+        blobFile.writePage(pageNo, page);
+      }
+      blobFile.sync();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << (writeBehind ? "write-behind: " : "write-through: ")
+              << elapsed.count() << "s for " << numPages << " pages"
+              << std::endl;
+    File::remove(fileName);
+  }
+}
+
+void bench9_mapped_blob_file() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench9_mapped_blob_file" << std::endl;
+
+  // random page reads through a 100-frame pool, so nearly every read misses
+  const int numPages = 20000;
+  const int numReads = 200000;
+  const std::string fileName = relationName + ".bench0";
+  for (int mapped = 0; mapped < 2; mapped++) {
+    try {
+      File::remove(fileName);
+    } catch (FileNotFoundException e) {
+    }
+    File *file;
+    if (mapped)
+      file = new MappedBlobFile(fileName, true);
+    else
+      file = new BlobFile(fileName, true);
+    for (int i = 0; i < numPages; i++) {
+      PageId pageNo;
+      file->allocatePage(pageNo);
+    }
+
+    BufMgr *pool = new BufMgr(100);
+    srand(7);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numReads; i++) {
+      Page *page;
+      const PageId pageNo = 1 + rand() % numPages;
+      pool->readPage(file, pageNo, page);
+      pool->unPinPage(file, pageNo, false);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << (mapped ? "MappedBlobFile: " : "BlobFile: ")
+              << elapsed.count() << "s for " << numReads << " reads, "
+              << pool->getBufStats().diskreads << " disk reads" << std::endl;
+    pool->flushFile(file);
+    delete pool;
+    delete file;
+    File::remove(fileName);
+  }
+}
+
+void bench10_relation_load() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench10_relation_load" << std::endl;
+
+  const int sizes[] = {100000, 1000000};
+  for (int size : sizes) {
+    auto start = std::chrono::steady_clock::now();
+    createRelationForward(size);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << size << " tuples: " << elapsed.count() << "s" << std::endl;
+    deleteRelation();
+  }
+}
+
+void bench11_record_view_scan() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench11_record_view_scan" << std::endl;
+  createRelationForward(1000000);
+
+  // sums the key of every tuple, reading records as copies and as views
+  for (int views = 0; views < 2; views++) {
+    long long sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+      FileScan fscan(relationName, bufMgr);
+      RecordId scanRid;
+      try {
+        while (1) {
+          fscan.scanNext(scanRid);
+          int key;
+          if (views) {
+            memcpy(&key, fscan.getRecordView().data + offsetof(RECORD, i),
+                   sizeof(key));
+          } else {
+            std::string record = fscan.getRecord();
+            memcpy(&key, record.data() + offsetof(RECORD, i), sizeof(key));
+          }
+          sum += key;
+        }
+      } catch (EndOfFileException e) {
+      }
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(sum, 1000000LL * 999999 / 2);
+    std::cout << (views ? "views" : "copies") << ": " << elapsed.count() << "s"
+              << std::endl;
+  }
+  deleteRelation();
+}
+
+void bench12_record_updates() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench12_record_updates" << std::endl;
+  Page::stats().clear();
+
+  // resizes random records of a full page, deleting and reinserting some
+  Page page;
+  std::vector<RecordId> rids;
+  const std::string record(sizeof(RECORD), 'r');
+  while (page.hasSpaceForRecord(record))
+    rids.push_back(page.insertRecord(record));
+  srand(1);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 1000000; i++) {
+    const RecordId &rid = rids[rand() % rids.size()];
+    if (i % 4 == 0) {
+      const std::string old = page.getRecord(rid);
+      page.deleteRecord(rid);
+      page.insertRecord(old);
+    } else {
+      const std::size_t length = sizeof(RECORD) - 8 + rand() % 16;
+      try {
+        page.updateRecord(rid, std::string(length, 'u'));
+      } catch (InsufficientSpaceException e) {
+        page.updateRecord(rid, std::string(sizeof(RECORD) - 8, 'u'));
+      }
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "1000000 updates: " << elapsed.count() << "s, "
+            << Page::stats().compactions << " compactions reclaiming "
+            << Page::stats().reclaimedBytes << " bytes" << std::endl;
+}
+
+void bench13_slot_reuse() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench13_slot_reuse" << std::endl;
+
+  // deletes and reinserts random records of a page full of tiny records
+  Page page;
+  std::vector<RecordId> rids;
+  while (page.hasSpaceForRecord("t")) rids.push_back(page.insertRecord("t"));
+  srand(1);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 1000000; i++) {
+    RecordId &rid = rids[rand() % rids.size()];
+    page.deleteRecord(rid);
+    rid = page.insertRecord("t");
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << rids.size() << " slots, 1000000 reinserts: " << elapsed.count()
+            << "s" << std::endl;
+}
+
+void bench14_string_prefix_compression() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench14_string_prefix_compression" << std::endl;
+  deleteIndexFile();
+  createRelationItemIds(1000000);
+
+  const BuildMethod methods[] = {INSERT_BUILD, BULK_BUILD};
+  const char *names[] = {"insert build", "bulk build"};
+  for (int m = 0; m < 2; m++) {
+    {
+      BTreeIndex index(relationName, stringIndexName, bufMgr,
+                       offsetof(tuple, s), STRING, methods[m]);
+
+      // point lookups of random item ids
+      srand(1);
+      const int lookups = 200000;
+      int found = 0;
+      RecordId scanRid;
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < lookups; i++) {
+        char key[STRINGSIZE + 1];
+        sprintf(key, "%010d", 1043000000 + rand() % 1000000);
+        index.startScan(key, GTE, key, LTE);
+        index.scanNext(scanRid);
+        index.endScan();
+        found++;
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      checkPassFail(found, lookups);
+      std::cout << names[m] << ": " << elapsed.count() / lookups * 1e9
+                << "ns per lookup" << std::endl;
+    }
+
+    int height, numLeaves;
+    stringIndexShape(stringIndexName, height, numLeaves);
+    std::cout << names[m] << ": height " << height << ", " << numLeaves
+              << " leaves" << std::endl;
+    deleteIndexFile();
+  }
+  deleteRelation();
+}
+
+void bench15_int_node_search() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench15_int_node_search" << std::endl;
+
+  // searches of random keys in a full leaf of even keys
+  std::vector<int> keys(INTARRAYLEAFSIZE);
+  for (int i = 0; i < INTARRAYLEAFSIZE; i++) keys[i] = 2 * i;
+  std::vector<int> probes(1 << 16);
+  srand(1);
+  for (int &probe : probes) probe = rand() % (2 * INTARRAYLEAFSIZE + 2) - 1;
+
+  const int searches = 20000000;
+  long long sums[2] = {0, 0};
+  for (int simd = 0; simd < 2; simd++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < searches; i++) {
+      const int probe = probes[i & (probes.size() - 1)];
+      if (simd)
+        sums[simd] += searchIntArray(keys.data(), keys.size(), probe, i & 1);
+      else if (i & 1)
+        sums[simd] +=
+            std::lower_bound(keys.begin(), keys.end(), probe) - keys.begin();
+      else
+        sums[simd] +=
+            std::upper_bound(keys.begin(), keys.end(), probe) - keys.begin();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << (simd ? "searchIntArray" : "std::lower_bound") << ": "
+              << searches / elapsed.count() / 1e6 << " Msearches/s"
+              << std::endl;
+  }
+  checkPassFail(sums[1], sums[0]);
+
+  // point lookups on an index resident in the buffer pool
+  deleteIndexFile();
+  createRelationRandom(100000);
+  BufMgr *pool = new BufMgr(1000);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER);
+    const int lookups = 1000000;
+    int found = 0;
+    RecordId scanRid;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < lookups; i++) {
+      int key = probes[i & (probes.size() - 1)] * 100000 / INTARRAYLEAFSIZE / 2;
+      key = std::max(0, std::min(key, 99999));
+      index.startScan(&key, GTE, &key, LTE);
+      index.scanNext(scanRid);
+      index.endScan();
+      found++;
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(found, lookups);
+    std::cout << "point lookups: " << lookups / elapsed.count() / 1e6
+              << " Mlookups/s" << std::endl;
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench16_delete_vs_rebuild() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench16_delete_vs_rebuild" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 350000;
+  createRelationRandom(numRecords);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+  std::srand(3);
+  std::random_shuffle(entries.begin(), entries.end());
+
+  // removing a tenth of the tuples from the index in place
+  const int numDeletes = numRecords / 10;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numDeletes; i++)
+      index.deleteEntry(&entries[i].first, entries[i].second);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "delete " << numDeletes << " entries: " << elapsed.count()
+              << "s" << std::endl;
+
+    int low = 0, high = numRecords;
+    checkPassFail(countScan(&index, &low, GTE, &high, LT),
+                  numRecords - numDeletes);
+  }
+  deleteIndexFile();
+
+  // against dropping the index and building it again
+  auto start = std::chrono::steady_clock::now();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "rebuild: " << elapsed.count() << "s" << std::endl;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench17_concurrent_index() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench17_concurrent_index" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 200000;
+  createRelationRandom(numRecords);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+
+  // nine short range scans for every insert, on a pool holding the index
+  const int opsPerThread = 100000;
+  auto runOps = [&](BTreeIndex &index, unsigned t) {
+    std::vector<RecordId> rids;
+    unsigned seed = t + 1;
+    for (int op = 0; op < opsPerThread; op++) {
+      seed = seed * 1103515245 + 12345;
+      const auto &entry = entries[(seed >> 8) % entries.size()];
+      if (op % 10 == 0) {
+        index.insertEntry(&entry.first, entry.second);
+        continue;
+      }
+      int low = entry.first, high = entry.first + 10;
+      rids.clear();
+      index.scanRange(&low, GTE, &high, LT, rids);
+    }
+  };
+
+  BufMgr *pool = new BufMgr(4000, true);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER);
+    auto start = std::chrono::steady_clock::now();
+    runOps(index, 0);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "single-threaded index: " << opsPerThread / elapsed.count()
+              << " ops/s" << std::endl;
+  }
+  deleteIndexFile();
+
+  const unsigned maxThreads =
+      std::max(4u, std::thread::hardware_concurrency());
+  for (unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+      std::vector<std::thread> threads;
+      auto start = std::chrono::steady_clock::now();
+      for (unsigned t = 0; t < numThreads; t++)
+        threads.emplace_back([&, t]() { runOps(index, t); });
+      for (std::thread &thread : threads) thread.join();
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << numThreads << " threads: "
+                << numThreads * opsPerThread / elapsed.count() << " ops/s"
+                << std::endl;
+
+      int low = 0, high = numRecords;
+      checkPassFail(countScan(&index, &low, GTE, &high, LT),
+                    numRecords + (int)numThreads * opsPerThread / 10);
+    }
+    deleteIndexFile();
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench18_batched_scan() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench18_batched_scan" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 200000;
+  createRelationRandom(numRecords);
+
+  // a pool holding the whole index, so that only the scans are timed
+  BufMgr *pool = new BufMgr(1000);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER);
+    const int fullScans = 20;
+    const int shortScans = 100000;
+    RecordId rids[256];
+
+    auto start = std::chrono::steady_clock::now();
+    int numResults = 0;
+    for (int i = 0; i < fullScans; i++) {
+      int low = 0, high = numRecords;
+      numResults += countScan(&index, &low, GTE, &high, LT);
+    }
+    std::chrono::duration<double> oneAtATime =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(numResults, fullScans * numRecords);
+
+    start = std::chrono::steady_clock::now();
+    numResults = 0;
+    for (int i = 0; i < fullScans; i++) {
+      int low = 0, high = numRecords;
+      index.startScan(&low, GTE, &high, LT);
+      std::size_t numRids;
+      while ((numRids = index.scanNextBatch(rids, 256)) != 0)
+        numResults += numRids;
+      index.endScan();
+    }
+    std::chrono::duration<double> batched =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(numResults, fullScans * numRecords);
+    std::cout << fullScans << " full scans: scanNext " << oneAtATime.count()
+              << "s, scanNextBatch " << batched.count() << "s" << std::endl;
+
+    // scans of ten keys, where the exception ending each scan weighs most
+    start = std::chrono::steady_clock::now();
+    numResults = 0;
+    for (int i = 0; i < shortScans; i++) {
+      int low = (i * 7919) % (numRecords - 10), high = low + 10;
+      numResults += countScan(&index, &low, GTE, &high, LT);
+    }
+    oneAtATime = std::chrono::steady_clock::now() - start;
+    checkPassFail(numResults, 10 * shortScans);
+
+    start = std::chrono::steady_clock::now();
+    numResults = 0;
+    for (int i = 0; i < shortScans; i++) {
+      int low = (i * 7919) % (numRecords - 10), high = low + 10;
+      index.startScan(&low, GTE, &high, LT);
+      numResults += index.scanNextBatch(rids, 256);
+      index.endScan();
+    }
+    batched = std::chrono::steady_clock::now() - start;
+    checkPassFail(numResults, 10 * shortScans);
+    std::cout << shortScans << " short scans: scanNext " << oneAtATime.count()
+              << "s, scanNextBatch " << batched.count() << "s" << std::endl;
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench19_insert_batch() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench19_insert_batch" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 200000;
+  createRelationRandom(numRecords);
+  std::vector<std::pair<int, RecordId>> entries = relationEntries();
+  std::srand(6);
+  std::random_shuffle(entries.begin(), entries.end());
+  std::vector<int> keys;
+  std::vector<RecordId> rids;
+  for (const auto &entry : entries) {
+    keys.push_back(entry.first);
+    rids.push_back(entry.second);
+  }
+
+  // every entry added again to an index of the relation, one at a time and
+  // in batches of 4096
+  const std::size_t batchSize = 4096;
+  BufMgr *pool = new BufMgr(2000);
+  for (bool batched : {false, true}) {
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER);
+      pool->clearBufStats();
+      auto start = std::chrono::steady_clock::now();
+      if (batched) {
+        for (std::size_t i = 0; i < keys.size(); i += batchSize)
+          index.insertBatch(&keys[i], &rids[i],
+                            std::min(batchSize, keys.size() - i));
+      } else {
+        for (std::size_t i = 0; i < keys.size(); i++)
+          index.insertEntry(&keys[i], rids[i]);
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << (batched ? "insertBatch: " : "insertEntry: ")
+                << elapsed.count() << "s, buffer accesses "
+                << pool->getBufStats().accesses << std::endl;
+
+      int low = 0, high = numRecords;
+      checkPassFail(countScan(&index, &low, GTE, &high, LT), 2 * numRecords);
+    }
+    deleteIndexFile();
+  }
+  delete pool;
+  deleteRelation();
+}
+
+void bench20_point_lookup() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench20_point_lookup" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 200000;
+  createRelationRandom(numRecords);
+
+  // probes of random keys, a fifth of them missing from the index
+  const int numProbes = 500000;
+  std::vector<int> probes(numProbes);
+  std::srand(7);
+  for (int &probe : probes) probe = std::rand() % (numRecords * 5 / 4);
+  const int numFound = std::count_if(probes.begin(), probes.end(),
+                                     [](int key) { return key < numRecords; });
+
+  BufMgr *pool = new BufMgr(1000);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER);
+    auto report = [&](const char *name, std::chrono::duration<double> elapsed) {
+      std::cout << name << ": " << elapsed.count() * 1e9 / numProbes
+                << " ns per probe" << std::endl;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    int numResults = 0;
+    for (int key : probes)
+      numResults += countScan(&index, &key, GTE, &key, LTE);
+    report("equality scan", std::chrono::steady_clock::now() - start);
+    checkPassFail(numResults, numFound);
+
+    start = std::chrono::steady_clock::now();
+    numResults = 0;
+    RecordId found[8];
+    for (int key : probes) numResults += index.lookup(&key, found, 8);
+    report("lookup", std::chrono::steady_clock::now() - start);
+    checkPassFail(numResults, numFound);
+
+    // the probes of a join sorted on the key, as a merge would see them
+    std::vector<int> sorted = probes;
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<RecordId> rids;
+    std::vector<std::size_t> counts;
+    rids.reserve(numProbes);
+    counts.reserve(numProbes);
+    start = std::chrono::steady_clock::now();
+    index.lookupMany(sorted.data(), sorted.size(), rids, counts);
+    report("sorted lookupMany", std::chrono::steady_clock::now() - start);
+    checkPassFail((int)rids.size(), numFound);
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench21_descending_top_k() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench21_descending_top_k" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 200000;
+  createRelationRandom(numRecords);
+
+  // the ten largest keys below a random bound, as ORDER BY key DESC LIMIT 10
+  const int numQueries = 200;
+  const int k = 10;
+  std::vector<int> bounds(numQueries);
+  std::srand(8);
+  for (int &bound : bounds) bound = k + std::rand() % (numRecords - k);
+
+  BufMgr *pool = new BufMgr(1000);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER);
+    RecordId rids[256];
+
+    // an ascending scan of the whole range, keeping the last k entries
+    pool->clearBufStats();
+    auto start = std::chrono::steady_clock::now();
+    int wrong = 0;
+    std::vector<RecordId> tail;
+    for (int high : bounds) {
+      int low = 0;
+      index.startScan(&low, GTE, &high, LT);
+      std::size_t numRids;
+      tail.clear();
+      while ((numRids = index.scanNextBatch(rids, 256)) != 0) {
+        tail.insert(tail.end(), rids, rids + numRids);
+        if (tail.size() > (std::size_t)k)
+          tail.erase(tail.begin(), tail.end() - k);
+      }
+      index.endScan();
+      wrong += tail.size() != (std::size_t)k;
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(wrong, 0);
+    std::cout << "ascending scan: " << elapsed.count() * 1e6 / numQueries
+              << "us and " << pool->getBufStats().accesses / numQueries
+              << " buffer accesses per query" << std::endl;
+
+    pool->clearBufStats();
+    start = std::chrono::steady_clock::now();
+    for (int high : bounds) {
+      int low = 0;
+      IndexScanCursor cursor =
+          index.openScan(&low, GTE, &high, LT, NORMAL_ACCESS, DESCENDING);
+      wrong += cursor.scanNextBatch(rids, k) != (std::size_t)k;
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    checkPassFail(wrong, 0);
+    std::cout << "descending scan: " << elapsed.count() * 1e6 / numQueries
+              << "us and " << pool->getBufStats().accesses / numQueries
+              << " buffer accesses per query" << std::endl;
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench22_posting_lists() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench22_posting_lists" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 1000000;
+  const int numCategories = 100;
+  createRelationCategories(numRecords, numCategories);
+
+  // a concurrent index keeps the duplicates of each key in its leaves, and
+  // serves as the baseline
+  BufMgr *pool = new BufMgr(1000, true);
+  const bool concurrent[] = {true, false};
+  const char *names[] = {"leaf entries", "posting lists"};
+  for (int m = 0; m < 2; m++) {
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR,
+                       concurrent[m]);
+
+      // full scans, and scans of a single key
+      RecordId rids[256];
+      int low = 0, high = numCategories;
+      std::size_t total = 0;
+      pool->clearBufStats();
+      auto start = std::chrono::steady_clock::now();
+      for (int r = 0; r < 10; r++) {
+        index.startScan(&low, GTE, &high, LT);
+        std::size_t numRids;
+        while ((numRids = index.scanNextBatch(rids, 256)) != 0)
+          total += numRids;
+        index.endScan();
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      checkPassFail(total, 10u * numRecords);
+      std::cout << names[m] << " full scan: " << elapsed.count() * 1e3 / 10
+                << "ms and " << pool->getBufStats().accesses / 10
+                << " buffer accesses" << std::endl;
+
+      total = 0;
+      start = std::chrono::steady_clock::now();
+      for (int key = 0; key < numCategories; key++) {
+        index.startScan(&key, GTE, &key, LTE);
+        std::size_t numRids;
+        while ((numRids = index.scanNextBatch(rids, 256)) != 0)
+          total += numRids;
+        index.endScan();
+      }
+      elapsed = std::chrono::steady_clock::now() - start;
+      checkPassFail(total, (std::size_t)numRecords);
+      std::cout << names[m] << " key scan: "
+                << elapsed.count() * 1e6 / numCategories << "us per key"
+                << std::endl;
+    }
+    std::ifstream indexFile(intIndexName, std::ios::binary | std::ios::ate);
+    std::cout << names[m] << " index size: " << indexFile.tellg() / Page::SIZE
+              << " pages" << std::endl;
+    deleteIndexFile();
+  }
+  delete pool;
+  deleteRelation();
+}
+
+void bench23_covering_index() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench23_covering_index" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 1000000;
+  createRelationRandom(numRecords);
+
+  // the sum of the d column over ranges of one percent of the keys, as
+  // SELECT SUM(d) WHERE i BETWEEN low AND high
+  const int numQueries = 50;
+  const int width = numRecords / 100;
+  std::vector<int> lows(numQueries);
+  std::srand(9);
+  for (int &low : lows) low = std::rand() % (numRecords - width);
+  double expected = 0;
+  for (int low : lows) expected += (double)width * (2 * low + width - 1) / 2;
+
+  const std::vector<CoveredColumn> columns = {{offsetof(tuple, d), 8}};
+  const char *names[] = {"record fetch", "covered column"};
+  for (int m = 0; m < 2; m++) {
+    {
+      BTreeIndex index(
+          relationName, intIndexName, bufMgr, offsetof(tuple, i), INTEGER,
+          BULK_BUILD, DEFAULT_FILL_FACTOR, false,
+          m == 0 ? std::vector<CoveredColumn>() : columns);
+      PageFile relation(relationName, false);
+      RecordId rids[256];
+      double ds[256];
+      double sum = 0;
+
+      bufMgr->clearBufStats();
+      auto start = std::chrono::steady_clock::now();
+      for (int low : lows) {
+        int high = low + width - 1;
+        index.startScan(&low, GTE, &high, LTE);
+        std::size_t numRids;
+        while ((numRids = index.scanNextBatch(rids, 256, (char *)ds)) != 0) {
+          for (std::size_t j = 0; j < numRids; j++) {
+            if (m == 1) {
+              sum += ds[j];
+              continue;
+            }
+            Page *page;
+            bufMgr->readPage(&relation, rids[j].page_number, page);
+            const RECORD *record =
+                (const RECORD *)page->getRecordView(rids[j]).data;
+            sum += record->d;
+            bufMgr->unPinPage(&relation, rids[j].page_number, false);
+          }
+        }
+        index.endScan();
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      checkPassFail(sum, expected);
+      std::cout << names[m] << ": " << elapsed.count() * 1e3 / numQueries
+                << "ms and " << bufMgr->getBufStats().diskreads / numQueries
+                << " disk reads per query" << std::endl;
+      bufMgr->flushFile(&relation);
+    }
+    std::ifstream indexFile(intIndexName, std::ios::binary | std::ios::ate);
+    std::cout << names[m] << " index size: " << indexFile.tellg() / Page::SIZE
+              << " pages" << std::endl;
+    deleteIndexFile();
+  }
+  deleteRelation();
+}
+
+void bench24_composite_keys() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench24_composite_keys" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 1000000;
+  const int numSellers = 1000;
+  const int perSeller = numRecords / numSellers;
+  createRelationSellers(numRecords, numSellers);
+
+  // the records of a seller within one percent of its ranks, as
+  // SELECT * WHERE i = seller AND d >= low AND d < high
+  const int numQueries = 200;
+  const int width = perSeller / 100;
+  std::vector<std::pair<int, int>> queries(numQueries);
+  std::srand(11);
+  for (auto &query : queries)
+    query = std::make_pair(std::rand() % numSellers,
+                           std::rand() % (perSeller - width));
+
+  const char *names[] = {"seller index and filter", "composite index"};
+  for (int m = 0; m < 2; m++) {
+    {
+      BTreeIndex *index =
+          m == 0 ? new BTreeIndex(relationName, intIndexName, bufMgr,
+                                  offsetof(tuple, i), INTEGER)
+                 : new BTreeIndex(relationName, intIndexName, bufMgr,
+                                  {{offsetof(tuple, i), INTEGER},
+                                   {offsetof(tuple, d), DOUBLE}});
+      PageFile relation(relationName, false);
+      RecordId rids[256];
+      std::size_t found = 0;
+
+      bufMgr->clearBufStats();
+      auto start = std::chrono::steady_clock::now();
+      for (const auto &query : queries) {
+        int seller = query.first;
+        const double low = query.second, high = query.second + width;
+        char lowKey[12], highKey[12];
+        memcpy(lowKey, &seller, 4);
+        memcpy(lowKey + 4, &low, 8);
+        memcpy(highKey, &seller, 4);
+        memcpy(highKey + 4, &high, 8);
+        if (m == 0)
+          index->startScan(&seller, GTE, &seller, LTE);
+        else
+          index->startScan(lowKey, GTE, highKey, LT);
+        std::size_t numRids;
+        while ((numRids = index->scanNextBatch(rids, 256)) != 0) {
+          for (std::size_t j = 0; j < numRids; j++) {
+            Page *page;
+            bufMgr->readPage(&relation, rids[j].page_number, page);
+            const RECORD *record =
+                (const RECORD *)page->getRecordView(rids[j]).data;
+            found += record->d >= low && record->d < high;
+            bufMgr->unPinPage(&relation, rids[j].page_number, false);
+          }
+        }
+        index->endScan();
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      checkPassFail(found, (std::size_t)numQueries * width);
+      std::cout << names[m] << ": " << elapsed.count() * 1e3 / numQueries
+                << "ms and " << bufMgr->getBufStats().diskreads / numQueries
+                << " disk reads per query" << std::endl;
+      bufMgr->flushFile(&relation);
+      delete index;
+    }
+    deleteIndexFile();
+  }
+  deleteRelation();
+}
+
+void bench25_parallel_build() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench25_parallel_build" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 1000000;
+  createRelationRandom(numRecords);
+  std::cout << std::thread::hardware_concurrency() << " cores" << std::endl;
+
+  BufMgr *pool = new BufMgr(4000, true);
+  const int threadCounts[] = {1, 4, 16, 32};
+  for (int numThreads : threadCounts) {
+    {
+      auto start = std::chrono::steady_clock::now();
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, false, {},
+                       numThreads);
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << numThreads << " threads: " << elapsed.count() * 1e3
+                << "ms" << std::endl;
+
+      int low = 0, high = numRecords;
+      checkPassFail(countScan(&index, &low, GTE, &high, LT), numRecords);
+    }
+    deleteIndexFile();
+  }
+  delete pool;
+  deleteRelation();
+}
+
+void bench26_parallel_scan() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench26_parallel_scan" << std::endl;
+  const int numRecords = 1000000;
+  createRelationForward(numRecords);
+  BufMgr *pool = new BufMgr(4000, true);
+
+  // sums the key of every tuple, on one FileScan and on parallel scans
+  long long want = (long long)numRecords * (numRecords - 1) / 2;
+  {
+    long long sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+      FileScan fscan(relationName, pool);
+      RecordId scanRid;
+      try {
+        while (1) {
+          fscan.scanNext(scanRid);
+          sum += ((const RECORD *)fscan.getRecordView().data)->i;
+        }
+      } catch (EndOfFileException e) {
+      }
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(sum, want);
+    std::cout << "FileScan: " << elapsed.count() * 1e3 << "ms" << std::endl;
+  }
+
+  const int workerCounts[] = {1, 4, 16, 32};
+  for (int numWorkers : workerCounts) {
+    std::vector<long long> sums(numWorkers);
+    auto start = std::chrono::steady_clock::now();
+    std::size_t steals;
+    {
+      ParallelFileScan scan(relationName, pool, numWorkers);
+      scan.run([&](ParallelFileScan::Worker &worker) {
+        long long sum = 0;
+        RecordId rid;
+        try {
+          while (1) {
+            worker.scanNext(rid);
+            sum += ((const RECORD *)worker.getRecordView().data)->i;
+          }
+        } catch (EndOfFileException e) {
+        }
+        sums[worker.id()] = sum;
+      });
+      steals = scan.numSteals();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    long long sum = 0;
+    for (long long part : sums) sum += part;
+    checkPassFail(sum, want);
+    std::cout << numWorkers << " workers: " << elapsed.count() * 1e3
+              << "ms, " << steals << " steals" << std::endl;
+  }
+  delete pool;
+  deleteRelation();
+}
+
+void bench27_filtered_scan() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench27_filtered_scan" << std::endl;
+  const int numRecords = 1000000;
+  createRelationRandom(numRecords);
+
+  // SELECT * WHERE i >= low AND d < high, at a few selectivities, filtered by
+  // the caller on a copy of every record and by the scan on the page
+  const int percents[] = {1, 10, 50};
+  for (int percent : percents) {
+    const int low = numRecords / 4;
+    const double high = low + numRecords / 100 * percent;
+    const int want = numRecords / 100 * percent;
+    for (int pushed = 0; pushed < 2; pushed++) {
+      int found = 0;
+      auto start = std::chrono::steady_clock::now();
+      {
+        std::vector<ScanPredicate> predicates;
+        if (pushed) {
+          predicates.push_back({offsetof(tuple, i), INTEGER, GTE, &low});
+          predicates.push_back({offsetof(tuple, d), DOUBLE, LT, &high});
+        }
+        FileScan fscan(relationName, bufMgr, predicates);
+        try {
+          RecordId scanRid;
+          while (1) {
+            fscan.scanNext(scanRid);
+            if (pushed) {
+              found++;
+              continue;
+            }
+            std::string record = fscan.getRecord();
+            const RECORD *r = (const RECORD *)record.data();
+            found += r->i >= low && r->d < high;
+          }
+        } catch (EndOfFileException e) {
+        }
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      checkPassFail(found, want);
+      std::cout << percent << "% selected, "
+                << (pushed ? "filtered by the scan: " : "filtered by caller: ")
+                << elapsed.count() * 1e3 << "ms" << std::endl;
+    }
+  }
+  deleteRelation();
+}
+
+void bench28_heap_fetch() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench28_heap_fetch" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 1000000;
+  createRelationRandom(numRecords);
+
+  // SELECT * WHERE low <= i < high through an index on i, whose record ids
+  // are scattered over the relation, resolved one record id at a time and by
+  // fetching the records page by page
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    const int widths[] = {1000, 10000, 100000};
+    for (int width : widths) {
+      int low = numRecords / 3, high = low + width;
+      std::vector<RecordId> rids = scanRids(&index, &low, GTE, &high, LT);
+      const char *names[] = {"one at a time", "page order", "key order"};
+      for (int m = 0; m < 3; m++) {
+        long long sum = 0;
+        bufMgr->clearBufStats();
+        auto start = std::chrono::steady_clock::now();
+        if (m == 0) {
+          PageFile relation(relationName, false);
+          for (const RecordId &rid : rids) {
+            Page *page;
+            bufMgr->readPage(&relation, rid.page_number, page);
+            sum += ((const RECORD *)page->getRecordView(rid).data)->i;
+            bufMgr->unPinPage(&relation, rid.page_number, false);
+          }
+          bufMgr->flushFile(&relation);
+        } else {
+          HeapFetch fetch(relationName, bufMgr);
+          fetch.fetch(rids,
+                      [&](const RecordId &, const RecordView &record) {
+                        sum += ((const RECORD *)record.data)->i;
+                      },
+                      m == 1 ? PAGE_ORDER : GIVEN_ORDER);
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        checkPassFail(sum, (long long)width * (2 * low + width - 1) / 2);
+        std::cout << width << " records, " << names[m] << ": "
+                  << elapsed.count() * 1e3 << "ms, "
+                  << bufMgr->getBufStats().accesses << " page accesses, "
+                  << bufMgr->getBufStats().diskreads << " disk reads"
+                  << std::endl;
+      }
+    }
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench29_joins() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench29_joins" << std::endl;
+  deleteIndexFile();
+  const int numItems = 200000;
+  createRelationRandom(numItems);
+  const std::string bidsName = "relB";
+  createRelationBids(bidsName, 1000000, numItems);
+
+  // SELECT * FROM bids JOIN items ON bids.itemId = items.itemId: a lookup per
+  // bid, lookups a sorted batch of bids at a time, and a merge of the scans
+  // of an index on each side
+  BufMgr *pool = new BufMgr(4000);
+  std::string itemsName, bidsIndexName;
+  {
+    BTreeIndex items(relationName, itemsName, pool, offsetof(tuple, i),
+                     INTEGER);
+    std::vector<JoinPair> pairs(1024);
+    const int numBids = 1000000;
+    for (int m = 0; m < 2; m++) {
+      std::size_t numPairs = 0;
+      auto start = std::chrono::steady_clock::now();
+      if (m == 0) {
+        FileScan scan(bidsName, pool);
+        RecordId bidRid, itemRid;
+        try {
+          while (1) {
+            scan.scanNext(bidRid);
+            const int key = ((const RECORD *)scan.getRecordView().data)->i;
+            numPairs += items.lookup(&key, &itemRid, 1);
+          }
+        } catch (EndOfFileException e) {
+        }
+      } else {
+        IndexNestedLoopJoin join(bidsName, {{offsetof(tuple, i), INTEGER}},
+                                 &items, pool);
+        std::size_t n;
+        while ((n = join.next(pairs.data(), pairs.size())) > 0) numPairs += n;
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      checkPassFail(numPairs, (std::size_t)numBids);
+      std::cout << (m == 0 ? "lookup per bid: " : "index nested loop: ")
+                << elapsed.count() * 1e3 << "ms" << std::endl;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    BTreeIndex bids(bidsName, bidsIndexName, pool, offsetof(tuple, i),
+                    INTEGER);
+    std::chrono::duration<double> built =
+        std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    int low = 0, high = numItems;
+    SortMergeJoin join(&bids, &items, &low, GTE, &high, LT);
+    std::size_t numPairs = 0, n;
+    while ((n = join.next(pairs.data(), pairs.size())) > 0) numPairs += n;
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(numPairs, (std::size_t)numBids);
+    std::cout << "sort-merge: " << elapsed.count() * 1e3 << "ms, after "
+              << built.count() * 1e3 << "ms building the index of bids"
+              << std::endl;
+  }
+  delete pool;
+  File::remove(itemsName);
+  File::remove(bidsIndexName);
+  File::remove(bidsName);
+  deleteRelation();
+}
+
+void bench30_tuple_batches() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench30_tuple_batches" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 1000000;
+  createRelationRandom(numRecords);
+
+  // SELECT COUNT(*), SUM(d) WHERE i >= low AND i < high, evaluated on a copy
+  // of each record, on a view of each record, and on batches of records
+  const int low = numRecords / 4, high = 3 * numRecords / 4;
+  const char *names[] = {"record copies", "record views", "tuple batches"};
+  for (int m = 0; m < 3; m++) {
+    std::size_t count = 0;
+    double sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    FileScan scan(relationName, bufMgr);
+    if (m < 2) {
+      RecordId rid;
+      try {
+        while (1) {
+          scan.scanNext(rid);
+          RECORD record;
+          if (m == 0) {
+            const std::string copy = scan.getRecord();
+            memcpy(&record, copy.data(), sizeof(RECORD));
+          } else {
+            memcpy(&record, scan.getRecordView().data, sizeof(RECORD));
+          }
+          if (record.i >= low && record.i < high) {
+            count++;
+            sum += record.d;
+          }
+        }
+      } catch (EndOfFileException e) {
+      }
+    } else {
+      TupleBatch batch({{offsetof(tuple, i), INTEGER},
+                        {offsetof(tuple, d), DOUBLE}});
+      while (scan.nextBatch(batch) > 0) {
+        batch.filter(0, GTE, &low);
+        batch.filter(0, LT, &high);
+        count += batch.numSelected();
+        sum += batch.sumDouble(1);
+      }
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(count, (std::size_t)(high - low));
+    checkPassFail(sum, (double)(high - low) * (low + high - 1) / 2);
+    std::cout << names[m] << ": " << elapsed.count() * 1e3 << "ms"
+              << std::endl;
+  }
+  deleteRelation();
+}
+
+void bench31_hash_aggregate() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench31_hash_aggregate" << std::endl;
+  deleteIndexFile();
+  const std::string bidsName = "relB";
+  const int numBids = 1000000;
+  const std::vector<KeyColumn> columns = {{offsetof(tuple, i), INTEGER},
+                                          {offsetof(tuple, d), DOUBLE}};
+
+  // SELECT i, COUNT(*), MAX(d) GROUP BY i, into a std::map fed by records and
+  // by a hash aggregate fed by batches, with the groups in memory and with
+  // room for a tenth of them
+  const int itemCounts[] = {1000, 100000};
+  for (int numItems : itemCounts) {
+    createRelationBids(bidsName, numBids, numItems);
+    for (int m = 0; m < 3; m++) {
+      std::size_t numGroups = 0, spilled = 0;
+      auto start = std::chrono::steady_clock::now();
+      if (m == 0) {
+        std::map<int, std::pair<std::int64_t, double>> groups;
+        FileScan scan(bidsName, bufMgr);
+        RecordId rid;
+        try {
+          while (1) {
+            scan.scanNext(rid);
+            const RECORD *record = (const RECORD *)scan.getRecordView().data;
+            auto &g = groups.emplace(record->i, std::make_pair(0, record->d))
+                          .first->second;
+            g.first++;
+            g.second = std::max(g.second, record->d);
+          }
+        } catch (EndOfFileException e) {
+        }
+        numGroups = groups.size();
+      } else {
+        HashAggregate aggregate(columns, 0, {{COUNT, 0}, {MAX, 1}}, bufMgr,
+                                "relB.agg",
+                                m == 1 ? 65536 * 4 : numItems / 10);
+        FileScan scan(bidsName, bufMgr);
+        TupleBatch batch(columns);
+        while (scan.nextBatch(batch) > 0) aggregate.consume(batch);
+        aggregate.finish([&](const void *, const AggregateValue *) {
+          numGroups++;
+        });
+        spilled = aggregate.numSpilledRows();
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      const bool fewer = numGroups <= (std::size_t)numItems;
+      checkPassFail(fewer, true);
+      const char *names[] = {"std::map", "hash aggregate",
+                             "hash aggregate, a tenth in memory"};
+      std::cout << numItems << " items, " << names[m] << ": "
+                << elapsed.count() * 1e3 << "ms, " << numGroups
+                << " groups, " << spilled << " rows spilled" << std::endl;
+    }
+  }
+  File::remove(bidsName);
+}
+
+void bench32_external_sort() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench32_external_sort" << std::endl;
+  deleteIndexFile();
+  const std::string bidsName = "relB";
+  const int numBids = 100000, numItems = 100000;
+  createRelationBids(bidsName, numBids, numItems);
+  std::vector<RECORD> records;
+  {
+    FileScan scan(bidsName, bufMgr);
+    RecordId rid;
+    try {
+      while (1) {
+        scan.scanNext(rid);
+        records.push_back(*(const RECORD *)scan.getRecordView().data);
+      }
+    } catch (EndOfFileException e) {
+    }
+  }
+
+  // ORDER BY i of ten times as many pages as the pool has, in memory, and
+  // through a pool of 100 frames with a buffer of 32 and of 8 pages, read
+  // ahead by its threads or not
+  const std::size_t memoryPages[] = {0, 32, 32, 8, 8};
+  for (int m = 0; m < 5; m++) {
+    const bool readAhead = m % 2 == 1;
+    BufMgr *pool = new BufMgr(100, readAhead);
+    if (readAhead) pool->setPrefetchDepth(2);
+    std::size_t runs = 0, passes = 0, n = 0;
+    bool sorted = true;
+    int last = std::numeric_limits<int>::min();
+    auto start = std::chrono::steady_clock::now();
+    if (m == 0) {
+      std::vector<RECORD> copy = records;
+      std::stable_sort(copy.begin(), copy.end(),
+                       [](const RECORD &a, const RECORD &b) {
+                         return a.i < b.i;
+                       });
+      for (const RECORD &record : copy) {
+        sorted &= last <= record.i;
+        last = record.i;
+        n++;
+      }
+    } else {
+      ExternalSort sort(sizeof(RECORD), {{offsetof(tuple, i), INTEGER}}, pool,
+                        "relB.sort", memoryPages[m]);
+      for (const RECORD &record : records) sort.add(&record);
+      while (const char *row = sort.next()) {
+        const int i = ((const RECORD *)row)->i;
+        sorted &= last <= i;
+        last = i;
+        n++;
+      }
+      runs = sort.numRuns();
+      passes = sort.numMergePasses();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    delete pool;
+    checkPassFail(sorted, true);
+    checkPassFail(n, records.size());
+    std::cout << (m == 0 ? "std::stable_sort" : "external sort") << ", "
+              << memoryPages[m] << " pages"
+              << (readAhead ? ", read ahead" : "") << ": "
+              << elapsed.count() * 1e3 << "ms, " << runs << " runs, "
+              << passes << " merge passes" << std::endl;
+  }
+  File::remove(bidsName);
+}
+
+void bench33_statistics() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench33_statistics" << std::endl;
+  deleteIndexFile();
+  const std::string bidsName = "relB";
+  const int numBids = 1000000, numItems = 100000;
+  createRelationBids(bidsName, numBids, numItems);
+
+  // the selectivities of ranges of items, counted by a scan of every record
+  // and estimated from histograms of samples of a hundredth and a thousandth
+  // of the pages
+  const int ranges[][2] = {{0, 100}, {0, 1000}, {20000, 70000}};
+  double exact[3] = {};
+  {
+    auto start = std::chrono::steady_clock::now();
+    FileScan scan(bidsName, bufMgr);
+    RecordId rid;
+    try {
+      while (1) {
+        scan.scanNext(rid);
+        const int i = ((const RECORD *)scan.getRecordView().data)->i;
+        for (int r = 0; r < 3; r++)
+          exact[r] += i >= ranges[r][0] && i < ranges[r][1];
+      }
+    } catch (EndOfFileException e) {
+    }
+    for (int r = 0; r < 3; r++) exact[r] /= numBids;
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "scan: " << elapsed.count() * 1e3 << "ms; selectivity "
+              << exact[0] << " " << exact[1] << " " << exact[2] << std::endl;
+  }
+  const std::size_t numPages = PageFile(bidsName, false).getNumPages();
+  const std::size_t fractions[] = {100, 1000};
+  for (std::size_t fraction : fractions) {
+    auto start = std::chrono::steady_clock::now();
+    RelationSample sample(bidsName, bufMgr, 10000, numPages / fraction);
+    EquiDepthHistogram histogram(sample.intValues(offsetof(tuple, i)), 100);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "1/" << fraction << " of the pages: "
+              << elapsed.count() * 1e3 << "ms, "
+              << sample.getRecords().size() << " records sampled, "
+              << sample.estimatedRecords() << " estimated; selectivity";
+    for (int r = 0; r < 3; r++)
+      std::cout << " "
+                << histogram.selectivity(ranges[r][0], GTE, ranges[r][1], LT);
+    std::cout << std::endl;
+    const bool close = std::abs(histogram.selectivity(20000, GTE, 70000, LT) -
+                                exact[2]) < 0.05;
+    checkPassFail(close, true);
+  }
+
+  // the statistics of an index on the items
+  std::string indexName;
+  {
+    BTreeIndex index(bidsName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    auto start = std::chrono::steady_clock::now();
+    const IndexStats stats = index.getStats();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(stats.numEntries, (std::size_t)numBids);
+    std::cout << "index statistics: " << elapsed.count() * 1e3 << "ms, height "
+              << stats.height << ", " << stats.numLeaves << " leaves, "
+              << stats.distinctKeys << " keys, fill factor "
+              << stats.fillFactor << std::endl;
+  }
+  File::remove(indexName);
+  File::remove(bidsName);
+}
+
+void bench34_limit_scans() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench34_limit_scans" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 200000;
+  createRelationRandom(numRecords);
+
+  const int numQueries = 200;
+  const int k = 10;
+  const int width = 10000;
+  std::vector<int> bounds(numQueries);
+  std::srand(9);
+  for (int &bound : bounds) bound = std::rand() % (numRecords - width);
+
+  BufMgr *pool = new BufMgr(1000);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER);
+    RecordId rids[256];
+    int keys[256];
+
+    // WHERE key >= x AND key < x + width LIMIT k, by scanning the range until
+    // it throws and keeping the first k entries, and by a limited scan
+    const char *limitNames[] = {"scan to the end of the range",
+                                "limited scan"};
+    for (int m = 0; m < 2; m++) {
+      pool->clearBufStats();
+      auto start = std::chrono::steady_clock::now();
+      int wrong = 0;
+      for (int low : bounds) {
+        const int high = low + width;
+        if (m == 0) {
+          index.startScan(&low, GTE, &high, LT);
+          std::size_t n = 0;
+          RecordId rid;
+          try {
+            while (1) {
+              index.scanNext(rid);
+              if (n < (std::size_t)k) rids[n] = rid;
+              n++;
+            }
+          } catch (IndexScanCompletedException e) {
+          }
+          index.endScan();
+          wrong += n < (std::size_t)k;
+        } else {
+          IndexScanCursor cursor = index.openScan(&low, GTE, &high, LT);
+          cursor.setLimit(k);
+          wrong += cursor.scanNextBatch(rids, 256) != (std::size_t)k;
+        }
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      checkPassFail(wrong, 0);
+      std::cout << "LIMIT " << k << ", " << limitNames[m] << ": "
+                << elapsed.count() * 1e6 / numQueries << "us and "
+                << pool->getBufStats().accesses / numQueries
+                << " buffer accesses per query" << std::endl;
+    }
+
+    // numPages pages of pageSize entries from x: each by OFFSET on a new
+    // scan, by a new limit on the same cursor, by a new scan from the last
+    // key of the page before, and by a seek of the same cursor to that key
+    const int pageSize = 100, numPages = 50;
+    const char *pageNames[] = {"OFFSET", "same cursor", "new scan from key",
+                               "seek to key"};
+    for (int m = 0; m < 4; m++) {
+      pool->clearBufStats();
+      auto start = std::chrono::steady_clock::now();
+      int wrong = 0;
+      for (int low : bounds) {
+        IndexScanCursor cursor;
+        int from = low;
+        for (int page = 0; page < numPages; page++) {
+          if (m == 0) {
+            cursor = index.openScanFrom(&low);
+            cursor.skip(page * pageSize);
+          } else if (page == 0 || m == 2) {
+            cursor = index.openScanFrom(&from);
+          } else if (m == 3) {
+            cursor.seek(&from);
+          }
+          cursor.setLimit(pageSize);
+          const std::size_t n = cursor.scanNextBatch(rids, 256, NULL, keys);
+          wrong += n != (std::size_t)pageSize;
+          from = keys[n - 1] + 1;
+        }
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      checkPassFail(wrong, 0);
+      std::cout << numPages << " pages of " << pageSize << ", "
+                << pageNames[m] << ": "
+                << elapsed.count() * 1e6 / numQueries << "us and "
+                << pool->getBufStats().accesses / numQueries
+                << " buffer accesses per query" << std::endl;
+    }
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench35_wal() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench35_wal" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 100000;
+  createRelationRandom(numRecords);
+  const std::string logName = "relA.log";
+  LogManager::remove(logName);
+  { BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER); }
+
+  // insertions into the index through a pool of 1000 pages, each run with
+  // keys of its own past those of the relation; the index is closed, writing
+  // its pages out, within the time
+  struct Run {
+    const char *name;
+    std::uint32_t commitGroup;
+    int numInserts;
+  };
+  const Run runs[] = {{"no log", 0, 20000},
+                      {"log, every commit forced", 1, 500},
+                      {"log, 32 commits per force", 32, 20000},
+                      {"log, 1024 commits per force", 1024, 20000}};
+  int nextKey = numRecords;
+  for (const Run &run : runs) {
+    std::unique_ptr<LogManager> log;
+    if (run.commitGroup > 0)
+      log.reset(new LogManager(logName, run.commitGroup));
+    BufMgr *pool = new BufMgr(1000);
+    pool->setLog(log.get());
+    auto start = std::chrono::steady_clock::now();
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER);
+      for (int k = 0; k < run.numInserts; k++, nextKey++) {
+        RecordId rid;
+        rid.page_number = 1 + nextKey / 100;
+        rid.slot_number = nextKey % 100 + 1;
+        index.insertEntry(&nextKey, rid);
+      }
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << run.name << ": " << elapsed.count() * 1e6 / run.numInserts
+              << "us per insertion";
+    if (log) {
+      const LogStats &stats = log->getLogStats();
+      std::cout << ", " << stats.flushes << " forces, "
+                << (double)stats.bytes / run.numInserts
+                << " bytes logged per insertion";
+    }
+    std::cout << std::endl;
+    delete pool;
+  }
+
+  // the log of the last run is redone as after a crash, and compared with
+  // building the index again
+  {
+    auto start = std::chrono::steady_clock::now();
+    LogManager log(logName);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "redo of " << log.numRedone()
+              << " page records: " << elapsed.count() * 1e3 << "ms"
+              << std::endl;
+  }
+  {
+    File::remove(intIndexName);
+    BufMgr *pool = new BufMgr(1000);
+    auto start = std::chrono::steady_clock::now();
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "bulk build of " << numRecords
+              << " entries: " << elapsed.count() * 1e3 << "ms" << std::endl;
+    delete pool;
+  }
+  LogManager::remove(logName);
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench36_fuzzy_checkpoint() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench36_fuzzy_checkpoint" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 100000, numInserts = 50000;
+  createRelationRandom(numRecords);
+  const std::string logName = "relA.log";
+
+  // insertions of keys spread over the index through a pool of 1000 pages
+  // with a log, 64 commits per force.  The times of the insertions include
+  // the checkpoints taken in the foreground.  The log left when the
+  // insertions end is then redone, as it would be after a crash.
+  struct Run {
+    const char *name;
+    int checkpointEvery;
+    std::uint32_t pagesPerSecond;
+  };
+  const Run runs[] = {{"no checkpoints", 0, 0},
+                      {"checkpoint every 10000 insertions", 10000, 0},
+                      {"background checkpointer, 20000 pages/s", 0, 20000}};
+  for (const Run &run : runs) {
+    if (File::exists(intIndexName)) File::remove(intIndexName);
+    LogManager::remove(logName);
+    { BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                       INTEGER); }
+    LogManager *log = new LogManager(logName, 64, 1 << 20);
+    BufMgr *pool = new BufMgr(1000, true);
+    pool->setLog(log);
+    pool->startCheckpointer(run.pagesPerSecond, 250);
+    std::vector<double> times;
+    times.reserve(numInserts);
+    std::size_t logSize = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER);
+      for (int k = 0; k < numInserts; k++) {
+        const auto before = std::chrono::steady_clock::now();
+        const int key = (int)((std::int64_t)k * 7919 % numRecords);
+        RecordId rid;
+        rid.page_number = 1 + k / 100;
+        rid.slot_number = k % 100 + 1;
+        index.insertEntry(&key, rid);
+        if (run.checkpointEvery > 0 && (k + 1) % run.checkpointEvery == 0)
+          pool->checkpoint();
+        const std::chrono::duration<double> took =
+            std::chrono::steady_clock::now() - before;
+        times.push_back(took.count());
+      }
+      for (const std::string &name : LogManager::segmentNames(logName)) {
+        std::ifstream segment(name, std::ios::binary | std::ios::ate);
+        logSize += segment.tellg();
+      }
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    const std::uint64_t logged = log->getLogStats().bytes;
+    delete pool;
+    delete log;
+
+    start = std::chrono::steady_clock::now();
+    std::size_t redone;
+    {
+      LogManager recovered(logName);
+      redone = recovered.numRedone();
+    }
+    std::chrono::duration<double> recovery =
+        std::chrono::steady_clock::now() - start;
+    std::sort(times.begin(), times.end());
+    std::cout << run.name << ": " << elapsed.count() * 1e6 / numInserts
+              << "us per insertion, 99.9th percentile "
+              << times[times.size() * 999 / 1000] * 1e3 << "ms, worst "
+              << times.back() * 1e3 << "ms; "
+              << logged / (1 << 20) << "MB logged, " << logSize / (1 << 20)
+              << "MB left, " << redone << " records redone in "
+              << recovery.count() * 1e3 << "ms" << std::endl;
+  }
+  LogManager::remove(logName);
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench37_page_checksums() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench37_page_checksums" << std::endl;
+  const std::string fileName = relationName + ".blob";
+  if (File::exists(fileName)) File::remove(fileName);
+
+  // the checksum of one page, as computed on every write and verified read
+  {
+    Page page;
+    memset(reinterpret_cast<char *>(&page), 7, Page::SIZE);
+    const int rounds = 200000;
+    std::uint32_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      reinterpret_cast<char *>(&page)[r % Page::BLOB_SIZE] ^= 1;
+      sum ^= page.computeChecksum();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "checksum of a page: " << elapsed.count() * 1e9 / rounds
+              << "ns, "
+              << (double)Page::BLOB_SIZE * rounds / elapsed.count() / 1e9
+              << "GB/s (" << (sum != 0) << ")" << std::endl;
+  }
+
+  // random reads of a 32MB file through a pool of 64 frames, so nearly every
+  // read misses and comes from the page cache
+  const int numPages = 4096, numReads = 100000;
+  std::vector<PageId> pages;
+  {
+    BlobFile blobFile = BlobFile::create(fileName);
+    BufMgr pool(64);
+    for (int i = 0; i < numPages; i++) {
+      PageId pageNo;
+      Page *page;
+      pool.allocPage(&blobFile, pageNo, page);
+      memset(reinterpret_cast<char *>(page), i, Page::BLOB_SIZE);
+      pool.unPinPage(&blobFile, pageNo, true);
+      pages.push_back(pageNo);
+    }
+    pool.flushFile(&blobFile);
+  }
+  struct Run {
+    const char *name;
+    ChecksumPolicy policy;
+  };
+  const Run runs[] = {{"verification off", CHECKSUM_OFF},
+                      {"1 page in 16 verified", CHECKSUM_SAMPLED},
+                      {"every page verified", CHECKSUM_ALWAYS}};
+  for (const Run &run : runs) {
+    BlobFile blobFile = BlobFile::open(fileName);
+    BufMgr pool(64);
+    pool.setChecksumPolicy(run.policy);
+    srandom(37);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < numReads; r++) {
+      const PageId pageNo = pages[random() % numPages];
+      Page *page;
+      pool.readPage(&blobFile, pageNo, page);
+      pool.unPinPage(&blobFile, pageNo, false);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    const BufStats &stats = pool.getBufStats();
+    std::cout << run.name << ": " << elapsed.count() * 1e6 / stats.diskreads
+              << "us per read from disk, " << stats.diskreads << " reads, "
+              << stats.checksumsVerified << " verified" << std::endl;
+    pool.flushFile(&blobFile);
+  }
+  File::remove(fileName);
+}
+
+void bench38_compressed_files() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench38_compressed_files" << std::endl;
+  deleteIndexFile();
+  auto fileSize = [](const std::string &name) {
+    std::ifstream file(name, std::ios::binary | std::ios::ate);
+    return static_cast<std::uint64_t>(file.tellg());
+  };
+  const std::string plainName = intIndexName + ".plain";
+
+  createRelationRandom(500000);
+  bufMgr->flushFile(file1);
+  delete file1;
+  file1 = NULL;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+  }
+  {
+    std::ifstream from(intIndexName, std::ios::binary);
+    std::ofstream to(plainName, std::ios::binary);
+    to << from.rdbuf();
+  }
+
+  const std::string names[] = {relationName, intIndexName};
+  for (const std::string &name : names) {
+    const std::uint64_t before = fileSize(name);
+    auto start = std::chrono::steady_clock::now();
+    File::compress(name);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    const std::uint64_t after = fileSize(name);
+    std::cout << name << ": " << before / 1024 << "KB plain, " << after / 1024
+              << "KB compressed, ratio " << (double)before / after << ", "
+              << elapsed.count() * 1e6 / (before / Page::SIZE)
+              << "us per page compressed" << std::endl;
+  }
+
+  // random reads of the index through a pool of 64 frames, so nearly every
+  // read misses and comes from the page cache
+  const int numReads = 100000;
+  const std::string files[] = {plainName, intIndexName};
+  for (const std::string &name : files) {
+    BlobFile indexFile = BlobFile::open(name);
+    const PageId numPages = indexFile.getNumPages();
+    BufMgr pool(64);
+    srandom(38);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < numReads; r++) {
+      const PageId pageNo = random() % (numPages - 1) + 1;
+      Page *page;
+      pool.readPage(&indexFile, pageNo, page);
+      pool.unPinPage(&indexFile, pageNo, false);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    const BufStats &stats = pool.getBufStats();
+    std::cout << (indexFile.compressed() ? "compressed" : "plain")
+              << " index: " << elapsed.count() * 1e6 / stats.diskreads
+              << "us per read from disk, " << stats.diskreads << " reads"
+              << std::endl;
+    pool.flushFile(&indexFile);
+  }
+  File::remove(plainName);
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench39_direct_io() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench39_direct_io" << std::endl;
+  const std::string fileName = relationName + ".direct";
+  if (File::exists(fileName)) File::remove(fileName);
+
+  // random reads of a 32MB file through a pool of 64 frames, so nearly every
+  // read misses; directly it comes from the device, through the stream from
+  // the page cache, which ends up holding the file
+  const int numPages = 4096, numReads = 20000;
+  {
+    BlobFile blobFile = BlobFile::create(fileName);
+    BufMgr pool(64);
+    for (int i = 0; i < numPages; i++) {
+      PageId pageNo;
+      Page *page;
+      pool.allocPage(&blobFile, pageNo, page);
+      memset(reinterpret_cast<char *>(page), i, Page::BLOB_SIZE);
+      pool.unPinPage(&blobFile, pageNo, true);
+    }
+    pool.flushFile(&blobFile);
+  }
+  {
+    // the page cache drops the pages of the file once they are on disk
+    const int fd = ::open(fileName.c_str(), O_RDONLY);
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  }
+  for (int direct = 1; direct >= 0; direct--) {
+    std::unique_ptr<File> file;
+    if (direct) {
+      file.reset(new DirectBlobFile(fileName, false));
+    } else {
+      file.reset(new BlobFile(fileName, false));
+    }
+    BufMgr pool(64);
+    srandom(39);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < numReads; r++) {
+      const PageId pageNo = random() % numPages + 1;
+      Page *page;
+      pool.readPage(file.get(), pageNo, page);
+      pool.unPinPage(file.get(), pageNo, false);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    const BufStats &stats = pool.getBufStats();
+    std::cout << (direct ? "direct I/O" : "stream") << ": "
+              << elapsed.count() * 1e6 / stats.diskreads
+              << "us per read from disk, " << stats.diskreads << " reads, "
+              << cachedPages(fileName) << " of " << numPages
+              << " pages in the page cache" << std::endl;
+    pool.flushFile(file.get());
+  }
+  File::remove(fileName);
+
+  // random hits on a 256MB pool, touching a random line of each page
+  const std::uint32_t numFrames = 32768;
+  const int numHits = 2000000;
+  {
+    BlobFile blobFile = BlobFile::create(fileName);
+    for (std::uint32_t i = 0; i < numFrames; i++) {
+      PageId pageNo;
+      blobFile.allocatePage(pageNo);
+    }
+  }
+  for (int huge = 0; huge < 2; huge++) {
+    BlobFile blobFile = BlobFile::open(fileName);
+    BufMgr pool(numFrames, false, CLOCK_REPLACEMENT, huge);
+    for (PageId pageNo = 1; pageNo <= numFrames; pageNo++) {
+      Page *page;
+      pool.readPage(&blobFile, pageNo, page);
+      pool.unPinPage(&blobFile, pageNo, false);
+    }
+    srandom(39);
+    std::uint64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int h = 0; h < numHits; h++) {
+      const PageId pageNo = random() % numFrames + 1;
+      Page *page;
+      pool.readPage(&blobFile, pageNo, page);
+      sum += reinterpret_cast<const char *>(page)[random() % Page::BLOB_SIZE];
+      pool.unPinPage(&blobFile, pageNo, false);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << (huge ? "huge pages" : "small pages") << ": "
+              << elapsed.count() * 1e9 / numHits << "ns per hit ("
+              << pool.onReservedHugePages() << " " << (sum != 1) << ")"
+              << std::endl;
+    pool.flushFile(&blobFile);
+  }
+  File::remove(fileName);
+}
+
+void bench40_io_engines() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench40_io_engines" << std::endl;
+  const std::string fileName = relationName + ".direct";
+  if (File::exists(fileName)) File::remove(fileName);
+
+  // random direct reads of a 32MB file, one page per request or in batches
+  // of BUF_IO_BATCH pages, on either engine
+  const int numPages = 4096, numReads = 8192;
+  {
+    BlobFile blobFile = BlobFile::create(fileName);
+    BufMgr pool(64);
+    for (int i = 0; i < numPages; i++) {
+      PageId pageNo;
+      Page *page;
+      pool.allocPage(&blobFile, pageNo, page);
+      memset(reinterpret_cast<char *>(page), i, Page::BLOB_SIZE);
+      pool.unPinPage(&blobFile, pageNo, true);
+    }
+    pool.flushFile(&blobFile);
+  }
+  for (int kind = SYNC_IO; kind <= URING_IO; kind++) {
+    std::unique_ptr<IoEngine> engine(IoEngine::create(IoEngineKind(kind)));
+    DirectBlobFile direct = DirectBlobFile::open(fileName);
+    direct.setIoEngine(*engine);
+    std::vector<Page> images(BUF_IO_BATCH);
+    std::vector<Page *> pages;
+    for (Page &image : images) pages.push_back(&image);
+    // the device is read through once first, so that every pass finds it
+    // in the same state
+    for (int i = 0; i < numPages; i++) direct.readPage(i + 1, *pages[0]);
+    for (int batched = 0; batched < 2; batched++) {
+      srandom(40);
+      auto start = std::chrono::steady_clock::now();
+      for (int r = 0; r < numReads; r += BUF_IO_BATCH) {
+        std::vector<PageId> pageNos;
+        for (std::uint32_t i = 0; i < BUF_IO_BATCH; i++)
+          pageNos.push_back(random() % numPages + 1);
+        if (batched) {
+          direct.readPages(pageNos, pages);
+        } else {
+          for (std::uint32_t i = 0; i < BUF_IO_BATCH; i++)
+            direct.readPage(pageNos[i], *pages[i]);
+        }
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << engine->name() << ", "
+                << (batched ? "batches" : "one page at a time") << ": "
+                << elapsed.count() * 1e6 / numReads << "us per page read"
+                << std::endl;
+    }
+  }
+
+  // flushing a file of dirty pages, written in batches
+  for (int kind = SYNC_IO; kind <= URING_IO; kind++) {
+    std::unique_ptr<IoEngine> engine(IoEngine::create(IoEngineKind(kind)));
+    DirectBlobFile direct = DirectBlobFile::open(fileName);
+    direct.setIoEngine(*engine);
+    BufMgr pool(numPages + 64);
+    std::vector<PageId> pageNos;
+    for (int i = 0; i < numPages; i++) pageNos.push_back(i + 1);
+    pool.prefetchPages(&direct, pageNos);
+    for (int i = 0; i < numPages; i++) {
+      Page *page;
+      pool.readPage(&direct, i + 1, page);
+      reinterpret_cast<char *>(page)[0] = char(kind);
+      pool.unPinPage(&direct, i + 1, true);
+    }
+    auto start = std::chrono::steady_clock::now();
+    pool.flushFile(&direct);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << engine->name() << ", flushFile: "
+              << elapsed.count() * 1e6 / numPages << "us per page written"
+              << std::endl;
+  }
+  File::remove(fileName);
+}
+
+void bench41_page_size() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench41_page_size" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 300000;
+  createRelationRandom(numRecords);
+
+  // the same index read through pools of 64MB, holding all of it, and of
+  // 1MB, whose misses are read from the page cache; the page size is the
+  // one built with, see the PAGE_SIZE option
+  const int numScans = 20, numProbes = 200000;
+  std::vector<int> probes(numProbes);
+  std::srand(41);
+  for (int &probe : probes) probe = std::rand() % numRecords;
+  for (int poolBytes : {64 << 20, 1 << 20}) {
+    BufMgr *pool = new BufMgr(poolBytes / Page::SIZE);
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER);
+      const int low = 0, high = numRecords;
+      countScan(&index, &low, GTE, &high, LT);
+      pool->clearBufStats();
+      auto start = std::chrono::steady_clock::now();
+      int numScanned = 0;
+      for (int s = 0; s < numScans; s++)
+        numScanned += countScan(&index, &low, GTE, &high, LT);
+      std::chrono::duration<double> scanTime =
+          std::chrono::steady_clock::now() - start;
+      const double scanReads = pool->getBufStats().diskreads;
+
+      pool->clearBufStats();
+      start = std::chrono::steady_clock::now();
+      int numFound = 0;
+      RecordId found[8];
+      for (int key : probes) numFound += index.lookup(&key, found, 8);
+      std::chrono::duration<double> lookupTime =
+          std::chrono::steady_clock::now() - start;
+      const double lookupReads = pool->getBufStats().diskreads;
+      checkPassFail(numScanned, numScans * numRecords);
+      checkPassFail(numFound, numProbes);
+
+      std::cout << Page::SIZE << "B pages, " << (poolBytes >> 20)
+                << "MB pool: scan " << numScanned / scanTime.count() / 1e6
+                << "M keys/s (" << scanReads / numScans
+                << " reads per scan), lookup "
+                << lookupTime.count() * 1e9 / numProbes << "ns ("
+                << lookupReads / numProbes << " reads per lookup)"
+                << std::endl;
+    }
+    delete pool;
+  }
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench42_int_node_directory() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench42_int_node_directory" << std::endl;
+
+  // searches of random keys in random full internal nodes, more of them than
+  // the caches hold, so that each search misses the way a descent does
+  const int numNodes = 4096;
+  const int stride = INTARRAYNONLEAFSIZE + INTNONLEAFBLOCKS + INTNONLEAFLINES;
+  int *nodes = (int *)aligned_alloc(64, (numNodes * stride * sizeof(int) + 63)
+                                            / 64 * 64);
+  std::srand(42);
+  for (int n = 0; n < numNodes; n++) {
+    int *keys = nodes + n * stride;
+    for (int k = 0; k < INTARRAYNONLEAFSIZE; k++)
+      keys[k] = 2 * k + std::rand() % 2;
+    indexIntKeys(keys, INTARRAYNONLEAFSIZE, keys + INTARRAYNONLEAFSIZE,
+                 keys + INTARRAYNONLEAFSIZE + INTNONLEAFBLOCKS);
+  }
+  std::vector<std::pair<int, int>> probes(1 << 16);
+  for (auto &probe : probes)
+    probe = std::make_pair(std::rand() % numNodes,
+                           std::rand() % (2 * INTARRAYNONLEAFSIZE + 2) - 1);
+
+  const int searches = 5000000;
+  long long sums[3] = {0, 0, 0};
+  const char *names[3] = {"std::lower_bound", "searchIntArray",
+                          "searchIntDirectory"};
+  for (int method = 0; method < 3; method++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < searches; i++) {
+      const auto &probe = probes[i & (probes.size() - 1)];
+      const int *keys = nodes + probe.first * stride;
+      if (method == 0)
+        sums[method] +=
+            std::lower_bound(keys, keys + INTARRAYNONLEAFSIZE, probe.second) -
+            keys;
+      else if (method == 1)
+        sums[method] +=
+            searchIntArray(keys, INTARRAYNONLEAFSIZE, probe.second, true);
+      else
+        sums[method] += searchIntDirectory(
+            keys, INTARRAYNONLEAFSIZE, keys + INTARRAYNONLEAFSIZE,
+            keys + INTARRAYNONLEAFSIZE + INTNONLEAFBLOCKS, NULL, probe.second,
+            true);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << names[method] << ": " << elapsed.count() * 1e9 / searches
+              << "ns per search of " << INTARRAYNONLEAFSIZE << " keys"
+              << std::endl;
+  }
+  free(nodes);
+  checkPassFail(sums[1], sums[0]);
+  checkPassFail(sums[2], sums[0]);
+
+  // point lookups on an index resident in the buffer pool, as in
+  // bench41_page_size
+  deleteIndexFile();
+  const int numRecords = 300000, numProbes = 200000;
+  createRelationRandom(numRecords);
+  std::vector<int> keys(numProbes);
+  for (int &key : keys) key = std::rand() % numRecords;
+  BufMgr *pool = new BufMgr((64 << 20) / Page::SIZE);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER);
+    int numFound = 0;
+    RecordId found[8];
+    for (int key : keys) numFound += index.lookup(&key, found, 8);
+    auto start = std::chrono::steady_clock::now();
+    for (int key : keys) numFound += index.lookup(&key, found, 8);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(numFound, 2 * numProbes);
+    std::cout << "lookup: " << elapsed.count() * 1e9 / numProbes << "ns"
+              << std::endl;
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench43_pinned_upper_levels() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench43_pinned_upper_levels" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 300000, numOps = 200000;
+  createRelationRandom(numRecords);
+
+  // lookups, short scans and insertions on a resident tree of three levels,
+  // with the buffer accesses each one makes
+  std::vector<int> keys(numOps);
+  std::srand(43);
+  for (int &key : keys) key = std::rand() % numRecords;
+  BufMgr *pool = new BufMgr((64 << 20) / Page::SIZE);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, 0.5);
+    RecordId found[8];
+    int numFound = 0;
+    for (int key : keys) numFound += index.lookup(&key, found, 8);
+    for (int test = 0; test < 3; test++) {
+      pool->clearBufStats();
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < numOps; i++) {
+        int key = keys[i];
+        if (test == 0) {
+          numFound += index.lookup(&key, found, 8);
+        } else if (test == 1) {
+          const int high = key + 10;
+          numFound += countScan(&index, &key, GTE, &high, LT);
+        } else {
+          key += numRecords;
+          index.insertEntry(&key, RecordId{1, 1});
+        }
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      const char *names[3] = {"lookup", "10-key scan", "insert"};
+      std::cout << names[test] << ": " << elapsed.count() * 1e9 / numOps
+                << "ns, " << (double)pool->getBufStats().accesses / numOps
+                << " buffer accesses" << std::endl;
+    }
+    const bool allFound = numFound >= 2 * numOps;
+    checkPassFail(allFound, true);
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench44_swizzled_children() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench44_swizzled_children" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 300000, numOps = 200000;
+  createRelationRandom(numRecords);
+
+  // lookups, short scans and insertions on a resident tree of three levels,
+  // reaching the leaves through the slots of the pinned nodes or through
+  // the hash table of the buffer manager
+  std::vector<int> keys(numOps);
+  std::srand(44);
+  for (int &key : keys) key = std::rand() % numRecords;
+  for (int swizzling = 0; swizzling < 2; swizzling++) {
+    BufMgr *pool = new BufMgr((64 << 20) / Page::SIZE);
+    {
+      BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                       INTEGER, BULK_BUILD, 0.5);
+      index.setSwizzling(swizzling);
+      RecordId found[8];
+      int numFound = 0;
+      for (int key : keys) numFound += index.lookup(&key, found, 8);
+      for (int test = 0; test < 3; test++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < numOps; i++) {
+          int key = keys[i];
+          if (test == 0) {
+            numFound += index.lookup(&key, found, 8);
+          } else if (test == 1) {
+            const int high = key + 10;
+            numFound += countScan(&index, &key, GTE, &high, LT);
+          } else {
+            key += numRecords;
+            index.insertEntry(&key, RecordId{1, 1});
+          }
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        const char *names[3] = {"lookup", "10-key scan", "insert"};
+        std::cout << (swizzling ? "swizzled " : "looked up ") << names[test]
+                  << ": " << elapsed.count() * 1e9 / numOps << "ns"
+                  << std::endl;
+      }
+      const bool allFound = numFound >= 2 * numOps;
+      checkPassFail(allFound, true);
+    }
+    delete pool;
+    File::remove(intIndexName);
+  }
+  deleteRelation();
+}
+
+void bench45_buf_stats() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench45_buf_stats" << std::endl;
+
+  // the cost of counting an access to a resident page, alone and with four
+  // threads sharing a concurrent pool
+  const std::string fileName = relationName + ".stats";
+  if (File::exists(fileName)) File::remove(fileName);
+  {
+    BlobFile blobFile = BlobFile::create(fileName);
+    std::vector<PageId> pageNos(64);
+    {
+      BufMgr pool(64);
+      Page *page;
+      for (PageId &pageNo : pageNos) {
+        pool.allocPage(&blobFile, pageNo, page);
+        pool.unPinPage(page, true);
+      }
+      pool.flushFile(&blobFile);
+    }
+    const int numReads = 2000000;
+    for (int numThreads : {1, 4}) {
+      BufMgr pool(128, numThreads > 1);
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&pool, &blobFile, &pageNos, numThreads, t]() {
+          for (int i = t; i < numReads; i += numThreads) {
+            Page *page;
+            const PageId pageNo = pageNos[i % pageNos.size()];
+            pool.readPage(&blobFile, pageNo, page);
+            pool.unPinPage(&blobFile, pageNo, false);
+          }
+        });
+      }
+      for (std::thread &thread : threads) thread.join();
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << numThreads << " thread(s): "
+                << elapsed.count() * 1e9 / numReads << "ns per access"
+                << std::endl;
+      const BufStats stats = pool.getBufStats();
+      checkPassFail(stats.accesses, numReads);
+      stats.print(std::cout);
+      pool.flushFile(&blobFile);
+    }
+  }
+  File::remove(fileName);
+}
+
+void bench46_index_counters() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench46_index_counters" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 300000, numOps = 200000;
+  createRelationRandom(numRecords);
+
+  // the cost of counting on lookups and insertions into a resident tree,
+  // and what the counters and the analysis then report
+  std::vector<int> keys(numOps);
+  std::srand(46);
+  for (int &key : keys) key = std::rand() % numRecords;
+  BufMgr *pool = new BufMgr((64 << 20) / Page::SIZE);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, 0.5);
+    RecordId found[8];
+    int numFound = 0;
+    for (int key : keys) numFound += index.lookup(&key, found, 8);
+    for (int test = 0; test < 2; test++) {
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < numOps; i++) {
+        int key = keys[i];
+        if (test == 0) {
+          numFound += index.lookup(&key, found, 8);
+        } else {
+          key += numRecords;
+          index.insertEntry(&key, RecordId{1, 1});
+        }
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << (test == 0 ? "lookup: " : "insert: ")
+                << elapsed.count() * 1e9 / numOps << "ns" << std::endl;
+    }
+    const bool allFound = numFound >= 2 * numOps;
+    checkPassFail(allFound, true);
+
+    const IndexCounters counters = index.getCounters();
+    std::cout << counters.lookups << " lookups, " << counters.inserts
+              << " inserts, " << counters.leafSplits << " leaf splits, "
+              << counters.nonLeafSplits << " internal node splits, "
+              << counters.pagesPerOperation() << " pages pinned per operation"
+              << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    const IndexAnalysis analysis = index.analyze();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    for (const LevelStats &level : analysis.levels)
+      std::cout << "level: " << level.numNodes << " nodes, "
+                << level.numEntries << " entries, " << level.fillFactor
+                << " full" << std::endl;
+    std::cout << "fragmentation: " << analysis.fragmentation << " ("
+              << analysis.outOfOrderLinks << " links), analyzed in "
+              << elapsed.count() * 1e3 << "ms" << std::endl;
+  }
+  delete pool;
+  File::remove(intIndexName);
+  deleteRelation();
+}
+
+void bench47_tracing() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench47_tracing" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 300000, numOps = 200000;
+  createRelationRandom(numRecords);
+
+  // the cost of the trace points on pins of resident pages and on lookups,
+  // with tracing off and on
+  std::vector<int> keys(numOps);
+  std::srand(47);
+  for (int &key : keys) key = std::rand() % numRecords;
+  BufMgr *pool = new BufMgr((64 << 20) / Page::SIZE);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD);
+    PageFile relation = PageFile::open(relationName);
+    const PageId firstPageNo = relation.getFirstPageNo();
+    RecordId found[8];
+    int numFound = 0;
+    for (int key : keys) numFound += index.lookup(&key, found, 8);
+    for (int on = 0; on < 2; on++) {
+      Tracer::enable(on == 1);
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < numOps; i++) {
+        Page *page;
+        const PageId pageNo = firstPageNo + i % 64;
+        pool->readPage(&relation, pageNo, page);
+        pool->unPinPage(&relation, pageNo, false);
+      }
+      std::chrono::duration<double> pinned =
+          std::chrono::steady_clock::now() - start;
+      start = std::chrono::steady_clock::now();
+      for (int key : keys) numFound += index.lookup(&key, found, 8);
+      std::chrono::duration<double> looked =
+          std::chrono::steady_clock::now() - start;
+      Tracer::enable(false);
+      std::cout << "tracing " << (on ? "on" : "off") << ": "
+                << pinned.count() * 1e9 / numOps << "ns per pin, "
+                << looked.count() * 1e9 / numOps << "ns per lookup"
+                << std::endl;
+    }
+    const bool allFound = numFound >= 3 * numOps;
+    checkPassFail(allFound, true);
+    pool->flushFile(&relation);
+
+    auto start = std::chrono::steady_clock::now();
+    std::ostringstream trace;
+    Tracer::dump(trace);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "dump: " << trace.str().size() / 1024 << "KB in "
+              << elapsed.count() * 1e3 << "ms" << std::endl;
+    Tracer::clear();
+  }
+  delete pool;
+  File::remove(intIndexName);
+  deleteRelation();
+}
+
+void bench48_pin_tracking() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench48_pin_tracking" << std::endl;
+  const int numRecords = 100000, numOps = 500000;
+  createRelationRandom(numRecords);
+
+  // the cost of a pin of a resident page given back by unPinPage() and by a
+  // handle, and with pins tracked
+  BufMgr *pool = new BufMgr((64 << 20) / Page::SIZE);
+  {
+    PageFile relation = PageFile::open(relationName);
+    const PageId firstPageNo = relation.getFirstPageNo();
+    const char *const modes[] = {"raw", "handle", "raw tracked",
+                                 "handle tracked"};
+    for (int mode = 0; mode < 4; mode++) {
+      pool->setPinTracking(mode >= 2);
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < numOps; i++) {
+        const PageId pageNo = firstPageNo + i % 64;
+        if (mode % 2 == 0) {
+          Page *page;
+          pool->readPage(&relation, pageNo, page);
+          pool->unPinPage(page, false);
+        } else {
+          PageHandle page = pool->pin(&relation, pageNo);
+        }
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << modes[mode] << ": " << elapsed.count() * 1e9 / numOps
+                << "ns per pin" << std::endl;
+    }
+    checkPassFail(pool->outstandingPins().size(), (std::size_t)0);
+    pool->setPinTracking(false);
+    pool->flushFile(&relation);
+  }
+  delete pool;
+  deleteRelation();
+}
+
+void bench49_resize_pool() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench49_resize_pool" << std::endl;
+  createRelationRandom(300000);
+  std::vector<PageId> pageNos;
+  {
+    PageFile relation = PageFile::open(relationName);
+    for (FileIterator it = relation.begin(); it != relation.end(); ++it)
+      pageNos.push_back((*it).page_number());
+  }
+
+  // growing an in-use pool eightfold and shrinking it back, and the cost
+  // of pins of resident pages while the hash tables move their entries
+  const std::uint32_t frames = 2048;
+  BufMgr *pool = new BufMgr(frames, true);
+  {
+    PageFile relation = PageFile::open(relationName);
+    const std::size_t resident = std::min<std::size_t>(pageNos.size(),
+                                                       frames / 2);
+    auto pinAll = [&]() {
+      auto start = std::chrono::steady_clock::now();
+      for (int round = 0; round < 20; round++) {
+        for (std::size_t i = 0; i < resident; i++)
+          PageHandle page = pool->pin(&relation, pageNos[i]);
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      return elapsed.count() * 1e9 / (20 * resident);
+    };
+    pinAll();
+    const double steady = pinAll();
+
+    auto start = std::chrono::steady_clock::now();
+    pool->resize(8 * frames);
+    std::chrono::duration<double> grow =
+        std::chrono::steady_clock::now() - start;
+    const double migrating = pinAll();
+    for (PageId pageNo : pageNos) {
+      PageHandle page = pool->pin(&relation, pageNo);
+    }
+
+    start = std::chrono::steady_clock::now();
+    const std::uint32_t shrunk = pool->resize(frames);
+    std::chrono::duration<double> shrink =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(shrunk, frames);
+    std::cout << "grow " << frames << " to " << 8 * frames << " frames: "
+              << grow.count() * 1e3 << "ms" << std::endl;
+    std::cout << "shrink back, evicting " << pageNos.size() - frames
+              << " pages: " << shrink.count() * 1e3 << "ms" << std::endl;
+    std::cout << "pin: " << steady << "ns before growing, " << migrating
+              << "ns after" << std::endl;
+    pool->flushFile(&relation);
+  }
+  delete pool;
+  deleteRelation();
+}
+
+void bench50_numa() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench50_numa" << std::endl;
+  createRelationRandom(400000);
+  std::vector<PageId> pageNos;
+  {
+    PageFile relation = PageFile::open(relationName);
+    for (FileIterator it = relation.begin(); it != relation.end(); ++it)
+      pageNos.push_back((*it).page_number());
+  }
+
+  // a scan thread pinned to each node reads its own share of the relation
+  // again and again, in a pool holding all of it: first with the frames
+  // touched by one thread, as if on one node, then spread over the nodes
+  const NumaTopology &machine = NumaTopology::system();
+  const std::uint32_t nodes = machine.nodes();
+  std::vector<int> allCpus;
+  for (std::uint32_t node = 0; node < nodes; node++) {
+    allCpus.insert(allCpus.end(), machine.cpus(node).begin(),
+                   machine.cpus(node).end());
+  }
+  const NumaTopology oneNode(std::vector<std::vector<int>>(1, allCpus));
+  std::cout << nodes << " NUMA nodes" << std::endl;
+
+  const int passes = 10;
+  for (const NumaTopology *topology : {&oneNode, &machine}) {
+    BufMgr *pool = new BufMgr(pageNos.size() + 64, true, CLOCK_REPLACEMENT,
+                              false, 0, *topology);
+    std::vector<std::thread> scanners;
+    std::vector<double> nanos(nodes);
+    std::atomic<std::uint64_t> records(0);
+    for (std::uint32_t node = 0; node < nodes; node++) {
+      scanners.emplace_back([&, node] {
+        machine.runOn(node);
+        PageFile relation = PageFile::open(relationName);
+        const std::size_t first = pageNos.size() * node / nodes;
+        const std::size_t last = pageNos.size() * (node + 1) / nodes;
+        for (std::size_t i = first; i < last; i++)
+          PageHandle page = pool->pin(&relation, pageNos[i]);
+        auto start = std::chrono::steady_clock::now();
+        std::uint64_t seen = 0;
+        for (int pass = 0; pass < passes; pass++) {
+          for (std::size_t i = first; i < last; i++) {
+            PageHandle page = pool->pin(&relation, pageNos[i]);
+            for (PageIterator it = page->begin(); it != page->end(); ++it)
+              seen++;
+          }
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        nanos[node] = elapsed.count() * 1e9 / (passes * (last - first));
+        records += seen;
+      });
+    }
+    for (std::thread &scanner : scanners) scanner.join();
+    checkPassFail(records.load(), (std::uint64_t)passes * 400000);
+
+    std::cout << (topology == &oneNode ? "frames on one node"
+                                       : "frames spread over the nodes")
+              << std::endl;
+    for (std::uint32_t node = 0; node < pool->numaNodes(); node++) {
+      const BufStats stats = pool->getBufStats(node);
+      std::cout << "  node " << node << ": " << stats.accesses
+                << " accesses, " << stats.remoteHits << " remote hits, "
+                << stats.remoteAllocations << " remote allocations"
+                << std::endl;
+    }
+    for (std::uint32_t node = 0; node < nodes; node++) {
+      std::cout << "  scan on node " << node << ": " << nanos[node]
+                << "ns per page scanned" << std::endl;
+    }
+    PageFile relation = PageFile::open(relationName);
+    pool->flushFile(&relation);
+    delete pool;
+  }
+  deleteRelation();
+}
+
+void bench52_file_registry() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench52_file_registry" << std::endl;
+
+  createRelationRandom(20000);
+  const int rounds = 20000;
+  auto timed = [&](const char *what, const std::function<void()> &fn) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < rounds; k++) fn();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << what << ": " << elapsed.count() * 1e9 / rounds << "ns"
+              << std::endl;
+  };
+
+  int found = 0;
+  timed("exists", [&] { found += File::exists(relationName); });
+  timed("isOpen", [&] { found += File::isOpen(relationName); });
+  timed("open of an open file", [&] {
+    PageFile relation = PageFile::open(relationName);
+    found += relation.id() != 0;
+  });
+  timed("file scan construction", [&] {
+    FileScan scan(relationName, bufMgr);
+    found++;
+  });
+  checkPassFail(found, 4 * rounds);
+  deleteRelation();
+}
+
+void bench53_ebay_loader() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench53_ebay_loader" << std::endl;
+#ifndef EBAY_DATA_DIR
+  std::cout << "no eBay data set" << std::endl;
+#else
+  std::vector<std::string> jsonFiles;
+  for (int k = 0;; k++) {
+    const std::string name =
+        std::string(EBAY_DATA_DIR) + "/items-" + std::to_string(k) + ".json";
+    if (!File::exists(name)) break;
+    jsonFiles.push_back(name);
+  }
+  if (jsonFiles.empty()) {
+    std::cout << "no eBay data set" << std::endl;
+    return;
+  }
+
+  struct Relation {
+    const char *suffix;
+    std::size_t recordSize;
+    std::vector<KeyColumn> keyColumns;
+  };
+  const std::vector<Relation> relations = {
+      {".items", sizeof(EbayItem), {{offsetof(EbayItem, itemId), INTEGER}}},
+      {".users", sizeof(EbayUser), {{offsetof(EbayUser, userId), STRING}}},
+      {".bids",
+       sizeof(EbayBid),
+       {{offsetof(EbayBid, itemId), INTEGER},
+        {offsetof(EbayBid, amount), DOUBLE}}},
+      {".categories",
+       sizeof(EbayCategory),
+       {{offsetof(EbayCategory, itemId), INTEGER}}}};
+  BufMgr *pool = new BufMgr(1000);
+  std::vector<std::string> indexNames;
+
+  auto start = std::chrono::steady_clock::now();
+  const EbayLoadStats stats = loadEbay(jsonFiles, relationName, pool);
+  const std::chrono::duration<double> loadTime =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "streaming load of " << stats.bytesRead / 1000000
+            << "MB: " << stats.items << " items, " << stats.users
+            << " users, " << stats.bids << " bids, " << stats.categories
+            << " categories" << std::endl;
+  std::cout << "  " << loadTime.count() * 1e3 << "ms, " << stats.pages
+            << " pages" << std::endl;
+
+  // the same records inserted one at a time into pages written as they fill,
+  // as the relations of the tests are, and indexed by a scan
+  std::vector<std::vector<char>> records;
+  for (const Relation &relation : relations) {
+    records.emplace_back();
+    FileScan scan(relationName + relation.suffix, pool);
+    try {
+      RecordId scanRid;
+      while (1) {
+        scan.scanNext(scanRid);
+        const RecordView view = scan.getRecordView();
+        records.back().insert(records.back().end(), view.data,
+                              view.data + view.length);
+      }
+    } catch (EndOfFileException e) {
+    }
+  }
+
+  // the records alone, loaded a page at a time
+  std::uint64_t loadPages = 0;
+  start = std::chrono::steady_clock::now();
+  for (std::size_t r = 0; r < relations.size(); r++) {
+    RelationLoader loader("relC" + std::string(relations[r].suffix),
+                          relations[r].recordSize);
+    loader.addIndex(relations[r].keyColumns);
+    for (std::size_t offset = 0; offset < records[r].size();
+         offset += relations[r].recordSize) {
+      loader.append(&records[r][offset]);
+    }
+    for (const std::string &name : loader.finish(pool)) {
+      indexNames.push_back(name);
+    }
+    loadPages += loader.pages();
+  }
+  const std::chrono::duration<double> appendTime =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "page appends and index builds from the keys" << std::endl;
+  std::cout << "  " << appendTime.count() * 1e3 << "ms, " << loadPages
+            << " pages" << std::endl;
+
+  std::uint64_t insertPages = 0;
+  start = std::chrono::steady_clock::now();
+  for (std::size_t r = 0; r < relations.size(); r++) {
+    const std::string name = "relB" + std::string(relations[r].suffix);
+    {
+      PageFile file = PageFile::create(name);
+      PageId pageNo;
+      Page page = file.allocatePage(pageNo);
+      insertPages++;
+      for (std::size_t offset = 0; offset < records[r].size();
+           offset += relations[r].recordSize) {
+        std::string data(&records[r][offset], relations[r].recordSize);
+        while (1) {
+          try {
+            page.insertRecord(data);
+            break;
+          } catch (InsufficientSpaceException e) {
+            file.writePage(pageNo, page);
+            page = file.allocatePage(pageNo);
+            insertPages++;
+          }
+        }
+      }
+      file.writePage(pageNo, page);
+    }
+    std::string indexName;
+    BTreeIndex index(name, indexName, pool, relations[r].keyColumns);
+    indexNames.push_back(indexName);
+  }
+  const std::chrono::duration<double> insertTime =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "insert loops and scanning index builds" << std::endl;
+  std::cout << "  " << insertTime.count() * 1e3 << "ms, " << insertPages
+            << " pages" << std::endl;
+  checkPassFail(loadPages, stats.pages);
+  checkPassFail(insertPages, stats.pages);
+
+  delete pool;
+  for (const std::string &name : indexNames) File::remove(name);
+  for (const Relation &relation : relations) {
+    File::remove(relationName + relation.suffix);
+    File::remove("relB" + std::string(relation.suffix));
+    File::remove("relC" + std::string(relation.suffix));
+    std::string indexName = relationName + relation.suffix;
+    for (const KeyColumn &column : relation.keyColumns) {
+      indexName += ',' + std::to_string(column.byteOffset);
+    }
+    File::remove(indexName);
+  }
+#endif
+}
+
+void bench54_hash_index() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench54_hash_index" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 300000, numOps = 200000;
+  createRelationRandom(numRecords);
+
+  // building each index, then point lookups of keys present and absent, in a
+  // pool holding all of it and in one holding little of it
+  std::vector<int> keys(numOps);
+  std::srand(54);
+  for (int &key : keys) key = std::rand() % numRecords;
+  std::string hashIndexName;
+  for (int resident = 1; resident >= 0; resident--) {
+    BufMgr *pool = new BufMgr(resident ? (64 << 20) / Page::SIZE : 64);
+    std::cout << (resident ? "pool holding the index" : "pool of 64 frames")
+              << std::endl;
+    for (int kind = 0; kind < 2; kind++) {
+      auto start = std::chrono::steady_clock::now();
+      std::unique_ptr<HashIndex> hash;
+      std::unique_ptr<BTreeIndex> tree;
+      if (kind == 0) {
+        hash.reset(new HashIndex(relationName, hashIndexName, pool,
+                                 offsetof(tuple, i), INTEGER));
+      } else {
+        tree.reset(new BTreeIndex(relationName, intIndexName, pool,
+                                  offsetof(tuple, i), INTEGER));
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << (kind == 0 ? "  hash index" : "  B+ tree") << " built in "
+                << elapsed.count() * 1e3 << "ms" << std::endl;
+
+      RecordId found[4];
+      std::size_t numFound = 0;
+      for (int miss = 0; miss < 2; miss++) {
+        pool->clearBufStats();
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < numOps; i++) {
+          const int key = keys[i] + miss * numRecords;
+          numFound += kind == 0 ? hash->lookup(&key, found, 4)
+                                : tree->lookup(&key, found, 4);
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+        const BufStats stats = pool->getBufStats();
+        std::cout << (miss ? "    miss: " : "    hit: ")
+                  << elapsed.count() * 1e9 / numOps << "ns, "
+                  << (double)stats.accesses / numOps << " pages and "
+                  << (double)stats.diskreads / numOps
+                  << " reads per lookup" << std::endl;
+      }
+      checkPassFail(numFound, (std::size_t)numOps);
+    }
+    delete pool;
+    File::remove(hashIndexName);
+    File::remove(intIndexName);
+  }
+  deleteRelation();
+}
+
+void bench55_leaf_summaries() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench55_leaf_summaries" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 300000, numProbes = 200000, stride = 8;
+
+  // join probes of which one in ten finds its key, into an index of every
+  // eighth key bulk built from a feed, in a pool holding a sixth of it
+  const RecordFeed feed = [&](const std::function<void(const RecordId &,
+                                                       const char *)> &add) {
+    tuple record{};
+    for (int k = 0; k < numRecords; k++) {
+      record.i = k * stride;
+      add(RecordId{(PageId)(k / 64 + 1), (SlotId)(k % 64)},
+          (const char *)&record);
+    }
+  };
+  std::vector<int> probes(numProbes);
+  std::srand(55);
+  for (int &probe : probes) {
+    const int k = std::rand() % numRecords;
+    probe = k * stride + (std::rand() % 10 == 0 ? 0 : 1 + std::rand() % 7);
+  }
+  std::vector<int> sortedProbes(probes);
+  std::sort(sortedProbes.begin(), sortedProbes.end());
+
+  BufMgr *pool = new BufMgr(64);
+  {
+    BTreeIndex index(relationName, intIndexName, pool,
+                     {{offsetof(tuple, i), INTEGER}}, feed);
+    for (int on = 0; on < 2; on++) {
+      index.setLeafSummaries(on);
+      std::cout << (on ? "leaf summaries" : "no leaf summaries") << std::endl;
+      RecordId rid;
+      std::size_t numFound = 0;
+      for (int probe : probes) numFound += index.lookup(&probe, &rid, 1);
+      for (int test = 0; test < 2; test++) {
+        index.clearCounters();
+        pool->clearBufStats();
+        auto start = std::chrono::steady_clock::now();
+        std::vector<RecordId> outRids;
+        std::vector<std::size_t> outCounts;
+        if (test == 0) {
+          for (int probe : probes) numFound += index.lookup(&probe, &rid, 1);
+        } else {
+          index.lookupMany(sortedProbes.data(), numProbes, outRids, outCounts);
+          numFound += outRids.size();
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        const IndexCounters counters = index.getCounters();
+        std::cout << (test == 0 ? "  lookup: " : "  lookupMany, sorted: ")
+                  << elapsed.count() * 1e9 / numProbes << "ns, "
+                  << (double)counters.pagesPinned / numProbes
+                  << " pages pinned and "
+                  << (double)pool->getBufStats().diskreads / numProbes
+                  << " reads per probe, " << counters.leavesSkipped
+                  << " leaves skipped" << std::endl;
+      }
+      const bool allFound = numFound == 3 * (std::size_t)std::count_if(
+                                               probes.begin(), probes.end(),
+                                               [](int probe) {
+                                                 return probe % stride == 0;
+                                               });
+      checkPassFail(allFound, true);
+    }
+  }
+  delete pool;
+  File::remove(intIndexName);
+}
+
+void bench56_insert_buffer() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench56_insert_buffer" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 300000, numInserts = 100000, stride = 8;
+
+  // random new keys inserted into an index of every eighth key bulk built
+  // from a feed, in a pool holding a sixth of it
+  const RecordFeed feed = [&](const std::function<void(const RecordId &,
+                                                       const char *)> &add) {
+    tuple record{};
+    for (int k = 0; k < numRecords; k++) {
+      record.i = k * stride;
+      add(RecordId{(PageId)(k / 64 + 1), (SlotId)(k % 64)},
+          (const char *)&record);
+    }
+  };
+  std::vector<int> keys(numInserts);
+  std::srand(56);
+  for (int &key : keys)
+    key = (std::rand() % numRecords) * stride + 1 + std::rand() % 7;
+
+  for (int on = 0; on < 2; on++) {
+    BufMgr *pool = new BufMgr(64);
+    {
+      BTreeIndex index(relationName, intIndexName, pool,
+                       {{offsetof(tuple, i), INTEGER}}, feed);
+      index.setInsertBuffer(on ? INSERT_BUFFER_ENTRIES : 0);
+      pool->clearBufStats();
+      auto start = std::chrono::steady_clock::now();
+      for (int k = 0; k < numInserts; k++)
+        index.insertEntry(&keys[k], RecordId{(PageId)(k + 1), 1});
+      index.flushInsertBuffer();
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      const BufStats stats = pool->getBufStats();
+      std::cout << (on ? "insert buffer: " : "no insert buffer: ")
+                << elapsed.count() * 1e9 / numInserts << "ns, "
+                << (double)stats.diskreads / numInserts << " reads and "
+                << (double)stats.diskwrites / numInserts
+                << " writes per insert, "
+                << index.getCounters().bufferFlushes << " flushes"
+                << std::endl;
+
+      RecordId rid;
+      std::size_t numFound = 0;
+      for (int k = 0; k < numInserts; k += 100)
+        numFound += index.lookup(&keys[k], &rid, 1) > 0;
+      checkPassFail(numFound, (std::size_t)numInserts / 100);
+    }
+    delete pool;
+    File::remove(intIndexName);
+  }
+}
+
+void bench57_snapshot_scans() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench57_snapshot_scans" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 200000, numInserts = 100000;
+  createRelationRandom(numRecords);
+  std::vector<int> keys(2 * numInserts);
+  std::srand(57);
+  for (int &key : keys) key = std::rand() % numRecords;
+
+  // full scans of a concurrent index in a pool holding it, alone and while
+  // a writer thread inserts random keys
+  BufMgr *pool = new BufMgr(4000, true);
+  {
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+    int low = 0, high = numRecords;
+    std::vector<RecordId> rids(numRecords + keys.size() + 1000);
+    auto scan = [&](IndexScanCursor &cursor) {
+      std::size_t numRids = 0, n;
+      while ((n = cursor.scanNextBatch(&rids[numRids], 1000)) > 0)
+        numRids += n;
+      return numRids;
+    };
+    auto insertKeys = [&](int from, int to) {
+      auto start = std::chrono::steady_clock::now();
+      for (int k = from; k < to; k++)
+        index.insertEntry(&keys[k], RecordId{(PageId)(numRecords + k), 1});
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      return (to - from) / elapsed.count();
+    };
+
+    for (int snapshot = 0; snapshot < 2; snapshot++) {
+      auto start = std::chrono::steady_clock::now();
+      IndexScanCursor cursor = index.openScan(
+          &low, GTE, &high, LT, NORMAL_ACCESS, ASCENDING, snapshot);
+      const std::size_t numRids = scan(cursor);
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << (snapshot ? "snapshot scan: " : "scan: ")
+                << elapsed.count() * 1e9 / numRids << "ns per entry"
+                << std::endl;
+    }
+    std::cout << "inserts alone: " << insertKeys(0, numInserts)
+              << " inserts/s" << std::endl;
+
+    index.clearCounters();
+    IndexScanCursor first = index.openScan(&low, GTE, &high, LT,
+                                           NORMAL_ACCESS, ASCENDING, true);
+    std::atomic<bool> done{false};
+    double insertRate = 0;
+    std::thread writer([&]() {
+      insertRate = insertKeys(numInserts, 2 * numInserts);
+      done = true;
+    });
+    auto start = std::chrono::steady_clock::now();
+    const std::size_t firstRids = scan(first);
+    std::size_t numScans = 1, numScanned = firstRids;
+    while (!done) {
+      IndexScanCursor cursor = index.openScan(&low, GTE, &high, LT,
+                                              NORMAL_ACCESS, ASCENDING, true);
+      numScanned += scan(cursor);
+      numScans++;
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    writer.join();
+    std::cout << "snapshot scans during inserts: "
+              << elapsed.count() * 1e9 / numScanned << "ns per entry over "
+              << numScans << " scans, " << insertRate << " inserts/s, "
+              << index.getCounters().pagesSaved << " pages saved"
+              << std::endl;
+    checkPassFail(firstRids, (std::size_t)(numRecords + numInserts));
+  }
+  delete pool;
+  deleteIndexFile();
+  deleteRelation();
+}
+
+void bench58_partitioned_index() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench58_partitioned_index" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 500000, numPartitions = 4, numLookups = 100000;
+  createRelationRandom(numRecords);
+  std::vector<int> keys(numLookups);
+  std::srand(58);
+  for (int &key : keys) key = std::rand() % numRecords;
+  int low = 0, high = numRecords;
+
+  // a single tree against range and hash partitions, built and scanned on a
+  // thread per partition, in a concurrent pool holding them all
+  BufMgr *pool = new BufMgr(10000, true);
+  std::size_t plainEntries = 0;
+  {
+    auto start = std::chrono::steady_clock::now();
+    BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i),
+                     INTEGER);
+    std::chrono::duration<double> build =
+        std::chrono::steady_clock::now() - start;
+    std::vector<RecordId> rids;
+    start = std::chrono::steady_clock::now();
+    index.scanRange(&low, GTE, &high, LT, rids);
+    std::chrono::duration<double> scan =
+        std::chrono::steady_clock::now() - start;
+    RecordId rid;
+    start = std::chrono::steady_clock::now();
+    for (int key : keys) index.lookup(&key, &rid, 1);
+    std::chrono::duration<double> lookups =
+        std::chrono::steady_clock::now() - start;
+    plainEntries = rids.size();
+    std::cout << "one tree: build " << build.count() * 1e3 << "ms, scan "
+              << scan.count() * 1e9 / rids.size() << "ns per entry, lookup "
+              << lookups.count() * 1e9 / numLookups << "ns" << std::endl;
+  }
+  File::remove(intIndexName);
+
+  for (PartitionMethod method : {RANGE_PARTITIONS, HASH_PARTITIONS}) {
+    std::string catalogName;
+    {
+      auto start = std::chrono::steady_clock::now();
+      PartitionedIndex index(relationName, catalogName, pool,
+                             offsetof(tuple, i), INTEGER, method,
+                             numPartitions);
+      std::chrono::duration<double> build =
+          std::chrono::steady_clock::now() - start;
+      std::vector<RecordId> rids;
+      start = std::chrono::steady_clock::now();
+      index.scanRange(&low, GTE, &high, LT, rids);
+      std::chrono::duration<double> scan =
+          std::chrono::steady_clock::now() - start;
+      start = std::chrono::steady_clock::now();
+      PartitionScanCursor cursor = index.openScan(&low, GTE, &high, LT);
+      std::vector<RecordId> batch(1000);
+      std::size_t numScanned = 0, n;
+      while ((n = cursor.scanNextBatch(batch.data(), batch.size())) > 0)
+        numScanned += n;
+      std::chrono::duration<double> cursorScan =
+          std::chrono::steady_clock::now() - start;
+      RecordId rid;
+      start = std::chrono::steady_clock::now();
+      for (int key : keys) index.lookup(&key, &rid, 1);
+      std::chrono::duration<double> lookups =
+          std::chrono::steady_clock::now() - start;
+      std::cout << numPartitions
+                << (method == RANGE_PARTITIONS ? " range" : " hash")
+                << " partitions: build " << build.count() * 1e3
+                << "ms, parallel scan " << scan.count() * 1e9 / rids.size()
+                << "ns per entry, cursor scan "
+                << cursorScan.count() * 1e9 / numScanned
+                << "ns per entry, lookup "
+                << lookups.count() * 1e9 / numLookups << "ns" << std::endl;
+      checkPassFail(rids.size(), plainEntries);
+      checkPassFail(numScanned, plainEntries);
+    }
+    for (int p = 0; p < numPartitions; p++)
+      File::remove(catalogName + ',' + std::to_string(p));
+    File::remove(catalogName);
+  }
+  delete pool;
+  deleteRelation();
+}
+
+void bench59_index_service() {
+  std::cout << "---------------------" << std::endl;
+  std::cout << "bench59_index_service" << std::endl;
+  deleteIndexFile();
+  const int numRecords = 200000, numLookups = 20000, batch = 100;
+  createRelationRandom(numRecords);
+  std::vector<int> keys(numLookups);
+  std::srand(59);
+  for (int &key : keys) key = std::rand() % numRecords;
+
+  // lookups in process, then over loopback one round trip at a time,
+  // pipelined in batches, and as probes of a batch of keys each
+  BufMgr *pool = new BufMgr(10000, true);
+  std::string indexName;
+  std::chrono::duration<double> inProcess;
+  {
+    BTreeIndex direct(relationName, indexName, pool, offsetof(tuple, i),
+                      INTEGER, BULK_BUILD, DEFAULT_FILL_FACTOR, true);
+    RecordId rid;
+    const auto start = std::chrono::steady_clock::now();
+    for (int key : keys) direct.lookup(&key, &rid, 1);
+    inProcess = std::chrono::steady_clock::now() - start;
+  }
+  {
+    IndexService service(pool);
+    const int index = service.addIndex(
+        relationName, {KeyColumn{offsetof(tuple, i), INTEGER}});
+    const int port = service.bind(0);
+    std::thread server([&service] { service.run(); });
+    ServiceClient client("127.0.0.1", port);
+    std::size_t numFound = 0;
+    auto count = [&numFound](const ServiceClient::Response &response) {
+      std::size_t pos = 4;
+      numFound += ServiceClient::readEntries(response, pos, false).size();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int key : keys) {
+      client.addLookup(index, &key, sizeof(key), 1);
+      count(client.next());
+    }
+    std::chrono::duration<double> single =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(numFound, (std::size_t)numLookups);
+
+    numFound = 0;
+    start = std::chrono::steady_clock::now();
+    for (int first = 0; first < numLookups; first += batch) {
+      for (int i = first; i < first + batch; i++)
+        client.addLookup(index, &keys[i], sizeof(int), 1);
+      for (int i = 0; i < batch; i++) count(client.next());
+    }
+    std::chrono::duration<double> pipelined =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(numFound, (std::size_t)numLookups);
+
+    numFound = 0;
+    start = std::chrono::steady_clock::now();
+    for (int first = 0; first < numLookups; first += batch) {
+      client.addProbe(index, &keys[first], batch, sizeof(int), 1);
+      const ServiceClient::Response response = client.next();
+      std::size_t pos = 0;
+      for (int i = 0; i < batch; i++) {
+        pos += 4;
+        numFound += ServiceClient::readEntries(response, pos, false).size();
+      }
+    }
+    std::chrono::duration<double> probes =
+        std::chrono::steady_clock::now() - start;
+    checkPassFail(numFound, (std::size_t)numLookups);
+
+    std::cout << "one at a time: " << numLookups / single.count()
+              << " lookups/s" << std::endl;
+    std::cout << "pipelined by " << batch << ": "
+              << numLookups / pipelined.count() << " lookups/s" << std::endl;
+    std::cout << "probes of " << batch << ": " << numLookups / probes.count()
+              << " lookups/s" << std::endl;
+    std::cout << "in process: " << numLookups / inProcess.count()
+              << " lookups/s" << std::endl;
+    service.stop();
+    server.join();
+  }
+  File::remove(indexName);
+  delete pool;
+  deleteRelation();
+}
+
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+// ######################    Create Relation    ######################## //
+// ##################################################################### //
+// ##################################################################### //
+// ##################################################################### //
+
+void createRelationForward(int relationSize) {
+  std::vector<RecordId> ridVec;
+  // destroy any old copies of relation file
+  try {
+    File::remove(relationName);
+  } catch (FileNotFoundException e) {
+  }
+
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+  PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for (int i = 0; i < relationSize; i++) {
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = (double)i;
+    std::string new_data(reinterpret_cast<char *>(&record1), sizeof(record1));
+
+    while (1) {
+      try {
+        new_page.insertRecord(new_data);
+        break;
+      } catch (InsufficientSpaceException e) {
+        file1->writePage(new_page_number, new_page);
+        new_page = file1->allocatePage(new_page_number);
+      }
+    }
+  }
+
+  file1->writePage(new_page_number, new_page);
+}
+
+void createRelationBackward(int relationSize) {
+  // destroy any old copies of relation file
+  try {
+    File::remove(relationName);
+  } catch (FileNotFoundException e) {
+  }
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+  PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for (int i = relationSize - 1; i >= 0; i--) {
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = i;
+
+    std::string new_data(reinterpret_cast<char *>(&record1), sizeof(RECORD));
+
+    while (1) {
+      try {
+        new_page.insertRecord(new_data);
+        break;
+      } catch (InsufficientSpaceException e) {
+        file1->writePage(new_page_number, new_page);
+        new_page = file1->allocatePage(new_page_number);
+      }
+    }
+  }
+
+  file1->writePage(new_page_number, new_page);
+}
+
+void createRelationRandom(int relationSize) {
+  // destroy any old copies of relation file
+  try {
+    File::remove(relationName);
+  } catch (FileNotFoundException e) {
+  }
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+  PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // insert records in random order
+
+  std::vector<int> intvec(relationSize);
+  for (int i = 0; i < relationSize; i++) {
+    intvec[i] = i;
+  }
+
+  long pos;
+  int val;
+  int i = 0;
+  while (i < relationSize) {
+    pos = random() % (relationSize - i);
+    val = intvec[pos];
+    sprintf(record1.s, "%05d string record", val);
+    record1.i = val;
+    record1.d = val;
+
+    std::string new_data(reinterpret_cast<char *>(&record1), sizeof(RECORD));
+
+    while (1) {
+      try {
+        new_page.insertRecord(new_data);
+        break;
+      } catch (InsufficientSpaceException e) {
+        file1->writePage(new_page_number, new_page);
+        new_page = file1->allocatePage(new_page_number);
+      }
+    }
+
+    int temp = intvec[relationSize - 1 - i];
+    intvec[relationSize - 1 - i] = intvec[pos];
+    intvec[pos] = temp;
+    i++;
+  }
+
+  file1->writePage(new_page_number, new_page);
+}
 
-void createRelationForward(int relationSize) {
-  std::vector<RecordId> ridVec;
+void createRelationItemIds(int relationSize) {
   // destroy any old copies of relation file
   try {
     File::remove(relationName);
   } catch (FileNotFoundException e) {
   }
-
   file1 = new PageFile(relationName, true);
 
   // initialize all of record1.s to keep purify happy
@@ -342,12 +10071,21 @@ void createRelationForward(int relationSize) {
   PageId new_page_number;
   Page new_page = file1->allocatePage(new_page_number);
 
-  // Insert a bunch of tuples into the relation.
+  // insert records in random order, with ten-digit item ids like the ones of
+  // the eBay data as their string field
+  std::vector<int> intvec(relationSize);
   for (int i = 0; i < relationSize; i++) {
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = (double)i;
-    std::string new_data(reinterpret_cast<char *>(&record1), sizeof(record1));
+    intvec[i] = i;
+  }
+  srand(1);
+  std::random_shuffle(intvec.begin(), intvec.end());
+
+  for (int val : intvec) {
+    sprintf(record1.s, "%010d", 1043000000 + val);
+    record1.i = val;
+    record1.d = val;
+
+    std::string new_data(reinterpret_cast<char *>(&record1), sizeof(RECORD));
 
     while (1) {
       try {
@@ -363,7 +10101,7 @@ void createRelationForward(int relationSize) {
   file1->writePage(new_page_number, new_page);
 }
 
-void createRelationBackward(int relationSize) {
+void createRelationCategories(int relationSize, int numCategories) {
   // destroy any old copies of relation file
   try {
     File::remove(relationName);
@@ -376,11 +10114,19 @@ void createRelationBackward(int relationSize) {
   PageId new_page_number;
   Page new_page = file1->allocatePage(new_page_number);
 
-  // Insert a bunch of tuples into the relation.
-  for (int i = relationSize - 1; i >= 0; i--) {
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = i;
+  // insert records in random order, whose fields hold one of a few
+  // categories, so that each category is the key of many of them
+  std::vector<int> intvec(relationSize);
+  for (int i = 0; i < relationSize; i++) {
+    intvec[i] = i % numCategories;
+  }
+  srand(1);
+  std::random_shuffle(intvec.begin(), intvec.end());
+
+  for (int val : intvec) {
+    sprintf(record1.s, "%05d string record", val);
+    record1.i = val;
+    record1.d = val;
 
     std::string new_data(reinterpret_cast<char *>(&record1), sizeof(RECORD));
 
@@ -398,7 +10144,7 @@ void createRelationBackward(int relationSize) {
   file1->writePage(new_page_number, new_page);
 }
 
-void createRelationRandom(int relationSize) {
+void createRelationSellers(int relationSize, int numSellers) {
   // destroy any old copies of relation file
   try {
     File::remove(relationName);
@@ -411,22 +10157,20 @@ void createRelationRandom(int relationSize) {
   PageId new_page_number;
   Page new_page = file1->allocatePage(new_page_number);
 
-  // insert records in random order
-
+  // insert records in random order, each of one of a few sellers, as its
+  // integer field, and of a rank among the records of the seller, as its
+  // double and string fields
   std::vector<int> intvec(relationSize);
   for (int i = 0; i < relationSize; i++) {
     intvec[i] = i;
   }
+  srand(1);
+  std::random_shuffle(intvec.begin(), intvec.end());
 
-  long pos;
-  int val;
-  int i = 0;
-  while (i < relationSize) {
-    pos = random() % (relationSize - i);
-    val = intvec[pos];
-    sprintf(record1.s, "%05d string record", val);
-    record1.i = val;
-    record1.d = val;
+  for (int val : intvec) {
+    sprintf(record1.s, "%05d string record", val / numSellers);
+    record1.i = val % numSellers;
+    record1.d = val / numSellers;
 
     std::string new_data(reinterpret_cast<char *>(&record1), sizeof(RECORD));
 
@@ -439,16 +10183,49 @@ void createRelationRandom(int relationSize) {
         new_page = file1->allocatePage(new_page_number);
       }
     }
-
-    int temp = intvec[relationSize - 1 - i];
-    intvec[relationSize - 1 - i] = intvec[pos];
-    intvec[pos] = temp;
-    i++;
   }
 
   file1->writePage(new_page_number, new_page);
 }
 
+void createRelationBids(const std::string &name, int numBids, int numItems) {
+  // destroy any old copies of relation file
+  try {
+    File::remove(name);
+  } catch (FileNotFoundException e) {
+  }
+  PageFile bids(name, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+  PageId new_page_number;
+  Page new_page = bids.allocatePage(new_page_number);
+
+  // bids on items drawn at random, whose fields all hold the item id as
+  // those of createRelationRandom() do
+  srand(2);
+  for (int bid = 0; bid < numBids; bid++) {
+    const int val = rand() % numItems;
+    sprintf(record1.s, "%05d string record", val);
+    record1.i = val;
+    record1.d = val;
+
+    std::string new_data(reinterpret_cast<char *>(&record1), sizeof(RECORD));
+
+    while (1) {
+      try {
+        new_page.insertRecord(new_data);
+        break;
+      } catch (InsufficientSpaceException e) {
+        bids.writePage(new_page_number, new_page);
+        new_page = bids.allocatePage(new_page_number);
+      }
+    }
+  }
+
+  bids.writePage(new_page_number, new_page);
+}
+
 // p = (rate - 1) / rate
 bool randBool(int rate) { return (rand() % rate) == 0; }
 
@@ -602,6 +10379,8 @@ void test9_error_test() {
 // ##################################################################### //
 void indexTests() {
   intTests();
+  doubleTests();
+  stringTests();
   deleteIndexFile();
 }
 
@@ -622,6 +10401,16 @@ void deleteIndexFile() {
     File::remove(intIndexName);
   } catch (FileNotFoundException e) {
   }
+
+  try {
+    File::remove(doubleIndexName);
+  } catch (FileNotFoundException e) {
+  }
+
+  try {
+    File::remove(stringIndexName);
+  } catch (FileNotFoundException e) {
+  }
 }
 
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
@@ -656,8 +10445,8 @@ int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
     try {
       index->scanNext(scanRid);
       bufMgr->readPage(file1, scanRid.page_number, curPage);
-      RECORD myRec = *(
-          reinterpret_cast<const RECORD *>(curPage->getRecord(scanRid).data()));
+      RECORD myRec = *(reinterpret_cast<const RECORD *>(
+          curPage->getRecordView(scanRid).data));
       bufMgr->unPinPage(file1, scanRid.page_number, false);
 
       if (ret_vector) ret_vector->push_back(myRec.i);
@@ -683,4 +10472,280 @@ int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
   std::cout << std::endl;
 
   return numResults;
-}
\ No newline at end of file
+}
+
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp,
+               double highVal, Operator highOp) {
+  RecordId scanRid;
+  Page *curPage;
+
+  std::cout << "Scan for ";
+  if (lowOp == GT) {
+    std::cout << "(";
+  } else {
+    std::cout << "[";
+  }
+  std::cout << lowVal << "," << highVal;
+  if (highOp == LT) {
+    std::cout << ")";
+  } else {
+    std::cout << "]";
+  }
+  std::cout << std::endl;
+
+  int numResults = 0;
+
+  try {
+    index->startScan(&lowVal, lowOp, &highVal, highOp);
+  } catch (NoSuchKeyFoundException e) {
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+    return 0;
+  }
+
+  while (1) {
+    try {
+      index->scanNext(scanRid);
+      bufMgr->readPage(file1, scanRid.page_number, curPage);
+      RECORD myRec = *(reinterpret_cast<const RECORD *>(
+          curPage->getRecordView(scanRid).data));
+      bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+      if (numResults < 5) {
+        std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+        std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s
+                  << ":" << std::endl;
+      } else if (numResults == 5) {
+        std::cout << "..." << std::endl;
+      }
+    } catch (IndexScanCompletedException e) {
+      break;
+    }
+
+    numResults++;
+  }
+
+  if (numResults >= 5) {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+
+  return numResults;
+}
+
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
+               Operator highOp) {
+  RecordId scanRid;
+  Page *curPage;
+
+  std::cout << "Scan for ";
+  if (lowOp == GT) {
+    std::cout << "(";
+  } else {
+    std::cout << "[";
+  }
+  std::cout << lowVal << "," << highVal;
+  if (highOp == LT) {
+    std::cout << ")";
+  } else {
+    std::cout << "]";
+  }
+  std::cout << std::endl;
+
+  // the keys are the first STRINGSIZE characters of the string field
+  char lowValStr[100];
+  sprintf(lowValStr, "%05d string record", lowVal);
+  char highValStr[100];
+  sprintf(highValStr, "%05d string record", highVal);
+
+  int numResults = 0;
+
+  try {
+    index->startScan(lowValStr, lowOp, highValStr, highOp);
+  } catch (NoSuchKeyFoundException e) {
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+    return 0;
+  }
+
+  while (1) {
+    try {
+      index->scanNext(scanRid);
+      bufMgr->readPage(file1, scanRid.page_number, curPage);
+      RECORD myRec = *(reinterpret_cast<const RECORD *>(
+          curPage->getRecordView(scanRid).data));
+      bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+      if (numResults < 5) {
+        std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+        std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s
+                  << ":" << std::endl;
+      } else if (numResults == 5) {
+        std::cout << "..." << std::endl;
+      }
+    } catch (IndexScanCompletedException e) {
+      break;
+    }
+
+    numResults++;
+  }
+
+  if (numResults >= 5) {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+
+  return numResults;
+}
+
+int countScan(BTreeIndex *index, const void *lowVal, Operator lowOp,
+              const void *highVal, Operator highOp) {
+  RecordId scanRid;
+  int numResults = 0;
+
+  try {
+    index->startScan(lowVal, lowOp, highVal, highOp);
+  } catch (NoSuchKeyFoundException e) {
+    return 0;
+  }
+
+  try {
+    while (1) {
+      index->scanNext(scanRid);
+      numResults++;
+    }
+  } catch (IndexScanCompletedException e) {
+  }
+  index->endScan();
+
+  return numResults;
+}
+
+std::vector<RecordId> scanRids(BTreeIndex *index, const void *lowVal,
+                               Operator lowOp, const void *highVal,
+                               Operator highOp, ScanOrder order) {
+  std::vector<RecordId> rids;
+  try {
+    index->startScan(lowVal, lowOp, highVal, highOp, NORMAL_ACCESS, order);
+  } catch (NoSuchKeyFoundException e) {
+    return rids;
+  }
+
+  RecordId scanRid;
+  try {
+    while (1) {
+      index->scanNext(scanRid);
+      rids.push_back(scanRid);
+    }
+  } catch (IndexScanCompletedException e) {
+  }
+  index->endScan();
+  return rids;
+}
+
+std::vector<RecordId> batchScanRids(BTreeIndex *index, const void *lowVal,
+                                    Operator lowOp, const void *highVal,
+                                    Operator highOp, std::size_t batchSize,
+                                    ScanOrder order) {
+  std::vector<RecordId> rids;
+  try {
+    index->startScan(lowVal, lowOp, highVal, highOp, NORMAL_ACCESS, order);
+  } catch (NoSuchKeyFoundException e) {
+    return rids;
+  }
+
+  std::size_t numRids;
+  do {
+    rids.resize(rids.size() + batchSize);
+    numRids = index->scanNextBatch(&rids[rids.size() - batchSize], batchSize);
+    rids.resize(rids.size() - batchSize + numRids);
+  } while (numRids == batchSize);
+  index->endScan();
+  return rids;
+}
+
+std::vector<std::pair<int, RecordId>> relationEntries(
+    const std::string &name) {
+  std::vector<std::pair<int, RecordId>> entries;
+  FileScan fscan(name, bufMgr);
+  try {
+    RecordId scanRid;
+    while (1) {
+      fscan.scanNext(scanRid);
+      const RECORD *record = (const RECORD *)fscan.getRecordView().data;
+      entries.push_back(std::make_pair(record->i, scanRid));
+    }
+  } catch (EndOfFileException e) {
+  }
+  return entries;
+}
+
+void stringIndexShape(const std::string &indexName, int &height,
+                      int &numLeaves) {
+  BlobFile indexFile(indexName, false);
+  Page *page;
+
+  // the meta page is the first page of the index file
+  PageId pageNo = indexFile.getFirstPageNo();
+  bufMgr->readPage(&indexFile, pageNo, page);
+  PageId childPageNo = ((IndexMetaInfo *)page)->rootPageNo;
+  bufMgr->unPinPage(&indexFile, pageNo, false);
+
+  // walk down the leftmost path, then along the leaves
+  for (height = 1;; height++) {
+    pageNo = childPageNo;
+    bufMgr->readPage(&indexFile, pageNo, page);
+    bool leaf = ((NonLeafNodeString *)page)->level == -1;
+    childPageNo = ((NonLeafNodeString *)page)->pageNoArray[0];
+    bufMgr->unPinPage(&indexFile, pageNo, false);
+    if (leaf) break;
+  }
+  for (numLeaves = 0; pageNo != 0; numLeaves++) {
+    bufMgr->readPage(&indexFile, pageNo, page);
+    PageId nextPageNo = ((LeafNodeString *)page)->rightSibPageNo;
+    bufMgr->unPinPage(&indexFile, pageNo, false);
+    pageNo = nextPageNo;
+  }
+  bufMgr->flushFile(&indexFile);
+}
+
+// true if the directory of every internal node of an INTEGER index matches
+// its keys
+bool intDirectoriesMatch(BlobFile &indexFile, PageId pageNo) {
+  Page *page;
+  bufMgr->readPage(&indexFile, pageNo, page);
+  const NonLeafNodeInt *node = (const NonLeafNodeInt *)page;
+  bool match = true;
+  if (node->level != -1) {
+    std::vector<int> blockKeys(INTNONLEAFBLOCKS), lineKeys(INTNONLEAFLINES);
+    indexIntKeys(node->keyArray, node->numKeys, blockKeys.data(),
+                 lineKeys.data());
+    const int numBlocks =
+        (node->numKeys + INTKEYBLOCKSIZE - 1) / INTKEYBLOCKSIZE;
+    const int numLines = (numBlocks + INTKEYBLOCKSIZE - 1) / INTKEYBLOCKSIZE;
+    match = std::equal(blockKeys.begin(), blockKeys.begin() + numBlocks,
+                       node->blockKeys) &&
+            std::equal(lineKeys.begin(), lineKeys.begin() + numLines,
+                       node->lineKeys);
+    std::vector<PageId> children(node->pageNoArray,
+                                 node->pageNoArray + node->numKeys + 1);
+    bufMgr->unPinPage(&indexFile, pageNo, false);
+    for (PageId childPageNo : children)
+      match &= intDirectoriesMatch(indexFile, childPageNo);
+  } else {
+    bufMgr->unPinPage(&indexFile, pageNo, false);
+  }
+  return match;
+}
+
+bool intDirectoriesMatch(const std::string &indexName) {
+  BlobFile indexFile(indexName, false);
+  Page *page;
+  const PageId metaPageNo = indexFile.getFirstPageNo();
+  bufMgr->readPage(&indexFile, metaPageNo, page);
+  const PageId rootPageNo = ((IndexMetaInfo *)page)->rootPageNo;
+  bufMgr->unPinPage(&indexFile, metaPageNo, false);
+  const bool match = intDirectoriesMatch(indexFile, rootPageNo);
+  bufMgr->flushFile(&indexFile);
+  return match;
+}
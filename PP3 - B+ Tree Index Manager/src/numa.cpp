@@ -0,0 +1,115 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "numa.h"
+
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+namespace {
+
+thread_local int threadNode = -1;
+
+// parses a CPU list such as "0-3,8-11"
+std::vector<int> parseCpuList(const std::string &text) {
+  std::vector<int> cpus;
+  std::stringstream ranges(text);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    if (range.empty() || range == "\n") continue;
+    const std::size_t dash = range.find('-');
+    const int first = std::atoi(range.c_str());
+    const int last =
+        dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+    for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+}  // namespace
+
+NumaTopology::NumaTopology(const std::vector<std::vector<int>> &cpus)
+    : cpuLists(cpus) {
+  if (cpuLists.empty()) cpuLists.emplace_back();
+  for (std::uint32_t node = 0; node < cpuLists.size(); node++) {
+    for (int cpu : cpuLists[node]) {
+      if ((std::size_t)cpu >= cpuNodes.size()) cpuNodes.resize(cpu + 1, 0);
+      cpuNodes[cpu] = node;
+    }
+  }
+}
+
+const NumaTopology &NumaTopology::system() {
+  static const NumaTopology topology = [] {
+    std::vector<int> ids;
+    if (DIR *dir = opendir("/sys/devices/system/node")) {
+      while (struct dirent *entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name.compare(0, 4, "node") == 0 && name.size() > 4 &&
+            std::isdigit((unsigned char)name[4])) {
+          ids.push_back(std::atoi(name.c_str() + 4));
+        }
+      }
+      closedir(dir);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    std::vector<std::vector<int>> cpus;
+    for (int id : ids) {
+      std::ifstream list("/sys/devices/system/node/node" + std::to_string(id) +
+                         "/cpulist");
+      std::string text;
+      std::getline(list, text);
+      cpus.push_back(parseCpuList(text));
+    }
+    NumaTopology topology(cpus);
+    if (ids.size() > 1) topology.systemIds = ids;
+    return topology;
+  }();
+  return topology;
+}
+
+std::uint32_t NumaTopology::currentNode() const {
+  if (threadNode >= 0) return threadNode % nodes();
+  return nodes() == 1 ? 0 : nodeOf(sched_getcpu());
+}
+
+void NumaTopology::setThreadNode(int node) { threadNode = node; }
+
+bool NumaTopology::runOn(std::uint32_t node) const {
+  if (cpuLists[node].empty()) return false;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpuLists[node]) CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool NumaTopology::bindMemory(void *start, std::size_t length,
+                              std::uint32_t node) const {
+  if (systemIds.empty()) return false;
+  const int id = systemIds[node];
+  std::vector<unsigned long> mask(id / (8 * sizeof(unsigned long)) + 1, 0);
+  mask[id / (8 * sizeof(unsigned long))] |=
+      1UL << (id % (8 * sizeof(unsigned long)));
+  return syscall(SYS_mbind, start, length, MPOL_PREFERRED, mask.data(),
+                 mask.size() * 8 * sizeof(unsigned long), 0) == 0;
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,113 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * @brief The NUMA nodes of a machine and the CPUs of each, by which a buffer
+ * manager partitions its frames.
+ *
+ * The topology of the machine is read from /sys/devices/system/node; without
+ * it, the machine has a single node holding every CPU.  A topology may also be
+ * built by hand, to partition a buffer pool as if the machine had other nodes;
+ * no memory is bound to the nodes of such a topology.
+ */
+class NumaTopology {
+ public:
+  /**
+   * Returns the topology of the machine, read once.
+   */
+  static const NumaTopology &system();
+
+  /**
+   * Builds a topology by hand.
+   *
+   * @param cpus  CPUs of each node; a CPU listed by no node is on node 0
+   */
+  explicit NumaTopology(const std::vector<std::vector<int>> &cpus);
+
+  /**
+   * Returns the number of nodes, at least 1.
+   */
+  std::uint32_t nodes() const { return cpuLists.size(); }
+
+  /**
+   * Returns the CPUs of the given node.
+   */
+  const std::vector<int> &cpus(std::uint32_t node) const {
+    return cpuLists[node];
+  }
+
+  /**
+   * Returns the node of the given CPU.
+   */
+  std::uint32_t nodeOf(int cpu) const {
+    return cpu >= 0 && (std::size_t)cpu < cpuNodes.size() ? cpuNodes[cpu] : 0;
+  }
+
+  /**
+   * Returns the node the calling thread runs on, or was set to by
+   * setThreadNode().
+   */
+  std::uint32_t currentNode() const;
+
+  /**
+   * Makes the calling thread count as running on the given node of every
+   * topology, whichever CPU it runs on; -1 to go back to its CPU.
+   *
+   * @param node  Node of the thread
+   */
+  static void setThreadNode(int node);
+
+  /**
+   * Lets the calling thread run only on the CPUs of the given node.
+   *
+   * @param node  Node to run on
+   * @return  False if the system did not allow it
+   */
+  bool runOn(std::uint32_t node) const;
+
+  /**
+   * Asks the system to place the memory of the given range on the given node
+   * when it is first touched, falling back to other nodes once it is full.
+   * Nothing is done for a topology built by hand.
+   *
+   * @param start   Start of the range, aligned to a system page
+   * @param length  Bytes of the range
+   * @param node    Node to place the memory on
+   * @return  False if the memory was not bound
+   */
+  bool bindMemory(void *start, std::size_t length, std::uint32_t node) const;
+
+ private:
+  NumaTopology() {}
+
+  /**
+   * CPUs of each node
+   */
+  std::vector<std::vector<int>> cpuLists;
+
+  /**
+   * Node of each CPU
+   */
+  std::vector<std::uint32_t> cpuNodes;
+
+  /**
+   * Numbers the system gives the nodes, which may have gaps; empty for a
+   * topology built by hand
+   */
+  std::vector<int> systemIds;
+};
+
+}  // namespace badgerdb
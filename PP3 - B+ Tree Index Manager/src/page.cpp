@@ -7,8 +7,13 @@
  */
 
 #include <cassert>
+#include <cstddef>
 
 #include <iostream>
+#include <vector>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_record_exception.h"
 #include "exceptions/invalid_slot_exception.h"
@@ -19,6 +24,97 @@
 
 namespace badgerdb {
 
+// the checksum covers the page up to itself, the data first
+static_assert(offsetof(PageHeader, checksum) + sizeof(std::uint32_t) ==
+                  sizeof(PageHeader),
+              "The checksum must end the page header.");
+static_assert(Page::DATA_SIZE + offsetof(PageHeader, checksum) ==
+                  Page::BLOB_SIZE,
+              "The checksum must end the page.");
+
+// CRC32C (Castagnoli) polynomial, bit-reflected
+static const std::uint32_t CRC32C_POLY = 0x82f63b78;
+
+static std::uint32_t crc32cSoftware(std::uint32_t crc, const char *data,
+                                    std::size_t len) {
+  static std::uint32_t table[256];
+  static const bool filled = [] {
+    for (std::uint32_t i = 0; i < 256; i++) {
+      std::uint32_t entry = i;
+      for (int bit = 0; bit < 8; bit++)
+        entry = (entry >> 1) ^ (CRC32C_POLY & (0u - (entry & 1)));
+      table[i] = entry;
+    }
+    return true;
+  }();
+  (void)filled;
+  for (std::size_t i = 0; i < len; i++)
+    crc = table[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#if defined(__x86_64__)
+// bytes of each of the three streams the hardware CRC runs at once; a CRC
+// instruction takes three cycles but a new one can start every cycle
+static const std::size_t CRC32C_STRIDE = 1360;
+
+// moves a CRC32C register past CRC32C_STRIDE zero bytes, so that the CRCs of
+// consecutive streams can be combined
+static std::uint32_t crc32cShift(std::uint32_t crc) {
+  static std::uint32_t table[4][256];
+  static const bool filled = [] {
+    const std::vector<char> zeros(CRC32C_STRIDE, 0);
+    for (int byte = 0; byte < 4; byte++)
+      for (std::uint32_t i = 0; i < 256; i++)
+        table[byte][i] = crc32cSoftware(i << (8 * byte), zeros.data(),
+                                        zeros.size());
+    return true;
+  }();
+  (void)filled;
+  return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^
+         table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+__attribute__((target("sse4.2"))) static std::uint32_t crc32cHardware(
+    std::uint32_t crc, const char *data, std::size_t len) {
+  std::size_t i = 0;
+  for (; len - i >= 3 * CRC32C_STRIDE; i += 3 * CRC32C_STRIDE) {
+    std::uint64_t first = crc, second = 0, third = 0;
+    for (std::size_t j = i; j < i + CRC32C_STRIDE; j += 8) {
+      std::uint64_t words[3];
+      memcpy(&words[0], data + j, 8);
+      memcpy(&words[1], data + j + CRC32C_STRIDE, 8);
+      memcpy(&words[2], data + j + 2 * CRC32C_STRIDE, 8);
+      first = _mm_crc32_u64(first, words[0]);
+      second = _mm_crc32_u64(second, words[1]);
+      third = _mm_crc32_u64(third, words[2]);
+    }
+    crc = crc32cShift(crc32cShift((std::uint32_t)first) ^
+                      (std::uint32_t)second) ^
+          (std::uint32_t)third;
+  }
+  std::uint64_t wide = crc;
+  for (; i + sizeof(std::uint64_t) <= len; i += sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    wide = _mm_crc32_u64(wide, word);
+  }
+  crc = (std::uint32_t)wide;
+  for (; i < len; i++) crc = _mm_crc32_u8(crc, (unsigned char)data[i]);
+  return crc;
+}
+#endif
+
+// continues a CRC32C, without its final inversion, over more bytes
+static std::uint32_t crc32c(std::uint32_t crc, const char *data,
+                            std::size_t len) {
+#if defined(__x86_64__)
+  static const bool hardware = __builtin_cpu_supports("sse4.2");
+  if (hardware) return crc32cHardware(crc, data, len);
+#endif
+  return crc32cSoftware(crc, data, len);
+}
+
 Page::Page() { initialize(); }
 
 void Page::initialize() {
@@ -26,8 +122,10 @@ void Page::initialize() {
   header_.free_space_upper_bound = DATA_SIZE;
   header_.num_slots = 0;
   header_.num_free_slots = 0;
+  header_.first_free_slot = INVALID_SLOT;
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
+  header_.checksum = 0;
   // data_.assign(DATA_SIZE, char());
   memset(data_, '\0', DATA_SIZE);
 }
@@ -38,23 +136,63 @@ RecordId Page::insertRecord(const std::string &record_data) {
                                      getFreeSpace());
   }
   const SlotId slot_number = getAvailableSlot();
+  if (record_data.length() > getContiguousFreeSpace()) compact();
   insertRecordInSlot(slot_number, record_data);
   return {page_number(), slot_number};
 }
 
+SlotId Page::appendRecord(const char *record_data, const std::size_t length) {
+  if (length + sizeof(PageSlot) > getContiguousFreeSpace()) return INVALID_SLOT;
+  const SlotId slot_number = ++header_.num_slots;
+  header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+  header_.free_space_upper_bound -= length;
+  PageSlot *slot = getSlot(slot_number);
+  slot->used = true;
+  slot->item_offset = header_.free_space_upper_bound;
+  slot->item_length = length;
+  memcpy(&data_[slot->item_offset], record_data, length);
+  return slot_number;
+}
+
 std::string Page::getRecord(const RecordId &record_id) const {
+  return getRecordView(record_id).str();
+}
+
+RecordView Page::getRecordView(const RecordId &record_id) const {
   validateRecordId(record_id);
   const PageSlot &slot = getSlot(record_id.slot_number);
-  std::string retStr =
-      std::string(data_, DATA_SIZE).substr(slot.item_offset, slot.item_length);
-
-  return retStr;
+  return RecordView{data_ + slot.item_offset, slot.item_length};
 }
 
 void Page::updateRecord(const RecordId &record_id,
                         const std::string &record_data) {
   validateRecordId(record_id);
-  const PageSlot *slot = getSlot(record_id.slot_number);
+  PageSlot *slot = getSlot(record_id.slot_number);
+  const std::uint16_t record_length = record_data.length();
+  if (slot->item_offset == header_.free_space_upper_bound &&
+      record_length <= slot->item_length + getContiguousFreeSpace()) {
+    // The record borders the free space, so it keeps its end and grows into
+    // the free space or shrinks away from it.
+    const std::uint16_t end = slot->item_offset + slot->item_length;
+    if (end - record_length > slot->item_offset) {
+      memset(&data_[slot->item_offset], '\0',
+             end - record_length - slot->item_offset);
+    }
+    slot->item_offset = end - record_length;
+    slot->item_length = record_length;
+    header_.free_space_upper_bound = slot->item_offset;
+    memcpy(&data_[slot->item_offset], record_data.data(), record_length);
+    return;
+  }
+  if (record_length <= slot->item_length) {
+    // Shrink in place, leaving a hole after the record.
+    memcpy(&data_[slot->item_offset], record_data.data(), record_length);
+    memset(&data_[slot->item_offset + record_length], '\0',
+           slot->item_length - record_length);
+    slot->item_length = record_length;
+    return;
+  }
+
   const std::size_t free_space_after_delete =
       getFreeSpace() + slot->item_length;
   if (record_data.length() > free_space_after_delete) {
@@ -65,6 +203,7 @@ void Page::updateRecord(const RecordId &record_id,
   // record data in the same slot, and compaction might delete the slot if we
   // permit it.
   deleteRecord(record_id, false /* allow_slot_compaction */);
+  if (record_length > getContiguousFreeSpace()) compact();
   insertRecordInSlot(record_id.slot_number, record_data);
 }
 
@@ -77,72 +216,89 @@ void Page::deleteRecord(const RecordId &record_id,
   validateRecordId(record_id);
   PageSlot *slot = getSlot(record_id.slot_number);
 
-  for (int i = 0; i < slot->item_length; i++)
-    data_[i + slot->item_offset] = '\0';
-
-  // data_.replace(slot->item_offset, slot->item_length, slot->item_length,
-  // '\0');
-
-  // Compact the data by removing the hole left by this record (if necessary).
-  std::uint16_t move_offset = slot->item_offset;
-  std::size_t move_bytes = 0;
-  for (SlotId i = 1; i <= header_.num_slots; ++i) {
-    PageSlot *other_slot = getSlot(i);
-    if (other_slot->used && other_slot->item_offset < slot->item_offset) {
-      if (other_slot->item_offset < move_offset) {
-        move_offset = other_slot->item_offset;
-      }
-      move_bytes += other_slot->item_length;
-      // Update the slot for the other data to reflect the soon-to-be-new
-      // location.
-      other_slot->item_offset += slot->item_length;
-    }
-  }
-  // If we have data to move, shift it to the right.
-  if (move_bytes > 0) {
-    const std::string &data_to_move =
-        std::string(data_, DATA_SIZE).substr(move_offset, move_bytes);
-
-    for (std::uint16_t i = 0; i < move_bytes; i++)
-      data_[i + move_offset + slot->item_length] = data_to_move[i];
+  memset(&data_[slot->item_offset], '\0', slot->item_length);
 
-    // data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
+  // A record bordering the free space gives its bytes back right away; any
+  // other leaves a hole until the page is compacted.
+  if (slot->item_offset == header_.free_space_upper_bound) {
+    header_.free_space_upper_bound += slot->item_length;
   }
-  header_.free_space_upper_bound += slot->item_length;
 
   // Mark slot as unused.
-  slot->used = false;
-  slot->item_offset = 0;
-  slot->item_length = 0;
+  linkFreeSlot(record_id.slot_number);
   ++header_.num_free_slots;
 
   if (allow_slot_compaction && record_id.slot_number == header_.num_slots) {
     // Last slot in the list, so we need to free any unused slots that are at
-    // the end of the slot list.
-    int num_slots_to_delete = 1;
-    for (SlotId i = 1; i < header_.num_slots; ++i) {
-      // Traverse list backwards, looking for unused slots.
-      const PageSlot *other_slot = getSlot(header_.num_slots - i);
-      if (!other_slot->used) {
-        ++num_slots_to_delete;
-      } else {
-        // Stop at the first used slot we find, since we can't move used slots
-        // without affecting record IDs.
-        break;
-      }
+    // the end of the slot list.  Stop at the first used slot we find, since
+    // we can't move used slots without affecting record IDs.
+    while (header_.num_slots > 0 && !getSlot(header_.num_slots)->used) {
+      unlinkFreeSlot(header_.num_slots);
+      --header_.num_slots;
+      --header_.num_free_slots;
+      header_.free_space_lower_bound -= sizeof(PageSlot);
     }
-    header_.num_slots -= num_slots_to_delete;
-    header_.num_free_slots -= num_slots_to_delete;
-    header_.free_space_lower_bound -= sizeof(PageSlot) * num_slots_to_delete;
   }
 }
 
+std::uint16_t Page::compact() {
+  // Pack the records at the end of a scratch copy of the data area, in slot
+  // order, and copy the packed records back.
+  char packed[DATA_SIZE];
+  std::uint16_t end = DATA_SIZE;
+  for (SlotId i = 1; i <= header_.num_slots; ++i) {
+    PageSlot *slot = getSlot(i);
+    if (!slot->used) continue;
+    end -= slot->item_length;
+    memcpy(&packed[end], &data_[slot->item_offset], slot->item_length);
+    slot->item_offset = end;
+  }
+
+  const std::uint16_t reclaimed = end - header_.free_space_upper_bound;
+  if (reclaimed > 0) {
+    memset(&data_[header_.free_space_upper_bound], '\0', reclaimed);
+    stats().compactions++;
+    stats().reclaimedBytes += reclaimed;
+  }
+  memcpy(&data_[end], &packed[end], DATA_SIZE - end);
+  header_.free_space_upper_bound = end;
+  return reclaimed;
+}
+
 bool Page::hasSpaceForRecord(const std::string &record_data) const {
   std::size_t record_size = record_data.length();
   if (header_.num_free_slots == 0) {
     record_size += sizeof(PageSlot);
   }
-  return record_size <= getFreeSpace();
+  return record_size <= getContiguousFreeSpace() ||
+         record_size <= getFreeSpace();
+}
+
+std::uint16_t Page::getFreeSpace() const {
+  std::size_t record_bytes = 0;
+  for (SlotId i = 1; i <= header_.num_slots; ++i) {
+    const PageSlot &slot = getSlot(i);
+    if (slot.used) record_bytes += slot.item_length;
+  }
+  return DATA_SIZE - header_.free_space_lower_bound - record_bytes;
+}
+
+std::uint32_t Page::computeChecksum(const PageHeader &header) const {
+  std::uint32_t crc = crc32c(~0u, data_, DATA_SIZE);
+  crc = crc32c(crc, reinterpret_cast<const char *>(&header),
+               offsetof(PageHeader, checksum));
+  crc = ~crc;
+  // 0 stands for no checksum
+  return crc == 0 ? 1 : crc;
+}
+
+bool Page::verifyChecksum() const {
+  return header_.checksum == 0 || header_.checksum == computeChecksum();
+}
+
+PageStats &Page::stats() {
+  static PageStats page_stats;
+  return page_stats;
 }
 
 PageSlot *Page::getSlot(const SlotId slot_number) {
@@ -155,25 +311,45 @@ const PageSlot &Page::getSlot(const SlotId slot_number) const {
       &data_[(slot_number - 1) * sizeof(PageSlot)]);
 }
 
+void Page::linkFreeSlot(const SlotId slot_number) {
+  PageSlot *slot = getSlot(slot_number);
+  slot->used = false;
+  slot->item_offset = header_.first_free_slot;
+  slot->item_length = INVALID_SLOT;
+  if (header_.first_free_slot != INVALID_SLOT) {
+    getSlot(header_.first_free_slot)->item_length = slot_number;
+  }
+  header_.first_free_slot = slot_number;
+}
+
+void Page::unlinkFreeSlot(const SlotId slot_number) {
+  const PageSlot *slot = getSlot(slot_number);
+  const SlotId next_slot = slot->item_offset;
+  const SlotId previous_slot = slot->item_length;
+  if (previous_slot == INVALID_SLOT) {
+    header_.first_free_slot = next_slot;
+  } else {
+    getSlot(previous_slot)->item_offset = next_slot;
+  }
+  if (next_slot != INVALID_SLOT) {
+    getSlot(next_slot)->item_length = previous_slot;
+  }
+}
+
 SlotId Page::getAvailableSlot() {
   SlotId slot_number = INVALID_SLOT;
   if (header_.num_free_slots > 0) {
-    // Have an allocated but unused slot that we can reuse.
-    for (SlotId i = 1; i <= header_.num_slots; ++i) {
-      const PageSlot *slot = getSlot(i);
-      if (!slot->used) {
-        // We don't decrement the number of free slots until someone actually
-        // puts data in the slot.
-        slot_number = i;
-        break;
-      }
-    }
+    // Have an allocated but unused slot that we can reuse.  It stays on the
+    // free slot list, and we don't decrement the number of free slots, until
+    // someone actually puts data in the slot.
+    slot_number = header_.first_free_slot;
   } else {
     // Have to allocate a new slot.
     slot_number = header_.num_slots + 1;
     ++header_.num_slots;
     ++header_.num_free_slots;
     header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+    linkFreeSlot(slot_number);
   }
   assert(slot_number != INVALID_SLOT);
   return static_cast<SlotId>(slot_number);
@@ -189,16 +365,14 @@ void Page::insertRecordInSlot(const SlotId slot_number,
     throw SlotInUseException(page_number(), slot_number);
   }
   const int record_length = record_data.length();
+  unlinkFreeSlot(slot_number);
   slot->used = true;
   slot->item_length = record_length;
   slot->item_offset = header_.free_space_upper_bound - record_length;
   header_.free_space_upper_bound = slot->item_offset;
   --header_.num_free_slots;
 
-  for (int i = 0; i < slot->item_length; i++)
-    data_[i + slot->item_offset] = record_data[i];
-
-  // data_.replace(slot->item_offset, slot->item_length, record_data);
+  memcpy(&data_[slot->item_offset], record_data.data(), record_length);
 }
 
 void Page::validateRecordId(const RecordId &record_id) const {
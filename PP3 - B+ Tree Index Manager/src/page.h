@@ -9,6 +9,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <atomic>
 #include <cstddef>
 #include <memory>
 #include <string>
@@ -16,6 +17,14 @@
 //#include <gtest/gtest.h>
 #include "types.h"
 
+/**
+ * Page size in bytes the code is built with; the build sets it through the
+ * PAGE_SIZE option.
+ */
+#ifndef BADGERDB_PAGE_SIZE
+#define BADGERDB_PAGE_SIZE 8192
+#endif
+
 namespace badgerdb {
 
 /**
@@ -49,6 +58,13 @@ struct PageHeader {
    */
   SlotId num_free_slots;
 
+  /**
+   * First slot on the list of slots allocated but not in use, or
+   * Page::INVALID_SLOT if there is none.  An unused slot holds the next and
+   * the previous slot on the list in its item offset and length.
+   */
+  SlotId first_free_slot;
+
   /**
    * Number of the page within the file.
    */
@@ -59,6 +75,14 @@ struct PageHeader {
    */
   PageId next_page_number;
 
+  /**
+   * CRC32C of the page as laid out in memory, up to this field, stored when
+   * the page is written to its file; 0 if none was stored.  Being last in
+   * the header, which is last in memory, it ends every page, also the pages
+   * of a BlobFile whose contents take the place of the header.
+   */
+  std::uint32_t checksum;
+
   /**
    * Returns true if this page header is equal to the other.
    *
@@ -67,6 +91,7 @@ struct PageHeader {
    */
   bool operator==(const PageHeader &rhs) const {
     return num_slots == rhs.num_slots && num_free_slots == rhs.num_free_slots &&
+           first_free_slot == rhs.first_free_slot &&
            current_page_number == rhs.current_page_number &&
            next_page_number == rhs.next_page_number;
   }
@@ -74,6 +99,8 @@ struct PageHeader {
 
 /**
  * @brief Slot metadata that tracks where a record is in the data space.
+ *
+ * Unused slots instead link the list of free slots of the page.
  */
 struct PageSlot {
   /**
@@ -93,6 +120,54 @@ struct PageSlot {
   std::uint16_t item_length;
 };
 
+/**
+ * @brief Bytes of a record as stored in a page, without a copy.
+ *
+ * A view stays valid only while the page it points into is neither changed
+ * nor, if it is a buffer pool frame, unpinned.
+ */
+struct RecordView {
+  /**
+   * First byte of the record.
+   */
+  const char *data;
+
+  /**
+   * Length of the record in bytes.
+   */
+  std::size_t length;
+
+  /**
+   * Returns a copy of the record.
+   *
+   * @return  The record.
+   */
+  std::string str() const { return std::string(data, length); }
+};
+
+/**
+ * @brief Counts of the space reclaimed by compacting pages.
+ */
+struct PageStats {
+  /**
+   * Number of compactions which reclaimed space
+   */
+  std::atomic<std::uint64_t> compactions;
+
+  /**
+   * Bytes of deleted and shrunk records reclaimed by compactions
+   */
+  std::atomic<std::uint64_t> reclaimedBytes;
+
+  /**
+   * Clear all values
+   */
+  void clear() {
+    compactions = 0;
+    reclaimedBytes = 0;
+  }
+};
+
 class PageIterator;
 
 /**
@@ -108,16 +183,22 @@ class PageIterator;
 class Page {
  public:
   /**
-   * Page size in bytes.  If this is changed, database files created with a
-   * different page size value will be unreadable by the resulting binaries.
+   * Page size in bytes, BADGERDB_PAGE_SIZE.  Each file records the size of
+   * its pages, and files of another size fail to open.
    */
-  static const std::size_t SIZE = 8192;
+  static const std::size_t SIZE = BADGERDB_PAGE_SIZE;
 
   /**
    * Size of page free space area in bytes.
    */
   static const std::size_t DATA_SIZE = SIZE - sizeof(PageHeader);
 
+  /**
+   * Bytes at the start of a page whose layout is left to its user, as with
+   * the pages of a BlobFile: all but the checksum ending the page.
+   */
+  static const std::size_t BLOB_SIZE = SIZE - sizeof(std::uint32_t);
+
   /**
    * Number of page indicating that it's invalid.
    */
@@ -141,6 +222,17 @@ class Page {
    */
   RecordId insertRecord(const std::string &record_data);
 
+  /**
+   * Appends a record in a new slot after the last one, as when filling a new
+   * page: free slots and holes are not reused, and the page is not compacted.
+   *
+   * @param record_data   First byte of the record.
+   * @param length        Length of the record in bytes.
+   * @return  Number of the new slot, or INVALID_SLOT if the record and its
+   *          slot do not fit in the contiguous free space.
+   */
+  SlotId appendRecord(const char *record_data, const std::size_t length);
+
   /**
    * Returns the record with the given ID.  Returned data is a copy of what is
    * stored on the page; use updateRecord to change it.
@@ -151,10 +243,22 @@ class Page {
    */
   std::string getRecord(const RecordId &record_id) const;
 
+  /**
+   * Returns the record with the given ID without copying it.
+   *
+   * @see RecordView
+   * @param record_id  ID of the record to return.
+   * @return  View of the record's bytes on this page.
+   */
+  RecordView getRecordView(const RecordId &record_id) const;
+
   /**
    * Updates the record with the given ID, replacing its data with a new
    * version.  This is equivalent to deleting the old record and inserting a
-   * new one, with the exception that the record ID will not change.
+   * new one, with the exception that the record ID will not change.  A record
+   * no longer than before is rewritten in place, as is one that borders the
+   * free space and can grow into it; otherwise the record is moved, compacting
+   * the page if needed.
    *
    * @param record_id   ID of record to update.
    * @param record_data Updated bytes that compose the record.
@@ -162,14 +266,24 @@ class Page {
   void updateRecord(const RecordId &record_id, const std::string &record_data);
 
   /**
-   * Deletes the record with the given ID.  Page is compacted upon delete to
-   * ensure that data of all records is contiguous.  Slot array is compacted if
-   * the slot deleted is at the end of the slot array.
+   * Deletes the record with the given ID.  The record's bytes are left as a
+   * hole until the page is compacted, unless the record borders the free
+   * space.  Slot array is compacted if the slot deleted is at the end of the
+   * slot array.
    *
    * @param record_id   ID of the record to delete.
    */
   void deleteRecord(const RecordId &record_id);
 
+  /**
+   * Moves the records on the page together, reclaiming the holes left by
+   * deleted and shrunk records.  Record IDs do not change.  Inserts and
+   * updates compact the page on their own when they need the space.
+   *
+   * @return  Number of bytes reclaimed.
+   */
+  std::uint16_t compact();
+
   /**
    * Returns true if the page has enough free space to hold the given data.
    *
@@ -179,14 +293,29 @@ class Page {
   bool hasSpaceForRecord(const std::string &record_data) const;
 
   /**
-   * Returns this page's free space in bytes.
+   * Returns this page's free space in bytes, including the holes that
+   * compacting the page would reclaim.
    *
    * @return  Free space in bytes.
    */
-  std::uint16_t getFreeSpace() const {
+  std::uint16_t getFreeSpace() const;
+
+  /**
+   * Returns the free space between the slot array and the records in bytes.
+   *
+   * @return  Contiguous free space in bytes.
+   */
+  std::uint16_t getContiguousFreeSpace() const {
     return header_.free_space_upper_bound - header_.free_space_lower_bound;
   }
 
+  /**
+   * Returns the compaction counts of all pages.
+   *
+   * @return  Process-wide page statistics.
+   */
+  static PageStats &stats();
+
   /**
    * Returns this page's number in its file.
    *
@@ -225,6 +354,23 @@ class Page {
     header_.current_page_number = new_page_number;
   }
 
+  /**
+   * Returns the checksum of the page: a CRC32C of its first BLOB_SIZE bytes
+   * as laid out in memory, never 0.  Computed in hardware where the CPU
+   * supports it.
+   *
+   * @return  Checksum of the page.
+   */
+  std::uint32_t computeChecksum() const { return computeChecksum(header_); }
+
+  /**
+   * Returns whether the checksum stored in the page matches its contents.
+   * Pages holding no checksum, such as pages never written, are not checked.
+   *
+   * @return  False if the page is corrupt or torn.
+   */
+  bool verifyChecksum() const;
+
  protected:
   char data_[DATA_SIZE];
 
@@ -233,6 +379,15 @@ class Page {
    */
   void initialize();
 
+  /**
+   * Returns the checksum the page would have with the given header in place
+   * of its own, as written by PageFile.
+   *
+   * @param header  Header stored with the data of the page.
+   * @return  Checksum of the page.
+   */
+  std::uint32_t computeChecksum(const PageHeader &header) const;
+
   /**
    * Sets the number of the next used page after this page in its file.
    *
@@ -243,10 +398,9 @@ class Page {
   }
 
   /**
-   * Deletes the record with the given ID.  Page is compacted upon delete to
-   * ensure that data of all records is contiguous.  Slot array is compacted if
-   * the slot deleted is at the end of the slot array and
-   * <allow_slot_compaction> is set.
+   * Deletes the record with the given ID, leaving its bytes as a hole unless
+   * it borders the free space.  Slot array is compacted if the slot deleted is
+   * at the end of the slot array and <allow_slot_compaction> is set.
    *
    * @param record_id             ID of the record to delete.
    * @param allow_slot_compaction If true, the slot array will be compacted if
@@ -276,8 +430,23 @@ class Page {
   const PageSlot &getSlot(const SlotId slot_number) const;
 
   /**
-   * Returns the slot number of an available slot.  If no slots are available
-   * to be reused, allocates a new slot.  Updates available slot count in the
+   * Adds the given slot to the front of the free slot list and marks it
+   * unused.
+   *
+   * @param slot_number   Number of slot freed.
+   */
+  void linkFreeSlot(const SlotId slot_number);
+
+  /**
+   * Removes the given slot from the free slot list.
+   *
+   * @param slot_number   Number of slot to be used or given up.
+   */
+  void unlinkFreeSlot(const SlotId slot_number);
+
+  /**
+   * Returns the slot number of an available slot, the first on the free slot
+   * list.  If no slots are available to be reused, allocates a new slot.  Updates available slot count in the
    * header metadata, but does not mark returned slot as used.  If a new slot is
    * allocated, updates the free space lower bound.
    *
@@ -295,8 +464,8 @@ class Page {
    * Inserts record data into the given slot.  The slot should not be currently
    * in use.  <slot_number> must be less than <header_.num_slots>.
    *
-   * Callers are responsible for making sure there is enough space to hold the
-   * record before calling this method.
+   * Callers are responsible for making sure there is enough contiguous space
+   * to hold the record before calling this method.
    *
    * @param slot_number   Number of slot to insert record into.
    * @param record_data   Bytes that compose the record.
@@ -340,6 +509,10 @@ class Page {
 
   friend class BlobFile;
 
+  friend class MappedBlobFile;
+
+  friend class DirectBlobFile;
+
   friend class PageIterator;
 };
 
@@ -347,5 +520,10 @@ class Page {
 static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0, "Page must have some space to hold data.");
+static_assert(Page::SIZE >= 4096 && Page::SIZE <= 65536 &&
+                  (Page::SIZE & (Page::SIZE - 1)) == 0,
+              "Page size must be a power of two from 4KB to 64KB.");
+static_assert(sizeof(Page) == Page::SIZE,
+              "Page must be laid out in memory as it is stored.");
 
 }  // namespace badgerdb
@@ -102,6 +102,15 @@ class PageIterator {
     return page_->getRecord(current_record_);
   }
 
+  /**
+   * Returns the current record in the page without copying it.
+   *
+   * @return  View of the record in page.
+   */
+  inline RecordView view() const {
+    return page_->getRecordView(current_record_);
+  }
+
   /**
    * Returns the next used slot in the page after the given slot or
    * Page::INVALID_SLOT if no slots are used after the given slot.
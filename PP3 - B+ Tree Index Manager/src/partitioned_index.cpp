@@ -0,0 +1,481 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "partitioned_index.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <queue>
+#include <thread>
+
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/bad_opcodes_exception.h"
+#include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/scan_not_initialized_exception.h"
+#include "filescan.h"
+
+namespace badgerdb {
+
+namespace {
+
+// Bytes a key in stored form takes at most
+const std::size_t MAX_KEY_SIZE = std::max<std::size_t>(sizeof(double),
+                                                       STRINGSIZE);
+
+// FNV-1a, then the finalizer of MurmurHash3, since the partition is taken
+// modulo a small number
+std::uint64_t hashBytes(const char *key, std::size_t size) {
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (std::size_t i = 0; i < size; i++) {
+    hash = (hash ^ static_cast<unsigned char>(key[i])) * 0x100000001b3ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+}  // namespace
+
+PartitionScanCursor::PartitionScanCursor(PartitionScanCursor &&other)
+    : index(other.index),
+      parts(std::move(other.parts)),
+      order(other.order),
+      current(other.current) {
+  other.index = nullptr;
+}
+
+PartitionScanCursor &PartitionScanCursor::operator=(
+    PartitionScanCursor &&other) {
+  index = other.index;
+  parts = std::move(other.parts);
+  order = other.order;
+  current = other.current;
+  other.index = nullptr;
+  return *this;
+}
+
+bool PartitionScanCursor::fill(Part &part) {
+  if (part.next < part.count) return true;
+  if (part.exhausted) return false;
+  part.count = part.cursor.scanNextBatch(part.rids.data(), part.rids.size(),
+                                         NULL, part.keys.data());
+  part.next = 0;
+  part.exhausted = part.count < part.rids.size();
+  return part.count > 0;
+}
+
+void PartitionScanCursor::scanNext(RecordId &outRid) {
+  if (scanNextBatch(&outRid, 1) == 0) throw IndexScanCompletedException();
+}
+
+std::size_t PartitionScanCursor::scanNextBatch(RecordId *outRids,
+                                               std::size_t maxRids) {
+  if (index == nullptr) throw ScanNotInitializedException();
+  std::size_t n = 0;
+  if (index->indexMetaInfo.method == RANGE_PARTITIONS) {
+    while (n < maxRids && current < parts.size()) {
+      Part &part = parts[current];
+      if (!fill(part)) {
+        current++;
+        continue;
+      }
+      const std::size_t take = std::min(maxRids - n, part.count - part.next);
+      std::copy(part.rids.begin() + part.next,
+                part.rids.begin() + part.next + take, outRids + n);
+      part.next += take;
+      n += take;
+    }
+    return n;
+  }
+
+  // a key is in one partition only, so the first of the heads comes next
+  const std::size_t keySize = index->keySize;
+  while (n < maxRids) {
+    Part *first = nullptr;
+    for (Part &part : parts) {
+      if (!fill(part)) continue;
+      if (first != nullptr) {
+        const int cmp = index->compareKeys(&part.keys[part.next * keySize],
+                                           &first->keys[first->next * keySize]);
+        if (order == ASCENDING ? cmp >= 0 : cmp <= 0) continue;
+      }
+      first = &part;
+    }
+    if (first == nullptr) break;
+    outRids[n++] = first->rids[first->next++];
+  }
+  return n;
+}
+
+void PartitionScanCursor::endScan() {
+  if (index == nullptr) throw ScanNotInitializedException();
+  for (Part &part : parts) {
+    if (part.cursor.isExecuting()) part.cursor.endScan();
+  }
+  parts.clear();
+  index = nullptr;
+  current = 0;
+}
+
+PartitionedIndex::PartitionedIndex(const std::string &relationName,
+                                   std::string &outIndexName, BufMgr *bufMgrIn,
+                                   const int attrByteOffset,
+                                   const Datatype attrType,
+                                   const PartitionMethod method,
+                                   const int numPartitions,
+                                   const std::vector<std::string> &directories,
+                                   const bool concurrent)
+    : bufMgr(bufMgrIn) {
+  if (numPartitions < 1 || numPartitions > MAXPARTITIONS)
+    throw BadIndexInfoException("number of partitions out of range");
+  keySize = attrType == INTEGER  ? sizeof(int)
+            : attrType == DOUBLE ? sizeof(double)
+                                 : STRINGSIZE;
+
+  outIndexName =
+      relationName + ',' + std::to_string(attrByteOffset) + ",parts";
+  relationName.copy(indexMetaInfo.relationName, 20, 0);
+  indexMetaInfo.attrByteOffset = attrByteOffset;
+  indexMetaInfo.attrType = attrType;
+  indexMetaInfo.method = method;
+  indexMetaInfo.numPartitions = numPartitions;
+
+  const bool exists = File::exists(outIndexName);
+  if (exists) {
+    BlobFile catalog(outIndexName, false);
+    std::string reason;
+    {
+      PageHandle header = bufMgr->pin(&catalog, catalog.getFirstPageNo());
+      const PartitionedIndexMetaInfo *meta =
+          header.as<PartitionedIndexMetaInfo>();
+      if (strncmp(meta->relationName, indexMetaInfo.relationName, 20) != 0)
+        reason = "relation name does not match";
+      else if (meta->attrByteOffset != attrByteOffset)
+        reason = "attribute byte offset does not match";
+      else if (meta->attrType != attrType)
+        reason = "attribute type does not match";
+      else if (meta->method != method)
+        reason = "partition method does not match";
+      else if (meta->numPartitions != numPartitions)
+        reason = "number of partitions does not match";
+      indexMetaInfo = *meta;
+    }
+    bufMgr->flushFile(&catalog);
+    if (!reason.empty()) throw BadIndexInfoException(reason);
+  }
+
+  std::vector<std::string> files(numPartitions);
+  bool missing = !exists;
+  for (int i = 0; i < numPartitions; i++) {
+    const std::string directory =
+        directories.empty() ? "" : directories[i % directories.size()];
+    files[i] = (directory.empty() ? "" : directory + '/') + outIndexName +
+               ',' + std::to_string(i);
+    missing = missing || !File::exists(files[i]);
+  }
+
+  // the key and record id of every record, to route to the partitions
+  const std::size_t stride = keySize + sizeof(RecordId);
+  std::vector<char> entries;
+  if (missing) {
+    FileScan fscan(relationName, bufMgr);
+    try {
+      RecordId scanRid;
+      while (1) {
+        fscan.scanNext(scanRid);
+        const std::size_t end = entries.size();
+        entries.resize(end + stride);
+        normalizeKey(fscan.getRecordView().data + attrByteOffset,
+                     &entries[end]);
+        memcpy(&entries[end + keySize], &scanRid, sizeof(RecordId));
+      }
+    } catch (EndOfFileException e) {
+    }
+  }
+
+  if (!exists) {
+    if (method == RANGE_PARTITIONS) {
+      switch (attrType) {
+        case INTEGER:
+          chooseBounds<int>(entries);
+          break;
+        case DOUBLE:
+          chooseBounds<double>(entries);
+          break;
+        case STRING:
+          chooseBounds<StringKey>(entries);
+          break;
+      }
+    }
+    BlobFile catalog(outIndexName, true);
+    PageId headerPageNum;
+    {
+      PageHandle header = bufMgr->pinNew(&catalog, headerPageNum);
+      memcpy(reinterpret_cast<char *>(header.get()), &indexMetaInfo,
+             sizeof(PartitionedIndexMetaInfo));
+      header.markDirty();
+    }
+    bufMgr->flushFile(&catalog);
+    catalog.sync();
+  }
+
+  const std::size_t numEntries = entries.size() / stride;
+  std::vector<std::uint8_t> owners(numEntries);
+  for (std::size_t k = 0; k < numEntries; k++)
+    owners[k] = partitionOf(&entries[k * stride]);
+
+  // a partition whose file is there is opened without calling its feed
+  partitions.resize(numPartitions);
+  const std::vector<KeyColumn> keyColumns{KeyColumn{attrByteOffset, attrType}};
+  forPartitions(0, numPartitions - 1, [&](int i) {
+    const RecordFeed feed =
+        [&, i](const std::function<void(const RecordId &, const char *)> &fn) {
+          std::vector<char> record(attrByteOffset + keySize);
+          RecordId rid;
+          for (std::size_t k = 0; k < numEntries; k++) {
+            if (owners[k] != i) continue;
+            memcpy(&record[attrByteOffset], &entries[k * stride], keySize);
+            memcpy(&rid, &entries[k * stride + keySize], sizeof(RecordId));
+            fn(rid, record.data());
+          }
+        };
+    partitions[i].reset(new BTreeIndex(relationName, files[i], bufMgr,
+                                       keyColumns, feed, DEFAULT_FILL_FACTOR,
+                                       concurrent));
+  });
+}
+
+PartitionedIndex::~PartitionedIndex() {}
+
+template <class T>
+void PartitionedIndex::chooseBounds(const std::vector<char> &entries) {
+  const std::size_t stride = keySize + sizeof(RecordId);
+  const std::size_t numEntries = entries.size() / stride;
+  if (numEntries == 0) return;
+  std::vector<T> keys(numEntries);
+  for (std::size_t k = 0; k < numEntries; k++)
+    memcpy(&keys[k], &entries[k * stride], sizeof(T));
+
+  // the keys past each bound found are no smaller, so the next is found
+  // among them
+  typename std::vector<T>::iterator start = keys.begin();
+  for (int i = 1; i < indexMetaInfo.numPartitions; i++) {
+    const typename std::vector<T>::iterator bound =
+        keys.begin() + numEntries * i / indexMetaInfo.numPartitions;
+    std::nth_element(start, bound, keys.end());
+    memcpy(indexMetaInfo.bounds[i - 1], &*bound, sizeof(T));
+    start = bound;
+  }
+}
+
+void PartitionedIndex::normalizeKey(const void *key, char *out) const {
+  switch (indexMetaInfo.attrType) {
+    case INTEGER:
+      memcpy(out, key, sizeof(int));
+      break;
+    case DOUBLE: {
+      double value;
+      memcpy(&value, key, sizeof(double));
+      if (value == 0) value = 0;  // -0.0 equals 0.0
+      memcpy(out, &value, sizeof(double));
+      break;
+    }
+    case STRING:
+      strncpy(out, static_cast<const char *>(key), STRINGSIZE);
+      break;
+  }
+}
+
+int PartitionedIndex::compareKeys(const char *key1, const char *key2) const {
+  switch (indexMetaInfo.attrType) {
+    case INTEGER: {
+      int value1, value2;
+      memcpy(&value1, key1, sizeof(int));
+      memcpy(&value2, key2, sizeof(int));
+      return (value1 > value2) - (value1 < value2);
+    }
+    case DOUBLE: {
+      double value1, value2;
+      memcpy(&value1, key1, sizeof(double));
+      memcpy(&value2, key2, sizeof(double));
+      return (value1 > value2) - (value1 < value2);
+    }
+    case STRING:
+      return memcmp(key1, key2, STRINGSIZE);
+  }
+  return 0;
+}
+
+int PartitionedIndex::partitionOf(const void *key) const {
+  char stored[MAX_KEY_SIZE];
+  normalizeKey(key, stored);
+  if (indexMetaInfo.method == HASH_PARTITIONS)
+    return hashBytes(stored, keySize) % indexMetaInfo.numPartitions;
+
+  // the partition after the last bound not above the key
+  int low = 0, high = indexMetaInfo.numPartitions - 1;
+  while (low < high) {
+    const int middle = (low + high) / 2;
+    if (compareKeys(indexMetaInfo.bounds[middle], stored) <= 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+void PartitionedIndex::insertEntry(const void *key, const RecordId rid) {
+  partitions[partitionOf(key)]->insertEntry(key, rid);
+}
+
+void PartitionedIndex::deleteEntry(const void *key, const RecordId rid) {
+  partitions[partitionOf(key)]->deleteEntry(key, rid);
+}
+
+std::size_t PartitionedIndex::lookup(const void *key, RecordId *outRids,
+                                     const std::size_t maxRids) {
+  return partitions[partitionOf(key)]->lookup(key, outRids, maxRids);
+}
+
+void PartitionedIndex::scanPartitions(const void *lowVal, const Operator lowOp,
+                                      const void *highVal,
+                                      const Operator highOp, int &first,
+                                      int &last) const {
+  if ((lowOp != GT && lowOp != GTE) || (highOp != LT && highOp != LTE))
+    throw BadOpcodesException();
+  char low[MAX_KEY_SIZE], high[MAX_KEY_SIZE];
+  normalizeKey(lowVal, low);
+  normalizeKey(highVal, high);
+  if (compareKeys(low, high) > 0) throw BadScanrangeException();
+  if (indexMetaInfo.method == HASH_PARTITIONS) {
+    first = 0;
+    last = indexMetaInfo.numPartitions - 1;
+  } else {
+    first = partitionOf(low);
+    last = partitionOf(high);
+  }
+}
+
+template <class Fn>
+void PartitionedIndex::forPartitions(int first, int last, Fn fn) {
+  if (!bufMgr->isConcurrent() || first == last) {
+    for (int i = first; i <= last; i++) fn(i);
+    return;
+  }
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(last - first + 1);
+  for (int i = first; i <= last; i++) {
+    threads.emplace_back([&fn, &errors, first, i] {
+      try {
+        fn(i);
+      } catch (...) {
+        errors[i - first] = std::current_exception();
+      }
+    });
+  }
+  for (std::thread &thread : threads) thread.join();
+  for (const std::exception_ptr &error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+}
+
+PartitionScanCursor PartitionedIndex::openScan(const void *lowVal,
+                                               const Operator lowOp,
+                                               const void *highVal,
+                                               const Operator highOp,
+                                               const ScanOrder order) {
+  int first, last;
+  scanPartitions(lowVal, lowOp, highVal, highOp, first, last);
+  PartitionScanCursor cursor;
+  cursor.order = order;
+  for (int i = first; i <= last; i++) {
+    // range partitions are returned one after the other, in scan order
+    const int p = order == ASCENDING ? i : first + last - i;
+    PartitionScanCursor::Part part;
+    try {
+      part.cursor = partitions[p]->openScan(lowVal, lowOp, highVal, highOp,
+                                            NORMAL_ACCESS, order);
+    } catch (const NoSuchKeyFoundException &e) {
+      continue;
+    }
+    part.rids.resize(PARTITION_SCAN_BATCH);
+    part.keys.resize(PARTITION_SCAN_BATCH * keySize);
+    cursor.parts.push_back(std::move(part));
+  }
+  if (cursor.parts.empty()) throw NoSuchKeyFoundException();
+  cursor.index = this;
+  return cursor;
+}
+
+void PartitionedIndex::scanRange(const void *lowVal, const Operator lowOp,
+                                 const void *highVal, const Operator highOp,
+                                 std::vector<RecordId> &outRids) {
+  int first, last;
+  scanPartitions(lowVal, lowOp, highVal, highOp, first, last);
+  const int n = last - first + 1;
+  std::vector<std::vector<RecordId>> rids(n);
+  if (indexMetaInfo.method == RANGE_PARTITIONS) {
+    forPartitions(first, last, [&](int i) {
+      partitions[i]->scanRange(lowVal, lowOp, highVal, highOp,
+                               rids[i - first]);
+    });
+    for (const std::vector<RecordId> &part : rids)
+      outRids.insert(outRids.end(), part.begin(), part.end());
+    return;
+  }
+
+  // the keys of hash partitions are read with their entries, to merge by
+  std::vector<std::vector<char>> keys(n);
+  forPartitions(first, last, [&](int i) {
+    IndexScanCursor cursor;
+    try {
+      cursor = partitions[i]->openScan(lowVal, lowOp, highVal, highOp);
+    } catch (const NoSuchKeyFoundException &e) {
+      return;
+    }
+    std::vector<RecordId> &partRids = rids[i - first];
+    std::vector<char> &partKeys = keys[i - first];
+    std::size_t size = 0, read;
+    do {
+      partRids.resize(size + PARTITION_SCAN_BATCH);
+      partKeys.resize((size + PARTITION_SCAN_BATCH) * keySize);
+      read = cursor.scanNextBatch(&partRids[size], PARTITION_SCAN_BATCH, NULL,
+                                  &partKeys[size * keySize]);
+      size += read;
+    } while (read == PARTITION_SCAN_BATCH);
+    partRids.resize(size);
+  });
+
+  std::vector<std::size_t> next(n, 0);
+  auto later = [&](int a, int b) {
+    return compareKeys(&keys[a][next[a] * keySize],
+                       &keys[b][next[b] * keySize]) > 0;
+  };
+  std::priority_queue<int, std::vector<int>, decltype(later)> heads(later);
+  for (int p = 0; p < n; p++) {
+    if (!rids[p].empty()) heads.push(p);
+  }
+  while (!heads.empty()) {
+    const int p = heads.top();
+    heads.pop();
+    outRids.push_back(rids[p][next[p]++]);
+    if (next[p] < rids[p].size()) heads.push(p);
+  }
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,396 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "buffer.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * Number of partitions a partitioned index is split into at most
+ */
+const int MAXPARTITIONS = 64;
+
+/**
+ * Number of entries a scan of a partitioned index reads from a partition at
+ * a time
+ */
+const std::size_t PARTITION_SCAN_BATCH = 256;
+
+/**
+ * @brief How the keys of a partitioned index are assigned to its partitions.
+ */
+enum PartitionMethod {
+  RANGE_PARTITIONS, /* Each partition holds a range of keys, the ranges split
+                       where they hold as many entries when the index is built */
+  HASH_PARTITIONS   /* Each partition holds the keys whose hash leads to it */
+};
+
+/**
+ * @brief Meta page of the catalog file of a partitioned index, its first and
+ * only page.
+ */
+struct PartitionedIndexMetaInfo {
+  /**
+   * Name of base relation.
+   */
+  char relationName[20];
+
+  /**
+   * Offset of attribute, over which index is built, inside the record stored
+   * in pages.
+   */
+  int attrByteOffset;
+
+  /**
+   * Type of the attribute over which index is built.
+   */
+  Datatype attrType;
+
+  /**
+   * How the keys are assigned to the partitions.
+   */
+  PartitionMethod method;
+
+  /**
+   * Number of partitions.
+   */
+  int numPartitions;
+
+  /**
+   * Smallest key of each range partition but the first, in the form keys are
+   * passed to the index in, with strings zero padded.
+   */
+  char bounds[MAXPARTITIONS - 1][STRINGSIZE];
+};
+
+class PartitionedIndex;
+
+/**
+ * @brief Cursor of a scan of a partitioned index, returning the entries of
+ * its range from every partition, in key order.
+ *
+ * The cursor holds a scan of every partition the range overlaps, each with
+ * its leaf pinned, and reads their entries in batches.  The scans of range
+ * partitions are read one after the other; those of hash partitions are
+ * merged by key.
+ */
+class PartitionScanCursor {
+ public:
+  /**
+   * Creates a cursor with no scan, to be assigned one from
+   * PartitionedIndex::openScan().
+   */
+  PartitionScanCursor() = default;
+
+  /**
+   * Takes over the scan of another cursor, which is left with no scan.
+   */
+  PartitionScanCursor(PartitionScanCursor &&other);
+
+  /**
+   * Takes over the scan of another cursor, which is left with no scan.
+   */
+  PartitionScanCursor &operator=(PartitionScanCursor &&other);
+
+  /**
+   * Fetch the record id of the next entry of the scan.
+   * @param outRid the record id of the next entry
+   * @throws ScanNotInitializedException If the scan has been ended.
+   * @throws IndexScanCompletedException If no more entries are left.
+   **/
+  void scanNext(RecordId &outRid);
+
+  /**
+   * Copy the record ids of the next entries of the scan to outRids.
+   * @param outRids the array the record ids are copied to
+   * @param maxRids the number of record ids that fit in outRids
+   * @return the number of record ids copied, which is less than maxRids only
+   *         at the end of the scan
+   * @throws ScanNotInitializedException If the scan has been ended.
+   **/
+  std::size_t scanNextBatch(RecordId *outRids, std::size_t maxRids);
+
+  /**
+   * Terminate the scan and unpin the leaves of the partitions.
+   * @throws ScanNotInitializedException If the scan has been ended.
+   **/
+  void endScan();
+
+  /**
+   * Returns true if the scan has been started and not yet ended.
+   */
+  bool isExecuting() const { return index != nullptr; }
+
+ private:
+  friend class PartitionedIndex;
+
+  /**
+   * @brief The scan of one partition, and the entries read from it but not
+   * yet returned.
+   */
+  struct Part {
+    IndexScanCursor cursor;
+    std::vector<RecordId> rids;
+    std::vector<char> keys;
+    std::size_t next = 0;
+    std::size_t count = 0;
+    bool exhausted = false;
+  };
+
+  /**
+   * Reads the next batch of a partition once its entries read are all
+   * returned, and returns false if it has none left.
+   */
+  bool fill(Part &part);
+
+  /**
+   * Index scanned, or null if there is no scan.
+   */
+  const PartitionedIndex *index = nullptr;
+
+  /**
+   * Scans of the partitions the range overlaps, in the order they are
+   * returned for range partitions.
+   */
+  std::vector<Part> parts;
+
+  /**
+   * Order in which the entries are returned.
+   */
+  ScanOrder order = ASCENDING;
+
+  /**
+   * Partition being returned, for range partitions.
+   */
+  std::size_t current = 0;
+};
+
+/**
+ * @brief Index of the records of a relation by the value of one attribute,
+ * split across several B+ trees, each in an index file of its own.
+ *
+ * The partitions are assigned the keys by range or by hash; all the entries
+ * of a key are in one partition.  The index files may be placed in different
+ * directories, such as on different disks, so that the reads and writes of
+ * the partitions go to as many files, each through a stream of its own.
+ * Range partitions are split when the index is built so that each holds as
+ * many entries; they may drift apart as keys are inserted.
+ *
+ * Inserts, deletes and lookups go to the partition of their key.  A scan
+ * reads the partitions its range overlaps: range partitions one after the
+ * other, hash partitions merged by key.  When the buffer manager is
+ * concurrent, the partitions of a new index are built on a thread each, and
+ * scanRange() reads them on a thread each.
+ *
+ * A catalog file named after the relation and attribute, followed by
+ * ",parts", records how the keys are assigned; partition i is kept in the
+ * file of that name followed by "," and i.
+ */
+class PartitionedIndex {
+ public:
+  /**
+   * PartitionedIndex Constructor.
+   * Check to see if the catalog file exists. If so, open it and the index
+   * files of the partitions, building any partition whose file is missing.
+   * If not, route the entries of every tuple of the relation to the
+   * partitions and bulk build each of them.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of the catalog file.
+   * @param bufMgrIn            Buffer Manager Instance
+   * @param attrByteOffset      Offset of attribute, over which index is to be
+   * built, in the record
+   * @param attrType            Datatype of attribute over which index is built
+   * @param method              How the keys are assigned to the partitions
+   * @param numPartitions       Number of partitions, at most MAXPARTITIONS
+   * @param directories         Directories the index files are placed in,
+   * partition i in directory i modulo their number; "" is the working
+   * directory
+   * @param concurrent          Whether the partitions may be used from several
+   * threads at once, which needs a concurrent buffer manager
+   * @throws  BadIndexInfoException     If the number of partitions is out of
+   * range, or if the catalog file already exists for the corresponding
+   * attribute, but does not match the parameters.
+   */
+  PartitionedIndex(const std::string &relationName, std::string &outIndexName,
+                   BufMgr *bufMgrIn, const int attrByteOffset,
+                   const Datatype attrType, const PartitionMethod method,
+                   const int numPartitions,
+                   const std::vector<std::string> &directories =
+                       std::vector<std::string>(1),
+                   const bool concurrent = false);
+
+  /**
+   * PartitionedIndex Destructor.
+   * Closes the index of every partition, which flushes its file.
+   */
+  ~PartitionedIndex();
+
+  PartitionedIndex(const PartitionedIndex &) = delete;
+  PartitionedIndex &operator=(const PartitionedIndex &) = delete;
+
+  /**
+   * Returns the number of partitions.
+   */
+  int numPartitions() const { return (int)partitions.size(); }
+
+  /**
+   * Returns the index of the given partition.
+   */
+  BTreeIndex &partition(int i) { return *partitions[i]; }
+
+  /**
+   * Returns the partition holding the given key.
+   *
+   * @param key   Key, pointer to integer/double/char string
+   */
+  int partitionOf(const void *key) const;
+
+  /**
+   * Insert a new entry using the pair <value,rid> into the partition of the
+   * key.
+   *
+   * @param key   Key to insert, pointer to integer/double/char string
+   * @param rid   Record ID of a record whose entry is getting inserted into
+   * the index.
+   */
+  void insertEntry(const void *key, const RecordId rid);
+
+  /**
+   * Delete the entry with the pair <value,rid> from the partition of the key.
+   *
+   * @param key   Key to delete, pointer to integer/double/char string
+   * @param rid   Record ID of the record whose entry is getting deleted from
+   * the index.
+   * @throws  NoSuchKeyFoundException If the index holds no such entry.
+   */
+  void deleteEntry(const void *key, const RecordId rid);
+
+  /**
+   * Find the entries with the given key, as BTreeIndex::lookup() does.
+   *
+   * @param key       Key to find, pointer to integer/double/char string
+   * @param outRids   Array the record ids of the entries are copied to
+   * @param maxRids   Number of record ids that fit in outRids
+   * @return the number of entries with the key, which may be more than
+   *         maxRids, in which case only the first maxRids are copied
+   */
+  std::size_t lookup(const void *key, RecordId *outRids,
+                     const std::size_t maxRids);
+
+  /**
+   * Open a scan of the entries in the given range, in key order, over the
+   * partitions the range overlaps.
+   *
+   * @param lowVal  Low value of range, pointer to integer / double / char
+   * string
+   * @param lowOp   Low operator (GT/GTE)
+   * @param highVal High value of range, pointer to integer / double / char
+   * string
+   * @param highOp  High operator (LT/LTE)
+   * @param order   Order in which the entries are returned
+   * @return the cursor of the scan
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of
+   * their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   * @throws  NoSuchKeyFoundException If no partition holds a key in the range.
+   */
+  PartitionScanCursor openScan(const void *lowVal, const Operator lowOp,
+                               const void *highVal, const Operator highOp,
+                               const ScanOrder order = ASCENDING);
+
+  /**
+   * Append the record ids of all entries in the given range to outRids, in
+   * key order. The partitions the range overlaps are read on a thread each
+   * if the buffer manager is concurrent.
+   *
+   * @param lowVal  Low value of range, pointer to integer / double / char
+   * string
+   * @param lowOp   Low operator (GT/GTE)
+   * @param highVal High value of range, pointer to integer / double / char
+   * string
+   * @param highOp  High operator (LT/LTE)
+   * @param outRids the vector the record ids are appended to
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of
+   * their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   */
+  void scanRange(const void *lowVal, const Operator lowOp,
+                 const void *highVal, const Operator highOp,
+                 std::vector<RecordId> &outRids);
+
+ private:
+  friend class PartitionScanCursor;
+
+  /**
+   * Copies a key into the fixed-width form it is compared and hashed in:
+   * STRINGSIZE characters of a string, zero padded, and 0 for -0.0.
+   */
+  void normalizeKey(const void *key, char *out) const;
+
+  /**
+   * Compares two keys in stored form, returning a negative number, 0 or a
+   * positive number as the first is smaller, equal or larger.
+   */
+  int compareKeys(const char *key1, const char *key2) const;
+
+  /**
+   * Sets the bounds of range partitions where they hold as many of the given
+   * keys, stored one after another.
+   */
+  template <class T>
+  void chooseBounds(const std::vector<char> &keys);
+
+  /**
+   * Checks the operators and bounds of a scan, and returns the first and
+   * last partitions it overlaps, from which every partition is read for hash
+   * partitions.
+   */
+  void scanPartitions(const void *lowVal, const Operator lowOp,
+                      const void *highVal, const Operator highOp, int &first,
+                      int &last) const;
+
+  /**
+   * Runs fn(i) for every partition i from first to last, on a thread each if
+   * the buffer manager is concurrent. The first exception thrown is rethrown
+   * once all are done.
+   */
+  template <class Fn>
+  void forPartitions(int first, int last, Fn fn);
+
+  /**
+   * Buffer manager the partitions are read through.
+   */
+  BufMgr *bufMgr;
+
+  /**
+   * Contents of the catalog file.
+   */
+  PartitionedIndexMetaInfo indexMetaInfo{};
+
+  /**
+   * Length of a key in stored form.
+   */
+  std::size_t keySize;
+
+  /**
+   * Index of every partition.
+   */
+  std::vector<std::unique_ptr<BTreeIndex>> partitions;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,385 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "replacer.h"
+
+namespace badgerdb {
+
+Replacer *Replacer::create(ReplacementPolicy policy, std::uint32_t numBufs,
+                           std::uint32_t maxBufs) {
+  switch (policy) {
+    case LRUK_REPLACEMENT:
+      return new LruKReplacer(numBufs);
+    case TWOQ_REPLACEMENT:
+      return new TwoQReplacer(numBufs);
+    case ARC_REPLACEMENT:
+      return new ArcReplacer(numBufs);
+    case CLOCK_REPLACEMENT:
+    default:
+      return new ClockReplacer(numBufs, maxBufs);
+  }
+}
+
+namespace {
+
+// offers the frames of list, oldest first, until one is accepted, counting
+// them in numScanned
+bool offer(const FrameList &list, FrameId &frameNo,
+           const Replacer::Evictable &evictable, std::uint32_t &numScanned) {
+  for (FrameId i = list.front(); i != FrameList::NONE; i = list.next(i)) {
+    numScanned++;
+    if (evictable(i)) {
+      frameNo = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+}
+
+//----------------------------------------
+// CLOCK
+//----------------------------------------
+
+ClockReplacer::ClockReplacer(std::uint32_t numBufs, std::uint32_t maxBufs)
+    : numBufs(numBufs), clockHand(numBufs - 1),
+      refbit(std::max(numBufs, maxBufs)) {
+  for (std::uint32_t i = 0; i < refbit.size(); i++) refbit[i] = false;
+}
+
+void ClockReplacer::recordHit(FrameId frameNo) { refbit[frameNo] = true; }
+
+void ClockReplacer::recordLoad(FrameId frameNo, const File *file,
+                               PageId pageNo) {
+  refbit[frameNo] = true;
+}
+
+void ClockReplacer::recordEvict(FrameId frameNo, const File *file,
+                                PageId pageNo) {
+  refbit[frameNo] = false;
+}
+
+void ClockReplacer::recordFree(FrameId frameNo) { refbit[frameNo] = false; }
+
+bool ClockReplacer::victim(FrameId &frameNo, const Evictable &evictable,
+                           std::uint32_t &numScanned) {
+  // free frames have their bit cleared, so they are taken on the first pass
+  const std::uint32_t frames = numBufs;
+  for (numScanned = 1; numScanned <= 2 * frames; numScanned++) {
+    // advance the clock
+    FrameId hand = (clockHand.fetch_add(1) + 1) % frames;
+
+    // has been referenced, clear the bit
+    if (refbit[hand].exchange(false)) continue;
+
+    if (evictable(hand)) {
+      frameNo = hand;
+      return true;
+    }
+  }
+  numScanned = 2 * frames;
+  return false;
+}
+
+void ClockReplacer::resize(std::uint32_t newBufs) {
+  // the frames added were retired or never used, and hold no page
+  for (FrameId i = numBufs; i < newBufs; i++) refbit[i] = false;
+  numBufs = newBufs;
+}
+
+//----------------------------------------
+// LRU-K
+//----------------------------------------
+
+LruKReplacer::LruKReplacer(std::uint32_t numBufs)
+    : now(0), history(numBufs * LRUK_K, 0) {
+  for (FrameId i = 0; i < numBufs; i++) order.insert({Key(0, 0), i});
+}
+
+void LruKReplacer::reference(FrameId frameNo, bool first) {
+  std::uint64_t *times = &history[frameNo * LRUK_K];
+  order.erase({Key(times[LRUK_K - 1], times[0]), frameNo});
+  if (first) std::fill(times, times + LRUK_K, 0);
+  std::copy_backward(times, times + LRUK_K - 1, times + LRUK_K);
+  times[0] = ++now;
+  order.insert({Key(times[LRUK_K - 1], times[0]), frameNo});
+}
+
+void LruKReplacer::recordHit(FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  reference(frameNo, false);
+}
+
+void LruKReplacer::recordLoad(FrameId frameNo, const File *file,
+                              PageId pageNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  reference(frameNo, true);
+}
+
+void LruKReplacer::recordEvict(FrameId frameNo, const File *file,
+                               PageId pageNo) {
+  recordFree(frameNo);
+}
+
+void LruKReplacer::recordFree(FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  std::uint64_t *times = &history[frameNo * LRUK_K];
+  order.erase({Key(times[LRUK_K - 1], times[0]), frameNo});
+  std::fill(times, times + LRUK_K, 0);
+  order.insert({Key(0, 0), frameNo});
+}
+
+bool LruKReplacer::victim(FrameId &frameNo, const Evictable &evictable,
+                          std::uint32_t &numScanned) {
+  std::lock_guard<std::mutex> guard(latch);
+  numScanned = 0;
+  for (const std::pair<Key, FrameId> &entry : order) {
+    numScanned++;
+    if (evictable(entry.second)) {
+      frameNo = entry.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LruKReplacer::resize(std::uint32_t newBufs) {
+  std::lock_guard<std::mutex> guard(latch);
+  const std::uint32_t oldBufs = history.size() / LRUK_K;
+  for (FrameId i = newBufs; i < oldBufs; i++) {
+    const std::uint64_t *times = &history[i * LRUK_K];
+    order.erase({Key(times[LRUK_K - 1], times[0]), i});
+  }
+  history.resize((std::size_t)newBufs * LRUK_K, 0);
+  for (FrameId i = oldBufs; i < newBufs; i++) order.insert({Key(0, 0), i});
+}
+
+//----------------------------------------
+// Frame and ghost lists
+//----------------------------------------
+
+const FrameId FrameList::NONE;
+
+FrameList::FrameList(std::uint32_t numBufs)
+    : prevFrame(numBufs, NONE), nextFrame(numBufs, NONE),
+      member(numBufs, false), head(NONE), tail(NONE), count(0) {}
+
+void FrameList::reserve(std::uint32_t numBufs) {
+  if (numBufs <= member.size()) return;
+  prevFrame.resize(numBufs, NONE);
+  nextFrame.resize(numBufs, NONE);
+  member.resize(numBufs, false);
+}
+
+void FrameList::pushBack(FrameId frameNo) {
+  prevFrame[frameNo] = tail;
+  nextFrame[frameNo] = NONE;
+  if (tail == NONE)
+    head = frameNo;
+  else
+    nextFrame[tail] = frameNo;
+  tail = frameNo;
+  member[frameNo] = true;
+  count++;
+}
+
+void FrameList::remove(FrameId frameNo) {
+  if (!member[frameNo]) return;
+  if (prevFrame[frameNo] == NONE)
+    head = nextFrame[frameNo];
+  else
+    nextFrame[prevFrame[frameNo]] = nextFrame[frameNo];
+  if (nextFrame[frameNo] == NONE)
+    tail = prevFrame[frameNo];
+  else
+    prevFrame[nextFrame[frameNo]] = prevFrame[frameNo];
+  member[frameNo] = false;
+  count--;
+}
+
+void GhostList::pushBack(const PageKey &key) {
+  remove(key);
+  index[key] = order.insert(order.end(), key);
+}
+
+bool GhostList::remove(const PageKey &key) {
+  auto it = index.find(key);
+  if (it == index.end()) return false;
+  order.erase(it->second);
+  index.erase(it);
+  return true;
+}
+
+void GhostList::popFront() {
+  index.erase(order.front());
+  order.pop_front();
+}
+
+//----------------------------------------
+// 2Q
+//----------------------------------------
+
+TwoQReplacer::TwoQReplacer(std::uint32_t numBufs)
+    : numBufs(numBufs), kin(std::max(1u, numBufs / 4)),
+      kout(std::max(1u, numBufs / 2)), freeFrames(numBufs), a1in(numBufs),
+      am(numBufs) {
+  for (FrameId i = 0; i < numBufs; i++) freeFrames.pushBack(i);
+}
+
+void TwoQReplacer::recordHit(FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  // hits in A1in are taken to be correlated with the first reference
+  if (am.contains(frameNo)) {
+    am.remove(frameNo);
+    am.pushBack(frameNo);
+  }
+}
+
+void TwoQReplacer::recordLoad(FrameId frameNo, const File *file,
+                              PageId pageNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  freeFrames.remove(frameNo);
+  if (a1out.remove(GhostList::PageKey(file, pageNo)))
+    am.pushBack(frameNo);
+  else
+    a1in.pushBack(frameNo);
+}
+
+void TwoQReplacer::recordEvict(FrameId frameNo, const File *file,
+                               PageId pageNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  if (a1in.contains(frameNo)) {
+    a1in.remove(frameNo);
+    a1out.pushBack(GhostList::PageKey(file, pageNo));
+    if (a1out.size() > kout) a1out.popFront();
+  } else {
+    am.remove(frameNo);
+  }
+  if (!freeFrames.contains(frameNo)) freeFrames.pushBack(frameNo);
+}
+
+void TwoQReplacer::recordFree(FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  a1in.remove(frameNo);
+  am.remove(frameNo);
+  if (!freeFrames.contains(frameNo)) freeFrames.pushBack(frameNo);
+}
+
+bool TwoQReplacer::victim(FrameId &frameNo, const Evictable &evictable,
+                          std::uint32_t &numScanned) {
+  std::lock_guard<std::mutex> guard(latch);
+  numScanned = 0;
+  if (offer(freeFrames, frameNo, evictable, numScanned)) return true;
+  if (a1in.size() > kin)
+    return offer(a1in, frameNo, evictable, numScanned) ||
+           offer(am, frameNo, evictable, numScanned);
+  return offer(am, frameNo, evictable, numScanned) ||
+         offer(a1in, frameNo, evictable, numScanned);
+}
+
+void TwoQReplacer::resize(std::uint32_t newBufs) {
+  std::lock_guard<std::mutex> guard(latch);
+  for (FrameId i = newBufs; i < numBufs; i++) freeFrames.remove(i);
+  freeFrames.reserve(newBufs);
+  a1in.reserve(newBufs);
+  am.reserve(newBufs);
+  for (FrameId i = numBufs; i < newBufs; i++) freeFrames.pushBack(i);
+  numBufs = newBufs;
+  kin = std::max(1u, numBufs / 4);
+  kout = std::max(1u, numBufs / 2);
+  while (a1out.size() > kout) a1out.popFront();
+}
+
+//----------------------------------------
+// ARC
+//----------------------------------------
+
+ArcReplacer::ArcReplacer(std::uint32_t numBufs)
+    : numBufs(numBufs), p(0), freeFrames(numBufs), t1(numBufs), t2(numBufs) {
+  for (FrameId i = 0; i < numBufs; i++) freeFrames.pushBack(i);
+}
+
+void ArcReplacer::recordHit(FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  t1.remove(frameNo);
+  t2.remove(frameNo);
+  t2.pushBack(frameNo);
+}
+
+void ArcReplacer::recordLoad(FrameId frameNo, const File *file,
+                             PageId pageNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  const GhostList::PageKey key(file, pageNo);
+  const std::uint32_t b1Size = b1.size();
+  const std::uint32_t b2Size = b2.size();
+  freeFrames.remove(frameNo);
+  if (b1.remove(key)) {
+    // T1 was too small to keep this page
+    p = std::min(numBufs, p + std::max(1u, b2Size / b1Size));
+    t2.pushBack(frameNo);
+  } else if (b2.remove(key)) {
+    // T2 was too small to keep this page
+    const std::uint32_t delta = std::max(1u, b1Size / b2Size);
+    p = p > delta ? p - delta : 0;
+    t2.pushBack(frameNo);
+  } else {
+    t1.pushBack(frameNo);
+  }
+}
+
+void ArcReplacer::recordEvict(FrameId frameNo, const File *file,
+                              PageId pageNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  const GhostList::PageKey key(file, pageNo);
+  if (t1.contains(frameNo)) {
+    t1.remove(frameNo);
+    b1.pushBack(key);
+  } else {
+    t2.remove(frameNo);
+    b2.pushBack(key);
+  }
+  // keep |T1| + |B1| and |B1| + |B2| within the pool size
+  while (b1.size() > 0 && t1.size() + b1.size() > numBufs) b1.popFront();
+  while (b2.size() > 0 && b1.size() + b2.size() > numBufs) b2.popFront();
+  if (!freeFrames.contains(frameNo)) freeFrames.pushBack(frameNo);
+}
+
+void ArcReplacer::recordFree(FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  t1.remove(frameNo);
+  t2.remove(frameNo);
+  if (!freeFrames.contains(frameNo)) freeFrames.pushBack(frameNo);
+}
+
+bool ArcReplacer::victim(FrameId &frameNo, const Evictable &evictable,
+                         std::uint32_t &numScanned) {
+  std::lock_guard<std::mutex> guard(latch);
+  numScanned = 0;
+  if (offer(freeFrames, frameNo, evictable, numScanned)) return true;
+  if (t1.size() > 0 && t1.size() > p)
+    return offer(t1, frameNo, evictable, numScanned) ||
+           offer(t2, frameNo, evictable, numScanned);
+  return offer(t2, frameNo, evictable, numScanned) ||
+         offer(t1, frameNo, evictable, numScanned);
+}
+
+void ArcReplacer::resize(std::uint32_t newBufs) {
+  std::lock_guard<std::mutex> guard(latch);
+  for (FrameId i = newBufs; i < numBufs; i++) freeFrames.remove(i);
+  freeFrames.reserve(newBufs);
+  t1.reserve(newBufs);
+  t2.reserve(newBufs);
+  for (FrameId i = numBufs; i < newBufs; i++) freeFrames.pushBack(i);
+  numBufs = newBufs;
+  p = std::min(p, numBufs);
+  while (b1.size() > 0 && t1.size() + b1.size() > numBufs) b1.popFront();
+  while (b2.size() > 0 && b1.size() + b2.size() > numBufs) b2.popFront();
+}
+
+}
@@ -0,0 +1,395 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+* @brief Page replacement policies a buffer manager can be built with
+*/
+enum ReplacementPolicy {
+  CLOCK_REPLACEMENT,
+  LRUK_REPLACEMENT,
+  TWOQ_REPLACEMENT,
+  ARC_REPLACEMENT
+};
+
+/**
+* Number of most recent references LRU-K orders frames by
+*/
+const int LRUK_K = 2;
+
+/**
+* @brief Decides which buffer pool frame to give up when a frame is needed
+*
+* The buffer manager tells the replacer about every page it reads in, every
+* hit on a resident page and every frame it empties.  It asks the replacer
+* for a victim by passing a predicate which claims a frame if nothing pins it;
+* the replacer offers frames in its preferred order until one is accepted.
+* Frames holding no page must be offered before any other frame.
+*
+* A replacer may be called from several threads at once.
+*/
+class Replacer {
+ public:
+  /**
+   * Predicate claiming the given frame if it may be evicted
+   */
+  typedef std::function<bool(FrameId)> Evictable;
+
+  /**
+   * Creates a replacer.
+   *
+   * @param policy    Replacement policy to use
+   * @param numBufs   Number of frames in the buffer pool
+   * @param maxBufs   Number of frames the buffer pool may grow to
+   * @return  The new replacer, owned by the caller
+   */
+  static Replacer *create(ReplacementPolicy policy, std::uint32_t numBufs,
+                          std::uint32_t maxBufs);
+
+  virtual ~Replacer() {}
+
+  /**
+   * Returns the name of the replacement policy.
+   */
+  virtual const char *name() const = 0;
+
+  /**
+   * Called when the page in the given frame is requested while resident.
+   * The caller holds a pin on the frame.
+   *
+   * @param frameNo   Frame holding the page
+   */
+  virtual void recordHit(FrameId frameNo) = 0;
+
+  /**
+   * Called when a page is read into or allocated in the given frame.
+   *
+   * @param frameNo   Frame now holding the page
+   * @param file      File of the page
+   * @param pageNo    Page number in the file
+   */
+  virtual void recordLoad(FrameId frameNo, const File *file, PageId pageNo) = 0;
+
+  /**
+   * Called when the page in the given frame has been evicted to make room
+   * for another page.
+   *
+   * @param frameNo   Frame given up
+   * @param file      File of the page evicted
+   * @param pageNo    Page number in the file
+   */
+  virtual void recordEvict(FrameId frameNo, const File *file, PageId pageNo) = 0;
+
+  /**
+   * Called when the given frame no longer holds a page for any other reason,
+   * e.g. its file was flushed or its page disposed.  The frame may already
+   * be free.
+   *
+   * @param frameNo   Frame now free
+   */
+  virtual void recordFree(FrameId frameNo) = 0;
+
+  /**
+   * Picks the frame to give up next.
+   *
+   * @param frameNo     Frame accepted by evictable is returned via this reference
+   * @param evictable   Predicate claiming a frame if it may be evicted
+   * @param numScanned  Number of frames looked at, offered or passed over,
+   *                    is returned via this reference
+   * @return  False if evictable rejected every frame offered
+   */
+  virtual bool victim(FrameId &frameNo, const Evictable &evictable,
+                      std::uint32_t &numScanned) = 0;
+
+  /**
+   * Called when frames are added to or retired from the end of the buffer
+   * pool.  Frames added are free; frames retired hold no page and are not
+   * offered again, though a victim() under way may still offer one.
+   *
+   * @param numBufs   Number of frames in the buffer pool now
+   */
+  virtual void resize(std::uint32_t numBufs) = 0;
+};
+
+/**
+* @brief Two-pass CLOCK sweep over reference bits; needs no latch
+*/
+class ClockReplacer : public Replacer {
+ public:
+  ClockReplacer(std::uint32_t numBufs, std::uint32_t maxBufs);
+
+  const char *name() const { return "CLOCK"; }
+  void recordHit(FrameId frameNo);
+  void recordLoad(FrameId frameNo, const File *file, PageId pageNo);
+  void recordEvict(FrameId frameNo, const File *file, PageId pageNo);
+  void recordFree(FrameId frameNo);
+  bool victim(FrameId &frameNo, const Evictable &evictable,
+              std::uint32_t &numScanned);
+  void resize(std::uint32_t numBufs);
+
+ private:
+  /**
+   * Number of frames in the buffer pool
+   */
+  std::atomic<std::uint32_t> numBufs;
+
+  /**
+   * Ticks of the clock hand; the hand points at clockHand % numBufs
+   */
+  std::atomic<std::uint32_t> clockHand;
+
+  /**
+   * Whether each frame has been referenced since the hand last passed it,
+   * for as many frames as the pool may grow to, since the bits are read
+   * without a latch
+   */
+  std::vector<std::atomic<bool> > refbit;
+};
+
+/**
+* @brief LRU-K: evicts the frame whose K-th most recent reference is oldest
+*
+* Frames referenced fewer than K times go first, least recently used first,
+* so pages touched once by a scan leave before pages touched repeatedly.
+*/
+class LruKReplacer : public Replacer {
+ public:
+  LruKReplacer(std::uint32_t numBufs);
+
+  const char *name() const { return "LRU-K"; }
+  void recordHit(FrameId frameNo);
+  void recordLoad(FrameId frameNo, const File *file, PageId pageNo);
+  void recordEvict(FrameId frameNo, const File *file, PageId pageNo);
+  void recordFree(FrameId frameNo);
+  bool victim(FrameId &frameNo, const Evictable &evictable,
+              std::uint32_t &numScanned);
+  void resize(std::uint32_t numBufs);
+
+ private:
+  /**
+   * Eviction order key of a frame: its K-th and its most recent reference
+   * time, 0 for references that never happened
+   */
+  typedef std::pair<std::uint64_t, std::uint64_t> Key;
+
+  /**
+   * Records a reference to the frame at the current time.
+   *
+   * @param frameNo   Frame referenced
+   * @param first     Whether this is the first reference to its page
+   */
+  void reference(FrameId frameNo, bool first);
+
+  /**
+   * Logical time of the last reference
+   */
+  std::uint64_t now;
+
+  /**
+   * Last K reference times of every frame, most recent first
+   */
+  std::vector<std::uint64_t> history;
+
+  /**
+   * Frames ordered by eviction key
+   */
+  std::set<std::pair<Key, FrameId> > order;
+
+  /**
+   * Guards all members
+   */
+  std::mutex latch;
+};
+
+/**
+* @brief Intrusive doubly linked list of frames, oldest at the front
+*/
+class FrameList {
+ public:
+  FrameList(std::uint32_t numBufs);
+
+  bool contains(FrameId frameNo) const { return member[frameNo]; }
+  std::uint32_t size() const { return count; }
+  FrameId front() const { return head; }
+  FrameId next(FrameId frameNo) const { return nextFrame[frameNo]; }
+
+  /**
+   * Makes room for frames up to the given number; never shrinks.
+   */
+  void reserve(std::uint32_t numBufs);
+
+  /**
+   * Appends the frame, which must not be on the list, at the back.
+   */
+  void pushBack(FrameId frameNo);
+
+  /**
+   * Removes the frame if it is on the list.
+   */
+  void remove(FrameId frameNo);
+
+  /**
+   * Marks the end of the list
+   */
+  static const FrameId NONE = ~FrameId(0);
+
+ private:
+  std::vector<FrameId> prevFrame;
+  std::vector<FrameId> nextFrame;
+  std::vector<bool> member;
+  FrameId head;
+  FrameId tail;
+  std::uint32_t count;
+};
+
+/**
+* @brief FIFO of the identities of recently evicted pages
+*/
+class GhostList {
+ public:
+  /**
+   * Identity of a page
+   */
+  typedef std::pair<const File *, PageId> PageKey;
+
+  std::size_t size() const { return index.size(); }
+
+  /**
+   * Appends the page at the back, moving it there if already present.
+   */
+  void pushBack(const PageKey &key);
+
+  /**
+   * Removes the page if present.
+   *
+   * @return  True if the page was present
+   */
+  bool remove(const PageKey &key);
+
+  /**
+   * Removes the oldest page.
+   */
+  void popFront();
+
+ private:
+  struct PageKeyHash {
+    std::size_t operator()(const PageKey &key) const {
+      return std::hash<const File *>()(key.first) ^
+          (std::size_t(key.second) * 0x9e3779b97f4a7c15ULL);
+    }
+  };
+
+  std::list<PageKey> order;
+  std::unordered_map<PageKey, std::list<PageKey>::iterator, PageKeyHash> index;
+};
+
+/**
+* @brief 2Q: pages seen once wait in a small FIFO before joining the LRU
+*
+* New pages enter A1in.  Pages evicted from A1in are remembered in A1out;
+* only a page requested again while remembered is loaded into Am, the main
+* LRU queue.  A scan therefore only cycles through A1in.
+*/
+class TwoQReplacer : public Replacer {
+ public:
+  TwoQReplacer(std::uint32_t numBufs);
+
+  const char *name() const { return "2Q"; }
+  void recordHit(FrameId frameNo);
+  void recordLoad(FrameId frameNo, const File *file, PageId pageNo);
+  void recordEvict(FrameId frameNo, const File *file, PageId pageNo);
+  void recordFree(FrameId frameNo);
+  bool victim(FrameId &frameNo, const Evictable &evictable,
+              std::uint32_t &numScanned);
+  void resize(std::uint32_t numBufs);
+
+ private:
+  /**
+   * Number of frames in the buffer pool
+   */
+  std::uint32_t numBufs;
+
+  /**
+   * Target size of A1in, a quarter of the pool
+   */
+  std::uint32_t kin;
+
+  /**
+   * Capacity of A1out, half of the pool
+   */
+  std::uint32_t kout;
+
+  FrameList freeFrames;
+  FrameList a1in;
+  FrameList am;
+  GhostList a1out;
+
+  /**
+   * Guards all members
+   */
+  std::mutex latch;
+};
+
+/**
+* @brief ARC: balances a recency list T1 and a frequency list T2
+*
+* Ghost lists B1 and B2 remember pages evicted from T1 and T2.  A request for
+* a page in B1 grows the target size p of T1, one in B2 shrinks it.  Since the
+* victim is chosen before the requested page is known, the tie rule of the
+* original algorithm favouring T1 when the request hits B2 is not applied.
+*/
+class ArcReplacer : public Replacer {
+ public:
+  ArcReplacer(std::uint32_t numBufs);
+
+  const char *name() const { return "ARC"; }
+  void recordHit(FrameId frameNo);
+  void recordLoad(FrameId frameNo, const File *file, PageId pageNo);
+  void recordEvict(FrameId frameNo, const File *file, PageId pageNo);
+  void recordFree(FrameId frameNo);
+  bool victim(FrameId &frameNo, const Evictable &evictable,
+              std::uint32_t &numScanned);
+  void resize(std::uint32_t numBufs);
+
+ private:
+  /**
+   * Number of frames in the buffer pool
+   */
+  std::uint32_t numBufs;
+
+  /**
+   * Target size of T1
+   */
+  std::uint32_t p;
+
+  FrameList freeFrames;
+  FrameList t1;
+  FrameList t2;
+  GhostList b1;
+  GhostList b2;
+
+  /**
+   * Guards all members
+   */
+  std::mutex latch;
+};
+
+}
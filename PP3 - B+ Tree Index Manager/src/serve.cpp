@@ -0,0 +1,131 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+// Server of BadgerDB indexes: opens the given indexes through one concurrent
+// buffer pool and answers lookups, scans and batches of lookups over TCP,
+// with the protocol of service.h, until interrupted; then writes what it
+// served as one JSON object.
+//
+//   PP3_serve --port 7070 --index ebay.items:0:int --index ebay.bids:4:int
+
+#include <signal.h>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "buffer.h"
+#include "exceptions/badgerdb_exception.h"
+#include "service.h"
+
+using namespace badgerdb;
+
+namespace {
+
+void usage(const char *program) {
+  std::cerr << "usage: " << program << " [options] --index spec...\n"
+            << "  --port N             port to listen on (7070)\n"
+            << "  --frames N           frames in the buffer pool (10000)\n"
+            << "  --index R:O:T[,O:T]  index of relation R on the attribute\n"
+            << "                       at offset O of type T, int, double or\n"
+            << "                       string; several make a composite key\n";
+}
+
+// Parses relation:offset:type[,offset:type], returning false if malformed
+bool parseIndex(const std::string &spec, std::string &relation,
+                std::vector<KeyColumn> &keyColumns) {
+  const std::size_t colon = spec.find(':');
+  if (colon == 0 || colon == std::string::npos) return false;
+  relation = spec.substr(0, colon);
+  std::istringstream columns(spec.substr(colon + 1));
+  std::string column;
+  while (std::getline(columns, column, ',')) {
+    const std::size_t at = column.find(':');
+    if (at == 0 || at == std::string::npos) return false;
+    char *end;
+    const long offset = std::strtol(column.c_str(), &end, 10);
+    const std::string type = column.substr(at + 1);
+    if (end != column.c_str() + at || offset < 0) return false;
+    if (type == "int") {
+      keyColumns.push_back(KeyColumn{(int)offset, INTEGER});
+    } else if (type == "double") {
+      keyColumns.push_back(KeyColumn{(int)offset, DOUBLE});
+    } else if (type == "string") {
+      keyColumns.push_back(KeyColumn{(int)offset, STRING});
+    } else {
+      return false;
+    }
+  }
+  return !keyColumns.empty();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int port = 7070;
+  std::uint32_t frames = 10000;
+  std::vector<std::string> relations;
+  std::vector<std::vector<KeyColumn>> keys;
+  bool valid = argc > 1;
+  for (int i = 1; i < argc && valid; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 == argc) {
+      valid = false;
+    } else if (arg == "--port") {
+      port = std::atoi(argv[++i]);
+    } else if (arg == "--frames") {
+      frames = std::strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--index") {
+      relations.emplace_back();
+      keys.emplace_back();
+      valid = parseIndex(argv[++i], relations.back(), keys.back());
+    } else {
+      valid = false;
+    }
+  }
+  if (!valid || relations.empty() || frames == 0 || port < 0 ||
+      port > 65535) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // the signals ending the server are taken by sigwait() below, on this
+  // thread, rather than by a handler interrupting any thread
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+  try {
+    std::unique_ptr<BufMgr> pool(new BufMgr(frames, true));
+    IndexService service(pool.get());
+    for (std::size_t i = 0; i < relations.size(); i++)
+      service.addIndex(relations[i], keys[i]);
+    std::cerr << "listening on port " << service.bind(port) << std::endl;
+
+    std::thread server([&service] { service.run(); });
+    int signal;
+    sigwait(&signals, &signal);
+    service.stop();
+    server.join();
+
+    const ServiceStats stats = service.getStats();
+    std::cout << "{\"connections\": " << stats.connections
+              << ", \"requests\": " << stats.requests
+              << ", \"bad_requests\": " << stats.badRequests
+              << ", \"entries\": " << stats.entriesReturned << "}"
+              << std::endl;
+  } catch (const BadgerDbException &e) {
+    std::cerr << e.message() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,550 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "service.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <thread>
+
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/bad_opcodes_exception.h"
+#include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/badgerdb_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+// Bytes of a request before its body: tag, op, flags and index
+const std::size_t REQUEST_HEADER = 8;
+
+// Bytes a connection reads at once, to begin with
+const std::size_t RECEIVE_SIZE = 64 << 10;
+
+// Number of entries read from a scan at a time
+const std::size_t SCAN_BATCH = 256;
+
+template <class T>
+void put(std::vector<char> &out, T value) {
+  const std::size_t end = out.size();
+  out.resize(end + sizeof(T));
+  memcpy(&out[end], &value, sizeof(T));
+}
+
+template <class T>
+bool get(const char *&pos, const char *end, T &value) {
+  if ((std::size_t)(end - pos) < sizeof(T)) return false;
+  memcpy(&value, pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+// Sends all the given bytes, returning false if the connection is closed
+bool sendAll(int fd, const std::vector<char> &bytes) {
+  std::size_t sent = 0;
+  while (sent < bytes.size()) {
+    const ssize_t n =
+        ::send(fd, &bytes[sent], bytes.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+void setNoDelay(int fd) {
+  const int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+// Copies bytes of keys out of a request, where they lie at any offset, into
+// storage aligned for every key type, and returns the copy
+const void *alignKeys(const char *keys, std::size_t size,
+                      std::vector<std::uint64_t> &storage) {
+  storage.resize(size / sizeof(std::uint64_t) + 1);
+  memcpy(storage.data(), keys, size);
+  return storage.data();
+}
+
+std::size_t keySizeOf(const std::vector<KeyColumn> &keyColumns) {
+  std::size_t size = 0;
+  for (const KeyColumn &column : keyColumns) {
+    size += column.type == INTEGER  ? sizeof(int)
+            : column.type == DOUBLE ? sizeof(double)
+                                    : STRINGSIZE;
+  }
+  return size;
+}
+
+}  // namespace
+
+IndexService::IndexService(BufMgr *bufMgrIn) : bufMgr(bufMgrIn) {}
+
+IndexService::~IndexService() {
+  if (listenFd >= 0) ::close(listenFd);
+}
+
+int IndexService::addIndex(const std::string &relationName,
+                           const std::vector<KeyColumn> &keyColumns) {
+  std::unique_ptr<Served> served(new Served);
+  served->relationName = relationName;
+  served->keySize = keySizeOf(keyColumns);
+  served->serialized = !bufMgr->isConcurrent();
+  if (!served->serialized) {
+    try {
+      served->index.reset(new BTreeIndex(relationName, served->indexName,
+                                         bufMgr, keyColumns, BULK_BUILD,
+                                         DEFAULT_FILL_FACTOR, true));
+    } catch (const BadIndexInfoException &e) {
+      // such as an index holding posting lists
+      served->serialized = true;
+    }
+  }
+  if (served->serialized) {
+    served->index.reset(new BTreeIndex(relationName, served->indexName, bufMgr,
+                                       keyColumns));
+  }
+  indexes.push_back(std::move(served));
+  return (int)indexes.size() - 1;
+}
+
+int IndexService::bind(int port) {
+  listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd < 0) throw BadgerDbException("could not open a socket");
+  const int on = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  socklen_t length = sizeof(address);
+  if (::bind(listenFd, (sockaddr *)&address, sizeof(address)) != 0 ||
+      ::listen(listenFd, 128) != 0 ||
+      getsockname(listenFd, (sockaddr *)&address, &length) != 0) {
+    ::close(listenFd);
+    listenFd = -1;
+    throw BadgerDbException("could not listen on port " +
+                            std::to_string(port));
+  }
+  return ntohs(address.sin_port);
+}
+
+void IndexService::run() {
+  while (!stopping) {
+    const int fd = ::accept(listenFd, NULL, NULL);
+    if (fd < 0) {
+      if (stopping) break;
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      break;
+    }
+    setNoDelay(fd);
+    std::lock_guard<std::mutex> guard(connectionsLatch);
+    if (stopping) {
+      ::close(fd);
+      break;
+    }
+    connectionFds.insert(fd);
+    numConnections++;
+    std::thread([this, fd] {
+      serveConnection(fd);
+      std::lock_guard<std::mutex> guard(connectionsLatch);
+      connectionFds.erase(fd);
+      ::close(fd);
+      connectionsDone.notify_all();
+    }).detach();
+  }
+
+  // the connections still open are woken from their reads
+  std::unique_lock<std::mutex> lock(connectionsLatch);
+  for (int fd : connectionFds) ::shutdown(fd, SHUT_RDWR);
+  connectionsDone.wait(lock, [this] { return connectionFds.empty(); });
+}
+
+void IndexService::stop() {
+  stopping = true;
+  if (listenFd >= 0) ::shutdown(listenFd, SHUT_RDWR);
+  std::lock_guard<std::mutex> guard(connectionsLatch);
+  for (int fd : connectionFds) ::shutdown(fd, SHUT_RDWR);
+}
+
+void IndexService::serveConnection(int fd) {
+  std::vector<char> in(RECEIVE_SIZE);
+  std::vector<char> out;
+  std::size_t filled = 0;
+  while (true) {
+    if (filled == in.size()) in.resize(in.size() * 2);
+    const ssize_t n = ::recv(fd, &in[filled], in.size() - filled, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return;
+    filled += n;
+
+    // every request received is answered before any response is sent
+    const long answered = answer(in.data(), filled, out);
+    if (answered < 0) return;
+    memmove(in.data(), in.data() + answered, filled - answered);
+    filled -= answered;
+    if (!sendAll(fd, out)) return;
+    out.clear();
+  }
+}
+
+long IndexService::answer(const char *in, std::size_t size,
+                          std::vector<char> &out) {
+  std::size_t pos = 0;
+  while (size - pos >= sizeof(std::uint32_t)) {
+    std::uint32_t length;
+    memcpy(&length, in + pos, sizeof(length));
+    if (length > SERVICE_MAX_FRAME) return -1;
+    if (size - pos - sizeof(length) < length) break;
+    answerRequest(in + pos + sizeof(length), length, out);
+    pos += sizeof(length) + length;
+  }
+  return pos;
+}
+
+void IndexService::answerRequest(const char *request, std::size_t length,
+                                 std::vector<char> &out) {
+  numRequests++;
+  const char *pos = request;
+  const char *end = request + length;
+  std::uint32_t tag = 0;
+  std::uint8_t op = 0, flags = 0;
+  std::uint16_t number = 0;
+  const bool whole = get(pos, end, tag) && get(pos, end, op) &&
+                     get(pos, end, flags) && get(pos, end, number);
+
+  // the length is filled in once the response is complete
+  const std::size_t start = out.size();
+  put<std::uint32_t>(out, 0);
+  put(out, tag);
+  const std::size_t statusPos = out.size();
+  put<std::uint8_t>(out, SERVICE_OK);
+  const std::size_t body = out.size();
+
+  ServiceStatus status = SERVICE_OK;
+  if (!whole) {
+    status = SERVICE_BAD_REQUEST;
+  } else if (op == SERVICE_INDEXES) {
+    put<std::uint16_t>(out, indexes.size());
+    for (const std::unique_ptr<Served> &served : indexes) {
+      put<std::uint16_t>(out, served->keySize);
+      put<std::uint16_t>(out, served->indexName.size());
+      out.insert(out.end(), served->indexName.begin(),
+                 served->indexName.end());
+    }
+  } else if (number >= indexes.size()) {
+    status = SERVICE_BAD_REQUEST;
+  } else {
+    Served &served = *indexes[number];
+    std::unique_lock<std::mutex> lock(served.latch, std::defer_lock);
+    if (served.serialized) lock.lock();
+    try {
+      status = answerIndex(served, op, flags, pos, end, out);
+    } catch (const BadOpcodesException &e) {
+      status = SERVICE_BAD_REQUEST;
+    } catch (const BadScanrangeException &e) {
+      status = SERVICE_BAD_REQUEST;
+    } catch (const BadgerDbException &e) {
+      status = SERVICE_FAILED;
+    } catch (const std::exception &e) {
+      // such as bad_alloc, which fails the request rather than the server
+      status = SERVICE_FAILED;
+    }
+  }
+
+  if (status != SERVICE_OK) {
+    numBadRequests++;
+    out.resize(body);
+    out[statusPos] = status;
+  }
+  const std::uint32_t responseLength =
+      out.size() - start - sizeof(responseLength);
+  memcpy(&out[start], &responseLength, sizeof(responseLength));
+}
+
+ServiceStatus IndexService::answerIndex(Served &served, std::uint8_t op,
+                                        std::uint8_t flags, const char *pos,
+                                        const char *end,
+                                        std::vector<char> &out) {
+  const bool records = flags & SERVICE_RECORDS;
+  const std::size_t keySize = served.keySize;
+  static thread_local std::vector<RecordId> rids;
+  static thread_local std::vector<std::uint64_t> lowKey, highKey;
+  std::uint32_t maxRids = 0;
+
+  switch (op) {
+    case SERVICE_LOOKUP: {
+      if ((std::size_t)(end - pos) != keySize + sizeof(maxRids))
+        return SERVICE_BAD_REQUEST;
+      const void *key = alignKeys(pos, keySize, lowKey);
+      pos += keySize;
+      get(pos, end, maxRids);
+      maxRids = std::min(maxRids, SERVICE_MAX_ENTRIES);
+      rids.resize(std::max<std::size_t>(maxRids, 1));
+      const std::size_t count = served.index->lookup(key, rids.data(), maxRids);
+      const std::size_t n = std::min<std::size_t>(count, maxRids);
+      put<std::uint32_t>(out, count);
+      put<std::uint32_t>(out, n);
+      appendEntries(served, rids.data(), n, records, out);
+      return SERVICE_OK;
+    }
+
+    case SERVICE_SCAN: {
+      std::uint8_t lowOp = 0, highOp = 0;
+      std::uint32_t limit = 0;
+      if ((std::size_t)(end - pos) != 2 + 2 * keySize + sizeof(limit))
+        return SERVICE_BAD_REQUEST;
+      get(pos, end, lowOp);
+      get(pos, end, highOp);
+      if (lowOp > NE || highOp > NE) return SERVICE_BAD_REQUEST;
+      const void *low = alignKeys(pos, keySize, lowKey);
+      const void *high = alignKeys(pos + keySize, keySize, highKey);
+      pos += 2 * keySize;
+      get(pos, end, limit);
+      const std::size_t countPos = out.size();
+      put<std::uint32_t>(out, 0);
+
+      IndexScanCursor cursor;
+      try {
+        cursor = served.index->openScan(low, (Operator)lowOp, high,
+                                        (Operator)highOp);
+      } catch (const NoSuchKeyFoundException &e) {
+        return SERVICE_OK;
+      }
+      cursor.setLimit(std::min(limit, SERVICE_MAX_ENTRIES));
+      rids.resize(SCAN_BATCH);
+      std::uint32_t numRids = 0;
+      std::size_t n;
+      while ((n = cursor.scanNextBatch(rids.data(), SCAN_BATCH)) > 0) {
+        appendEntries(served, rids.data(), n, records, out);
+        numRids += n;
+      }
+      memcpy(&out[countPos], &numRids, sizeof(numRids));
+      return SERVICE_OK;
+    }
+
+    case SERVICE_PROBE: {
+      std::uint32_t numKeys;
+      if (!get(pos, end, numKeys) ||
+          (std::size_t)(end - pos) !=
+              (std::uint64_t)numKeys * keySize + sizeof(maxRids))
+        return SERVICE_BAD_REQUEST;
+      if (numKeys > SERVICE_MAX_KEYS) return SERVICE_BAD_REQUEST;
+      const void *keys =
+          alignKeys(pos, (std::size_t)numKeys * keySize, lowKey);
+      pos += (std::size_t)numKeys * keySize;
+      get(pos, end, maxRids);
+      // the keys share the entries a response holds at most
+      maxRids = std::min(maxRids, SERVICE_MAX_ENTRIES /
+                                      std::max<std::uint32_t>(numKeys, 1));
+      std::vector<std::size_t> counts;
+      rids.clear();
+      served.index->lookupMany(keys, numKeys, rids, counts, maxRids);
+      std::size_t first = 0;
+      for (std::size_t count : counts) {
+        const std::size_t n = std::min<std::size_t>(count, maxRids);
+        put<std::uint32_t>(out, count);
+        put<std::uint32_t>(out, n);
+        appendEntries(served, rids.data() + first, n, records, out);
+        first += n;
+      }
+      return SERVICE_OK;
+    }
+  }
+  return SERVICE_BAD_REQUEST;
+}
+
+void IndexService::appendEntries(Served &served, const RecordId *rids,
+                                 std::size_t n, bool records,
+                                 std::vector<char> &out) {
+  numEntriesReturned += n;
+  if (!records) {
+    for (std::size_t i = 0; i < n; i++) {
+      put<std::uint32_t>(out, rids[i].page_number);
+      put<std::uint16_t>(out, rids[i].slot_number);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(served.heapLatch);
+  if (!served.heap) served.heap.reset(new HeapFetch(served.relationName,
+                                                    bufMgr));
+  served.heap->fetch(
+      std::vector<RecordId>(rids, rids + n),
+      [&out](const RecordId &rid, const RecordView &record) {
+        put<std::uint32_t>(out, rid.page_number);
+        put<std::uint16_t>(out, rid.slot_number);
+        put<std::uint16_t>(out, record.length);
+        out.insert(out.end(), record.data, record.data + record.length);
+      },
+      GIVEN_ORDER);
+}
+
+ServiceStats IndexService::getStats() const {
+  return ServiceStats{numConnections, numRequests, numBadRequests,
+                      numEntriesReturned};
+}
+
+ServiceClient::ServiceClient(const std::string &host, int port) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *addresses;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                  &addresses) != 0)
+    throw BadgerDbException("could not resolve " + host);
+  fd = -1;
+  for (addrinfo *address = addresses; address != NULL && fd < 0;
+       address = address->ai_next) {
+    fd = ::socket(address->ai_family, address->ai_socktype,
+                  address->ai_protocol);
+    if (fd >= 0 && ::connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0)
+    throw BadgerDbException("could not connect to " + host + ':' +
+                            std::to_string(port));
+  setNoDelay(fd);
+}
+
+ServiceClient::~ServiceClient() { ::close(fd); }
+
+std::uint32_t ServiceClient::add(ServiceOp op, std::uint8_t flags,
+                                 std::uint16_t index, const void *body,
+                                 std::size_t length) {
+  const std::uint32_t tag = nextTag++;
+  put<std::uint32_t>(out, REQUEST_HEADER + length);
+  put(out, tag);
+  put<std::uint8_t>(out, op);
+  put(out, flags);
+  put(out, index);
+  const char *bytes = static_cast<const char *>(body);
+  out.insert(out.end(), bytes, bytes + length);
+  outstanding++;
+  return tag;
+}
+
+std::uint32_t ServiceClient::addLookup(std::uint16_t index, const void *key,
+                                       std::size_t keySize,
+                                       std::uint32_t maxRids,
+                                       std::uint8_t flags) {
+  std::vector<char> body(static_cast<const char *>(key),
+                         static_cast<const char *>(key) + keySize);
+  put(body, maxRids);
+  return add(SERVICE_LOOKUP, flags, index, body.data(), body.size());
+}
+
+std::uint32_t ServiceClient::addScan(std::uint16_t index, const void *lowVal,
+                                     Operator lowOp, const void *highVal,
+                                     Operator highOp, std::size_t keySize,
+                                     std::uint32_t limit,
+                                     std::uint8_t flags) {
+  std::vector<char> body;
+  put<std::uint8_t>(body, lowOp);
+  put<std::uint8_t>(body, highOp);
+  body.insert(body.end(), static_cast<const char *>(lowVal),
+              static_cast<const char *>(lowVal) + keySize);
+  body.insert(body.end(), static_cast<const char *>(highVal),
+              static_cast<const char *>(highVal) + keySize);
+  put(body, limit);
+  return add(SERVICE_SCAN, flags, index, body.data(), body.size());
+}
+
+std::uint32_t ServiceClient::addProbe(std::uint16_t index, const void *keys,
+                                      std::size_t numKeys,
+                                      std::size_t keySize,
+                                      std::uint32_t maxRids,
+                                      std::uint8_t flags) {
+  std::vector<char> body;
+  put<std::uint32_t>(body, numKeys);
+  body.insert(body.end(), static_cast<const char *>(keys),
+              static_cast<const char *>(keys) + numKeys * keySize);
+  put(body, maxRids);
+  return add(SERVICE_PROBE, flags, index, body.data(), body.size());
+}
+
+void ServiceClient::flush() {
+  if (!sendAll(fd, out)) throw BadgerDbException("connection closed");
+  out.clear();
+}
+
+ServiceClient::Response ServiceClient::next() {
+  if (!out.empty()) flush();
+  std::uint32_t length = 0;
+  while (true) {
+    const std::size_t available = in.size() - inStart;
+    if (available >= sizeof(length)) {
+      memcpy(&length, &in[inStart], sizeof(length));
+      if (available - sizeof(length) >= length) break;
+    }
+    if (inStart > 0) {
+      in.erase(in.begin(), in.begin() + inStart);
+      inStart = 0;
+    }
+    const std::size_t filled = in.size();
+    in.resize(filled + RECEIVE_SIZE);
+    ssize_t n;
+    do {
+      n = ::recv(fd, &in[filled], RECEIVE_SIZE, 0);
+    } while (n < 0 && errno == EINTR);
+    in.resize(filled + std::max<ssize_t>(n, 0));
+    if (n <= 0) throw BadgerDbException("connection closed");
+  }
+
+  Response response;
+  const char *pos = &in[inStart + sizeof(length)];
+  const char *end = pos + length;
+  std::uint8_t status = SERVICE_BAD_REQUEST;
+  get(pos, end, response.tag);
+  get(pos, end, status);
+  response.status = (ServiceStatus)status;
+  response.body.assign(pos, end);
+  inStart += sizeof(length) + length;
+  outstanding--;
+  return response;
+}
+
+std::vector<RecordId> ServiceClient::readEntries(
+    const Response &response, std::size_t &pos, bool withRecords,
+    std::vector<std::string> *records) {
+  const char *at = response.body.data() + std::min(pos, response.body.size());
+  const char *end = response.body.data() + response.body.size();
+  std::uint32_t n = 0;
+  bool whole = get(at, end, n);
+  std::vector<RecordId> rids;
+  for (std::uint32_t i = 0; i < n && whole; i++) {
+    RecordId rid;
+    std::uint16_t length = 0;
+    whole = get(at, end, rid.page_number) && get(at, end, rid.slot_number) &&
+            (!withRecords ||
+             (get(at, end, length) && (std::size_t)(end - at) >= length));
+    if (!whole) break;
+    rids.push_back(rid);
+    if (withRecords) {
+      if (records != nullptr) records->emplace_back(at, length);
+      at += length;
+    }
+  }
+  if (!whole) throw BadgerDbException("malformed response");
+  pos = at - response.body.data();
+  return rids;
+}
+
+}  // namespace badgerdb
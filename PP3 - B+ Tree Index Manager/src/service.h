@@ -0,0 +1,366 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "buffer.h"
+#include "filescan.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Operations of a request to an IndexService.
+ *
+ * Every message is a frame: its length in bytes, not counting the length
+ * itself, as a 32-bit integer, then its contents.  Integers and keys are
+ * stored as in memory on the x86 machines BadgerDB runs on, little-endian,
+ * without padding; a key is the values of the key columns of its index one
+ * after another, strings STRINGSIZE bytes long.  A request holds:
+ *
+ *   u32 tag  u8 op  u8 flags  u16 index  body
+ *
+ * and its response:
+ *
+ *   u32 tag  u8 status  body
+ *
+ * The tag is returned as given, so that a client may send any number of
+ * requests before reading the responses, which come back in the order of
+ * the requests.  An entry of a response is the record id, u32 page and u16
+ * slot, followed with SERVICE_RECORDS by u16 length and the record.
+ */
+enum ServiceOp {
+  /* body: key  u32 maxRids;  response: u32 count  u32 n  n entries */
+  SERVICE_LOOKUP = 1,
+  /* body: u8 lowOp  u8 highOp  low key  high key  u32 limit;
+     response: u32 n  n entries, in key order, at most limit of them */
+  SERVICE_SCAN = 2,
+  /* body: u32 numKeys  numKeys keys  u32 maxRids;
+     response: for each key, as for SERVICE_LOOKUP */
+  SERVICE_PROBE = 3,
+  /* body: none;  response: u16 numIndexes, then for each index u16 key
+     length and u16 name length and its name, the index file name */
+  SERVICE_INDEXES = 4
+};
+
+/**
+ * Flag of a request asking for the records of the entries found
+ */
+const std::uint8_t SERVICE_RECORDS = 1;
+
+/**
+ * @brief Status of the response to a request.
+ */
+enum ServiceStatus {
+  SERVICE_OK = 0,          /* The body holds the result */
+  SERVICE_BAD_REQUEST = 1, /* Malformed, or naming no index; no body */
+  SERVICE_FAILED = 2       /* The index could not answer; no body */
+};
+
+/**
+ * Number of entries a response to a lookup, a scan or a probe holds at most,
+ * whatever its maxRids or limit; the keys of a probe share them equally
+ */
+const std::uint32_t SERVICE_MAX_ENTRIES = 1 << 20;
+
+/**
+ * Number of keys a probe holds at most; a probe of more is a bad request
+ */
+const std::uint32_t SERVICE_MAX_KEYS = 1 << 16;
+
+/**
+ * Length of a request frame at most; the connection of a longer one is closed
+ */
+const std::uint32_t SERVICE_MAX_FRAME = 16 << 20;
+
+/**
+ * @brief Counts of the work of an IndexService since it was created.
+ */
+struct ServiceStats {
+  std::uint64_t connections;
+  std::uint64_t requests;
+  std::uint64_t badRequests;
+  std::uint64_t entriesReturned;
+};
+
+/**
+ * @brief Server answering index lookups, range scans and batches of lookups
+ * over TCP, so that a client, such as a web application, reaches the indexes
+ * of a warm buffer pool without opening them itself.
+ *
+ * The indexes are opened once, when added, and shared by the connections,
+ * each of which is served by a thread of its own.  A connection reads all
+ * the requests that have arrived, answers them in order and sends their
+ * responses together, so pipelined requests cost a read and a write per
+ * batch.  The indexes are opened as concurrent indexes if the buffer manager
+ * is concurrent and they hold no posting lists; the requests to any other
+ * index are served one at a time.  Nothing is changed: the indexes and
+ * relations must not be written meanwhile.
+ */
+class IndexService {
+ public:
+  /**
+   * Creates a service with no index.
+   *
+   * @param bufMgrIn  Buffer manager the indexes and relations are read
+   *                  through, concurrent for requests to be served in parallel
+   */
+  explicit IndexService(BufMgr *bufMgrIn);
+
+  /**
+   * Closes the port and the indexes; run() must have returned.
+   */
+  ~IndexService();
+
+  IndexService(const IndexService &) = delete;
+  IndexService &operator=(const IndexService &) = delete;
+
+  /**
+   * Opens an index of a relation, building it if its file does not exist,
+   * to be served under the next number, from 0.  Must not be called once the
+   * service runs.
+   *
+   * @param relationName  Name of the relation
+   * @param keyColumns    Attributes the keys are built from, as given to
+   *                      BTreeIndex
+   * @return  The number of the index in requests
+   * @throws  BadIndexInfoException   As the BTreeIndex constructor.
+   */
+  int addIndex(const std::string &relationName,
+               const std::vector<KeyColumn> &keyColumns);
+
+  /**
+   * Binds the service to a TCP port of every interface.
+   *
+   * @param port  Port to listen on, or 0 for any free port
+   * @return  The port listened on
+   * @throws  BadgerDbException   If the port can not be listened on.
+   */
+  int bind(int port);
+
+  /**
+   * Accepts connections to the bound port, serving each on a thread of its
+   * own, until stop() is called; then closes the connections and waits for
+   * their threads.
+   */
+  void run();
+
+  /**
+   * Makes run() return; may be called from any thread.
+   */
+  void stop();
+
+  /**
+   * Serves the requests of a connected socket until the peer closes it or
+   * sends a frame that is too long.  The socket is left open.
+   *
+   * @param fd  The socket
+   */
+  void serveConnection(int fd);
+
+  /**
+   * Answers the requests in the given bytes, appending their responses to
+   * out, and returns the number of bytes of the whole frames answered.
+   *
+   * @param in    Bytes received
+   * @param size  Number of bytes received
+   * @param out   Buffer the responses are appended to
+   * @return  The number of bytes answered, or -1 if a frame is too long
+   */
+  long answer(const char *in, std::size_t size, std::vector<char> &out);
+
+  /**
+   * Returns the counts of the work done so far.
+   */
+  ServiceStats getStats() const;
+
+ private:
+  /**
+   * @brief An index served, and the relation its records are fetched from.
+   */
+  struct Served {
+    std::string relationName;
+    std::string indexName;
+    std::unique_ptr<BTreeIndex> index;
+    std::size_t keySize;
+
+    /**
+     * True if the index is not concurrent, so that its requests take latch
+     */
+    bool serialized;
+    std::mutex latch;
+
+    /**
+     * Fetcher of records, opened by the first request for them
+     */
+    std::unique_ptr<HeapFetch> heap;
+    std::mutex heapLatch;
+  };
+
+  /**
+   * Answers one request, appending its response to out.
+   */
+  void answerRequest(const char *request, std::size_t length,
+                     std::vector<char> &out);
+
+  /**
+   * Answers a request to an index, appending the body of its response to out
+   * if it succeeds.
+   */
+  ServiceStatus answerIndex(Served &served, std::uint8_t op,
+                            std::uint8_t flags, const char *pos,
+                            const char *end, std::vector<char> &out);
+
+  /**
+   * Appends the entries of the given record ids to out, with their records
+   * if asked for.
+   */
+  void appendEntries(Served &served, const RecordId *rids, std::size_t n,
+                     bool records, std::vector<char> &out);
+
+  BufMgr *bufMgr;
+  std::vector<std::unique_ptr<Served>> indexes;
+
+  /**
+   * Listening socket, or -1
+   */
+  int listenFd = -1;
+  std::atomic<bool> stopping{false};
+
+  /**
+   * Sockets of the connections being served, each by a detached thread
+   */
+  std::mutex connectionsLatch;
+  std::set<int> connectionFds;
+  std::condition_variable connectionsDone;
+
+  std::atomic<std::uint64_t> numConnections{0};
+  std::atomic<std::uint64_t> numRequests{0};
+  std::atomic<std::uint64_t> numBadRequests{0};
+  std::atomic<std::uint64_t> numEntriesReturned{0};
+};
+
+/**
+ * @brief Client of an IndexService, sending requests over one connection.
+ *
+ * Requests are queued with the add methods and sent together by flush(),
+ * and their responses read in order by next(), so that a batch costs a round
+ * trip rather than one per request.  Not latched; used by one thread at a
+ * time.
+ */
+class ServiceClient {
+ public:
+  /**
+   * @brief Response to a request.
+   */
+  struct Response {
+    std::uint32_t tag;
+    ServiceStatus status;
+    /**
+     * Body of the response, decoded by the reader methods below
+     */
+    std::vector<char> body;
+  };
+
+  /**
+   * Connects to a service.
+   *
+   * @param host  Address of the host, such as "127.0.0.1"
+   * @param port  Port of the service
+   * @throws  BadgerDbException   If the service can not be reached.
+   */
+  ServiceClient(const std::string &host, int port);
+
+  /**
+   * Closes the connection.
+   */
+  ~ServiceClient();
+
+  ServiceClient(const ServiceClient &) = delete;
+  ServiceClient &operator=(const ServiceClient &) = delete;
+
+  /**
+   * Queues a request, returning its tag.
+   *
+   * @param op      Operation
+   * @param flags   Flags, such as SERVICE_RECORDS
+   * @param index   Number of the index
+   * @param body    Body of the request
+   * @param length  Length of the body
+   */
+  std::uint32_t add(ServiceOp op, std::uint8_t flags, std::uint16_t index,
+                    const void *body, std::size_t length);
+
+  /**
+   * Queues a lookup of a key, returning its tag.
+   */
+  std::uint32_t addLookup(std::uint16_t index, const void *key,
+                          std::size_t keySize, std::uint32_t maxRids,
+                          std::uint8_t flags = 0);
+
+  /**
+   * Queues a scan of a range, returning its tag.
+   */
+  std::uint32_t addScan(std::uint16_t index, const void *lowVal,
+                        Operator lowOp, const void *highVal, Operator highOp,
+                        std::size_t keySize, std::uint32_t limit,
+                        std::uint8_t flags = 0);
+
+  /**
+   * Queues lookups of numKeys keys stored one after another, returning the
+   * tag of the request.
+   */
+  std::uint32_t addProbe(std::uint16_t index, const void *keys,
+                         std::size_t numKeys, std::size_t keySize,
+                         std::uint32_t maxRids, std::uint8_t flags = 0);
+
+  /**
+   * Sends the queued requests.
+   */
+  void flush();
+
+  /**
+   * Reads the response to the next request sent, flushing first if none is
+   * outstanding.
+   *
+   * @throws  BadgerDbException   If the connection is closed.
+   */
+  Response next();
+
+  /**
+   * Decodes a number of entries, then as many entries, from the body of a
+   * response at the given position, which is moved past them.  Returns the
+   * record ids, and appends the records to records if it is not null.
+   *
+   * @throws  BadgerDbException   If the body ends before the entries do.
+   */
+  static std::vector<RecordId> readEntries(
+      const Response &response, std::size_t &pos, bool withRecords,
+      std::vector<std::string> *records = nullptr);
+
+ private:
+  int fd;
+  std::uint32_t nextTag = 0;
+  std::size_t outstanding = 0;
+  std::vector<char> out;
+  std::vector<char> in;
+  std::size_t inStart = 0;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,295 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "sort.h"
+#include <algorithm>
+#include <cstring>
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb {
+
+// a page of a run starts with the number of the next page of the run, and its
+// rows follow at an aligned offset
+static const std::size_t RUNHEADERSIZE = 8;
+
+static PageId nextRunPage(const Page &page) {
+  PageId next;
+  memcpy(&next, &page, sizeof(next));
+  return next;
+}
+
+static void setNextRunPage(Page *page, PageId next) {
+  memcpy(reinterpret_cast<char *>(page), &next, sizeof(next));
+}
+
+ExternalSort::ExternalSort(std::size_t size,
+                           const std::vector<KeyColumn> &columns,
+                           BufMgr *bufferMgr, const std::string &name,
+                           std::size_t pages)
+    : rowSize(size),
+      keyColumns(columns),
+      bufMgr(bufferMgr),
+      tempName(name),
+      memoryPages(std::max<std::size_t>(pages, 4)),
+      bufferRows(0),
+      state(0),
+      bufferPos(0),
+      winnerTaken(false),
+      nextRun(0),
+      runsWritten(0),
+      mergePasses(0) {
+  rowsPerPage = (Page::BLOB_SIZE - RUNHEADERSIZE) / rowSize;
+  // each run merged has its page and the page read ahead of it in the pool
+  fanIn = memoryPages / 2;
+  buffer.resize(memoryPages * rowsPerPage * rowSize);
+}
+
+ExternalSort::~ExternalSort() {
+  try {
+    closeMerge();
+  } catch (...) {
+  }
+  for (const Run &run : runs) {
+    try {
+      File::remove(run.name);
+    } catch (FileNotFoundException e) {
+    }
+  }
+}
+
+int ExternalSort::compareRows(const char *a, const char *b) const {
+  for (const KeyColumn &column : keyColumns) {
+    const char *x = a + column.byteOffset;
+    const char *y = b + column.byteOffset;
+    int c;
+    if (column.type == INTEGER) {
+      int i, j;
+      memcpy(&i, x, sizeof(int));
+      memcpy(&j, y, sizeof(int));
+      c = (i > j) - (i < j);
+    } else if (column.type == DOUBLE) {
+      double i, j;
+      memcpy(&i, x, sizeof(double));
+      memcpy(&j, y, sizeof(double));
+      c = (i > j) - (i < j);
+    } else {
+      c = strncmp(x, y, rowSize - column.byteOffset);
+    }
+    if (c != 0) return c;
+  }
+  return 0;
+}
+
+void ExternalSort::add(const void *row) {
+  if (bufferRows * rowSize == buffer.size()) spillBuffer();
+  memcpy(buffer.data() + bufferRows * rowSize, row, rowSize);
+  bufferRows++;
+}
+
+void ExternalSort::sortBuffer() {
+  order.resize(bufferRows);
+  for (std::size_t k = 0; k < bufferRows; k++) order[k] = k;
+  const char *rows = buffer.data();
+  std::stable_sort(order.begin(), order.end(),
+                   [this, rows](std::uint32_t a, std::uint32_t b) {
+                     return compareRows(rows + a * rowSize,
+                                        rows + b * rowSize) < 0;
+                   });
+}
+
+void ExternalSort::spillBuffer() {
+  sortBuffer();
+  const char *rows = buffer.data();
+  std::size_t pos = 0;
+  auto nextRow = [&]() -> const char * {
+    return pos == bufferRows ? NULL : rows + order[pos++] * rowSize;
+  };
+  runs.push_back(writeRun(nextRow));
+  bufferRows = 0;
+}
+
+template <class NextRow>
+ExternalSort::Run ExternalSort::writeRun(NextRow &nextRow) {
+  Run run{runName(), Page::INVALID_NUMBER, 0};
+  try {
+    File::remove(run.name);
+  } catch (FileNotFoundException e) {
+  }
+  BlobFile file(run.name, true);
+  PageId pageNo = Page::INVALID_NUMBER;
+  Page *page = NULL;
+  try {
+    while (const char *row = nextRow()) {
+      const std::size_t onPage = run.numRows % rowsPerPage;
+      if (onPage == 0) {
+        // the page before is chained to the new one before it is let go
+        PageId newPageNo;
+        Page *newPage;
+        bufMgr->allocPage(&file, newPageNo, newPage);
+        setNextRunPage(newPage, Page::INVALID_NUMBER);
+        if (page != NULL) {
+          setNextRunPage(page, newPageNo);
+          bufMgr->unPinPage(&file, pageNo, true);
+        } else {
+          run.firstPageNo = newPageNo;
+        }
+        page = newPage;
+        pageNo = newPageNo;
+      }
+      memcpy((char *)page + RUNHEADERSIZE + onPage * rowSize, row, rowSize);
+      run.numRows++;
+    }
+  } catch (...) {
+    if (page != NULL) bufMgr->unPinPage(&file, pageNo, true);
+    bufMgr->flushFile(&file);
+    throw;
+  }
+  if (page != NULL) bufMgr->unPinPage(&file, pageNo, true);
+  bufMgr->flushFile(&file);
+  runsWritten++;
+  return run;
+}
+
+const char *ExternalSort::readerRow(std::size_t r) const {
+  return (const char *)readers[r].page + RUNHEADERSIZE +
+         readers[r].pos * rowSize;
+}
+
+bool ExternalSort::beats(std::size_t a, std::size_t b) const {
+  if (readers[a].rowsLeft == 0) return false;
+  if (readers[b].rowsLeft == 0) return true;
+  const int c = compareRows(readerRow(a), readerRow(b));
+  return c < 0 || (c == 0 && a < b);
+}
+
+std::size_t ExternalSort::buildTree(std::size_t node) {
+  // the leaves are nodes k..2k-1, for run 0..k-1
+  const std::size_t k = readers.size();
+  if (node >= k) return node - k;
+  const std::size_t left = buildTree(2 * node);
+  const std::size_t right = buildTree(2 * node + 1);
+  if (beats(left, right)) {
+    tree[node] = right;
+    return left;
+  }
+  tree[node] = left;
+  return right;
+}
+
+void ExternalSort::openMerge(std::vector<Run>::const_iterator first,
+                             std::vector<Run>::const_iterator last) {
+  merging.assign(first, last);
+  readers.clear();
+  for (const Run &run : merging) {
+    RunReader reader{new BlobFile(run.name, false), run.firstPageNo, NULL, 0,
+                     run.numRows};
+    readers.push_back(reader);
+    if (run.numRows == 0) continue;
+    RunReader &r = readers.back();
+    bufMgr->readPage(r.file, r.pageNo, r.page);
+    bufMgr->prefetch(r.file, nextRunPage(*r.page), nextRunPage,
+                     NORMAL_ACCESS);
+  }
+  tree.assign(readers.size(), 0);
+  tree[0] = buildTree(1);
+}
+
+void ExternalSort::advanceWinner() {
+  const std::size_t k = readers.size();
+  std::size_t winner = tree[0];
+  RunReader &r = readers[winner];
+  r.rowsLeft--;
+  r.pos++;
+  if (r.rowsLeft == 0) {
+    bufMgr->unPinPage(r.file, r.pageNo, false);
+    r.page = NULL;
+  } else if (r.pos == rowsPerPage) {
+    const PageId next = nextRunPage(*r.page);
+    bufMgr->unPinPage(r.file, r.pageNo, false);
+    r.page = NULL;
+    r.pageNo = next;
+    r.pos = 0;
+    bufMgr->readPage(r.file, r.pageNo, r.page);
+    bufMgr->prefetch(r.file, nextRunPage(*r.page), nextRunPage,
+                     NORMAL_ACCESS);
+  }
+
+  // the winner's row plays the losers on its path to the root again
+  for (std::size_t node = (winner + k) / 2; node >= 1; node /= 2) {
+    if (beats(tree[node], winner)) std::swap(tree[node], winner);
+  }
+  tree[0] = winner;
+}
+
+void ExternalSort::closeMerge() {
+  for (RunReader &r : readers) {
+    if (r.page != NULL) bufMgr->unPinPage(r.file, r.pageNo, false);
+    bufMgr->flushFile(r.file);
+    delete r.file;
+  }
+  readers.clear();
+  for (const Run &run : merging) {
+    try {
+      File::remove(run.name);
+    } catch (FileNotFoundException e) {
+    }
+  }
+  merging.clear();
+}
+
+const char *ExternalSort::next() {
+  if (state == 0) {
+    if (runs.empty()) {
+      // every row fits in the buffer
+      state = 1;
+      sortBuffer();
+    } else {
+      if (bufferRows > 0) spillBuffer();
+      state = 2;
+      // each pass merges fanIn runs at a time, keeping them in order, until
+      // the last merge can take all of the runs left
+      while (runs.size() > fanIn) {
+        std::vector<Run> merged;
+        for (std::size_t i = 0; i < runs.size(); i += fanIn) {
+          const std::size_t end = std::min(runs.size(), i + fanIn);
+          if (end - i == 1) {
+            merged.push_back(runs[i]);
+            continue;
+          }
+          openMerge(runs.begin() + i, runs.begin() + end);
+          bool first = true;
+          auto nextRow = [&]() -> const char * {
+            if (!first) advanceWinner();
+            first = false;
+            return readers[tree[0]].rowsLeft == 0 ? NULL : readerRow(tree[0]);
+          };
+          merged.push_back(writeRun(nextRow));
+          closeMerge();
+        }
+        runs.swap(merged);
+        mergePasses++;
+      }
+      openMerge(runs.begin(), runs.end());
+      runs.clear();
+    }
+  }
+
+  if (state == 1) {
+    if (bufferPos == bufferRows) return NULL;
+    return buffer.data() + order[bufferPos++] * rowSize;
+  }
+  if (readers.empty()) return NULL;
+  if (winnerTaken) advanceWinner();
+  winnerTaken = true;
+  if (readers[tree[0]].rowsLeft == 0) {
+    closeMerge();
+    return NULL;
+  }
+  return readerRow(tree[0]);
+}
+
+}
@@ -0,0 +1,207 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "buffer.h"
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Sorts rows of a fixed size by some of their attributes, with a
+ * bounded amount of memory.
+ *
+ * Rows are collected in a buffer of memoryPages pages.  Each time it fills,
+ * it is sorted and written out as a run to a temporary BlobFile through the
+ * buffer manager.  The runs are then merged with a loser tree, memoryPages / 2
+ * of them at a time, in as many passes as needed to leave few enough for a
+ * last merge that returns the rows.  While a run is merged, the page after
+ * the one being read is asked for from the buffer manager's read-ahead, which
+ * a concurrent buffer manager with a prefetch depth serves in the background.
+ * Rows that fit in the buffer are sorted in memory without any I/O.
+ *
+ * The sort is stable: rows with equal keys come out in the order they were
+ * added.
+ */
+class ExternalSort {
+ public:
+  /**
+   * Creates a sort with no rows.
+   *
+   * @param rowSize     Bytes of each row, at most a page less a few bytes
+   * @param keyColumns  Attributes of the rows they are sorted by, in order;
+   *                    strings end at a zero byte or at the end of the row
+   * @param bufMgr      Buffer manager the runs are written and read through;
+   *                    it has at least memoryPages frames free
+   * @param tempName    Prefix of the names of the files of the runs
+   * @param memoryPages Pages of rows sorted in memory at once, at least 4
+   */
+  ExternalSort(std::size_t rowSize, const std::vector<KeyColumn> &keyColumns,
+               BufMgr *bufMgr, const std::string &tempName,
+               std::size_t memoryPages);
+
+  /**
+   * Removes the files of the runs left.
+   */
+  ~ExternalSort();
+
+  /**
+   * Adds a row.  No rows are added once the first one has been returned.
+   *
+   * @param row  rowSize bytes of the row
+   */
+  void add(const void *row);
+
+  /**
+   * Returns the next row in sorted order, merging the runs down to the last
+   * merge on the first call.
+   *
+   * @return  The row, valid until the next call, or NULL once all rows have
+   *          been returned
+   */
+  const char *next();
+
+  /**
+   * Returns the number of runs written, by run formation and by merges.
+   */
+  std::size_t numRuns() const { return runsWritten; }
+
+  /**
+   * Returns the number of merge passes that wrote runs.
+   */
+  std::size_t numMergePasses() const { return mergePasses; }
+
+ private:
+  /**
+   * @brief A sorted run: a file of pages chained one after another.
+   */
+  struct Run {
+    std::string name;
+    PageId firstPageNo;
+    std::size_t numRows;
+  };
+
+  /**
+   * @brief The page of a run being read, and the position in it.
+   */
+  struct RunReader {
+    File *file;
+    PageId pageNo;
+    Page *page;
+    std::size_t pos;
+    std::size_t rowsLeft;
+  };
+
+  /**
+   * Sorts the rows in the buffer into order.
+   */
+  void sortBuffer();
+
+  /**
+   * Sorts the rows in the buffer and writes them out as a run.
+   */
+  void spillBuffer();
+
+  /**
+   * Writes the rows nextRow() returns, until it returns NULL, as a new run.
+   */
+  template <class NextRow>
+  Run writeRun(NextRow &nextRow);
+
+  /**
+   * Opens runs for a merge, each with its first page pinned, and builds the
+   * loser tree over them.
+   */
+  void openMerge(std::vector<Run>::const_iterator first,
+                 std::vector<Run>::const_iterator last);
+
+  /**
+   * Moves the winner of the merge to its next row, and replays its path in
+   * the loser tree.
+   */
+  void advanceWinner();
+
+  /**
+   * Unpins the pages of the runs of the merge, closes their files and removes
+   * them.
+   */
+  void closeMerge();
+
+  /**
+   * Returns the current row of a run of the merge.
+   */
+  const char *readerRow(std::size_t r) const;
+
+  /**
+   * Returns true if run a's row goes out before run b's; exhausted runs go
+   * out last, and equal rows by the order of their runs.
+   */
+  bool beats(std::size_t a, std::size_t b) const;
+
+  /**
+   * Returns the winner of the subtree of a node, storing the losers in it.
+   */
+  std::size_t buildTree(std::size_t node);
+
+  /**
+   * Compares two rows by the key attributes.
+   */
+  int compareRows(const char *a, const char *b) const;
+
+  std::string runName() {
+    return tempName + ".run" + std::to_string(nextRun++);
+  }
+
+  std::size_t rowSize;
+  std::vector<KeyColumn> keyColumns;
+  BufMgr *bufMgr;
+  std::string tempName;
+  std::size_t memoryPages;
+
+  /**
+   * Rows on a page of a run, and runs merged at once.
+   */
+  std::size_t rowsPerPage;
+  std::size_t fanIn;
+
+  /**
+   * Rows collected for the next run, and their order once sorted.
+   */
+  std::vector<char> buffer;
+  std::size_t bufferRows;
+  std::vector<std::uint32_t> order;
+
+  std::vector<Run> runs;
+
+  /**
+   * The runs being merged, and the loser tree over them: tree[0] is the run
+   * whose row goes out next, and tree[1..k-1] the losers of the matches.
+   */
+  std::vector<RunReader> readers;
+  std::vector<Run> merging;
+  std::vector<std::size_t> tree;
+
+  /**
+   * 0 while rows are added, 1 once they are returned from the buffer, 2 once
+   * they are returned from a merge.
+   */
+  int state;
+  std::size_t bufferPos;
+  bool winnerTaken;
+
+  std::size_t nextRun;
+  std::size_t runsWritten;
+  std::size_t mergePasses;
+};
+
+}
@@ -0,0 +1,118 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "stats.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include "file.h"
+#include "page_iterator.h"
+#include "exceptions/invalid_page_exception.h"
+
+namespace badgerdb {
+
+RelationSample::RelationSample(const std::string &relationName,
+                               BufMgr *bufMgr, std::size_t sampleSize,
+                               std::size_t maxPages, std::uint32_t seed)
+    : pagesRead(0), recordsEstimate(0) {
+  PageFile file(relationName, false);
+  std::mt19937 random(seed);
+
+  // pages are numbered from 1 up to below the number allocated
+  const PageId numPages = file.getNumPages();
+  std::vector<PageId> pages;
+  for (PageId pageNo = 1; pageNo < numPages; pageNo++) {
+    if (pages.size() < maxPages) {
+      pages.push_back(pageNo);
+      continue;
+    }
+    std::uniform_int_distribution<std::size_t> pick(0, pageNo - 1);
+    const std::size_t k = pick(random);
+    if (k < maxPages) pages[k] = pageNo;
+  }
+  std::sort(pages.begin(), pages.end());
+
+  std::size_t recordsSeen = 0;
+  for (PageId pageNo : pages) {
+    pagesRead++;
+    Page *page;
+    try {
+      bufMgr->readPage(&file, pageNo, page, SEQUENTIAL_ACCESS);
+    } catch (InvalidPageException e) {
+      // a free page, or a page of the free space map
+      continue;
+    }
+    for (PageIterator it = page->begin(); it != page->end(); ++it) {
+      recordsSeen++;
+      if (records.size() < sampleSize) {
+        records.push_back(it.view().str());
+        continue;
+      }
+      std::uniform_int_distribution<std::size_t> pick(0, recordsSeen - 1);
+      const std::size_t k = pick(random);
+      if (k < sampleSize) records[k] = it.view().str();
+    }
+    bufMgr->unPinPage(&file, pageNo, false);
+  }
+  bufMgr->flushFile(&file);
+  if (pagesRead > 0)
+    recordsEstimate = (double)recordsSeen * (numPages - 1) / pagesRead;
+}
+
+std::vector<int> RelationSample::intValues(int byteOffset) const {
+  std::vector<int> values;
+  values.reserve(records.size());
+  for (const std::string &record : records) {
+    if (record.size() < byteOffset + sizeof(int)) continue;
+    int value;
+    memcpy(&value, record.data() + byteOffset, sizeof(int));
+    values.push_back(value);
+  }
+  return values;
+}
+
+EquiDepthHistogram::EquiDepthHistogram(std::vector<int> values,
+                                       int numBuckets) {
+  std::sort(values.begin(), values.end());
+  const std::size_t n = values.size();
+  const std::size_t count = std::min<std::size_t>(numBuckets, n);
+  for (std::size_t b = 0; b < count; b++) {
+    const std::size_t begin = b * n / count, end = (b + 1) * n / count;
+    std::size_t distinct = 1;
+    for (std::size_t k = begin + 1; k < end; k++)
+      distinct += values[k] != values[k - 1];
+    buckets.push_back(Bucket{values[begin], values[end - 1],
+                             (double)(end - begin) / n, distinct});
+  }
+}
+
+double EquiDepthHistogram::selectivity(int lowVal, Operator lowOp,
+                                       int highVal, Operator highOp) const {
+  // the range as the values it holds, from low to high
+  const std::int64_t low = (std::int64_t)lowVal + (lowOp == GT);
+  const std::int64_t high = (std::int64_t)highVal - (highOp == LT);
+  double fraction = 0;
+  for (const Bucket &bucket : buckets) {
+    const std::int64_t from = std::max<std::int64_t>(low, bucket.low);
+    const std::int64_t to = std::min<std::int64_t>(high, bucket.high);
+    if (from > to) continue;
+    const std::int64_t width = (std::int64_t)bucket.high - bucket.low + 1;
+    fraction += bucket.fraction * (to - from + 1) / width;
+  }
+  return fraction;
+}
+
+double EquiDepthHistogram::selectivity(int value) const {
+  double fraction = 0;
+  for (const Bucket &bucket : buckets) {
+    if (value >= bucket.low && value <= bucket.high)
+      fraction += bucket.fraction / bucket.distinct;
+  }
+  return fraction;
+}
+
+}
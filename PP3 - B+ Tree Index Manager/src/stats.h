@@ -0,0 +1,130 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+ * @brief A uniform random sample of the records of a relation, drawn from a
+ * random sample of its pages.
+ *
+ * The pages read are chosen by reservoir sampling over the page numbers of the
+ * file, so that no page is read to choose them, and are read through the
+ * buffer manager in the order of their numbers with SEQUENTIAL_ACCESS, so that
+ * the sample does not evict the pool.  Free pages picked are skipped.  The
+ * records of the pages read are in turn reservoir sampled, so that each has
+ * the same chance of being kept.  Reading every page gives a sample of the
+ * whole relation and its exact number of records.
+ */
+class RelationSample {
+ public:
+  /**
+   * Draws a sample.
+   *
+   * @param relationName  Name of the relation file
+   * @param bufMgr        Buffer manager to read the pages through
+   * @param sampleSize    Number of records kept, at most
+   * @param maxPages      Number of pages read, at most
+   * @param seed          Seed of the random choices
+   */
+  RelationSample(const std::string &relationName, BufMgr *bufMgr,
+                 std::size_t sampleSize, std::size_t maxPages,
+                 std::uint32_t seed = 1);
+
+  /**
+   * Returns the records kept, in no particular order.
+   */
+  const std::vector<std::string> &getRecords() const { return records; }
+
+  /**
+   * Returns the values of an INTEGER attribute of the records kept.
+   *
+   * @param byteOffset  Offset of the attribute in the records
+   */
+  std::vector<int> intValues(int byteOffset) const;
+
+  /**
+   * Returns the number of pages read, free pages picked included.
+   */
+  std::size_t numPagesRead() const { return pagesRead; }
+
+  /**
+   * Returns the number of records of the relation, scaled up from those of
+   * the pages read.
+   */
+  double estimatedRecords() const { return recordsEstimate; }
+
+ private:
+  std::vector<std::string> records;
+  std::size_t pagesRead;
+  double recordsEstimate;
+};
+
+/**
+ * @brief A histogram of the values of an INTEGER attribute whose buckets each
+ * hold about as many of the values, so that frequent values get narrow
+ * buckets and selectivities are estimated as well for skewed values as for
+ * uniform ones.
+ *
+ * Values are taken to be spread uniformly over the range of their bucket,
+ * and the values of a bucket to be equally frequent.
+ */
+class EquiDepthHistogram {
+ public:
+  /**
+   * Builds the histogram of some values, such as those of a sample.
+   *
+   * @param values      The values
+   * @param numBuckets  Number of buckets, at most the number of values
+   */
+  EquiDepthHistogram(std::vector<int> values, int numBuckets);
+
+  /**
+   * Returns the estimated fraction of the values in a range.
+   *
+   * @param lowVal   Low value of the range
+   * @param lowOp    Low operator (GT/GTE)
+   * @param highVal  High value of the range
+   * @param highOp   High operator (LT/LTE)
+   */
+  double selectivity(int lowVal, Operator lowOp, int highVal,
+                     Operator highOp) const;
+
+  /**
+   * Returns the estimated fraction of the values equal to a value.
+   */
+  double selectivity(int value) const;
+
+  /**
+   * Returns the number of buckets.
+   */
+  int numBuckets() const { return (int)buckets.size(); }
+
+ private:
+  /**
+   * @brief The values of a bucket lie in [low, high]; fraction of all the
+   * values are in it, and distinct of them are different.
+   */
+  struct Bucket {
+    int low;
+    int high;
+    double fraction;
+    std::size_t distinct;
+  };
+
+  std::vector<Bucket> buckets;
+};
+
+}
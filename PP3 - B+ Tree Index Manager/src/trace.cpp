@@ -0,0 +1,174 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "trace.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace badgerdb {
+
+std::atomic<bool> Tracer::recording(false);
+
+namespace {
+
+// The events of a thread. Its thread claims the slot of an event by raising
+// claimed, fills it in, and publishes it by raising published; a reader
+// that copied a slot keeps it only if claimed shows it was not claimed again
+// meanwhile, as with a seqlock.
+struct TraceRing {
+  struct Slot {
+    std::atomic<const TracePoint *> point;
+    std::atomic<std::uint64_t> start;
+    std::atomic<std::uint64_t> duration;
+    std::atomic<std::uint64_t> args[2];
+  };
+
+  explicit TraceRing(std::size_t id) : id(id) {}
+
+  const std::size_t id;
+  std::atomic<bool> owned{true};
+  std::atomic<std::uint64_t> claimed{0};
+  std::atomic<std::uint64_t> published{0};
+  Slot slots[Tracer::RING_EVENTS];
+};
+
+std::mutex ringsLatch;
+std::vector<std::unique_ptr<TraceRing>> rings;
+
+// gives the ring of a thread back when the thread ends
+struct RingOwner {
+  TraceRing *ring = NULL;
+  ~RingOwner() {
+    if (ring != NULL) ring->owned = false;
+  }
+};
+
+TraceRing &threadRing() {
+  thread_local RingOwner owner;
+  if (owner.ring != NULL) return *owner.ring;
+  std::lock_guard<std::mutex> guard(ringsLatch);
+  for (const std::unique_ptr<TraceRing> &ring : rings) {
+    if (!ring->owned) {
+      ring->owned = true;
+      owner.ring = ring.get();
+      return *owner.ring;
+    }
+  }
+  rings.emplace_back(new TraceRing(rings.size()));
+  owner.ring = rings.back().get();
+  return *owner.ring;
+}
+
+void writeString(std::ostream &out, const char *s) {
+  out << '"';
+  for (; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\') out << '\\';
+    out << *s;
+  }
+  out << '"';
+}
+
+}  // namespace
+
+void Tracer::enable(bool on) { recording = on; }
+
+void Tracer::record(const TracePoint &point, std::uint64_t start,
+                    std::uint64_t duration, std::uint64_t arg0,
+                    std::uint64_t arg1) {
+  TraceRing &ring = threadRing();
+  const std::uint64_t index = ring.claimed.load(std::memory_order_relaxed);
+  ring.claimed.store(index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  TraceRing::Slot &slot = ring.slots[index % RING_EVENTS];
+  slot.point.store(&point, std::memory_order_relaxed);
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.duration.store(duration, std::memory_order_relaxed);
+  slot.args[0].store(arg0, std::memory_order_relaxed);
+  slot.args[1].store(arg1, std::memory_order_relaxed);
+  ring.published.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::dump(std::ostream &out) {
+  struct Event {
+    const TracePoint *point;
+    std::uint64_t start;
+    std::uint64_t duration;
+    std::uint64_t args[2];
+  };
+
+  std::lock_guard<std::mutex> guard(ringsLatch);
+  out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+  bool first = true;
+  for (const std::unique_ptr<TraceRing> &ring : rings) {
+    const std::uint64_t end = ring->published.load(std::memory_order_acquire);
+    const std::uint64_t begin =
+        end > RING_EVENTS ? end - RING_EVENTS : 0;
+    std::vector<Event> events;
+    events.reserve(end - begin);
+    for (std::uint64_t index = begin; index < end; index++) {
+      const TraceRing::Slot &slot = ring->slots[index % RING_EVENTS];
+      events.push_back({slot.point.load(std::memory_order_relaxed),
+                        slot.start.load(std::memory_order_relaxed),
+                        slot.duration.load(std::memory_order_relaxed),
+                        {slot.args[0].load(std::memory_order_relaxed),
+                         slot.args[1].load(std::memory_order_relaxed)}});
+    }
+    // the events whose slots were claimed again while being copied are torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const std::uint64_t claimed =
+        ring->claimed.load(std::memory_order_relaxed);
+    const std::uint64_t firstWhole =
+        claimed > RING_EVENTS ? claimed - RING_EVENTS : 0;
+
+    for (std::uint64_t index = std::max(begin, firstWhole); index < end;
+         index++) {
+      const Event &event = events[index - begin];
+      const TracePoint &point = *event.point;
+      out << (first ? "\n" : ",\n") << "{\"name\": ";
+      first = false;
+      writeString(out, point.name);
+      out << ", \"cat\": ";
+      writeString(out, point.category);
+      out << ", \"ph\": \"" << (point.instant ? "i" : "X") << "\""
+          << ", \"pid\": 1, \"tid\": " << ring->id
+          << ", \"ts\": " << event.start / 1000 << '.'
+          << std::to_string(1000 + event.start % 1000).substr(1);
+      if (point.instant) {
+        out << ", \"s\": \"t\"";
+      } else {
+        out << ", \"dur\": " << event.duration / 1000 << '.'
+            << std::to_string(1000 + event.duration % 1000).substr(1);
+      }
+      out << ", \"args\": {";
+      bool firstArg = true;
+      for (int arg = 0; arg < 2; arg++) {
+        if (point.argNames[arg] == NULL) continue;
+        if (!firstArg) out << ", ";
+        firstArg = false;
+        writeString(out, point.argNames[arg]);
+        out << ": " << event.args[arg];
+      }
+      out << "}}";
+    }
+  }
+  out << "\n]}\n";
+}
+
+void Tracer::clear() {
+  std::lock_guard<std::mutex> guard(ringsLatch);
+  for (const std::unique_ptr<TraceRing> &ring : rings) {
+    ring->claimed = 0;
+    ring->published = 0;
+  }
+}
+
+}  // namespace badgerdb
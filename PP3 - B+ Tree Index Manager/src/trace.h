@@ -0,0 +1,169 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace badgerdb {
+
+/**
+ * @brief A place in the code that records trace events: the name and
+ * category the events are shown under, and the names of their two arguments,
+ * NULL for an argument not shown.
+ */
+struct TracePoint {
+  const char *name;
+  const char *category;
+  const char *argNames[2];
+  bool instant;
+};
+
+/**
+ * @brief Records events of the buffer manager, the files and the indexes in a
+ * ring buffer per thread, and writes them out in the Chrome trace event
+ * format, which chrome://tracing and Perfetto open.
+ *
+ * The code records events through the TRACE_SCOPE and TRACE_EVENT macros.
+ * They compile to nothing unless BADGERDB_TRACING is defined, and otherwise
+ * record nothing until tracing is enabled, at the cost of a load and a branch.
+ * A thread records into its own ring without any lock, overwriting its oldest
+ * events once RING_EVENTS are held, so a trace shows the last events of each
+ * thread. Rings are kept after their threads end, and reused by new threads.
+ */
+class Tracer {
+ public:
+  /**
+   * Number of events a ring holds
+   */
+  static const std::size_t RING_EVENTS = 1 << 14;
+
+  /**
+   * Starts or stops recording events.
+   */
+  static void enable(bool on);
+
+  /**
+   * Returns whether events are being recorded.
+   */
+  static bool enabled() { return recording.load(std::memory_order_relaxed); }
+
+  /**
+   * Returns the time events are stamped with, in nanoseconds.
+   */
+  static std::uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /**
+   * Records an event in the ring of the calling thread.
+   *
+   * @param point     Where the event happened
+   * @param start     Time the event started
+   * @param duration  Nanoseconds the event took, 0 for an instant event
+   * @param arg0      Value of the first argument
+   * @param arg1      Value of the second argument
+   */
+  static void record(const TracePoint &point, std::uint64_t start,
+                     std::uint64_t duration, std::uint64_t arg0,
+                     std::uint64_t arg1);
+
+  /**
+   * Writes the events held by the rings as a Chrome trace. Threads may
+   * record meanwhile; an event they overwrite while it is being written out
+   * is left out.
+   */
+  static void dump(std::ostream &out);
+
+  /**
+   * Drops the events held by the rings. No thread may record meanwhile.
+   */
+  static void clear();
+
+ private:
+  static std::atomic<bool> recording;
+};
+
+/**
+ * @brief Records an event lasting from its construction to its destruction,
+ * if tracing was enabled when it was constructed.
+ */
+class TraceScope {
+ public:
+  TraceScope(const TracePoint &point, std::uint64_t arg0, std::uint64_t arg1)
+      : point(point), active(Tracer::enabled()), args{arg0, arg1} {
+    if (active) start = Tracer::now();
+  }
+
+  ~TraceScope() {
+    if (active) {
+      Tracer::record(point, start, Tracer::now() - start, args[0], args[1]);
+    }
+  }
+
+  /**
+   * Sets an argument to a value known only once the event is under way.
+   */
+  void setArg(int index, std::uint64_t value) { args[index] = value; }
+
+ private:
+  const TracePoint &point;
+  const bool active;
+  std::uint64_t start{};
+  std::uint64_t args[2];
+};
+
+}  // namespace badgerdb
+
+#ifdef BADGERDB_TRACING
+
+/**
+ * Records the rest of the enclosing block as an event. At most one per block,
+ * whose arguments TRACE_SET_ARG may set.
+ */
+#define TRACE_SCOPE(name, category, arg0Name, arg0, arg1Name, arg1)         \
+  static const ::badgerdb::TracePoint tracePoint{                          \
+      name, category, {arg0Name, arg1Name}, false};                        \
+  ::badgerdb::TraceScope traceScope(tracePoint, (std::uint64_t)(arg0),     \
+                                    (std::uint64_t)(arg1))
+
+#define TRACE_SET_ARG(index, value) traceScope.setArg(index, (value))
+
+/**
+ * Records an instant event.
+ */
+#define TRACE_EVENT(name, category, arg0Name, arg0, arg1Name, arg1)          \
+  do {                                                                      \
+    static const ::badgerdb::TracePoint tracePoint{                         \
+        name, category, {arg0Name, arg1Name}, true};                        \
+    if (::badgerdb::Tracer::enabled()) {                                    \
+      ::badgerdb::Tracer::record(tracePoint, ::badgerdb::Tracer::now(), 0,  \
+                                 (std::uint64_t)(arg0),                     \
+                                 (std::uint64_t)(arg1));                    \
+    }                                                                       \
+  } while (0)
+
+#else
+
+#define TRACE_SCOPE(name, category, arg0Name, arg0, arg1Name, arg1) \
+  do {                                                              \
+  } while (0)
+#define TRACE_SET_ARG(index, value) \
+  do {                              \
+  } while (0)
+#define TRACE_EVENT(name, category, arg0Name, arg0, arg1Name, arg1) \
+  do {                                                              \
+  } while (0)
+
+#endif
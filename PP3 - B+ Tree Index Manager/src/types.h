@@ -24,6 +24,11 @@ typedef std::uint16_t SlotId;
  */
 typedef std::uint32_t FrameId;
 
+/**
+ * @brief Identifier for a File object, never reused by another; 0 is none.
+ */
+typedef std::uint32_t FileId;
+
 /**
  * @brief Identifier for a record in a page.
  */
@@ -59,4 +64,39 @@ struct RecordId {
   }
 };
 
+/**
+ * @brief Datatype enumeration type.
+ */
+enum Datatype { INTEGER = 0, DOUBLE = 1, STRING = 2 };
+
+/**
+ * @brief Scan operations enumeration. Passed to BTreeIndex::startScan() method
+ * and in the predicates of a filtered FileScan.
+ */
+enum Operator {
+  LT,  /* Less Than */
+  LTE, /* Less Than or Equal to */
+  GTE, /* Greater Than or Equal to */
+  GT,  /* Greater Than */
+  EQ,  /* Equal to; only in the predicates of a FileScan */
+  NE   /* Not Equal to; only in the predicates of a FileScan */
+};
+
+/**
+ * @brief An attribute of the records of a relation: its offset inside the
+ * record and its type.  Composite keys and the columns of a TupleBatch are
+ * built from them.
+ */
+struct KeyColumn {
+  /**
+   * Offset of the attribute inside the record.
+   */
+  int byteOffset;
+
+  /**
+   * Type of the attribute.
+   */
+  Datatype type;
+};
+
 }
@@ -0,0 +1,455 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "wal.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+
+namespace badgerdb {
+
+// a record is its body length, a checksum of its type and body, its type and
+// its body
+static const std::size_t RECORDHEADERSIZE = 9;
+
+static const char FILE_RECORD = 'F';
+static const char PAGE_RECORD = 'P';
+static const char COMMIT_RECORD = 'C';
+
+// how the pages of a named file are stored
+static const char PAGE_FILE = 'P';
+static const char BLOB_FILE = 'B';
+
+// changed bytes are looked for a word at a time, and ranges closer than this
+// are logged as one, since a range costs a header of its own
+static const std::size_t DIFFWORD = 8;
+static const std::size_t DIFFGAP = 16;
+
+static std::uint32_t checksum(char type, const char *body, std::size_t len) {
+  // FNV-1a
+  std::uint32_t hash = 2166136261u;
+  hash = (hash ^ (unsigned char)type) * 16777619u;
+  for (std::size_t i = 0; i < len; i++)
+    hash = (hash ^ (unsigned char)body[i]) * 16777619u;
+  return hash;
+}
+
+static void writeAll(int fd, const char *data, std::size_t len) {
+  while (len > 0) {
+    const ssize_t written = ::write(fd, data, len);
+    if (written <= 0) return;
+    data += written;
+    len -= written;
+  }
+}
+
+LogManager::LogManager(const std::string &name, std::uint32_t group,
+                       std::size_t size)
+    : logName(name),
+      commitGroup(std::max<std::uint32_t>(group, 1)),
+      segmentSize(size),
+      checkpointed(0),
+      nextFileId(1),
+      nextLsn(0),
+      lastCommit(0),
+      durable(0),
+      commitsWaiting(0),
+      flushing(false),
+      redone(0) {
+  const std::vector<std::string> names = segmentNames(logName);
+  recover();
+  // numbers keep growing, so that segments left by a crash while the old
+  // ones were deleted are still read in order
+  std::lock_guard<std::mutex> guard(latch);
+  openSegment(names.empty()
+                  ? 0
+                  : std::stoull(names.back().substr(logName.size() + 1)) + 1);
+}
+
+LogManager::~LogManager() {
+  flush();
+  for (const Segment &segment : segments) ::close(segment.fd);
+}
+
+std::vector<std::string> LogManager::segmentNames(
+    const std::string &logName) {
+  const std::size_t slash = logName.rfind('/');
+  const std::string dir = slash == std::string::npos
+                              ? "."
+                              : slash == 0 ? "/" : logName.substr(0, slash);
+  const std::string prefix = logName.substr(0, slash + 1);
+  const std::string base = logName.substr(slash + 1) + ".";
+
+  std::vector<std::pair<std::uint64_t, std::string> > found;
+  DIR *d = ::opendir(dir.c_str());
+  if (d == NULL) return std::vector<std::string>();
+  while (struct dirent *entry = ::readdir(d)) {
+    const std::string name = entry->d_name;
+    if (name.size() <= base.size() || name.compare(0, base.size(), base) != 0)
+      continue;
+    const std::string number = name.substr(base.size());
+    if (number.size() > 18 ||
+        number.find_first_not_of("0123456789") != std::string::npos)
+      continue;
+    found.push_back(std::make_pair(std::stoull(number), prefix + name));
+  }
+  ::closedir(d);
+  std::sort(found.begin(), found.end());
+
+  std::vector<std::string> names;
+  for (auto &segment : found) names.push_back(segment.second);
+  return names;
+}
+
+void LogManager::remove(const std::string &logName) {
+  for (const std::string &name : segmentNames(logName))
+    ::unlink(name.c_str());
+}
+
+void LogManager::openSegment(std::uint64_t number) {
+  const std::string name = logName + "." + std::to_string(number);
+  const int fd = ::open(name.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) throw FileNotFoundException(name);
+  segments.push_back(Segment{number, nextLsn, fd});
+  // each segment names the files it changes, so that it is read on its own
+  // once the ones before are dropped
+  named.clear();
+}
+
+void LogManager::recover() {
+  // records do not span segments, so the segments are read as one log
+  const std::vector<std::string> names = segmentNames(logName);
+  std::vector<char> log;
+  for (const std::string &name : names) {
+    const int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0) continue;
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = ::read(fd, chunk, sizeof(chunk))) > 0)
+      log.insert(log.end(), chunk, chunk + n);
+    ::close(fd);
+  }
+
+  // the files named in the log, opened when a committed record needs them
+  struct LoggedFile {
+    std::string name;
+    char kind;
+    std::unique_ptr<File> file;
+  };
+  std::map<std::uint32_t, LoggedFile> logged;
+  // pages as redone so far, written out once the whole log is read
+  std::map<std::pair<std::uint32_t, PageId>, Page> pages;
+  std::vector<std::size_t> uncommitted;
+
+  auto redo = [&](std::size_t pos, std::size_t len) {
+    std::uint32_t id;
+    PageId pageNo;
+    memcpy(&id, &log[pos], sizeof(id));
+    memcpy(&pageNo, &log[pos + 4], sizeof(pageNo));
+    auto fileIt = logged.find(id);
+    if (fileIt == logged.end()) return;
+    LoggedFile &entry = fileIt->second;
+    if (!entry.file) {
+      if (!File::exists(entry.name)) return;
+      if (entry.kind == PAGE_FILE)
+        entry.file.reset(new PageFile(entry.name, false));
+      else
+        entry.file.reset(new BlobFile(entry.name, false));
+    }
+
+    auto pageIt = pages.find(std::make_pair(id, pageNo));
+    if (pageIt == pages.end()) {
+      Page page;
+      try {
+        entry.file->readPage(pageNo, page);
+      } catch (InvalidPageException e) {
+        // a blob page the file header had not counted yet; the whole page is
+        // logged before any range of it
+        page = Page();
+      }
+      pageIt = pages.emplace(std::make_pair(id, pageNo), page).first;
+    }
+    char *image = reinterpret_cast<char *>(&pageIt->second);
+    for (std::size_t at = pos + 8; at + 4 <= pos + len;) {
+      std::uint16_t offset, length;
+      memcpy(&offset, &log[at], sizeof(offset));
+      memcpy(&length, &log[at + 2], sizeof(length));
+      memcpy(image + offset, &log[at + 4], length);
+      at += 4 + length;
+    }
+    redone++;
+  };
+
+  std::size_t pos = 0;
+  while (pos + RECORDHEADERSIZE <= log.size()) {
+    std::uint32_t len, sum;
+    memcpy(&len, &log[pos], sizeof(len));
+    memcpy(&sum, &log[pos + 4], sizeof(sum));
+    const char type = log[pos + 8];
+    const std::size_t body = pos + RECORDHEADERSIZE;
+    // a record torn by the crash ends the log
+    if (body + len > log.size() || checksum(type, &log[body], len) != sum)
+      break;
+    if (type == FILE_RECORD) {
+      std::uint32_t id;
+      memcpy(&id, &log[body], sizeof(id));
+      LoggedFile &entry = logged[id];
+      entry.kind = log[body + 4];
+      entry.name.assign(&log[body + 5], len - 5);
+    } else if (type == PAGE_RECORD) {
+      uncommitted.push_back(pos);
+    } else if (type == COMMIT_RECORD) {
+      for (std::size_t record : uncommitted) {
+        std::uint32_t recordLen;
+        memcpy(&recordLen, &log[record], sizeof(recordLen));
+        redo(record + RECORDHEADERSIZE, recordLen);
+      }
+      uncommitted.clear();
+    }
+    pos = body + len;
+  }
+
+  for (auto &page : pages) {
+    File *file = logged[page.first.first].file.get();
+    const PageId pageNo = page.first.second;
+    if (dynamic_cast<BlobFile *>(file) != NULL) {
+      // the header of the file may not have reached disk
+      while (file->getNumPages() <= pageNo) {
+        PageId newPageNo;
+        Page newPage;
+        file->allocatePage(newPageNo, newPage);
+      }
+    }
+    try {
+      file->writePage(pageNo, page.second);
+    } catch (InvalidPageException e) {
+      // a page of a relation deleted since
+    }
+  }
+  for (auto &entry : logged) {
+    if (entry.second.file) entry.second.file->sync();
+  }
+  for (const std::string &name : names) ::unlink(name.c_str());
+}
+
+void LogManager::addFile(File *file) {
+  std::lock_guard<std::mutex> guard(latch);
+  if (fileIds.count(file) > 0) return;
+  fileIds[file] = nextFileId;
+  files[nextFileId] = file;
+  nextFileId++;
+}
+
+void LogManager::removeFile(const File *file) {
+  flush();
+  std::lock_guard<std::mutex> syncGuard(syncLatch);
+  std::lock_guard<std::mutex> guard(latch);
+  auto it = fileIds.find(file);
+  if (it == fileIds.end()) return;
+  files.erase(it->second);
+  fileIds.erase(it);
+}
+
+bool LogManager::isLogged(const File *file) {
+  std::lock_guard<std::mutex> guard(latch);
+  return fileIds.count(file) > 0;
+}
+
+void LogManager::syncFiles() {
+  std::lock_guard<std::mutex> syncGuard(syncLatch);
+  std::vector<File *> logging;
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    for (auto &entry : files) logging.push_back(entry.second);
+  }
+  for (File *file : logging) file->sync();
+}
+
+Lsn LogManager::endLsn() {
+  std::lock_guard<std::mutex> guard(latch);
+  return nextLsn;
+}
+
+Lsn LogManager::append(
+    char type,
+    const std::vector<std::pair<const void *, std::size_t> > &parts) {
+  std::size_t len = 0;
+  for (auto &part : parts) len += part.second;
+  const std::size_t start = buffer.size();
+  buffer.resize(start + RECORDHEADERSIZE + len);
+  char *record = &buffer[start];
+  char *body = record + RECORDHEADERSIZE;
+  for (auto &part : parts) {
+    memcpy(body, part.first, part.second);
+    body += part.second;
+  }
+  const std::uint32_t len32 = len;
+  const std::uint32_t sum =
+      checksum(type, record + RECORDHEADERSIZE, len);
+  memcpy(record, &len32, sizeof(len32));
+  memcpy(record + 4, &sum, sizeof(sum));
+  record[8] = type;
+  nextLsn += RECORDHEADERSIZE + len;
+  logStats.bytes += RECORDHEADERSIZE + len;
+  return nextLsn;
+}
+
+std::uint32_t LogManager::fileIdOf(const File *file) {
+  const std::uint32_t id = fileIds.at(file);
+  if (named.insert(id).second) {
+    const char kind =
+        dynamic_cast<const PageFile *>(file) != NULL ? PAGE_FILE : BLOB_FILE;
+    const std::string &name = file->filename();
+    append(FILE_RECORD,
+           {{&id, sizeof(id)}, {&kind, 1}, {name.data(), name.size()}});
+  }
+  return id;
+}
+
+Lsn LogManager::logPage(const File *file, PageId pageNo, const char *image,
+                        const char *before) {
+  // the changed ranges, each as its offset and length
+  std::vector<std::uint16_t> ranges;
+  if (before == NULL) {
+    ranges.push_back(0);
+    ranges.push_back(Page::SIZE);
+  } else {
+    std::size_t i = 0;
+    while (i < Page::SIZE) {
+      if (memcmp(image + i, before + i, DIFFWORD) == 0) {
+        i += DIFFWORD;
+        continue;
+      }
+      const std::size_t start = i;
+      std::size_t end = i + DIFFWORD;
+      for (i = end; i < Page::SIZE && i < end + DIFFGAP; i += DIFFWORD) {
+        if (memcmp(image + i, before + i, DIFFWORD) != 0) end = i + DIFFWORD;
+      }
+      i = end;
+      ranges.push_back(start);
+      ranges.push_back(end - start);
+    }
+    if (ranges.empty()) return 0;
+  }
+
+  std::size_t size = RECORDHEADERSIZE + sizeof(std::uint32_t) + sizeof(PageId);
+  for (std::size_t r = 0; r < ranges.size(); r += 2)
+    size += 2 * sizeof(std::uint16_t) + ranges[r + 1];
+
+  std::vector<std::pair<const void *, std::size_t> > parts;
+  parts.reserve(2 + ranges.size());
+  Lsn lsn;
+  bool full;
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    const Segment &current = segments.back();
+    if (nextLsn > current.start && nextLsn - current.start + size > segmentSize)
+      openSegment(current.number + 1);
+    const std::uint32_t id = fileIdOf(file);
+    parts.push_back({&id, sizeof(id)});
+    parts.push_back({&pageNo, sizeof(pageNo)});
+    for (std::size_t r = 0; r < ranges.size(); r += 2) {
+      parts.push_back({&ranges[r], 2 * sizeof(std::uint16_t)});
+      parts.push_back({image + ranges[r], ranges[r + 1]});
+    }
+    lsn = append(PAGE_RECORD, parts);
+    full = buffer.size() >= LOG_BUFFER_SIZE;
+  }
+  logStats.pageRecords++;
+  if (before == NULL) logStats.pageImages++;
+  // records are written out early when the buffer fills; redo still stops at
+  // the last commit
+  if (full) flush(lsn);
+  return lsn;
+}
+
+Lsn LogManager::commit() {
+  Lsn lsn;
+  bool force;
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    // nothing was changed since the last commit
+    if (nextLsn == lastCommit) return lastCommit;
+    lsn = append(COMMIT_RECORD, {});
+    lastCommit = lsn;
+    commitsWaiting++;
+    force = commitsWaiting >= commitGroup || buffer.size() >= LOG_BUFFER_SIZE;
+  }
+  logStats.commits++;
+  if (force) flush(lsn);
+  return lsn;
+}
+
+void LogManager::flush(Lsn lsn) {
+  std::unique_lock<std::mutex> lock(latch);
+  while (durable < lsn) {
+    // the thread writing the log out takes the records of the others along
+    if (flushing) {
+      flushed.wait(lock);
+      continue;
+    }
+    flushing = true;
+    std::vector<char> out;
+    out.swap(buffer);
+    const Lsn end = nextLsn;
+    const Lsn begin = end - out.size();
+    commitsWaiting = 0;
+    // the pieces of the records going to each segment, which are not dropped
+    // while the log is being written
+    std::vector<std::pair<int, std::pair<Lsn, Lsn> > > pieces;
+    for (std::size_t s = 0; s < segments.size(); s++) {
+      const Lsn from = std::max(begin, segments[s].start);
+      const Lsn to =
+          s + 1 < segments.size() ? std::min(end, segments[s + 1].start) : end;
+      if (from < to)
+        pieces.push_back(std::make_pair(segments[s].fd,
+                                        std::make_pair(from, to)));
+    }
+    lock.unlock();
+    for (auto &piece : pieces) {
+      const Lsn from = piece.second.first, to = piece.second.second;
+      writeAll(piece.first, out.data() + (from - begin), to - from);
+      ::fdatasync(piece.first);
+    }
+    logStats.flushes++;
+    lock.lock();
+    durable = end;
+    flushing = false;
+    flushed.notify_all();
+  }
+}
+
+void LogManager::checkpoint(Lsn redoLsn) {
+  flush(redoLsn);
+  std::vector<Segment> dropped;
+  {
+    std::unique_lock<std::mutex> lock(latch);
+    while (flushing) flushed.wait(lock);
+    // a segment goes once its records all end before the LSN, and it has
+    // been written out whole
+    while (segments.size() > 1 && segments[1].start < redoLsn &&
+           segments[1].start <= durable) {
+      dropped.push_back(segments.front());
+      segments.pop_front();
+    }
+    if (redoLsn > checkpointed) checkpointed = redoLsn;
+  }
+  // the files are deleted without holding up the threads appending records
+  for (const Segment &segment : dropped) {
+    ::close(segment.fd);
+    ::unlink((logName + "." + std::to_string(segment.number)).c_str());
+    logStats.segmentsDropped++;
+  }
+}
+
+}
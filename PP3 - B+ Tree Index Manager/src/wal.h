@@ -0,0 +1,357 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Log sequence number: the position in the log just past a record.
+ * LSNs grow for the life of a LogManager, also across checkpoints.
+ */
+typedef std::uint64_t Lsn;
+
+/**
+ * Bytes of log records buffered before they are written out without waiting
+ * for a commit
+ */
+const std::size_t LOG_BUFFER_SIZE = 1 << 20;
+
+/**
+ * Bytes of log records a segment file of the log grows to before the next one
+ * is started
+ */
+const std::size_t LOG_SEGMENT_SIZE = 16 << 20;
+
+/**
+ * @brief Class to maintain statistics of log usage
+ */
+struct LogStats {
+  /**
+   * Number of page records appended
+   */
+  std::atomic<std::uint64_t> pageRecords;
+
+  /**
+   * Number of page records holding a whole page image
+   */
+  std::atomic<std::uint64_t> pageImages;
+
+  /**
+   * Number of commit records appended
+   */
+  std::atomic<std::uint64_t> commits;
+
+  /**
+   * Bytes appended to the log
+   */
+  std::atomic<std::uint64_t> bytes;
+
+  /**
+   * Number of times the log was written out and forced to disk
+   */
+  std::atomic<std::uint64_t> flushes;
+
+  /**
+   * Number of segment files dropped by checkpoints
+   */
+  std::atomic<std::uint64_t> segmentsDropped;
+
+  /**
+   * Clear all values
+   */
+  void clear() {
+    pageRecords = 0;
+    pageImages = 0;
+    commits = 0;
+    bytes = 0;
+    flushes = 0;
+    segmentsDropped = 0;
+  }
+
+  /**
+   * Constructor of LogStats class
+   */
+  LogStats() { clear(); }
+};
+
+/**
+ * @brief A write-ahead log of the changes made to the pages of some files
+ * through a buffer manager, with redo recovery.
+ *
+ * A buffer manager the log is given to (BufMgr::setLog) appends a record for
+ * each page of a logged file unpinned dirty: the whole page the first time it
+ * changes after being read in or written out, so that a page torn by a
+ * crash is rebuilt whole, and the byte ranges that changed since the record
+ * before otherwise.  A commit record ends each group of changes that must be
+ * redone together, such as the pages of a split; BTreeIndex commits once per
+ * insertion or deletion.
+ *
+ * The log is forced to disk once per commitGroup commits, so that a group of
+ * them shares one write and one fsync, and before the buffer manager writes a
+ * page whose records are not on disk yet.  Pages changed by records that are
+ * not committed yet are not written at all.  Threads waiting for the log to
+ * reach disk wait for the one writing it rather than write it again.
+ *
+ * The log is kept as a series of segment files, logName.0, logName.1 and so
+ * on, each started once the one before holds segmentSize bytes.  A checkpoint
+ * (BufMgr::checkpoint) drops the segments whose records all precede the
+ * oldest change not on disk yet, so that recovery only reads the log written
+ * since about the last checkpoint.  Each segment names the files its records
+ * change.
+ *
+ * Opening a log that holds records redoes the committed ones on their files:
+ * changes committed before a crash and forced to disk are recovered, and
+ * those after the last commit on disk are dropped, together with a record
+ * torn by the crash.  The log is then emptied.  Redoing records whose changes
+ * already reached disk leaves the pages as they are.
+ *
+ * Records hold the in-memory image of pages, so the changes of a file must
+ * all be made through buffer managers using the log.
+ */
+class LogManager {
+ public:
+  /**
+   * Opens the log, creating it if it does not exist, and redoes the committed
+   * records it holds.
+   *
+   * @param logName     Name of the log; its segment files are named after it
+   * @param commitGroup Number of commits forced to disk together; with 1,
+   *                    each commit is on disk once commit() returns
+   * @param segmentSize Bytes a segment file grows to
+   */
+  explicit LogManager(const std::string &logName,
+                      std::uint32_t commitGroup = 1,
+                      std::size_t segmentSize = LOG_SEGMENT_SIZE);
+
+  /**
+   * Forces the records appended so far to disk and closes the log.
+   */
+  ~LogManager();
+
+  /**
+   * Starts logging the changes of a file.
+   *
+   * @param file   File object
+   */
+  void addFile(File *file);
+
+  /**
+   * Stops logging the changes of a file, before it is closed.  Its changes
+   * logged so far are forced to disk.
+   *
+   * @param file   File object
+   */
+  void removeFile(const File *file);
+
+  /**
+   * Returns true if the changes of the file are logged.
+   *
+   * @param file   File object
+   */
+  bool isLogged(const File *file);
+
+  /**
+   * Appends the changes of a page of a logged file.
+   *
+   * @param file    File object
+   * @param pageNo  Page number in the file
+   * @param image   Page::SIZE bytes of the page as changed
+   * @param before  Page::SIZE bytes of the page as last logged, or NULL to
+   *                log the whole page
+   * @return  LSN of the record, or 0 if the page did not change
+   */
+  Lsn logPage(const File *file, PageId pageNo, const char *image,
+              const char *before);
+
+  /**
+   * Appends a commit record for the changes appended so far, and forces the
+   * log to disk once commitGroup commits are waiting.
+   *
+   * @return  LSN of the commit record
+   */
+  Lsn commit();
+
+  /**
+   * Forces the log to disk up to the given LSN.
+   *
+   * @param lsn   LSN to reach
+   */
+  void flush(Lsn lsn);
+
+  /**
+   * Forces all the records appended so far to disk.
+   */
+  void flush() { flush(endLsn()); }
+
+  /**
+   * Drops the segments holding only records before the given LSN, once every
+   * change they hold is on disk in the logged files.  The log is forced to
+   * disk up to the LSN first.
+   *
+   * @param redoLsn   LSN of the oldest record recovery may need
+   */
+  void checkpoint(Lsn redoLsn);
+
+  /**
+   * Forces the logged files to disk.  A file is not removed while it is being
+   * forced.
+   */
+  void syncFiles();
+
+  /**
+   * Returns the LSN of the last commit record.
+   */
+  Lsn committedLsn() const { return lastCommit; }
+
+  /**
+   * Returns the LSN up to which the log is on disk.
+   */
+  Lsn durableLsn() const { return durable; }
+
+  /**
+   * Returns the LSN past the last record appended.
+   */
+  Lsn endLsn();
+
+  /**
+   * Returns the LSN given to the last checkpoint, 0 before the first.
+   */
+  Lsn checkpointLsn() const { return checkpointed; }
+
+  /**
+   * Returns the number of page records redone when the log was opened.
+   */
+  std::size_t numRedone() const { return redone; }
+
+  /**
+   * Get log usage statistics
+   */
+  LogStats &getLogStats() { return logStats; }
+
+  /**
+   * Returns the names of the segment files of a log, oldest first.
+   *
+   * @param logName   Name of the log
+   */
+  static std::vector<std::string> segmentNames(const std::string &logName);
+
+  /**
+   * Deletes the segment files of a log that is not open.
+   *
+   * @param logName   Name of the log
+   */
+  static void remove(const std::string &logName);
+
+ private:
+  /**
+   * Reads the log and redoes its committed records, then empties it.
+   */
+  void recover();
+
+  /**
+   * Starts a new segment file for the records appended from now on.  The
+   * caller holds latch.
+   *
+   * @param number  Number of the segment
+   * @throws FileNotFoundException If the segment file can not be created
+   */
+  void openSegment(std::uint64_t number);
+
+  /**
+   * Appends a record to the buffer.  The caller holds latch.
+   *
+   * @param type    Type of the record
+   * @param parts   Pieces of the body of the record, in order
+   * @return  LSN of the record
+   */
+  Lsn append(char type, const std::vector<std::pair<const void *,
+                                                    std::size_t> > &parts);
+
+  /**
+   * Returns the identifier of a logged file, appending a record naming it if
+   * it has not been named in the current segment yet.  The caller holds
+   * latch.
+   */
+  std::uint32_t fileIdOf(const File *file);
+
+  std::string logName;
+  std::uint32_t commitGroup;
+  std::size_t segmentSize;
+
+  /**
+   * @brief A segment file of the log
+   */
+  struct Segment {
+    std::uint64_t number;
+    /**
+     * LSN of its first record
+     */
+    Lsn start;
+    int fd;
+  };
+
+  /**
+   * Segments not dropped yet, oldest first; records are appended to the last
+   */
+  std::deque<Segment> segments;
+  std::atomic<Lsn> checkpointed;
+
+  /**
+   * Files being logged, by identifier, and identifiers named in the current
+   * segment
+   */
+  std::map<const File *, std::uint32_t> fileIds;
+  std::map<std::uint32_t, File *> files;
+  std::set<std::uint32_t> named;
+  std::uint32_t nextFileId;
+
+  /**
+   * Records appended and not written out yet; they start at LSN
+   * durable + (bytes being written)
+   */
+  std::vector<char> buffer;
+  Lsn nextLsn;
+  std::atomic<Lsn> lastCommit;
+  std::atomic<Lsn> durable;
+  std::uint32_t commitsWaiting;
+
+  /**
+   * True while a thread writes the log out; the others wait on flushed
+   */
+  bool flushing;
+  std::condition_variable flushed;
+
+  /**
+   * Latch guarding the members above
+   */
+  std::mutex latch;
+
+  /**
+   * Latch held while the logged files are forced to disk, so that none is
+   * removed meanwhile
+   */
+  std::mutex syncLatch;
+
+  std::size_t redone;
+  LogStats logStats;
+};
+
+}
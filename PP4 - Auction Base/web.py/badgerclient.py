@@ -0,0 +1,115 @@
+import socket
+import struct
+
+# Client of PP3_serve, the server of the BadgerDB indexes of PP3, for pages
+# that look items up by id rather than through sqlite. The protocol is
+# described in PP3's src/service.h; integer keys only.
+#
+# Sample usage (in auctionbase.py):
+#
+# badger = badgerclient.BadgerClient('127.0.0.1', 7070)
+# items = badger.index('ebay.items,0')
+# rids = badger.lookup(items, 1043374545)
+# for ids in badger.probe(items, [1043374545, 1043397459]):
+#     ...
+
+LOOKUP, SCAN, PROBE, INDEXES = 1, 2, 3, 4
+RECORDS = 1
+LT, LTE, GTE, GT = 0, 1, 2, 3
+
+class BadgerError(Exception):
+    pass
+
+class BadgerClient(object):
+    def __init__(self, host='127.0.0.1', port=7070):
+        self.sock = socket.create_connection((host, port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.tag = 0
+        self.buf = b''
+
+    def close(self):
+        self.sock.close()
+
+    # sends the requests given as (op, flags, index, body) together and
+    # returns the body of each response, in order; every response of the
+    # batch is read before a failed one is raised, so that the next batch
+    # does not read them
+    def requests(self, requests):
+        frames, tags = [], []
+        for op, flags, index, body in requests:
+            frames.append(struct.pack('<IIBBH', 8 + len(body), self.tag, op,
+                                      flags, index) + body)
+            tags.append(self.tag)
+            self.tag = (self.tag + 1) & 0xffffffff
+        self.sock.sendall(b''.join(frames))
+        responses = [self._response() for _ in requests]
+        for tag, (responseTag, status, body) in zip(tags, responses):
+            if responseTag != tag:
+                raise BadgerError('response tag %d for request tag %d' %
+                                  (responseTag, tag))
+            if status != 0:
+                raise BadgerError('request failed with status %d' % status)
+        return [body for _, _, body in responses]
+
+    # reads the next response, returning its tag, status and body
+    def _response(self):
+        while len(self.buf) < 4 or \
+                len(self.buf) < 4 + struct.unpack('<I', self.buf[:4])[0]:
+            data = self.sock.recv(65536)
+            if not data:
+                raise BadgerError('connection closed')
+            self.buf += data
+        length = struct.unpack('<I', self.buf[:4])[0]
+        frame, self.buf = self.buf[4:4 + length], self.buf[4 + length:]
+        tag, status = struct.unpack('<IB', frame[:5])
+        return tag, status, frame[5:]
+
+    # returns the number of the index of the given file name
+    def index(self, name):
+        body = self.requests([(INDEXES, 0, 0, b'')])[0]
+        pos = 2
+        for number in range(struct.unpack('<H', body[:2])[0]):
+            nameLength = struct.unpack('<H', body[pos + 2:pos + 4])[0]
+            if body[pos + 4:pos + 4 + nameLength].decode() == name:
+                return number
+            pos += 4 + nameLength
+        raise BadgerError('no index ' + name)
+
+    # returns the (page, slot) record ids of the entries of a key
+    def lookup(self, index, key, maxRids=1000):
+        return self.lookupMany(index, [key], maxRids)[0]
+
+    # returns the record ids of the entries of each key, with one request
+    # per key sent together
+    def lookupMany(self, index, keys, maxRids=1000):
+        bodies = self.requests([(LOOKUP, 0, index,
+                                 struct.pack('<iI', key, maxRids))
+                                for key in keys])
+        return [_entries(body, 4)[0] for body in bodies]
+
+    # returns the record ids of the entries of each key, in one request
+    def probe(self, index, keys, maxRids=1000):
+        body = self.requests([(PROBE, 0, index,
+                               struct.pack('<I%diI' % len(keys), len(keys),
+                                           *(list(keys) + [maxRids])))])[0]
+        pos, result = 0, []
+        for _ in keys:
+            rids, pos = _entries(body, pos + 4)
+            result.append(rids)
+        return result
+
+    # returns the record ids of the entries from low to high, in key order
+    def scan(self, index, low, high, lowOp=GTE, highOp=LTE, limit=1000):
+        body = self.requests([(SCAN, 0, index,
+                               struct.pack('<BBiiI', lowOp, highOp, low,
+                                           high, limit))])[0]
+        return _entries(body, 0)[0]
+
+# decodes a number of entries, then as many entries, returning their record
+# ids and the position past them
+def _entries(body, pos):
+    n = struct.unpack('<I', body[pos:pos + 4])[0]
+    pos += 4
+    rids = [struct.unpack('<IH', body[pos + 6 * i:pos + 6 * i + 6])
+            for i in range(n)]
+    return rids, pos + 6 * n